@@ -21,7 +21,7 @@ use File::Basename;
 
 my $file = dirname($0)."/../src/schema.tmpl";	# name the file
 
-my ($state, %output, $eol, $fk_bol, $fk_eol, $ltab, $pkey, $table_name);
+my ($state, %output, $eol, $fk_bol, $fk_eol, $ltab, $pkey, $table_name, $table_pkey);
 my ($szcol1, $szcol2, $szcol3, $szcol4, $sequences, $sql_suffix);
 my ($fkeys, $fkeys_prefix, $fkeys_suffix, $uniq);
 
@@ -210,6 +210,7 @@ sub process_table
 	newstate("table");
 
 	($table_name, $pkey, $flags) = split(/\|/, $line, 3);
+	$table_pkey = $pkey;
 
 	if ($output{"type"} eq "code")
 	{
@@ -401,7 +402,7 @@ sub process_field
 				$sequences = "${sequences}BEFORE INSERT ON ${table_name}${eol}\n";
 				$sequences = "${sequences}FOR EACH ROW${eol}\n";
 				$sequences = "${sequences}BEGIN${eol}\n";
-				$sequences = "${sequences}SELECT ${table_name}_seq.nextval INTO :new.id FROM dual;${eol}\n";
+				$sequences = "${sequences}SELECT ${table_name}_seq.nextval INTO :new.${name} FROM dual;${eol}\n";
 				$sequences = "${sequences}END;${eol}\n/${eol}\n";
 			}
 		}
@@ -526,6 +527,64 @@ sub process_index
 	}
 }
 
+sub process_changelog
+{
+	my $line = $_[0];
+	my ($object) = split(/\|/, $line);
+
+	# the change records are used by configuration cache, they are not needed for the code schema
+	return if ($output{"type"} eq "code");
+
+	$object =~ s/\s+//g;
+
+	my %operations = ("insert" => [1, "new"], "update" => [2, "new"], "delete" => [3, "old"]);
+
+	foreach my $name ("insert", "update", "delete")
+	{
+		my ($operation, $row) = @{$operations{$name}};
+		my $op = uc($name);
+		my $trigger = "${table_name}_${name}";
+		my $insert = "INSERT INTO changelog (object,objectid,operation,clock)";
+
+		if ($output{"database"} eq "mysql")
+		{
+			$sequences = "${sequences}CREATE TRIGGER ${trigger} AFTER ${op} ON ${table_name}${eol}\n";
+			$sequences = "${sequences}FOR EACH ROW${eol}\n";
+			$sequences = "${sequences}${insert}${eol}\n";
+			$sequences = "${sequences}VALUES (${object},${row}.${table_pkey},${operation},unix_timestamp());${eol}\n";
+		}
+		elsif ($output{"database"} eq "postgresql")
+		{
+			$sequences = "${sequences}CREATE FUNCTION changelog_${trigger}() RETURNS TRIGGER LANGUAGE plpgsql AS \$\$${eol}\n";
+			$sequences = "${sequences}BEGIN${eol}\n";
+			$sequences = "${sequences}${insert}${eol}\n";
+			$sequences = "${sequences}VALUES (${object},${row}.${table_pkey},${operation},cast(extract(epoch FROM now()) AS integer));${eol}\n";
+			$sequences = "${sequences}RETURN NULL;${eol}\n";
+			$sequences = "${sequences}END \$\$;${eol}\n";
+			$sequences = "${sequences}CREATE TRIGGER ${trigger} AFTER ${op} ON ${table_name}${eol}\n";
+			$sequences = "${sequences}FOR EACH ROW EXECUTE PROCEDURE changelog_${trigger}();${eol}\n";
+		}
+		elsif ($output{"database"} eq "oracle")
+		{
+			$sequences = "${sequences}CREATE TRIGGER ${trigger} AFTER ${op} ON ${table_name}${eol}\n";
+			$sequences = "${sequences}FOR EACH ROW${eol}\n";
+			$sequences = "${sequences}BEGIN${eol}\n";
+			$sequences = "${sequences}${insert}${eol}\n";
+			$sequences = "${sequences}VALUES (${object},:${row}.${table_pkey},${operation},";
+			$sequences = "${sequences}(cast(sys_extract_utc(systimestamp) AS date)-date'1970-01-01')*86400);${eol}\n";
+			$sequences = "${sequences}END;${eol}\n/${eol}\n";
+		}
+		elsif ($output{"database"} eq "sqlite3")
+		{
+			$sequences = "${sequences}CREATE TRIGGER ${trigger} AFTER ${op} ON ${table_name}${eol}\n";
+			$sequences = "${sequences}FOR EACH ROW BEGIN${eol}\n";
+			$sequences = "${sequences}${insert}${eol}\n";
+			$sequences = "${sequences}VALUES (${object},${row}.${table_pkey},${operation},cast(strftime('%s','now') AS integer));${eol}\n";
+			$sequences = "${sequences}END;${eol}\n";
+		}
+	}
+}
+
 sub process_row
 {
 	my $line = $_[0];
@@ -724,6 +783,7 @@ sub process
 			elsif ($type eq 'INDEX')	{ process_index($line, 0); }
 			elsif ($type eq 'TABLE')	{ process_table($line); }
 			elsif ($type eq 'UNIQUE')	{ process_index($line, 1); }
+			elsif ($type eq 'CHANGELOG')	{ process_changelog($line); }
 			elsif ($type eq 'ROW' && $output{"type"} ne "code")		{ process_row($line); }
 		}
 	}
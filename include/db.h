@@ -725,6 +725,8 @@ typedef struct
 	zbx_vector_ptr_t	rows;
 	/* index of autoincrement field */
 	int			autoincrement;
+	/* insert rows with COPY statement instead of insert statements (PostgreSQL only) */
+	unsigned char		copy;
 }
 zbx_db_insert_t;
 
@@ -736,6 +738,10 @@ void	zbx_db_insert_add_values(zbx_db_insert_t *self, ...);
 int	zbx_db_insert_execute(zbx_db_insert_t *self);
 void	zbx_db_insert_clean(zbx_db_insert_t *self);
 void	zbx_db_insert_autoincrement(zbx_db_insert_t *self, const char *field_name);
+void	zbx_db_insert_set_copy(zbx_db_insert_t *self);
+#ifdef HAVE_POSTGRESQL
+int	zbx_db_insert_format(const zbx_db_insert_t *self, zbx_db_stmt_t *stmt);
+#endif
 int	zbx_db_get_database_type(void);
 
 /* agent (ZABBIX, SNMP, IPMI, JMX) availability data */
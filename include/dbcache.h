@@ -38,7 +38,10 @@
 #define	ZBX_POLLER_TYPE_PINGER		3
 #define	ZBX_POLLER_TYPE_JAVA		4
 #define	ZBX_POLLER_TYPE_HISTORY		5
-#define	ZBX_POLLER_TYPE_COUNT		6	/* number of poller types */
+#define	ZBX_POLLER_TYPE_AGENT		6
+#define	ZBX_POLLER_TYPE_SNMP		7
+#define	ZBX_POLLER_TYPE_HTTPAGENT	8
+#define	ZBX_POLLER_TYPE_COUNT		9	/* number of poller types */
 
 #define MAX_JAVA_ITEMS		32
 #define MAX_SNMP_ITEMS		128
@@ -57,6 +60,11 @@ extern int	CONFIG_TIMEOUT;
 extern zbx_uint64_t	CONFIG_CONF_CACHE_SIZE;
 extern zbx_uint64_t	CONFIG_HISTORY_CACHE_SIZE;
 extern zbx_uint64_t	CONFIG_HISTORY_INDEX_CACHE_SIZE;
+extern int		CONFIG_HISTORY_CACHE_SHARDS;
+extern int		CONFIG_HISTORY_CACHE_COMPRESSION;
+extern char		*CONFIG_HISTORY_CACHE_SPOOL_FILE;
+extern zbx_uint64_t	CONFIG_HISTORY_CACHE_SPOOL_SIZE;
+extern char		*CONFIG_HISTORY_CACHE_SNAPSHOT_FILE;
 extern zbx_uint64_t	CONFIG_TRENDS_CACHE_SIZE;
 
 extern int	CONFIG_POLLER_FORKS;
@@ -68,9 +76,13 @@ extern int	CONFIG_UNAVAILABLE_DELAY;
 extern int	CONFIG_UNREACHABLE_PERIOD;
 extern int	CONFIG_UNREACHABLE_DELAY;
 extern int	CONFIG_HISTSYNCER_FORKS;
+extern int	CONFIG_HISTSYNCER_PIPELINE;
 extern int	CONFIG_PROXYCONFIG_FREQUENCY;
 extern int	CONFIG_PROXYDATA_FREQUENCY;
 extern int	CONFIG_HISTORYPOLLER_FORKS;
+extern int	CONFIG_AGENTPOLLER_FORKS;
+extern int	CONFIG_SNMPPOLLER_FORKS;
+extern int	CONFIG_HTTPAGENT_POLLER_FORKS;
 
 typedef struct
 {
@@ -642,7 +654,13 @@ void	free_database_cache(void);
 #define ZBX_STATS_HISTORY_INDEX_FREE	19
 #define ZBX_STATS_HISTORY_INDEX_PUSED	20
 #define ZBX_STATS_HISTORY_INDEX_PFREE	21
+
+/* the maximum number of history cache shards */
+#define ZBX_HC_SHARDS_MAX	(ZBX_MUTEX_HISTORY_SHARDS_NUM + 1)
+#define ZBX_HC_SHARD_ALL	-1
+
 void	*DCget_stats(int request);
+void	*DCget_shard_stats(int request, int shard_index);
 void	DCget_stats_all(zbx_wcache_info_t *wcache_info);
 
 zbx_uint64_t	DCget_nextid(const char *table_name, int num);
@@ -706,6 +724,8 @@ int	DCconfig_get_interface(DC_INTERFACE *interface, zbx_uint64_t hostid, zbx_uin
 int	DCconfig_get_poller_nextcheck(unsigned char poller_type);
 int	DCconfig_get_poller_items(unsigned char poller_type, DC_ITEM **items);
 int	DCconfig_get_ipmi_poller_items(int now, DC_ITEM *items, int items_num, int *nextcheck);
+int	DCconfig_get_async_poller_items(unsigned char poller_type, int now, DC_ITEM *items, int items_num,
+		int *nextcheck);
 int	DCconfig_get_snmp_interfaceids_by_addr(const char *addr, zbx_uint64_t **interfaceids);
 size_t	DCconfig_get_snmp_items_by_interfaceid(zbx_uint64_t interfaceid, DC_ITEM **items);
 
@@ -743,10 +763,12 @@ int	DCget_host_inventory_value_by_hostid(zbx_uint64_t hostid, char **replace_to,
 #define ZBX_CONFSTATS_BUFFER_FREE	3
 #define ZBX_CONFSTATS_BUFFER_PUSED	4
 #define ZBX_CONFSTATS_BUFFER_PFREE	5
+#define ZBX_CONFSTATS_BUFFER_PER_ITEM	6
 void	*DCconfig_get_stats(int request);
 
 int	DCconfig_get_last_sync_time(void);
 void	DCconfig_wait_sync(void);
+int	DCconfig_snapshot_loaded(void);
 int	DCconfig_get_proxypoller_hosts(DC_PROXY *proxies, int max_hosts);
 int	DCconfig_get_proxypoller_nextcheck(void);
 
@@ -862,6 +884,7 @@ typedef struct zbx_hc_data
 	unsigned char	flags;
 	unsigned char	state;
 
+	struct zbx_hc_block	*block;	/* compressed values following this value, see HistoryCacheCompression */
 	struct zbx_hc_data	*next;
 }
 zbx_hc_data_t;
@@ -1007,8 +1030,21 @@ int	zbx_dc_expand_user_macros_len(const char *text, size_t text_len, zbx_uint64_
 
 
 /* diagnostic data */
+typedef struct
+{
+	zbx_uint64_t	items_num;
+	zbx_uint64_t	values_num;
+	zbx_uint64_t	data_free;
+	zbx_uint64_t	data_total;
+	zbx_uint64_t	index_free;
+	zbx_uint64_t	index_total;
+}
+zbx_hc_shard_stats_t;
+
 void	zbx_hc_get_diag_stats(zbx_uint64_t *items_num, zbx_uint64_t *values_num);
-void	zbx_hc_get_mem_stats(zbx_mem_stats_t *data, zbx_mem_stats_t *index);
+int	zbx_hc_get_shards_num(void);
+void	zbx_hc_get_shard_diag_stats(int shard_index, zbx_hc_shard_stats_t *stats);
+void	zbx_hc_get_mem_stats(zbx_mem_stats_t *data, zbx_mem_stats_t *index, double *compression);
 void	zbx_hc_get_items(zbx_vector_uint64_pair_t *items);
 
 typedef struct
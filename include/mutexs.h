@@ -29,6 +29,15 @@
 typedef wchar_t * zbx_mutex_name_t;
 typedef HANDLE zbx_mutex_t;
 #else	/* not _WINDOWS */
+/* the number of history cache shard locks besides ZBX_MUTEX_CACHE */
+#define ZBX_MUTEX_HISTORY_SHARDS_NUM	15
+
+/* the number of configuration cache poller queue locks, one per poller type */
+#define ZBX_MUTEX_POLLER_QUEUES_NUM	9
+
+/* the number of value cache stripe locks besides ZBX_RWLOCK_VALUECACHE */
+#define ZBX_RWLOCK_VALUECACHE_STRIPES_NUM	15
+
 typedef enum
 {
 	ZBX_MUTEX_LOG = 0,
@@ -48,6 +57,13 @@ typedef enum
 #endif
 	ZBX_MUTEX_MODBUS,
 	ZBX_MUTEX_TREND_FUNC,
+	/* history cache shard locks, the first shard is protected by ZBX_MUTEX_CACHE */
+	ZBX_MUTEX_HISTORY_SHARD,
+	ZBX_MUTEX_HISTORY_SHARD_LAST = ZBX_MUTEX_HISTORY_SHARD + ZBX_MUTEX_HISTORY_SHARDS_NUM - 1,
+	/* configuration cache poller queue locks and their memory allocation lock */
+	ZBX_MUTEX_POLLER_QUEUE,
+	ZBX_MUTEX_POLLER_QUEUE_LAST = ZBX_MUTEX_POLLER_QUEUE + ZBX_MUTEX_POLLER_QUEUES_NUM - 1,
+	ZBX_MUTEX_POLLER_QUEUE_MEM,
 	/* NOTE: Do not forget to sync changes here with mutex names in diag_add_locks_info()! */
 	ZBX_MUTEX_COUNT
 }
@@ -57,6 +73,9 @@ typedef enum
 {
 	ZBX_RWLOCK_CONFIG = 0,
 	ZBX_RWLOCK_VALUECACHE,
+	/* value cache stripe locks, the first stripe is protected by ZBX_RWLOCK_VALUECACHE */
+	ZBX_RWLOCK_VALUECACHE_STRIPE,
+	ZBX_RWLOCK_VALUECACHE_STRIPE_LAST = ZBX_RWLOCK_VALUECACHE_STRIPE + ZBX_RWLOCK_VALUECACHE_STRIPES_NUM - 1,
 	ZBX_RWLOCK_COUNT,
 }
 zbx_rwlock_name_t;
@@ -68,6 +87,8 @@ zbx_rwlock_name_t;
 #	define zbx_rwlock_wrlock(rwlock)	__zbx_rwlock_wrlock(__FILE__, __LINE__, rwlock)
 #	define zbx_rwlock_rdlock(rwlock)	__zbx_rwlock_rdlock(__FILE__, __LINE__, rwlock)
 #	define zbx_rwlock_unlock(rwlock)	__zbx_rwlock_unlock(__FILE__, __LINE__, rwlock)
+#	define zbx_rwlock_trywrlock(rwlock)	__zbx_rwlock_trywrlock(__FILE__, __LINE__, rwlock)
+#	define zbx_rwlock_tryrdlock(rwlock)	__zbx_rwlock_tryrdlock(__FILE__, __LINE__, rwlock)
 
 typedef pthread_mutex_t * zbx_mutex_t;
 typedef pthread_rwlock_t * zbx_rwlock_t;
@@ -75,6 +96,8 @@ typedef pthread_rwlock_t * zbx_rwlock_t;
 void	__zbx_rwlock_wrlock(const char *filename, int line, zbx_rwlock_t rwlock);
 void	__zbx_rwlock_rdlock(const char *filename, int line, zbx_rwlock_t rwlock);
 void	__zbx_rwlock_unlock(const char *filename, int line, zbx_rwlock_t rwlock);
+int	__zbx_rwlock_trywrlock(const char *filename, int line, zbx_rwlock_t rwlock);
+int	__zbx_rwlock_tryrdlock(const char *filename, int line, zbx_rwlock_t rwlock);
 void	zbx_rwlock_destroy(zbx_rwlock_t *rwlock);
 void	zbx_locks_disable(void);
 #else	/* fallback to semaphores if read-write locks are not available */
@@ -85,9 +108,13 @@ void	zbx_locks_disable(void);
 #	define zbx_rwlock_rdlock(rwlock)		__zbx_mutex_lock(__FILE__, __LINE__, rwlock)
 #	define zbx_rwlock_unlock(rwlock)		__zbx_mutex_unlock(__FILE__, __LINE__, rwlock)
 #	define zbx_rwlock_destroy(rwlock)		zbx_mutex_destroy(rwlock)
+#	define zbx_rwlock_trywrlock(rwlock)		__zbx_mutex_trylock(__FILE__, __LINE__, rwlock)
+#	define zbx_rwlock_tryrdlock(rwlock)		__zbx_mutex_trylock(__FILE__, __LINE__, rwlock)
 
 typedef int zbx_mutex_t;
 typedef int zbx_rwlock_t;
+
+int	__zbx_mutex_trylock(const char *filename, int line, zbx_mutex_t mutex);
 #endif
 int		zbx_locks_create(char **error);
 int		zbx_rwlock_create(zbx_rwlock_t *rwlock, zbx_rwlock_name_t name, char **error);
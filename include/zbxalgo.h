@@ -271,6 +271,56 @@ void			zbx_binary_heap_remove_direct(zbx_binary_heap_t *heap, zbx_uint64_t key);
 
 void			zbx_binary_heap_clear(zbx_binary_heap_t *heap);
 
+/* hierarchical timer wheel */
+
+/* Schedules elements with second precision timestamps. Elements are kept in wheel slots with O(1) insert and */
+/* remove until their time is reached, then they are moved to the due elements heap, which orders elements    */
+/* scheduled at the same second by the compare function.                                                      */
+
+#define ZBX_TIMER_WHEEL_LEVEL_BITS	8
+#define ZBX_TIMER_WHEEL_LEVEL_SLOTS	(1 << ZBX_TIMER_WHEEL_LEVEL_BITS)
+#define ZBX_TIMER_WHEEL_LEVELS		4	/* the levels cover 32 bit timestamps */
+
+typedef struct zbx_timer_wheel_node
+{
+	zbx_uint64_t			key;
+	const void			*data;
+	struct zbx_timer_wheel_node	*prev;
+	struct zbx_timer_wheel_node	*next;
+	int				time;
+	int				slot;	/* the wheel slot index or -1 for due elements */
+}
+zbx_timer_wheel_node_t;
+
+typedef struct
+{
+	zbx_timer_wheel_node_t	**slots;
+	int			levels_num[ZBX_TIMER_WHEEL_LEVELS];	/* the number of elements in level slots */
+	int			time;					/* the next second to expire */
+	zbx_hashset_t		nodes;					/* the elements by key */
+	zbx_binary_heap_t	due;					/* the elements scheduled before time */
+
+	zbx_mem_malloc_func_t	mem_malloc_func;
+	zbx_mem_realloc_func_t	mem_realloc_func;
+	zbx_mem_free_func_t	mem_free_func;
+}
+zbx_timer_wheel_t;
+
+void			zbx_timer_wheel_create(zbx_timer_wheel_t *wheel, zbx_compare_func_t compare_func);
+void			zbx_timer_wheel_create_ext(zbx_timer_wheel_t *wheel, zbx_compare_func_t compare_func,
+							zbx_mem_malloc_func_t mem_malloc_func,
+							zbx_mem_realloc_func_t mem_realloc_func,
+							zbx_mem_free_func_t mem_free_func);
+void			zbx_timer_wheel_destroy(zbx_timer_wheel_t *wheel);
+
+int			zbx_timer_wheel_empty(const zbx_timer_wheel_t *wheel);
+int			zbx_timer_wheel_elems_num(const zbx_timer_wheel_t *wheel);
+void			zbx_timer_wheel_update(zbx_timer_wheel_t *wheel, zbx_uint64_t key, const void *data, int time);
+void			zbx_timer_wheel_remove(zbx_timer_wheel_t *wheel, zbx_uint64_t key);
+zbx_binary_heap_elem_t	*zbx_timer_wheel_find_min(zbx_timer_wheel_t *wheel, int now);
+void			zbx_timer_wheel_remove_min(zbx_timer_wheel_t *wheel);
+int			zbx_timer_wheel_nextcheck(const zbx_timer_wheel_t *wheel);
+
 /* vector */
 
 #define ZBX_VECTOR_DECL(__id, __type)										\
@@ -460,4 +510,28 @@ int	zbx_list_iterator_equal(const zbx_list_iterator_t *iterator1, const zbx_list
 int	zbx_list_iterator_isset(const zbx_list_iterator_t *iterator);
 void	zbx_list_iterator_update(zbx_list_iterator_t *iterator);
 
+/* Gorilla style time series compression */
+
+/* the maximum number of bits a single value can take in compressed data stream */
+#define ZBX_GORILLA_VALUE_BITS_MAX	176
+
+typedef struct
+{
+	zbx_uint64_t	value;		/* the last value */
+	zbx_int64_t	delta;		/* the last timestamp seconds delta */
+	int		sec;		/* the last timestamp seconds */
+	int		ns;		/* the last timestamp nanoseconds */
+	zbx_uint32_t	bits_num;	/* the number of written/read bits */
+	zbx_uint32_t	values_num;	/* the number of encoded/decoded values */
+	unsigned char	leading;	/* the leading zero bits of the last meaningful bits window */
+	unsigned char	trailing;	/* the trailing zero bits of the last meaningful bits window */
+}
+zbx_gorilla_state_t;
+
+void	zbx_gorilla_init(zbx_gorilla_state_t *state);
+int	zbx_gorilla_encode(zbx_gorilla_state_t *encoder, unsigned char *data, size_t size, const zbx_timespec_t *ts,
+		zbx_uint64_t value);
+void	zbx_gorilla_decode(zbx_gorilla_state_t *decoder, const unsigned char *data, zbx_timespec_t *ts,
+		zbx_uint64_t *value);
+
 #endif
@@ -100,8 +100,27 @@ const char	*zbx_db_last_strerr(void);
 #ifdef HAVE_POSTGRESQL
 int	zbx_tsdb_get_version(void);
 #define ZBX_DB_TSDB_V1	(20000 > zbx_tsdb_get_version())
+
+int	zbx_db_copy(const char *sql, const char *data, size_t size);
+
+/* statement executed on the asynchronous connection */
+typedef struct
+{
+	char	*sql;
+	char	*data;		/* the data of COPY FROM STDIN statement, NULL for other statements */
+	size_t	data_size;
+}
+zbx_db_stmt_t;
+
+int	zbx_db_async_send(const zbx_db_stmt_t *stmts, int stmts_num);
+int	zbx_db_async_wait(void);
+void	zbx_db_async_close(void);
 #endif
 
+int		zbx_db_prefetch_send(const char *sql);
+DB_RESULT	zbx_db_prefetch_result(int index);
+void		zbx_db_prefetch_close(void);
+
 #ifdef HAVE_ORACLE
 
 /* context for dynamic parameter binding */
@@ -131,6 +150,9 @@ DB_RESULT	zbx_db_vselect(const char *fmt, va_list args);
 DB_RESULT	zbx_db_select_n(const char *query, int n);
 
 DB_ROW		zbx_db_fetch(DB_RESULT result);
+DB_RESULT	zbx_db_result_from_blob(char *blob, size_t blob_size, int fields);
+void		zbx_db_row_serialize(char **blob, size_t *blob_alloc, size_t *blob_offset, DB_ROW row, int fields);
+int		zbx_db_result_fields(DB_RESULT result);
 void		DBfree_result(DB_RESULT result);
 int		zbx_db_is_null(const char *field);
 
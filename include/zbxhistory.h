@@ -55,10 +55,15 @@ int	zbx_history_init(char **error);
 void	zbx_history_destroy(void);
 
 int	zbx_history_add_values(const zbx_vector_ptr_t *history);
+int	zbx_history_add_values_async(const zbx_vector_ptr_t *history);
+int	zbx_history_wait_async(void);
 int	zbx_history_get_values(zbx_uint64_t itemid, int value_type, int start, int count, int end,
 		zbx_vector_history_record_t *values);
+int	zbx_history_get_values_multi(const zbx_vector_uint64_t *itemids, int value_type, int start, int end,
+		zbx_vector_history_record_t *values);
 
 int	zbx_history_requires_trends(int value_type);
+int	zbx_history_housekeep(int value_type, int now, int keep_from, int *deleted);
 void	zbx_history_check_version(struct zbx_json *json);
 
 #endif
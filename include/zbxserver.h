@@ -66,6 +66,9 @@ int	evaluate_function(char **value, DC_ITEM *item, const char *function, const c
 int	evaluate_function2(zbx_variant_t *value, DC_ITEM *item, const char *function, const char *parameter,
 		const zbx_timespec_t *ts, char **error);
 
+int	zbx_get_function_history_range(const char *function, const char *parameter, const zbx_timespec_t *ts,
+		int *range_start);
+
 int	zbx_is_trigger_function(const char *name, size_t len);
 
 int	substitute_simple_macros(const zbx_uint64_t *actionid, const DB_EVENT *event, const DB_EVENT *r_event,
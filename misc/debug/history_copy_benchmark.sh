@@ -0,0 +1,63 @@
+#!/bin/sh
+
+# Compares inserting history values into PostgreSQL with multi-row insert statements,
+# as generated by zbx_db_insert_execute(), and with COPY statement, as used for history
+# tables since zbx_db_insert_set_copy() was introduced.
+#
+# Usage: history_copy_benchmark.sh [rows] [rows per insert statement]
+#
+# The database is selected with standard libpq environment variables (PGHOST, PGDATABASE, PGUSER, ...).
+# A temporary table is used, so the benchmark can be run against a database with Zabbix schema.
+
+ROWS=${1:-1000000}
+BATCH=${2:-1000}
+TMPDIR=${TMPDIR:-/tmp}
+
+INSERT_FILE="$TMPDIR/zbx_bench_insert.$$.sql"
+COPY_FILE="$TMPDIR/zbx_bench_copy.$$.sql"
+
+trap 'rm -f "$INSERT_FILE" "$COPY_FILE"' EXIT
+
+TABLE="create temporary table history_bench (itemid bigint not null, clock integer default '0' not null,
+	value double precision default '0.0000' not null, ns integer default '0' not null,
+	primary key (itemid,clock,ns));"
+
+echo "generating $ROWS rows..."
+
+awk -v rows="$ROWS" -v batch="$BATCH" -v table="$TABLE" 'BEGIN {
+	print table
+	print "begin;"
+	for (i = 0; i < rows; i++)
+	{
+		if (0 == i % batch)
+			printf("%sinsert into history_bench (itemid,clock,ns,value) values ", 0 == i ? "" : ";\n")
+		else
+			printf(",")
+
+		printf("(%d,%d,%d,%.17G)", 10000 + i % 10000, 1600000000 + int(i / 10000), i % 1000, i * 0.25)
+	}
+	print ";"
+	print "commit;"
+}' > "$INSERT_FILE"
+
+awk -v rows="$ROWS" -v table="$TABLE" 'BEGIN {
+	print table
+	print "begin;"
+	print "copy history_bench (itemid,clock,ns,value) from stdin;"
+	for (i = 0; i < rows; i++)
+		printf("%d\t%d\t%d\t%.17G\n", 10000 + i % 10000, 1600000000 + int(i / 10000), i % 1000, i * 0.25)
+	print "\\."
+	print "commit;"
+}' > "$COPY_FILE"
+
+run()
+{
+	START=$(date +%s.%N)
+	psql -q -v ON_ERROR_STOP=1 -f "$2" > /dev/null || exit 1
+	END=$(date +%s.%N)
+
+	echo "$1: $(echo "$END - $START" | bc) sec"
+}
+
+run "insert ($BATCH rows per statement)" "$INSERT_FILE"
+run "copy" "$COPY_FILE"
@@ -0,0 +1,401 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "common.h"
+#include "zbxalgo.h"
+
+/*
+ * Gorilla style time series compression.
+ *
+ * Each value is encoded as timestamp seconds, timestamp nanoseconds and 64 bit value pattern.
+ *
+ * The first value is stored as is - 32 bits of seconds, 30 bits of nanoseconds and 64 bits of value.
+ *
+ * For the following values:
+ *   seconds are stored as delta of deltas:
+ *     '0'                          - the delta is the same as previous delta
+ *     '10'   + 7 bits              - the delta of deltas is in range [-64, 63]
+ *     '110'  + 9 bits              - the delta of deltas is in range [-256, 255]
+ *     '1110' + 12 bits             - the delta of deltas is in range [-2048, 2047]
+ *     '1111' + 64 bits             - any other delta of deltas
+ *   nanoseconds are stored as:
+ *     '0'                          - the nanoseconds are the same as in previous value
+ *     '1'    + 30 bits             - the nanoseconds
+ *   values are XOR'ed with the previous value and stored as:
+ *     '0'                          - the value is the same as previous value
+ *     '10'   + meaningful bits     - the meaningful bits fit into the previous meaningful bits window
+ *     '11'   + 5 bits of leading zeros count + 6 bits of meaningful bits count + meaningful bits
+ */
+
+#define GORILLA_SEC_BITS	32
+#define GORILLA_NS_BITS		30
+
+#define GORILLA_LEADING_BITS	5
+#define GORILLA_LEADING_MAX	((1 << GORILLA_LEADING_BITS) - 1)
+#define GORILLA_MEANINGFUL_BITS	6
+
+/* leading zero count of the initial state, guarantees that the first XOR'ed value */
+/* is written with explicit leading/meaningful bits counts                         */
+#define GORILLA_LEADING_NONE	64
+
+typedef struct
+{
+	int	bits;		/* the delta of deltas bits */
+	int	prefix;		/* the bucket prefix */
+	int	prefix_bits;	/* the bucket prefix bits */
+}
+zbx_gorilla_bucket_t;
+
+static const zbx_gorilla_bucket_t	gorilla_buckets[] = {
+	{7, 0x2, 2},
+	{9, 0x6, 3},
+	{12, 0xe, 4},
+	{64, 0xf, 4}
+};
+
+/******************************************************************************
+ *                                                                            *
+ * Function: gorilla_write_bits                                               *
+ *                                                                            *
+ * Purpose: write the lowest bits of value into data stream                   *
+ *                                                                            *
+ * Parameters: data  - [IN/OUT] the data stream                               *
+ *             pos   - [IN/OUT] the position of the next bit in stream        *
+ *             value - [IN] the value to write                                *
+ *             bits  - [IN] the number of bits to write                       *
+ *                                                                            *
+ * Comments: The bits are written starting with the most significant bit.     *
+ *           Bits following the written bits in the last modified byte are    *
+ *           reset, so the stream can be written into uninitialized buffer.   *
+ *                                                                            *
+ ******************************************************************************/
+static void	gorilla_write_bits(unsigned char *data, zbx_uint32_t *pos, zbx_uint64_t value, int bits)
+{
+	while (0 < bits)
+	{
+		int		offset = (int)(*pos & 7), num = 8 - offset;
+		unsigned char	*byte = data + (*pos >> 3), chunk;
+
+		if (num > bits)
+			num = bits;
+
+		chunk = (unsigned char)((value >> (bits - num)) & ((1 << num) - 1));
+
+		if (0 == offset)
+			*byte = 0;
+
+		*byte |= (unsigned char)(chunk << (8 - offset - num));
+
+		*pos += (zbx_uint32_t)num;
+		bits -= num;
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: gorilla_read_bits                                                *
+ *                                                                            *
+ * Purpose: read value from data stream                                       *
+ *                                                                            *
+ * Parameters: data  - [IN] the data stream                                   *
+ *             pos   - [IN/OUT] the position of the next bit in stream        *
+ *             bits  - [IN] the number of bits to read                        *
+ *                                                                            *
+ * Return value: The read value.                                              *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_uint64_t	gorilla_read_bits(const unsigned char *data, zbx_uint32_t *pos, int bits)
+{
+	zbx_uint64_t	value = 0;
+
+	while (0 < bits)
+	{
+		int	offset = (int)(*pos & 7), num = 8 - offset;
+
+		if (num > bits)
+			num = bits;
+
+		value = (value << num) | ((data[*pos >> 3] >> (8 - offset - num)) & ((1 << num) - 1));
+
+		*pos += (zbx_uint32_t)num;
+		bits -= num;
+	}
+
+	return value;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: gorilla_count_leading                                            *
+ *                                                                            *
+ * Purpose: count leading zero bits of a non zero value                       *
+ *                                                                            *
+ ******************************************************************************/
+static int	gorilla_count_leading(zbx_uint64_t value)
+{
+	int	count = 0;
+
+	while (0 == (value & __UINT64_C(0x8000000000000000)))
+	{
+		value <<= 1;
+		count++;
+	}
+
+	return count;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: gorilla_count_trailing                                           *
+ *                                                                            *
+ * Purpose: count trailing zero bits of a non zero value                      *
+ *                                                                            *
+ ******************************************************************************/
+static int	gorilla_count_trailing(zbx_uint64_t value)
+{
+	int	count = 0;
+
+	while (0 == (value & 1))
+	{
+		value >>= 1;
+		count++;
+	}
+
+	return count;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_gorilla_init                                                 *
+ *                                                                            *
+ * Purpose: initialize compression encoder or decoder state                   *
+ *                                                                            *
+ * Parameters: state - [OUT] the state to initialize                          *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_gorilla_init(zbx_gorilla_state_t *state)
+{
+	memset(state, 0, sizeof(zbx_gorilla_state_t));
+	state->leading = GORILLA_LEADING_NONE;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_gorilla_encode                                               *
+ *                                                                            *
+ * Purpose: append value to the compressed data stream                        *
+ *                                                                            *
+ * Parameters: encoder - [IN/OUT] the encoder state                           *
+ *             data    - [IN/OUT] the compressed data stream                  *
+ *             size    - [IN] the data stream buffer size in bytes            *
+ *             ts      - [IN] the value timestamp                             *
+ *             value   - [IN] the value bit pattern                           *
+ *                                                                            *
+ * Return value: SUCCEED - the value was encoded                              *
+ *               FAIL    - the data stream buffer might not have enough space *
+ *                         for the value, the stream was not changed          *
+ *                                                                            *
+ * Comments: Floating point values must be passed as their bit patterns.      *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_gorilla_encode(zbx_gorilla_state_t *encoder, unsigned char *data, size_t size, const zbx_timespec_t *ts,
+		zbx_uint64_t value)
+{
+	zbx_int64_t	delta, dod;
+	zbx_uint64_t	xor;
+	int		leading, trailing;
+	size_t		i;
+
+	if (size * 8 < (size_t)encoder->bits_num + ZBX_GORILLA_VALUE_BITS_MAX)
+		return FAIL;
+
+	if (0 == encoder->values_num)
+	{
+		gorilla_write_bits(data, &encoder->bits_num, (zbx_uint32_t)ts->sec, GORILLA_SEC_BITS);
+		gorilla_write_bits(data, &encoder->bits_num, (zbx_uint64_t)ts->ns, GORILLA_NS_BITS);
+		gorilla_write_bits(data, &encoder->bits_num, value, 64);
+		goto out;
+	}
+
+	/* timestamp seconds */
+
+	delta = (zbx_int64_t)ts->sec - encoder->sec;
+
+	if (0 == (dod = delta - encoder->delta))
+	{
+		gorilla_write_bits(data, &encoder->bits_num, 0, 1);
+	}
+	else
+	{
+		for (i = 0; i < ARRSIZE(gorilla_buckets) - 1; i++)
+		{
+			zbx_int64_t	limit = (zbx_int64_t)1 << (gorilla_buckets[i].bits - 1);
+
+			if (-limit <= dod && dod < limit)
+				break;
+		}
+
+		gorilla_write_bits(data, &encoder->bits_num, (zbx_uint64_t)gorilla_buckets[i].prefix,
+				gorilla_buckets[i].prefix_bits);
+		gorilla_write_bits(data, &encoder->bits_num, (zbx_uint64_t)dod, gorilla_buckets[i].bits);
+	}
+
+	encoder->delta = delta;
+
+	/* timestamp nanoseconds */
+
+	if (ts->ns == encoder->ns)
+	{
+		gorilla_write_bits(data, &encoder->bits_num, 0, 1);
+	}
+	else
+	{
+		gorilla_write_bits(data, &encoder->bits_num, 1, 1);
+		gorilla_write_bits(data, &encoder->bits_num, (zbx_uint64_t)ts->ns, GORILLA_NS_BITS);
+	}
+
+	/* value */
+
+	if (0 == (xor = value ^ encoder->value))
+	{
+		gorilla_write_bits(data, &encoder->bits_num, 0, 1);
+		goto out;
+	}
+
+	if (GORILLA_LEADING_MAX < (leading = gorilla_count_leading(xor)))
+		leading = GORILLA_LEADING_MAX;
+
+	trailing = gorilla_count_trailing(xor);
+
+	if (leading >= encoder->leading && trailing >= encoder->trailing)
+	{
+		gorilla_write_bits(data, &encoder->bits_num, 0x2, 2);
+		gorilla_write_bits(data, &encoder->bits_num, xor >> encoder->trailing,
+				64 - encoder->leading - encoder->trailing);
+	}
+	else
+	{
+		int	meaningful = 64 - leading - trailing;
+
+		gorilla_write_bits(data, &encoder->bits_num, 0x3, 2);
+		gorilla_write_bits(data, &encoder->bits_num, (zbx_uint64_t)leading, GORILLA_LEADING_BITS);
+		/* 64 meaningful bits are written as 0, it's not possible to have 0 meaningful bits */
+		gorilla_write_bits(data, &encoder->bits_num, (zbx_uint64_t)(meaningful & 0x3f),
+				GORILLA_MEANINGFUL_BITS);
+		gorilla_write_bits(data, &encoder->bits_num, xor >> trailing, meaningful);
+
+		encoder->leading = (unsigned char)leading;
+		encoder->trailing = (unsigned char)trailing;
+	}
+out:
+	encoder->sec = ts->sec;
+	encoder->ns = ts->ns;
+	encoder->value = value;
+	encoder->values_num++;
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_gorilla_decode                                               *
+ *                                                                            *
+ * Purpose: read the next value from the compressed data stream               *
+ *                                                                            *
+ * Parameters: decoder - [IN/OUT] the decoder state                           *
+ *             data    - [IN] the compressed data stream                      *
+ *             ts      - [OUT] the value timestamp                            *
+ *             value   - [OUT] the value bit pattern                          *
+ *                                                                            *
+ * Comments: The caller must ensure that the stream has more values by        *
+ *           comparing decoder and encoder values_num.                        *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_gorilla_decode(zbx_gorilla_state_t *decoder, const unsigned char *data, zbx_timespec_t *ts,
+		zbx_uint64_t *value)
+{
+	zbx_uint64_t	xor;
+
+	if (0 == decoder->values_num)
+	{
+		ts->sec = (int)(zbx_uint32_t)gorilla_read_bits(data, &decoder->bits_num, GORILLA_SEC_BITS);
+		ts->ns = (int)gorilla_read_bits(data, &decoder->bits_num, GORILLA_NS_BITS);
+		*value = gorilla_read_bits(data, &decoder->bits_num, 64);
+		goto out;
+	}
+
+	/* timestamp seconds */
+
+	if (0 != gorilla_read_bits(data, &decoder->bits_num, 1))
+	{
+		size_t		i;
+		zbx_uint64_t	dod;
+
+		for (i = 0; i < ARRSIZE(gorilla_buckets) - 1; i++)
+		{
+			if (0 == gorilla_read_bits(data, &decoder->bits_num, 1))
+				break;
+		}
+
+		dod = gorilla_read_bits(data, &decoder->bits_num, gorilla_buckets[i].bits);
+
+		/* sign extend the delta of deltas */
+		if (64 > gorilla_buckets[i].bits && 0 != (dod & (__UINT64_C(1) << (gorilla_buckets[i].bits - 1))))
+			dod |= ~__UINT64_C(0) << gorilla_buckets[i].bits;
+
+		decoder->delta += (zbx_int64_t)dod;
+	}
+
+	ts->sec = (int)(decoder->sec + decoder->delta);
+
+	/* timestamp nanoseconds */
+
+	if (0 != gorilla_read_bits(data, &decoder->bits_num, 1))
+		ts->ns = (int)gorilla_read_bits(data, &decoder->bits_num, GORILLA_NS_BITS);
+	else
+		ts->ns = decoder->ns;
+
+	/* value */
+
+	if (0 == gorilla_read_bits(data, &decoder->bits_num, 1))
+	{
+		*value = decoder->value;
+		goto out;
+	}
+
+	if (0 != gorilla_read_bits(data, &decoder->bits_num, 1))
+	{
+		int	meaningful;
+
+		decoder->leading = (unsigned char)gorilla_read_bits(data, &decoder->bits_num, GORILLA_LEADING_BITS);
+
+		if (0 == (meaningful = (int)gorilla_read_bits(data, &decoder->bits_num, GORILLA_MEANINGFUL_BITS)))
+			meaningful = 64;
+
+		decoder->trailing = (unsigned char)(64 - decoder->leading - meaningful);
+	}
+
+	xor = gorilla_read_bits(data, &decoder->bits_num, 64 - decoder->leading - decoder->trailing);
+	*value = decoder->value ^ (xor << decoder->trailing);
+out:
+	decoder->sec = ts->sec;
+	decoder->ns = ts->ns;
+	decoder->value = *value;
+	decoder->values_num++;
+}
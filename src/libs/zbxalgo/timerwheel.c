@@ -0,0 +1,373 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "common.h"
+#include "log.h"
+
+#include "zbxalgo.h"
+
+/* An element is kept at the lowest level where its time shares all higher level digits with the wheel time, */
+/* in the slot of its own digit at that level. When the wheel time crosses a level boundary, the elements of  */
+/* the corresponding higher level slot are moved down to the lower levels (cascaded).                         */
+
+#define ZBX_TIMER_WHEEL_SLOT_MASK	(ZBX_TIMER_WHEEL_LEVEL_SLOTS - 1)
+#define ZBX_TIMER_WHEEL_SLOT_DUE	-1
+
+#define TW_SHIFT(level)			(ZBX_TIMER_WHEEL_LEVEL_BITS * (level))
+#define TW_DIGIT(time, level)		((int)(((zbx_uint64_t)(time) >> TW_SHIFT(level)) & ZBX_TIMER_WHEEL_SLOT_MASK))
+#define TW_PREFIX(time, level)		((zbx_uint64_t)(time) >> TW_SHIFT((level) + 1))
+
+/* private timer wheel functions */
+
+static int	timer_wheel_slots_num(const zbx_timer_wheel_t *wheel)
+{
+	return wheel->nodes.num_data - wheel->due.elems_num;
+}
+
+static void	timer_wheel_link(zbx_timer_wheel_t *wheel, zbx_timer_wheel_node_t *node)
+{
+	int	level;
+
+	if (node->time < wheel->time)
+	{
+		zbx_binary_heap_elem_t	elem = {node->key, node->data};
+
+		node->slot = ZBX_TIMER_WHEEL_SLOT_DUE;
+		zbx_binary_heap_insert(&wheel->due, &elem);
+		return;
+	}
+
+	for (level = 0; level < ZBX_TIMER_WHEEL_LEVELS - 1; level++)
+	{
+		if (TW_PREFIX(node->time, level) == TW_PREFIX(wheel->time, level))
+			break;
+	}
+
+	node->slot = level * ZBX_TIMER_WHEEL_LEVEL_SLOTS + TW_DIGIT(node->time, level);
+	node->prev = NULL;
+
+	if (NULL != (node->next = wheel->slots[node->slot]))
+		node->next->prev = node;
+
+	wheel->slots[node->slot] = node;
+	wheel->levels_num[level]++;
+}
+
+static void	timer_wheel_unlink(zbx_timer_wheel_t *wheel, zbx_timer_wheel_node_t *node)
+{
+	if (ZBX_TIMER_WHEEL_SLOT_DUE == node->slot)
+	{
+		zbx_binary_heap_remove_direct(&wheel->due, node->key);
+		return;
+	}
+
+	if (NULL != node->prev)
+		node->prev->next = node->next;
+	else
+		wheel->slots[node->slot] = node->next;
+
+	if (NULL != node->next)
+		node->next->prev = node->prev;
+
+	wheel->levels_num[node->slot / ZBX_TIMER_WHEEL_LEVEL_SLOTS]--;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: timer_wheel_cascade                                              *
+ *                                                                            *
+ * Purpose: moves elements of the higher level slots that became current      *
+ *          after crossing level boundary to the lower levels                 *
+ *                                                                            *
+ ******************************************************************************/
+static void	timer_wheel_cascade(zbx_timer_wheel_t *wheel)
+{
+	int	level;
+
+	for (level = ZBX_TIMER_WHEEL_LEVELS - 1; 0 < level; level--)
+	{
+		zbx_timer_wheel_node_t	*node, *next;
+		int			slot;
+
+		if (0 != ((zbx_uint64_t)wheel->time & ((__UINT64_C(1) << TW_SHIFT(level)) - 1)))
+			continue;
+
+		slot = level * ZBX_TIMER_WHEEL_LEVEL_SLOTS + TW_DIGIT(wheel->time, level);
+		node = wheel->slots[slot];
+		wheel->slots[slot] = NULL;
+
+		for (; NULL != node; node = next)
+		{
+			next = node->next;
+			wheel->levels_num[level]--;
+			timer_wheel_link(wheel, node);
+		}
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: timer_wheel_advance                                              *
+ *                                                                            *
+ * Purpose: moves elements scheduled up to the specified time to due heap     *
+ *                                                                            *
+ ******************************************************************************/
+static void	timer_wheel_advance(zbx_timer_wheel_t *wheel, int now)
+{
+	while (wheel->time <= now)
+	{
+		if (0 == timer_wheel_slots_num(wheel))
+		{
+			wheel->time = now + 1;
+			break;
+		}
+
+		if (0 != wheel->levels_num[0])
+		{
+			zbx_timer_wheel_node_t	*node, *next;
+			int			slot;
+
+			slot = TW_DIGIT(wheel->time, 0);
+			node = wheel->slots[slot];
+			wheel->slots[slot] = NULL;
+
+			for (; NULL != node; node = next)
+			{
+				zbx_binary_heap_elem_t	elem = {node->key, node->data};
+
+				next = node->next;
+				wheel->levels_num[0]--;
+				node->slot = ZBX_TIMER_WHEEL_SLOT_DUE;
+				zbx_binary_heap_insert(&wheel->due, &elem);
+			}
+
+			wheel->time++;
+		}
+		else
+		{
+			zbx_uint64_t	boundary;
+			int		level;
+
+			/* nothing is scheduled until the boundary of the lowest non-empty level */
+			for (level = 1; 0 == wheel->levels_num[level]; level++)
+				;
+
+			boundary = (((zbx_uint64_t)wheel->time >> TW_SHIFT(level)) + 1) << TW_SHIFT(level);
+
+			if (boundary > (zbx_uint64_t)now + 1)
+			{
+				wheel->time = now + 1;
+				break;
+			}
+
+			wheel->time = (int)boundary;
+		}
+
+		if (0 == TW_DIGIT(wheel->time, 0))
+			timer_wheel_cascade(wheel);
+	}
+}
+
+/* public timer wheel interface */
+
+void	zbx_timer_wheel_create(zbx_timer_wheel_t *wheel, zbx_compare_func_t compare_func)
+{
+	zbx_timer_wheel_create_ext(wheel, compare_func, ZBX_DEFAULT_MEM_MALLOC_FUNC, ZBX_DEFAULT_MEM_REALLOC_FUNC,
+			ZBX_DEFAULT_MEM_FREE_FUNC);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_timer_wheel_create_ext                                       *
+ *                                                                            *
+ * Purpose: creates timer wheel                                               *
+ *                                                                            *
+ * Parameters: wheel        - [OUT] the timer wheel                           *
+ *             compare_func - [IN] the due element compare function, must     *
+ *                                 order elements by their time first         *
+ *             mem_*_func   - [IN] the memory management functions            *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_timer_wheel_create_ext(zbx_timer_wheel_t *wheel, zbx_compare_func_t compare_func,
+		zbx_mem_malloc_func_t mem_malloc_func, zbx_mem_realloc_func_t mem_realloc_func,
+		zbx_mem_free_func_t mem_free_func)
+{
+	size_t	slots_size = sizeof(zbx_timer_wheel_node_t *) * ZBX_TIMER_WHEEL_LEVELS * ZBX_TIMER_WHEEL_LEVEL_SLOTS;
+
+	wheel->slots = (zbx_timer_wheel_node_t **)mem_malloc_func(NULL, slots_size);
+	memset(wheel->slots, 0, slots_size);
+	memset(wheel->levels_num, 0, sizeof(wheel->levels_num));
+	wheel->time = 0;
+
+	zbx_hashset_create_ext(&wheel->nodes, 0, ZBX_DEFAULT_UINT64_HASH_FUNC, ZBX_DEFAULT_UINT64_COMPARE_FUNC, NULL,
+			mem_malloc_func, mem_realloc_func, mem_free_func);
+	zbx_binary_heap_create_ext(&wheel->due, compare_func, ZBX_BINARY_HEAP_OPTION_DIRECT, mem_malloc_func,
+			mem_realloc_func, mem_free_func);
+
+	wheel->mem_malloc_func = mem_malloc_func;
+	wheel->mem_realloc_func = mem_realloc_func;
+	wheel->mem_free_func = mem_free_func;
+}
+
+void	zbx_timer_wheel_destroy(zbx_timer_wheel_t *wheel)
+{
+	zbx_binary_heap_destroy(&wheel->due);
+	zbx_hashset_destroy(&wheel->nodes);
+	wheel->mem_free_func(wheel->slots);
+	wheel->slots = NULL;
+}
+
+int	zbx_timer_wheel_empty(const zbx_timer_wheel_t *wheel)
+{
+	return 0 == wheel->nodes.num_data ? SUCCEED : FAIL;
+}
+
+int	zbx_timer_wheel_elems_num(const zbx_timer_wheel_t *wheel)
+{
+	return wheel->nodes.num_data;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_timer_wheel_update                                           *
+ *                                                                            *
+ * Purpose: schedules element or reschedules already scheduled element        *
+ *                                                                            *
+ * Parameters: wheel - [IN] the timer wheel                                   *
+ *             key   - [IN] the element key                                   *
+ *             data  - [IN] the element data                                  *
+ *             time  - [IN] the element time                                  *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_timer_wheel_update(zbx_timer_wheel_t *wheel, zbx_uint64_t key, const void *data, int time)
+{
+	zbx_timer_wheel_node_t	*node, node_local;
+
+	if (NULL == (node = (zbx_timer_wheel_node_t *)zbx_hashset_search(&wheel->nodes, &key)))
+	{
+		node_local.key = key;
+		node = (zbx_timer_wheel_node_t *)zbx_hashset_insert(&wheel->nodes, &node_local, sizeof(node_local));
+	}
+	else
+		timer_wheel_unlink(wheel, node);
+
+	node->data = data;
+	node->time = time;
+
+	timer_wheel_link(wheel, node);
+}
+
+void	zbx_timer_wheel_remove(zbx_timer_wheel_t *wheel, zbx_uint64_t key)
+{
+	zbx_timer_wheel_node_t	*node;
+
+	if (NULL == (node = (zbx_timer_wheel_node_t *)zbx_hashset_search(&wheel->nodes, &key)))
+		return;
+
+	timer_wheel_unlink(wheel, node);
+	zbx_hashset_remove_direct(&wheel->nodes, node);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_timer_wheel_find_min                                         *
+ *                                                                            *
+ * Purpose: gets the first due element                                        *
+ *                                                                            *
+ * Parameters: wheel - [IN] the timer wheel                                   *
+ *             now   - [IN] the current time                                  *
+ *                                                                            *
+ * Return value: the first element scheduled at or before the current time,   *
+ *               NULL if there are no such elements                           *
+ *                                                                            *
+ * Comments: The returned element can also be scheduled shortly after the     *
+ *           current time, so the caller must check its time.                 *
+ *                                                                            *
+ ******************************************************************************/
+zbx_binary_heap_elem_t	*zbx_timer_wheel_find_min(zbx_timer_wheel_t *wheel, int now)
+{
+	timer_wheel_advance(wheel, now);
+
+	if (SUCCEED == zbx_binary_heap_empty(&wheel->due))
+		return NULL;
+
+	return zbx_binary_heap_find_min(&wheel->due);
+}
+
+void	zbx_timer_wheel_remove_min(zbx_timer_wheel_t *wheel)
+{
+	zbx_binary_heap_elem_t	*min;
+	zbx_timer_wheel_node_t	*node;
+
+	min = zbx_binary_heap_find_min(&wheel->due);
+	node = (zbx_timer_wheel_node_t *)zbx_hashset_search(&wheel->nodes, &min->key);
+
+	zbx_binary_heap_remove_min(&wheel->due);
+	zbx_hashset_remove_direct(&wheel->nodes, node);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_timer_wheel_nextcheck                                        *
+ *                                                                            *
+ * Purpose: gets the time of the first scheduled element                      *
+ *                                                                            *
+ * Return value: the time of the first element or FAIL if the wheel is empty  *
+ *                                                                            *
+ * Comments: For elements scheduled beyond the current level 0 range the      *
+ *           start of their slot is returned, which is never later than the   *
+ *           element time.                                                    *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_timer_wheel_nextcheck(const zbx_timer_wheel_t *wheel)
+{
+	int	level, digit;
+
+	if (FAIL == zbx_binary_heap_empty((zbx_binary_heap_t *)&wheel->due))
+	{
+		const zbx_binary_heap_elem_t	*min;
+		const zbx_timer_wheel_node_t	*node;
+
+		min = zbx_binary_heap_find_min((zbx_binary_heap_t *)&wheel->due);
+		node = (const zbx_timer_wheel_node_t *)zbx_hashset_search((zbx_hashset_t *)&wheel->nodes, &min->key);
+
+		return node->time;
+	}
+
+	for (level = 0; level < ZBX_TIMER_WHEEL_LEVELS; level++)
+	{
+		if (0 == wheel->levels_num[level])
+			continue;
+
+		/* level 0 elements can be in the current slot, higher level elements are in the following slots */
+		for (digit = TW_DIGIT(wheel->time, level) + (0 == level ? 0 : 1); digit < ZBX_TIMER_WHEEL_LEVEL_SLOTS;
+				digit++)
+		{
+			if (NULL != wheel->slots[level * ZBX_TIMER_WHEEL_LEVEL_SLOTS + digit])
+			{
+				return (int)((TW_PREFIX(wheel->time, level) << TW_SHIFT(level + 1)) |
+						((zbx_uint64_t)digit << TW_SHIFT(level)));
+			}
+		}
+	}
+
+	THIS_SHOULD_NEVER_HAPPEN;
+
+	return FAIL;
+}
@@ -1423,6 +1423,12 @@ const char	*get_process_type_string(unsigned char proc_type)
 			return "service manager";
 		case ZBX_PROCESS_TYPE_PROBLEMHOUSEKEEPER:
 			return "problem housekeeper";
+		case ZBX_PROCESS_TYPE_AGENT_POLLER:
+			return "agent poller";
+		case ZBX_PROCESS_TYPE_SNMP_POLLER:
+			return "snmp poller";
+		case ZBX_PROCESS_TYPE_HTTPAGENT_POLLER:
+			return "http agent poller";
 	}
 
 	THIS_SHOULD_NEVER_HAPPEN;
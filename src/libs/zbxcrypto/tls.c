@@ -3255,69 +3255,36 @@ void	zbx_tls_free(void)
 #endif
 }
 
+#if defined(HAVE_GNUTLS)
 /******************************************************************************
  *                                                                            *
- * Function: zbx_tls_connect                                                  *
+ * Function: zbx_tls_client_init                                              *
  *                                                                            *
- * Purpose: establish a TLS connection over an established TCP connection     *
+ * Purpose: set up TLS client session with certificate or PSK credentials     *
+ *          over a connected socket                                           *
  *                                                                            *
- * Parameters:                                                                *
- *     s           - [IN] socket with opened connection                       *
- *     error       - [OUT] dynamically allocated memory with error message    *
- *     tls_connect - [IN] how to connect. Allowed values:                     *
- *                        ZBX_TCP_SEC_TLS_CERT, ZBX_TCP_SEC_TLS_PSK.          *
- *     tls_arg1    - [IN] required issuer of peer certificate (may be NULL    *
- *                        or empty string if not important) or PSK identity   *
- *                        to connect with depending on value of               *
- *                        'tls_connect'.                                      *
- *     tls_arg2    - [IN] required subject of peer certificate (may be NULL   *
- *                        or empty string if not important) or PSK            *
- *                        (in hex-string) to connect with depending on value  *
- *                        of 'tls_connect'.                                   *
+ * Parameters: tls_ctx     - [IN/OUT] TLS context with empty session          *
+ *             fd          - [IN] socket with opened connection               *
+ *             tls_connect - [IN] ZBX_TCP_SEC_TLS_CERT or ZBX_TCP_SEC_TLS_PSK *
+ *             tls_arg1    - [IN] see zbx_tls_connect()                       *
+ *             tls_arg2    - [IN] see zbx_tls_connect()                       *
+ *             error       - [OUT] dynamically allocated error message        *
  *                                                                            *
- * Return value:                                                              *
- *     SUCCEED - successful TLS handshake with a valid certificate or PSK     *
- *     FAIL - an error occurred                                               *
+ * Return value: SUCCEED - session is ready for handshake                     *
+ *               FAIL    - an error occurred, the caller releases session     *
  *                                                                            *
  ******************************************************************************/
-#if defined(HAVE_GNUTLS)
-int	zbx_tls_connect(zbx_socket_t *s, unsigned int tls_connect, const char *tls_arg1, const char *tls_arg2,
-		char **error)
+static int	zbx_tls_client_init(zbx_tls_context_t *tls_ctx, ZBX_SOCKET fd, unsigned int tls_connect,
+		const char *tls_arg1, const char *tls_arg2, char **error)
 {
-	int	ret = FAIL, res;
-#if defined(_WINDOWS)
-	double	sec;
-#endif
-
-	if (ZBX_TCP_SEC_TLS_CERT == tls_connect)
-	{
-		zabbix_log(LOG_LEVEL_DEBUG, "In %s(): issuer:\"%s\" subject:\"%s\"", __func__,
-				ZBX_NULL2EMPTY_STR(tls_arg1), ZBX_NULL2EMPTY_STR(tls_arg2));
-	}
-	else if (ZBX_TCP_SEC_TLS_PSK == tls_connect)
-	{
-		zabbix_log(LOG_LEVEL_DEBUG, "In %s(): psk_identity:\"%s\"", __func__, ZBX_NULL2EMPTY_STR(tls_arg1));
-	}
-	else
-	{
-		*error = zbx_strdup(*error, "invalid connection parameters");
-		THIS_SHOULD_NEVER_HAPPEN;
-		goto out1;
-	}
-
-	/* set up TLS context */
-
-	s->tls_ctx = zbx_malloc(s->tls_ctx, sizeof(zbx_tls_context_t));
-	s->tls_ctx->ctx = NULL;
-	s->tls_ctx->psk_client_creds = NULL;
-	s->tls_ctx->psk_server_creds = NULL;
+	int	res;
 
-	if (GNUTLS_E_SUCCESS != (res = gnutls_init(&s->tls_ctx->ctx, GNUTLS_CLIENT | GNUTLS_NO_EXTENSIONS)))
+	if (GNUTLS_E_SUCCESS != (res = gnutls_init(&tls_ctx->ctx, GNUTLS_CLIENT | GNUTLS_NO_EXTENSIONS)))
 			/* GNUTLS_NO_EXTENSIONS is used because we do not currently support extensions (e.g. session */
 			/* tickets and OCSP) */
 	{
 		*error = zbx_dsprintf(*error, "gnutls_init() failed: %d %s", res, gnutls_strerror(res));
-		goto out;
+		return FAIL;
 	}
 
 	if (ZBX_TCP_SEC_TLS_CERT == tls_connect)
@@ -3326,22 +3293,22 @@ int	zbx_tls_connect(zbx_socket_t *s, unsigned int tls_connect, const char *tls_a
 		{
 			*error = zbx_strdup(*error, "cannot connect with TLS and certificate: no valid certificate"
 					" loaded");
-			goto out;
+			return FAIL;
 		}
 
-		if (GNUTLS_E_SUCCESS != (res = gnutls_priority_set(s->tls_ctx->ctx, ciphersuites_cert)))
+		if (GNUTLS_E_SUCCESS != (res = gnutls_priority_set(tls_ctx->ctx, ciphersuites_cert)))
 		{
 			*error = zbx_dsprintf(*error, "gnutls_priority_set() for 'ciphersuites_cert' failed: %d %s",
 					res, gnutls_strerror(res));
-			goto out;
+			return FAIL;
 		}
 
-		if (GNUTLS_E_SUCCESS != (res = gnutls_credentials_set(s->tls_ctx->ctx, GNUTLS_CRD_CERTIFICATE,
+		if (GNUTLS_E_SUCCESS != (res = gnutls_credentials_set(tls_ctx->ctx, GNUTLS_CRD_CERTIFICATE,
 				my_cert_creds)))
 		{
 			*error = zbx_dsprintf(*error, "gnutls_credentials_set() for certificate failed: %d %s", res,
 					gnutls_strerror(res));
-			goto out;
+			return FAIL;
 		}
 	}
 	else	/* use a pre-shared key */
@@ -3349,14 +3316,14 @@ int	zbx_tls_connect(zbx_socket_t *s, unsigned int tls_connect, const char *tls_a
 		if (NULL == ciphersuites_psk)
 		{
 			*error = zbx_strdup(*error, "cannot connect with TLS and PSK: no valid PSK loaded");
-			goto out;
+			return FAIL;
 		}
 
-		if (GNUTLS_E_SUCCESS != (res = gnutls_priority_set(s->tls_ctx->ctx, ciphersuites_psk)))
+		if (GNUTLS_E_SUCCESS != (res = gnutls_priority_set(tls_ctx->ctx, ciphersuites_psk)))
 		{
 			*error = zbx_dsprintf(*error, "gnutls_priority_set() for 'ciphersuites_psk' failed: %d %s", res,
 					gnutls_strerror(res));
-			goto out;
+			return FAIL;
 		}
 
 		if (NULL == tls_arg2)	/* PSK is not set from DB */
@@ -3364,12 +3331,12 @@ int	zbx_tls_connect(zbx_socket_t *s, unsigned int tls_connect, const char *tls_a
 			/* set up the PSK from a configuration file (always in agentd and a case in active proxy */
 			/* when it connects to server) */
 
-			if (GNUTLS_E_SUCCESS != (res = gnutls_credentials_set(s->tls_ctx->ctx, GNUTLS_CRD_PSK,
+			if (GNUTLS_E_SUCCESS != (res = gnutls_credentials_set(tls_ctx->ctx, GNUTLS_CRD_PSK,
 					my_psk_client_creds)))
 			{
 				*error = zbx_dsprintf(*error, "gnutls_credentials_set() for psk failed: %d %s", res,
 						gnutls_strerror(res));
-				goto out;
+				return FAIL;
 			}
 		}
 		else
@@ -3384,35 +3351,35 @@ int	zbx_tls_connect(zbx_socket_t *s, unsigned int tls_connect, const char *tls_a
 			if (0 >= (psk_len = zbx_psk_hex2bin((const unsigned char *)tls_arg2, psk_buf, sizeof(psk_buf))))
 			{
 				*error = zbx_strdup(*error, "invalid PSK");
-				goto out;
+				return FAIL;
 			}
 
 			if (GNUTLS_E_SUCCESS != (res = gnutls_psk_allocate_client_credentials(
-					&s->tls_ctx->psk_client_creds)))
+					&tls_ctx->psk_client_creds)))
 			{
 				*error = zbx_dsprintf(*error, "gnutls_psk_allocate_client_credentials() failed: %d %s",
 						res, gnutls_strerror(res));
-				goto out;
+				return FAIL;
 			}
 
 			key.data = psk_buf;
 			key.size = (unsigned int)psk_len;
 
 			/* Simplified. 'tls_arg1' (PSK identity) should have been prepared as required by RFC 4518. */
-			if (GNUTLS_E_SUCCESS != (res = gnutls_psk_set_client_credentials(s->tls_ctx->psk_client_creds,
+			if (GNUTLS_E_SUCCESS != (res = gnutls_psk_set_client_credentials(tls_ctx->psk_client_creds,
 					tls_arg1, &key, GNUTLS_PSK_KEY_RAW)))
 			{
 				*error = zbx_dsprintf(*error, "gnutls_psk_set_client_credentials() failed: %d %s", res,
 						gnutls_strerror(res));
-				goto out;
+				return FAIL;
 			}
 
-			if (GNUTLS_E_SUCCESS != (res = gnutls_credentials_set(s->tls_ctx->ctx, GNUTLS_CRD_PSK,
-					s->tls_ctx->psk_client_creds)))
+			if (GNUTLS_E_SUCCESS != (res = gnutls_credentials_set(tls_ctx->ctx, GNUTLS_CRD_PSK,
+					tls_ctx->psk_client_creds)))
 			{
 				*error = zbx_dsprintf(*error, "gnutls_credentials_set() for psk failed: %d %s", res,
 						gnutls_strerror(res));
-				goto out;
+				return FAIL;
 			}
 		}
 	}
@@ -3432,7 +3399,350 @@ int	zbx_tls_connect(zbx_socket_t *s, unsigned int tls_connect, const char *tls_a
 	/* set our own callback function to log issues into Zabbix log */
 	gnutls_global_set_audit_log_function(zbx_gnutls_audit_cb);
 
-	gnutls_transport_set_int(s->tls_ctx->ctx, ZBX_SOCKET_TO_INT(s->socket));
+	gnutls_transport_set_int(tls_ctx->ctx, ZBX_SOCKET_TO_INT(fd));
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_tls_handshake_result                                         *
+ *                                                                            *
+ * Purpose: check whether client handshake can continue after error           *
+ *                                                                            *
+ * Parameters: func    - [IN] name of the calling function                    *
+ *             session - [IN] TLS session                                     *
+ *             res     - [IN] value returned by gnutls_handshake()            *
+ *             error   - [OUT] dynamically allocated error message            *
+ *                                                                            *
+ * Return value: SUCCEED - handshake can be continued                         *
+ *               FAIL    - handshake failed                                   *
+ *                                                                            *
+ ******************************************************************************/
+static int	zbx_tls_handshake_result(const char *func, gnutls_session_t session, int res, char **error)
+{
+	if (GNUTLS_E_WARNING_ALERT_RECEIVED == res || GNUTLS_E_FATAL_ALERT_RECEIVED == res)
+	{
+		const char	*msg;
+		int		alert;
+
+		/* server sent an alert to us */
+		alert = gnutls_alert_get(session);
+
+		if (NULL == (msg = gnutls_alert_get_name(alert)))
+			msg = "unknown";
+
+		if (GNUTLS_E_WARNING_ALERT_RECEIVED == res)
+		{
+			zabbix_log(LOG_LEVEL_WARNING, "%s() gnutls_handshake() received a warning alert: %d %s",
+					func, alert, msg);
+			return SUCCEED;
+		}
+
+		/* GNUTLS_E_FATAL_ALERT_RECEIVED */
+		*error = zbx_dsprintf(*error, "%s(): gnutls_handshake() failed with fatal alert: %d %s", func, alert,
+				msg);
+		return FAIL;
+	}
+	else
+	{
+		int	level;
+
+		/* log "peer has closed connection" case with debug level */
+		level = (GNUTLS_E_PREMATURE_TERMINATION == res ? LOG_LEVEL_DEBUG : LOG_LEVEL_WARNING);
+
+		if (SUCCEED == ZBX_CHECK_LOG_LEVEL(level))
+			zabbix_log(level, "%s() gnutls_handshake() returned: %d %s", func, res, gnutls_strerror(res));
+
+		if (0 != gnutls_error_is_fatal(res))
+		{
+			*error = zbx_dsprintf(*error, "%s(): gnutls_handshake() failed: %d %s", func, res,
+					gnutls_strerror(res));
+			return FAIL;
+		}
+	}
+
+	return SUCCEED;
+}
+#elif defined(HAVE_OPENSSL)
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_tls_client_init                                              *
+ *                                                                            *
+ * Purpose: set up TLS client connection context with certificate or PSK      *
+ *          ciphersuites over a connected socket                              *
+ *                                                                            *
+ * Parameters: tls_ctx     - [IN/OUT] TLS context with empty connection       *
+ *             fd          - [IN] socket with opened connection               *
+ *             tls_connect - [IN] ZBX_TCP_SEC_TLS_CERT or ZBX_TCP_SEC_TLS_PSK *
+ *             error       - [OUT] dynamically allocated error message        *
+ *                                                                            *
+ * Return value: SUCCEED - connection is ready for handshake                  *
+ *               FAIL    - an error occurred, the caller releases connection  *
+ *                                                                            *
+ ******************************************************************************/
+static int	zbx_tls_client_init(zbx_tls_context_t *tls_ctx, ZBX_SOCKET fd, unsigned int tls_connect,
+		char **error)
+{
+	size_t	error_alloc = 0, error_offset = 0;
+
+	if (ZBX_TCP_SEC_TLS_CERT == tls_connect)
+	{
+		if (NULL == ctx_cert)
+		{
+			*error = zbx_strdup(*error, "cannot connect with TLS and certificate: no valid certificate"
+					" loaded");
+			return FAIL;
+		}
+
+		if (NULL == (tls_ctx->ctx = SSL_new(ctx_cert)))
+		{
+			zbx_snprintf_alloc(error, &error_alloc, &error_offset, "cannot create connection context:");
+			zbx_tls_error_msg(error, &error_alloc, &error_offset);
+			return FAIL;
+		}
+	}
+	else
+	{
+#if defined(HAVE_OPENSSL_WITH_PSK)
+		if (NULL == ctx_psk)
+		{
+			*error = zbx_strdup(*error, "cannot connect with TLS and PSK: no valid PSK loaded");
+			return FAIL;
+		}
+
+		if (NULL == (tls_ctx->ctx = SSL_new(ctx_psk)))
+		{
+			zbx_snprintf_alloc(error, &error_alloc, &error_offset, "cannot create connection context:");
+			zbx_tls_error_msg(error, &error_alloc, &error_offset);
+			return FAIL;
+		}
+#else
+		*error = zbx_strdup(*error, "cannot connect with TLS and PSK: support for PSK was not compiled in");
+		return FAIL;
+#endif
+	}
+
+	/* set our connected TCP socket to TLS context */
+	if (1 != SSL_set_fd(tls_ctx->ctx, fd))
+	{
+		*error = zbx_strdup(*error, "cannot set socket for TLS context");
+		return FAIL;
+	}
+
+	return SUCCEED;
+}
+
+#if defined(HAVE_OPENSSL_WITH_PSK)
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_psk_client_prepare                                           *
+ *                                                                            *
+ * Purpose: set up PSK global variables for zbx_psk_client_cb()               *
+ *                                                                            *
+ * Parameters: tls_arg1    - [IN] PSK identity                                *
+ *             tls_arg2    - [IN] PSK (in hex-string) or NULL if PSK is not   *
+ *                                set from DB                                 *
+ *             psk_buf     - [OUT] buffer for binary PSK                      *
+ *             psk_buf_len - [IN] size of 'psk_buf'                           *
+ *             error       - [OUT] dynamically allocated error message        *
+ *                                                                            *
+ * Return value: SUCCEED - PSK is set                                         *
+ *               FAIL    - invalid PSK                                        *
+ *                                                                            *
+ * Comments: The variables point to 'tls_arg1' and 'psk_buf', they must stay  *
+ *           available until the handshake step calling the callback returns. *
+ *                                                                            *
+ ******************************************************************************/
+static int	zbx_psk_client_prepare(const char *tls_arg1, const char *tls_arg2, char *psk_buf, int psk_buf_len,
+		char **error)
+{
+	int	psk_len;
+
+	if (NULL == tls_arg2)	/* PSK is not set from DB */
+	{
+		/* Set up PSK global variables from a configuration file (always in agentd and a case when */
+		/* active proxy connects to server). Here we set it only in case of active proxy */
+		/* because for other programs it has already been set in zbx_tls_init_child(). */
+
+		if (0 != (program_type & ZBX_PROGRAM_TYPE_PROXY_ACTIVE))
+		{
+			psk_identity_for_cb = my_psk_identity;
+			psk_identity_len_for_cb = my_psk_identity_len;
+			psk_for_cb = my_psk;
+			psk_len_for_cb = my_psk_len;
+		}
+
+		return SUCCEED;
+	}
+
+	/* PSK comes from a database (case for a server/proxy when it connects to an agent for */
+	/* passive checks, for a server when it connects to a passive proxy) */
+
+	if (0 >= (psk_len = zbx_psk_hex2bin((const unsigned char *)tls_arg2, (unsigned char *)psk_buf, psk_buf_len)))
+	{
+		*error = zbx_strdup(*error, "invalid PSK");
+		return FAIL;
+	}
+
+	/* some data reside in stack but it will be available at the time when a PSK client callback */
+	/* function copies the data into buffers provided by OpenSSL within the callback */
+	psk_identity_for_cb = tls_arg1;			/* string is on stack */
+	/* NULL check to silence analyzer warning */
+	psk_identity_len_for_cb = (NULL == tls_arg1 ? 0 : strlen(tls_arg1));
+	psk_for_cb = psk_buf;				/* buffer is on stack */
+	psk_len_for_cb = (size_t)psk_len;
+
+	return SUCCEED;
+}
+#endif
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_tls_connect_error                                            *
+ *                                                                            *
+ * Purpose: describe failed SSL_connect() call                                *
+ *                                                                            *
+ * Parameters: tls_ctx     - [IN] TLS context                                 *
+ *             tls_connect - [IN] ZBX_TCP_SEC_TLS_CERT or ZBX_TCP_SEC_TLS_PSK *
+ *             res         - [IN] value returned by SSL_connect()             *
+ *             result_code - [IN] value returned by SSL_get_error()           *
+ *             error       - [OUT] dynamically allocated error message        *
+ *                                                                            *
+ * Return value: SUCCEED - handshake has been successful                      *
+ *               FAIL    - handshake failed                                   *
+ *                                                                            *
+ ******************************************************************************/
+static int	zbx_tls_connect_error(const zbx_tls_context_t *tls_ctx, unsigned int tls_connect, int res,
+		int result_code, char **error)
+{
+	size_t	error_alloc = 0, error_offset = 0;
+
+	if (ZBX_TCP_SEC_TLS_CERT == tls_connect)
+	{
+		long	verify_result;
+
+		/* In case of certificate error SSL_get_verify_result() provides more helpful diagnostics */
+		/* than other methods. Include it as first but continue with other diagnostics. */
+		if (X509_V_OK != (verify_result = SSL_get_verify_result(tls_ctx->ctx)))
+		{
+			zbx_snprintf_alloc(error, &error_alloc, &error_offset, "%s: ",
+					X509_verify_cert_error_string(verify_result));
+		}
+	}
+
+	switch (result_code)
+	{
+		case SSL_ERROR_NONE:		/* handshake successful */
+			return SUCCEED;
+		case SSL_ERROR_ZERO_RETURN:
+			zbx_snprintf_alloc(error, &error_alloc, &error_offset,
+					"TLS connection has been closed during handshake");
+			break;
+		case SSL_ERROR_SYSCALL:
+			if (0 == ERR_peek_error())
+			{
+				if (0 == res)
+				{
+					zbx_snprintf_alloc(error, &error_alloc, &error_offset, "connection closed by peer");
+				}
+				else if (-1 == res)
+				{
+					zbx_snprintf_alloc(error, &error_alloc, &error_offset, "SSL_connect() I/O error: %s",
+							strerror_from_system(zbx_socket_last_error()));
+				}
+				else
+				{
+					/* "man SSL_get_error" describes only res == 0 and res == -1 for */
+					/* SSL_ERROR_SYSCALL case */
+					zbx_snprintf_alloc(error, &error_alloc, &error_offset, "SSL_connect() returned"
+							" undocumented code %d", res);
+				}
+			}
+			else
+			{
+				zbx_snprintf_alloc(error, &error_alloc, &error_offset, "SSL_connect() set result code"
+						" to SSL_ERROR_SYSCALL:");
+				zbx_tls_error_msg(error, &error_alloc, &error_offset);
+				zbx_snprintf_alloc(error, &error_alloc, &error_offset, "%s", info_buf);
+			}
+			break;
+		case SSL_ERROR_SSL:
+			zbx_snprintf_alloc(error, &error_alloc, &error_offset, "SSL_connect() set result code to"
+					" SSL_ERROR_SSL:");
+			zbx_tls_error_msg(error, &error_alloc, &error_offset);
+			zbx_snprintf_alloc(error, &error_alloc, &error_offset, "%s", info_buf);
+			break;
+		default:
+			zbx_snprintf_alloc(error, &error_alloc, &error_offset, "SSL_connect() set result code to %d",
+					result_code);
+			zbx_tls_error_msg(error, &error_alloc, &error_offset);
+			zbx_snprintf_alloc(error, &error_alloc, &error_offset, "%s", info_buf);
+	}
+
+	return FAIL;
+}
+#endif
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_tls_connect                                                  *
+ *                                                                            *
+ * Purpose: establish a TLS connection over an established TCP connection     *
+ *                                                                            *
+ * Parameters:                                                                *
+ *     s           - [IN] socket with opened connection                       *
+ *     error       - [OUT] dynamically allocated memory with error message    *
+ *     tls_connect - [IN] how to connect. Allowed values:                     *
+ *                        ZBX_TCP_SEC_TLS_CERT, ZBX_TCP_SEC_TLS_PSK.          *
+ *     tls_arg1    - [IN] required issuer of peer certificate (may be NULL    *
+ *                        or empty string if not important) or PSK identity   *
+ *                        to connect with depending on value of               *
+ *                        'tls_connect'.                                      *
+ *     tls_arg2    - [IN] required subject of peer certificate (may be NULL   *
+ *                        or empty string if not important) or PSK            *
+ *                        (in hex-string) to connect with depending on value  *
+ *                        of 'tls_connect'.                                   *
+ *                                                                            *
+ * Return value:                                                              *
+ *     SUCCEED - successful TLS handshake with a valid certificate or PSK     *
+ *     FAIL - an error occurred                                               *
+ *                                                                            *
+ ******************************************************************************/
+#if defined(HAVE_GNUTLS)
+int	zbx_tls_connect(zbx_socket_t *s, unsigned int tls_connect, const char *tls_arg1, const char *tls_arg2,
+		char **error)
+{
+	int	ret = FAIL, res;
+#if defined(_WINDOWS)
+	double	sec;
+#endif
+
+	if (ZBX_TCP_SEC_TLS_CERT == tls_connect)
+	{
+		zabbix_log(LOG_LEVEL_DEBUG, "In %s(): issuer:\"%s\" subject:\"%s\"", __func__,
+				ZBX_NULL2EMPTY_STR(tls_arg1), ZBX_NULL2EMPTY_STR(tls_arg2));
+	}
+	else if (ZBX_TCP_SEC_TLS_PSK == tls_connect)
+	{
+		zabbix_log(LOG_LEVEL_DEBUG, "In %s(): psk_identity:\"%s\"", __func__, ZBX_NULL2EMPTY_STR(tls_arg1));
+	}
+	else
+	{
+		*error = zbx_strdup(*error, "invalid connection parameters");
+		THIS_SHOULD_NEVER_HAPPEN;
+		goto out1;
+	}
+
+	/* set up TLS context */
+
+	s->tls_ctx = zbx_malloc(s->tls_ctx, sizeof(zbx_tls_context_t));
+	s->tls_ctx->ctx = NULL;
+	s->tls_ctx->psk_client_creds = NULL;
+	s->tls_ctx->psk_server_creds = NULL;
+
+	if (SUCCEED != zbx_tls_client_init(s->tls_ctx, s->socket, tls_connect, tls_arg1, tls_arg2, error))
+		goto out;
 
 	/* TLS handshake */
 
@@ -3453,53 +3763,10 @@ int	zbx_tls_connect(zbx_socket_t *s, unsigned int tls_connect, const char *tls_a
 		}
 
 		if (GNUTLS_E_INTERRUPTED == res || GNUTLS_E_AGAIN == res)
-		{
 			continue;
-		}
-		else if (GNUTLS_E_WARNING_ALERT_RECEIVED == res || GNUTLS_E_FATAL_ALERT_RECEIVED == res)
-		{
-			const char	*msg;
-			int		alert;
-
-			/* server sent an alert to us */
-			alert = gnutls_alert_get(s->tls_ctx->ctx);
-
-			if (NULL == (msg = gnutls_alert_get_name(alert)))
-				msg = "unknown";
-
-			if (GNUTLS_E_WARNING_ALERT_RECEIVED == res)
-			{
-				zabbix_log(LOG_LEVEL_WARNING, "%s() gnutls_handshake() received a warning alert: %d %s",
-						__func__, alert, msg);
-				continue;
-			}
-			else	/* GNUTLS_E_FATAL_ALERT_RECEIVED */
-			{
-				*error = zbx_dsprintf(*error, "%s(): gnutls_handshake() failed with fatal alert: %d %s",
-						__func__, alert, msg);
-				goto out;
-			}
-		}
-		else
-		{
-			int	level;
 
-			/* log "peer has closed connection" case with debug level */
-			level = (GNUTLS_E_PREMATURE_TERMINATION == res ? LOG_LEVEL_DEBUG : LOG_LEVEL_WARNING);
-
-			if (SUCCEED == ZBX_CHECK_LOG_LEVEL(level))
-			{
-				zabbix_log(level, "%s() gnutls_handshake() returned: %d %s",
-						__func__, res, gnutls_strerror(res));
-			}
-
-			if (0 != gnutls_error_is_fatal(res))
-			{
-				*error = zbx_dsprintf(*error, "%s(): gnutls_handshake() failed: %d %s",
-						__func__, res, gnutls_strerror(res));
-				goto out;
-			}
-		}
+		if (SUCCEED != zbx_tls_handshake_result(__func__, s->tls_ctx->ctx, res, error))
+			goto out;
 	}
 
 	if (ZBX_TCP_SEC_TLS_CERT == tls_connect)
@@ -3561,87 +3828,15 @@ int	zbx_tls_connect(zbx_socket_t *s, unsigned int tls_connect, const char *tls_a
 #if defined(HAVE_OPENSSL_WITH_PSK)
 	char	psk_buf[HOST_TLS_PSK_LEN / 2];
 #endif
-
-	s->tls_ctx = zbx_malloc(s->tls_ctx, sizeof(zbx_tls_context_t));
-	s->tls_ctx->ctx = NULL;
-
-	if (ZBX_TCP_SEC_TLS_CERT == tls_connect)
-	{
-		zabbix_log(LOG_LEVEL_DEBUG, "In %s(): issuer:\"%s\" subject:\"%s\"", __func__,
-				ZBX_NULL2EMPTY_STR(tls_arg1), ZBX_NULL2EMPTY_STR(tls_arg2));
-
-		if (NULL == ctx_cert)
-		{
-			*error = zbx_strdup(*error, "cannot connect with TLS and certificate: no valid certificate"
-					" loaded");
-			goto out;
-		}
-
-		if (NULL == (s->tls_ctx->ctx = SSL_new(ctx_cert)))
-		{
-			zbx_snprintf_alloc(error, &error_alloc, &error_offset, "cannot create connection context:");
-			zbx_tls_error_msg(error, &error_alloc, &error_offset);
-			goto out;
-		}
-	}
-	else if (ZBX_TCP_SEC_TLS_PSK == tls_connect)
-	{
-		zabbix_log(LOG_LEVEL_DEBUG, "In %s(): psk_identity:\"%s\"", __func__, ZBX_NULL2EMPTY_STR(tls_arg1));
-
-#if defined(HAVE_OPENSSL_WITH_PSK)
-		if (NULL == ctx_psk)
-		{
-			*error = zbx_strdup(*error, "cannot connect with TLS and PSK: no valid PSK loaded");
-			goto out;
-		}
-
-		if (NULL == (s->tls_ctx->ctx = SSL_new(ctx_psk)))
-		{
-			zbx_snprintf_alloc(error, &error_alloc, &error_offset, "cannot create connection context:");
-			zbx_tls_error_msg(error, &error_alloc, &error_offset);
-			goto out;
-		}
-
-		if (NULL == tls_arg2)	/* PSK is not set from DB */
-		{
-			/* Set up PSK global variables from a configuration file (always in agentd and a case when */
-			/* active proxy connects to server). Here we set it only in case of active proxy */
-			/* because for other programs it has already been set in zbx_tls_init_child(). */
-
-			if (0 != (program_type & ZBX_PROGRAM_TYPE_PROXY_ACTIVE))
-			{
-				psk_identity_for_cb = my_psk_identity;
-				psk_identity_len_for_cb = my_psk_identity_len;
-				psk_for_cb = my_psk;
-				psk_len_for_cb = my_psk_len;
-			}
-		}
-		else
-		{
-			/* PSK comes from a database (case for a server/proxy when it connects to an agent for */
-			/* passive checks, for a server when it connects to a passive proxy) */
-
-			int	psk_len;
-
-			if (0 >= (psk_len = zbx_psk_hex2bin((const unsigned char *)tls_arg2, (unsigned char *)psk_buf,
-					sizeof(psk_buf))))
-			{
-				*error = zbx_strdup(*error, "invalid PSK");
-				goto out;
-			}
-
-			/* some data reside in stack but it will be available at the time when a PSK client callback */
-			/* function copies the data into buffers provided by OpenSSL within the callback */
-			psk_identity_for_cb = tls_arg1;			/* string is on stack */
-			/* NULL check to silence analyzer warning */
-			psk_identity_len_for_cb = (NULL == tls_arg1 ? 0 : strlen(tls_arg1));
-			psk_for_cb = psk_buf;				/* buffer is on stack */
-			psk_len_for_cb = (size_t)psk_len;
-		}
-#else
-		*error = zbx_strdup(*error, "cannot connect with TLS and PSK: support for PSK was not compiled in");
-		goto out;
-#endif
+
+	if (ZBX_TCP_SEC_TLS_CERT == tls_connect)
+	{
+		zabbix_log(LOG_LEVEL_DEBUG, "In %s(): issuer:\"%s\" subject:\"%s\"", __func__,
+				ZBX_NULL2EMPTY_STR(tls_arg1), ZBX_NULL2EMPTY_STR(tls_arg2));
+	}
+	else if (ZBX_TCP_SEC_TLS_PSK == tls_connect)
+	{
+		zabbix_log(LOG_LEVEL_DEBUG, "In %s(): psk_identity:\"%s\"", __func__, ZBX_NULL2EMPTY_STR(tls_arg1));
 	}
 	else
 	{
@@ -3650,13 +3845,18 @@ int	zbx_tls_connect(zbx_socket_t *s, unsigned int tls_connect, const char *tls_a
 		goto out1;
 	}
 
-	/* set our connected TCP socket to TLS context */
-	if (1 != SSL_set_fd(s->tls_ctx->ctx, s->socket))
+	s->tls_ctx = zbx_malloc(s->tls_ctx, sizeof(zbx_tls_context_t));
+	s->tls_ctx->ctx = NULL;
+
+	if (SUCCEED != zbx_tls_client_init(s->tls_ctx, s->socket, tls_connect, error))
+		goto out;
+#if defined(HAVE_OPENSSL_WITH_PSK)
+	if (ZBX_TCP_SEC_TLS_PSK == tls_connect && SUCCEED != zbx_psk_client_prepare(tls_arg1, tls_arg2, psk_buf,
+			sizeof(psk_buf), error))
 	{
-		*error = zbx_strdup(*error, "cannot set socket for TLS context");
 		goto out;
 	}
-
+#endif
 	/* TLS handshake */
 
 	info_buf[0] = '\0';	/* empty buffer for zbx_openssl_info_cb() messages */
@@ -3666,8 +3866,6 @@ int	zbx_tls_connect(zbx_socket_t *s, unsigned int tls_connect, const char *tls_a
 #endif
 	if (1 != (res = SSL_connect(s->tls_ctx->ctx)))
 	{
-		int	result_code;
-
 #if defined(_WINDOWS)
 		if (s->timeout < zbx_time() - sec)
 			zbx_alarm_flag_set();
@@ -3678,71 +3876,10 @@ int	zbx_tls_connect(zbx_socket_t *s, unsigned int tls_connect, const char *tls_a
 			goto out;
 		}
 
-		if (ZBX_TCP_SEC_TLS_CERT == tls_connect)
-		{
-			long	verify_result;
-
-			/* In case of certificate error SSL_get_verify_result() provides more helpful diagnostics */
-			/* than other methods. Include it as first but continue with other diagnostics. */
-			if (X509_V_OK != (verify_result = SSL_get_verify_result(s->tls_ctx->ctx)))
-			{
-				zbx_snprintf_alloc(error, &error_alloc, &error_offset, "%s: ",
-						X509_verify_cert_error_string(verify_result));
-			}
-		}
-
-		result_code = SSL_get_error(s->tls_ctx->ctx, res);
-
-		switch (result_code)
+		if (SUCCEED != zbx_tls_connect_error(s->tls_ctx, tls_connect, res, SSL_get_error(s->tls_ctx->ctx, res),
+				error))
 		{
-			case SSL_ERROR_NONE:		/* handshake successful */
-				break;
-			case SSL_ERROR_ZERO_RETURN:
-				zbx_snprintf_alloc(error, &error_alloc, &error_offset,
-						"TLS connection has been closed during handshake");
-				goto out;
-			case SSL_ERROR_SYSCALL:
-				if (0 == ERR_peek_error())
-				{
-					if (0 == res)
-					{
-						zbx_snprintf_alloc(error, &error_alloc, &error_offset,
-								"connection closed by peer");
-					}
-					else if (-1 == res)
-					{
-						zbx_snprintf_alloc(error, &error_alloc, &error_offset, "SSL_connect()"
-								" I/O error: %s",
-								strerror_from_system(zbx_socket_last_error()));
-					}
-					else
-					{
-						/* "man SSL_get_error" describes only res == 0 and res == -1 for */
-						/* SSL_ERROR_SYSCALL case */
-						zbx_snprintf_alloc(error, &error_alloc, &error_offset, "SSL_connect()"
-								" returned undocumented code %d", res);
-					}
-				}
-				else
-				{
-					zbx_snprintf_alloc(error, &error_alloc, &error_offset, "SSL_connect() set"
-							" result code to SSL_ERROR_SYSCALL:");
-					zbx_tls_error_msg(error, &error_alloc, &error_offset);
-					zbx_snprintf_alloc(error, &error_alloc, &error_offset, "%s", info_buf);
-				}
-				goto out;
-			case SSL_ERROR_SSL:
-				zbx_snprintf_alloc(error, &error_alloc, &error_offset, "SSL_connect() set"
-						" result code to SSL_ERROR_SSL:");
-				zbx_tls_error_msg(error, &error_alloc, &error_offset);
-				zbx_snprintf_alloc(error, &error_alloc, &error_offset, "%s", info_buf);
-				goto out;
-			default:
-				zbx_snprintf_alloc(error, &error_alloc, &error_offset, "SSL_connect() set result code"
-						" to %d", result_code);
-				zbx_tls_error_msg(error, &error_alloc, &error_offset);
-				zbx_snprintf_alloc(error, &error_alloc, &error_offset, "%s", info_buf);
-				goto out;
+			goto out;
 		}
 	}
 
@@ -4559,6 +4696,370 @@ void	zbx_tls_close(zbx_socket_t *s)
 	zbx_free(s->tls_ctx);
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_tls_async_connect                                            *
+ *                                                                            *
+ * Purpose: set up TLS client context over a connected nonblocking socket     *
+ *                                                                            *
+ * Parameters:                                                                *
+ *     tls_ctx     - [OUT] TLS context ready for handshake                    *
+ *     fd          - [IN] nonblocking socket with opened connection           *
+ *     tls_connect - [IN] ZBX_TCP_SEC_TLS_CERT or ZBX_TCP_SEC_TLS_PSK         *
+ *     tls_arg1    - [IN] see zbx_tls_connect()                               *
+ *     tls_arg2    - [IN] see zbx_tls_connect()                               *
+ *     error       - [OUT] dynamically allocated memory with error message    *
+ *                                                                            *
+ * Return value:                                                              *
+ *     SUCCEED - TLS context is created, continue with                        *
+ *               zbx_tls_async_handshake()                                    *
+ *     FAIL - an error occurred                                               *
+ *                                                                            *
+ * Comments: Used by pollers running checks in event loop instead of          *
+ *           zbx_tls_connect(), which blocks until handshake is finished.     *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_tls_async_connect(zbx_tls_context_t **tls_ctx, ZBX_SOCKET fd, unsigned int tls_connect,
+		const char *tls_arg1, const char *tls_arg2, char **error)
+{
+	int	ret;
+
+	if (ZBX_TCP_SEC_TLS_CERT != tls_connect && ZBX_TCP_SEC_TLS_PSK != tls_connect)
+	{
+		*error = zbx_strdup(*error, "invalid connection parameters");
+		THIS_SHOULD_NEVER_HAPPEN;
+		return FAIL;
+	}
+
+	*tls_ctx = (zbx_tls_context_t *)zbx_malloc(NULL, sizeof(zbx_tls_context_t));
+	(*tls_ctx)->ctx = NULL;
+#if defined(HAVE_GNUTLS)
+	(*tls_ctx)->psk_client_creds = NULL;
+	(*tls_ctx)->psk_server_creds = NULL;
+
+	ret = zbx_tls_client_init(*tls_ctx, fd, tls_connect, tls_arg1, tls_arg2, error);
+#elif defined(HAVE_OPENSSL)
+	ZBX_UNUSED(tls_arg1);
+	ZBX_UNUSED(tls_arg2);
+
+	ret = zbx_tls_client_init(*tls_ctx, fd, tls_connect, error);
+#endif
+	if (SUCCEED != ret)
+		zbx_tls_async_close(tls_ctx);
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_tls_async_handshake                                          *
+ *                                                                            *
+ * Purpose: continue TLS handshake without blocking                           *
+ *                                                                            *
+ * Parameters:                                                                *
+ *     tls_ctx     - [IN] TLS context created by zbx_tls_async_connect()      *
+ *     tls_connect - [IN] ZBX_TCP_SEC_TLS_CERT or ZBX_TCP_SEC_TLS_PSK         *
+ *     tls_arg1    - [IN] see zbx_tls_connect()                               *
+ *     tls_arg2    - [IN] see zbx_tls_connect()                               *
+ *     events      - [OUT] ZBX_TLS_POLL_READ or ZBX_TLS_POLL_WRITE if socket  *
+ *                         must become readable or writable before the next   *
+ *                         call, 0 if handshake is finished                   *
+ *     error       - [OUT] dynamically allocated memory with error message    *
+ *                                                                            *
+ * Return value:                                                              *
+ *     SUCCEED - handshake is in progress or finished with a valid            *
+ *               certificate or PSK                                           *
+ *     FAIL - an error occurred                                               *
+ *                                                                            *
+ * Comments: The arguments must be the same in every call for one context.    *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_tls_async_handshake(zbx_tls_context_t *tls_ctx, unsigned int tls_connect, const char *tls_arg1,
+		const char *tls_arg2, int *events, char **error)
+{
+#if defined(HAVE_GNUTLS)
+	int	res;
+
+	*events = 0;
+
+	while (GNUTLS_E_SUCCESS != (res = gnutls_handshake(tls_ctx->ctx)))
+	{
+		if (GNUTLS_E_INTERRUPTED == res || GNUTLS_E_AGAIN == res)
+		{
+			*events = (0 == gnutls_record_get_direction(tls_ctx->ctx) ? ZBX_TLS_POLL_READ : ZBX_TLS_POLL_WRITE);
+			return SUCCEED;
+		}
+
+		if (SUCCEED != zbx_tls_handshake_result(__func__, tls_ctx->ctx, res, error))
+			return FAIL;
+	}
+
+	if (ZBX_TCP_SEC_TLS_CERT == tls_connect)
+	{
+		/* log peer certificate information for debugging */
+		zbx_log_peer_cert(__func__, tls_ctx);
+
+		/* perform basic verification of peer certificate */
+		if (SUCCEED != zbx_verify_peer_cert(tls_ctx->ctx, error))
+			return FAIL;
+
+		/* if required verify peer certificate Issuer and Subject */
+		if (SUCCEED != zbx_verify_issuer_subject(tls_ctx, tls_arg1, tls_arg2, error))
+			return FAIL;
+	}
+
+	zabbix_log(LOG_LEVEL_DEBUG, "%s() established %s %s-%s-%s-" ZBX_FS_SIZE_T, __func__,
+			gnutls_protocol_get_name(gnutls_protocol_get_version(tls_ctx->ctx)),
+			gnutls_kx_get_name(gnutls_kx_get(tls_ctx->ctx)),
+			gnutls_cipher_get_name(gnutls_cipher_get(tls_ctx->ctx)),
+			gnutls_mac_get_name(gnutls_mac_get(tls_ctx->ctx)),
+			(zbx_fs_size_t)gnutls_mac_get_key_size(gnutls_mac_get(tls_ctx->ctx)));
+#elif defined(HAVE_OPENSSL)
+	int	res, result_code;
+#if defined(HAVE_OPENSSL_WITH_PSK)
+	char	psk_buf[HOST_TLS_PSK_LEN / 2];
+
+	/* PSK client callback can be called by any handshake step, it takes the PSK from global variables */
+	if (ZBX_TCP_SEC_TLS_PSK == tls_connect && SUCCEED != zbx_psk_client_prepare(tls_arg1, tls_arg2, psk_buf,
+			sizeof(psk_buf), error))
+	{
+		return FAIL;
+	}
+#endif
+	*events = 0;
+	info_buf[0] = '\0';	/* empty buffer for zbx_openssl_info_cb() messages */
+
+	if (1 != (res = SSL_connect(tls_ctx->ctx)))
+	{
+		switch (result_code = SSL_get_error(tls_ctx->ctx, res))
+		{
+			case SSL_ERROR_WANT_READ:
+				*events = ZBX_TLS_POLL_READ;
+				return SUCCEED;
+			case SSL_ERROR_WANT_WRITE:
+				*events = ZBX_TLS_POLL_WRITE;
+				return SUCCEED;
+		}
+
+		if (SUCCEED != zbx_tls_connect_error(tls_ctx, tls_connect, res, result_code, error))
+			return FAIL;
+	}
+
+	if (ZBX_TCP_SEC_TLS_CERT == tls_connect)
+	{
+		long	verify_result;
+
+		/* log peer certificate information for debugging */
+		zbx_log_peer_cert(__func__, tls_ctx);
+
+		/* perform basic verification of peer certificate */
+		if (X509_V_OK != (verify_result = SSL_get_verify_result(tls_ctx->ctx)))
+		{
+			*error = zbx_strdup(*error, X509_verify_cert_error_string(verify_result));
+			return FAIL;
+		}
+
+		/* if required verify peer certificate Issuer and Subject */
+		if (SUCCEED != zbx_verify_issuer_subject(tls_ctx, tls_arg1, tls_arg2, error))
+			return FAIL;
+	}
+
+	zabbix_log(LOG_LEVEL_DEBUG, "%s() established %s %s", __func__, SSL_get_version(tls_ctx->ctx),
+			SSL_get_cipher(tls_ctx->ctx));
+#endif
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_tls_async_write                                              *
+ *                                                                            *
+ * Purpose: send data over TLS connection without blocking                    *
+ *                                                                            *
+ * Parameters: tls_ctx - [IN] TLS context with finished handshake             *
+ *             buf     - [IN] data to send                                    *
+ *             len     - [IN] length of data                                  *
+ *             events  - [OUT] ZBX_TLS_POLL_READ or ZBX_TLS_POLL_WRITE if     *
+ *                             nothing was sent and the call must be repeated *
+ *                             with the same data when socket is ready        *
+ *             error   - [OUT] dynamically allocated error message            *
+ *                                                                            *
+ * Return value: number of bytes sent, 0 when waiting for socket or           *
+ *               ZBX_PROTO_ERROR on error                                     *
+ *                                                                            *
+ ******************************************************************************/
+ssize_t	zbx_tls_async_write(zbx_tls_context_t *tls_ctx, const char *buf, size_t len, int *events, char **error)
+{
+#if defined(HAVE_GNUTLS)
+	ssize_t	res;
+
+	*events = 0;
+
+	if (0 > (res = gnutls_record_send(tls_ctx->ctx, buf, len)))
+	{
+		if (GNUTLS_E_INTERRUPTED == res || GNUTLS_E_AGAIN == res)
+		{
+			*events = (0 == gnutls_record_get_direction(tls_ctx->ctx) ? ZBX_TLS_POLL_READ : ZBX_TLS_POLL_WRITE);
+			return 0;
+		}
+
+		*error = zbx_dsprintf(*error, "gnutls_record_send() failed: " ZBX_FS_SSIZE_T " %s",
+				(zbx_fs_ssize_t)res, gnutls_strerror(res));
+
+		return ZBX_PROTO_ERROR;
+	}
+#elif defined(HAVE_OPENSSL)
+	int	res;
+
+	*events = 0;
+	info_buf[0] = '\0';	/* empty buffer for zbx_openssl_info_cb() messages */
+
+	if (0 >= (res = SSL_write(tls_ctx->ctx, buf, (int)len)))
+	{
+		char	*err = NULL;
+		size_t	error_alloc = 0, error_offset = 0;
+		int	result_code;
+
+		switch (result_code = SSL_get_error(tls_ctx->ctx, res))
+		{
+			case SSL_ERROR_WANT_READ:
+				*events = ZBX_TLS_POLL_READ;
+				return 0;
+			case SSL_ERROR_WANT_WRITE:
+				*events = ZBX_TLS_POLL_WRITE;
+				return 0;
+			case SSL_ERROR_ZERO_RETURN:
+				*error = zbx_strdup(*error, "connection closed during write");
+				return ZBX_PROTO_ERROR;
+		}
+
+		zbx_snprintf_alloc(&err, &error_alloc, &error_offset, "TLS write set result code to %d:",
+				result_code);
+		zbx_tls_error_msg(&err, &error_alloc, &error_offset);
+		*error = zbx_dsprintf(*error, "%s%s", err, info_buf);
+		zbx_free(err);
+
+		return ZBX_PROTO_ERROR;
+	}
+#endif
+	return (ssize_t)res;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_tls_async_read                                               *
+ *                                                                            *
+ * Purpose: receive data over TLS connection without blocking                 *
+ *                                                                            *
+ * Parameters: tls_ctx - [IN] TLS context with finished handshake             *
+ *             buf     - [OUT] buffer for received data                       *
+ *             len     - [IN] size of buffer                                  *
+ *             events  - [OUT] ZBX_TLS_POLL_READ or ZBX_TLS_POLL_WRITE if     *
+ *                             nothing was received and the call must be      *
+ *                             repeated when socket is ready, otherwise 0     *
+ *             error   - [OUT] dynamically allocated error message            *
+ *                                                                            *
+ * Return value: number of bytes received, 0 when waiting for socket or when  *
+ *               peer has closed connection (events is 0) or ZBX_PROTO_ERROR  *
+ *               on error                                                     *
+ *                                                                            *
+ ******************************************************************************/
+ssize_t	zbx_tls_async_read(zbx_tls_context_t *tls_ctx, char *buf, size_t len, int *events, char **error)
+{
+#if defined(HAVE_GNUTLS)
+	ssize_t	res;
+
+	*events = 0;
+
+	if (0 > (res = gnutls_record_recv(tls_ctx->ctx, buf, len)))
+	{
+		if (GNUTLS_E_INTERRUPTED == res || GNUTLS_E_AGAIN == res)
+		{
+			*events = (0 == gnutls_record_get_direction(tls_ctx->ctx) ? ZBX_TLS_POLL_READ : ZBX_TLS_POLL_WRITE);
+			return 0;
+		}
+
+		/* in case of rehandshake a GNUTLS_E_REHANDSHAKE will be returned, deal with it as with error */
+		*error = zbx_dsprintf(*error, "gnutls_record_recv() failed: " ZBX_FS_SSIZE_T " %s",
+				(zbx_fs_ssize_t)res, gnutls_strerror(res));
+
+		return ZBX_PROTO_ERROR;
+	}
+#elif defined(HAVE_OPENSSL)
+	int	res;
+
+	*events = 0;
+	info_buf[0] = '\0';	/* empty buffer for zbx_openssl_info_cb() messages */
+
+	if (0 >= (res = SSL_read(tls_ctx->ctx, buf, (int)len)))
+	{
+		char	*err = NULL;
+		size_t	error_alloc = 0, error_offset = 0;
+		int	result_code;
+
+		switch (result_code = SSL_get_error(tls_ctx->ctx, res))
+		{
+			case SSL_ERROR_WANT_READ:
+				*events = ZBX_TLS_POLL_READ;
+				return 0;
+			case SSL_ERROR_WANT_WRITE:
+				*events = ZBX_TLS_POLL_WRITE;
+				return 0;
+			case SSL_ERROR_ZERO_RETURN:
+				return 0;
+		}
+
+		zbx_snprintf_alloc(&err, &error_alloc, &error_offset, "TLS read set result code to %d:",
+				result_code);
+		zbx_tls_error_msg(&err, &error_alloc, &error_offset);
+		*error = zbx_dsprintf(*error, "%s%s", err, info_buf);
+		zbx_free(err);
+
+		return ZBX_PROTO_ERROR;
+	}
+#endif
+	return (ssize_t)res;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_tls_async_close                                              *
+ *                                                                            *
+ * Purpose: close TLS connection created by zbx_tls_async_connect() before    *
+ *          closing a TCP socket                                              *
+ *                                                                            *
+ * Comments: Shutdown alert is sent once without waiting for socket, as the   *
+ *           TCP connection is closed right after.                            *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_tls_async_close(zbx_tls_context_t **tls_ctx)
+{
+	if (NULL == *tls_ctx)
+		return;
+#if defined(HAVE_GNUTLS)
+	if (NULL != (*tls_ctx)->ctx)
+	{
+		gnutls_bye((*tls_ctx)->ctx, GNUTLS_SHUT_WR);
+		gnutls_credentials_clear((*tls_ctx)->ctx);
+		gnutls_deinit((*tls_ctx)->ctx);
+	}
+
+	if (NULL != (*tls_ctx)->psk_client_creds)
+		gnutls_psk_free_client_credentials((*tls_ctx)->psk_client_creds);
+#elif defined(HAVE_OPENSSL)
+	if (NULL != (*tls_ctx)->ctx)
+	{
+		/* unidirectional shutdown, errors of unfinished connections are not interesting */
+		if (1 == SSL_is_init_finished((*tls_ctx)->ctx))
+			SSL_shutdown((*tls_ctx)->ctx);
+
+		ERR_clear_error();
+		SSL_free((*tls_ctx)->ctx);
+	}
+#endif
+	zbx_free(*tls_ctx);
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: zbx_tls_get_attr_cert                                            *
@@ -27,6 +27,18 @@ int	zbx_tls_accept(zbx_socket_t *s, unsigned int tls_accept, char **error);
 ssize_t	zbx_tls_write(zbx_socket_t *s, const char *buf, size_t len, char **error);
 ssize_t	zbx_tls_read(zbx_socket_t *s, char *buf, size_t len, char **error);
 void	zbx_tls_close(zbx_socket_t *s);
+
+/* socket events TLS connection waits for before nonblocking operation can continue */
+#define ZBX_TLS_POLL_READ	0x01
+#define ZBX_TLS_POLL_WRITE	0x02
+
+int	zbx_tls_async_connect(zbx_tls_context_t **tls_ctx, ZBX_SOCKET fd, unsigned int tls_connect,
+		const char *tls_arg1, const char *tls_arg2, char **error);
+int	zbx_tls_async_handshake(zbx_tls_context_t *tls_ctx, unsigned int tls_connect, const char *tls_arg1,
+		const char *tls_arg2, int *events, char **error);
+ssize_t	zbx_tls_async_write(zbx_tls_context_t *tls_ctx, const char *buf, size_t len, int *events, char **error);
+ssize_t	zbx_tls_async_read(zbx_tls_context_t *tls_ctx, char *buf, size_t len, int *events, char **error);
+void	zbx_tls_async_close(zbx_tls_context_t **tls_ctx);
 #endif
 
 #if defined(HAVE_OPENSSL)
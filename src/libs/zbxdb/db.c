@@ -62,8 +62,15 @@ struct zbx_db_result
 	int		ncolumn;
 	DB_ROW		values;
 #endif
+	char		*blob;		/* serialized rows of a result restored without querying database */
+	size_t		blob_size;
+	size_t		blob_offset;
+	int		blob_fields;
+	DB_ROW		blob_row;
 };
 
+#define ZBX_DB_BLOB_NULL	0xffffffff
+
 static int	txn_level = 0;	/* transaction level, nested transactions are not supported */
 static int	txn_error = ZBX_DB_OK;	/* failed transaction */
 static int	txn_end_error = ZBX_DB_OK;	/* transaction result */
@@ -100,6 +107,25 @@ static ub4	OCI_DBserver_status(void);
 
 #elif defined(HAVE_POSTGRESQL)
 static PGconn			*conn = NULL;
+static PGconn			*async_conn = NULL;	/* connection for asynchronous history writes */
+
+/* the maximum number of select statements prefetched in parallel */
+#define ZBX_DB_PREFETCH_MAX	8
+
+typedef struct
+{
+	PGconn	*conn;
+	char	*sql;
+	double	sec;
+}
+zbx_db_prefetch_t;
+
+static zbx_db_prefetch_t	prefetch[ZBX_DB_PREFETCH_MAX];
+static char			*async_dbschema = NULL;
+static const zbx_db_stmt_t	*async_stmts = NULL;	/* statements of asynchronous transaction */
+static int			async_stmts_num;
+static int			async_index;		/* the statement being executed */
+static double			async_sec;
 static unsigned int		ZBX_PG_BYTEAOID = 0;
 static int			ZBX_TSDB_VERSION = -1;
 static zbx_uint32_t		ZBX_PG_SVERSION = ZBX_DBVERSION_UNDEFINED;
@@ -773,7 +799,10 @@ int	zbx_db_connect(char *host, char *user, char *password, char *dbname, char *d
 		dbschema_esc = zbx_db_dyn_escape_string(dbschema, ZBX_SIZE_T_MAX, ZBX_SIZE_T_MAX, ESCAPE_SEQUENCE_ON);
 		if (ZBX_DB_DOWN == (rc = zbx_db_execute("set schema '%s'", dbschema_esc)) || ZBX_DB_FAIL == rc)
 			ret = rc;
-		zbx_free(dbschema_esc);
+
+		/* remember the schema for the asynchronous connection */
+		zbx_free(async_dbschema);
+		async_dbschema = dbschema_esc;
 	}
 
 	if (ZBX_DB_FAIL == ret || ZBX_DB_DOWN == ret)
@@ -982,6 +1011,8 @@ void	zbx_db_close(void)
 
 	zbx_vector_ptr_destroy(&oracle.db_results);
 #elif defined(HAVE_POSTGRESQL)
+	zbx_db_async_close();
+
 	if (NULL != conn)
 	{
 		PQfinish(conn);
@@ -1570,6 +1601,688 @@ clean:
 	return ret;
 }
 
+#if defined(HAVE_POSTGRESQL)
+/******************************************************************************
+ *                                                                            *
+ * Function: db_put_copy_data                                                 *
+ *                                                                            *
+ * Purpose: sends data of COPY FROM STDIN statement accepted by database      *
+ *                                                                            *
+ * Parameters: pg_conn - [IN] the database connection                         *
+ *             data    - [IN] the data to copy                                *
+ *             size    - [IN] the data size                                   *
+ *                                                                            *
+ * Return value: SUCCEED - the data was sent                                  *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+static int	db_put_copy_data(PGconn *pg_conn, const char *data, size_t size)
+{
+#define ZBX_DB_COPY_CHUNK_SIZE	(64 * ZBX_KIBIBYTE)
+
+	size_t	offset;
+
+	for (offset = 0; offset < size; offset += ZBX_DB_COPY_CHUNK_SIZE)
+	{
+		if (1 != PQputCopyData(pg_conn, data + offset, (int)MIN(ZBX_DB_COPY_CHUNK_SIZE, size - offset)))
+			return FAIL;
+	}
+
+	return 1 == PQputCopyEnd(pg_conn, NULL) ? SUCCEED : FAIL;
+
+#undef ZBX_DB_COPY_CHUNK_SIZE
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_db_copy                                                      *
+ *                                                                            *
+ * Purpose: executes COPY FROM STDIN statement                                *
+ *                                                                            *
+ * Parameters: sql  - [IN] the COPY statement                                 *
+ *             data - [IN] the data to copy, in the format expected by the    *
+ *                         statement                                          *
+ *             size - [IN] the data size                                      *
+ *                                                                            *
+ * Return value: ZBX_DB_FAIL (on error) or ZBX_DB_DOWN (on recoverable error) *
+ *               or number of rows copied (on success)                        *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_db_copy(const char *sql, const char *data, size_t size)
+{
+	int		ret = ZBX_DB_OK;
+	double		sec = 0;
+	PGresult	*result;
+	char		*error = NULL;
+
+	if (0 != CONFIG_LOG_SLOW_QUERIES)
+		sec = zbx_time();
+
+	if (0 == txn_level)
+		zabbix_log(LOG_LEVEL_DEBUG, "query without transaction detected");
+
+	if (ZBX_DB_OK != txn_error)
+	{
+		zabbix_log(LOG_LEVEL_DEBUG, "ignoring query [txnlev:%d] [%s] within failed transaction", txn_level, sql);
+		return ZBX_DB_FAIL;
+	}
+
+	zabbix_log(LOG_LEVEL_DEBUG, "query [txnlev:%d] [%s] size:" ZBX_FS_SIZE_T, txn_level, sql,
+			(zbx_fs_size_t)size);
+
+	result = PQexec(conn, sql);
+
+	if (NULL == result)
+	{
+		zbx_db_errlog(ERR_Z3005, 0, "result is NULL", sql);
+		ret = (CONNECTION_OK == PQstatus(conn) ? ZBX_DB_FAIL : ZBX_DB_DOWN);
+		goto out;
+	}
+
+	if (PGRES_COPY_IN != PQresultStatus(result))
+	{
+		zbx_postgresql_error(&error, result);
+		zbx_db_errlog(ERR_Z3005, 0, error, sql);
+		zbx_free(error);
+
+		ret = (SUCCEED == is_recoverable_postgresql_error(conn, result) ? ZBX_DB_DOWN : ZBX_DB_FAIL);
+		PQclear(result);
+		goto out;
+	}
+
+	PQclear(result);
+
+	if (SUCCEED != db_put_copy_data(conn, data, size))
+	{
+		zbx_db_errlog(ERR_Z3005, 0, PQerrorMessage(conn), sql);
+		ret = (CONNECTION_OK == PQstatus(conn) ? ZBX_DB_FAIL : ZBX_DB_DOWN);
+	}
+
+	/* the COPY command result must be read even if sending data failed */
+	while (NULL != (result = PQgetResult(conn)))
+	{
+		if (ZBX_DB_OK == ret)
+		{
+			if (PGRES_COMMAND_OK != PQresultStatus(result))
+			{
+				zbx_postgresql_error(&error, result);
+				zbx_db_errlog(ERR_Z3005, 0, error, sql);
+				zbx_free(error);
+
+				ret = (SUCCEED == is_recoverable_postgresql_error(conn, result) ? ZBX_DB_DOWN :
+						ZBX_DB_FAIL);
+			}
+			else
+				ret = atoi(PQcmdTuples(result));
+		}
+
+		PQclear(result);
+	}
+out:
+	if (0 != CONFIG_LOG_SLOW_QUERIES)
+	{
+		sec = zbx_time() - sec;
+		if (sec > (double)CONFIG_LOG_SLOW_QUERIES / 1000.0)
+			zabbix_log(LOG_LEVEL_WARNING, "slow query: " ZBX_FS_DBL " sec, \"%s\"", sec, sql);
+	}
+
+	if (ZBX_DB_FAIL == ret && 0 < txn_level)
+	{
+		zabbix_log(LOG_LEVEL_DEBUG, "query [%s] failed, setting transaction as failed", sql);
+		txn_error = ZBX_DB_FAIL;
+	}
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: db_connect_duplicate                                             *
+ *                                                                            *
+ * Purpose: opens additional connection with the same parameters as the main  *
+ *          connection                                                        *
+ *                                                                            *
+ * Return value: the opened connection or NULL if database is down            *
+ *                                                                            *
+ ******************************************************************************/
+static PGconn	*db_connect_duplicate(void)
+{
+	PQconninfoOption	*options, *option;
+	const char		**keywords, **values;
+	int			i = 0;
+	char			*sql = NULL, *error = NULL;
+	size_t			sql_alloc = 0, sql_offset = 0;
+	PGresult		*result;
+	PGconn			*pg_conn;
+
+	if (NULL == conn || NULL == (options = PQconninfo(conn)))
+		return NULL;
+
+	for (option = options; NULL != option->keyword; option++)
+		i++;
+
+	keywords = (const char **)zbx_malloc(NULL, sizeof(char *) * (size_t)(i + 1));
+	values = (const char **)zbx_malloc(NULL, sizeof(char *) * (size_t)(i + 1));
+
+	for (i = 0, option = options; NULL != option->keyword; option++)
+	{
+		if (NULL == option->val || '\0' == *option->val)
+			continue;
+
+		keywords[i] = option->keyword;
+		values[i++] = option->val;
+	}
+
+	keywords[i] = NULL;
+	values[i] = NULL;
+
+	pg_conn = PQconnectdbParams(keywords, values, 0);
+
+	zbx_free(values);
+	zbx_free(keywords);
+	PQconninfoFree(options);
+
+	if (CONNECTION_OK != PQstatus(pg_conn))
+	{
+		zbx_db_errlog(ERR_Z3001, 0, PQerrorMessage(pg_conn), PQdb(conn));
+		goto out;
+	}
+
+	zbx_strcpy_alloc(&sql, &sql_alloc, &sql_offset, "set escape_string_warning to off");
+
+	if (NULL != async_dbschema)
+		zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset, ";set schema '%s'", async_dbschema);
+
+	result = PQexec(pg_conn, sql);
+
+	if (PGRES_COMMAND_OK != PQresultStatus(result))
+	{
+		zbx_postgresql_error(&error, result);
+		zbx_db_errlog(ERR_Z3005, 0, error, sql);
+		zbx_free(error);
+		PQclear(result);
+		zbx_free(sql);
+		goto out;
+	}
+
+	PQclear(result);
+	zbx_free(sql);
+
+	return pg_conn;
+out:
+	PQfinish(pg_conn);
+
+	return NULL;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: db_async_connect                                                 *
+ *                                                                            *
+ * Purpose: opens connection for asynchronous queries                         *
+ *                                                                            *
+ * Return value: ZBX_DB_OK - successfully connected                           *
+ *               ZBX_DB_DOWN - database is down                               *
+ *                                                                            *
+ * Comments: The connection is opened with the same parameters as the main    *
+ *           connection.                                                      *
+ *                                                                            *
+ ******************************************************************************/
+static int	db_async_connect(void)
+{
+	if (NULL == (async_conn = db_connect_duplicate()))
+		return ZBX_DB_DOWN;
+
+	return ZBX_DB_OK;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: db_async_start                                                   *
+ *                                                                            *
+ * Purpose: sends the current statement of asynchronous transaction          *
+ *                                                                            *
+ * Return value: ZBX_DB_OK - the statement was sent                           *
+ *               ZBX_DB_FAIL - the statement failed                           *
+ *               ZBX_DB_DOWN - database is down                               *
+ *                                                                            *
+ * Comments: The first statement opens and the last statement commits the    *
+ *           transaction. The data of COPY statement can be sent only after   *
+ *           database has accepted the statement, so sending COPY statement   *
+ *           waits for one round trip, but not for the copy to complete.      *
+ *                                                                            *
+ ******************************************************************************/
+static int	db_async_start(void)
+{
+	const zbx_db_stmt_t	*stmt = &async_stmts[async_index];
+	char			*sql = NULL, *error = NULL;
+	size_t			sql_alloc = 0, sql_offset = 0;
+	PGresult		*result;
+	int			ret = ZBX_DB_OK;
+
+	if (0 == async_index)
+		zbx_strcpy_alloc(&sql, &sql_alloc, &sql_offset, "begin;");
+
+	zbx_strcpy_alloc(&sql, &sql_alloc, &sql_offset, stmt->sql);
+
+	if (async_index == async_stmts_num - 1)
+		zbx_strcpy_alloc(&sql, &sql_alloc, &sql_offset, ";commit");
+
+	zabbix_log(LOG_LEVEL_DEBUG, "async query [%s]", sql);
+
+	if (1 != PQsendQuery(async_conn, sql))
+	{
+		zbx_db_errlog(ERR_Z3005, 0, PQerrorMessage(async_conn), sql);
+		ret = ZBX_DB_DOWN;
+		goto out;
+	}
+
+	if (NULL == stmt->data)
+		goto out;
+
+	/* skip the result of begin statement */
+	while (NULL != (result = PQgetResult(async_conn)) && PGRES_COMMAND_OK == PQresultStatus(result))
+		PQclear(result);
+
+	if (NULL == result)
+	{
+		zbx_db_errlog(ERR_Z3005, 0, PQerrorMessage(async_conn), sql);
+		ret = ZBX_DB_DOWN;
+		goto out;
+	}
+
+	if (PGRES_COPY_IN != PQresultStatus(result))
+	{
+		zbx_postgresql_error(&error, result);
+		zbx_db_errlog(ERR_Z3005, 0, error, sql);
+		zbx_free(error);
+
+		ret = (SUCCEED == is_recoverable_postgresql_error(async_conn, result) ? ZBX_DB_DOWN : ZBX_DB_FAIL);
+		PQclear(result);
+		goto out;
+	}
+
+	PQclear(result);
+
+	if (SUCCEED != db_put_copy_data(async_conn, stmt->data, stmt->data_size))
+	{
+		zbx_db_errlog(ERR_Z3005, 0, PQerrorMessage(async_conn), sql);
+		ret = (CONNECTION_OK == PQstatus(async_conn) ? ZBX_DB_FAIL : ZBX_DB_DOWN);
+	}
+out:
+	zbx_free(sql);
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: db_async_finish                                                  *
+ *                                                                            *
+ * Purpose: waits for the current statement of asynchronous transaction to   *
+ *          complete                                                          *
+ *                                                                            *
+ * Return value: ZBX_DB_OK - the statement was executed successfully          *
+ *               ZBX_DB_FAIL - the statement failed                           *
+ *               ZBX_DB_DOWN - database is down                               *
+ *                                                                            *
+ ******************************************************************************/
+static int	db_async_finish(void)
+{
+	int		ret = ZBX_DB_OK;
+	PGresult	*result;
+	char		*error = NULL;
+
+	while (NULL != (result = PQgetResult(async_conn)))
+	{
+		if (ZBX_DB_OK == ret && PGRES_COMMAND_OK != PQresultStatus(result))
+		{
+			zbx_postgresql_error(&error, result);
+			zbx_db_errlog(ERR_Z3005, 0, error, async_stmts[async_index].sql);
+			zbx_free(error);
+
+			ret = (SUCCEED == is_recoverable_postgresql_error(async_conn, result) ? ZBX_DB_DOWN :
+					ZBX_DB_FAIL);
+		}
+
+		PQclear(result);
+	}
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_db_async_send                                                *
+ *                                                                            *
+ * Purpose: starts execution of statements without waiting for the result    *
+ *                                                                            *
+ * Parameters: stmts     - [IN] the statements to execute                     *
+ *             stmts_num - [IN] the number of statements                      *
+ *                                                                            *
+ * Return value: ZBX_DB_OK - the statements were sent                         *
+ *               ZBX_DB_FAIL - the first statement failed                     *
+ *               ZBX_DB_DOWN - database is down                               *
+ *                                                                            *
+ * Comments: The statements are executed on a separate connection in their   *
+ *           own transaction, so either all or none of them are applied.      *
+ *           Only the first statement is sent, the following statements are   *
+ *           sent by zbx_db_async_wait() after the previous one completes,    *
+ *           because COPY statements cannot be pipelined.                     *
+ *           The statements must be kept until zbx_db_async_wait() returns.   *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_db_async_send(const zbx_db_stmt_t *stmts, int stmts_num)
+{
+	int	ret;
+
+	if (0 == stmts_num)
+		return ZBX_DB_OK;
+
+	if (NULL != async_conn && CONNECTION_OK != PQstatus(async_conn))
+		zbx_db_async_close();
+
+	if (NULL == async_conn && ZBX_DB_OK != db_async_connect())
+		return ZBX_DB_DOWN;
+
+	if (0 != CONFIG_LOG_SLOW_QUERIES)
+		async_sec = zbx_time();
+
+	async_stmts = stmts;
+	async_stmts_num = stmts_num;
+	async_index = 0;
+
+	if (ZBX_DB_OK != (ret = db_async_start()))
+		zbx_db_async_close();
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_db_async_wait                                                *
+ *                                                                            *
+ * Purpose: waits for the statements sent by zbx_db_async_send() to complete  *
+ *                                                                            *
+ * Return value: ZBX_DB_OK - the statements were executed successfully        *
+ *               ZBX_DB_FAIL - the statements failed                          *
+ *               ZBX_DB_DOWN - database is down                               *
+ *                                                                            *
+ * Comments: If a statement fails the connection is closed, rolling back the  *
+ *           transaction.                                                     *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_db_async_wait(void)
+{
+	int	ret;
+
+	if (NULL == async_stmts)
+		return ZBX_DB_OK;
+
+	while (ZBX_DB_OK == (ret = db_async_finish()) && ++async_index < async_stmts_num)
+	{
+		if (ZBX_DB_OK != (ret = db_async_start()))
+			break;
+	}
+
+	if (0 != CONFIG_LOG_SLOW_QUERIES)
+	{
+		double	sec;
+
+		sec = zbx_time() - async_sec;
+		if (sec > (double)CONFIG_LOG_SLOW_QUERIES / 1000.0)
+		{
+			zabbix_log(LOG_LEVEL_WARNING, "slow query: " ZBX_FS_DBL " sec, \"%s\"", sec,
+					async_stmts[0].sql);
+		}
+	}
+
+	async_stmts = NULL;
+
+	if (ZBX_DB_OK != ret)
+		zbx_db_async_close();
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_db_async_close                                               *
+ *                                                                            *
+ * Purpose: closes connection for asynchronous queries                        *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_db_async_close(void)
+{
+	if (NULL != async_conn)
+	{
+		PQfinish(async_conn);
+		async_conn = NULL;
+	}
+
+	async_stmts = NULL;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: db_prefetch_free                                                 *
+ *                                                                            *
+ * Purpose: closes prefetch connection and frees the prefetch slot            *
+ *                                                                            *
+ ******************************************************************************/
+static void	db_prefetch_free(zbx_db_prefetch_t *pf)
+{
+	PGresult	*result;
+
+	if (NULL != pf->conn)
+	{
+		while (NULL != (result = PQgetResult(pf->conn)))
+			PQclear(result);
+
+		PQfinish(pf->conn);
+		pf->conn = NULL;
+	}
+
+	zbx_free(pf->sql);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: db_prefetch_consume                                              *
+ *                                                                            *
+ * Purpose: reads the available input of all pending prefetch queries         *
+ *                                                                            *
+ * Parameters: timeout - [IN] the maximum time to wait for input in           *
+ *                            milliseconds, 0 - do not wait                   *
+ *                                                                            *
+ * Comments: The results of all pending queries are transferred while waiting *
+ *           for any of them, so the database server is not stalled by        *
+ *           unread data of the queries not yet waited for.                   *
+ *                                                                            *
+ ******************************************************************************/
+static void	db_prefetch_consume(int timeout)
+{
+	fd_set		fds;
+	int		i, fd, fd_max = -1;
+	struct timeval	tv;
+
+	FD_ZERO(&fds);
+
+	for (i = 0; i < ZBX_DB_PREFETCH_MAX; i++)
+	{
+		if (NULL == prefetch[i].conn || 0 == PQisBusy(prefetch[i].conn))
+			continue;
+
+		if (0 == timeout)
+		{
+			PQconsumeInput(prefetch[i].conn);
+			continue;
+		}
+
+		if (0 > (fd = PQsocket(prefetch[i].conn)))
+			continue;
+
+		FD_SET(fd, &fds);
+
+		if (fd > fd_max)
+			fd_max = fd;
+	}
+
+	if (-1 == fd_max)
+		return;
+
+	tv.tv_sec = timeout / 1000;
+	tv.tv_usec = (timeout % 1000) * 1000;
+
+	if (0 < select(fd_max + 1, &fds, NULL, NULL, &tv))
+		db_prefetch_consume(0);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_db_prefetch_send                                             *
+ *                                                                            *
+ * Purpose: starts select statement execution on a separate connection        *
+ *                                                                            *
+ * Parameters: sql - [IN] the select statement                                *
+ *                                                                            *
+ * Return value: the prefetch index to pass to zbx_db_prefetch_result() or    *
+ *               FAIL if the statement could not be sent                      *
+ *                                                                            *
+ * Comments: Every prefetched statement is executed on its own connection, so *
+ *           the database server executes them in parallel with each other   *
+ *           and with the main connection statements.                         *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_db_prefetch_send(const char *sql)
+{
+	int	i;
+
+	for (i = 0; i < ZBX_DB_PREFETCH_MAX; i++)
+	{
+		if (NULL == prefetch[i].conn)
+			break;
+	}
+
+	if (ZBX_DB_PREFETCH_MAX == i || NULL == (prefetch[i].conn = db_connect_duplicate()))
+		return FAIL;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "prefetch query [%s]", sql);
+
+	prefetch[i].sec = zbx_time();
+
+	if (1 != PQsendQuery(prefetch[i].conn, sql))
+	{
+		zbx_db_errlog(ERR_Z3005, 0, PQerrorMessage(prefetch[i].conn), sql);
+		db_prefetch_free(&prefetch[i]);
+
+		return FAIL;
+	}
+
+	prefetch[i].sql = zbx_strdup(NULL, sql);
+
+	return i;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_db_prefetch_result                                           *
+ *                                                                            *
+ * Purpose: waits for the prefetched select statement result                  *
+ *                                                                            *
+ * Parameters: index - [IN] the prefetch index returned by                    *
+ *                          zbx_db_prefetch_send()                            *
+ *                                                                            *
+ * Return value: the select statement result or NULL on error                 *
+ *                                                                            *
+ * Comments: The prefetch connection is closed after the result is received.  *
+ *                                                                            *
+ ******************************************************************************/
+DB_RESULT	zbx_db_prefetch_result(int index)
+{
+	zbx_db_prefetch_t	*pf = &prefetch[index];
+	DB_RESULT		result = NULL;
+	PGresult		*pg_result;
+	char			*error = NULL;
+	double			sec;
+
+	if (NULL == pf->conn)
+		return NULL;
+
+	while (1 == PQconsumeInput(pf->conn) && 0 != PQisBusy(pf->conn))
+		db_prefetch_consume(1000);
+
+	if (NULL == (pg_result = PQgetResult(pf->conn)))
+	{
+		zbx_db_errlog(ERR_Z3005, 0, PQerrorMessage(pf->conn), pf->sql);
+		goto out;
+	}
+
+	if (PGRES_TUPLES_OK != PQresultStatus(pg_result))
+	{
+		zbx_postgresql_error(&error, pg_result);
+		zbx_db_errlog(ERR_Z3005, 0, error, pf->sql);
+		zbx_free(error);
+		PQclear(pg_result);
+		goto out;
+	}
+
+	result = (DB_RESULT)zbx_malloc(NULL, sizeof(struct zbx_db_result));
+	result->blob = NULL;
+	result->pg_result = pg_result;
+	result->values = NULL;
+	result->cursor = 0;
+	result->row_num = PQntuples(pg_result);
+
+	if (0 != CONFIG_LOG_SLOW_QUERIES)
+	{
+		sec = zbx_time() - pf->sec;
+		if (sec > (double)CONFIG_LOG_SLOW_QUERIES / 1000.0)
+			zabbix_log(LOG_LEVEL_WARNING, "slow query: " ZBX_FS_DBL " sec, \"%s\"", sec, pf->sql);
+	}
+out:
+	db_prefetch_free(pf);
+
+	return result;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_db_prefetch_close                                            *
+ *                                                                            *
+ * Purpose: cancels all pending prefetch queries                              *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_db_prefetch_close(void)
+{
+	int	i;
+
+	for (i = 0; i < ZBX_DB_PREFETCH_MAX; i++)
+	{
+		if (NULL != prefetch[i].conn)
+			db_prefetch_free(&prefetch[i]);
+	}
+}
+#else
+int	zbx_db_prefetch_send(const char *sql)
+{
+	ZBX_UNUSED(sql);
+
+	return FAIL;
+}
+
+DB_RESULT	zbx_db_prefetch_result(int index)
+{
+	ZBX_UNUSED(index);
+
+	return NULL;
+}
+
+void	zbx_db_prefetch_close(void)
+{
+}
+#endif
+
 /******************************************************************************
  *                                                                            *
  * Function: zbx_db_vselect                                                   *
@@ -1609,6 +2322,7 @@ DB_RESULT	zbx_db_vselect(const char *fmt, va_list args)
 
 #if defined(HAVE_MYSQL)
 	result = (DB_RESULT)zbx_malloc(NULL, sizeof(struct zbx_db_result));
+	result->blob = NULL;
 	result->result = NULL;
 
 	if (NULL == conn)
@@ -1781,6 +2495,7 @@ error:
 	}
 #elif defined(HAVE_POSTGRESQL)
 	result = zbx_malloc(NULL, sizeof(struct zbx_db_result));
+	result->blob = NULL;
 	result->pg_result = PQexec(conn, sql);
 	result->values = NULL;
 	result->cursor = 0;
@@ -1813,6 +2528,7 @@ error:
 		zbx_mutex_lock(sqlite_access);
 
 	result = zbx_malloc(NULL, sizeof(struct zbx_db_result));
+	result->blob = NULL;
 	result->curow = 0;
 
 lbl_get_table:
@@ -1925,6 +2641,154 @@ static size_t	zbx_db_bytea_unescape(u_char *io)
 }
 #endif
 
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_db_result_from_blob                                          *
+ *                                                                            *
+ * Purpose: create result from rows serialized by zbx_db_row_serialize()      *
+ *                                                                            *
+ * Parameters: blob      - [IN] the serialized rows, the result takes         *
+ *                              ownership of it                               *
+ *             blob_size - [IN] the size of serialized rows                   *
+ *             fields    - [IN] the number of fields in a row                 *
+ *                                                                            *
+ * Return value: the result, which is freed with DBfree_result()              *
+ *                                                                            *
+ * Comments: Fetched row values point directly into the serialized data, so   *
+ *           the result does not require database connection.                 *
+ *                                                                            *
+ ******************************************************************************/
+DB_RESULT	zbx_db_result_from_blob(char *blob, size_t blob_size, int fields)
+{
+	DB_RESULT	result;
+
+	result = (DB_RESULT)zbx_malloc(NULL, sizeof(struct zbx_db_result));
+	memset(result, 0, sizeof(struct zbx_db_result));
+
+	/* empty result still needs non-NULL blob to be distinguished from database results */
+	result->blob = (NULL != blob ? blob : zbx_malloc(NULL, 1));
+	result->blob_size = blob_size;
+	result->blob_fields = fields;
+	result->blob_row = (DB_ROW)zbx_malloc(NULL, sizeof(char *) * (size_t)MAX(fields, 1));
+
+	return result;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_db_row_serialize                                             *
+ *                                                                            *
+ * Purpose: append row to serialized rows buffer                              *
+ *                                                                            *
+ * Parameters: blob        - [IN/OUT] the serialized rows                     *
+ *             blob_alloc  - [IN/OUT] the allocated buffer size               *
+ *             blob_offset - [IN/OUT] the serialized rows size                *
+ *             row         - [IN] the row to serialize                        *
+ *             fields      - [IN] the number of fields in the row             *
+ *                                                                            *
+ * Comments: Every field is stored as 32 bit length (ZBX_DB_BLOB_NULL for     *
+ *           NULL values), followed by the value and terminating zero.        *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_db_row_serialize(char **blob, size_t *blob_alloc, size_t *blob_offset, DB_ROW row, int fields)
+{
+	int	i;
+
+	for (i = 0; i < fields; i++)
+	{
+		zbx_uint32_t	len;
+		size_t		size;
+
+		len = (NULL == row[i] ? ZBX_DB_BLOB_NULL : (zbx_uint32_t)strlen(row[i]));
+		size = sizeof(len) + (ZBX_DB_BLOB_NULL == len ? 0 : (size_t)len + 1);
+
+		if (*blob_offset + size > *blob_alloc)
+		{
+			while (*blob_offset + size > *blob_alloc)
+				*blob_alloc = (0 == *blob_alloc ? ZBX_KIBIBYTE : *blob_alloc * 2);
+
+			*blob = (char *)zbx_realloc(*blob, *blob_alloc);
+		}
+
+		memcpy(*blob + *blob_offset, &len, sizeof(len));
+		*blob_offset += sizeof(len);
+
+		if (ZBX_DB_BLOB_NULL != len)
+		{
+			memcpy(*blob + *blob_offset, row[i], (size_t)len + 1);
+			*blob_offset += (size_t)len + 1;
+		}
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_db_result_fields                                             *
+ *                                                                            *
+ * Purpose: get number of fields in select result                             *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_db_result_fields(DB_RESULT result)
+{
+	if (NULL == result)
+		return 0;
+
+	if (NULL != result->blob)
+		return result->blob_fields;
+
+#if defined(HAVE_MYSQL)
+	return NULL == result->result ? 0 : (int)mysql_num_fields(result->result);
+#elif defined(HAVE_ORACLE)
+	return result->ncolumn;
+#elif defined(HAVE_POSTGRESQL)
+	return NULL == result->pg_result ? 0 : PQnfields(result->pg_result);
+#elif defined(HAVE_SQLITE3)
+	return result->ncolumn;
+#else
+	return 0;
+#endif
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: db_blob_fetch                                                    *
+ *                                                                            *
+ * Purpose: fetch next row from serialized rows                               *
+ *                                                                            *
+ ******************************************************************************/
+static DB_ROW	db_blob_fetch(DB_RESULT result)
+{
+	int	i;
+
+	if (result->blob_offset >= result->blob_size)
+		return NULL;
+
+	for (i = 0; i < result->blob_fields; i++)
+	{
+		zbx_uint32_t	len;
+
+		if (result->blob_offset + sizeof(len) > result->blob_size)
+			return NULL;
+
+		memcpy(&len, result->blob + result->blob_offset, sizeof(len));
+		result->blob_offset += sizeof(len);
+
+		if (ZBX_DB_BLOB_NULL == len)
+		{
+			result->blob_row[i] = NULL;
+			continue;
+		}
+
+		if (result->blob_offset + (size_t)len + 1 > result->blob_size)
+			return NULL;
+
+		result->blob_row[i] = result->blob + result->blob_offset;
+		result->blob_offset += (size_t)len + 1;
+	}
+
+	return result->blob_row;
+}
+
 DB_ROW	zbx_db_fetch(DB_RESULT result)
 {
 #if defined(HAVE_ORACLE)
@@ -1937,6 +2801,9 @@ DB_ROW	zbx_db_fetch(DB_RESULT result)
 	if (NULL == result)
 		return NULL;
 
+	if (NULL != result->blob)
+		return db_blob_fetch(result);
+
 #if defined(HAVE_MYSQL)
 	if (NULL == result->result)
 		return NULL;
@@ -2127,6 +2994,14 @@ static void	OCI_DBclean_result(DB_RESULT result)
 
 void	DBfree_result(DB_RESULT result)
 {
+	if (NULL != result && NULL != result->blob)
+	{
+		zbx_free(result->blob_row);
+		zbx_free(result->blob);
+		zbx_free(result);
+		return;
+	}
+
 #if defined(HAVE_MYSQL)
 	if (NULL == result)
 		return;
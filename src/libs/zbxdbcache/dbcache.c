@@ -42,18 +42,33 @@
 #include "zbxalgo.h"
 #include "../zbxalgo/vectorimpl.h"
 
+#include <sys/mman.h>
+
+/* history cache and history index cache memory of the currently locked shard */
 static zbx_mem_info_t	*hc_index_mem = NULL;
 static zbx_mem_info_t	*hc_mem = NULL;
 static zbx_mem_info_t	*trend_mem = NULL;
 
-#define	LOCK_CACHE	zbx_mutex_lock(cache_lock)
-#define	UNLOCK_CACHE	zbx_mutex_unlock(cache_lock)
+#define	LOCK_SHARD(shard)				\
+							\
+do							\
+{							\
+	zbx_mutex_lock((shard)->lock);			\
+	hc_mem = (shard)->mem;				\
+	hc_index_mem = (shard)->index_mem;		\
+}							\
+while (0)
+
+#define	UNLOCK_SHARD(shard)	zbx_mutex_unlock((shard)->lock)
+
+/* the first shard lock also protects the data shared by all shards */
+#define	LOCK_CACHE	LOCK_SHARD(cache->shards[0])
+#define	UNLOCK_CACHE	UNLOCK_SHARD(cache->shards[0])
 #define	LOCK_TRENDS	zbx_mutex_lock(trends_lock)
 #define	UNLOCK_TRENDS	zbx_mutex_unlock(trends_lock)
 #define	LOCK_CACHE_IDS		zbx_mutex_lock(cache_ids_lock)
 #define	UNLOCK_CACHE_IDS	zbx_mutex_unlock(cache_ids_lock)
 
-static zbx_mutex_t	cache_lock = ZBX_MUTEX_NULL;
 static zbx_mutex_t	trends_lock = ZBX_MUTEX_NULL;
 static zbx_mutex_t	cache_ids_lock = ZBX_MUTEX_NULL;
 
@@ -61,6 +76,7 @@ static char		*sql = NULL;
 static size_t		sql_alloc = 4 * ZBX_KIBIBYTE;
 
 extern unsigned char	program_type;
+extern int		process_num;
 extern int		CONFIG_DOUBLE_PRECISION;
 extern char		*CONFIG_EXPORT_DIR;
 
@@ -68,6 +84,22 @@ extern char		*CONFIG_EXPORT_DIR;
 
 #define ZBX_HC_ITEMS_INIT_SIZE	1000
 
+/* the minimum size of history cache and history index cache memory per shard */
+#define ZBX_HC_SHARD_SIZE_MIN	(128 * ZBX_KIBIBYTE)
+
+/* the initial and maximum size of compressed history values block data */
+#define ZBX_HC_BLOCK_SIZE_MIN	64
+#define ZBX_HC_BLOCK_SIZE_MAX	1024
+
+#define ZBX_HC_SPOOL_MAGIC	"ZBXHCSPL"
+#define ZBX_HC_SPOOL_VERSION	3
+
+#define ZBX_HC_SNAPSHOT_MAGIC	"ZBXHCSNP"
+#define ZBX_HC_SNAPSHOT_VERSION	1
+
+/* the maximum number of spooled values moved back to history cache at once */
+#define ZBX_HC_SPOOL_REFILL_MAX	(ZBX_HC_SYNC_MAX * 2)
+
 #define ZBX_TRENDS_CLEANUP_TIME	((SEC_PER_HOUR * 55) / 60)
 
 /* the maximum time spent synchronizing history */
@@ -115,15 +147,97 @@ typedef struct
 }
 zbx_hc_proxyqueue_t;
 
+/* history cache spool segment header, each shard has its own segment in spool file */
+/* used as a ring buffer - when a record does not fit at the segment end, a wrap      */
+/* record of zero size is written (if there is space for it) and writing continues    */
+/* from the segment start                                                             */
 typedef struct
 {
-	zbx_hashset_t		trends;
+	char		magic[8];
+	zbx_uint32_t	version;
+	zbx_uint32_t	value_size;	/* the size of spooled item value structure */
+	zbx_uint64_t	size;		/* the segment size */
+	zbx_hash_t	checksum;	/* the checksum of the above fields */
+	zbx_uint32_t	generation;	/* the record checksum seed of the writer, incremented */
+					/* on every wrap and when the segment is emptied       */
+	zbx_uint32_t	read_generation;/* the record checksum seed of the oldest value */
+	zbx_uint32_t	reserved;
+	zbx_uint64_t	read_offset;	/* the offset of the oldest spooled value */
+	zbx_uint64_t	write_offset;	/* the offset of the next spooled value */
+	zbx_uint64_t	values_num;	/* the number of spooled values */
+	zbx_uint64_t	snapshot_num;	/* the number of the oldest spooled values preceding */
+					/* the values not loaded from history cache snapshot */
+}
+zbx_hc_spool_t;
+
+/* spooled or saved item value record, followed by item value and its strings */
+typedef struct
+{
+	zbx_uint32_t	size;		/* the record size, including header and padding */
+	zbx_hash_t	checksum;	/* the checksum of record data, seeded with segment generation */
+}
+zbx_hc_value_record_t;
+
+#define HC_SPOOL_HEADER_SIZE	ZBX_SIZE_T_ALIGN8(sizeof(zbx_hc_spool_t))
+
+/* history cache snapshot file header, followed by item value records */
+typedef struct
+{
+	char		magic[8];
+	zbx_uint32_t	version;
+	zbx_uint32_t	value_size;	/* the size of saved item value structure */
+	zbx_uint64_t	values_num;	/* the number of saved values */
+	zbx_hash_t	checksum;	/* the checksum of the above fields */
+	zbx_uint32_t	reserved;
+}
+zbx_hc_snapshot_t;
+
+/* history cache shard, items are assigned to shards by itemid */
+typedef struct
+{
+	zbx_mutex_t		lock;
+	zbx_mem_info_t		*mem;
+	zbx_mem_info_t		*index_mem;
+
 	ZBX_DC_STATS		stats;
 
 	zbx_hashset_t		history_items;
 	zbx_binary_heap_t	history_queue;
 
 	int			history_num;
+
+	/* the number of values and the memory used by compressed history value blocks */
+	zbx_uint64_t		compressed_values_num;
+	zbx_uint64_t		compressed_size;
+
+	/* the shard segment in history cache spool file, NULL if spooling is disabled */
+	zbx_hc_spool_t		*spool;
+
+	/* the values that did not fit into history cache and spool when loading history cache */
+	/* snapshot, they are moved to history cache after the spooled values preceding them   */
+	zbx_uint64_t		snapshot_offset;	/* the offset of the next record in snapshot */
+	zbx_uint64_t		snapshot_values_num;
+}
+zbx_hc_shard_t;
+
+/* compressed float or unsigned values of an item, the data follows block header */
+typedef struct zbx_hc_block
+{
+	zbx_gorilla_state_t	encoder;
+	zbx_gorilla_state_t	decoder;
+	size_t			size;
+}
+zbx_hc_block_t;
+
+#define HC_BLOCK_DATA(block)	((unsigned char *)(block) + sizeof(zbx_hc_block_t))
+
+typedef struct
+{
+	zbx_hashset_t		trends;
+
+	zbx_hc_shard_t		*shards[ZBX_HC_SHARDS_MAX];
+	int			shards_num;
+
 	int			trends_num;
 	int			trends_last_cleanup_hour;
 	int			history_num_total;
@@ -180,14 +294,20 @@ static size_t		string_values_alloc = 0, string_values_offset = 0;
 static dc_item_value_t	*item_values = NULL;
 static size_t		item_values_alloc = 0, item_values_num = 0;
 
-static void	hc_add_item_values(dc_item_value_t *values, int values_num);
-static void	hc_pop_items(zbx_vector_ptr_t *history_items);
+/* the preferred history cache shard of the current syncer process */
+static int		hc_shard_pref = 0;
+
+static void	hc_add_item_values(zbx_hc_shard_t *shard, dc_item_value_t *values, int values_num);
+static int	hc_spool_write(zbx_hc_shard_t *shard, const dc_item_value_t *item_value, const char *strings);
+static void	hc_spool_refill(zbx_hc_shard_t *shard);
+static zbx_hc_shard_t	*hc_pop_items(zbx_vector_ptr_t *history_items);
 static void	hc_get_item_values(ZBX_DC_HISTORY *history, zbx_vector_ptr_t *history_items);
-static void	hc_push_items(zbx_vector_ptr_t *history_items);
+static void	hc_push_items(zbx_hc_shard_t *shard, zbx_vector_ptr_t *history_items);
 static void	hc_free_item_values(ZBX_DC_HISTORY *history, int history_num);
-static void	hc_queue_item(zbx_hc_item_t *item);
+static void	hc_queue_item(zbx_hc_shard_t *shard, zbx_hc_item_t *item);
 static int	hc_queue_elem_compare_func(const void *d1, const void *d2);
 static int	hc_queue_get_size(void);
+static int	hc_get_history_num(void);
 static int	hc_get_history_compression_age(void);
 
 ZBX_PTR_VECTOR_DECL(item_tag, zbx_tag_t)
@@ -195,6 +315,56 @@ ZBX_PTR_VECTOR_IMPL(item_tag, zbx_tag_t)
 
 ZBX_PTR_VECTOR_IMPL(tags, zbx_tag_t*)
 
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_get_shards_stats                                              *
+ *                                                                            *
+ * Purpose: retrieves statistics of one or all history cache shards          *
+ *                                                                            *
+ * Parameters: shard_index - [IN] the shard index or ZBX_HC_SHARD_ALL         *
+ *             stats       - [OUT] the value counters                         *
+ *             mem_total   - [OUT] the total size of history cache            *
+ *             mem_free    - [OUT] the free size of history cache             *
+ *             index_total - [OUT] the total size of history index cache      *
+ *             index_free  - [OUT] the free size of history index cache       *
+ *                                                                            *
+ ******************************************************************************/
+static void	hc_get_shards_stats(int shard_index, ZBX_DC_STATS *stats, zbx_uint64_t *mem_total,
+		zbx_uint64_t *mem_free, zbx_uint64_t *index_total, zbx_uint64_t *index_free)
+{
+	int	i;
+
+	memset(stats, 0, sizeof(ZBX_DC_STATS));
+	*mem_total = *mem_free = *index_total = *index_free = 0;
+
+	for (i = 0; i < cache->shards_num; i++)
+	{
+		zbx_hc_shard_t	*shard;
+
+		if (ZBX_HC_SHARD_ALL != shard_index && i != shard_index)
+			continue;
+
+		shard = cache->shards[i];
+
+		LOCK_SHARD(shard);
+
+		stats->history_counter += shard->stats.history_counter;
+		stats->history_float_counter += shard->stats.history_float_counter;
+		stats->history_uint_counter += shard->stats.history_uint_counter;
+		stats->history_str_counter += shard->stats.history_str_counter;
+		stats->history_log_counter += shard->stats.history_log_counter;
+		stats->history_text_counter += shard->stats.history_text_counter;
+		stats->notsupported_counter += shard->stats.notsupported_counter;
+
+		*mem_total += shard->mem->total_size;
+		*mem_free += shard->mem->free_size;
+		*index_total += shard->index_mem->total_size;
+		*index_free += shard->index_mem->free_size;
+
+		UNLOCK_SHARD(shard);
+	}
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: DCget_stats_all                                                  *
@@ -206,141 +376,181 @@ ZBX_PTR_VECTOR_IMPL(tags, zbx_tag_t*)
  ******************************************************************************/
 void	DCget_stats_all(zbx_wcache_info_t *wcache_info)
 {
-	LOCK_CACHE;
-
-	wcache_info->stats = cache->stats;
-	wcache_info->history_free = hc_mem->free_size;
-	wcache_info->history_total = hc_mem->total_size;
-	wcache_info->index_free = hc_index_mem->free_size;
-	wcache_info->index_total = hc_index_mem->total_size;
+	hc_get_shards_stats(ZBX_HC_SHARD_ALL, &wcache_info->stats, &wcache_info->history_total,
+			&wcache_info->history_free, &wcache_info->index_total, &wcache_info->index_free);
 
 	if (0 != (program_type & ZBX_PROGRAM_TYPE_SERVER))
 	{
+		LOCK_CACHE;
+
 		wcache_info->trend_free = trend_mem->free_size;
 		wcache_info->trend_total = trend_mem->orig_size;
-	}
 
-	UNLOCK_CACHE;
+		UNLOCK_CACHE;
+	}
 }
 
 /******************************************************************************
  *                                                                            *
- * Function: DCget_stats                                                      *
+ * Function: DCget_shard_stats                                                *
  *                                                                            *
- * Purpose: get statistics of the database cache                              *
+ * Purpose: get statistics of the database cache or of a single history       *
+ *          cache shard                                                       *
  *                                                                            *
- * Author: Alexander Vladishev                                                *
+ * Parameters: request     - [IN] the requested statistics (ZBX_STATS_*)      *
+ *             shard_index - [IN] the history cache shard index or            *
+ *                                ZBX_HC_SHARD_ALL for all shards             *
+ *                                                                            *
+ * Return value: pointer to the requested value or NULL if the request or     *
+ *               shard index is invalid                                       *
+ *                                                                            *
+ * Comments: Trend cache statistics are not sharded, so only ZBX_HC_SHARD_ALL *
+ *           is accepted for them.                                            *
  *                                                                            *
  ******************************************************************************/
-void	*DCget_stats(int request)
+void	*DCget_shard_stats(int request, int shard_index)
 {
 	static zbx_uint64_t	value_uint;
 	static double		value_double;
 	void			*ret;
+	ZBX_DC_STATS		stats;
+	zbx_uint64_t		mem_total, mem_free, index_total, index_free;
 
-	LOCK_CACHE;
+	if (ZBX_HC_SHARD_ALL != shard_index && (0 > shard_index || shard_index >= cache->shards_num))
+		return NULL;
+
+	if (ZBX_STATS_TREND_TOTAL <= request && ZBX_STATS_TREND_PFREE >= request)
+	{
+		if (ZBX_HC_SHARD_ALL != shard_index)
+			return NULL;
+
+		LOCK_CACHE;
+
+		switch (request)
+		{
+			case ZBX_STATS_TREND_TOTAL:
+				value_uint = trend_mem->orig_size;
+				ret = (void *)&value_uint;
+				break;
+			case ZBX_STATS_TREND_USED:
+				value_uint = trend_mem->orig_size - trend_mem->free_size;
+				ret = (void *)&value_uint;
+				break;
+			case ZBX_STATS_TREND_FREE:
+				value_uint = trend_mem->free_size;
+				ret = (void *)&value_uint;
+				break;
+			case ZBX_STATS_TREND_PUSED:
+				value_double = 100 * (double)(trend_mem->orig_size - trend_mem->free_size) /
+						trend_mem->orig_size;
+				ret = (void *)&value_double;
+				break;
+			case ZBX_STATS_TREND_PFREE:
+				value_double = 100 * (double)trend_mem->free_size / trend_mem->orig_size;
+				ret = (void *)&value_double;
+				break;
+			default:
+				ret = NULL;
+		}
+
+		UNLOCK_CACHE;
+
+		return ret;
+	}
+
+	hc_get_shards_stats(shard_index, &stats, &mem_total, &mem_free, &index_total, &index_free);
 
 	switch (request)
 	{
 		case ZBX_STATS_HISTORY_COUNTER:
-			value_uint = cache->stats.history_counter;
+			value_uint = stats.history_counter;
 			ret = (void *)&value_uint;
 			break;
 		case ZBX_STATS_HISTORY_FLOAT_COUNTER:
-			value_uint = cache->stats.history_float_counter;
+			value_uint = stats.history_float_counter;
 			ret = (void *)&value_uint;
 			break;
 		case ZBX_STATS_HISTORY_UINT_COUNTER:
-			value_uint = cache->stats.history_uint_counter;
+			value_uint = stats.history_uint_counter;
 			ret = (void *)&value_uint;
 			break;
 		case ZBX_STATS_HISTORY_STR_COUNTER:
-			value_uint = cache->stats.history_str_counter;
+			value_uint = stats.history_str_counter;
 			ret = (void *)&value_uint;
 			break;
 		case ZBX_STATS_HISTORY_LOG_COUNTER:
-			value_uint = cache->stats.history_log_counter;
+			value_uint = stats.history_log_counter;
 			ret = (void *)&value_uint;
 			break;
 		case ZBX_STATS_HISTORY_TEXT_COUNTER:
-			value_uint = cache->stats.history_text_counter;
+			value_uint = stats.history_text_counter;
 			ret = (void *)&value_uint;
 			break;
 		case ZBX_STATS_NOTSUPPORTED_COUNTER:
-			value_uint = cache->stats.notsupported_counter;
+			value_uint = stats.notsupported_counter;
 			ret = (void *)&value_uint;
 			break;
 		case ZBX_STATS_HISTORY_TOTAL:
-			value_uint = hc_mem->total_size;
+			value_uint = mem_total;
 			ret = (void *)&value_uint;
 			break;
 		case ZBX_STATS_HISTORY_USED:
-			value_uint = hc_mem->total_size - hc_mem->free_size;
+			value_uint = mem_total - mem_free;
 			ret = (void *)&value_uint;
 			break;
 		case ZBX_STATS_HISTORY_FREE:
-			value_uint = hc_mem->free_size;
+			value_uint = mem_free;
 			ret = (void *)&value_uint;
 			break;
 		case ZBX_STATS_HISTORY_PUSED:
-			value_double = 100 * (double)(hc_mem->total_size - hc_mem->free_size) / hc_mem->total_size;
+			value_double = 100 * (double)(mem_total - mem_free) / mem_total;
 			ret = (void *)&value_double;
 			break;
 		case ZBX_STATS_HISTORY_PFREE:
-			value_double = 100 * (double)hc_mem->free_size / hc_mem->total_size;
-			ret = (void *)&value_double;
-			break;
-		case ZBX_STATS_TREND_TOTAL:
-			value_uint = trend_mem->orig_size;
-			ret = (void *)&value_uint;
-			break;
-		case ZBX_STATS_TREND_USED:
-			value_uint = trend_mem->orig_size - trend_mem->free_size;
-			ret = (void *)&value_uint;
-			break;
-		case ZBX_STATS_TREND_FREE:
-			value_uint = trend_mem->free_size;
-			ret = (void *)&value_uint;
-			break;
-		case ZBX_STATS_TREND_PUSED:
-			value_double = 100 * (double)(trend_mem->orig_size - trend_mem->free_size) /
-					trend_mem->orig_size;
-			ret = (void *)&value_double;
-			break;
-		case ZBX_STATS_TREND_PFREE:
-			value_double = 100 * (double)trend_mem->free_size / trend_mem->orig_size;
+			value_double = 100 * (double)mem_free / mem_total;
 			ret = (void *)&value_double;
 			break;
 		case ZBX_STATS_HISTORY_INDEX_TOTAL:
-			value_uint = hc_index_mem->total_size;
+			value_uint = index_total;
 			ret = (void *)&value_uint;
 			break;
 		case ZBX_STATS_HISTORY_INDEX_USED:
-			value_uint = hc_index_mem->total_size - hc_index_mem->free_size;
+			value_uint = index_total - index_free;
 			ret = (void *)&value_uint;
 			break;
 		case ZBX_STATS_HISTORY_INDEX_FREE:
-			value_uint = hc_index_mem->free_size;
+			value_uint = index_free;
 			ret = (void *)&value_uint;
 			break;
 		case ZBX_STATS_HISTORY_INDEX_PUSED:
-			value_double = 100 * (double)(hc_index_mem->total_size - hc_index_mem->free_size) /
-					hc_index_mem->total_size;
+			value_double = 100 * (double)(index_total - index_free) / index_total;
 			ret = (void *)&value_double;
 			break;
 		case ZBX_STATS_HISTORY_INDEX_PFREE:
-			value_double = 100 * (double)hc_index_mem->free_size / hc_index_mem->total_size;
+			value_double = 100 * (double)index_free / index_total;
 			ret = (void *)&value_double;
 			break;
 		default:
 			ret = NULL;
 	}
 
-	UNLOCK_CACHE;
-
 	return ret;
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: DCget_stats                                                      *
+ *                                                                            *
+ * Purpose: get statistics of the database cache                              *
+ *                                                                            *
+ * Author: Alexander Vladishev                                                *
+ *                                                                            *
+ ******************************************************************************/
+void	*DCget_stats(int request)
+{
+	return DCget_shard_stats(request, ZBX_HC_SHARD_ALL);
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: DCget_trend                                                      *
@@ -667,6 +877,178 @@ static void	dc_trends_fetch_and_update(ZBX_DC_TREND *trends, int trends_num, zbx
 		DBexecute("%s", sql);
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: dc_trends_upsert_supported                                       *
+ *                                                                            *
+ * Purpose: checks if trends can be merged with existing database records by  *
+ *          a single insert statement                                         *
+ *                                                                            *
+ * Return value: SUCCEED - insert on conflict update is supported            *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+static int	dc_trends_upsert_supported(void)
+{
+#if defined(HAVE_POSTGRESQL)
+	/* on conflict clause is supported since PostgreSQL 9.5 */
+	if (90500 > zbx_dbms_version_get())
+		return FAIL;
+
+	return SUCCEED;
+#elif defined(HAVE_MYSQL)
+	return SUCCEED;
+#else
+	return FAIL;
+#endif
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: dc_trends_upsert_suffix                                          *
+ *                                                                            *
+ * Purpose: adds the clause merging inserted trend with existing record       *
+ *                                                                            *
+ * Comments: The average value of existing and inserted trend is weighted by  *
+ *           number of values the same way as in dc_trends_update_float() and *
+ *           dc_trends_update_uint() - floating point averages are divided    *
+ *           before multiplying, so the sum cannot overflow, and unsigned     *
+ *           averages are summed as decimals and truncated.                   *
+ *                                                                            *
+ ******************************************************************************/
+static void	dc_trends_upsert_suffix(unsigned char value_type, const char *table_name, size_t *sql_offset)
+{
+#if defined(HAVE_POSTGRESQL)
+	zbx_snprintf_alloc(&sql, &sql_alloc, sql_offset,
+			" on conflict (itemid,clock) do update set"
+			" num=%s.num+excluded.num,"
+			"value_min=least(%s.value_min,excluded.value_min),"
+			"value_max=greatest(%s.value_max,excluded.value_max),",
+			table_name, table_name, table_name);
+
+	if (ITEM_VALUE_TYPE_FLOAT == value_type)
+	{
+		/* num is a 32 bit integer, so it's divided as double */
+		zbx_snprintf_alloc(&sql, &sql_alloc, sql_offset,
+				"value_avg=%s.value_avg/(%s.num+excluded.num)::double precision*%s.num+"
+				"excluded.value_avg/(%s.num+excluded.num)::double precision*excluded.num",
+				table_name, table_name, table_name, table_name);
+	}
+	else
+	{
+		/* value_avg is numeric(20,0), so the products are calculated without overflow */
+		zbx_snprintf_alloc(&sql, &sql_alloc, sql_offset,
+				"value_avg=trunc((%s.value_avg*%s.num+excluded.value_avg*excluded.num)/"
+				"(%s.num+excluded.num))",
+				table_name, table_name, table_name);
+	}
+#elif defined(HAVE_MYSQL)
+	ZBX_UNUSED(table_name);
+
+	/* the columns are assigned from left to right, so num must be updated last */
+	zbx_strcpy_alloc(&sql, &sql_alloc, sql_offset,
+			" on duplicate key update"
+			" value_min=least(value_min,values(value_min)),"
+			"value_max=greatest(value_max,values(value_max)),");
+
+	if (ITEM_VALUE_TYPE_FLOAT == value_type)
+	{
+		zbx_strcpy_alloc(&sql, &sql_alloc, sql_offset,
+				"value_avg=value_avg/(num+values(num))*num+"
+				"values(value_avg)/(num+values(num))*values(num),");
+	}
+	else
+	{
+		/* bigint unsigned multiplication overflows with error, so decimals are used */
+		zbx_strcpy_alloc(&sql, &sql_alloc, sql_offset,
+				"value_avg=truncate((cast(value_avg as decimal(20,0))*num+"
+				"cast(values(value_avg) as decimal(20,0))*values(num))/(num+values(num)),0),");
+	}
+
+	zbx_strcpy_alloc(&sql, &sql_alloc, sql_offset, "num=num+values(num)");
+#else
+	ZBX_UNUSED(value_type);
+	ZBX_UNUSED(table_name);
+	ZBX_UNUSED(sql_offset);
+#endif
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: dc_upsert_trends_in_db                                           *
+ *                                                                            *
+ * Purpose: inserts trends into database, merging them with existing records  *
+ *          of the same hour                                                  *
+ *                                                                            *
+ * Comments: A helper function for DCflush trends, replacing the selection    *
+ *           and update of existing trend records with one statement per      *
+ *           batch of trends.                                                 *
+ *                                                                            *
+ ******************************************************************************/
+static void	dc_upsert_trends_in_db(ZBX_DC_TREND *trends, int trends_num, unsigned char value_type,
+		const char *table_name, int clock)
+{
+	ZBX_DC_TREND	*trend;
+	int		i, rows_num = 0;
+	size_t		sql_offset = 0;
+
+	for (i = 0; i < trends_num; i++)
+	{
+		trend = &trends[i];
+
+		if (0 == trend->itemid)
+			continue;
+
+		if (clock != trend->clock || value_type != trend->value_type)
+			continue;
+
+		if (0 == rows_num)
+		{
+			zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset, "insert into %s"
+					" (itemid,clock,num,value_min,value_avg,value_max) values ", table_name);
+		}
+		else
+			zbx_chrcpy_alloc(&sql, &sql_alloc, &sql_offset, ',');
+
+		if (ITEM_VALUE_TYPE_FLOAT == value_type)
+		{
+			zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset, "(" ZBX_FS_UI64 ",%d,%d," ZBX_FS_DBL64_SQL
+					"," ZBX_FS_DBL64_SQL "," ZBX_FS_DBL64_SQL ")",
+					trend->itemid, trend->clock, trend->num, trend->value_min.dbl,
+					trend->value_avg.dbl, trend->value_max.dbl);
+		}
+		else
+		{
+			zbx_uint128_t	avg;
+
+			/* calculate the trend average value */
+			udiv128_64(&avg, &trend->value_avg.ui64, trend->num);
+
+			zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset, "(" ZBX_FS_UI64 ",%d,%d," ZBX_FS_UI64 ","
+					ZBX_FS_UI64 "," ZBX_FS_UI64 ")",
+					trend->itemid, trend->clock, trend->num, trend->value_min.ui64, avg.lo,
+					trend->value_max.ui64);
+		}
+
+		trend->itemid = 0;
+
+		if (ZBX_HC_SYNC_MAX == ++rows_num)
+		{
+			dc_trends_upsert_suffix(value_type, table_name, &sql_offset);
+			DBexecute("%s", sql);
+
+			sql_offset = 0;
+			rows_num = 0;
+		}
+	}
+
+	if (0 != rows_num)
+	{
+		dc_trends_upsert_suffix(value_type, table_name, &sql_offset);
+		DBexecute("%s", sql);
+	}
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: DBflush_trends                                                   *
@@ -701,6 +1083,12 @@ static void	DBflush_trends(ZBX_DC_TREND *trends, int *trends_num, zbx_vector_uin
 			assert(0);
 	}
 
+	if (SUCCEED == dc_trends_upsert_supported())
+	{
+		dc_upsert_trends_in_db(trends, *trends_num, value_type, table_name, clock);
+		goto clean;
+	}
+
 	itemids_alloc = MIN(ZBX_HC_SYNC_MAX, *trends_num);
 	itemids = (zbx_uint64_t *)zbx_malloc(itemids, itemids_alloc * sizeof(zbx_uint64_t));
 
@@ -777,7 +1165,7 @@ static void	DBflush_trends(ZBX_DC_TREND *trends, int *trends_num, zbx_vector_uin
 
 	if (0 != inserts_num)
 		dc_insert_trends_in_db(trends, trends_to, value_type, table_name, clock);
-
+clean:
 	/* clean trends */
 	for (i = 0, num = 0; i < *trends_num; i++)
 	{
@@ -1996,7 +2384,8 @@ static void	normalize_item_value(const DC_ITEM *item, ZBX_DC_HISTORY *hdata)
  *                                                                            *
  * Return value: The update data. This data must be freed by the caller.      *
  *                                                                            *
- * Comments: Will generate internal events when item state switches.          *
+ * Comments: Internal events for item state switches are generated later by   *
+ *           DCmass_add_internal_events().                                    *
  *                                                                            *
  ******************************************************************************/
 static zbx_item_diff_t	*calculate_item_update(const DC_ITEM *item, const ZBX_DC_HISTORY *h)
@@ -2023,9 +2412,6 @@ static zbx_item_diff_t	*calculate_item_update(const DC_ITEM *item, const ZBX_DC_
 			zabbix_log(LOG_LEVEL_WARNING, "item \"%s:%s\" became not supported: %s",
 					item->host.host, item->key_orig, h->value.str);
 
-			zbx_add_event(EVENT_SOURCE_INTERNAL, EVENT_OBJECT_ITEM, item->itemid, &h->ts, h->state, NULL,
-					NULL, NULL, 0, 0, NULL, 0, NULL, 0, NULL, NULL, h->value.err);
-
 			if (0 != strcmp(item->error, h->value.err))
 				item_error = h->value.err;
 		}
@@ -2034,11 +2420,6 @@ static zbx_item_diff_t	*calculate_item_update(const DC_ITEM *item, const ZBX_DC_
 			zabbix_log(LOG_LEVEL_WARNING, "item \"%s:%s\" became supported",
 					item->host.host, item->key_orig);
 
-			/* we know it's EVENT_OBJECT_ITEM because LLDRULE that becomes */
-			/* supported is handled in lld_process_discovery_rule()        */
-			zbx_add_event(EVENT_SOURCE_INTERNAL, EVENT_OBJECT_ITEM, item->itemid, &h->ts, h->state,
-					NULL, NULL, NULL, 0, 0, NULL, 0, NULL, 0, NULL, NULL, NULL);
-
 			item_error = "";
 		}
 	}
@@ -2202,59 +2583,179 @@ static void	DBmass_proxy_update_items(zbx_vector_ptr_t *item_diff)
 
 /******************************************************************************
  *                                                                            *
- * Function: DBmass_add_history                                               *
+ * Function: DCmass_add_internal_events                                       *
  *                                                                            *
- * Purpose: inserting new history data after new value is received            *
+ * Purpose: generates internal events for items that switched state           *
  *                                                                            *
- * Parameters: history     - array of history data                            *
- *             history_num - number of history structures                     *
+ * Parameters: history     - [IN] array of history data                       *
+ *             history_num - [IN] number of history structures                *
+ *             item_diff   - [IN] the changes in item data, sorted by itemid  *
  *                                                                            *
  ******************************************************************************/
-static int	DBmass_add_history(ZBX_DC_HISTORY *history, int history_num)
+static void	DCmass_add_internal_events(const ZBX_DC_HISTORY *history, int history_num,
+		const zbx_vector_ptr_t *item_diff)
 {
-	int			i, ret = SUCCEED;
-	zbx_vector_ptr_t	history_values;
-
-	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
-
-	zbx_vector_ptr_create(&history_values);
-	zbx_vector_ptr_reserve(&history_values, history_num);
+	int	i, index;
 
 	for (i = 0; i < history_num; i++)
 	{
-		ZBX_DC_HISTORY	*h = &history[i];
+		const ZBX_DC_HISTORY	*h = &history[i];
+		const zbx_item_diff_t	*diff;
 
-		if (0 != (ZBX_DC_FLAGS_NOT_FOR_HISTORY & h->flags))
+		if (FAIL == (index = zbx_vector_ptr_bsearch(item_diff, &h->itemid,
+				ZBX_DEFAULT_UINT64_PTR_COMPARE_FUNC)))
+		{
 			continue;
+		}
 
-		zbx_vector_ptr_append(&history_values, h);
-	}
-
-	if (0 != history_values.values_num)
-		ret = zbx_vc_add_values(&history_values);
-
-	zbx_vector_ptr_destroy(&history_values);
+		diff = (const zbx_item_diff_t *)item_diff->values[index];
 
-	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
+		if (0 == (ZBX_FLAGS_ITEM_DIFF_UPDATE_STATE & diff->flags))
+			continue;
 
-	return ret;
+		/* we know it's EVENT_OBJECT_ITEM because LLDRULE that changes */
+		/* state is handled in lld_process_discovery_rule()            */
+		zbx_add_event(EVENT_SOURCE_INTERNAL, EVENT_OBJECT_ITEM, h->itemid, &h->ts, h->state, NULL, NULL,
+				NULL, 0, 0, NULL, 0, NULL, 0, NULL, NULL,
+				ITEM_STATE_NOTSUPPORTED == h->state ? h->value.err : NULL);
+	}
 }
 
 /******************************************************************************
  *                                                                            *
- * Function: dc_add_proxy_history                                             *
+ * Function: DCmass_get_history_values                                        *
  *                                                                            *
- * Purpose: helper function for DCmass_proxy_add_history()                    *
+ * Purpose: selects history data to be written into history storage          *
  *                                                                            *
- * Comment: this function is meant for items with value_type other other than *
- *          ITEM_VALUE_TYPE_LOG not containing meta information in result     *
+ * Parameters: history        - [IN] array of history data                    *
+ *             history_num    - [IN] number of history structures             *
+ *             history_values - [OUT] the history data to write               *
  *                                                                            *
  ******************************************************************************/
-static void	dc_add_proxy_history(ZBX_DC_HISTORY *history, int history_num)
+static void	DCmass_get_history_values(ZBX_DC_HISTORY *history, int history_num, zbx_vector_ptr_t *history_values)
 {
-	int		i, now;
-	unsigned int	flags;
-	char		buffer[64], *pvalue;
+	int	i;
+
+	zbx_vector_ptr_reserve(history_values, history_num);
+
+	for (i = 0; i < history_num; i++)
+	{
+		ZBX_DC_HISTORY	*h = &history[i];
+
+		if (0 != (ZBX_DC_FLAGS_NOT_FOR_HISTORY & h->flags))
+			continue;
+
+		zbx_vector_ptr_append(history_values, h);
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: DBmass_add_history                                               *
+ *                                                                            *
+ * Purpose: inserting new history data after new value is received            *
+ *                                                                            *
+ * Parameters: history     - array of history data                            *
+ *             history_num - number of history structures                     *
+ *                                                                            *
+ ******************************************************************************/
+static int	DBmass_add_history(ZBX_DC_HISTORY *history, int history_num)
+{
+	int			ret = SUCCEED;
+	zbx_vector_ptr_t	history_values;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+
+	zbx_vector_ptr_create(&history_values);
+	DCmass_get_history_values(history, history_num, &history_values);
+
+	if (0 != history_values.values_num)
+		ret = zbx_vc_add_values(&history_values);
+
+	zbx_vector_ptr_destroy(&history_values);
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: DBmass_add_history_async                                         *
+ *                                                                            *
+ * Purpose: starts writing new history data without waiting for the result   *
+ *                                                                            *
+ * Parameters: history        - [IN] array of history data                    *
+ *             history_num    - [IN] number of history structures             *
+ *             history_values - [OUT] the history data being written          *
+ *                                                                            *
+ * Return value: SUCCEED - the history data is being written,                 *
+ *                         DBmass_wait_history() must be called to complete   *
+ *                         writing it                                         *
+ *               FAIL    - history storage does not support asynchronous      *
+ *                         writes, DBmass_add_history() must be used instead  *
+ *                                                                            *
+ ******************************************************************************/
+static int	DBmass_add_history_async(ZBX_DC_HISTORY *history, int history_num, zbx_vector_ptr_t *history_values)
+{
+	int	ret = SUCCEED;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+
+	DCmass_get_history_values(history, history_num, history_values);
+
+	if (0 != history_values->values_num && SUCCEED != (ret = zbx_vc_add_values_async(history_values)))
+		zbx_vector_ptr_clear(history_values);
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%s", __func__, zbx_result_string(ret));
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: DBmass_wait_history                                              *
+ *                                                                            *
+ * Purpose: waits for history data written by DBmass_add_history_async()      *
+ *                                                                            *
+ * Parameters: history_values - [IN/OUT] the history data being written       *
+ *                                                                            *
+ * Return value: SUCCEED - the history data was written                       *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+static int	DBmass_wait_history(zbx_vector_ptr_t *history_values)
+{
+	int	ret = SUCCEED;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+
+	if (0 != history_values->values_num)
+	{
+		ret = zbx_vc_wait_values(history_values);
+		zbx_vector_ptr_clear(history_values);
+	}
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%s", __func__, zbx_result_string(ret));
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: dc_add_proxy_history                                             *
+ *                                                                            *
+ * Purpose: helper function for DCmass_proxy_add_history()                    *
+ *                                                                            *
+ * Comment: this function is meant for items with value_type other other than *
+ *          ITEM_VALUE_TYPE_LOG not containing meta information in result     *
+ *                                                                            *
+ ******************************************************************************/
+static void	dc_add_proxy_history(ZBX_DC_HISTORY *history, int history_num)
+{
+	int		i, now;
+	unsigned int	flags;
+	char		buffer[64], *pvalue;
 	zbx_db_insert_t	db_insert;
 
 	now = (int)time(NULL);
@@ -2927,6 +3428,7 @@ static void	sync_proxy_history(int *total_num, int *more)
 	time_t			sync_start;
 	zbx_vector_ptr_t	history_items;
 	zbx_vector_ptr_t	item_diff;
+	zbx_hc_shard_t		*shard;
 	ZBX_DC_HISTORY		history[ZBX_HC_SYNC_MAX];
 
 	zbx_vector_ptr_create(&history_items);
@@ -2939,14 +3441,9 @@ static void	sync_proxy_history(int *total_num, int *more)
 	{
 		*more = ZBX_SYNC_DONE;
 
-		LOCK_CACHE;
-
-		hc_pop_items(&history_items);		/* select and take items out of history cache */
-		history_num = history_items.values_num;
+		shard = hc_pop_items(&history_items);	/* select and take items out of history cache */
 
-		UNLOCK_CACHE;
-
-		if (0 == history_num)
+		if (0 == (history_num = history_items.values_num))
 			break;
 
 		hc_get_item_values(history, &history_items);	/* copy item data from history cache */
@@ -2963,22 +3460,22 @@ static void	sync_proxy_history(int *total_num, int *more)
 		}
 		while (ZBX_DB_DOWN == (txn_rc = DBcommit()));
 
-		LOCK_CACHE;
+		LOCK_SHARD(shard);
 
-		hc_push_items(&history_items);	/* return items to history cache */
+		hc_push_items(shard, &history_items);	/* return items to history cache */
 
 		if (ZBX_DB_FAIL != txn_rc)
 		{
 			if (0 != item_diff.values_num)
 				DCconfig_items_apply_changes(&item_diff);
 
-			cache->history_num -= history_num;
+			shard->history_num -= history_num;
+
+			UNLOCK_SHARD(shard);
 
 			if (0 != hc_queue_get_size())
 				*more = ZBX_SYNC_MORE;
 
-			UNLOCK_CACHE;
-
 			*total_num += history_num;
 
 			hc_free_item_values(history, history_num);
@@ -2986,7 +3483,7 @@ static void	sync_proxy_history(int *total_num, int *more)
 		else
 		{
 			*more = ZBX_SYNC_MORE;
-			UNLOCK_CACHE;
+			UNLOCK_SHARD(shard);
 		}
 
 		zbx_vector_ptr_clear(&history_items);
@@ -3002,47 +3499,208 @@ static void	sync_proxy_history(int *total_num, int *more)
 	zbx_vector_ptr_destroy(&history_items);
 }
 
+/* history synchronization batch */
+typedef struct
+{
+	ZBX_DC_HISTORY			*history;
+	int				history_num;
+	zbx_hc_shard_t			*shard;
+	zbx_vector_ptr_t		history_items;
+	zbx_vector_ptr_t		history_values;		/* values being written asynchronously */
+	zbx_vector_uint64_t		itemids;
+	zbx_vector_uint64_t		triggerids;
+	zbx_vector_ptr_t		item_diff;
+	zbx_vector_ptr_t		inventory_values;
+	zbx_vector_uint64_pair_t	proxy_subscribtions;
+	DC_ITEM				*items;
+	int				*errcodes;
+	ZBX_DC_TREND			*trends;
+	int				trends_num;
+	int				ret;
+}
+zbx_hc_sync_batch_t;
+
 /******************************************************************************
  *                                                                            *
- * Function: sync_server_history                                              *
+ * Function: hc_sync_batch_init                                               *
  *                                                                            *
- * Purpose: flush history cache to database, process triggers of flushed      *
- *          and timer triggers from timer queue                               *
+ * Purpose: allocates history synchronization batch resources                 *
  *                                                                            *
- * Parameters: sync_timeout - [IN] the timeout in seconds                     *
- *             values_num   - [IN/OUT] the number of synced values            *
- *             triggers_num - [IN/OUT] the number of processed timers         *
- *             more         - [OUT] a flag indicating the cache emptiness:    *
- *                               ZBX_SYNC_DONE - nothing to sync, go idle     *
- *                               ZBX_SYNC_MORE - more data to sync            *
+ ******************************************************************************/
+static void	hc_sync_batch_init(zbx_hc_sync_batch_t *batch)
+{
+	memset(batch, 0, sizeof(zbx_hc_sync_batch_t));
+
+	batch->history = (ZBX_DC_HISTORY *)zbx_malloc(NULL, ZBX_HC_SYNC_MAX * sizeof(ZBX_DC_HISTORY));
+
+	zbx_vector_ptr_create(&batch->history_items);
+	zbx_vector_ptr_reserve(&batch->history_items, ZBX_HC_SYNC_MAX);
+	zbx_vector_ptr_create(&batch->history_values);
+	zbx_vector_uint64_create(&batch->itemids);
+	zbx_vector_uint64_create(&batch->triggerids);
+	zbx_vector_uint64_reserve(&batch->triggerids, ZBX_HC_SYNC_MAX);
+	zbx_vector_ptr_create(&batch->item_diff);
+	zbx_vector_ptr_create(&batch->inventory_values);
+	zbx_vector_uint64_pair_create(&batch->proxy_subscribtions);
+}
+
+/******************************************************************************
  *                                                                            *
- * Comments: This function loops syncing history values by 1k batches and     *
- *           processing timer triggers by batches of 500 triggers.            *
- *           Unless full sync is being done the loop is aborted if either     *
- *           timeout has passed or there are no more data to process.         *
- *           The last is assumed when the following is true:                  *
- *            a) history cache is empty or less than 10% of batch values were *
- *               processed (the other items were locked by triggers)          *
- *            b) less than 500 (full batch) timer triggers were processed     *
+ * Function: sync_server_history_prepare                                      *
+ *                                                                            *
+ * Purpose: takes the next batch of values out of history cache and prepares  *
+ *          them for writing                                                  *
+ *                                                                            *
+ * Parameters: batch              - [OUT] the history synchronization batch   *
+ *             item_retrieve_mode - [IN] the item configuration to retrieve   *
+ *             compression_age    - [IN] history compression age              *
+ *                                                                            *
+ * Comments: The triggers of the taken items are locked until the batch is    *
+ *           finished, so items sharing triggers with a batch in progress are *
+ *           left in history cache. This keeps values of an item and trigger  *
+ *           processing ordered even when batches are overlapped.             *
  *                                                                            *
  ******************************************************************************/
-static void	sync_server_history(int *values_num, int *triggers_num, int *more)
+static void	sync_server_history_prepare(zbx_hc_sync_batch_t *batch, unsigned int item_retrieve_mode,
+		int compression_age)
+{
+	int	i;
+
+	batch->ret = SUCCEED;
+	batch->trends = NULL;
+	batch->trends_num = 0;
+
+	batch->shard = hc_pop_items(&batch->history_items);	/* select and take items out of history cache */
+
+	if (0 != batch->history_items.values_num)
+	{
+		if (0 == (batch->history_num = DCconfig_lock_triggers_by_history_items(&batch->history_items,
+				&batch->triggerids)))
+		{
+			LOCK_SHARD(batch->shard);
+			hc_push_items(batch->shard, &batch->history_items);
+			UNLOCK_SHARD(batch->shard);
+			zbx_vector_ptr_clear(&batch->history_items);
+		}
+	}
+	else
+		batch->history_num = 0;
+
+	if (0 == batch->history_num)
+		return;
+
+	hc_get_item_values(batch->history, &batch->history_items);	/* copy item data from history cache */
+
+	batch->items = (DC_ITEM *)zbx_malloc(NULL, sizeof(DC_ITEM) * (size_t)batch->history_num);
+	batch->errcodes = (int *)zbx_malloc(NULL, sizeof(int) * (size_t)batch->history_num);
+
+	zbx_vector_uint64_reserve(&batch->itemids, batch->history_num);
+
+	for (i = 0; i < batch->history_num; i++)
+		zbx_vector_uint64_append(&batch->itemids, batch->history[i].itemid);
+
+	zbx_vector_uint64_sort(&batch->itemids, ZBX_DEFAULT_UINT64_COMPARE_FUNC);
+
+	DCconfig_get_items_by_itemids_partial(batch->items, batch->itemids.values, batch->errcodes,
+			batch->history_num, item_retrieve_mode);
+
+	DCmass_prepare_history(batch->history, &batch->itemids, batch->items, batch->errcodes, batch->history_num,
+			&batch->item_diff, &batch->inventory_values, compression_age, &batch->proxy_subscribtions);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: sync_server_history_update                                       *
+ *                                                                            *
+ * Purpose: writes history of the batch and updates items and trends          *
+ *                                                                            *
+ * Parameters: batch           - [IN/OUT] the history synchronization batch   *
+ *             async           - [IN] 1 - the history is being written by     *
+ *                                        DBmass_add_history_async()          *
+ *                                    0 - otherwise                           *
+ *             compression_age - [IN] history compression age                 *
+ *                                                                            *
+ ******************************************************************************/
+static void	sync_server_history_update(zbx_hc_sync_batch_t *batch, int async, int compression_age)
+{
+	int				txn_error;
+	zbx_vector_uint64_pair_t	trends_diff;
+
+	if (0 == batch->history_num)
+		return;
+
+	if (0 != async)
+		batch->ret = DBmass_wait_history(&batch->history_values);
+	else
+		batch->ret = DBmass_add_history(batch->history, batch->history_num);
+
+	if (FAIL != batch->ret)
+	{
+		DCmass_add_internal_events(batch->history, batch->history_num, &batch->item_diff);
+		DCconfig_items_apply_changes(&batch->item_diff);
+		DCmass_update_trends(batch->history, batch->history_num, &batch->trends, &batch->trends_num,
+				compression_age);
+
+		if (0 != batch->trends_num)
+			zbx_tfc_invalidate_trends(batch->trends, batch->trends_num);
+
+		zbx_vector_uint64_pair_create(&trends_diff);
+
+		do
+		{
+			DBbegin();
+
+			DBmass_update_items(&batch->item_diff, &batch->inventory_values);
+			DBmass_update_trends(batch->trends, batch->trends_num, &trends_diff);
+
+			/* process internal events generated by DCmass_add_internal_events() */
+			zbx_process_events(NULL, NULL);
+
+			if (ZBX_DB_OK == (txn_error = DBcommit()))
+				DCupdate_trends(&trends_diff);
+			else
+				zbx_reset_event_recovery();
+
+			zbx_vector_uint64_pair_clear(&trends_diff);
+		}
+		while (ZBX_DB_DOWN == txn_error);
+
+		zbx_vector_uint64_pair_destroy(&trends_diff);
+	}
+
+	zbx_clean_events();
+
+	zbx_vector_ptr_clear_ext(&batch->inventory_values, (zbx_clean_func_t)DCinventory_value_free);
+	zbx_vector_ptr_clear_ext(&batch->item_diff, (zbx_clean_func_t)zbx_ptr_free);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: sync_server_history_finish                                       *
+ *                                                                            *
+ * Purpose: processes triggers of the written batch and timer triggers,       *
+ *          returns the batch items to history cache                          *
+ *                                                                            *
+ * Parameters: batch          - [IN/OUT] the history synchronization batch    *
+ *             trigger_timers - [IN] the trigger timer vector (empty)         *
+ *             values_num     - [IN/OUT] the number of synced values          *
+ *             triggers_num   - [IN/OUT] the number of processed timers       *
+ *             more           - [OUT] a flag indicating the cache emptiness:  *
+ *                                 ZBX_SYNC_DONE - nothing to sync, go idle   *
+ *                                 ZBX_SYNC_MORE - more data to sync          *
+ *                                                                            *
+ ******************************************************************************/
+static void	sync_server_history_finish(zbx_hc_sync_batch_t *batch, zbx_vector_ptr_t *trigger_timers,
+		int *values_num, int *triggers_num, int *more)
 {
 	static ZBX_HISTORY_FLOAT	*history_float;
 	static ZBX_HISTORY_INTEGER	*history_integer;
 	static ZBX_HISTORY_STRING	*history_string;
 	static ZBX_HISTORY_TEXT		*history_text;
 	static ZBX_HISTORY_LOG		*history_log;
-	int				i, history_num, history_float_num, history_integer_num, history_string_num,
-					history_text_num, history_log_num, txn_error, compression_age;
-	unsigned int			item_retrieve_mode;
-	time_t				sync_start;
-	zbx_vector_uint64_t		triggerids ;
-	zbx_vector_ptr_t		history_items, trigger_diff, item_diff, inventory_values, trigger_timers;
-	zbx_vector_uint64_pair_t	trends_diff, proxy_subscribtions;
-	ZBX_DC_HISTORY			history[ZBX_HC_SYNC_MAX];
-
-	item_retrieve_mode = NULL == CONFIG_EXPORT_DIR ? ZBX_ITEM_GET_SYNC : ZBX_ITEM_GET_SYNC_EXPORT;
+	int				i, history_float_num, history_integer_num, history_string_num,
+					history_text_num, history_log_num, txn_error, timers_num = 0;
+	zbx_vector_ptr_t		trigger_diff;
 
 	if (NULL == history_float && NULL != history_float_cbs)
 	{
@@ -3074,272 +3732,267 @@ static void	sync_server_history(int *values_num, int *triggers_num, int *more)
 				ZBX_HC_SYNC_MAX * sizeof(ZBX_HISTORY_LOG));
 	}
 
-	compression_age = hc_get_history_compression_age();
-
-	zbx_vector_ptr_create(&inventory_values);
-	zbx_vector_ptr_create(&item_diff);
 	zbx_vector_ptr_create(&trigger_diff);
-	zbx_vector_uint64_pair_create(&trends_diff);
-	zbx_vector_uint64_pair_create(&proxy_subscribtions);
-
-	zbx_vector_uint64_create(&triggerids);
-	zbx_vector_uint64_reserve(&triggerids, ZBX_HC_SYNC_MAX);
-
-	zbx_vector_ptr_create(&trigger_timers);
-	zbx_vector_ptr_reserve(&trigger_timers, ZBX_HC_TIMER_MAX);
 
-	zbx_vector_ptr_create(&history_items);
-	zbx_vector_ptr_reserve(&history_items, ZBX_HC_SYNC_MAX);
-
-	sync_start = time(NULL);
-
-	do
+	if (FAIL != batch->ret)
 	{
-		DC_ITEM			*items;
-		int			*errcodes, trends_num = 0, timers_num = 0, ret = SUCCEED;
-		zbx_vector_uint64_t	itemids;
-		ZBX_DC_TREND		*trends = NULL;
-
-		zbx_vector_uint64_create(&itemids);
+		/* don't process trigger timers when server is shutting down */
+		if (ZBX_IS_RUNNING())
+		{
+			zbx_dc_get_trigger_timers(trigger_timers, time(NULL), ZBX_HC_TIMER_SOFT_MAX,
+					ZBX_HC_TIMER_MAX);
+		}
 
-		*more = ZBX_SYNC_DONE;
+		timers_num = trigger_timers->values_num;
 
-		LOCK_CACHE;
-		hc_pop_items(&history_items);		/* select and take items out of history cache */
-		UNLOCK_CACHE;
+		if (ZBX_HC_TIMER_SOFT_MAX <= timers_num)
+			*more = ZBX_SYNC_MORE;
 
-		if (0 != history_items.values_num)
+		if (0 != batch->history_num || 0 != timers_num)
 		{
-			if (0 == (history_num = DCconfig_lock_triggers_by_history_items(&history_items, &triggerids)))
+			for (i = 0; i < trigger_timers->values_num; i++)
 			{
-				LOCK_CACHE;
-				hc_push_items(&history_items);
-				UNLOCK_CACHE;
-				zbx_vector_ptr_clear(&history_items);
-			}
-		}
-		else
-			history_num = 0;
-
-		if (0 != history_num)
-		{
-			hc_get_item_values(history, &history_items);	/* copy item data from history cache */
+				zbx_trigger_timer_t	*timer = (zbx_trigger_timer_t *)trigger_timers->values[i];
 
-			items = (DC_ITEM *)zbx_malloc(NULL, sizeof(DC_ITEM) * (size_t)history_num);
-			errcodes = (int *)zbx_malloc(NULL, sizeof(int) * (size_t)history_num);
+				if (0 != timer->lock)
+					zbx_vector_uint64_append(&batch->triggerids, timer->triggerid);
+			}
 
-			zbx_vector_uint64_reserve(&itemids, history_num);
+			do
+			{
+				DBbegin();
 
-			for (i = 0; i < history_num; i++)
-				zbx_vector_uint64_append(&itemids, history[i].itemid);
+				recalculate_triggers(batch->history, batch->history_num, &batch->itemids, batch->items,
+						batch->errcodes, trigger_timers, &trigger_diff);
 
-			zbx_vector_uint64_sort(&itemids, ZBX_DEFAULT_UINT64_COMPARE_FUNC);
+				/* process trigger events generated by recalculate_triggers() */
+				zbx_process_events(&trigger_diff, &batch->triggerids);
+				if (0 != trigger_diff.values_num)
+					zbx_db_save_trigger_changes(&trigger_diff);
 
-			DCconfig_get_items_by_itemids_partial(items, itemids.values, errcodes, history_num,
-					item_retrieve_mode);
+				if (ZBX_DB_OK == (txn_error = DBcommit()))
+					DCconfig_triggers_apply_changes(&trigger_diff);
+				else
+					zbx_clean_events();
 
-			DCmass_prepare_history(history, &itemids, items, errcodes, history_num, &item_diff,
-					&inventory_values, compression_age, &proxy_subscribtions);
+				zbx_vector_ptr_clear_ext(&trigger_diff, (zbx_clean_func_t)zbx_trigger_diff_free);
+			}
+			while (ZBX_DB_DOWN == txn_error);
 
-			if (FAIL != (ret = DBmass_add_history(history, history_num)))
-			{
-				DCconfig_items_apply_changes(&item_diff);
-				DCmass_update_trends(history, history_num, &trends, &trends_num, compression_age);
+			if (ZBX_DB_OK == txn_error)
+				zbx_events_update_itservices();
+		}
+	}
 
-				if (0 != trends_num)
-					zbx_tfc_invalidate_trends(trends, trends_num);
+	zbx_vector_ptr_destroy(&trigger_diff);
 
-				do
-				{
-					DBbegin();
+	if (0 != batch->triggerids.values_num)
+	{
+		*triggers_num += batch->triggerids.values_num;
+		DCconfig_unlock_triggers(&batch->triggerids);
+		zbx_vector_uint64_clear(&batch->triggerids);
+	}
 
-					DBmass_update_items(&item_diff, &inventory_values);
-					DBmass_update_trends(trends, trends_num, &trends_diff);
+	if (0 != trigger_timers->values_num)
+	{
+		zbx_dc_reschedule_trigger_timers(trigger_timers, time(NULL));
+		zbx_vector_ptr_clear(trigger_timers);
+	}
 
-					/* process internal events generated by DCmass_prepare_history() */
-					zbx_process_events(NULL, NULL);
+	if (0 != batch->proxy_subscribtions.values_num)
+	{
+		zbx_vector_uint64_pair_sort(&batch->proxy_subscribtions, ZBX_DEFAULT_UINT64_COMPARE_FUNC);
+		zbx_dc_proxy_update_nodata(&batch->proxy_subscribtions);
+		zbx_vector_uint64_pair_clear(&batch->proxy_subscribtions);
+	}
 
-					if (ZBX_DB_OK == (txn_error = DBcommit()))
-						DCupdate_trends(&trends_diff);
-					else
-						zbx_reset_event_recovery();
+	if (0 != batch->history_num)
+	{
+		LOCK_SHARD(batch->shard);
+		hc_push_items(batch->shard, &batch->history_items);	/* return items to history cache */
+		batch->shard->history_num -= batch->history_num;
+		UNLOCK_SHARD(batch->shard);
 
-					zbx_vector_uint64_pair_clear(&trends_diff);
-				}
-				while (ZBX_DB_DOWN == txn_error);
-			}
+		if (0 != hc_queue_get_size())
+		{
+			/* Continue sync if enough of sync candidates were processed       */
+			/* (meaning most of sync candidates are not locked by triggers).   */
+			/* Otherwise better to wait a bit for other syncers to unlock      */
+			/* items rather than trying and failing to sync locked items over  */
+			/* and over again.                                                 */
+			if (ZBX_HC_SYNC_MIN_PCNT <= batch->history_num * 100 / batch->history_items.values_num)
+				*more = ZBX_SYNC_MORE;
+		}
 
-			zbx_clean_events();
+		*values_num += batch->history_num;
+	}
 
-			zbx_vector_ptr_clear_ext(&inventory_values, (zbx_clean_func_t)DCinventory_value_free);
-			zbx_vector_ptr_clear_ext(&item_diff, (zbx_clean_func_t)zbx_ptr_free);
+	if (FAIL != batch->ret)
+	{
+		if (0 != batch->history_num)
+		{
+			DCmodule_prepare_history(batch->history, batch->history_num, history_float,
+					&history_float_num, history_integer, &history_integer_num, history_string,
+					&history_string_num, history_text, &history_text_num, history_log,
+					&history_log_num);
+
+			DCmodule_sync_history(history_float_num, history_integer_num, history_string_num,
+					history_text_num, history_log_num, history_float, history_integer,
+					history_string, history_text, history_log);
 		}
 
-		if (FAIL != ret)
+		if (0 != batch->history_num)
 		{
-			/* don't process trigger timers when server is shutting down */
-			if (ZBX_IS_RUNNING())
+			const ZBX_DC_HISTORY	*phistory = NULL;
+			const ZBX_DC_TREND	*ptrends = NULL;
+			int			history_num_loc = 0, trends_num_loc = 0;
+
+			if (SUCCEED == zbx_is_export_enabled(ZBX_FLAG_EXPTYPE_HISTORY))
 			{
-				zbx_dc_get_trigger_timers(&trigger_timers, time(NULL), ZBX_HC_TIMER_SOFT_MAX,
-						ZBX_HC_TIMER_MAX);
+				phistory = batch->history;
+				history_num_loc = batch->history_num;
 			}
 
-			timers_num = trigger_timers.values_num;
-
-			if (ZBX_HC_TIMER_SOFT_MAX <= timers_num)
-				*more = ZBX_SYNC_MORE;
+			if (SUCCEED == zbx_is_export_enabled(ZBX_FLAG_EXPTYPE_TRENDS))
+			{
+				ptrends = batch->trends;
+				trends_num_loc = batch->trends_num;
+			}
 
-			if (0 != history_num || 0 != timers_num)
+			if (NULL != phistory || NULL != ptrends)
 			{
-				for (i = 0; i < trigger_timers.values_num; i++)
-				{
-					zbx_trigger_timer_t	*timer = (zbx_trigger_timer_t *)trigger_timers.values[i];
+				DCexport_history_and_trends(phistory, history_num_loc, &batch->itemids, batch->items,
+						batch->errcodes, ptrends, trends_num_loc);
+			}
+		}
 
-					if (0 != timer->lock)
-						zbx_vector_uint64_append(&triggerids, timer->triggerid);
-				}
+		if (SUCCEED == zbx_is_export_enabled(ZBX_FLAG_EXPTYPE_EVENTS))
+			zbx_export_events();
+	}
 
-				do
-				{
-					DBbegin();
+	if (0 != batch->history_num || 0 != timers_num)
+		zbx_clean_events();
 
-					recalculate_triggers(history, history_num, &itemids, items, errcodes,
-							&trigger_timers, &trigger_diff);
-
-					/* process trigger events generated by recalculate_triggers() */
-					zbx_process_events(&trigger_diff, &triggerids);
-					if (0 != trigger_diff.values_num)
-						zbx_db_save_trigger_changes(&trigger_diff);
+	if (0 != batch->history_num)
+	{
+		zbx_free(batch->trends);
+		DCconfig_clean_items(batch->items, batch->errcodes, batch->history_num);
+		zbx_free(batch->errcodes);
+		zbx_free(batch->items);
+
+		zbx_vector_ptr_clear(&batch->history_items);
+		hc_free_item_values(batch->history, batch->history_num);
+		batch->history_num = 0;
+	}
 
-					if (ZBX_DB_OK == (txn_error = DBcommit()))
-						DCconfig_triggers_apply_changes(&trigger_diff);
-					else
-						zbx_clean_events();
+	zbx_vector_uint64_clear(&batch->itemids);
+}
 
-					zbx_vector_ptr_clear_ext(&trigger_diff, (zbx_clean_func_t)zbx_trigger_diff_free);
-				}
-				while (ZBX_DB_DOWN == txn_error);
+/******************************************************************************
+ *                                                                            *
+ * Function: sync_server_history                                              *
+ *                                                                            *
+ * Purpose: flush history cache to database, process triggers of flushed      *
+ *          and timer triggers from timer queue                               *
+ *                                                                            *
+ * Parameters: sync_timeout - [IN] the timeout in seconds                     *
+ *             values_num   - [IN/OUT] the number of synced values            *
+ *             triggers_num - [IN/OUT] the number of processed timers         *
+ *             more         - [OUT] a flag indicating the cache emptiness:    *
+ *                               ZBX_SYNC_DONE - nothing to sync, go idle     *
+ *                               ZBX_SYNC_MORE - more data to sync            *
+ *                                                                            *
+ * Comments: This function loops syncing history values by 1k batches and     *
+ *           processing timer triggers by batches of 500 triggers.            *
+ *           Unless full sync is being done the loop is aborted if either     *
+ *           timeout has passed or there are no more data to process.         *
+ *           The last is assumed when the following is true:                  *
+ *            a) history cache is empty or less than 10% of batch values were *
+ *               processed (the other items were locked by triggers)          *
+ *            b) less than 500 (full batch) timer triggers were processed     *
+ *           With HistorySyncPipeline enabled the history of the next batch   *
+ *           is written over a separate database connection while triggers of *
+ *           the previous batch are processed. So the triggers of batch N are *
+ *           processed only after batch N+1 is taken from history cache and   *
+ *           its history write is started, delaying trigger processing by one *
+ *           batch preparation. The delayed batch is finished before leaving  *
+ *           this function, so no batch is kept between calls.                *
+ *           History is committed in its own transaction before the item and  *
+ *           trend updates, as with synchronous writes - if the update        *
+ *           transaction fails, the written history is not rolled back.       *
+ *                                                                            *
+ ******************************************************************************/
+static void	sync_server_history(int *values_num, int *triggers_num, int *more)
+{
+	/* the batch being written and the batch waiting for trigger processing */
+	static zbx_hc_sync_batch_t	batches[2];
+	zbx_hc_sync_batch_t		*batch = &batches[0], *batch_prev = NULL;
+	int				i, compression_age, async;
+	unsigned int			item_retrieve_mode;
+	time_t				sync_start;
+	zbx_vector_ptr_t		trigger_timers;
 
-				if (ZBX_DB_OK == txn_error)
-					zbx_events_update_itservices();
-			}
-		}
+	item_retrieve_mode = NULL == CONFIG_EXPORT_DIR ? ZBX_ITEM_GET_SYNC : ZBX_ITEM_GET_SYNC_EXPORT;
 
-		if (0 != triggerids.values_num)
-		{
-			*triggers_num += triggerids.values_num;
-			DCconfig_unlock_triggers(&triggerids);
-			zbx_vector_uint64_clear(&triggerids);
-		}
+	for (i = 0; i < (0 != CONFIG_HISTSYNCER_PIPELINE ? 2 : 1); i++)
+	{
+		if (NULL == batches[i].history)
+			hc_sync_batch_init(&batches[i]);
+	}
 
-		if (0 != trigger_timers.values_num)
-		{
-			zbx_dc_reschedule_trigger_timers(&trigger_timers, time(NULL));
-			zbx_vector_ptr_clear(&trigger_timers);
-		}
+	compression_age = hc_get_history_compression_age();
 
-		if (0 != proxy_subscribtions.values_num)
-		{
-			zbx_vector_uint64_pair_sort(&proxy_subscribtions, ZBX_DEFAULT_UINT64_COMPARE_FUNC);
-			zbx_dc_proxy_update_nodata(&proxy_subscribtions);
-			zbx_vector_uint64_pair_clear(&proxy_subscribtions);
-		}
+	zbx_vector_ptr_create(&trigger_timers);
+	zbx_vector_ptr_reserve(&trigger_timers, ZBX_HC_TIMER_MAX);
 
-		if (0 != history_num)
-		{
-			LOCK_CACHE;
-			hc_push_items(&history_items);	/* return items to history cache */
-			cache->history_num -= history_num;
+	sync_start = time(NULL);
 
-			if (0 != hc_queue_get_size())
-			{
-				/* Continue sync if enough of sync candidates were processed       */
-				/* (meaning most of sync candidates are not locked by triggers).   */
-				/* Otherwise better to wait a bit for other syncers to unlock      */
-				/* items rather than trying and failing to sync locked items over  */
-				/* and over again.                                                 */
-				if (ZBX_HC_SYNC_MIN_PCNT <= history_num * 100 / history_items.values_num)
-					*more = ZBX_SYNC_MORE;
-			}
+	do
+	{
+		*more = ZBX_SYNC_DONE;
 
-			UNLOCK_CACHE;
+		sync_server_history_prepare(batch, item_retrieve_mode, compression_age);
 
-			*values_num += history_num;
-		}
+		async = 0;
 
-		if (FAIL != ret)
+		if (0 != CONFIG_HISTSYNCER_PIPELINE)
 		{
-			if (0 != history_num)
+			if (0 != batch->history_num)
 			{
-				DCmodule_prepare_history(history, history_num, history_float, &history_float_num,
-						history_integer, &history_integer_num, history_string,
-						&history_string_num, history_text, &history_text_num, history_log,
-						&history_log_num);
-
-				DCmodule_sync_history(history_float_num, history_integer_num, history_string_num,
-						history_text_num, history_log_num, history_float, history_integer,
-						history_string, history_text, history_log);
+				async = (SUCCEED == DBmass_add_history_async(batch->history, batch->history_num,
+						&batch->history_values));
 			}
 
-			if (0 != history_num)
+			/* process triggers of the previous batch while history of the current batch is written */
+			if (NULL != batch_prev)
 			{
-				const ZBX_DC_HISTORY	*phistory = NULL;
-				const ZBX_DC_TREND	*ptrends = NULL;
-				int			history_num_loc = 0, trends_num_loc = 0;
-
-				if (SUCCEED == zbx_is_export_enabled(ZBX_FLAG_EXPTYPE_HISTORY))
-				{
-					phistory = history;
-					history_num_loc = history_num;
-				}
-
-				if (SUCCEED == zbx_is_export_enabled(ZBX_FLAG_EXPTYPE_TRENDS))
-				{
-					ptrends = trends;
-					trends_num_loc = trends_num;
-				}
-
-				if (NULL != phistory || NULL != ptrends)
-				{
-					DCexport_history_and_trends(phistory, history_num_loc, &itemids, items,
-							errcodes, ptrends, trends_num_loc);
-				}
+				sync_server_history_finish(batch_prev, &trigger_timers, values_num, triggers_num, more);
+				batch_prev = NULL;
 			}
-
-			if (SUCCEED == zbx_is_export_enabled(ZBX_FLAG_EXPTYPE_EVENTS))
-				zbx_export_events();
 		}
 
-		if (0 != history_num || 0 != timers_num)
-			zbx_clean_events();
+		sync_server_history_update(batch, async, compression_age);
 
-		if (0 != history_num)
+		/* defer trigger processing of the batch to overlap it with writing of the next batch */
+		if (0 != async && ZBX_HC_SYNC_TIME_MAX >= time(NULL) - sync_start)
 		{
-			zbx_free(trends);
-			DCconfig_clean_items(items, errcodes, history_num);
-			zbx_free(errcodes);
-			zbx_free(items);
-
-			zbx_vector_ptr_clear(&history_items);
-			hc_free_item_values(history, history_num);
+			batch_prev = batch;
+			batch = (&batches[0] == batch ? &batches[1] : &batches[0]);
+			*more = ZBX_SYNC_MORE;
+			continue;
 		}
 
-		zbx_vector_uint64_destroy(&itemids);
+		sync_server_history_finish(batch, &trigger_timers, values_num, triggers_num, more);
 
 		/* Exit from sync loop if we have spent too much time here.       */
 		/* This is done to allow syncer process to update its statistics. */
 	}
 	while (ZBX_SYNC_MORE == *more && ZBX_HC_SYNC_TIME_MAX >= time(NULL) - sync_start);
 
-	zbx_vector_ptr_destroy(&history_items);
-	zbx_vector_ptr_destroy(&inventory_values);
-	zbx_vector_ptr_destroy(&item_diff);
-	zbx_vector_ptr_destroy(&trigger_diff);
-	zbx_vector_uint64_pair_destroy(&trends_diff);
-	zbx_vector_uint64_pair_destroy(&proxy_subscribtions);
+	if (NULL != batch_prev)
+		sync_server_history_finish(batch_prev, &trigger_timers, values_num, triggers_num, more);
 
 	zbx_vector_ptr_destroy(&trigger_timers);
-	zbx_vector_uint64_destroy(&triggerids);
 }
 
 /******************************************************************************
@@ -3356,12 +4009,12 @@ static void	sync_server_history(int *values_num, int *triggers_num, int *more)
  ******************************************************************************/
 static void	sync_history_cache_full(void)
 {
-	int			values_num = 0, triggers_num = 0, more;
+	int			i, values_num = 0, triggers_num = 0, more, history_num;
 	zbx_hashset_iter_t	iter;
 	zbx_hc_item_t		*item;
-	zbx_binary_heap_t	tmp_history_queue;
+	zbx_binary_heap_t	tmp_history_queue[ZBX_HC_SHARDS_MAX];
 
-	zabbix_log(LOG_LEVEL_DEBUG, "In %s() history_num:%d", __func__, cache->history_num);
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() history_num:%d", __func__, hc_get_history_num());
 
 	/* History index cache might be full without any space left for queueing items from history index to  */
 	/* history queue. The solution: replace the shared-memory history queue with heap-allocated one. Add  */
@@ -3380,18 +4033,24 @@ static void	sync_history_cache_full(void)
 		DCconfig_unlock_all_triggers();
 	}
 
-	tmp_history_queue = cache->history_queue;
+	for (i = 0; i < cache->shards_num; i++)
+	{
+		zbx_hc_shard_t	*shard = cache->shards[i];
 
-	zbx_binary_heap_create(&cache->history_queue, hc_queue_elem_compare_func, ZBX_BINARY_HEAP_OPTION_EMPTY);
-	zbx_hashset_iter_reset(&cache->history_items, &iter);
+		tmp_history_queue[i] = shard->history_queue;
 
-	/* add all items from history index to the new history queue */
-	while (NULL != (item = (zbx_hc_item_t *)zbx_hashset_iter_next(&iter)))
-	{
-		if (NULL != item->tail)
+		zbx_binary_heap_create(&shard->history_queue, hc_queue_elem_compare_func,
+				ZBX_BINARY_HEAP_OPTION_EMPTY);
+		zbx_hashset_iter_reset(&shard->history_items, &iter);
+
+		/* add all items from history index to the new history queue */
+		while (NULL != (item = (zbx_hc_item_t *)zbx_hashset_iter_next(&iter)))
 		{
-			item->status = ZBX_HC_ITEM_STATUS_NORMAL;
-			hc_queue_item(item);
+			if (NULL != item->tail)
+			{
+				item->status = ZBX_HC_ITEM_STATUS_NORMAL;
+				hc_queue_item(shard, item);
+			}
 		}
 	}
 
@@ -3406,16 +4065,21 @@ static void	sync_history_cache_full(void)
 			else
 				sync_proxy_history(&values_num, &more);
 
+			history_num = hc_get_history_num();
+
 			zabbix_log(LOG_LEVEL_WARNING, "syncing history data... " ZBX_FS_DBL "%%",
-					(double)values_num / (cache->history_num + values_num) * 100);
+					(double)values_num / (history_num + values_num) * 100);
 		}
 		while (0 != hc_queue_get_size());
 
 		zabbix_log(LOG_LEVEL_WARNING, "syncing history data done");
 	}
 
-	zbx_binary_heap_destroy(&cache->history_queue);
-	cache->history_queue = tmp_history_queue;
+	for (i = 0; i < cache->shards_num; i++)
+	{
+		zbx_binary_heap_destroy(&cache->shards[i]->history_queue);
+		cache->shards[i]->history_queue = tmp_history_queue[i];
+	}
 
 	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
 }
@@ -3430,7 +4094,9 @@ static void	sync_history_cache_full(void)
 void	zbx_log_sync_history_cache_progress(void)
 {
 	double		pcnt = -1.0;
-	int		ts_last, ts_next, sec;
+	int		ts_last, ts_next, sec, history_num;
+
+	history_num = hc_get_history_num();
 
 	LOCK_CACHE;
 
@@ -3445,16 +4111,16 @@ void	zbx_log_sync_history_cache_progress(void)
 
 	if (0 == cache->history_progress_ts)
 	{
-		cache->history_num_total = cache->history_num;
+		cache->history_num_total = history_num;
 		cache->history_progress_ts = sec;
 	}
 
-	if (ZBX_HC_SYNC_TIME_MAX <= sec - cache->history_progress_ts || 0 == cache->history_num)
+	if (ZBX_HC_SYNC_TIME_MAX <= sec - cache->history_progress_ts || 0 == history_num)
 	{
 		if (0 != cache->history_num_total)
-			pcnt = 100 * (double)(cache->history_num_total - cache->history_num) / cache->history_num_total;
+			pcnt = 100 * (double)(cache->history_num_total - history_num) / cache->history_num_total;
 
-		cache->history_progress_ts = (0 == cache->history_num ? INT_MAX : sec);
+		cache->history_progress_ts = (0 == history_num ? INT_MAX : sec);
 	}
 
 	ts_next = cache->history_progress_ts;
@@ -3485,7 +4151,10 @@ void	zbx_log_sync_history_cache_progress(void)
  ******************************************************************************/
 void	zbx_sync_history_cache(int *values_num, int *triggers_num, int *more)
 {
-	zabbix_log(LOG_LEVEL_DEBUG, "In %s() history_num:%d", __func__, cache->history_num);
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+
+	/* each syncer starts with its own shard and helps with the others when it is empty */
+	hc_shard_pref = (0 < process_num ? process_num - 1 : 0) % cache->shards_num;
 
 	*values_num = 0;
 	*triggers_num = 0;
@@ -3843,18 +4512,45 @@ void	dc_add_history(zbx_uint64_t itemid, unsigned char item_value_type, unsigned
 	}
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_get_shard_index                                               *
+ *                                                                            *
+ * Purpose: returns index of the history cache shard storing the item         *
+ *                                                                            *
+ ******************************************************************************/
+static int	hc_get_shard_index(zbx_uint64_t itemid)
+{
+	return (int)(itemid % (zbx_uint64_t)cache->shards_num);
+}
+
 void	dc_flush_history(void)
 {
+	int	i, values_num[ZBX_HC_SHARDS_MAX] = {0};
+
 	if (0 == item_values_num)
 		return;
 
-	LOCK_CACHE;
+	for (i = 0; i < (int)item_values_num; i++)
+		values_num[hc_get_shard_index(item_values[i].itemid)]++;
 
-	hc_add_item_values(item_values, item_values_num);
+	for (i = 0; i < cache->shards_num; i++)
+	{
+		zbx_hc_shard_t	*shard;
+
+		if (0 == values_num[i])
+			continue;
 
-	cache->history_num += item_values_num;
+		shard = cache->shards[i];
 
-	UNLOCK_CACHE;
+		LOCK_SHARD(shard);
+
+		hc_add_item_values(shard, item_values, item_values_num);
+
+		shard->history_num += values_num[i];
+
+		UNLOCK_SHARD(shard);
+	}
 
 	item_values_num = 0;
 	string_values_offset = 0;
@@ -3924,6 +4620,9 @@ static void	hc_free_data(zbx_hc_data_t *data)
 		}
 	}
 
+	if (NULL != data->block)
+		__hc_mem_free_func(data->block);
+
 	__hc_mem_free_func(data);
 }
 
@@ -3933,14 +4632,15 @@ static void	hc_free_data(zbx_hc_data_t *data)
  *                                                                            *
  * Purpose: put back item into history queue                                  *
  *                                                                            *
- * Parameters: data - [IN] history item data                                  *
+ * Parameters: shard - [IN] the history cache shard                           *
+ *             item  - [IN] history item                                      *
  *                                                                            *
  ******************************************************************************/
-static void	hc_queue_item(zbx_hc_item_t *item)
+static void	hc_queue_item(zbx_hc_shard_t *shard, zbx_hc_item_t *item)
 {
 	zbx_binary_heap_elem_t	elem = {item->itemid, (const void *)item};
 
-	zbx_binary_heap_insert(&cache->history_queue, &elem);
+	zbx_binary_heap_insert(&shard->history_queue, &elem);
 }
 
 /******************************************************************************
@@ -3949,15 +4649,16 @@ static void	hc_queue_item(zbx_hc_item_t *item)
  *                                                                            *
  * Purpose: returns history item by itemid                                    *
  *                                                                            *
- * Parameters: itemid - [IN] the item id                                      *
+ * Parameters: shard  - [IN] the history cache shard                          *
+ *             itemid - [IN] the item id                                      *
  *                                                                            *
  * Return value: the history item or NULL if the requested item is not in     *
  *               history cache                                                *
  *                                                                            *
  ******************************************************************************/
-static zbx_hc_item_t	*hc_get_item(zbx_uint64_t itemid)
+static zbx_hc_item_t	*hc_get_item(zbx_hc_shard_t *shard, zbx_uint64_t itemid)
 {
-	return (zbx_hc_item_t *)zbx_hashset_search(&cache->history_items, &itemid);
+	return (zbx_hc_item_t *)zbx_hashset_search(&shard->history_items, &itemid);
 }
 
 /******************************************************************************
@@ -3966,17 +4667,18 @@ static zbx_hc_item_t	*hc_get_item(zbx_uint64_t itemid)
  *                                                                            *
  * Purpose: adds a new item to history cache                                  *
  *                                                                            *
- * Parameters: itemid - [IN] the item id                                      *
- *                      [IN] the item data                                    *
+ * Parameters: shard  - [IN] the history cache shard                          *
+ *             itemid - [IN] the item id                                      *
+ *             data   - [IN] the item data                                    *
  *                                                                            *
  * Return value: the added history item                                       *
  *                                                                            *
  ******************************************************************************/
-static zbx_hc_item_t	*hc_add_item(zbx_uint64_t itemid, zbx_hc_data_t *data)
+static zbx_hc_item_t	*hc_add_item(zbx_hc_shard_t *shard, zbx_uint64_t itemid, zbx_hc_data_t *data)
 {
 	zbx_hc_item_t	item_local = {itemid, ZBX_HC_ITEM_STATUS_NORMAL, 0, data, data};
 
-	return (zbx_hc_item_t *)zbx_hashset_insert(&cache->history_items, &item_local, sizeof(item_local));
+	return (zbx_hc_item_t *)zbx_hashset_insert(&shard->history_items, &item_local, sizeof(item_local));
 }
 
 /******************************************************************************
@@ -3985,19 +4687,20 @@ static zbx_hc_item_t	*hc_add_item(zbx_uint64_t itemid, zbx_hc_data_t *data)
  *                                                                            *
  * Purpose: copies string value to history cache                              *
  *                                                                            *
- * Parameters: str - [IN] the string value                                    *
+ * Parameters: str     - [IN] the string value                                *
+ *             strings - [IN] the buffer containing string values             *
  *                                                                            *
  * Return value: the copied string or NULL if there was not enough memory     *
  *                                                                            *
  ******************************************************************************/
-static char	*hc_mem_value_str_dup(const dc_value_str_t *str)
+static char	*hc_mem_value_str_dup(const dc_value_str_t *str, const char *strings)
 {
 	char	*ptr;
 
 	if (NULL == (ptr = (char *)__hc_mem_malloc_func(NULL, str->len)))
 		return NULL;
 
-	memcpy(ptr, &string_values[str->pvalue], str->len - 1);
+	memcpy(ptr, &strings[str->pvalue], str->len - 1);
 	ptr[str->len - 1] = '\0';
 
 	return ptr;
@@ -4009,8 +4712,9 @@ static char	*hc_mem_value_str_dup(const dc_value_str_t *str)
  *                                                                            *
  * Purpose: clones string value into history data memory                      *
  *                                                                            *
- * Parameters: dst - [IN/OUT] a reference to the cloned value                 *
- *             str - [IN] the string value to clone                           *
+ * Parameters: dst     - [IN/OUT] a reference to the cloned value             *
+ *             str     - [IN] the string value to clone                       *
+ *             strings - [IN] the buffer containing string values             *
  *                                                                            *
  * Return value: SUCCESS - either there was no need to clone the string       *
  *                         (it was empty or already cloned) or the string was *
@@ -4021,7 +4725,7 @@ static char	*hc_mem_value_str_dup(const dc_value_str_t *str)
  *           until it finishes cloning string value.                          *
  *                                                                            *
  ******************************************************************************/
-static int	hc_clone_history_str_data(char **dst, const dc_value_str_t *str)
+static int	hc_clone_history_str_data(char **dst, const dc_value_str_t *str, const char *strings)
 {
 	if (0 == str->len)
 		return SUCCEED;
@@ -4029,7 +4733,7 @@ static int	hc_clone_history_str_data(char **dst, const dc_value_str_t *str)
 	if (NULL != *dst)
 		return SUCCEED;
 
-	if (NULL != (*dst = hc_mem_value_str_dup(str)))
+	if (NULL != (*dst = hc_mem_value_str_dup(str, strings)))
 		return SUCCEED;
 
 	return FAIL;
@@ -4043,6 +4747,7 @@ static int	hc_clone_history_str_data(char **dst, const dc_value_str_t *str)
  *                                                                            *
  * Parameters: dst        - [IN/OUT] a reference to the cloned value          *
  *             item_value - [IN] the log value to clone                       *
+ *             strings    - [IN] the buffer containing string values          *
  *                                                                            *
  * Return value: SUCCESS - the log value was cloned successfully              *
  *               FAIL    - not enough memory                                  *
@@ -4051,7 +4756,8 @@ static int	hc_clone_history_str_data(char **dst, const dc_value_str_t *str)
  *           until it finishes cloning log value.                             *
  *                                                                            *
  ******************************************************************************/
-static int	hc_clone_history_log_data(zbx_log_value_t **dst, const dc_item_value_t *item_value)
+static int	hc_clone_history_log_data(zbx_log_value_t **dst, const dc_item_value_t *item_value,
+		const char *strings)
 {
 	if (NULL == *dst)
 	{
@@ -4062,10 +4768,10 @@ static int	hc_clone_history_log_data(zbx_log_value_t **dst, const dc_item_value_
 		memset(*dst, 0, sizeof(zbx_log_value_t));
 	}
 
-	if (SUCCEED != hc_clone_history_str_data(&(*dst)->value, &item_value->value.value_str))
+	if (SUCCEED != hc_clone_history_str_data(&(*dst)->value, &item_value->value.value_str, strings))
 		return FAIL;
 
-	if (SUCCEED != hc_clone_history_str_data(&(*dst)->source, &item_value->source))
+	if (SUCCEED != hc_clone_history_str_data(&(*dst)->source, &item_value->source, strings))
 		return FAIL;
 
 	(*dst)->logeventid = item_value->logeventid;
@@ -4081,8 +4787,10 @@ static int	hc_clone_history_log_data(zbx_log_value_t **dst, const dc_item_value_
  *                                                                            *
  * Purpose: clones item value from local cache into history cache             *
  *                                                                            *
- * Parameters: data       - [IN/OUT] a reference to the cloned value          *
+ * Parameters: shard      - [IN] the history cache shard                      *
+ *             data       - [IN/OUT] a reference to the cloned value          *
  *             item_value - [IN] the item value                               *
+ *             strings    - [IN] the buffer containing item value strings     *
  *                                                                            *
  * Return value: SUCCESS - the item value was cloned successfully             *
  *               FAIL    - not enough memory                                  *
@@ -4091,7 +4799,8 @@ static int	hc_clone_history_log_data(zbx_log_value_t **dst, const dc_item_value_
  *           until it finishes cloning item value.                            *
  *                                                                            *
  ******************************************************************************/
-static int	hc_clone_history_data(zbx_hc_data_t **data, const dc_item_value_t *item_value)
+static int	hc_clone_history_data(zbx_hc_shard_t *shard, zbx_hc_data_t **data, const dc_item_value_t *item_value,
+		const char *strings)
 {
 	if (NULL == *data)
 	{
@@ -4113,24 +4822,24 @@ static int	hc_clone_history_data(zbx_hc_data_t **data, const dc_item_value_t *it
 
 	if (ITEM_STATE_NOTSUPPORTED == item_value->state)
 	{
-		if (NULL == ((*data)->value.str = hc_mem_value_str_dup(&item_value->value.value_str)))
+		if (NULL == ((*data)->value.str = hc_mem_value_str_dup(&item_value->value.value_str, strings)))
 			return FAIL;
 
 		(*data)->value_type = item_value->value_type;
-		cache->stats.notsupported_counter++;
+		shard->stats.notsupported_counter++;
 
 		return SUCCEED;
 	}
 
 	if (0 != (ZBX_DC_FLAG_LLD & item_value->flags))
 	{
-		if (NULL == ((*data)->value.str = hc_mem_value_str_dup(&item_value->value.value_str)))
+		if (NULL == ((*data)->value.str = hc_mem_value_str_dup(&item_value->value.value_str, strings)))
 			return FAIL;
 
 		(*data)->value_type = ITEM_VALUE_TYPE_TEXT;
 
-		cache->stats.history_text_counter++;
-		cache->stats.history_counter++;
+		shard->stats.history_text_counter++;
+		shard->stats.history_counter++;
 
 		return SUCCEED;
 	}
@@ -4147,20 +4856,20 @@ static int	hc_clone_history_data(zbx_hc_data_t **data, const dc_item_value_t *it
 				break;
 			case ITEM_VALUE_TYPE_STR:
 				if (SUCCEED != hc_clone_history_str_data(&(*data)->value.str,
-						&item_value->value.value_str))
+						&item_value->value.value_str, strings))
 				{
 					return FAIL;
 				}
 				break;
 			case ITEM_VALUE_TYPE_TEXT:
 				if (SUCCEED != hc_clone_history_str_data(&(*data)->value.str,
-						&item_value->value.value_str))
+						&item_value->value.value_str, strings))
 				{
 					return FAIL;
 				}
 				break;
 			case ITEM_VALUE_TYPE_LOG:
-				if (SUCCEED != hc_clone_history_log_data(&(*data)->value.log, item_value))
+				if (SUCCEED != hc_clone_history_log_data(&(*data)->value.log, item_value, strings))
 					return FAIL;
 				break;
 		}
@@ -4168,23 +4877,23 @@ static int	hc_clone_history_data(zbx_hc_data_t **data, const dc_item_value_t *it
 		switch (item_value->item_value_type)
 		{
 			case ITEM_VALUE_TYPE_FLOAT:
-				cache->stats.history_float_counter++;
+				shard->stats.history_float_counter++;
 				break;
 			case ITEM_VALUE_TYPE_UINT64:
-				cache->stats.history_uint_counter++;
+				shard->stats.history_uint_counter++;
 				break;
 			case ITEM_VALUE_TYPE_STR:
-				cache->stats.history_str_counter++;
+				shard->stats.history_str_counter++;
 				break;
 			case ITEM_VALUE_TYPE_TEXT:
-				cache->stats.history_text_counter++;
+				shard->stats.history_text_counter++;
 				break;
 			case ITEM_VALUE_TYPE_LOG:
-				cache->stats.history_log_counter++;
+				shard->stats.history_log_counter++;
 				break;
 		}
 
-		cache->stats.history_counter++;
+		shard->stats.history_counter++;
 	}
 
 	(*data)->value_type = item_value->value_type;
@@ -4194,194 +4903,1941 @@ static int	hc_clone_history_data(zbx_hc_data_t **data, const dc_item_value_t *it
 
 /******************************************************************************
  *                                                                            *
- * Function: hc_add_item_values                                               *
- *                                                                            *
- * Purpose: adds item values to the history cache                             *
+ * Function: hc_free_cloned_data                                              *
  *                                                                            *
- * Parameters: values     - [IN] the item values to add                       *
- *             values_num - [IN] the number of item values to add             *
+ * Purpose: frees partially cloned item value                                 *
  *                                                                            *
- * Comments: If the history cache is full this function will wait until       *
- *           history syncers processes values freeing enough space to store   *
- *           the new value.                                                   *
+ * Parameters: data       - [IN] the history data being cloned                *
+ *             item_value - [IN] the item value being cloned                  *
  *                                                                            *
  ******************************************************************************/
-static void	hc_add_item_values(dc_item_value_t *values, int values_num)
+static void	hc_free_cloned_data(zbx_hc_data_t *data, const dc_item_value_t *item_value)
 {
-	dc_item_value_t	*item_value;
-	int		i;
-	zbx_hc_item_t	*item;
-
-	for (i = 0; i < values_num; i++)
+	if (ITEM_STATE_NOTSUPPORTED == item_value->state || 0 != (ZBX_DC_FLAG_LLD & item_value->flags))
 	{
-		zbx_hc_data_t	*data = NULL;
-
-		item_value = &values[i];
-
-		/* a record with metadata and no value can be dropped if  */
-		/* the metadata update is copied to the last queued value */
-		if (NULL != (item = hc_get_item(item_value->itemid)) &&
-				0 != (item_value->flags & ZBX_DC_FLAG_NOVALUE) &&
-				0 != (item_value->flags & ZBX_DC_FLAG_META))
-		{
-			/* skip metadata updates when only one value is queued, */
-			/* because the item might be already being processed    */
-			if (item->head != item->tail)
-			{
-				item->head->lastlogsize = item_value->lastlogsize;
-				item->head->mtime = item_value->mtime;
-				item->head->flags |= ZBX_DC_FLAG_META;
-				continue;
-			}
-		}
-
-		if (SUCCEED != hc_clone_history_data(&data, item_value))
+		if (NULL != data->value.str)
+			__hc_mem_free_func(data->value.str);
+	}
+	else if (0 == (ZBX_DC_FLAG_NOVALUE & item_value->flags))
+	{
+		switch (item_value->value_type)
 		{
-			do
-			{
-				UNLOCK_CACHE;
-
-				zabbix_log(LOG_LEVEL_DEBUG, "History cache is full. Sleeping for 1 second.");
-				sleep(1);
+			case ITEM_VALUE_TYPE_STR:
+			case ITEM_VALUE_TYPE_TEXT:
+				if (NULL != data->value.str)
+					__hc_mem_free_func(data->value.str);
+				break;
+			case ITEM_VALUE_TYPE_LOG:
+				if (NULL == data->value.log)
+					break;
 
-				LOCK_CACHE;
-			}
-			while (SUCCEED != hc_clone_history_data(&data, item_value));
+				if (NULL != data->value.log->value)
+					__hc_mem_free_func(data->value.log->value);
 
-			item = hc_get_item(item_value->itemid);
-		}
+				if (NULL != data->value.log->source)
+					__hc_mem_free_func(data->value.log->source);
 
-		if (NULL == item)
-		{
-			item = hc_add_item(item_value->itemid, data);
-			hc_queue_item(item);
-		}
-		else
-		{
-			item->head->next = data;
-			item->head = data;
+				__hc_mem_free_func(data->value.log);
+				break;
 		}
-		item->values_num++;
 	}
+
+	__hc_mem_free_func(data);
 }
 
 /******************************************************************************
  *                                                                            *
- * Function: hc_copy_history_data                                             *
+ * Function: hc_value_is_compressible                                         *
  *                                                                            *
- * Purpose: copies item value from history cache into the specified history   *
- *          value                                                             *
+ * Purpose: checks if item value can be appended to the compressed block of   *
+ *          the specified history data                                        *
  *                                                                            *
- * Parameters: history - [OUT] the history value                              *
- *             itemid  - [IN] the item identifier                             *
- *             data    - [IN] the history data to copy                        *
+ * Parameters: data       - [IN] the last queued history data of the item     *
+ *             item_value - [IN] the item value                               *
  *                                                                            *
- * Comments: handling of uninitialized fields in dc_add_proxy_history_log()   *
+ * Return value: SUCCEED - the value can be compressed                        *
+ *               FAIL    - otherwise                                          *
  *                                                                            *
  ******************************************************************************/
-static void	hc_copy_history_data(ZBX_DC_HISTORY *history, zbx_uint64_t itemid, zbx_hc_data_t *data)
+static int	hc_value_is_compressible(const zbx_hc_data_t *data, const dc_item_value_t *item_value)
 {
-	history->itemid = itemid;
-	history->ts = data->ts;
-	history->state = data->state;
-	history->flags = data->flags;
-	history->lastlogsize = data->lastlogsize;
-	history->mtime = data->mtime;
+	if (ITEM_STATE_NORMAL != item_value->state || ITEM_STATE_NORMAL != data->state)
+		return FAIL;
 
-	if (ITEM_STATE_NOTSUPPORTED == data->state)
+	/* all values in block share flags of the history data */
+	if (0 != (item_value->flags & (ZBX_DC_FLAG_META | ZBX_DC_FLAG_NOVALUE | ZBX_DC_FLAG_LLD | ZBX_DC_FLAG_UNDEF)) ||
+			item_value->flags != data->flags)
 	{
-		history->value.err = zbx_strdup(NULL, data->value.str);
-		history->flags |= ZBX_DC_FLAG_UNDEF;
-		return;
+		return FAIL;
 	}
 
-	history->value_type = data->value_type;
-
-	if (0 == (ZBX_DC_FLAG_NOVALUE & data->flags))
-	{
-		switch (data->value_type)
-		{
-			case ITEM_VALUE_TYPE_FLOAT:
-				history->value.dbl = data->value.dbl;
-				break;
-			case ITEM_VALUE_TYPE_UINT64:
-				history->value.ui64 = data->value.ui64;
-				break;
-			case ITEM_VALUE_TYPE_STR:
-			case ITEM_VALUE_TYPE_TEXT:
-				history->value.str = zbx_strdup(NULL, data->value.str);
-				break;
-			case ITEM_VALUE_TYPE_LOG:
-				history->value.log = (zbx_log_value_t *)zbx_malloc(NULL, sizeof(zbx_log_value_t));
-				history->value.log->value = zbx_strdup(NULL, data->value.log->value);
-
-				if (NULL != data->value.log->source)
-					history->value.log->source = zbx_strdup(NULL, data->value.log->source);
-				else
-					history->value.log->source = NULL;
+	if (ITEM_VALUE_TYPE_FLOAT != item_value->value_type && ITEM_VALUE_TYPE_UINT64 != item_value->value_type)
+		return FAIL;
 
-				history->value.log->timestamp = data->value.log->timestamp;
-				history->value.log->severity = data->value.log->severity;
-				history->value.log->logeventid = data->value.log->logeventid;
+	if (item_value->value_type != data->value_type || item_value->value_type != item_value->item_value_type)
+		return FAIL;
 
-				break;
-		}
-	}
+	return SUCCEED;
 }
 
 /******************************************************************************
  *                                                                            *
- * Function: hc_pop_items                                                     *
+ * Function: hc_compress_value                                                *
  *                                                                            *
- * Purpose: pops the next batch of history items from cache for processing    *
+ * Purpose: appends item value to the compressed block of the last queued     *
+ *          item history data                                                 *
  *                                                                            *
- * Parameters: history_items - [OUT] the locked history items                 *
+ * Parameters: shard      - [IN] the history cache shard                      *
+ *             item       - [IN] the history item                             *
+ *             item_value - [IN] the item value                               *
+ *                                                                            *
+ * Return value: SUCCEED - the value was compressed                           *
+ *               FAIL    - the value must be added as separate history data   *
  *                                                                            *
- * Comments: The history_items must be returned back to history cache with    *
- *           hc_push_items() function after they have been processed.         *
+ * Comments: The compressed block is started with the value of history data   *
+ *           it's attached to. This value is decoded right away, so history   *
+ *           data always contains the next value to be synced.                *
+ *           Blocks are only attached to the values of items already having   *
+ *           queued values, so items with regularly synced values are not     *
+ *           affected.                                                        *
  *                                                                            *
  ******************************************************************************/
-static void	hc_pop_items(zbx_vector_ptr_t *history_items)
+static int	hc_compress_value(zbx_hc_shard_t *shard, zbx_hc_item_t *item, const dc_item_value_t *item_value)
 {
-	zbx_binary_heap_elem_t	*elem;
-	zbx_hc_item_t		*item;
+	zbx_hc_data_t	*data = item->head;
+	zbx_hc_block_t	*block;
+	zbx_uint64_t	value;
+
+	if (0 == CONFIG_HISTORY_CACHE_COMPRESSION || SUCCEED != hc_value_is_compressible(data, item_value))
+		return FAIL;
+
+	if (NULL == (block = data->block))
+	{
+		zbx_timespec_t	ts;
+
+		if (NULL == (block = (zbx_hc_block_t *)__hc_mem_malloc_func(NULL,
+				sizeof(zbx_hc_block_t) + ZBX_HC_BLOCK_SIZE_MIN)))
+		{
+			return FAIL;
+		}
+
+		block->size = ZBX_HC_BLOCK_SIZE_MIN;
+		zbx_gorilla_init(&block->encoder);
+		zbx_gorilla_init(&block->decoder);
+
+		zbx_gorilla_encode(&block->encoder, HC_BLOCK_DATA(block), block->size, &data->ts, data->value.ui64);
+		zbx_gorilla_decode(&block->decoder, HC_BLOCK_DATA(block), &ts, &value);
+
+		data->block = block;
+
+		shard->compressed_values_num++;
+		shard->compressed_size += sizeof(zbx_hc_data_t) + sizeof(zbx_hc_block_t) + block->size;
+	}
+
+	if (ITEM_VALUE_TYPE_FLOAT == item_value->value_type)
+		memcpy(&value, &item_value->value.value_dbl, sizeof(value));
+	else
+		value = item_value->value.value_uint;
 
-	while (ZBX_HC_SYNC_MAX > history_items->values_num && FAIL == zbx_binary_heap_empty(&cache->history_queue))
+	while (SUCCEED != zbx_gorilla_encode(&block->encoder, HC_BLOCK_DATA(block), block->size, &item_value->ts,
+			value))
 	{
-		elem = zbx_binary_heap_find_min(&cache->history_queue);
-		item = (zbx_hc_item_t *)elem->data;
-		zbx_vector_ptr_append(history_items, item);
+		zbx_hc_block_t	*block_new;
+		size_t		size = block->size * 2;
+
+		if (ZBX_HC_BLOCK_SIZE_MAX < size)
+			return FAIL;
+
+		if (NULL == (block_new = (zbx_hc_block_t *)__hc_mem_realloc_func(block,
+				sizeof(zbx_hc_block_t) + size)))
+		{
+			return FAIL;
+		}
 
-		zbx_binary_heap_remove_min(&cache->history_queue);
+		shard->compressed_size += size - block_new->size;
+		block_new->size = size;
+		data->block = block = block_new;
 	}
+
+	if (ITEM_VALUE_TYPE_FLOAT == item_value->value_type)
+		shard->stats.history_float_counter++;
+	else
+		shard->stats.history_uint_counter++;
+
+	shard->stats.history_counter++;
+	shard->compressed_values_num++;
+
+	return SUCCEED;
 }
 
 /******************************************************************************
  *                                                                            *
- * Function: hc_get_item_values                                               *
+ * Function: hc_decompress_value                                              *
  *                                                                            *
- * Purpose: gets item history values                                          *
+ * Purpose: replaces the processed value of history data with the next value  *
+ *          from its compressed block                                         *
  *                                                                            *
- * Parameters: history       - [OUT] the history valeus                       *
- *             history_items - [IN] the history items                         *
+ * Parameters: shard - [IN] the history cache shard                           *
+ *             data  - [IN/OUT] the history data with compressed block        *
+ *                                                                            *
+ * Return value: SUCCEED - the next value was decoded                         *
+ *               FAIL    - the block has no more values, the history data     *
+ *                         can be freed                                       *
  *                                                                            *
  ******************************************************************************/
-static void	hc_get_item_values(ZBX_DC_HISTORY *history, zbx_vector_ptr_t *history_items)
+static int	hc_decompress_value(zbx_hc_shard_t *shard, zbx_hc_data_t *data)
 {
-	int		i, history_num = 0;
-	zbx_hc_item_t	*item;
+	zbx_hc_block_t	*block = data->block;
 
-	/* we don't need to lock history cache because no other processes can  */
-	/* change item's history data until it is pushed back to history queue */
-	for (i = 0; i < history_items->values_num; i++)
+	shard->compressed_values_num--;
+
+	if (block->decoder.values_num == block->encoder.values_num)
 	{
-		item = (zbx_hc_item_t *)history_items->values[i];
+		shard->compressed_size -= sizeof(zbx_hc_data_t) + sizeof(zbx_hc_block_t) + block->size;
+		return FAIL;
+	}
 
-		if (ZBX_HC_ITEM_STATUS_BUSY == item->status)
-			continue;
+	zbx_gorilla_decode(&block->decoder, HC_BLOCK_DATA(block), &data->ts, &data->value.ui64);
 
-		hc_copy_history_data(&history[history_num++], item->itemid, item->tail);
-	}
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_add_item_value                                                *
+ *                                                                            *
+ * Purpose: adds item value to the history cache                              *
+ *                                                                            *
+ * Parameters: shard      - [IN] the history cache shard                      *
+ *             item_value - [IN] the item value to add                        *
+ *             strings    - [IN] the buffer containing item value strings     *
+ *                                                                            *
+ * Return value: SUCCEED - the value was added                                *
+ *               FAIL    - there is not enough memory in history cache        *
+ *                                                                            *
+ ******************************************************************************/
+static int	hc_add_item_value(zbx_hc_shard_t *shard, const dc_item_value_t *item_value, const char *strings)
+{
+	zbx_hc_item_t	*item;
+	zbx_hc_data_t	*data = NULL;
+
+	/* a record with metadata and no value can be dropped if  */
+	/* the metadata update is copied to the last queued value */
+	if (NULL != (item = hc_get_item(shard, item_value->itemid)) &&
+			0 != (item_value->flags & ZBX_DC_FLAG_NOVALUE) &&
+			0 != (item_value->flags & ZBX_DC_FLAG_META))
+	{
+		/* skip metadata updates when only one value is queued, */
+		/* because the item might be already being processed,   */
+		/* or when the last value is shared by compressed values */
+		if (item->head != item->tail && NULL == item->head->block)
+		{
+			item->head->lastlogsize = item_value->lastlogsize;
+			item->head->mtime = item_value->mtime;
+			item->head->flags |= ZBX_DC_FLAG_META;
+			return SUCCEED;
+		}
+	}
+
+	if (NULL != item && SUCCEED == hc_compress_value(shard, item, item_value))
+	{
+		item->values_num++;
+		return SUCCEED;
+	}
+
+	if (SUCCEED != hc_clone_history_data(shard, &data, item_value, strings))
+	{
+		if (NULL != data)
+			hc_free_cloned_data(data, item_value);
+
+		return FAIL;
+	}
+
+	if (NULL == item)
+	{
+		item = hc_add_item(shard, item_value->itemid, data);
+		hc_queue_item(shard, item);
+	}
+	else
+	{
+		item->head->next = data;
+		item->head = data;
+	}
+	item->values_num++;
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_add_item_values                                               *
+ *                                                                            *
+ * Purpose: adds item values to the history cache                             *
+ *                                                                            *
+ * Parameters: shard      - [IN] the history cache shard                      *
+ *             values     - [IN] the item values to add                       *
+ *             values_num - [IN] the number of item values to add             *
+ *                                                                            *
+ * Comments: Only values of items belonging to the specified shard are added, *
+ *           the shard must be locked by the caller.                          *
+ *           If the history cache is full the values are written to history   *
+ *           cache spool (if configured). To keep the values in order, new    *
+ *           values are spooled until history syncers move all spooled values *
+ *           back to history cache. For the same reason new values are        *
+ *           spooled while the shard has values not loaded from history cache *
+ *           snapshot.                                                        *
+ *           If the history cache (and spool) is full this function will wait *
+ *           until history syncers processes values freeing enough space to   *
+ *           store the new value.                                             *
+ *                                                                            *
+ ******************************************************************************/
+static void	hc_add_item_values(zbx_hc_shard_t *shard, dc_item_value_t *values, int values_num)
+{
+	dc_item_value_t	*item_value;
+	int		i;
+
+	for (i = 0; i < values_num; i++)
+	{
+		item_value = &values[i];
+
+		if (cache->shards[hc_get_shard_index(item_value->itemid)] != shard)
+			continue;
+
+		while (1)
+		{
+			if ((NULL == shard->spool || 0 == shard->spool->values_num) && 0 == shard->snapshot_values_num)
+			{
+				if (SUCCEED == hc_add_item_value(shard, item_value, string_values))
+					break;
+			}
+
+			if (NULL != shard->spool && SUCCEED == hc_spool_write(shard, item_value, string_values))
+				break;
+
+			UNLOCK_SHARD(shard);
+
+			zabbix_log(LOG_LEVEL_DEBUG, "History cache is full. Sleeping for 1 second.");
+			sleep(1);
+
+			LOCK_SHARD(shard);
+		}
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * history cache spool                                                        *
+ *                                                                            *
+ ******************************************************************************/
+
+static int		spool_fd = -1;
+static void		*spool_map = MAP_FAILED;
+static size_t		spool_map_size = 0;
+
+/* history cache snapshot with the values that were not loaded at start, mapped before forking */
+static void		*snapshot_map = MAP_FAILED;
+static size_t		snapshot_map_size = 0;
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_item_value_get_strings                                        *
+ *                                                                            *
+ * Purpose: gets the lengths of strings used by item value                    *
+ *                                                                            *
+ * Parameters: item_value - [IN] the item value                               *
+ *             value_len  - [OUT] the length of value string                  *
+ *             source_len - [OUT] the length of log source string             *
+ *                                                                            *
+ ******************************************************************************/
+static void	hc_item_value_get_strings(const dc_item_value_t *item_value, size_t *value_len, size_t *source_len)
+{
+	*value_len = 0;
+	*source_len = 0;
+
+	if (ITEM_STATE_NOTSUPPORTED == item_value->state || 0 != (ZBX_DC_FLAG_LLD & item_value->flags))
+	{
+		*value_len = item_value->value.value_str.len;
+		return;
+	}
+
+	if (0 != (ZBX_DC_FLAG_NOVALUE & item_value->flags))
+		return;
+
+	switch (item_value->value_type)
+	{
+		case ITEM_VALUE_TYPE_STR:
+		case ITEM_VALUE_TYPE_TEXT:
+			*value_len = item_value->value.value_str.len;
+			break;
+		case ITEM_VALUE_TYPE_LOG:
+			*value_len = item_value->value.value_str.len;
+			*source_len = item_value->source.len;
+			break;
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_value_record_size                                             *
+ *                                                                            *
+ * Purpose: calculates the size of item value record                          *
+ *                                                                            *
+ ******************************************************************************/
+static size_t	hc_value_record_size(const dc_item_value_t *item_value)
+{
+	size_t	value_len, source_len;
+
+	hc_item_value_get_strings(item_value, &value_len, &source_len);
+
+	return ZBX_SIZE_T_ALIGN8(sizeof(zbx_hc_value_record_t) + sizeof(dc_item_value_t) + value_len + source_len);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_value_record_checksum                                         *
+ *                                                                            *
+ * Purpose: calculates checksum of item value record data                     *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_hash_t	hc_value_record_checksum(const zbx_hc_value_record_t *record, zbx_uint32_t seed)
+{
+	return zbx_hash_modfnv(record + 1, record->size - sizeof(zbx_hc_value_record_t), seed);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_value_record_write                                            *
+ *                                                                            *
+ * Purpose: writes item value with its strings into a record                  *
+ *                                                                            *
+ * Parameters: record     - [OUT] the record, must have at least the size     *
+ *                                returned by hc_value_record_size()          *
+ *             item_value - [IN] the item value                               *
+ *             strings    - [IN] the buffer containing item value strings     *
+ *             seed       - [IN] the record checksum seed                     *
+ *                                                                            *
+ * Comments: The record checksum is written last, so a partially written      *
+ *           record will be discarded when loading records after crash.       *
+ *           The string offsets of the stored item value are relative to the  *
+ *           end of item value structure.                                     *
+ *                                                                            *
+ ******************************************************************************/
+static void	hc_value_record_write(zbx_hc_value_record_t *record, const dc_item_value_t *item_value,
+		const char *strings, zbx_uint32_t seed)
+{
+	dc_item_value_t	*value = (dc_item_value_t *)(record + 1);
+	char		*ptr = (char *)(value + 1);
+	size_t		value_len, source_len, size;
+
+	hc_item_value_get_strings(item_value, &value_len, &source_len);
+	size = ZBX_SIZE_T_ALIGN8(sizeof(zbx_hc_value_record_t) + sizeof(dc_item_value_t) + value_len + source_len);
+
+	*value = *item_value;
+
+	if (0 != value_len)
+	{
+		memcpy(ptr, strings + item_value->value.value_str.pvalue, value_len);
+		value->value.value_str.pvalue = 0;
+	}
+
+	if (0 != source_len)
+	{
+		memcpy(ptr + value_len, strings + item_value->source.pvalue, source_len);
+		value->source.pvalue = value_len;
+	}
+
+	memset(ptr + value_len + source_len, 0, (char *)record + size - (ptr + value_len + source_len));
+
+	record->size = (zbx_uint32_t)size;
+	record->checksum = hc_value_record_checksum(record, seed);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_value_record_validate                                         *
+ *                                                                            *
+ * Purpose: checks if item value record was completely written                *
+ *                                                                            *
+ * Parameters: record - [IN] the record                                       *
+ *             size   - [IN] the number of bytes available from record start  *
+ *             seed   - [IN] the record checksum seed                         *
+ *                                                                            *
+ * Return value: SUCCEED - the record is valid                                *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+static int	hc_value_record_validate(const zbx_hc_value_record_t *record, zbx_uint64_t size, zbx_uint32_t seed)
+{
+	const dc_item_value_t	*value = (const dc_item_value_t *)(record + 1);
+	size_t			value_len, source_len;
+
+	if (sizeof(zbx_hc_value_record_t) + sizeof(dc_item_value_t) > size)
+		return FAIL;
+
+	if (sizeof(zbx_hc_value_record_t) + sizeof(dc_item_value_t) > record->size || size < record->size ||
+			0 != (record->size & 7) || record->checksum != hc_value_record_checksum(record, seed))
+	{
+		return FAIL;
+	}
+
+	hc_item_value_get_strings(value, &value_len, &source_len);
+
+	if (record->size < sizeof(zbx_hc_value_record_t) + sizeof(dc_item_value_t) + value_len + source_len)
+		return FAIL;
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_spool_wrap_checksum                                           *
+ *                                                                            *
+ * Purpose: calculates checksum of the record marking spool segment wrap      *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_hash_t	hc_spool_wrap_checksum(zbx_uint32_t seed)
+{
+	return zbx_hash_modfnv(ZBX_HC_SPOOL_MAGIC, ZBX_CONST_STRLEN(ZBX_HC_SPOOL_MAGIC), seed);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_spool_is_wrap                                                 *
+ *                                                                            *
+ * Purpose: checks if the next record must be read from the segment start     *
+ *                                                                            *
+ * Parameters: spool  - [IN] the spool segment                                *
+ *             offset - [IN] the record offset                                *
+ *             seed   - [IN] the record checksum seed                         *
+ *                                                                            *
+ * Return value: SUCCEED - the segment wraps at the offset                    *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+static int	hc_spool_is_wrap(const zbx_hc_spool_t *spool, zbx_uint64_t offset, zbx_uint32_t seed)
+{
+	const zbx_hc_value_record_t	*record;
+
+	if (spool->size - offset < sizeof(zbx_hc_value_record_t))
+		return SUCCEED;
+
+	record = (const zbx_hc_value_record_t *)((const char *)spool + offset);
+
+	if (0 == record->size && hc_spool_wrap_checksum(seed) == record->checksum)
+		return SUCCEED;
+
+	return FAIL;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_spool_write                                                   *
+ *                                                                            *
+ * Purpose: appends item value to the history cache shard spool               *
+ *                                                                            *
+ * Comments: The space freed by refilling history cache is reused as soon as  *
+ *           there is enough of it before the oldest spooled value.           *
+ *                                                                            *
+ * Parameters: shard      - [IN] the history cache shard                      *
+ *             item_value - [IN] the item value to spool                      *
+ *             strings    - [IN] the buffer containing item value strings     *
+ *                                                                            *
+ * Return value: SUCCEED - the value was spooled                              *
+ *               FAIL    - there is not enough space in spool                 *
+ *                                                                            *
+ ******************************************************************************/
+static int	hc_spool_write(zbx_hc_shard_t *shard, const dc_item_value_t *item_value, const char *strings)
+{
+	zbx_hc_spool_t	*spool = shard->spool;
+	size_t		size;
+
+	size = hc_value_record_size(item_value);
+
+	if (0 != spool->values_num && spool->write_offset <= spool->read_offset)
+	{
+		/* the writer has wrapped, free space is up to the oldest value */
+		if (spool->read_offset - spool->write_offset < size)
+			return FAIL;
+	}
+	else if (spool->size - spool->write_offset < size)
+	{
+		zbx_hc_value_record_t	*record;
+
+		if (spool->read_offset - HC_SPOOL_HEADER_SIZE < size)
+			return FAIL;
+
+		if (spool->size - spool->write_offset >= sizeof(zbx_hc_value_record_t))
+		{
+			record = (zbx_hc_value_record_t *)((char *)spool + spool->write_offset);
+			record->size = 0;
+			record->checksum = hc_spool_wrap_checksum(spool->generation);
+		}
+
+		spool->write_offset = HC_SPOOL_HEADER_SIZE;
+		spool->generation++;
+	}
+
+	hc_value_record_write((zbx_hc_value_record_t *)((char *)spool + spool->write_offset), item_value, strings,
+			spool->generation);
+
+	spool->write_offset += size;
+
+	if (1 == ++spool->values_num)
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "history cache shard #%d is full, spooling new values to disk",
+				hc_get_shard_index(item_value->itemid));
+	}
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_spool_reset                                                   *
+ *                                                                            *
+ * Purpose: empties history cache spool segment                               *
+ *                                                                            *
+ ******************************************************************************/
+static void	hc_spool_reset(zbx_hc_spool_t *spool)
+{
+	spool->generation++;
+	spool->read_generation = spool->generation;
+	spool->read_offset = HC_SPOOL_HEADER_SIZE;
+	spool->write_offset = HC_SPOOL_HEADER_SIZE;
+	spool->values_num = 0;
+	spool->snapshot_num = 0;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_snapshot_record_shard                                         *
+ *                                                                            *
+ * Purpose: returns history cache shard of the item value stored in record    *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_hc_shard_t	*hc_snapshot_record_shard(const zbx_hc_value_record_t *record)
+{
+	return cache->shards[hc_get_shard_index(((const dc_item_value_t *)(record + 1))->itemid)];
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_spool_refill                                                  *
+ *                                                                            *
+ * Purpose: moves the oldest spooled values and the values not loaded from    *
+ *          history cache snapshot back to history cache shard                *
+ *                                                                            *
+ * Parameters: shard - [IN] the history cache shard                           *
+ *                                                                            *
+ * Comments: The values are moved while there is enough memory in history     *
+ *           cache. The shard must be locked by the caller.                   *
+ *           The values not loaded from snapshot are moved after the spooled  *
+ *           values that were loaded from snapshot and before the values      *
+ *           spooled later.                                                   *
+ *                                                                            *
+ ******************************************************************************/
+static void	hc_spool_refill(zbx_hc_shard_t *shard)
+{
+	zbx_hc_spool_t			*spool = shard->spool;
+	const zbx_hc_value_record_t	*record;
+	const dc_item_value_t		*value;
+	int				i, spooled = 0;
+
+	for (i = 0; i < ZBX_HC_SPOOL_REFILL_MAX; i++)
+	{
+		if (0 != shard->snapshot_values_num && (NULL == spool || 0 == spool->snapshot_num))
+		{
+			record = (const zbx_hc_value_record_t *)((char *)snapshot_map + shard->snapshot_offset);
+
+			/* snapshot records of all shards are mixed together */
+			while (shard != hc_snapshot_record_shard(record))
+			{
+				shard->snapshot_offset += record->size;
+				record = (const zbx_hc_value_record_t *)((char *)snapshot_map + shard->snapshot_offset);
+			}
+
+			value = (const dc_item_value_t *)(record + 1);
+
+			if (SUCCEED != hc_add_item_value(shard, value, (const char *)(value + 1)))
+				break;
+
+			shard->snapshot_offset += record->size;
+
+			if (0 == --shard->snapshot_values_num)
+			{
+				zabbix_log(LOG_LEVEL_WARNING, "all values not loaded from history cache snapshot were"
+						" moved to history cache shard #%d", hc_get_shard_index(value->itemid));
+			}
+
+			continue;
+		}
+
+		if (NULL == spool || 0 == spool->values_num)
+			break;
+
+		if (SUCCEED == hc_spool_is_wrap(spool, spool->read_offset, spool->read_generation))
+		{
+			spool->read_offset = HC_SPOOL_HEADER_SIZE;
+			spool->read_generation++;
+		}
+
+		record = (const zbx_hc_value_record_t *)((char *)spool + spool->read_offset);
+		value = (const dc_item_value_t *)(record + 1);
+
+		if (SUCCEED != hc_add_item_value(shard, value, (const char *)(value + 1)))
+			break;
+
+		spool->read_offset += record->size;
+		spool->values_num--;
+
+		if (0 != spool->snapshot_num)
+			spool->snapshot_num--;
+
+		spooled = 1;
+	}
+
+	if (0 != spooled && 0 == spool->values_num)
+	{
+		hc_spool_reset(spool);
+		zabbix_log(LOG_LEVEL_WARNING, "all spooled values were moved back to history cache shard #%d",
+				(int)(((char *)spool - (char *)spool_map) / spool->size));
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_spool_load                                                    *
+ *                                                                            *
+ * Purpose: validates history cache spool segment left by previous run        *
+ *                                                                            *
+ * Parameters: spool - [IN/OUT] the spool segment                             *
+ *             size  - [IN] the segment size                                  *
+ *                                                                            *
+ * Return value: The number of values recovered from spool segment.           *
+ *                                                                            *
+ * Comments: The segment is reinitialized if it's not valid. Otherwise the    *
+ *           records are checked starting with the oldest spooled value until *
+ *           the first invalid record - the write offset and the number of    *
+ *           values stored in header cannot be trusted after crash. Records   *
+ *           left by the previous lap of the ring buffer do not match the     *
+ *           checksum seed of the current lap.                                *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_uint64_t	hc_spool_load(zbx_hc_spool_t *spool, zbx_uint64_t size)
+{
+	zbx_uint64_t			offset, end = size;
+	zbx_uint32_t			seed;
+	const zbx_hc_value_record_t	*record;
+	int				wrapped = 0;
+
+	if (0 != memcmp(spool->magic, ZBX_HC_SPOOL_MAGIC, sizeof(spool->magic)) ||
+			ZBX_HC_SPOOL_VERSION != spool->version || sizeof(dc_item_value_t) != spool->value_size ||
+			size != spool->size ||
+			spool->checksum != zbx_hash_modfnv(spool, offsetof(zbx_hc_spool_t, checksum), 0) ||
+			HC_SPOOL_HEADER_SIZE > spool->read_offset || size < spool->read_offset)
+	{
+		if (0 == memcmp(spool->magic, ZBX_HC_SPOOL_MAGIC, sizeof(spool->magic)))
+		{
+			zabbix_log(LOG_LEVEL_WARNING, "discarding history cache spool segment of incompatible format"
+					" version %u", spool->version);
+		}
+
+		memcpy(spool->magic, ZBX_HC_SPOOL_MAGIC, sizeof(spool->magic));
+		spool->version = ZBX_HC_SPOOL_VERSION;
+		spool->value_size = sizeof(dc_item_value_t);
+		spool->size = size;
+		spool->checksum = zbx_hash_modfnv(spool, offsetof(zbx_hc_spool_t, checksum), 0);
+		spool->generation = 0;
+		hc_spool_reset(spool);
+
+		return 0;
+	}
+
+	spool->values_num = 0;
+	offset = spool->read_offset;
+	seed = spool->read_generation;
+
+	while (1)
+	{
+		if (0 == wrapped && SUCCEED == hc_spool_is_wrap(spool, offset, seed))
+		{
+			/* continue with the records written after wrap, up to the oldest value */
+			wrapped = 1;
+			offset = HC_SPOOL_HEADER_SIZE;
+			end = spool->read_offset;
+			seed++;
+		}
+
+		if (end <= offset)
+			break;
+
+		record = (const zbx_hc_value_record_t *)((char *)spool + offset);
+
+		if (SUCCEED != hc_value_record_validate(record, end - offset, seed))
+			break;
+
+		spool->values_num++;
+		offset += record->size;
+	}
+
+	if (0 == spool->values_num)
+	{
+		hc_spool_reset(spool);
+	}
+	else
+	{
+		spool->write_offset = offset;
+		spool->generation = seed;
+
+		if (spool->snapshot_num > spool->values_num)
+			spool->snapshot_num = spool->values_num;
+	}
+
+	return spool->values_num;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_spool_count_previous                                          *
+ *                                                                            *
+ * Purpose: counts values spooled by previous run with different spool layout *
+ *                                                                            *
+ * Parameters: file_size    - [IN] the spool file size                        *
+ *             segment_size - [OUT] the segment size of previous run, 0 if    *
+ *                                  the file has unknown format               *
+ *                                                                            *
+ * Return value: The number of valid values in the file.                      *
+ *                                                                            *
+ * Comments: The file is mapped privately, so the segments are validated      *
+ *           without modifying it.                                            *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_uint64_t	hc_spool_count_previous(size_t file_size, zbx_uint64_t *segment_size)
+{
+	void		*map;
+	zbx_hc_spool_t	*spool;
+	zbx_uint64_t	values_num = 0, offset;
+
+	*segment_size = 0;
+
+	if (sizeof(zbx_hc_spool_t) > file_size)
+		return 0;
+
+	if (MAP_FAILED == (map = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, spool_fd, 0)))
+		return 0;
+
+	spool = (zbx_hc_spool_t *)map;
+
+	if (0 == memcmp(spool->magic, ZBX_HC_SPOOL_MAGIC, sizeof(spool->magic)) &&
+			ZBX_HC_SPOOL_VERSION == spool->version && sizeof(dc_item_value_t) == spool->value_size &&
+			HC_SPOOL_HEADER_SIZE < spool->size && spool->size <= file_size &&
+			spool->checksum == zbx_hash_modfnv(spool, offsetof(zbx_hc_spool_t, checksum), 0))
+	{
+		*segment_size = spool->size;
+
+		for (offset = 0; offset + *segment_size <= file_size; offset += *segment_size)
+			values_num += hc_spool_load((zbx_hc_spool_t *)((char *)map + offset), *segment_size);
+	}
+
+	munmap(map, file_size);
+
+	return values_num;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_spool_init                                                    *
+ *                                                                            *
+ * Purpose: opens history cache spool file and maps it into memory            *
+ *                                                                            *
+ * Parameters: error - [OUT] the error message                                *
+ *                                                                            *
+ * Return value: SUCCEED - the spool was initialized                          *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ * Comments: The spool file is divided into equal segments for each history   *
+ *           cache shard. The values spooled by previous run are recovered    *
+ *           and will be moved to history cache by history syncers.           *
+ *           The file is mapped before forking, so all processes share the    *
+ *           same mapping at the same address.                                *
+ *                                                                            *
+ ******************************************************************************/
+static int	hc_spool_init(char **error)
+{
+	zbx_stat_t	st;
+	zbx_uint64_t	segment_size, values_num = 0;
+	int		i;
+
+	segment_size = (CONFIG_HISTORY_CACHE_SPOOL_SIZE / cache->shards_num) & ~(zbx_uint64_t)7;
+	spool_map_size = (size_t)(segment_size * cache->shards_num);
+
+	if (-1 == (spool_fd = open(CONFIG_HISTORY_CACHE_SPOOL_FILE, O_RDWR | O_CREAT, 0600)))
+	{
+		*error = zbx_dsprintf(*error, "cannot open history cache spool file \"%s\": %s",
+				CONFIG_HISTORY_CACHE_SPOOL_FILE, zbx_strerror(errno));
+		return FAIL;
+	}
+
+	if (0 != fstat(spool_fd, &st))
+	{
+		*error = zbx_dsprintf(*error, "cannot stat history cache spool file \"%s\": %s",
+				CONFIG_HISTORY_CACHE_SPOOL_FILE, zbx_strerror(errno));
+		return FAIL;
+	}
+
+	if (0 != st.st_size)
+	{
+		zbx_hc_spool_t	header;
+
+		if ((zbx_uint64_t)st.st_size != spool_map_size ||
+				(ssize_t)sizeof(header) != pread(spool_fd, &header, sizeof(header), 0) ||
+				header.size != segment_size)
+		{
+			zbx_uint64_t	old_values_num, old_segment_size;
+
+			old_values_num = hc_spool_count_previous((size_t)st.st_size, &old_segment_size);
+
+			if (0 == old_segment_size)
+			{
+				zabbix_log(LOG_LEVEL_WARNING, "discarding history cache spool file \"%s\" of"
+						" incompatible format", CONFIG_HISTORY_CACHE_SPOOL_FILE);
+			}
+			else
+			{
+				zabbix_log(LOG_LEVEL_WARNING, "discarding " ZBX_FS_UI64 " values spooled by previous"
+						" run to \"%s\": HistoryCacheSpoolSize or HistoryCacheShards was"
+						" changed (" ZBX_FS_UI64 " segments of " ZBX_FS_UI64 " bytes, now %d"
+						" segments of " ZBX_FS_UI64 " bytes)", old_values_num,
+						CONFIG_HISTORY_CACHE_SPOOL_FILE, (zbx_uint64_t)st.st_size / old_segment_size,
+						old_segment_size, cache->shards_num, segment_size);
+			}
+
+			/* force reallocation */
+			st.st_size = 0;
+		}
+	}
+
+	if ((zbx_uint64_t)st.st_size != spool_map_size)
+	{
+		char	buf[64 * ZBX_KIBIBYTE];
+		size_t	offset;
+
+		/* allocate the whole file upfront, writing to a hole of sparse file */
+		/* mapped into memory would crash the process if the disk is full    */
+		if (0 != ftruncate(spool_fd, 0))
+		{
+			*error = zbx_dsprintf(*error, "cannot truncate history cache spool file \"%s\": %s",
+					CONFIG_HISTORY_CACHE_SPOOL_FILE, zbx_strerror(errno));
+			return FAIL;
+		}
+
+		memset(buf, 0, sizeof(buf));
+
+		for (offset = 0; offset < spool_map_size; offset += sizeof(buf))
+		{
+			size_t	len = MIN(sizeof(buf), spool_map_size - offset);
+
+			if ((ssize_t)len != write(spool_fd, buf, len))
+			{
+				*error = zbx_dsprintf(*error, "cannot allocate history cache spool file \"%s\": %s",
+						CONFIG_HISTORY_CACHE_SPOOL_FILE, zbx_strerror(errno));
+				return FAIL;
+			}
+		}
+	}
+
+	if (MAP_FAILED == (spool_map = mmap(NULL, spool_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, spool_fd, 0)))
+	{
+		*error = zbx_dsprintf(*error, "cannot map history cache spool file \"%s\": %s",
+				CONFIG_HISTORY_CACHE_SPOOL_FILE, zbx_strerror(errno));
+		return FAIL;
+	}
+
+	for (i = 0; i < cache->shards_num; i++)
+	{
+		zbx_hc_shard_t	*shard = cache->shards[i];
+
+		shard->spool = (zbx_hc_spool_t *)((char *)spool_map + segment_size * i);
+		values_num += hc_spool_load(shard->spool, segment_size);
+
+		/* spooled values are counted as history cache values */
+		shard->history_num += (int)shard->spool->values_num;
+	}
+
+	if (0 != values_num)
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "recovered " ZBX_FS_UI64 " values from history cache spool file \"%s\"",
+				values_num, CONFIG_HISTORY_CACHE_SPOOL_FILE);
+	}
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_spool_destroy                                                 *
+ *                                                                            *
+ * Purpose: flushes and unmaps history cache spool file                       *
+ *                                                                            *
+ ******************************************************************************/
+static void	hc_spool_destroy(void)
+{
+	if (MAP_FAILED != spool_map)
+	{
+		if (0 != msync(spool_map, spool_map_size, MS_SYNC))
+		{
+			zabbix_log(LOG_LEVEL_WARNING, "cannot flush history cache spool file \"%s\": %s",
+					CONFIG_HISTORY_CACHE_SPOOL_FILE, zbx_strerror(errno));
+		}
+
+		munmap(spool_map, spool_map_size);
+		spool_map = MAP_FAILED;
+	}
+
+	if (-1 != spool_fd)
+	{
+		close(spool_fd);
+		spool_fd = -1;
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * history cache snapshot                                                     *
+ *                                                                            *
+ ******************************************************************************/
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_snapshot_header_init                                          *
+ *                                                                            *
+ * Purpose: initializes history cache snapshot file header                    *
+ *                                                                            *
+ ******************************************************************************/
+static void	hc_snapshot_header_init(zbx_hc_snapshot_t *header, zbx_uint64_t values_num)
+{
+	memset(header, 0, sizeof(zbx_hc_snapshot_t));
+	memcpy(header->magic, ZBX_HC_SNAPSHOT_MAGIC, sizeof(header->magic));
+	header->version = ZBX_HC_SNAPSHOT_VERSION;
+	header->value_size = sizeof(dc_item_value_t);
+	header->values_num = values_num;
+	header->checksum = zbx_hash_modfnv(header, offsetof(zbx_hc_snapshot_t, checksum), 0);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_snapshot_write_value                                          *
+ *                                                                            *
+ * Purpose: writes history data value into snapshot file                      *
+ *                                                                            *
+ * Parameters: fp            - [IN] the snapshot file                         *
+ *             itemid        - [IN] the item identifier                       *
+ *             data          - [IN] the history data                          *
+ *             buf           - [IN/OUT] the record buffer                     *
+ *             buf_alloc     - [IN/OUT] the record buffer size                *
+ *             strings       - [IN/OUT] the value strings buffer              *
+ *             strings_alloc - [IN/OUT] the value strings buffer size         *
+ *                                                                            *
+ * Return value: SUCCEED - the value was written                              *
+ *               FAIL    - file write error                                   *
+ *                                                                            *
+ ******************************************************************************/
+static int	hc_snapshot_write_value(FILE *fp, zbx_uint64_t itemid, const zbx_hc_data_t *data, char **buf,
+		size_t *buf_alloc, char **strings, size_t *strings_alloc)
+{
+	dc_item_value_t	item_value;
+	const char	*value = NULL, *source = NULL;
+	size_t		size, strings_offset = 0;
+
+	memset(&item_value, 0, sizeof(item_value));
+
+	item_value.itemid = itemid;
+	item_value.ts = data->ts;
+	item_value.state = data->state;
+	item_value.flags = data->flags;
+	item_value.lastlogsize = data->lastlogsize;
+	item_value.mtime = data->mtime;
+	item_value.value_type = data->value_type;
+	item_value.item_value_type = data->value_type;
+
+	if (ITEM_STATE_NOTSUPPORTED == data->state || 0 != (ZBX_DC_FLAG_LLD & data->flags))
+	{
+		value = data->value.str;
+	}
+	else if (0 == (ZBX_DC_FLAG_NOVALUE & data->flags))
+	{
+		switch (data->value_type)
+		{
+			case ITEM_VALUE_TYPE_FLOAT:
+				item_value.value.value_dbl = data->value.dbl;
+				break;
+			case ITEM_VALUE_TYPE_UINT64:
+				item_value.value.value_uint = data->value.ui64;
+				break;
+			case ITEM_VALUE_TYPE_STR:
+			case ITEM_VALUE_TYPE_TEXT:
+				value = data->value.str;
+				break;
+			case ITEM_VALUE_TYPE_LOG:
+				value = data->value.log->value;
+				source = data->value.log->source;
+				item_value.timestamp = data->value.log->timestamp;
+				item_value.severity = data->value.log->severity;
+				item_value.logeventid = data->value.log->logeventid;
+				break;
+		}
+	}
+
+	if (NULL != value)
+	{
+		item_value.value.value_str.pvalue = strings_offset;
+		item_value.value.value_str.len = strlen(value) + 1;
+		zbx_strcpy_alloc(strings, strings_alloc, &strings_offset, value);
+		strings_offset++;
+	}
+
+	if (NULL != source)
+	{
+		item_value.source.pvalue = strings_offset;
+		item_value.source.len = strlen(source) + 1;
+		zbx_strcpy_alloc(strings, strings_alloc, &strings_offset, source);
+	}
+
+	size = hc_value_record_size(&item_value);
+
+	if (*buf_alloc < size)
+	{
+		*buf_alloc = size;
+		*buf = (char *)zbx_realloc(*buf, *buf_alloc);
+	}
+
+	hc_value_record_write((zbx_hc_value_record_t *)*buf, &item_value, *strings, 0);
+
+	if (1 != fwrite(*buf, size, 1, fp))
+		return FAIL;
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_snapshot_write_item                                           *
+ *                                                                            *
+ * Purpose: writes all cached values of history item into snapshot file       *
+ *                                                                            *
+ * Parameters: fp            - [IN] the snapshot file                         *
+ *             item          - [IN] the history item                          *
+ *             buf           - [IN/OUT] the record buffer                     *
+ *             buf_alloc     - [IN/OUT] the record buffer size                *
+ *             strings       - [IN/OUT] the value strings buffer              *
+ *             strings_alloc - [IN/OUT] the value strings buffer size         *
+ *             values_num    - [IN/OUT] the number of written values          *
+ *                                                                            *
+ * Return value: SUCCEED - the values were written                            *
+ *               FAIL    - file write error                                   *
+ *                                                                            *
+ ******************************************************************************/
+static int	hc_snapshot_write_item(FILE *fp, const zbx_hc_item_t *item, char **buf, size_t *buf_alloc,
+		char **strings, size_t *strings_alloc, zbx_uint64_t *values_num)
+{
+	const zbx_hc_data_t	*data;
+
+	for (data = item->tail; NULL != data; data = data->next)
+	{
+		zbx_gorilla_state_t	decoder;
+		zbx_hc_data_t		value;
+
+		if (SUCCEED != hc_snapshot_write_value(fp, item->itemid, data, buf, buf_alloc, strings, strings_alloc))
+			return FAIL;
+
+		(*values_num)++;
+
+		if (NULL == data->block)
+			continue;
+
+		/* the history data contains the last decoded value, write the rest of compressed block */
+		decoder = data->block->decoder;
+		value = *data;
+
+		while (decoder.values_num < data->block->encoder.values_num)
+		{
+			zbx_gorilla_decode(&decoder, HC_BLOCK_DATA(data->block), &value.ts, &value.value.ui64);
+
+			if (SUCCEED != hc_snapshot_write_value(fp, item->itemid, &value, buf, buf_alloc, strings,
+					strings_alloc))
+			{
+				return FAIL;
+			}
+
+			(*values_num)++;
+		}
+	}
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_snapshot_open                                                 *
+ *                                                                            *
+ * Purpose: maps history cache snapshot file into memory and validates its    *
+ *          header                                                            *
+ *                                                                            *
+ * Parameters: filename - [IN] the snapshot file name                         *
+ *             map      - [OUT] the mapped file                               *
+ *             map_size - [OUT] the mapped file size                          *
+ *             invalid  - [OUT] 1 if the file exists, but cannot be used      *
+ *                                                                            *
+ * Return value: SUCCEED - the snapshot was mapped                            *
+ *               FAIL    - the snapshot does not exist or is invalid          *
+ *                                                                            *
+ ******************************************************************************/
+static int	hc_snapshot_open(const char *filename, void **map, size_t *map_size, int *invalid)
+{
+	int			fd, ret = FAIL;
+	zbx_stat_t		st;
+	const zbx_hc_snapshot_t	*header;
+	zbx_hc_snapshot_t	header_local;
+
+	*invalid = 0;
+
+	if (-1 == (fd = open(filename, O_RDONLY)))
+	{
+		if (ENOENT != errno)
+		{
+			zabbix_log(LOG_LEVEL_WARNING, "cannot open history cache snapshot file \"%s\": %s", filename,
+					zbx_strerror(errno));
+		}
+
+		return FAIL;
+	}
+
+	*invalid = 1;
+
+	if (0 != fstat(fd, &st) || sizeof(zbx_hc_snapshot_t) > (zbx_uint64_t)st.st_size)
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "invalid history cache snapshot file \"%s\"", filename);
+		goto out;
+	}
+
+	*map_size = (size_t)st.st_size;
+
+	if (MAP_FAILED == (*map = mmap(NULL, *map_size, PROT_READ, MAP_PRIVATE, fd, 0)))
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "cannot map history cache snapshot file \"%s\": %s", filename,
+				zbx_strerror(errno));
+		goto out;
+	}
+
+	header = (const zbx_hc_snapshot_t *)*map;
+	hc_snapshot_header_init(&header_local, header->values_num);
+
+	if (0 != memcmp(header, &header_local, offsetof(zbx_hc_snapshot_t, checksum)) ||
+			header->checksum != header_local.checksum)
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "incompatible history cache snapshot file \"%s\"", filename);
+		munmap(*map, *map_size);
+		goto out;
+	}
+
+	*invalid = 0;
+	ret = SUCCEED;
+out:
+	close(fd);
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_snapshot_set_aside                                            *
+ *                                                                            *
+ * Purpose: renames unusable snapshot file, so it's not loaded again, but can *
+ *          be inspected                                                      *
+ *                                                                            *
+ ******************************************************************************/
+static void	hc_snapshot_set_aside(void)
+{
+	char	*filename;
+
+	filename = zbx_dsprintf(NULL, "%s.corrupted", CONFIG_HISTORY_CACHE_SNAPSHOT_FILE);
+
+	if (0 != rename(CONFIG_HISTORY_CACHE_SNAPSHOT_FILE, filename))
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "cannot rename history cache snapshot file \"%s\" to \"%s\": %s",
+				CONFIG_HISTORY_CACHE_SNAPSHOT_FILE, filename, zbx_strerror(errno));
+
+		if (0 != unlink(CONFIG_HISTORY_CACHE_SNAPSHOT_FILE))
+		{
+			zabbix_log(LOG_LEVEL_WARNING, "cannot remove history cache snapshot file \"%s\": %s",
+					CONFIG_HISTORY_CACHE_SNAPSHOT_FILE, zbx_strerror(errno));
+		}
+	}
+	else
+		zabbix_log(LOG_LEVEL_WARNING, "history cache snapshot file was renamed to \"%s\"", filename);
+
+	zbx_free(filename);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_snapshot_copy_records                                         *
+ *                                                                            *
+ * Purpose: copies the records of values not loaded from mapped snapshot into *
+ *          file                                                              *
+ *                                                                            *
+ * Parameters: fp         - [IN] the output file                              *
+ *             map        - [IN] the mapped snapshot                          *
+ *             end        - [IN] the end offset of records to check           *
+ *             values_num - [IN/OUT] the number of copied values              *
+ *                                                                            *
+ * Return value: SUCCEED - the records were copied                            *
+ *               FAIL    - file write error                                   *
+ *                                                                            *
+ * Comments: The records must be validated by the caller. A record is not     *
+ *           loaded if its shard has values not loaded from snapshot and the  *
+ *           record is not before the first of them.                          *
+ *                                                                            *
+ ******************************************************************************/
+static int	hc_snapshot_copy_records(FILE *fp, const void *map, zbx_uint64_t end, zbx_uint64_t *values_num)
+{
+	zbx_uint64_t			offset;
+	const zbx_hc_value_record_t	*record;
+	const zbx_hc_shard_t		*shard;
+
+	for (offset = sizeof(zbx_hc_snapshot_t); offset < end; offset += record->size)
+	{
+		record = (const zbx_hc_value_record_t *)((const char *)map + offset);
+		shard = hc_snapshot_record_shard(record);
+
+		if (0 == shard->snapshot_values_num || offset < shard->snapshot_offset)
+			continue;
+
+		if (1 != fwrite(record, record->size, 1, fp))
+			return FAIL;
+
+		(*values_num)++;
+	}
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_snapshot_write_spool                                          *
+ *                                                                            *
+ * Purpose: writes spooled values into snapshot file                          *
+ *                                                                            *
+ * Parameters: fp         - [IN] the snapshot file                            *
+ *             spool      - [IN] the spool segment                            *
+ *             offset     - [IN/OUT] the offset of the next spooled value     *
+ *             generation - [IN/OUT] the checksum seed of the next value      *
+ *             num        - [IN] the number of values to write                *
+ *             buf        - [IN/OUT] the record buffer                        *
+ *             buf_alloc  - [IN/OUT] the record buffer size                   *
+ *             values_num - [IN/OUT] the number of written values             *
+ *                                                                            *
+ * Return value: SUCCEED - the values were written                            *
+ *               FAIL    - file write error                                   *
+ *                                                                            *
+ * Comments: The spool segment is not modified, so it's still usable if the   *
+ *           snapshot cannot be saved.                                        *
+ *                                                                            *
+ ******************************************************************************/
+static int	hc_snapshot_write_spool(FILE *fp, const zbx_hc_spool_t *spool, zbx_uint64_t *offset,
+		zbx_uint32_t *generation, zbx_uint64_t num, char **buf, size_t *buf_alloc, zbx_uint64_t *values_num)
+{
+	const zbx_hc_value_record_t	*record;
+	const dc_item_value_t		*value;
+
+	for (; 0 != num; num--)
+	{
+		if (SUCCEED == hc_spool_is_wrap(spool, *offset, *generation))
+		{
+			*offset = HC_SPOOL_HEADER_SIZE;
+			(*generation)++;
+		}
+
+		record = (const zbx_hc_value_record_t *)((const char *)spool + *offset);
+		value = (const dc_item_value_t *)(record + 1);
+
+		if (*buf_alloc < record->size)
+		{
+			*buf_alloc = record->size;
+			*buf = (char *)zbx_realloc(*buf, *buf_alloc);
+		}
+
+		/* snapshot record checksums are not seeded with spool generation */
+		hc_value_record_write((zbx_hc_value_record_t *)*buf, value, (const char *)(value + 1), 0);
+
+		if (1 != fwrite(*buf, record->size, 1, fp))
+			return FAIL;
+
+		*offset += record->size;
+		(*values_num)++;
+	}
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_snapshot_keep                                                 *
+ *                                                                            *
+ * Purpose: replaces snapshot file with the values that were not loaded       *
+ *                                                                            *
+ * Parameters: map - [IN] the mapped snapshot                                 *
+ *             end - [IN] the end offset of valid records                     *
+ *                                                                            *
+ * Return value: SUCCEED - the snapshot file was replaced                     *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+static int	hc_snapshot_keep(const void *map, zbx_uint64_t end)
+{
+	FILE			*fp;
+	char			*filename;
+	zbx_uint64_t		values_num = 0;
+	zbx_hc_snapshot_t	header;
+	int			ret = FAIL;
+
+	filename = zbx_dsprintf(NULL, "%s.tmp", CONFIG_HISTORY_CACHE_SNAPSHOT_FILE);
+
+	if (NULL == (fp = fopen(filename, "wb")))
+		goto out;
+
+	hc_snapshot_header_init(&header, 0);
+
+	if (1 != fwrite(&header, sizeof(header), 1, fp) ||
+			SUCCEED != hc_snapshot_copy_records(fp, map, end, &values_num))
+	{
+		goto clean;
+	}
+
+	hc_snapshot_header_init(&header, values_num);
+
+	if (0 != fseek(fp, 0, SEEK_SET) || 1 != fwrite(&header, sizeof(header), 1, fp) || 0 != fflush(fp) ||
+			0 != fsync(fileno(fp)))
+	{
+		goto clean;
+	}
+
+	ret = SUCCEED;
+clean:
+	if (0 != fclose(fp))
+		ret = FAIL;
+
+	if (SUCCEED == ret && 0 != rename(filename, CONFIG_HISTORY_CACHE_SNAPSHOT_FILE))
+		ret = FAIL;
+out:
+	if (SUCCEED != ret)
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "cannot write history cache snapshot file \"%s\": %s", filename,
+				zbx_strerror(errno));
+		unlink(filename);
+	}
+
+	zbx_free(filename);
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_snapshot_save                                                 *
+ *                                                                            *
+ * Purpose: saves history cache contents into snapshot file                   *
+ *                                                                            *
+ * Return value: SUCCEED - the history cache was saved                        *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ * Comments: This function is used instead of flushing history cache to      *
+ *           database at server/proxy exit. Other processes are already       *
+ *           terminated, so cache locking is unnecessary.                     *
+ *           The snapshot is written into temporary file which is renamed     *
+ *           after all values are written, so an interrupted save cannot      *
+ *           leave a partial snapshot.                                        *
+ *           The values are saved in the order they would be moved to         *
+ *           history cache - cached values, spooled values loaded from        *
+ *           previous snapshot, values not loaded from previous snapshot and  *
+ *           the rest of spooled values, so the values of each item are saved *
+ *           in the order they were received. The spool is emptied after the  *
+ *           snapshot is saved, so spooled values are not loaded twice.       *
+ *                                                                            *
+ ******************************************************************************/
+static int	hc_snapshot_save(void)
+{
+	FILE			*fp;
+	char			*filename, *buf = NULL, *strings = NULL;
+	size_t			buf_alloc = 0, strings_alloc = 0;
+	int			i, ret = FAIL;
+	zbx_uint64_t		values_num = 0, spool_offset[ZBX_HC_SHARDS_MAX];
+	zbx_uint32_t		spool_generation[ZBX_HC_SHARDS_MAX];
+	zbx_hc_snapshot_t	header;
+	zbx_hashset_iter_t	iter;
+	zbx_hc_item_t		*item;
+	zbx_hc_spool_t		*spool;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() history_num:%d", __func__, hc_get_history_num());
+
+	filename = zbx_dsprintf(NULL, "%s.tmp", CONFIG_HISTORY_CACHE_SNAPSHOT_FILE);
+
+	if (NULL == (fp = fopen(filename, "wb")))
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "cannot create history cache snapshot file \"%s\": %s", filename,
+				zbx_strerror(errno));
+		goto out;
+	}
+
+	zabbix_log(LOG_LEVEL_WARNING, "saving history cache snapshot...");
+
+	hc_snapshot_header_init(&header, 0);
+
+	if (1 != fwrite(&header, sizeof(header), 1, fp))
+		goto clean;
+
+	for (i = 0; i < cache->shards_num; i++)
+	{
+		zbx_hashset_iter_reset(&cache->shards[i]->history_items, &iter);
+
+		while (NULL != (item = (zbx_hc_item_t *)zbx_hashset_iter_next(&iter)))
+		{
+			if (SUCCEED != hc_snapshot_write_item(fp, item, &buf, &buf_alloc, &strings, &strings_alloc,
+					&values_num))
+				goto clean;
+		}
+	}
+
+	for (i = 0; i < cache->shards_num; i++)
+	{
+		if (NULL == (spool = cache->shards[i]->spool))
+			continue;
+
+		spool_offset[i] = spool->read_offset;
+		spool_generation[i] = spool->read_generation;
+
+		if (SUCCEED != hc_snapshot_write_spool(fp, spool, &spool_offset[i], &spool_generation[i],
+				spool->snapshot_num, &buf, &buf_alloc, &values_num))
+		{
+			goto clean;
+		}
+	}
+
+	if (MAP_FAILED != snapshot_map &&
+			SUCCEED != hc_snapshot_copy_records(fp, snapshot_map, snapshot_map_size, &values_num))
+	{
+		goto clean;
+	}
+
+	for (i = 0; i < cache->shards_num; i++)
+	{
+		if (NULL == (spool = cache->shards[i]->spool))
+			continue;
+
+		if (SUCCEED != hc_snapshot_write_spool(fp, spool, &spool_offset[i], &spool_generation[i],
+				spool->values_num - spool->snapshot_num, &buf, &buf_alloc, &values_num))
+		{
+			goto clean;
+		}
+	}
+
+	hc_snapshot_header_init(&header, values_num);
+
+	if (0 != fseek(fp, 0, SEEK_SET) || 1 != fwrite(&header, sizeof(header), 1, fp) || 0 != fflush(fp) ||
+			0 != fsync(fileno(fp)))
+	{
+		goto clean;
+	}
+
+	ret = SUCCEED;
+clean:
+	if (SUCCEED != ret)
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "cannot write history cache snapshot file \"%s\": %s", filename,
+				zbx_strerror(errno));
+	}
+
+	if (0 != fclose(fp) && SUCCEED == ret)
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "cannot close history cache snapshot file \"%s\": %s", filename,
+				zbx_strerror(errno));
+		ret = FAIL;
+	}
+
+	if (SUCCEED == ret && 0 != rename(filename, CONFIG_HISTORY_CACHE_SNAPSHOT_FILE))
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "cannot rename history cache snapshot file \"%s\" to \"%s\": %s",
+				filename, CONFIG_HISTORY_CACHE_SNAPSHOT_FILE, zbx_strerror(errno));
+		ret = FAIL;
+	}
+
+	if (SUCCEED != ret)
+	{
+		unlink(filename);
+		goto out;
+	}
+
+	for (i = 0; i < cache->shards_num; i++)
+	{
+		if (NULL != cache->shards[i]->spool)
+			hc_spool_reset(cache->shards[i]->spool);
+
+		cache->shards[i]->snapshot_values_num = 0;
+	}
+
+	if (MAP_FAILED != snapshot_map)
+	{
+		munmap(snapshot_map, snapshot_map_size);
+		snapshot_map = MAP_FAILED;
+	}
+
+	zabbix_log(LOG_LEVEL_WARNING, "saved " ZBX_FS_UI64 " values to history cache snapshot", values_num);
+out:
+	zbx_free(strings);
+	zbx_free(buf);
+	zbx_free(filename);
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%s", __func__, zbx_result_string(ret));
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_snapshot_release                                              *
+ *                                                                            *
+ * Purpose: unmaps history cache snapshot with the values not loaded at start *
+ *          after history cache was flushed to database                       *
+ *                                                                            *
+ * Comments: The snapshot file is removed if all its values were moved to     *
+ *           history cache.                                                   *
+ *                                                                            *
+ ******************************************************************************/
+static void	hc_snapshot_release(void)
+{
+	int	i;
+
+	if (MAP_FAILED == snapshot_map)
+		return;
+
+	munmap(snapshot_map, snapshot_map_size);
+	snapshot_map = MAP_FAILED;
+
+	for (i = 0; i < cache->shards_num; i++)
+	{
+		if (0 != cache->shards[i]->snapshot_values_num)
+			return;
+	}
+
+	if (0 != unlink(CONFIG_HISTORY_CACHE_SNAPSHOT_FILE))
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "cannot remove history cache snapshot file \"%s\": %s",
+				CONFIG_HISTORY_CACHE_SNAPSHOT_FILE, zbx_strerror(errno));
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_snapshot_load                                                 *
+ *                                                                            *
+ * Purpose: loads history cache contents saved at previous server/proxy exit  *
+ *                                                                            *
+ * Comments: The snapshot file is removed after loading, so the values will   *
+ *           not be loaded twice. Once a shard spool has values, the further  *
+ *           values of that shard are spooled too, keeping the item value     *
+ *           order. If history cache and spool of a shard are too small to    *
+ *           hold all its saved values, the rest of shard values are kept in  *
+ *           snapshot file, which stays mapped, and history syncers move them *
+ *           to history cache after the spooled values.                       *
+ *           The values spooled by previous run are older than snapshot       *
+ *           values, because spool is emptied when saving snapshot. So the    *
+ *           snapshot values of shards with spooled values are not loaded at  *
+ *           all. This happens only if the previous run was started from      *
+ *           snapshot and did not stop normally.                              *
+ *           A corrupted snapshot file is renamed instead of being removed.   *
+ *           This function is called before forking, so cache locking is only *
+ *           used to select the shard memory.                                 *
+ *                                                                            *
+ ******************************************************************************/
+static void	hc_snapshot_load(void)
+{
+	void				*map;
+	size_t				map_size;
+	const zbx_hc_snapshot_t		*header;
+	const zbx_hc_value_record_t	*record;
+	zbx_uint64_t			offset, records_num, values_num = 0, pending_num = 0;
+	int				i, invalid, corrupted = 0;
+	unsigned char			pending[ZBX_HC_SHARDS_MAX];
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+
+	if (SUCCEED != hc_snapshot_open(CONFIG_HISTORY_CACHE_SNAPSHOT_FILE, &map, &map_size, &invalid))
+	{
+		if (0 != invalid)
+			hc_snapshot_set_aside();
+
+		goto out;
+	}
+
+	header = (const zbx_hc_snapshot_t *)map;
+
+	for (i = 0; i < cache->shards_num; i++)
+		pending[i] = (NULL != cache->shards[i]->spool && 0 != cache->shards[i]->spool->values_num);
+
+	for (offset = sizeof(zbx_hc_snapshot_t), records_num = 0; records_num < header->values_num;
+			offset += record->size, records_num++)
+	{
+		const dc_item_value_t	*item_value;
+		zbx_hc_shard_t		*shard;
+		int			index, ret = FAIL;
+
+		record = (const zbx_hc_value_record_t *)((const char *)map + offset);
+
+		if (SUCCEED != hc_value_record_validate(record, (zbx_uint64_t)map_size - offset, 0))
+		{
+			corrupted = 1;
+			break;
+		}
+
+		item_value = (const dc_item_value_t *)(record + 1);
+		index = hc_get_shard_index(item_value->itemid);
+		shard = cache->shards[index];
+
+		if (0 == pending[index])
+		{
+			LOCK_SHARD(shard);
+
+			if (NULL == shard->spool || 0 == shard->spool->values_num)
+				ret = hc_add_item_value(shard, item_value, (const char *)(item_value + 1));
+
+			if (SUCCEED != ret && NULL != shard->spool)
+				ret = hc_spool_write(shard, item_value, (const char *)(item_value + 1));
+
+			if (SUCCEED == ret)
+				shard->history_num++;
+
+			UNLOCK_SHARD(shard);
+
+			if (SUCCEED == ret)
+			{
+				values_num++;
+				continue;
+			}
+
+			/* all spooled values were loaded from snapshot, the rest of shard values follow them */
+			pending[index] = 1;
+
+			if (NULL != shard->spool)
+				shard->spool->snapshot_num = shard->spool->values_num;
+		}
+
+		if (0 == shard->snapshot_values_num++)
+			shard->snapshot_offset = offset;
+
+		pending_num++;
+	}
+
+	zabbix_log(LOG_LEVEL_WARNING, "loaded " ZBX_FS_UI64 " values from history cache snapshot", values_num);
+
+	if (0 != corrupted)
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "history cache snapshot file \"%s\" is corrupted, " ZBX_FS_UI64
+				" values were not loaded", CONFIG_HISTORY_CACHE_SNAPSHOT_FILE,
+				header->values_num - records_num);
+		hc_snapshot_set_aside();
+	}
+
+	if (0 != pending_num)
+	{
+		if (SUCCEED == hc_snapshot_keep(map, offset) && SUCCEED == hc_snapshot_open(
+				CONFIG_HISTORY_CACHE_SNAPSHOT_FILE, &snapshot_map, &snapshot_map_size, &invalid))
+		{
+			zabbix_log(LOG_LEVEL_WARNING, "not enough space in history cache, " ZBX_FS_UI64 " values"
+					" were kept in history cache snapshot to be moved to history cache later",
+					pending_num);
+
+			/* the kept snapshot contains only the values not loaded */
+			for (i = 0; i < cache->shards_num; i++)
+			{
+				zbx_hc_shard_t	*shard = cache->shards[i];
+
+				shard->snapshot_offset = sizeof(zbx_hc_snapshot_t);
+				shard->history_num += (int)shard->snapshot_values_num;
+			}
+
+			munmap(map, map_size);
+			goto out;
+		}
+
+		zabbix_log(LOG_LEVEL_WARNING, "not enough space in history cache, " ZBX_FS_UI64 " values from"
+				" history cache snapshot were lost", pending_num);
+
+		for (i = 0; i < cache->shards_num; i++)
+			cache->shards[i]->snapshot_values_num = 0;
+	}
+
+	munmap(map, map_size);
+
+	/* corrupted snapshot was renamed unless the values not loaded were kept */
+	if ((0 == corrupted || 0 != pending_num) && 0 != unlink(CONFIG_HISTORY_CACHE_SNAPSHOT_FILE) &&
+			ENOENT != errno)
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "cannot remove history cache snapshot file \"%s\": %s",
+				CONFIG_HISTORY_CACHE_SNAPSHOT_FILE, zbx_strerror(errno));
+	}
+out:
+	/* spooled values do not wait for snapshot values if there are none */
+	for (i = 0; i < cache->shards_num; i++)
+	{
+		if (NULL != cache->shards[i]->spool && 0 == cache->shards[i]->snapshot_values_num)
+			cache->shards[i]->spool->snapshot_num = 0;
+	}
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_copy_history_data                                             *
+ *                                                                            *
+ * Purpose: copies item value from history cache into the specified history   *
+ *          value                                                             *
+ *                                                                            *
+ * Parameters: history - [OUT] the history value                              *
+ *             itemid  - [IN] the item identifier                             *
+ *             data    - [IN] the history data to copy                        *
+ *                                                                            *
+ * Comments: handling of uninitialized fields in dc_add_proxy_history_log()   *
+ *                                                                            *
+ ******************************************************************************/
+static void	hc_copy_history_data(ZBX_DC_HISTORY *history, zbx_uint64_t itemid, zbx_hc_data_t *data)
+{
+	history->itemid = itemid;
+	history->ts = data->ts;
+	history->state = data->state;
+	history->flags = data->flags;
+	history->lastlogsize = data->lastlogsize;
+	history->mtime = data->mtime;
+
+	if (ITEM_STATE_NOTSUPPORTED == data->state)
+	{
+		history->value.err = zbx_strdup(NULL, data->value.str);
+		history->flags |= ZBX_DC_FLAG_UNDEF;
+		return;
+	}
+
+	history->value_type = data->value_type;
+
+	if (0 == (ZBX_DC_FLAG_NOVALUE & data->flags))
+	{
+		switch (data->value_type)
+		{
+			case ITEM_VALUE_TYPE_FLOAT:
+				history->value.dbl = data->value.dbl;
+				break;
+			case ITEM_VALUE_TYPE_UINT64:
+				history->value.ui64 = data->value.ui64;
+				break;
+			case ITEM_VALUE_TYPE_STR:
+			case ITEM_VALUE_TYPE_TEXT:
+				history->value.str = zbx_strdup(NULL, data->value.str);
+				break;
+			case ITEM_VALUE_TYPE_LOG:
+				history->value.log = (zbx_log_value_t *)zbx_malloc(NULL, sizeof(zbx_log_value_t));
+				history->value.log->value = zbx_strdup(NULL, data->value.log->value);
+
+				if (NULL != data->value.log->source)
+					history->value.log->source = zbx_strdup(NULL, data->value.log->source);
+				else
+					history->value.log->source = NULL;
+
+				history->value.log->timestamp = data->value.log->timestamp;
+				history->value.log->severity = data->value.log->severity;
+				history->value.log->logeventid = data->value.log->logeventid;
+
+				break;
+		}
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_pop_items                                                     *
+ *                                                                            *
+ * Purpose: pops the next batch of history items from cache for processing    *
+ *                                                                            *
+ * Parameters: history_items - [OUT] the locked history items                 *
+ *                                                                            *
+ * Return value: the history cache shard the items were taken from            *
+ *                                                                            *
+ * Comments: The items are taken from the preferred shard of the syncer, if   *
+ *           it is empty then the other shards are checked in turn.           *
+ *           The history_items must be returned back to the returned history  *
+ *           cache shard with hc_push_items() function after they have been   *
+ *           processed.                                                       *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_hc_shard_t	*hc_pop_items(zbx_vector_ptr_t *history_items)
+{
+	zbx_binary_heap_elem_t	*elem;
+	zbx_hc_item_t		*item;
+	zbx_hc_shard_t		*shard = NULL;
+	int			i;
+
+	for (i = 0; i < cache->shards_num; i++)
+	{
+		shard = cache->shards[(hc_shard_pref + i) % cache->shards_num];
+
+		LOCK_SHARD(shard);
+
+		if ((NULL != shard->spool && 0 != shard->spool->values_num) || 0 != shard->snapshot_values_num)
+			hc_spool_refill(shard);
+
+		while (ZBX_HC_SYNC_MAX > history_items->values_num &&
+				FAIL == zbx_binary_heap_empty(&shard->history_queue))
+		{
+			elem = zbx_binary_heap_find_min(&shard->history_queue);
+			item = (zbx_hc_item_t *)elem->data;
+			zbx_vector_ptr_append(history_items, item);
+
+			zbx_binary_heap_remove_min(&shard->history_queue);
+		}
+
+		UNLOCK_SHARD(shard);
+
+		if (0 != history_items->values_num)
+			break;
+	}
+
+	return shard;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_get_item_values                                               *
+ *                                                                            *
+ * Purpose: gets item history values                                          *
+ *                                                                            *
+ * Parameters: history       - [OUT] the history valeus                       *
+ *             history_items - [IN] the history items                         *
+ *                                                                            *
+ ******************************************************************************/
+static void	hc_get_item_values(ZBX_DC_HISTORY *history, zbx_vector_ptr_t *history_items)
+{
+	int		i, history_num = 0;
+	zbx_hc_item_t	*item;
+
+	/* we don't need to lock history cache because no other processes can  */
+	/* change item's history data until it is pushed back to history queue */
+	for (i = 0; i < history_items->values_num; i++)
+	{
+		item = (zbx_hc_item_t *)history_items->values[i];
+
+		if (ZBX_HC_ITEM_STATUS_BUSY == item->status)
+			continue;
+
+		hc_copy_history_data(&history[history_num++], item->itemid, item->tail);
+	}
 }
 
 /******************************************************************************
@@ -4390,7 +6846,9 @@ static void	hc_get_item_values(ZBX_DC_HISTORY *history, zbx_vector_ptr_t *histor
  *                                                                            *
  * Purpose: push back the processed history items into history cache          *
  *                                                                            *
- * Parameters: history_items - [IN] the history items containing processed    *
+ * Parameters: shard         - [IN] the history cache shard the items were    *
+ *                                  taken from                                *
+ *             history_items - [IN] the history items containing processed    *
  *                                  (available) and busy items                *
  *                                                                            *
  * Comments: This function removes processed value from history cache.        *
@@ -4398,7 +6856,7 @@ static void	hc_get_item_values(ZBX_DC_HISTORY *history, zbx_vector_ptr_t *histor
  *           removed from history index.                                      *
  *                                                                            *
  ******************************************************************************/
-void	hc_push_items(zbx_vector_ptr_t *history_items)
+void	hc_push_items(zbx_hc_shard_t *shard, zbx_vector_ptr_t *history_items)
 {
 	int		i;
 	zbx_hc_item_t	*item;
@@ -4413,17 +6871,24 @@ void	hc_push_items(zbx_vector_ptr_t *history_items)
 			case ZBX_HC_ITEM_STATUS_BUSY:
 				/* reset item status before returning it to queue */
 				item->status = ZBX_HC_ITEM_STATUS_NORMAL;
-				hc_queue_item(item);
+				hc_queue_item(shard, item);
 				break;
 			case ZBX_HC_ITEM_STATUS_NORMAL:
 				item->values_num--;
+
+				if (NULL != item->tail->block && SUCCEED == hc_decompress_value(shard, item->tail))
+				{
+					hc_queue_item(shard, item);
+					break;
+				}
+
 				data_free = item->tail;
 				item->tail = item->tail->next;
 				hc_free_data(data_free);
 				if (NULL == item->tail)
-					zbx_hashset_remove(&cache->history_items, item);
+					zbx_hashset_remove(&shard->history_items, item);
 				else
-					hc_queue_item(item);
+					hc_queue_item(shard, item);
 				break;
 		}
 	}
@@ -4435,10 +6900,46 @@ void	hc_push_items(zbx_vector_ptr_t *history_items)
  *                                                                            *
  * Purpose: retrieve the size of history queue                                *
  *                                                                            *
+ * Comments: The shards are locked one by one, so this function must not be   *
+ *           called with any shard locked.                                    *
+ *                                                                            *
  ******************************************************************************/
 int	hc_queue_get_size(void)
 {
-	return cache->history_queue.elems_num;
+	int	i, size = 0;
+
+	for (i = 0; i < cache->shards_num; i++)
+	{
+		LOCK_SHARD(cache->shards[i]);
+		size += cache->shards[i]->history_queue.elems_num;
+		UNLOCK_SHARD(cache->shards[i]);
+	}
+
+	return size;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_get_history_num                                               *
+ *                                                                            *
+ * Purpose: retrieve the number of values in history cache                    *
+ *                                                                            *
+ * Comments: The shards are locked one by one, so this function must not be   *
+ *           called with any shard locked.                                    *
+ *                                                                            *
+ ******************************************************************************/
+static int	hc_get_history_num(void)
+{
+	int	i, history_num = 0;
+
+	for (i = 0; i < cache->shards_num; i++)
+	{
+		LOCK_SHARD(cache->shards[i]);
+		history_num += cache->shards[i]->history_num;
+		UNLOCK_SHARD(cache->shards[i]);
+	}
+
+	return history_num;
 }
 
 int	hc_get_history_compression_age(void)
@@ -4513,6 +7014,65 @@ out:
 	return ret;
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_shard_create                                                  *
+ *                                                                            *
+ * Purpose: allocate shared memory and lock for history cache shard           *
+ *                                                                            *
+ * Parameters: shard - [OUT] the created shard                                *
+ *             index - [IN] the shard index                                   *
+ *             error - [OUT] the error message                                *
+ *                                                                            *
+ * Return value: SUCCEED - the shard was created successfully                 *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ * Comments: History cache and history index cache sizes are divided equally  *
+ *           between shards. On success the process history cache memory     *
+ *           pointers are left pointing to the memory of the created shard.   *
+ *                                                                            *
+ ******************************************************************************/
+static int	hc_shard_create(zbx_hc_shard_t **shard, int index, char **error)
+{
+	zbx_mutex_t		lock = ZBX_MUTEX_NULL;
+	zbx_mutex_name_t	lock_name;
+	int			ret;
+
+	lock_name = (0 == index ? ZBX_MUTEX_CACHE : (zbx_mutex_name_t)(ZBX_MUTEX_HISTORY_SHARD + index - 1));
+
+	if (SUCCEED != (ret = zbx_mutex_create(&lock, lock_name, error)))
+		return ret;
+
+	if (SUCCEED != (ret = zbx_mem_create(&hc_mem, CONFIG_HISTORY_CACHE_SIZE / CONFIG_HISTORY_CACHE_SHARDS,
+			"history cache", "HistoryCacheSize", 1, error)))
+	{
+		return ret;
+	}
+
+	if (SUCCEED != (ret = zbx_mem_create(&hc_index_mem, CONFIG_HISTORY_INDEX_CACHE_SIZE /
+			CONFIG_HISTORY_CACHE_SHARDS, "history index cache", "HistoryIndexCacheSize", 0, error)))
+	{
+		return ret;
+	}
+
+	*shard = (zbx_hc_shard_t *)__hc_index_mem_malloc_func(NULL, sizeof(zbx_hc_shard_t));
+	memset(*shard, 0, sizeof(zbx_hc_shard_t));
+
+	(*shard)->lock = lock;
+	(*shard)->mem = hc_mem;
+	(*shard)->index_mem = hc_index_mem;
+
+	zbx_hashset_create_ext(&(*shard)->history_items, ZBX_HC_ITEMS_INIT_SIZE / CONFIG_HISTORY_CACHE_SHARDS,
+			ZBX_DEFAULT_UINT64_HASH_FUNC, ZBX_DEFAULT_UINT64_COMPARE_FUNC, NULL,
+			__hc_index_mem_malloc_func, __hc_index_mem_realloc_func, __hc_index_mem_free_func);
+
+	zbx_binary_heap_create_ext(&(*shard)->history_queue, hc_queue_elem_compare_func,
+			ZBX_BINARY_HEAP_OPTION_EMPTY, __hc_index_mem_malloc_func, __hc_index_mem_realloc_func,
+			__hc_index_mem_free_func);
+
+	return SUCCEED;
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: init_database_cache                                              *
@@ -4524,41 +7084,37 @@ out:
  ******************************************************************************/
 int	init_database_cache(char **error)
 {
-	int	ret;
+	int		ret, i;
+	zbx_hc_shard_t	*shard;
 
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
 
-	if (SUCCEED != (ret = zbx_mutex_create(&cache_lock, ZBX_MUTEX_CACHE, error)))
+	if (ZBX_HC_SHARD_SIZE_MIN > CONFIG_HISTORY_CACHE_SIZE / CONFIG_HISTORY_CACHE_SHARDS ||
+			ZBX_HC_SHARD_SIZE_MIN > CONFIG_HISTORY_INDEX_CACHE_SIZE / CONFIG_HISTORY_CACHE_SHARDS)
+	{
+		*error = zbx_dsprintf(*error, "HistoryCacheSize and HistoryIndexCacheSize must be at least "
+				ZBX_FS_UI64 " bytes per each of %d history cache shards",
+				(zbx_uint64_t)ZBX_HC_SHARD_SIZE_MIN, CONFIG_HISTORY_CACHE_SHARDS);
+		ret = FAIL;
 		goto out;
+	}
 
 	if (SUCCEED != (ret = zbx_mutex_create(&cache_ids_lock, ZBX_MUTEX_CACHE_IDS, error)))
 		goto out;
 
-	if (SUCCEED != (ret = zbx_mem_create(&hc_mem, CONFIG_HISTORY_CACHE_SIZE, "history cache",
-			"HistoryCacheSize", 1, error)))
-	{
-		goto out;
-	}
-
-	if (SUCCEED != (ret = zbx_mem_create(&hc_index_mem, CONFIG_HISTORY_INDEX_CACHE_SIZE, "history index cache",
-			"HistoryIndexCacheSize", 0, error)))
-	{
+	/* the data shared by all shards is stored in the first shard */
+	if (SUCCEED != (ret = hc_shard_create(&shard, 0, error)))
 		goto out;
-	}
 
 	cache = (ZBX_DC_CACHE *)__hc_index_mem_malloc_func(NULL, sizeof(ZBX_DC_CACHE));
 	memset(cache, 0, sizeof(ZBX_DC_CACHE));
 
+	cache->shards[0] = shard;
+	cache->shards_num = CONFIG_HISTORY_CACHE_SHARDS;
+
 	ids = (ZBX_DC_IDS *)__hc_index_mem_malloc_func(NULL, sizeof(ZBX_DC_IDS));
 	memset(ids, 0, sizeof(ZBX_DC_IDS));
 
-	zbx_hashset_create_ext(&cache->history_items, ZBX_HC_ITEMS_INIT_SIZE,
-			ZBX_DEFAULT_UINT64_HASH_FUNC, ZBX_DEFAULT_UINT64_COMPARE_FUNC, NULL,
-			__hc_index_mem_malloc_func, __hc_index_mem_realloc_func, __hc_index_mem_free_func);
-
-	zbx_binary_heap_create_ext(&cache->history_queue, hc_queue_elem_compare_func, ZBX_BINARY_HEAP_OPTION_EMPTY,
-			__hc_index_mem_malloc_func, __hc_index_mem_realloc_func, __hc_index_mem_free_func);
-
 	if (0 != (program_type & ZBX_PROGRAM_TYPE_SERVER))
 	{
 		zbx_hashset_create_ext(&(cache->proxyqueue.index), ZBX_HC_SYNC_MAX,
@@ -4573,6 +7129,18 @@ int	init_database_cache(char **error)
 			goto out;
 	}
 
+	for (i = 1; i < cache->shards_num; i++)
+	{
+		if (SUCCEED != (ret = hc_shard_create(&cache->shards[i], i, error)))
+			goto out;
+	}
+
+	if (NULL != CONFIG_HISTORY_CACHE_SPOOL_FILE && SUCCEED != (ret = hc_spool_init(error)))
+		goto out;
+
+	if (NULL != CONFIG_HISTORY_CACHE_SNAPSHOT_FILE)
+		hc_snapshot_load();
+
 	cache->history_num_total = 0;
 	cache->history_progress_ts = 0;
 
@@ -4599,7 +7167,12 @@ static void	DCsync_all(void)
 {
 	zabbix_log(LOG_LEVEL_DEBUG, "In DCsync_all()");
 
-	sync_history_cache_full();
+	if (NULL == CONFIG_HISTORY_CACHE_SNAPSHOT_FILE || SUCCEED != hc_snapshot_save())
+	{
+		sync_history_cache_full();
+		hc_snapshot_release();
+	}
+
 	if (0 != (program_type & ZBX_PROGRAM_TYPE_SERVER))
 		DCsync_trends();
 
@@ -4617,13 +7190,19 @@ static void	DCsync_all(void)
  ******************************************************************************/
 void	free_database_cache(void)
 {
+	int	i;
+
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
 
 	DCsync_all();
 
+	hc_spool_destroy();
+
+	for (i = 0; i < cache->shards_num; i++)
+		zbx_mutex_destroy(&cache->shards[i]->lock);
+
 	cache = NULL;
 
-	zbx_mutex_destroy(&cache_lock);
 	zbx_mutex_destroy(&cache_ids_lock);
 
 	if (0 != (program_type & ZBX_PROGRAM_TYPE_SERVER))
@@ -4748,12 +7327,93 @@ out:
  ******************************************************************************/
 void	zbx_hc_get_diag_stats(zbx_uint64_t *items_num, zbx_uint64_t *values_num)
 {
-	LOCK_CACHE;
+	int	i;
 
-	*values_num = cache->history_num;
-	*items_num = cache->history_items.num_data;
+	*values_num = 0;
+	*items_num = 0;
 
-	UNLOCK_CACHE;
+	for (i = 0; i < cache->shards_num; i++)
+	{
+		zbx_hc_shard_t	*shard = cache->shards[i];
+
+		LOCK_SHARD(shard);
+
+		*values_num += shard->history_num;
+		*items_num += shard->history_items.num_data;
+
+		UNLOCK_SHARD(shard);
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_hc_get_shards_num                                            *
+ *                                                                            *
+ * Purpose: get the number of history cache shards                            *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_hc_get_shards_num(void)
+{
+	return cache->shards_num;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_hc_get_shard_diag_stats                                      *
+ *                                                                            *
+ * Purpose: get diagnostics statistics of a history cache shard               *
+ *                                                                            *
+ * Parameters: shard_index - [IN] the shard index                             *
+ *             stats       - [OUT] the shard statistics                       *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_hc_get_shard_diag_stats(int shard_index, zbx_hc_shard_stats_t *stats)
+{
+	zbx_hc_shard_t	*shard = cache->shards[shard_index];
+
+	LOCK_SHARD(shard);
+
+	stats->values_num = shard->history_num;
+	stats->items_num = shard->history_items.num_data;
+	stats->data_free = shard->mem->free_size;
+	stats->data_total = shard->mem->total_size;
+	stats->index_free = shard->index_mem->free_size;
+	stats->index_total = shard->index_mem->total_size;
+
+	UNLOCK_SHARD(shard);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_mem_stats_add                                                 *
+ *                                                                            *
+ * Purpose: add shared memory allocator statistics of a shard to the total    *
+ *                                                                            *
+ ******************************************************************************/
+static void	hc_mem_stats_add(zbx_mem_stats_t *total, const zbx_mem_stats_t *stats)
+{
+	int	i;
+
+	if (0 == total->used_chunks + total->free_chunks)
+	{
+		*total = *stats;
+		return;
+	}
+
+	total->free_size += stats->free_size;
+	total->used_size += stats->used_size;
+	total->overhead += stats->overhead;
+	total->free_chunks += stats->free_chunks;
+	total->used_chunks += stats->used_chunks;
+
+	if (stats->min_chunk_size < total->min_chunk_size)
+		total->min_chunk_size = stats->min_chunk_size;
+
+	if (stats->max_chunk_size > total->max_chunk_size)
+		total->max_chunk_size = stats->max_chunk_size;
+
+	for (i = 0; i < MEM_BUCKET_COUNT; i++)
+		total->chunks_num[i] += stats->chunks_num[i];
 }
 
 /******************************************************************************
@@ -4762,18 +7422,61 @@ void	zbx_hc_get_diag_stats(zbx_uint64_t *items_num, zbx_uint64_t *values_num)
  *                                                                            *
  * Purpose: get shared memory allocator statistics                            *
  *                                                                            *
+ * Parameters: data        - [OUT] the history data memory statistics         *
+ *                                   (optional)                               *
+ *             index       - [OUT] the history index memory statistics        *
+ *                                   (optional)                               *
+ *             compression - [OUT] the compression ratio of values stored in  *
+ *                                 compressed blocks - the size they would    *
+ *                                 take as separate history data divided by   *
+ *                                 the size of compressed blocks (optional)   *
+ *                                                                            *
+ * Comments: The statistics are summed over all history cache shards.         *
+ *                                                                            *
  ******************************************************************************/
-void	zbx_hc_get_mem_stats(zbx_mem_stats_t *data, zbx_mem_stats_t *index)
+void	zbx_hc_get_mem_stats(zbx_mem_stats_t *data, zbx_mem_stats_t *index, double *compression)
 {
-	LOCK_CACHE;
+	int		i;
+	zbx_mem_stats_t	stats;
+	zbx_uint64_t	compressed_values_num = 0, compressed_size = 0;
 
 	if (NULL != data)
-		zbx_mem_get_stats(hc_mem, data);
+		memset(data, 0, sizeof(zbx_mem_stats_t));
 
 	if (NULL != index)
-		zbx_mem_get_stats(hc_index_mem, index);
+		memset(index, 0, sizeof(zbx_mem_stats_t));
 
-	UNLOCK_CACHE;
+	for (i = 0; i < cache->shards_num; i++)
+	{
+		zbx_hc_shard_t	*shard = cache->shards[i];
+
+		LOCK_SHARD(shard);
+
+		if (NULL != data)
+		{
+			zbx_mem_get_stats(shard->mem, &stats);
+			hc_mem_stats_add(data, &stats);
+		}
+
+		if (NULL != index)
+		{
+			zbx_mem_get_stats(shard->index_mem, &stats);
+			hc_mem_stats_add(index, &stats);
+		}
+
+		compressed_values_num += shard->compressed_values_num;
+		compressed_size += shard->compressed_size;
+
+		UNLOCK_SHARD(shard);
+	}
+
+	if (NULL != compression)
+	{
+		if (0 != compressed_size)
+			*compression = (double)(compressed_values_num * sizeof(zbx_hc_data_t)) / compressed_size;
+		else
+			*compression = 1;
+	}
 }
 
 /******************************************************************************
@@ -4787,19 +7490,25 @@ void	zbx_hc_get_items(zbx_vector_uint64_pair_t *items)
 {
 	zbx_hashset_iter_t	iter;
 	zbx_hc_item_t		*item;
+	int			i;
 
-	LOCK_CACHE;
+	for (i = 0; i < cache->shards_num; i++)
+	{
+		zbx_hc_shard_t	*shard = cache->shards[i];
 
-	zbx_vector_uint64_pair_reserve(items, cache->history_items.num_data);
+		LOCK_SHARD(shard);
 
-	zbx_hashset_iter_reset(&cache->history_items, &iter);
-	while (NULL != (item = (zbx_hc_item_t *)zbx_hashset_iter_next(&iter)))
-	{
-		zbx_uint64_pair_t	pair = {item->itemid, item->values_num};
-		zbx_vector_uint64_pair_append_ptr(items, &pair);
-	}
+		zbx_vector_uint64_pair_reserve(items, items->values_num + shard->history_items.num_data);
 
-	UNLOCK_CACHE;
+		zbx_hashset_iter_reset(&shard->history_items, &iter);
+		while (NULL != (item = (zbx_hc_item_t *)zbx_hashset_iter_next(&iter)))
+		{
+			zbx_uint64_pair_t	pair = {item->itemid, item->values_num};
+			zbx_vector_uint64_pair_append_ptr(items, &pair);
+		}
+
+		UNLOCK_SHARD(shard);
+	}
 }
 
 /******************************************************************************
@@ -4927,14 +7636,17 @@ static void	zbx_hc_proxyqueue_clear(void)
  ******************************************************************************/
 int	zbx_hc_check_proxy(zbx_uint64_t proxyid)
 {
-	double	hc_pused;
-	int	ret;
+	double		hc_pused;
+	int		ret;
+	ZBX_DC_STATS	stats;
+	zbx_uint64_t	mem_total, mem_free, index_total, index_free;
 
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s() proxyid:"ZBX_FS_UI64, __func__, proxyid);
 
-	LOCK_CACHE;
+	hc_get_shards_stats(ZBX_HC_SHARD_ALL, &stats, &mem_total, &mem_free, &index_total, &index_free);
+	hc_pused = 100 * (double)(mem_total - mem_free) / mem_total;
 
-	hc_pused = 100 * (double)(hc_mem->total_size - hc_mem->free_size) / hc_mem->total_size;
+	LOCK_CACHE;
 
 	if (20 >= hc_pused)
 	{
@@ -4985,3 +7697,7 @@ out:
 
 	return ret;
 }
+
+#ifdef HAVE_TESTS
+#	include "../../../tests/libs/zbxdbcache/dbcache_test.c"
+#endif
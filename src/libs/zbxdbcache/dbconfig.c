@@ -45,11 +45,26 @@
 #include "zbxvault.h"
 #include "zbxserialize.h"
 
+#include <sched.h>
+
 int	sync_in_progress = 0;
 
-#define START_SYNC	WRLOCK_CACHE; sync_in_progress = 1
+#define START_SYNC	WRLOCK_CACHE; sync_in_progress = 1; sync_lock_time = zbx_time()
 #define FINISH_SYNC	sync_in_progress = 0; UNLOCK_CACHE
 
+/* the maximum time configuration cache write lock can be held by synchronization */
+/* before it's released to let the waiting readers access configuration cache     */
+#define ZBX_SYNC_LOCK_SLICE	0.001
+
+/* the number of rows processed between lock slice checks */
+#define ZBX_SYNC_YIELD_ROWS	64
+
+/* the time synchronization acquired configuration cache write lock */
+static double	sync_lock_time;
+
+/* the number of times synchronization released the write lock to readers */
+static int	sync_yield_num;
+
 #define ZBX_LOC_NOWHERE	0
 #define ZBX_LOC_QUEUE	1
 #define ZBX_LOC_POLLER	2
@@ -96,11 +111,53 @@ ZBX_DC_CONFIG	*config = NULL;
 zbx_rwlock_t	config_lock = ZBX_RWLOCK_NULL;
 static zbx_mem_info_t	*config_mem;
 
+#if ZBX_MUTEX_POLLER_QUEUES_NUM != ZBX_POLLER_TYPE_COUNT
+#	error "the number of poller queue locks does not match the number of poller types"
+#endif
+
+/* Poller queues are updated by pollers with configuration cache read locked. Each queue is protected by its */
+/* own lock and the queue memory allocations from configuration cache are serialized by the queue memory    */
+/* lock. With configuration cache write locked the queues are accessed without taking these locks.          */
+static zbx_mutex_t	poller_queue_locks[ZBX_POLLER_TYPE_COUNT];
+static zbx_mutex_t	poller_queue_mem_lock = ZBX_MUTEX_NULL;
+
+#define	LOCK_POLLER_QUEUE(poller_type)		zbx_mutex_lock(poller_queue_locks[poller_type])
+#define	UNLOCK_POLLER_QUEUE(poller_type)	zbx_mutex_unlock(poller_queue_locks[poller_type])
+
 extern unsigned char	program_type;
 extern int		CONFIG_TIMER_FORKS;
 
 ZBX_MEM_FUNC_IMPL(__config, config_mem)
 
+static void	*__config_queue_mem_malloc_func(void *old, size_t size)
+{
+	void	*ptr;
+
+	zbx_mutex_lock(poller_queue_mem_lock);
+	ptr = __config_mem_malloc_func(old, size);
+	zbx_mutex_unlock(poller_queue_mem_lock);
+
+	return ptr;
+}
+
+static void	*__config_queue_mem_realloc_func(void *old, size_t size)
+{
+	void	*ptr;
+
+	zbx_mutex_lock(poller_queue_mem_lock);
+	ptr = __config_mem_realloc_func(old, size);
+	zbx_mutex_unlock(poller_queue_mem_lock);
+
+	return ptr;
+}
+
+static void	__config_queue_mem_free_func(void *ptr)
+{
+	zbx_mutex_lock(poller_queue_mem_lock);
+	__config_mem_free_func(ptr);
+	zbx_mutex_unlock(poller_queue_mem_lock);
+}
+
 static void	dc_maintenance_precache_nested_groups(void);
 
 /* by default the macro environment is non-secure and all secret macros are masked with ****** */
@@ -200,14 +257,52 @@ clean:
 	return ret;
 }
 
-static unsigned char	poller_by_item(unsigned char type, const char *key)
+/******************************************************************************
+ *                                                                            *
+ * Function: dc_snmp_item_is_async                                            *
+ *                                                                            *
+ * Purpose: checks if SNMP item can be polled by asynchronous SNMP poller     *
+ *                                                                            *
+ * Return value: SUCCEED - the item is a plain OID of SNMPv1 or SNMPv2c       *
+ *                         interface                                          *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ * Comments: Dynamic index items and discovery rules walk OID trees, SNMPv3   *
+ *           sessions perform engine discovery when opened. Both block, so    *
+ *           such items are left to regular pollers.                          *
+ *                                                                            *
+ ******************************************************************************/
+static int	dc_snmp_item_is_async(const ZBX_DC_ITEM *dc_item)
+{
+	const ZBX_DC_SNMPITEM		*snmpitem;
+	const ZBX_DC_SNMPINTERFACE	*snmp;
+
+	if (0 != (ZBX_FLAG_DISCOVERY_RULE & dc_item->flags))
+		return FAIL;
+
+	if (NULL == (snmpitem = (const ZBX_DC_SNMPITEM *)zbx_hashset_search(&config->snmpitems, &dc_item->itemid)) ||
+			ZBX_SNMP_OID_TYPE_NORMAL != snmpitem->snmp_oid_type)
+	{
+		return FAIL;
+	}
+
+	if (NULL == (snmp = (const ZBX_DC_SNMPINTERFACE *)zbx_hashset_search(&config->interfaces_snmp,
+			&dc_item->interfaceid)) || ZBX_IF_SNMP_VERSION_3 == snmp->version)
+	{
+		return FAIL;
+	}
+
+	return SUCCEED;
+}
+
+static unsigned char	poller_by_item(const ZBX_DC_ITEM *dc_item)
 {
-	switch (type)
+	switch (dc_item->type)
 	{
 		case ITEM_TYPE_SIMPLE:
-			if (SUCCEED == cmp_key_id(key, SERVER_ICMPPING_KEY) ||
-					SUCCEED == cmp_key_id(key, SERVER_ICMPPINGSEC_KEY) ||
-					SUCCEED == cmp_key_id(key, SERVER_ICMPPINGLOSS_KEY))
+			if (SUCCEED == cmp_key_id(dc_item->key, SERVER_ICMPPING_KEY) ||
+					SUCCEED == cmp_key_id(dc_item->key, SERVER_ICMPPINGSEC_KEY) ||
+					SUCCEED == cmp_key_id(dc_item->key, SERVER_ICMPPINGLOSS_KEY))
 			{
 				if (0 == CONFIG_PINGER_FORKS)
 					break;
@@ -215,17 +310,38 @@ static unsigned char	poller_by_item(unsigned char type, const char *key)
 				return ZBX_POLLER_TYPE_PINGER;
 			}
 			ZBX_FALLTHROUGH;
-		case ITEM_TYPE_ZABBIX:
-		case ITEM_TYPE_SNMP:
 		case ITEM_TYPE_EXTERNAL:
 		case ITEM_TYPE_DB_MONITOR:
 		case ITEM_TYPE_SSH:
 		case ITEM_TYPE_TELNET:
-		case ITEM_TYPE_HTTPAGENT:
 		case ITEM_TYPE_SCRIPT:
 			if (0 == CONFIG_POLLER_FORKS)
 				break;
 
+			return ZBX_POLLER_TYPE_NORMAL;
+		case ITEM_TYPE_HTTPAGENT:
+			if (0 != CONFIG_HTTPAGENT_POLLER_FORKS)
+				return ZBX_POLLER_TYPE_HTTPAGENT;
+
+			if (0 == CONFIG_POLLER_FORKS)
+				break;
+
+			return ZBX_POLLER_TYPE_NORMAL;
+		case ITEM_TYPE_SNMP:
+			if (0 != CONFIG_SNMPPOLLER_FORKS && SUCCEED == dc_snmp_item_is_async(dc_item))
+				return ZBX_POLLER_TYPE_SNMP;
+
+			if (0 == CONFIG_POLLER_FORKS)
+				break;
+
+			return ZBX_POLLER_TYPE_NORMAL;
+		case ITEM_TYPE_ZABBIX:
+			if (0 != CONFIG_AGENTPOLLER_FORKS)
+				return ZBX_POLLER_TYPE_AGENT;
+
+			if (0 == CONFIG_POLLER_FORKS)
+				break;
+
 			return ZBX_POLLER_TYPE_NORMAL;
 		case ITEM_TYPE_CALCULATED:
 		case ITEM_TYPE_INTERNAL:
@@ -397,12 +513,16 @@ static void	DCitem_poller_type_update(ZBX_DC_ITEM *dc_item, const ZBX_DC_HOST *d
 		return;
 	}
 
-	poller_type = poller_by_item(dc_item->type, dc_item->key);
+	poller_type = poller_by_item(dc_item);
 
 	if (0 != (flags & ZBX_HOST_UNREACHABLE))
 	{
-		if (ZBX_POLLER_TYPE_NORMAL == poller_type || ZBX_POLLER_TYPE_JAVA == poller_type)
+		if (ZBX_POLLER_TYPE_NORMAL == poller_type || ZBX_POLLER_TYPE_JAVA == poller_type ||
+				ZBX_POLLER_TYPE_AGENT == poller_type || ZBX_POLLER_TYPE_SNMP == poller_type ||
+				ZBX_POLLER_TYPE_HTTPAGENT == poller_type)
+		{
 			poller_type = ZBX_POLLER_TYPE_UNREACHABLE;
+		}
 
 		dc_item->poller_type = poller_type;
 		return;
@@ -415,12 +535,16 @@ static void	DCitem_poller_type_update(ZBX_DC_ITEM *dc_item, const ZBX_DC_HOST *d
 	}
 
 	if (ZBX_POLLER_TYPE_UNREACHABLE != dc_item->poller_type ||
-			(ZBX_POLLER_TYPE_NORMAL != poller_type && ZBX_POLLER_TYPE_JAVA != poller_type))
+			(ZBX_POLLER_TYPE_NORMAL != poller_type && ZBX_POLLER_TYPE_JAVA != poller_type &&
+			ZBX_POLLER_TYPE_AGENT != poller_type && ZBX_POLLER_TYPE_SNMP != poller_type &&
+			ZBX_POLLER_TYPE_HTTPAGENT != poller_type))
 	{
 		dc_item->poller_type = poller_type;
 	}
 }
 
+/* pollers update interface disable_until with configuration cache read locked, but concurrent */
+/* updates from pollers of different types store the same value                                */
 static void	DCincrease_disable_until(ZBX_DC_INTERFACE *interface, int now)
 {
 	if (NULL != interface && 0 != interface->errors_from)
@@ -583,15 +707,13 @@ int	DCstrpool_replace(int found, const char **curr, const char *new_str)
 
 static void	DCupdate_item_queue(ZBX_DC_ITEM *item, unsigned char old_poller_type, int old_nextcheck)
 {
-	zbx_binary_heap_elem_t	elem;
-
 	if (ZBX_LOC_POLLER == item->location)
 		return;
 
 	if (ZBX_LOC_QUEUE == item->location && old_poller_type != item->poller_type)
 	{
 		item->location = ZBX_LOC_NOWHERE;
-		zbx_binary_heap_remove_direct(&config->queues[old_poller_type], item->itemid);
+		zbx_timer_wheel_remove(&config->queues[old_poller_type], item->itemid);
 	}
 
 	if (item->poller_type == ZBX_NO_POLLER)
@@ -600,16 +722,8 @@ static void	DCupdate_item_queue(ZBX_DC_ITEM *item, unsigned char old_poller_type
 	if (ZBX_LOC_QUEUE == item->location && old_nextcheck == item->nextcheck)
 		return;
 
-	elem.key = item->itemid;
-	elem.data = (const void *)item;
-
-	if (ZBX_LOC_QUEUE != item->location)
-	{
-		item->location = ZBX_LOC_QUEUE;
-		zbx_binary_heap_insert(&config->queues[item->poller_type], &elem);
-	}
-	else
-		zbx_binary_heap_update_direct(&config->queues[item->poller_type], &elem);
+	item->location = ZBX_LOC_QUEUE;
+	zbx_timer_wheel_update(&config->queues[item->poller_type], item->itemid, item, item->nextcheck);
 }
 
 static void	DCupdate_proxy_queue(ZBX_DC_PROXY *proxy)
@@ -1121,6 +1235,43 @@ static void	DCsync_autoreg_config(zbx_dbsync_t *sync)
 	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: dc_sync_yield                                                    *
+ *                                                                            *
+ * Purpose: briefly releases configuration cache write lock during long       *
+ *          synchronization so that readers are not blocked for the whole     *
+ *          synchronization                                                   *
+ *                                                                            *
+ * Parameters: rows - [IN/OUT] the number of rows processed since the last    *
+ *                             check                                          *
+ *                                                                            *
+ * Comments: Must be called only between synchronized rows, when the objects *
+ *           of the previous row are completely updated. Readers can observe  *
+ *           configuration with only part of the rows applied, similarly to   *
+ *           the state between synchronization sections.                      *
+ *                                                                            *
+ ******************************************************************************/
+static void	dc_sync_yield(int *rows)
+{
+	if (ZBX_SYNC_YIELD_ROWS > ++(*rows))
+		return;
+
+	*rows = 0;
+
+	if (ZBX_SYNC_LOCK_SLICE > zbx_time() - sync_lock_time)
+		return;
+
+	FINISH_SYNC;
+
+	/* give the readers waiting for the lock a chance to acquire it */
+	sched_yield();
+
+	START_SYNC;
+
+	sync_yield_num++;
+}
+
 static void	DCsync_proxy_remove(ZBX_DC_PROXY *proxy)
 {
 	if (ZBX_LOC_QUEUE == proxy->location)
@@ -2214,6 +2365,8 @@ static int	DCsync_kvs_paths(const struct zbx_json_parse *jp_kvs_paths)
 				dc_kv->value = NULL;
 			}
 
+			config->um_revision++;
+
 			FINISH_SYNC;
 		}
 
@@ -2748,6 +2901,82 @@ static unsigned char	*config_decode_serialized_expression(const char *src)
 	return dst;
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: dc_httpitem_params_acquire                                       *
+ *                                                                            *
+ * Purpose: gets shared HTTP agent item parameters                            *
+ *                                                                            *
+ * Parameters: params_local - [IN] the parameters with interned strings,      *
+ *                                 the string references are passed to the   *
+ *                                 shared parameters or released              *
+ *                                                                            *
+ * Return value: the shared parameters                                        *
+ *                                                                            *
+ ******************************************************************************/
+static const zbx_dc_httpitem_params_t	*dc_httpitem_params_acquire(zbx_dc_httpitem_params_t *params_local)
+{
+	zbx_dc_httpitem_params_t	*params;
+
+	if (NULL == (params = (zbx_dc_httpitem_params_t *)zbx_hashset_search(&config->httpitem_params,
+			params_local)))
+	{
+		params_local->refcount = 1;
+
+		return (const zbx_dc_httpitem_params_t *)zbx_hashset_insert(&config->httpitem_params, params_local,
+				sizeof(zbx_dc_httpitem_params_t));
+	}
+
+	zbx_strpool_release(params_local->timeout);
+	zbx_strpool_release(params_local->url);
+	zbx_strpool_release(params_local->query_fields);
+	zbx_strpool_release(params_local->posts);
+	zbx_strpool_release(params_local->status_codes);
+	zbx_strpool_release(params_local->http_proxy);
+	zbx_strpool_release(params_local->headers);
+	zbx_strpool_release(params_local->ssl_cert_file);
+	zbx_strpool_release(params_local->ssl_key_file);
+	zbx_strpool_release(params_local->ssl_key_password);
+	zbx_strpool_release(params_local->username);
+	zbx_strpool_release(params_local->password);
+	zbx_strpool_release(params_local->trapper_hosts);
+
+	params->refcount++;
+
+	return params;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: dc_httpitem_params_release                                       *
+ *                                                                            *
+ * Purpose: releases shared HTTP agent item parameters                        *
+ *                                                                            *
+ ******************************************************************************/
+static void	dc_httpitem_params_release(const zbx_dc_httpitem_params_t *params)
+{
+	zbx_dc_httpitem_params_t	*params_mod = (zbx_dc_httpitem_params_t *)params;
+
+	if (0 != --params_mod->refcount)
+		return;
+
+	zbx_strpool_release(params->timeout);
+	zbx_strpool_release(params->url);
+	zbx_strpool_release(params->query_fields);
+	zbx_strpool_release(params->posts);
+	zbx_strpool_release(params->status_codes);
+	zbx_strpool_release(params->http_proxy);
+	zbx_strpool_release(params->headers);
+	zbx_strpool_release(params->ssl_cert_file);
+	zbx_strpool_release(params->ssl_key_file);
+	zbx_strpool_release(params->ssl_key_password);
+	zbx_strpool_release(params->username);
+	zbx_strpool_release(params->password);
+	zbx_strpool_release(params->trapper_hosts);
+
+	zbx_hashset_remove_direct(&config->httpitem_params, params_mod);
+}
+
 static void	DCsync_items(zbx_dbsync_t *sync, int flags)
 {
 	char			**row;
@@ -2779,7 +3008,7 @@ static void	DCsync_items(zbx_dbsync_t *sync, int flags)
 
 	time_t			now;
 	unsigned char		status, type, value_type, old_poller_type;
-	int			found, update_index, ret, i,  old_nextcheck;
+	int			found, update_index, ret, i,  old_nextcheck, rows = 0;
 	zbx_uint64_t		itemid, hostid, interfaceid;
 	zbx_vector_ptr_t	dep_items;
 
@@ -2795,6 +3024,8 @@ static void	DCsync_items(zbx_dbsync_t *sync, int flags)
 		if (ZBX_DBSYNC_ROW_REMOVE == tag)
 			break;
 
+		dc_sync_yield(&rows);
+
 		ZBX_STR2UINT64(itemid, row[0]);
 		ZBX_STR2UINT64(hostid, row[1]);
 		ZBX_STR2UCHAR(status, row[2]);
@@ -3209,49 +3440,49 @@ static void	DCsync_items(zbx_dbsync_t *sync, int flags)
 
 		if (ITEM_TYPE_HTTPAGENT == item->type)
 		{
+			zbx_dc_httpitem_params_t	params_local;
+			const zbx_dc_httpitem_params_t	*params;
+
 			httpitem = (ZBX_DC_HTTPITEM *)DCfind_id(&config->httpitems, itemid, sizeof(ZBX_DC_HTTPITEM),
 					&found);
 
-			DCstrpool_replace(found, &httpitem->timeout, row[30]);
-			DCstrpool_replace(found, &httpitem->url, row[31]);
-			DCstrpool_replace(found, &httpitem->query_fields, row[32]);
-			DCstrpool_replace(found, &httpitem->posts, row[33]);
-			DCstrpool_replace(found, &httpitem->status_codes, row[34]);
-			httpitem->follow_redirects = (unsigned char)atoi(row[35]);
-			httpitem->post_type = (unsigned char)atoi(row[36]);
-			DCstrpool_replace(found, &httpitem->http_proxy, row[37]);
-			DCstrpool_replace(found, &httpitem->headers, row[38]);
-			httpitem->retrieve_mode = (unsigned char)atoi(row[39]);
-			httpitem->request_method = (unsigned char)atoi(row[40]);
-			httpitem->output_format = (unsigned char)atoi(row[41]);
-			DCstrpool_replace(found, &httpitem->ssl_cert_file, row[42]);
-			DCstrpool_replace(found, &httpitem->ssl_key_file, row[43]);
-			DCstrpool_replace(found, &httpitem->ssl_key_password, row[44]);
-			httpitem->verify_peer = (unsigned char)atoi(row[45]);
-			httpitem->verify_host = (unsigned char)atoi(row[46]);
-			httpitem->allow_traps = (unsigned char)atoi(row[47]);
-
-			httpitem->authtype = (unsigned char)atoi(row[13]);
-			DCstrpool_replace(found, &httpitem->username, row[14]);
-			DCstrpool_replace(found, &httpitem->password, row[15]);
-			DCstrpool_replace(found, &httpitem->trapper_hosts, row[9]);
+			/* zero padding bytes, as parameters are hashed and compared as memory block */
+			memset(&params_local, 0, sizeof(params_local));
+
+			params_local.timeout = zbx_strpool_intern(row[30]);
+			params_local.url = zbx_strpool_intern(row[31]);
+			params_local.query_fields = zbx_strpool_intern(row[32]);
+			params_local.posts = zbx_strpool_intern(row[33]);
+			params_local.status_codes = zbx_strpool_intern(row[34]);
+			params_local.follow_redirects = (unsigned char)atoi(row[35]);
+			params_local.post_type = (unsigned char)atoi(row[36]);
+			params_local.http_proxy = zbx_strpool_intern(row[37]);
+			params_local.headers = zbx_strpool_intern(row[38]);
+			params_local.retrieve_mode = (unsigned char)atoi(row[39]);
+			params_local.request_method = (unsigned char)atoi(row[40]);
+			params_local.output_format = (unsigned char)atoi(row[41]);
+			params_local.ssl_cert_file = zbx_strpool_intern(row[42]);
+			params_local.ssl_key_file = zbx_strpool_intern(row[43]);
+			params_local.ssl_key_password = zbx_strpool_intern(row[44]);
+			params_local.verify_peer = (unsigned char)atoi(row[45]);
+			params_local.verify_host = (unsigned char)atoi(row[46]);
+			params_local.allow_traps = (unsigned char)atoi(row[47]);
+
+			params_local.authtype = (unsigned char)atoi(row[13]);
+			params_local.username = zbx_strpool_intern(row[14]);
+			params_local.password = zbx_strpool_intern(row[15]);
+			params_local.trapper_hosts = zbx_strpool_intern(row[9]);
+
+			params = dc_httpitem_params_acquire(&params_local);
+
+			if (1 == found)
+				dc_httpitem_params_release(httpitem->params);
+
+			httpitem->params = params;
 		}
 		else if (NULL != (httpitem = (ZBX_DC_HTTPITEM *)zbx_hashset_search(&config->httpitems, &itemid)))
 		{
-			zbx_strpool_release(httpitem->timeout);
-			zbx_strpool_release(httpitem->url);
-			zbx_strpool_release(httpitem->query_fields);
-			zbx_strpool_release(httpitem->posts);
-			zbx_strpool_release(httpitem->status_codes);
-			zbx_strpool_release(httpitem->http_proxy);
-			zbx_strpool_release(httpitem->headers);
-			zbx_strpool_release(httpitem->ssl_cert_file);
-			zbx_strpool_release(httpitem->ssl_key_file);
-			zbx_strpool_release(httpitem->ssl_key_password);
-			zbx_strpool_release(httpitem->username);
-			zbx_strpool_release(httpitem->password);
-			zbx_strpool_release(httpitem->trapper_hosts);
-
+			dc_httpitem_params_release(httpitem->params);
 			zbx_hashset_remove_direct(&config->httpitems, httpitem);
 		}
 
@@ -3354,6 +3585,8 @@ static void	DCsync_items(zbx_dbsync_t *sync, int flags)
 	/* remove deleted items from buffer */
 	for (; SUCCEED == ret; ret = zbx_dbsync_next(sync, &rowid, &row, &tag))
 	{
+		dc_sync_yield(&rows);
+
 		if (NULL == (item = (ZBX_DC_ITEM *)zbx_hashset_search(&config->items, &rowid)))
 			continue;
 
@@ -3507,20 +3740,7 @@ static void	DCsync_items(zbx_dbsync_t *sync, int flags)
 		{
 			httpitem = (ZBX_DC_HTTPITEM *)zbx_hashset_search(&config->httpitems, &itemid);
 
-			zbx_strpool_release(httpitem->timeout);
-			zbx_strpool_release(httpitem->url);
-			zbx_strpool_release(httpitem->query_fields);
-			zbx_strpool_release(httpitem->posts);
-			zbx_strpool_release(httpitem->status_codes);
-			zbx_strpool_release(httpitem->http_proxy);
-			zbx_strpool_release(httpitem->headers);
-			zbx_strpool_release(httpitem->ssl_cert_file);
-			zbx_strpool_release(httpitem->ssl_key_file);
-			zbx_strpool_release(httpitem->ssl_key_password);
-			zbx_strpool_release(httpitem->username);
-			zbx_strpool_release(httpitem->password);
-			zbx_strpool_release(httpitem->trapper_hosts);
-
+			dc_httpitem_params_release(httpitem->params);
 			zbx_hashset_remove_direct(&config->httpitems, httpitem);
 		}
 
@@ -3555,7 +3775,7 @@ static void	DCsync_items(zbx_dbsync_t *sync, int flags)
 		}
 
 		if (ZBX_LOC_QUEUE == item->location)
-			zbx_binary_heap_remove_direct(&config->queues[item->poller_type], item->itemid);
+			zbx_timer_wheel_remove(&config->queues[item->poller_type], item->itemid);
 
 		zbx_strpool_release(item->key);
 		zbx_strpool_release(item->error);
@@ -3658,7 +3878,7 @@ static void	DCsync_triggers(zbx_dbsync_t *sync)
 
 	ZBX_DC_TRIGGER	*trigger;
 
-	int		found, ret;
+	int		found, ret, rows = 0;
 	zbx_uint64_t	triggerid;
 
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
@@ -3669,6 +3889,8 @@ static void	DCsync_triggers(zbx_dbsync_t *sync)
 		if (ZBX_DBSYNC_ROW_REMOVE == tag)
 			break;
 
+		dc_sync_yield(&rows);
+
 		ZBX_STR2UINT64(triggerid, row[0]);
 
 		trigger = (ZBX_DC_TRIGGER *)DCfind_id(&config->triggers, triggerid, sizeof(ZBX_DC_TRIGGER), &found);
@@ -4227,7 +4449,7 @@ static void	DCsync_functions(zbx_dbsync_t *sync)
 	ZBX_DC_ITEM	*item;
 	ZBX_DC_FUNCTION	*function;
 
-	int		found, ret;
+	int		found, ret, rows = 0;
 	zbx_uint64_t	itemid, functionid, triggerid;
 
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
@@ -4238,6 +4460,8 @@ static void	DCsync_functions(zbx_dbsync_t *sync)
 		if (ZBX_DBSYNC_ROW_REMOVE == tag)
 			break;
 
+		dc_sync_yield(&rows);
+
 		ZBX_STR2UINT64(itemid, row[0]);
 		ZBX_STR2UINT64(functionid, row[1]);
 		ZBX_STR2UINT64(triggerid, row[4]);
@@ -4292,6 +4516,8 @@ static void	DCsync_functions(zbx_dbsync_t *sync)
 
 	for (; SUCCEED == ret; ret = zbx_dbsync_next(sync, &rowid, &row, &tag))
 	{
+		dc_sync_yield(&rows);
+
 		if (NULL == (function = (ZBX_DC_FUNCTION *)zbx_hashset_search(&config->functions, &rowid)))
 			continue;
 
@@ -5919,6 +6145,80 @@ static void	dc_load_trigger_queue(zbx_hashset_t *trend_functions)
 	DBfree_result(result);
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: dc_load_runtime_data                                             *
+ *                                                                            *
+ * Purpose: load trigger, item and interface runtime data from database       *
+ *                                                                            *
+ * Comments: This function is called after the first synchronization was     *
+ *           done from configuration cache snapshot. Runtime data is not      *
+ *           compared by the next synchronization, so the values saved in     *
+ *           snapshot would stay in cache.                                    *
+ *                                                                            *
+ ******************************************************************************/
+static void	dc_load_runtime_data(void)
+{
+	DB_RESULT		result;
+	DB_ROW			row;
+	zbx_uint64_t		objectid;
+	ZBX_DC_TRIGGER		*trigger;
+	ZBX_DC_ITEM		*item;
+	ZBX_DC_INTERFACE	*interface;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+
+	result = DBselect("select triggerid,value,state,lastchange,error from triggers");
+
+	while (NULL != (row = DBfetch(result)))
+	{
+		ZBX_STR2UINT64(objectid, row[0]);
+
+		if (NULL == (trigger = (ZBX_DC_TRIGGER *)zbx_hashset_search(&config->triggers, &objectid)))
+			continue;
+
+		ZBX_STR2UCHAR(trigger->value, row[1]);
+		ZBX_STR2UCHAR(trigger->state, row[2]);
+		trigger->lastchange = atoi(row[3]);
+		DCstrpool_replace(1, &trigger->error, row[4]);
+	}
+	DBfree_result(result);
+
+	result = DBselect("select itemid,state,lastlogsize,mtime,error from item_rtdata");
+
+	while (NULL != (row = DBfetch(result)))
+	{
+		ZBX_STR2UINT64(objectid, row[0]);
+
+		if (NULL == (item = (ZBX_DC_ITEM *)zbx_hashset_search(&config->items, &objectid)))
+			continue;
+
+		ZBX_STR2UCHAR(item->state, row[1]);
+		ZBX_STR2UINT64(item->lastlogsize, row[2]);
+		item->mtime = atoi(row[3]);
+		DCstrpool_replace(1, &item->error, row[4]);
+	}
+	DBfree_result(result);
+
+	result = DBselect("select interfaceid,available,disable_until,errors_from,error from interface");
+
+	while (NULL != (row = DBfetch(result)))
+	{
+		ZBX_STR2UINT64(objectid, row[0]);
+
+		if (NULL == (interface = (ZBX_DC_INTERFACE *)zbx_hashset_search(&config->interfaces, &objectid)))
+			continue;
+
+		ZBX_STR2UCHAR(interface->available, row[1]);
+		interface->disable_until = atoi(row[2]);
+		interface->errors_from = atoi(row[3]);
+		DCstrpool_replace(1, &interface->error, row[4]);
+	}
+	DBfree_result(result);
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: DCsync_configuration                                             *
@@ -5956,6 +6256,7 @@ void	DCsync_configuration(unsigned char mode, const struct zbx_json_parse *jp_kv
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
 
 	config->sync_start_ts = time(NULL);
+	sync_yield_num = 0;
 
 	if (ZBX_SYNC_SECRETS == mode)
 	{
@@ -5964,6 +6265,8 @@ void	DCsync_configuration(unsigned char mode, const struct zbx_json_parse *jp_kv
 	}
 
 	zbx_dbsync_init_env(config);
+	zbx_dbsync_env_prepare(mode);
+	zbx_dbsync_env_prefetch();
 
 	if (ZBX_DBSYNC_INIT == mode)
 	{
@@ -6055,6 +6358,14 @@ void	DCsync_configuration(unsigned char mode, const struct zbx_json_parse *jp_kv
 		goto out;
 	host_tag_sec = zbx_time() - sec;
 
+	/* user macros are expanded in item fields, so any change of them requires full item comparison */
+	if (0 != htmpl_sync.add_num + htmpl_sync.update_num + htmpl_sync.remove_num +
+			gmacro_sync.add_num + gmacro_sync.update_num + gmacro_sync.remove_num +
+			hmacro_sync.add_num + hmacro_sync.update_num + hmacro_sync.remove_num)
+	{
+		zbx_dbsync_env_reset_changelog();
+	}
+
 	START_SYNC;
 	sec = zbx_time();
 	DCsync_htmpls(&htmpl_sync);
@@ -6068,6 +6379,13 @@ void	DCsync_configuration(unsigned char mode, const struct zbx_json_parse *jp_kv
 	DCsync_hmacros(&hmacro_sync);
 	hmsec2 = zbx_time() - sec;
 
+	if (0 != htmpl_sync.add_num + htmpl_sync.update_num + htmpl_sync.remove_num +
+			gmacro_sync.add_num + gmacro_sync.update_num + gmacro_sync.remove_num +
+			hmacro_sync.add_num + hmacro_sync.update_num + hmacro_sync.remove_num)
+	{
+		config->um_revision++;
+	}
+
 	sec = zbx_time();
 	DCsync_host_tags(&host_tag_sync);
 	host_tag_sec2 = zbx_time() - sec;
@@ -6357,6 +6675,12 @@ void	DCsync_configuration(unsigned char mode, const struct zbx_json_parse *jp_kv
 
 	update_sec = zbx_time() - sec;
 
+	if (ZBX_DBSYNC_INIT == mode && SUCCEED == zbx_dbsync_snapshot_loaded())
+		dc_load_runtime_data();
+
+	zbx_dbsync_env_save_snapshot();
+	zbx_dbsync_env_flush_changelog();
+
 	if (SUCCEED == ZBX_CHECK_LOG_LEVEL(LOG_LEVEL_DEBUG))
 	{
 		total = csec + hsec + hisec + htsec + gmsec + hmsec + ifsec + isec + tsec + dsec + fsec + expr_sec +
@@ -6562,6 +6886,8 @@ void	DCsync_configuration(unsigned char mode, const struct zbx_json_parse *jp_kv
 				config->calcitems.num_data, config->calcitems.num_slots);
 		zabbix_log(LOG_LEVEL_DEBUG, "%s() httpitems  : %d (%d slots)", __func__,
 				config->httpitems.num_data, config->httpitems.num_slots);
+		zabbix_log(LOG_LEVEL_DEBUG, "%s() httpparams : %d (%d slots)", __func__,
+				config->httpitem_params.num_data, config->httpitem_params.num_slots);
 		zabbix_log(LOG_LEVEL_DEBUG, "%s() scriptitems  : %d (%d slots)", __func__,
 				config->scriptitems.num_data, config->scriptitems.num_slots);
 		zabbix_log(LOG_LEVEL_DEBUG, "%s() functions  : %d (%d slots)", __func__,
@@ -6600,8 +6926,8 @@ void	DCsync_configuration(unsigned char mode, const struct zbx_json_parse *jp_kv
 
 		for (i = 0; ZBX_POLLER_TYPE_COUNT > i; i++)
 		{
-			zabbix_log(LOG_LEVEL_DEBUG, "%s() queue[%d]   : %d (%d allocated)", __func__,
-					i, config->queues[i].elems_num, config->queues[i].elems_alloc);
+			zabbix_log(LOG_LEVEL_DEBUG, "%s() queue[%d]   : %d", __func__,
+					i, zbx_timer_wheel_elems_num(&config->queues[i]));
 		}
 
 		zabbix_log(LOG_LEVEL_DEBUG, "%s() pqueue     : %d (%d allocated)", __func__,
@@ -6616,6 +6942,8 @@ void	DCsync_configuration(unsigned char mode, const struct zbx_json_parse *jp_kv
 		zabbix_log(LOG_LEVEL_DEBUG, "%s() strings    : %d (%d slots)", __func__,
 				config->strpool.num_data, config->strpool.num_slots);
 
+		zabbix_log(LOG_LEVEL_DEBUG, "%s() lock yields: %d", __func__, sync_yield_num);
+
 		zbx_mem_dump_stats(LOG_LEVEL_DEBUG, config_mem);
 	}
 out:
@@ -6716,6 +7044,16 @@ static zbx_hash_t	__config_host_h_hash(const void *data)
 	return ZBX_DEFAULT_STRING_HASH_ALGO(host_h->host, strlen(host_h->host), ZBX_DEFAULT_HASH_SEED);
 }
 
+static zbx_hash_t	__config_httpitem_params_hash(const void *data)
+{
+	return ZBX_DEFAULT_HASH_ALGO(data, offsetof(zbx_dc_httpitem_params_t, refcount), ZBX_DEFAULT_HASH_SEED);
+}
+
+static int	__config_httpitem_params_compare(const void *d1, const void *d2)
+{
+	return memcmp(d1, d2, offsetof(zbx_dc_httpitem_params_t, refcount));
+}
+
 static int	__config_host_h_compare(const void *d1, const void *d2)
 {
 	const ZBX_DC_HOST_H	*host_h_1 = (const ZBX_DC_HOST_H *)d1;
@@ -7006,6 +7344,20 @@ int	init_configuration_cache(char **error)
 	if (SUCCEED != (ret = zbx_rwlock_create(&config_lock, ZBX_RWLOCK_CONFIG, error)))
 		goto out;
 
+	for (i = 0; i < ZBX_POLLER_TYPE_COUNT; i++)
+	{
+		poller_queue_locks[i] = ZBX_MUTEX_NULL;
+
+		if (SUCCEED != (ret = zbx_mutex_create(&poller_queue_locks[i],
+				(zbx_mutex_name_t)(ZBX_MUTEX_POLLER_QUEUE + i), error)))
+		{
+			goto out;
+		}
+	}
+
+	if (SUCCEED != (ret = zbx_mutex_create(&poller_queue_mem_lock, ZBX_MUTEX_POLLER_QUEUE_MEM, error)))
+		goto out;
+
 	if (SUCCEED != (ret = zbx_mem_create(&config_mem, CONFIG_CONF_CACHE_SIZE, "configuration cache",
 			"CacheSize", 0, error)))
 	{
@@ -7081,6 +7433,8 @@ int	init_configuration_cache(char **error)
 	CREATE_HASHSET(config->maintenance_tags, 0);
 
 	CREATE_HASHSET_EXT(config->items_hk, 100, __config_item_hk_hash, __config_item_hk_compare);
+	CREATE_HASHSET_EXT(config->httpitem_params, 0, __config_httpitem_params_hash,
+			__config_httpitem_params_compare);
 	CREATE_HASHSET_EXT(config->hosts_h, 10, __config_host_h_hash, __config_host_h_compare);
 	CREATE_HASHSET_EXT(config->hosts_p, 0, __config_host_h_hash, __config_host_h_compare);
 	CREATE_HASHSET_EXT(config->gmacros_m, 0, __config_gmacro_m_hash, __config_gmacro_m_compare);
@@ -7100,28 +7454,25 @@ int	init_configuration_cache(char **error)
 		switch (i)
 		{
 			case ZBX_POLLER_TYPE_JAVA:
-				zbx_binary_heap_create_ext(&config->queues[i],
+				zbx_timer_wheel_create_ext(&config->queues[i],
 						__config_java_elem_compare,
-						ZBX_BINARY_HEAP_OPTION_DIRECT,
-						__config_mem_malloc_func,
-						__config_mem_realloc_func,
-						__config_mem_free_func);
+						__config_queue_mem_malloc_func,
+						__config_queue_mem_realloc_func,
+						__config_queue_mem_free_func);
 				break;
 			case ZBX_POLLER_TYPE_PINGER:
-				zbx_binary_heap_create_ext(&config->queues[i],
+				zbx_timer_wheel_create_ext(&config->queues[i],
 						__config_pinger_elem_compare,
-						ZBX_BINARY_HEAP_OPTION_DIRECT,
-						__config_mem_malloc_func,
-						__config_mem_realloc_func,
-						__config_mem_free_func);
+						__config_queue_mem_malloc_func,
+						__config_queue_mem_realloc_func,
+						__config_queue_mem_free_func);
 				break;
 			default:
-				zbx_binary_heap_create_ext(&config->queues[i],
+				zbx_timer_wheel_create_ext(&config->queues[i],
 						__config_heap_elem_compare,
-						ZBX_BINARY_HEAP_OPTION_DIRECT,
-						__config_mem_malloc_func,
-						__config_mem_realloc_func,
-						__config_mem_free_func);
+						__config_queue_mem_malloc_func,
+						__config_queue_mem_realloc_func,
+						__config_queue_mem_free_func);
 				break;
 		}
 	}
@@ -7151,6 +7502,7 @@ int	init_configuration_cache(char **error)
 	config->sync_ts = 0;
 	config->item_sync_ts = 0;
 	config->sync_start_ts = 0;
+	config->um_revision = 0;
 
 	config->internal_actions = 0;
 
@@ -7196,6 +7548,8 @@ out:
  ******************************************************************************/
 void	free_configuration_cache(void)
 {
+	int	i;
+
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
 
 	WRLOCK_CACHE;
@@ -7206,6 +7560,11 @@ void	free_configuration_cache(void)
 
 	zbx_rwlock_destroy(&config_lock);
 
+	for (i = 0; i < ZBX_POLLER_TYPE_COUNT; i++)
+		zbx_mutex_destroy(&poller_queue_locks[i]);
+
+	zbx_mutex_destroy(&poller_queue_mem_lock);
+
 	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
 }
 
@@ -7790,28 +8149,28 @@ static void	DCget_item(DC_ITEM *dst_item, const ZBX_DC_ITEM *src_item, unsigned
 		case ITEM_TYPE_HTTPAGENT:
 			if (NULL != (httpitem = (ZBX_DC_HTTPITEM *)zbx_hashset_search(&config->httpitems, &src_item->itemid)))
 			{
-				strscpy(dst_item->timeout_orig, httpitem->timeout);
-				strscpy(dst_item->url_orig, httpitem->url);
-				strscpy(dst_item->query_fields_orig, httpitem->query_fields);
-				strscpy(dst_item->status_codes_orig, httpitem->status_codes);
-				dst_item->follow_redirects = httpitem->follow_redirects;
-				dst_item->post_type = httpitem->post_type;
-				strscpy(dst_item->http_proxy_orig, httpitem->http_proxy);
-				dst_item->headers = zbx_strdup(NULL, httpitem->headers);
-				dst_item->retrieve_mode = httpitem->retrieve_mode;
-				dst_item->request_method = httpitem->request_method;
-				dst_item->output_format = httpitem->output_format;
-				strscpy(dst_item->ssl_cert_file_orig, httpitem->ssl_cert_file);
-				strscpy(dst_item->ssl_key_file_orig, httpitem->ssl_key_file);
-				strscpy(dst_item->ssl_key_password_orig, httpitem->ssl_key_password);
-				dst_item->verify_peer = httpitem->verify_peer;
-				dst_item->verify_host = httpitem->verify_host;
-				dst_item->authtype = httpitem->authtype;
-				strscpy(dst_item->username_orig, httpitem->username);
-				strscpy(dst_item->password_orig, httpitem->password);
-				dst_item->posts = zbx_strdup(NULL, httpitem->posts);
-				dst_item->allow_traps = httpitem->allow_traps;
-				strscpy(dst_item->trapper_hosts, httpitem->trapper_hosts);
+				strscpy(dst_item->timeout_orig, httpitem->params->timeout);
+				strscpy(dst_item->url_orig, httpitem->params->url);
+				strscpy(dst_item->query_fields_orig, httpitem->params->query_fields);
+				strscpy(dst_item->status_codes_orig, httpitem->params->status_codes);
+				dst_item->follow_redirects = httpitem->params->follow_redirects;
+				dst_item->post_type = httpitem->params->post_type;
+				strscpy(dst_item->http_proxy_orig, httpitem->params->http_proxy);
+				dst_item->headers = zbx_strdup(NULL, httpitem->params->headers);
+				dst_item->retrieve_mode = httpitem->params->retrieve_mode;
+				dst_item->request_method = httpitem->params->request_method;
+				dst_item->output_format = httpitem->params->output_format;
+				strscpy(dst_item->ssl_cert_file_orig, httpitem->params->ssl_cert_file);
+				strscpy(dst_item->ssl_key_file_orig, httpitem->params->ssl_key_file);
+				strscpy(dst_item->ssl_key_password_orig, httpitem->params->ssl_key_password);
+				dst_item->verify_peer = httpitem->params->verify_peer;
+				dst_item->verify_host = httpitem->params->verify_host;
+				dst_item->authtype = httpitem->params->authtype;
+				strscpy(dst_item->username_orig, httpitem->params->username);
+				strscpy(dst_item->password_orig, httpitem->params->password);
+				dst_item->posts = zbx_strdup(NULL, httpitem->params->posts);
+				dst_item->allow_traps = httpitem->params->allow_traps;
+				strscpy(dst_item->trapper_hosts, httpitem->params->trapper_hosts);
 			}
 			else
 			{
@@ -9344,26 +9703,25 @@ unlock:
  *                                                                            *
  * Purpose: Get nextcheck for selected queue                                  *
  *                                                                            *
- * Parameters: queue - [IN] the queue                                         *
+ * Parameters: poller_type - [IN] the poller type of the queue                *
  *                                                                            *
  * Return value: nextcheck or FAIL if no items for the specified queue        *
  *                                                                            *
+ * Comments: The configuration cache must be read locked.                     *
+ *                                                                            *
  ******************************************************************************/
-static int	dc_config_get_queue_nextcheck(zbx_binary_heap_t *queue)
+static int	dc_config_get_queue_nextcheck(unsigned char poller_type)
 {
-	int				nextcheck;
-	const zbx_binary_heap_elem_t	*min;
-	const ZBX_DC_ITEM		*dc_item;
+	int	nextcheck;
 
-	if (FAIL == zbx_binary_heap_empty(queue))
-	{
-		min = zbx_binary_heap_find_min(queue);
-		dc_item = (const ZBX_DC_ITEM *)min->data;
+	LOCK_POLLER_QUEUE(poller_type);
 
-		nextcheck = dc_item->nextcheck;
-	}
-	else
+	if (SUCCEED == zbx_timer_wheel_empty(&config->queues[poller_type]))
 		nextcheck = FAIL;
+	else
+		nextcheck = zbx_timer_wheel_nextcheck(&config->queues[poller_type]);
+
+	UNLOCK_POLLER_QUEUE(poller_type);
 
 	return nextcheck;
 }
@@ -9383,16 +9741,13 @@ static int	dc_config_get_queue_nextcheck(zbx_binary_heap_t *queue)
  ******************************************************************************/
 int	DCconfig_get_poller_nextcheck(unsigned char poller_type)
 {
-	int			nextcheck;
-	zbx_binary_heap_t	*queue;
+	int	nextcheck;
 
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s() poller_type:%d", __func__, (int)poller_type);
 
-	queue = &config->queues[poller_type];
-
 	RDLOCK_CACHE;
 
-	nextcheck = dc_config_get_queue_nextcheck(queue);
+	nextcheck = dc_config_get_queue_nextcheck(poller_type);
 
 	UNLOCK_CACHE;
 
@@ -9401,20 +9756,127 @@ int	DCconfig_get_poller_nextcheck(unsigned char poller_type)
 	return nextcheck;
 }
 
-static void	dc_requeue_item(ZBX_DC_ITEM *dc_item, const ZBX_DC_HOST *dc_host, const ZBX_DC_INTERFACE *dc_interface,
-		int flags, int lastclock)
+/******************************************************************************
+ *                                                                            *
+ * Function: dc_poller_queue_take                                             *
+ *                                                                            *
+ * Purpose: removes item from its poller queue                                *
+ *                                                                            *
+ * Parameters: dc_item - [IN] the item                                        *
+ *                                                                            *
+ * Comments: The configuration cache must be read locked. Items that are not  *
+ *           in poller queue are owned by the process that has taken them,    *
+ *           so their scheduling data can be updated without queue locks.     *
+ *                                                                            *
+ ******************************************************************************/
+static void	dc_poller_queue_take(ZBX_DC_ITEM *dc_item)
 {
-	unsigned char	old_poller_type;
-	int		old_nextcheck;
+	unsigned char	poller_type;
 
-	old_nextcheck = dc_item->nextcheck;
-	DCitem_nextcheck_update(dc_item, dc_interface, flags, lastclock, NULL);
+	if (ZBX_LOC_QUEUE != dc_item->location)
+		return;
 
-	old_poller_type = dc_item->poller_type;
-	DCitem_poller_type_update(dc_item, dc_host, flags);
+	poller_type = dc_item->poller_type;
 
-	DCupdate_item_queue(dc_item, old_poller_type, old_nextcheck);
-}
+	LOCK_POLLER_QUEUE(poller_type);
+
+	/* the item could have been taken by poller before the queue was locked */
+	if (ZBX_LOC_QUEUE == dc_item->location && poller_type == dc_item->poller_type)
+	{
+		zbx_timer_wheel_remove(&config->queues[poller_type], dc_item->itemid);
+		dc_item->location = ZBX_LOC_NOWHERE;
+	}
+
+	UNLOCK_POLLER_QUEUE(poller_type);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: dc_poller_queue_pop                                              *
+ *                                                                            *
+ * Purpose: takes the first due item from poller queue                        *
+ *                                                                            *
+ * Parameters: poller_type  - [IN] the poller type                            *
+ *             now          - [IN] the current time                           *
+ *             dc_item_prev - [IN] the previously taken item of the batch,    *
+ *                                 NULL for the first item                    *
+ *                                                                            *
+ * Return value: the taken item or NULL if there are no due items that can    *
+ *               be added to the batch                                        *
+ *                                                                            *
+ * Comments: The configuration cache must be read locked.                     *
+ *                                                                            *
+ ******************************************************************************/
+static ZBX_DC_ITEM	*dc_poller_queue_pop(unsigned char poller_type, int now, const ZBX_DC_ITEM *dc_item_prev)
+{
+	zbx_timer_wheel_t		*queue = &config->queues[poller_type];
+	const zbx_binary_heap_elem_t	*min;
+	ZBX_DC_ITEM			*dc_item = NULL;
+
+	LOCK_POLLER_QUEUE(poller_type);
+
+	if (NULL == (min = zbx_timer_wheel_find_min(queue, now)))
+		goto out;
+
+	if (((const ZBX_DC_ITEM *)min->data)->nextcheck > now)
+		goto out;
+
+	if (NULL != dc_item_prev)
+	{
+		if (ITEM_TYPE_SNMP == dc_item_prev->type)
+		{
+			if (0 != __config_snmp_item_compare(dc_item_prev, (const ZBX_DC_ITEM *)min->data))
+				goto out;
+		}
+		else if (ITEM_TYPE_JMX == dc_item_prev->type)
+		{
+			if (0 != __config_java_item_compare(dc_item_prev, (const ZBX_DC_ITEM *)min->data))
+				goto out;
+		}
+	}
+
+	dc_item = (ZBX_DC_ITEM *)min->data;
+
+	zbx_timer_wheel_remove_min(queue);
+	dc_item->location = ZBX_LOC_NOWHERE;
+out:
+	UNLOCK_POLLER_QUEUE(poller_type);
+
+	return dc_item;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: dc_requeue_item                                                  *
+ *                                                                            *
+ * Purpose: calculates item nextcheck and poller type and puts it back in     *
+ *          poller queue                                                      *
+ *                                                                            *
+ * Comments: The configuration cache must be read locked. Only the target     *
+ *           poller queue is locked while inserting the item.                 *
+ *                                                                            *
+ ******************************************************************************/
+static void	dc_requeue_item(ZBX_DC_ITEM *dc_item, const ZBX_DC_HOST *dc_host, const ZBX_DC_INTERFACE *dc_interface,
+		int flags, int lastclock)
+{
+	unsigned char	old_poller_type;
+	int		old_nextcheck;
+
+	dc_poller_queue_take(dc_item);
+
+	old_nextcheck = dc_item->nextcheck;
+	DCitem_nextcheck_update(dc_item, dc_interface, flags, lastclock, NULL);
+
+	old_poller_type = dc_item->poller_type;
+	DCitem_poller_type_update(dc_item, dc_host, flags);
+
+	if (ZBX_NO_POLLER == dc_item->poller_type)
+		return;
+
+	LOCK_POLLER_QUEUE(dc_item->poller_type);
+	DCupdate_item_queue(dc_item, old_poller_type, old_nextcheck);
+	UNLOCK_POLLER_QUEUE(dc_item->poller_type);
+}
 
 /******************************************************************************
  *                                                                            *
@@ -9445,86 +9907,34 @@ static void	dc_requeue_item_at(ZBX_DC_ITEM *dc_item, ZBX_DC_HOST *dc_host, int n
 
 /******************************************************************************
  *                                                                            *
- * Function: DCconfig_get_poller_items                                        *
- *                                                                            *
- * Purpose: Get array of items for selected poller                            *
- *                                                                            *
- * Parameters: poller_type - [IN] poller type (ZBX_POLLER_TYPE_...)           *
- *             items       - [OUT] array of items                             *
- *                                                                            *
- * Return value: number of items in items array                               *
+ * Function: dc_poller_queue_get_item                                         *
  *                                                                            *
- * Author: Alexander Vladishev, Aleksandrs Saveljevs                          *
+ * Purpose: takes the next item that must be polled from poller queue         *
  *                                                                            *
- * Comments: Items leave the queue only through this function. Pollers must   *
- *           always return the items they have taken using DCrequeue_items()  *
- *           or DCpoller_requeue_items().                                     *
+ * Parameters: poller_type  - [IN] the poller type                            *
+ *             now          - [IN] the current time                           *
+ *             dc_item_prev - [IN] the previously taken item of the batch,    *
+ *                                 NULL for the first item                    *
+ *             dc_host_out  - [OUT] the item host                             *
  *                                                                            *
- *           Currently batch polling is supported only for JMX, SNMP and      *
- *           icmpping* simple checks. In other cases only single item is      *
- *           retrieved.                                                       *
+ * Return value: the taken item or NULL if there are no due items that can    *
+ *               be polled                                                    *
  *                                                                            *
- *           IPMI poller queue are handled by DCconfig_get_ipmi_poller_items()*
- *           function.                                                        *
+ * Comments: The configuration cache must be read locked. Items of hosts in   *
+ *           maintenance and items throttled because of unreachable hosts are *
+ *           requeued without returning them.                                 *
  *                                                                            *
  ******************************************************************************/
-int	DCconfig_get_poller_items(unsigned char poller_type, DC_ITEM **items)
+static ZBX_DC_ITEM	*dc_poller_queue_get_item(unsigned char poller_type, int now, const ZBX_DC_ITEM *dc_item_prev,
+		ZBX_DC_HOST **dc_host_out)
 {
-	int			now, num = 0, max_items;
-	zbx_binary_heap_t	*queue;
-
-	zabbix_log(LOG_LEVEL_DEBUG, "In %s() poller_type:%d", __func__, (int)poller_type);
-
-	now = time(NULL);
-
-	queue = &config->queues[poller_type];
-
-	switch (poller_type)
-	{
-		case ZBX_POLLER_TYPE_JAVA:
-			max_items = MAX_JAVA_ITEMS;
-			break;
-		case ZBX_POLLER_TYPE_PINGER:
-			max_items = MAX_PINGER_ITEMS;
-			break;
-		default:
-			max_items = 1;
-	}
-
-	WRLOCK_CACHE;
+	int			disable_until;
+	ZBX_DC_HOST		*dc_host;
+	ZBX_DC_INTERFACE	*dc_interface;
+	ZBX_DC_ITEM		*dc_item;
 
-	while (num < max_items && FAIL == zbx_binary_heap_empty(queue))
+	while (NULL != (dc_item = dc_poller_queue_pop(poller_type, now, dc_item_prev)))
 	{
-		int				disable_until;
-		const zbx_binary_heap_elem_t	*min;
-		ZBX_DC_HOST			*dc_host;
-		ZBX_DC_INTERFACE		*dc_interface;
-		ZBX_DC_ITEM			*dc_item;
-		static const ZBX_DC_ITEM	*dc_item_prev = NULL;
-
-		min = zbx_binary_heap_find_min(queue);
-		dc_item = (ZBX_DC_ITEM *)min->data;
-
-		if (dc_item->nextcheck > now)
-			break;
-
-		if (0 != num)
-		{
-			if (ITEM_TYPE_SNMP == dc_item_prev->type)
-			{
-				if (0 != __config_snmp_item_compare(dc_item_prev, dc_item))
-					break;
-			}
-			else if (ITEM_TYPE_JMX == dc_item_prev->type)
-			{
-				if (0 != __config_java_item_compare(dc_item_prev, dc_item))
-					break;
-			}
-		}
-
-		zbx_binary_heap_remove_min(queue);
-		dc_item->location = ZBX_LOC_NOWHERE;
-
 		if (NULL == (dc_host = (ZBX_DC_HOST *)zbx_hashset_search(&config->hosts, &dc_item->hostid)))
 			continue;
 
@@ -9558,7 +9968,8 @@ int	DCconfig_get_poller_items(unsigned char poller_type, DC_ITEM **items)
 				/* postpone checks on hosts that have been checked recently and */
 				/* are still unreachable                                        */
 				if (ZBX_POLLER_TYPE_NORMAL == poller_type || ZBX_POLLER_TYPE_JAVA == poller_type ||
-						disable_until > now)
+						ZBX_POLLER_TYPE_AGENT == poller_type || ZBX_POLLER_TYPE_SNMP == poller_type ||
+						ZBX_POLLER_TYPE_HTTPAGENT == poller_type || disable_until > now)
 				{
 					dc_requeue_item(dc_item, dc_host, dc_interface,
 							ZBX_ITEM_COLLECTED | ZBX_HOST_UNREACHABLE, now);
@@ -9569,6 +9980,75 @@ int	DCconfig_get_poller_items(unsigned char poller_type, DC_ITEM **items)
 			}
 		}
 
+		*dc_host_out = dc_host;
+		break;
+	}
+
+	return dc_item;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: DCconfig_get_poller_items                                        *
+ *                                                                            *
+ * Purpose: Get array of items for selected poller                            *
+ *                                                                            *
+ * Parameters: poller_type - [IN] poller type (ZBX_POLLER_TYPE_...)           *
+ *             items       - [OUT] array of items                             *
+ *                                                                            *
+ * Return value: number of items in items array                               *
+ *                                                                            *
+ * Author: Alexander Vladishev, Aleksandrs Saveljevs                          *
+ *                                                                            *
+ * Comments: Items leave the queue only through this function. Pollers must   *
+ *           always return the items they have taken using DCrequeue_items()  *
+ *           or DCpoller_requeue_items().                                     *
+ *                                                                            *
+ *           Currently batch polling is supported only for JMX, SNMP and      *
+ *           icmpping* simple checks. In other cases only single item is      *
+ *           retrieved.                                                       *
+ *                                                                            *
+ *           IPMI poller queue are handled by DCconfig_get_ipmi_poller_items()*
+ *           function.                                                        *
+ *                                                                            *
+ *           Configuration cache is only read locked, the poller queue is     *
+ *           locked while taking each item from it.                           *
+ *                                                                            *
+ ******************************************************************************/
+int	DCconfig_get_poller_items(unsigned char poller_type, DC_ITEM **items)
+{
+	int	now, num = 0, max_items;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() poller_type:%d", __func__, (int)poller_type);
+
+	now = time(NULL);
+
+	switch (poller_type)
+	{
+		case ZBX_POLLER_TYPE_JAVA:
+			max_items = MAX_JAVA_ITEMS;
+			break;
+		case ZBX_POLLER_TYPE_PINGER:
+			max_items = MAX_PINGER_ITEMS;
+			break;
+		default:
+			max_items = 1;
+	}
+
+	RDLOCK_CACHE;
+
+	while (num < max_items)
+	{
+		ZBX_DC_HOST			*dc_host;
+		ZBX_DC_ITEM			*dc_item;
+		static const ZBX_DC_ITEM	*dc_item_prev = NULL;
+
+		if (NULL == (dc_item = dc_poller_queue_get_item(poller_type, now, 0 != num ? dc_item_prev : NULL,
+				&dc_host)))
+		{
+			break;
+		}
+
 		if (0 == num)
 		{
 			if (ZBX_POLLER_TYPE_NORMAL == poller_type && ITEM_TYPE_SNMP == dc_item->type &&
@@ -9623,32 +10103,22 @@ int	DCconfig_get_poller_items(unsigned char poller_type, DC_ITEM **items)
  ******************************************************************************/
 int	DCconfig_get_ipmi_poller_items(int now, DC_ITEM *items, int items_num, int *nextcheck)
 {
-	int			num = 0;
-	zbx_binary_heap_t	*queue;
+	int	num = 0;
 
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
 
-	queue = &config->queues[ZBX_POLLER_TYPE_IPMI];
-
-	WRLOCK_CACHE;
+	RDLOCK_CACHE;
 
-	while (num < items_num && FAIL == zbx_binary_heap_empty(queue))
+	while (num < items_num)
 	{
-		int				disable_until;
-		const zbx_binary_heap_elem_t	*min;
-		ZBX_DC_HOST			*dc_host;
-		ZBX_DC_INTERFACE		*dc_interface;
-		ZBX_DC_ITEM			*dc_item;
+		int			disable_until;
+		ZBX_DC_HOST		*dc_host;
+		ZBX_DC_INTERFACE	*dc_interface;
+		ZBX_DC_ITEM		*dc_item;
 
-		min = zbx_binary_heap_find_min(queue);
-		dc_item = (ZBX_DC_ITEM *)min->data;
-
-		if (dc_item->nextcheck > now)
+		if (NULL == (dc_item = dc_poller_queue_pop(ZBX_POLLER_TYPE_IPMI, now, NULL)))
 			break;
 
-		zbx_binary_heap_remove_min(queue);
-		dc_item->location = ZBX_LOC_NOWHERE;
-
 		if (NULL == (dc_host = (ZBX_DC_HOST *)zbx_hashset_search(&config->hosts, &dc_item->hostid)))
 			continue;
 
@@ -9689,7 +10159,74 @@ int	DCconfig_get_ipmi_poller_items(int now, DC_ITEM *items, int items_num, int *
 		num++;
 	}
 
-	*nextcheck = dc_config_get_queue_nextcheck(&config->queues[ZBX_POLLER_TYPE_IPMI]);
+	*nextcheck = dc_config_get_queue_nextcheck(ZBX_POLLER_TYPE_IPMI);
+
+	UNLOCK_CACHE;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%d", __func__, num);
+
+	return num;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: DCconfig_get_async_poller_items                                  *
+ *                                                                            *
+ * Purpose: Get array of items for asynchronous poller                        *
+ *                                                                            *
+ * Parameters: poller_type - [IN] poller type (ZBX_POLLER_TYPE_...)           *
+ *             now         - [IN] current timestamp                           *
+ *             items       - [OUT] array of items                             *
+ *             items_num   - [IN] the number of items to get                  *
+ *             nextcheck   - [OUT] the next scheduled check                   *
+ *                                                                            *
+ * Return value: number of items in items array                               *
+ *                                                                            *
+ * Comments: Asynchronous pollers keep many checks in progress, so instead of *
+ *           fixed batch size they request as many items as they have free    *
+ *           check slots. The taken items must be returned using              *
+ *           DCpoller_requeue_items() as their checks finish.                 *
+ *                                                                            *
+ *           SNMP poller gets a single batch of items that can be queried     *
+ *           with one request, limited by the suggested number of variables   *
+ *           of the interface.                                                *
+ *                                                                            *
+ ******************************************************************************/
+int	DCconfig_get_async_poller_items(unsigned char poller_type, int now, DC_ITEM *items, int items_num,
+		int *nextcheck)
+{
+	int			num = 0;
+	ZBX_DC_HOST		*dc_host;
+	ZBX_DC_ITEM		*dc_item;
+	const ZBX_DC_ITEM	*dc_item_prev = NULL;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() poller_type:%d", __func__, (int)poller_type);
+
+	RDLOCK_CACHE;
+
+	while (num < items_num)
+	{
+		if (NULL == (dc_item = dc_poller_queue_get_item(poller_type, now, dc_item_prev, &dc_host)))
+			break;
+
+		if (ZBX_POLLER_TYPE_SNMP == poller_type)
+		{
+			if (0 == num)
+			{
+				items_num = MIN(items_num, DCconfig_get_suggested_snmp_vars_nolock(dc_item->interfaceid,
+						NULL));
+			}
+
+			dc_item_prev = dc_item;
+		}
+
+		dc_item->location = ZBX_LOC_POLLER;
+		DCget_host(&items[num].host, dc_host, ZBX_ITEM_GET_ALL);
+		DCget_item(&items[num], dc_item, ZBX_ITEM_GET_ALL);
+		num++;
+	}
+
+	*nextcheck = dc_config_get_queue_nextcheck(poller_type);
 
 	UNLOCK_CACHE;
 
@@ -9838,6 +10375,9 @@ static void	dc_requeue_items(const zbx_uint64_t *itemids, const int *lastclocks,
 
 		dc_interface = (ZBX_DC_INTERFACE *)zbx_hashset_search(&config->interfaces, &dc_item->interfaceid);
 
+		/* queue priority is used to order items in queue, so the item must be taken from queue first */
+		dc_poller_queue_take(dc_item);
+
 		switch (errcodes[i])
 		{
 			case SUCCEED:
@@ -9863,7 +10403,7 @@ static void	dc_requeue_items(const zbx_uint64_t *itemids, const int *lastclocks,
 void	DCrequeue_items(const zbx_uint64_t *itemids, const int *lastclocks,
 		const int *errcodes, size_t num)
 {
-	WRLOCK_CACHE;
+	RDLOCK_CACHE;
 
 	dc_requeue_items(itemids, lastclocks, errcodes, num);
 
@@ -9873,10 +10413,10 @@ void	DCrequeue_items(const zbx_uint64_t *itemids, const int *lastclocks,
 void	DCpoller_requeue_items(const zbx_uint64_t *itemids, const int *lastclocks,
 		const int *errcodes, size_t num, unsigned char poller_type, int *nextcheck)
 {
-	WRLOCK_CACHE;
+	RDLOCK_CACHE;
 
 	dc_requeue_items(itemids, lastclocks, errcodes, num);
-	*nextcheck = dc_config_get_queue_nextcheck(&config->queues[poller_type]);
+	*nextcheck = dc_config_get_queue_nextcheck(poller_type);
 
 	UNLOCK_CACHE;
 }
@@ -9904,7 +10444,7 @@ void	zbx_dc_requeue_unreachable_items(zbx_uint64_t *itemids, size_t itemids_num)
 	ZBX_DC_HOST		*dc_host;
 	ZBX_DC_INTERFACE	*dc_interface;
 
-	WRLOCK_CACHE;
+	RDLOCK_CACHE;
 
 	for (i = 0; i < itemids_num; i++)
 	{
@@ -10647,6 +11187,11 @@ void	*DCconfig_get_stats(int request)
 		case ZBX_CONFSTATS_BUFFER_PFREE:
 			value_double = 100 * (double)config_mem->free_size / config_mem->orig_size;
 			return &value_double;
+		case ZBX_CONFSTATS_BUFFER_PER_ITEM:
+			/* the used memory divided by the number of items, including host and trigger data */
+			value_uint = (0 != config->items.num_data ? (config_mem->orig_size - config_mem->free_size) /
+					(zbx_uint64_t)config->items.num_data : 0);
+			return &value_uint;
 		default:
 			return NULL;
 	}
@@ -10737,6 +11282,22 @@ void	DCconfig_wait_sync(void)
 		nanosleep(&ts, NULL);
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: DCconfig_snapshot_loaded                                         *
+ *                                                                            *
+ * Purpose: checks if configuration cache was initialized from snapshot and   *
+ *          must be synchronized with database without waiting               *
+ *                                                                            *
+ * Return value: SUCCEED - the configuration cache was loaded from snapshot   *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+int	DCconfig_snapshot_loaded(void)
+{
+	return zbx_dbsync_snapshot_loaded();
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: DCconfig_get_proxypoller_hosts                                   *
@@ -11063,24 +11624,318 @@ static void	dc_get_user_macro(const zbx_uint64_t *hostids, int hostids_num, cons
 	}
 }
 
+/* Process local user macro cache. Texts with user macros are compiled into templates of literal text and */
+/* parsed macro segments, which do not depend on configuration. Resolved macro values are cached by host   */
+/* and dropped when the configuration cache user macro revision changes.                                   */
+
+#define ZBX_UM_CACHE_TEMPLATES_MAX	10000
+#define ZBX_UM_CACHE_VALUES_MAX		100000
+
+typedef struct
+{
+	size_t	offset;		/* the segment offset in template text */
+	size_t	len;		/* the segment length */
+	char	*macro;		/* the user macro or NULL for literal text */
+	char	*name;
+	char	*context;
+}
+zbx_um_segment_t;
+
+typedef struct
+{
+	char			*text;
+	size_t			text_len;
+	zbx_um_segment_t	*segments;
+	int			segments_num;
+}
+zbx_um_template_t;
+
+typedef struct
+{
+	zbx_uint64_t	hostid;
+	char		*macro;
+	char		*value;		/* the resolved value or NULL if macro is not defined */
+	unsigned char	env;
+}
+zbx_um_value_t;
+
+static zbx_hashset_t	um_templates;
+static zbx_hashset_t	um_values;
+static zbx_uint64_t	um_values_revision;
+static int		um_cache_initialized = 0;
+
+static zbx_hash_t	um_template_hash(const void *data)
+{
+	const zbx_um_template_t	*template = (const zbx_um_template_t *)data;
+
+	return ZBX_DEFAULT_STRING_HASH_ALGO(template->text, template->text_len, ZBX_DEFAULT_HASH_SEED);
+}
+
+static int	um_template_compare(const void *d1, const void *d2)
+{
+	const zbx_um_template_t	*t1 = (const zbx_um_template_t *)d1;
+	const zbx_um_template_t	*t2 = (const zbx_um_template_t *)d2;
+
+	ZBX_RETURN_IF_NOT_EQUAL(t1->text_len, t2->text_len);
+
+	return memcmp(t1->text, t2->text, t1->text_len);
+}
+
+static void	um_template_clean(void *data)
+{
+	zbx_um_template_t	*template = (zbx_um_template_t *)data;
+	int			i;
+
+	for (i = 0; i < template->segments_num; i++)
+	{
+		zbx_free(template->segments[i].macro);
+		zbx_free(template->segments[i].name);
+		zbx_free(template->segments[i].context);
+	}
+
+	zbx_free(template->segments);
+	zbx_free(template->text);
+}
+
+static zbx_hash_t	um_value_hash(const void *data)
+{
+	const zbx_um_value_t	*value = (const zbx_um_value_t *)data;
+	zbx_hash_t		hash;
+
+	hash = ZBX_DEFAULT_UINT64_HASH_ALGO(&value->hostid, sizeof(value->hostid), ZBX_DEFAULT_HASH_SEED);
+	hash = ZBX_DEFAULT_STRING_HASH_ALGO(&value->env, sizeof(value->env), hash);
+
+	return ZBX_DEFAULT_STRING_HASH_ALGO(value->macro, strlen(value->macro), hash);
+}
+
+static int	um_value_compare(const void *d1, const void *d2)
+{
+	const zbx_um_value_t	*v1 = (const zbx_um_value_t *)d1;
+	const zbx_um_value_t	*v2 = (const zbx_um_value_t *)d2;
+
+	ZBX_RETURN_IF_NOT_EQUAL(v1->hostid, v2->hostid);
+	ZBX_RETURN_IF_NOT_EQUAL(v1->env, v2->env);
+
+	return strcmp(v1->macro, v2->macro);
+}
+
+static void	um_value_clean(void *data)
+{
+	zbx_um_value_t	*value = (zbx_um_value_t *)data;
+
+	zbx_free(value->value);
+	zbx_free(value->macro);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: um_cache_prepare                                                 *
+ *                                                                            *
+ * Purpose: initializes process user macro cache and drops resolved values    *
+ *          if user macro configuration has changed                           *
+ *                                                                            *
+ * Comments: The configuration cache must be locked.                          *
+ *                                                                            *
+ ******************************************************************************/
+static void	um_cache_prepare(void)
+{
+	if (0 == um_cache_initialized)
+	{
+		zbx_hashset_create_ext(&um_templates, 100, um_template_hash, um_template_compare, um_template_clean,
+				ZBX_DEFAULT_MEM_MALLOC_FUNC, ZBX_DEFAULT_MEM_REALLOC_FUNC, ZBX_DEFAULT_MEM_FREE_FUNC);
+		zbx_hashset_create_ext(&um_values, 100, um_value_hash, um_value_compare, um_value_clean,
+				ZBX_DEFAULT_MEM_MALLOC_FUNC, ZBX_DEFAULT_MEM_REALLOC_FUNC, ZBX_DEFAULT_MEM_FREE_FUNC);
+		um_values_revision = config->um_revision;
+		um_cache_initialized = 1;
+		return;
+	}
+
+	if (um_values_revision != config->um_revision || ZBX_UM_CACHE_VALUES_MAX < um_values.num_data)
+	{
+		zbx_hashset_clear(&um_values);
+		um_values_revision = config->um_revision;
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: um_cache_get_value                                               *
+ *                                                                            *
+ * Purpose: resolves user macro, using the cached value if possible           *
+ *                                                                            *
+ * Parameters: hostids     - [IN] an array of related hostids                 *
+ *             hostids_num - [IN] the number of hostids                       *
+ *             macro       - [IN] the user macro                              *
+ *             name        - [IN] the user macro name, optional               *
+ *             context     - [IN] the user macro context, optional            *
+ *                                                                            *
+ * Return value: the resolved value or NULL if macro is not defined or cannot *
+ *               be parsed                                                    *
+ *                                                                            *
+ * Comments: The configuration cache must be locked and um_cache_prepare()    *
+ *           called. The returned value is owned by cache unless the value    *
+ *           is not cached, in which case it is stored in *value_local and    *
+ *           must be freed by the caller.                                     *
+ *                                                                            *
+ *           Values are cached only for macros resolved for a single host or  *
+ *           globally.                                                        *
+ *                                                                            *
+ ******************************************************************************/
+static const char	*um_cache_get_value(const zbx_uint64_t *hostids, int hostids_num, const char *macro,
+		const char *name, const char *context, char **value_local)
+{
+	zbx_um_value_t	*value, value_local_entry;
+	char		*name_local = NULL, *context_local = NULL;
+
+	if (1 >= hostids_num)
+	{
+		value_local_entry.hostid = (0 == hostids_num ? 0 : hostids[0]);
+		value_local_entry.env = macro_env;
+		value_local_entry.macro = (char *)macro;
+
+		if (NULL != (value = (zbx_um_value_t *)zbx_hashset_search(&um_values, &value_local_entry)))
+			return value->value;
+	}
+
+	if (NULL == name)
+	{
+		if (SUCCEED != zbx_user_macro_parse_dyn(macro, &name_local, &context_local, NULL, NULL))
+			return NULL;
+
+		name = name_local;
+		context = context_local;
+	}
+
+	*value_local = NULL;
+	dc_get_user_macro(hostids, hostids_num, name, context, value_local);
+
+	zbx_free(context_local);
+	zbx_free(name_local);
+
+	if (1 < hostids_num)
+		return *value_local;
+
+	value_local_entry.macro = zbx_strdup(NULL, macro);
+	value_local_entry.value = *value_local;
+	*value_local = NULL;
+
+	value = (zbx_um_value_t *)zbx_hashset_insert(&um_values, &value_local_entry, sizeof(value_local_entry));
+
+	return value->value;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: um_cache_get_template                                            *
+ *                                                                            *
+ * Purpose: gets compiled template of the specified text                      *
+ *                                                                            *
+ * Parameters: text     - [IN] the text                                       *
+ *             text_len - [IN] the text length                                *
+ *                                                                            *
+ * Return value: the text template                                            *
+ *                                                                            *
+ ******************************************************************************/
+static const zbx_um_template_t	*um_cache_get_template(const char *text, size_t text_len)
+{
+	zbx_um_template_t	*template, template_local;
+	zbx_token_t		token;
+	size_t			pos = 0, last_pos = 0;
+	int			segments_alloc = 0;
+	char			*name = NULL, *context = NULL;
+
+	template_local.text = (char *)text;
+	template_local.text_len = text_len;
+
+	if (NULL != (template = (zbx_um_template_t *)zbx_hashset_search(&um_templates, &template_local)))
+		return template;
+
+	if (ZBX_UM_CACHE_TEMPLATES_MAX < um_templates.num_data)
+		zbx_hashset_clear(&um_templates);
+
+	template_local.segments = NULL;
+	template_local.segments_num = 0;
+
+	for (; SUCCEED == zbx_token_find(text, pos, &token, ZBX_TOKEN_SEARCH_BASIC) && token.loc.r < text_len; pos++)
+	{
+		zbx_um_segment_t	*segment;
+
+		if (ZBX_TOKEN_USER_MACRO != token.type)
+			continue;
+
+		if (SUCCEED != zbx_user_macro_parse_dyn(text + token.loc.l, &name, &context, NULL, NULL))
+			continue;
+
+		if (segments_alloc < template_local.segments_num + 2)
+		{
+			segments_alloc = (0 == segments_alloc ? 4 : segments_alloc * 2);
+			template_local.segments = (zbx_um_segment_t *)zbx_realloc(template_local.segments,
+					sizeof(zbx_um_segment_t) * segments_alloc);
+		}
+
+		if (last_pos < token.loc.l)
+		{
+			segment = &template_local.segments[template_local.segments_num++];
+			segment->offset = last_pos;
+			segment->len = token.loc.l - last_pos;
+			segment->macro = NULL;
+			segment->name = NULL;
+			segment->context = NULL;
+		}
+
+		segment = &template_local.segments[template_local.segments_num++];
+		segment->offset = token.loc.l;
+		segment->len = token.loc.r - token.loc.l + 1;
+		segment->macro = zbx_dsprintf(NULL, "%.*s", (int)segment->len, text + token.loc.l);
+		segment->name = name;
+		segment->context = context;
+		name = NULL;
+		context = NULL;
+
+		pos = token.loc.r;
+		last_pos = pos + 1;
+	}
+
+	if (last_pos < text_len)
+	{
+		zbx_um_segment_t	*segment;
+
+		template_local.segments = (zbx_um_segment_t *)zbx_realloc(template_local.segments,
+				sizeof(zbx_um_segment_t) * (template_local.segments_num + 1));
+
+		segment = &template_local.segments[template_local.segments_num++];
+		segment->offset = last_pos;
+		segment->len = text_len - last_pos;
+		segment->macro = NULL;
+		segment->name = NULL;
+		segment->context = NULL;
+	}
+
+	template_local.text = (char *)zbx_malloc(NULL, text_len + 1);
+	memcpy(template_local.text, text, text_len);
+	template_local.text[text_len] = '\0';
+
+	return (zbx_um_template_t *)zbx_hashset_insert(&um_templates, &template_local, sizeof(template_local));
+}
+
 void	DCget_user_macro(const zbx_uint64_t *hostids, int hostids_num, const char *macro, char **replace_to)
 {
-	char	*name = NULL, *context = NULL;
+	const char	*value;
+	char		*value_local = NULL;
 
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s() macro:'%s'", __func__, macro);
 
-	if (SUCCEED != zbx_user_macro_parse_dyn(macro, &name, &context, NULL, NULL))
-		goto out;
-
 	RDLOCK_CACHE;
 
-	dc_get_user_macro(hostids, hostids_num, name, context, replace_to);
+	um_cache_prepare();
+
+	if (NULL != (value = um_cache_get_value(hostids, hostids_num, macro, NULL, NULL, &value_local)))
+		*replace_to = zbx_strdup(*replace_to, value);
 
 	UNLOCK_CACHE;
 
-	zbx_free(context);
-	zbx_free(name);
-out:
+	zbx_free(value_local);
+
 	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
 }
 
@@ -11111,10 +11966,10 @@ out:
 int	dc_expand_user_macros_len(const char *text, size_t text_len, zbx_uint64_t *hostids, int hostids_num,
 		char **value, char **error)
 {
-	zbx_token_t	token;
-	int		len;
-	char		*str = NULL, *name = NULL, *context = NULL, *macro_value = NULL;
-	size_t		str_alloc = 0, str_offset = 0, pos = 0, last_pos = 0;
+	const zbx_um_template_t	*template;
+	int			i;
+	char			*str = NULL, *macro_value = NULL;
+	size_t			str_alloc = 0, str_offset = 0;
 
 	if ('\0' == *text)
 	{
@@ -11122,47 +11977,38 @@ int	dc_expand_user_macros_len(const char *text, size_t text_len, zbx_uint64_t *h
 		return SUCCEED;
 	}
 
-	for (; SUCCEED == zbx_token_find(text, pos, &token, ZBX_TOKEN_SEARCH_BASIC) && token.loc.r < text_len; pos++)
+	um_cache_prepare();
+	template = um_cache_get_template(text, text_len);
+
+	for (i = 0; i < template->segments_num; i++)
 	{
-		if (ZBX_TOKEN_USER_MACRO != token.type)
-			continue;
+		const zbx_um_segment_t	*segment = &template->segments[i];
+		const char		*resolved;
 
-		if (SUCCEED != zbx_user_macro_parse_dyn(text + token.loc.l, &name, &context, &len, NULL))
+		if (NULL == segment->macro)
+		{
+			zbx_strncpy_alloc(&str, &str_alloc, &str_offset, template->text + segment->offset, segment->len);
 			continue;
+		}
 
-		if (last_pos < token.loc.l)
-			zbx_strncpy_alloc(&str, &str_alloc, &str_offset, text + last_pos, token.loc.l - last_pos);
-
-		dc_get_user_macro(hostids, hostids_num, name, context, &macro_value);
-
-		zbx_free(name);
-		zbx_free(context);
-
-		if (NULL != macro_value)
+		if (NULL != (resolved = um_cache_get_value(hostids, hostids_num, segment->macro, segment->name,
+				segment->context, &macro_value)))
 		{
-			zbx_strcpy_alloc(&str, &str_alloc, &str_offset, macro_value);
+			zbx_strcpy_alloc(&str, &str_alloc, &str_offset, resolved);
 			zbx_free(macro_value);
+			continue;
 		}
-		else
+
+		if (NULL != error)
 		{
-			if (NULL != error)
-			{
-				*error = zbx_dsprintf(NULL, "unknown user macro \"%.*s\"",
-						(int)(token.loc.r - token.loc.l + 1), text + token.loc.l);
-				zbx_free(str);
-				return FAIL;
-			}
-			zbx_strncpy_alloc(&str, &str_alloc, &str_offset, text + token.loc.l,
-					token.loc.r - token.loc.l + 1);
+			*error = zbx_dsprintf(NULL, "unknown user macro \"%s\"", segment->macro);
+			zbx_free(str);
+			return FAIL;
 		}
 
-		pos = token.loc.r;
-		last_pos = pos + 1;
+		zbx_strncpy_alloc(&str, &str_alloc, &str_offset, segment->macro, segment->len);
 	}
 
-	if (last_pos < text_len)
-		zbx_strncpy_alloc(&str, &str_alloc, &str_offset, text + last_pos, text_len - last_pos);
-
 	*value = str;
 
 	return SUCCEED;
@@ -14184,4 +15030,5 @@ void	zbx_dc_eval_expand_user_macros(zbx_eval_context_t *ctx)
 #ifdef HAVE_TESTS
 #	include "../../../tests/libs/zbxdbcache/dc_item_poller_type_update_test.c"
 #	include "../../../tests/libs/zbxdbcache/dc_function_calculate_nextcheck_test.c"
+#	include "../../../tests/libs/zbxdbcache/dc_httpitem_params_test.c"
 #endif
@@ -85,35 +85,37 @@ ZBX_DC_FUNCTION;
 
 typedef struct
 {
+	/* the fields used by scheduling and item queue scans, kept together at the structure start */
 	zbx_uint64_t		itemid;
 	zbx_uint64_t		hostid;
 	zbx_uint64_t		interfaceid;
-	zbx_uint64_t		lastlogsize;
-	zbx_uint64_t		valuemapid;
 	const char		*key;
-	const char		*port;
-	const char		*error;
 	const char		*delay;
-	ZBX_DC_TRIGGER		**triggers;
 	int			nextcheck;
-	int			mtime;
 	int			data_expected_from;
-	int			history_sec;
-	unsigned char		history;
 	unsigned char		type;
 	unsigned char		value_type;
 	unsigned char		poller_type;
+	unsigned char		status;
 	unsigned char		state;
-	unsigned char		db_state;
-	unsigned char		inventory_link;
 	unsigned char		location;
 	unsigned char		flags;
-	unsigned char		status;
 	unsigned char		queue_priority;
 	unsigned char		schedulable;
+
+	unsigned char		db_state;
+	unsigned char		inventory_link;
+	unsigned char		history;
 	unsigned char		update_triggers;
+	int			mtime;
+	int			history_sec;
+	zbx_uint64_t		lastlogsize;
+	zbx_uint64_t		valuemapid;
 	zbx_uint64_t		templateid;
 	zbx_uint64_t		parent_itemid; /* from joined item_discovery table */
+	const char		*port;
+	const char		*error;
+	ZBX_DC_TRIGGER		**triggers;
 
 	zbx_vector_ptr_t	tags;
 }
@@ -260,9 +262,12 @@ typedef struct
 }
 ZBX_DC_PREPROCITEM;
 
+/* HTTP agent item parameters, shared by items with the same parameters (usually inherited from template). */
+/* The strings are interned in string pool, so parameters are hashed and compared by string pointers.    */
+/* Only HTTP agent parameters are shared - other type specific objects hold a few interned strings, so    */
+/* a shared record with hash slot and reference count would take about as much memory as it saves.       */
 typedef struct
 {
-	zbx_uint64_t	itemid;
 	const char	*timeout;
 	const char	*url;
 	const char	*query_fields;
@@ -285,6 +290,16 @@ typedef struct
 	unsigned char	verify_peer;
 	unsigned char	verify_host;
 	unsigned char	allow_traps;
+
+	/* the number of HTTP agent items using these parameters, not hashed */
+	zbx_uint32_t	refcount;
+}
+zbx_dc_httpitem_params_t;
+
+typedef struct
+{
+	zbx_uint64_t			itemid;
+	const zbx_dc_httpitem_params_t	*params;
 }
 ZBX_DC_HTTPITEM;
 
@@ -789,6 +804,8 @@ typedef struct
 	int			sync_ts;
 	int			item_sync_ts;
 	int			sync_start_ts;
+	zbx_uint64_t		um_revision;	/* incremented when user macros, template links or vault */
+						/* secrets change                                         */
 
 	unsigned int		internal_actions;		/* number of enabled internal actions */
 
@@ -819,6 +836,7 @@ typedef struct
 	zbx_hashset_t		masteritems;
 	zbx_hashset_t		preprocitems;
 	zbx_hashset_t		httpitems;
+	zbx_hashset_t		httpitem_params;
 	zbx_hashset_t		scriptitems;
 	zbx_hashset_t		functions;
 	zbx_hashset_t		triggers;
@@ -867,7 +885,7 @@ typedef struct
 							/* by PSK identity */
 #endif
 	zbx_hashset_t		data_sessions;
-	zbx_binary_heap_t	queues[ZBX_POLLER_TYPE_COUNT];
+	zbx_timer_wheel_t	queues[ZBX_POLLER_TYPE_COUNT];
 	zbx_binary_heap_t	pqueue;
 	zbx_binary_heap_t	trigger_queue;
 	ZBX_DC_CONFIG_TABLE	*config;
@@ -482,23 +482,25 @@ static void	DCdump_sshitem(const ZBX_DC_SSHITEM *sshitem)
 
 static void	DCdump_httpitem(const ZBX_DC_HTTPITEM *httpitem)
 {
-	zabbix_log(LOG_LEVEL_TRACE, "  http:[url:'%s']", httpitem->url);
-	zabbix_log(LOG_LEVEL_TRACE, "  http:[query fields:'%s']", httpitem->query_fields);
-	zabbix_log(LOG_LEVEL_TRACE, "  http:[headers:'%s']", httpitem->headers);
-	zabbix_log(LOG_LEVEL_TRACE, "  http:[posts:'%s']", httpitem->posts);
+	const zbx_dc_httpitem_params_t	*params = httpitem->params;
+
+	zabbix_log(LOG_LEVEL_TRACE, "  http:[url:'%s']", params->url);
+	zabbix_log(LOG_LEVEL_TRACE, "  http:[query fields:'%s']", params->query_fields);
+	zabbix_log(LOG_LEVEL_TRACE, "  http:[headers:'%s']", params->headers);
+	zabbix_log(LOG_LEVEL_TRACE, "  http:[posts:'%s']", params->posts);
 
 	zabbix_log(LOG_LEVEL_TRACE, "  http:[timeout:'%s' status codes:'%s' follow redirects:%u post type:%u"
 			" http proxy:'%s' retrieve mode:%u request method:%u output format:%u allow traps:%u"
 			" trapper_hosts:'%s']",
-			httpitem->timeout, httpitem->status_codes, httpitem->follow_redirects, httpitem->post_type,
-			httpitem->http_proxy, httpitem->retrieve_mode, httpitem->request_method,
-			httpitem->output_format, httpitem->allow_traps, httpitem->trapper_hosts);
+			params->timeout, params->status_codes, params->follow_redirects, params->post_type,
+			params->http_proxy, params->retrieve_mode, params->request_method,
+			params->output_format, params->allow_traps, params->trapper_hosts);
 
 	zabbix_log(LOG_LEVEL_TRACE, "  http:[username:'%s' password:'%s' authtype:%u]",
-			httpitem->username, httpitem->password, httpitem->authtype);
+			params->username, params->password, params->authtype);
 	zabbix_log(LOG_LEVEL_TRACE, "  http:[publickey:'%s' privatekey:'%s' ssl key password:'%s' verify peer:%u"
-			" verify host:%u]", httpitem->ssl_cert_file, httpitem->ssl_key_file, httpitem->ssl_key_password,
-			httpitem->verify_peer, httpitem->verify_host);
+			" verify host:%u]", params->ssl_cert_file, params->ssl_key_file, params->ssl_key_password,
+			params->verify_peer, params->verify_host);
 }
 
 static void	DCdump_scriptitem(const ZBX_DC_SCRIPTITEM *scriptitem)
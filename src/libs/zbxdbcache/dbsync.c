@@ -28,15 +28,111 @@
 #include "dbconfig.h"
 #include "dbsync.h"
 
+/* changelog object types, must match CHANGELOG object values in database schema */
+#define ZBX_DBSYNC_OBJ_HOST		1
+#define ZBX_DBSYNC_OBJ_ITEM		2
+
+/* changelog operations, must match the operations recorded by database triggers */
+#define ZBX_DBSYNC_OP_DELETE		3
+
+/* the period of full synchronization, when changelog is ignored and cleaned up */
+#define ZBX_DBSYNC_FULL_SYNC_PERIOD	SEC_PER_HOUR
+
+/* changelog identifiers skipped by the last processed record are read again while the gap is not expired, */
+/* records of transactions committed later than that are left for the next full synchronization          */
+#define ZBX_DBSYNC_CHANGELOG_GAP_TIMEOUT	(10 * SEC_PER_MIN)
+#define ZBX_DBSYNC_CHANGELOG_GAPS_MAX		1000
+
+#define ZBX_DBSYNC_SNAPSHOT_MAGIC	"ZBXCSNP"
+#define ZBX_DBSYNC_SNAPSHOT_VERSION	1
+
+/* configuration cache snapshot file header, followed by select result sections terminated by zero sql_len */
+/* section: zbx_uint32_t sql_len, sql, zbx_uint32_t fields, zbx_uint64_t data_size, serialized rows         */
 typedef struct
 {
-	zbx_hashset_t	strpool;
-	ZBX_DC_CONFIG	*cache;
+	char		magic[8];
+	zbx_uint32_t	version;
+	int		dbversion;	/* the mandatory database version */
+	int		saved;		/* the snapshot save time */
+	zbx_uint32_t	reserved;
+}
+zbx_dbsync_snapshot_t;
+
+typedef struct
+{
+	char	*sql;
+	char	*data;
+	size_t	data_size;
+	int	fields;
+}
+zbx_dbsync_snapshot_section_t;
+
+extern char	*CONFIG_CONFIG_CACHE_SNAPSHOT_FILE;
+
+/* the maximum number of select statements executed on separate database connections at once, */
+/* each executed statement buffers its whole result set in memory until it is synchronized     */
+#define ZBX_DBSYNC_PREFETCH_MAX		2
+
+/* the range of changelog identifiers not seen below the last processed record */
+typedef struct
+{
+	zbx_uint64_t	first;
+	zbx_uint64_t	last;
+	int		time;		/* the time the gap was found */
+}
+zbx_dbsync_changelog_gap_t;
+
+typedef struct
+{
+	zbx_hashset_t		strpool;
+	ZBX_DC_CONFIG		*cache;
+
+	/* SUCCEED - hosts and items are synchronized only for objects listed in changelog */
+	int			changelog;
+	zbx_vector_uint64_t	changelog_hostids;
+	zbx_vector_uint64_t	changelog_itemids;
+
+	/* the changelog records read for this synchronization, removed after it's done */
+	zbx_vector_uint64_t	changelogids;
+
+	/* the last changelog record covered by this synchronization */
+	zbx_uint64_t		changelog_lastid;
+
+	/* the changelog gaps after this synchronization, sorted by identifiers */
+	zbx_dbsync_changelog_gap_t	changelog_gaps[ZBX_DBSYNC_CHANGELOG_GAPS_MAX];
+	int				changelog_gaps_num;
+
+	/* the select statements executed in parallel on separate database connections, */
+	/* in the order their results are synchronized                                  */
+	zbx_vector_ptr_t	prefetch;
+
+	/* the select results loaded from configuration cache snapshot during initial synchronization */
+	zbx_vector_ptr_t	snapshot;
+
+	/* the temporary snapshot file written during full synchronization */
+	FILE			*snapshot_fp;
+	char			*snapshot_tmp;
 }
 zbx_dbsync_env_t;
 
+typedef struct
+{
+	char	*sql;
+	int	index;		/* the database prefetch index or FAIL if statement is not sent yet */
+}
+zbx_dbsync_prefetch_t;
+
 static zbx_dbsync_env_t	dbsync_env;
 
+/* the time of the last full synchronization, the last processed changelog record and the gaps below it */
+static int				dbsync_full_sync_time = 0;
+static zbx_uint64_t			dbsync_changelog_lastid = 0;
+static zbx_dbsync_changelog_gap_t	dbsync_changelog_gaps[ZBX_DBSYNC_CHANGELOG_GAPS_MAX];
+static int				dbsync_changelog_gaps_num = 0;
+
+/* SUCCEED - initial synchronization was done from configuration cache snapshot */
+static int	dbsync_snapshot_loaded = FAIL;
+
 /* string pool support */
 
 #define REFCOUNT_FIELD_SIZE	sizeof(zbx_uint32_t)
@@ -269,6 +365,465 @@ static char	**dbsync_preproc_row(zbx_dbsync_t *sync, char **row)
 	return sync->row;
 }
 
+static void	dbsync_prefetch_free(zbx_dbsync_prefetch_t *prefetch)
+{
+	zbx_free(prefetch->sql);
+	zbx_free(prefetch);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: dbsync_prefetch_send                                             *
+ *                                                                            *
+ * Purpose: starts execution of queued select statements while less than      *
+ *          ZBX_DBSYNC_PREFETCH_MAX statements are being executed             *
+ *                                                                            *
+ * Comments: If a statement cannot be sent, it and the rest of queued         *
+ *           statements are dropped and executed on the main database         *
+ *           connection when their results are synchronized.                  *
+ *                                                                            *
+ ******************************************************************************/
+static void	dbsync_prefetch_send(void)
+{
+	int			i, sent = 0;
+	zbx_dbsync_prefetch_t	*prefetch;
+
+	for (i = 0; i < dbsync_env.prefetch.values_num; i++)
+	{
+		prefetch = (zbx_dbsync_prefetch_t *)dbsync_env.prefetch.values[i];
+
+		if (FAIL == prefetch->index)
+		{
+			if (ZBX_DBSYNC_PREFETCH_MAX <= sent)
+				break;
+
+			if (FAIL == (prefetch->index = zbx_db_prefetch_send(prefetch->sql)))
+			{
+				while (i < dbsync_env.prefetch.values_num)
+				{
+					dbsync_prefetch_free((zbx_dbsync_prefetch_t *)
+							dbsync_env.prefetch.values[dbsync_env.prefetch.values_num - 1]);
+					zbx_vector_ptr_remove(&dbsync_env.prefetch, dbsync_env.prefetch.values_num - 1);
+				}
+
+				break;
+			}
+		}
+
+		sent++;
+	}
+}
+
+static void	dbsync_snapshot_section_free(zbx_dbsync_snapshot_section_t *section)
+{
+	zbx_free(section->sql);
+	zbx_free(section->data);
+	zbx_free(section);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: dbsync_snapshot_dbversion                                        *
+ *                                                                            *
+ * Purpose: gets mandatory database version to validate snapshot against     *
+ *                                                                            *
+ ******************************************************************************/
+static int	dbsync_snapshot_dbversion(void)
+{
+	DB_RESULT	result;
+	DB_ROW		row;
+	int		dbversion = -1;
+
+	if (NULL == (result = DBselect("select mandatory from dbversion")))
+		return -1;
+
+	if (NULL != (row = DBfetch(result)))
+		dbversion = atoi(row[0]);
+
+	DBfree_result(result);
+
+	return dbversion;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: dbsync_snapshot_header_init                                      *
+ *                                                                            *
+ * Purpose: initializes configuration cache snapshot file header              *
+ *                                                                            *
+ ******************************************************************************/
+static void	dbsync_snapshot_header_init(zbx_dbsync_snapshot_t *header, int dbversion, int saved)
+{
+	memset(header, 0, sizeof(zbx_dbsync_snapshot_t));
+	memcpy(header->magic, ZBX_DBSYNC_SNAPSHOT_MAGIC, sizeof(header->magic));
+	header->version = ZBX_DBSYNC_SNAPSHOT_VERSION;
+	header->dbversion = dbversion;
+	header->saved = saved;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: dbsync_snapshot_load                                             *
+ *                                                                            *
+ * Purpose: loads select results saved by the last full synchronization       *
+ *                                                                            *
+ * Return value: SUCCEED - the snapshot was loaded                            *
+ *               FAIL    - the snapshot does not exist or is not compatible   *
+ *                         with the database                                  *
+ *                                                                            *
+ ******************************************************************************/
+static int	dbsync_snapshot_load(void)
+{
+	FILE				*fp;
+	zbx_stat_t			st;
+	zbx_dbsync_snapshot_t		header, header_local;
+	zbx_dbsync_snapshot_section_t	*section;
+	zbx_uint32_t			sql_len, fields;
+	zbx_uint64_t			data_size, size = 0;
+	int				ret = FAIL;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+
+	if (NULL == (fp = fopen(CONFIG_CONFIG_CACHE_SNAPSHOT_FILE, "rb")))
+	{
+		if (ENOENT != errno)
+		{
+			zabbix_log(LOG_LEVEL_WARNING, "cannot open configuration cache snapshot file \"%s\": %s",
+					CONFIG_CONFIG_CACHE_SNAPSHOT_FILE, zbx_strerror(errno));
+		}
+
+		goto out;
+	}
+
+	if (0 != fstat(fileno(fp), &st))
+		goto corrupted;
+
+	/* snapshot contains host credentials, PSK and macro values */
+	if (0 != (st.st_mode & (S_IRWXG | S_IRWXO)))
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "ignoring configuration cache snapshot file \"%s\": the file must not be"
+				" accessible by group or others", CONFIG_CONFIG_CACHE_SNAPSHOT_FILE);
+		fclose(fp);
+		goto out;
+	}
+
+	if (1 != fread(&header, sizeof(header), 1, fp))
+		goto corrupted;
+
+	dbsync_snapshot_header_init(&header_local, dbsync_snapshot_dbversion(), header.saved);
+
+	if (0 != memcmp(&header, &header_local, sizeof(header)) || header.saved > (int)time(NULL))
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "discarding incompatible configuration cache snapshot file \"%s\"",
+				CONFIG_CONFIG_CACHE_SNAPSHOT_FILE);
+		goto clean;
+	}
+
+	while (1)
+	{
+		if (1 != fread(&sql_len, sizeof(sql_len), 1, fp))
+			goto corrupted;
+
+		if (0 == sql_len)
+			break;
+
+		if (sql_len > (zbx_uint64_t)st.st_size - size)
+			goto corrupted;
+
+		section = (zbx_dbsync_snapshot_section_t *)zbx_malloc(NULL, sizeof(zbx_dbsync_snapshot_section_t));
+		section->sql = (char *)zbx_malloc(NULL, (size_t)sql_len + 1);
+		section->data = NULL;
+		zbx_vector_ptr_append(&dbsync_env.snapshot, section);
+
+		if (1 != fread(section->sql, sql_len, 1, fp) || 1 != fread(&fields, sizeof(fields), 1, fp) ||
+				1 != fread(&data_size, sizeof(data_size), 1, fp) ||
+				data_size > (zbx_uint64_t)st.st_size - size)
+		{
+			goto corrupted;
+		}
+
+		section->sql[sql_len] = '\0';
+		section->fields = (int)fields;
+		section->data_size = (size_t)data_size;
+
+		if (0 != data_size)
+		{
+			section->data = (char *)zbx_malloc(NULL, (size_t)data_size);
+
+			if (1 != fread(section->data, (size_t)data_size, 1, fp))
+				goto corrupted;
+		}
+
+		size += sql_len + data_size;
+	}
+
+	zabbix_log(LOG_LEVEL_WARNING, "loaded %d select results from configuration cache snapshot saved at %s %s",
+			dbsync_env.snapshot.values_num, zbx_date2str(header.saved, NULL), zbx_time2str(header.saved, NULL));
+
+	ret = SUCCEED;
+	goto clean;
+corrupted:
+	zabbix_log(LOG_LEVEL_WARNING, "configuration cache snapshot file \"%s\" is corrupted",
+			CONFIG_CONFIG_CACHE_SNAPSHOT_FILE);
+clean:
+	fclose(fp);
+
+	if (SUCCEED != ret)
+	{
+		zbx_vector_ptr_clear_ext(&dbsync_env.snapshot, (zbx_clean_func_t)dbsync_snapshot_section_free);
+		unlink(CONFIG_CONFIG_CACHE_SNAPSHOT_FILE);
+	}
+out:
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%s", __func__, zbx_result_string(ret));
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: dbsync_snapshot_discard                                          *
+ *                                                                            *
+ * Purpose: removes unfinished temporary snapshot file                        *
+ *                                                                            *
+ ******************************************************************************/
+static void	dbsync_snapshot_discard(void)
+{
+	if (NULL == dbsync_env.snapshot_fp)
+		return;
+
+	fclose(dbsync_env.snapshot_fp);
+	dbsync_env.snapshot_fp = NULL;
+
+	unlink(dbsync_env.snapshot_tmp);
+	zbx_free(dbsync_env.snapshot_tmp);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: dbsync_snapshot_create                                           *
+ *                                                                            *
+ * Purpose: starts writing temporary snapshot file                            *
+ *                                                                            *
+ ******************************************************************************/
+static void	dbsync_snapshot_create(void)
+{
+	zbx_dbsync_snapshot_t	header;
+	int			dbversion, fd;
+
+	if (-1 == (dbversion = dbsync_snapshot_dbversion()))
+		return;
+
+	dbsync_env.snapshot_tmp = zbx_dsprintf(NULL, "%s.tmp", CONFIG_CONFIG_CACHE_SNAPSHOT_FILE);
+
+	/* remove file left by interrupted synchronization, new file is created only by this process */
+	unlink(dbsync_env.snapshot_tmp);
+
+	if (-1 == (fd = open(dbsync_env.snapshot_tmp, O_CREAT | O_EXCL | O_WRONLY, S_IRUSR | S_IWUSR)))
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "cannot create configuration cache snapshot file \"%s\": %s",
+				dbsync_env.snapshot_tmp, zbx_strerror(errno));
+		zbx_free(dbsync_env.snapshot_tmp);
+		return;
+	}
+
+	if (NULL == (dbsync_env.snapshot_fp = fdopen(fd, "wb")))
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "cannot open configuration cache snapshot file \"%s\": %s",
+				dbsync_env.snapshot_tmp, zbx_strerror(errno));
+		close(fd);
+		unlink(dbsync_env.snapshot_tmp);
+		zbx_free(dbsync_env.snapshot_tmp);
+		return;
+	}
+
+	dbsync_snapshot_header_init(&header, dbversion, (int)time(NULL));
+
+	if (1 != fwrite(&header, sizeof(header), 1, dbsync_env.snapshot_fp))
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "cannot write configuration cache snapshot file \"%s\": %s",
+				dbsync_env.snapshot_tmp, zbx_strerror(errno));
+		dbsync_snapshot_discard();
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: dbsync_snapshot_record                                           *
+ *                                                                            *
+ * Purpose: writes select result into temporary snapshot file                 *
+ *                                                                            *
+ * Parameters: sql    - [IN] the select statement                             *
+ *             result - [IN] the select result, freed by this function        *
+ *                                                                            *
+ * Return value: the result restored from written rows                        *
+ *                                                                            *
+ ******************************************************************************/
+static DB_RESULT	dbsync_snapshot_record(const char *sql, DB_RESULT result)
+{
+	DB_ROW		row;
+	char		*data = NULL;
+	size_t		data_alloc = 0, data_offset = 0;
+	int		fields;
+	zbx_uint32_t	sql_len, fields_ui32;
+	zbx_uint64_t	data_size;
+
+	fields = zbx_db_result_fields(result);
+
+	while (NULL != (row = DBfetch(result)))
+		zbx_db_row_serialize(&data, &data_alloc, &data_offset, row, fields);
+
+	DBfree_result(result);
+
+	sql_len = (zbx_uint32_t)strlen(sql);
+	fields_ui32 = (zbx_uint32_t)fields;
+	data_size = (zbx_uint64_t)data_offset;
+
+	if (1 != fwrite(&sql_len, sizeof(sql_len), 1, dbsync_env.snapshot_fp) ||
+			1 != fwrite(sql, sql_len, 1, dbsync_env.snapshot_fp) ||
+			1 != fwrite(&fields_ui32, sizeof(fields_ui32), 1, dbsync_env.snapshot_fp) ||
+			1 != fwrite(&data_size, sizeof(data_size), 1, dbsync_env.snapshot_fp) ||
+			(0 != data_offset && 1 != fwrite(data, data_offset, 1, dbsync_env.snapshot_fp)))
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "cannot write configuration cache snapshot file \"%s\": %s",
+				dbsync_env.snapshot_tmp, zbx_strerror(errno));
+		dbsync_snapshot_discard();
+	}
+
+	return zbx_db_result_from_blob(data, data_offset, fields);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: dbsync_select                                                    *
+ *                                                                            *
+ * Purpose: executes select statement or takes its loaded or prefetched       *
+ *          result                                                            *
+ *                                                                            *
+ * Parameters: fmt - [IN] the select statement format                         *
+ *                                                                            *
+ * Return value: the select statement result or NULL on error                 *
+ *                                                                            *
+ * Comments: During initial synchronization the results are taken from        *
+ *           configuration cache snapshot, if available. If prefetching       *
+ *           failed the statement is executed on the main database            *
+ *           connection. Taking prefetched result starts execution of the     *
+ *           next queued statement. During full synchronization the results   *
+ *           are also written into new snapshot file.                         *
+ *                                                                            *
+ ******************************************************************************/
+static DB_RESULT	dbsync_select(const char *fmt, ...)
+{
+	int				i;
+	zbx_dbsync_prefetch_t		*prefetch;
+	zbx_dbsync_snapshot_section_t	*section;
+	DB_RESULT			result = NULL;
+	va_list				args;
+	char				*sql;
+
+	va_start(args, fmt);
+	sql = zbx_dvsprintf(NULL, fmt, args);
+	va_end(args);
+
+	for (i = 0; i < dbsync_env.snapshot.values_num; i++)
+	{
+		section = (zbx_dbsync_snapshot_section_t *)dbsync_env.snapshot.values[i];
+
+		if (0 != strcmp(section->sql, sql))
+			continue;
+
+		result = zbx_db_result_from_blob(section->data, section->data_size, section->fields);
+		section->data = NULL;
+
+		zbx_vector_ptr_remove_noorder(&dbsync_env.snapshot, i);
+		dbsync_snapshot_section_free(section);
+		goto out;
+	}
+
+	for (i = 0; i < dbsync_env.prefetch.values_num; i++)
+	{
+		prefetch = (zbx_dbsync_prefetch_t *)dbsync_env.prefetch.values[i];
+
+		if (0 != strcmp(prefetch->sql, sql))
+			continue;
+
+		if (FAIL != prefetch->index)
+			result = zbx_db_prefetch_result(prefetch->index);
+
+		zbx_vector_ptr_remove(&dbsync_env.prefetch, i);
+		dbsync_prefetch_free(prefetch);
+		dbsync_prefetch_send();
+		break;
+	}
+
+	if (NULL == result)
+		result = DBselect("%s", sql);
+
+	if (NULL != result && NULL != dbsync_env.snapshot_fp)
+		result = dbsync_snapshot_record(sql, result);
+out:
+	zbx_free(sql);
+
+	return result;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_dbsync_env_save_snapshot                                     *
+ *                                                                            *
+ * Purpose: replaces configuration cache snapshot with the select results     *
+ *          written during the current synchronization                        *
+ *                                                                            *
+ * Comments: Must be called only after successful synchronization, otherwise  *
+ *           the temporary snapshot file is removed when environment is freed.*
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_dbsync_env_save_snapshot(void)
+{
+	zbx_uint32_t	sql_len = 0;
+	FILE		*fp;
+
+	if (NULL == (fp = dbsync_env.snapshot_fp))
+		return;
+
+	dbsync_env.snapshot_fp = NULL;
+
+	if (1 != fwrite(&sql_len, sizeof(sql_len), 1, fp) || 0 != fflush(fp) || 0 != fsync(fileno(fp)) ||
+			0 != fclose(fp))
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "cannot write configuration cache snapshot file \"%s\": %s",
+				dbsync_env.snapshot_tmp, zbx_strerror(errno));
+		goto out;
+	}
+
+	if (0 != rename(dbsync_env.snapshot_tmp, CONFIG_CONFIG_CACHE_SNAPSHOT_FILE))
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "cannot rename configuration cache snapshot file \"%s\" to \"%s\": %s",
+				dbsync_env.snapshot_tmp, CONFIG_CONFIG_CACHE_SNAPSHOT_FILE, zbx_strerror(errno));
+		goto out;
+	}
+
+	zabbix_log(LOG_LEVEL_DEBUG, "saved configuration cache snapshot");
+	zbx_free(dbsync_env.snapshot_tmp);
+
+	return;
+out:
+	unlink(dbsync_env.snapshot_tmp);
+	zbx_free(dbsync_env.snapshot_tmp);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_dbsync_snapshot_loaded                                       *
+ *                                                                            *
+ * Purpose: checks if initial synchronization was done from configuration     *
+ *          cache snapshot and must be followed by full synchronization       *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_dbsync_snapshot_loaded(void)
+{
+	return dbsync_snapshot_loaded;
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: zbx_dbsync_init_env                                              *
@@ -278,6 +833,304 @@ void	zbx_dbsync_init_env(ZBX_DC_CONFIG *cache)
 {
 	dbsync_env.cache = cache;
 	zbx_hashset_create(&dbsync_env.strpool, 100, dbsync_strpool_hash_func, dbsync_strpool_compare_func);
+
+	dbsync_env.changelog = FAIL;
+	zbx_vector_uint64_create(&dbsync_env.changelog_hostids);
+	zbx_vector_uint64_create(&dbsync_env.changelog_itemids);
+	zbx_vector_uint64_create(&dbsync_env.changelogids);
+	dbsync_env.changelog_lastid = dbsync_changelog_lastid;
+	memcpy(dbsync_env.changelog_gaps, dbsync_changelog_gaps,
+			sizeof(zbx_dbsync_changelog_gap_t) * (size_t)dbsync_changelog_gaps_num);
+	dbsync_env.changelog_gaps_num = dbsync_changelog_gaps_num;
+	zbx_vector_ptr_create(&dbsync_env.prefetch);
+	zbx_vector_ptr_create(&dbsync_env.snapshot);
+	dbsync_env.snapshot_fp = NULL;
+	dbsync_env.snapshot_tmp = NULL;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: dbsync_changelog_gaps_expire                                     *
+ *                                                                            *
+ * Purpose: stops reading changelog gaps found earlier than gap timeout       *
+ *                                                                            *
+ ******************************************************************************/
+static void	dbsync_changelog_gaps_expire(int now)
+{
+	int	i;
+
+	for (i = 0; i < dbsync_env.changelog_gaps_num; i++)
+	{
+		if (now - dbsync_env.changelog_gaps[i].time < ZBX_DBSYNC_CHANGELOG_GAP_TIMEOUT)
+			break;
+	}
+
+	if (0 == i)
+		return;
+
+	dbsync_env.changelog_gaps_num -= i;
+	memmove(dbsync_env.changelog_gaps, dbsync_env.changelog_gaps + i,
+			sizeof(zbx_dbsync_changelog_gap_t) * (size_t)dbsync_env.changelog_gaps_num);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: dbsync_changelog_gap_add                                         *
+ *                                                                            *
+ * Purpose: remembers changelog identifiers skipped by the last processed     *
+ *          record                                                            *
+ *                                                                            *
+ * Comments: Gaps are found in the order of identifiers, so the oldest gap    *
+ *           is dropped when there are too many of them.                      *
+ *                                                                            *
+ ******************************************************************************/
+static void	dbsync_changelog_gap_add(zbx_uint64_t first, zbx_uint64_t last, int now)
+{
+	zbx_dbsync_changelog_gap_t	*gap;
+
+	if (ZBX_DBSYNC_CHANGELOG_GAPS_MAX == dbsync_env.changelog_gaps_num)
+	{
+		zabbix_log(LOG_LEVEL_DEBUG, "too many changelog gaps, dropping gap " ZBX_FS_UI64 "-" ZBX_FS_UI64,
+				dbsync_env.changelog_gaps[0].first, dbsync_env.changelog_gaps[0].last);
+
+		dbsync_env.changelog_gaps_num--;
+		memmove(dbsync_env.changelog_gaps, dbsync_env.changelog_gaps + 1,
+				sizeof(zbx_dbsync_changelog_gap_t) * (size_t)dbsync_env.changelog_gaps_num);
+	}
+
+	gap = &dbsync_env.changelog_gaps[dbsync_env.changelog_gaps_num++];
+	gap->first = first;
+	gap->last = last;
+	gap->time = now;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: dbsync_changelog_gap_search                                      *
+ *                                                                            *
+ * Purpose: checks if changelog identifier is in one of the gaps              *
+ *                                                                            *
+ * Return value: SUCCEED - the identifier is in a gap                         *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+static int	dbsync_changelog_gap_search(zbx_uint64_t changelogid)
+{
+	int	lo = 0, hi = dbsync_env.changelog_gaps_num - 1, mid;
+
+	while (lo <= hi)
+	{
+		mid = (lo + hi) / 2;
+
+		if (changelogid < dbsync_env.changelog_gaps[mid].first)
+			hi = mid - 1;
+		else if (changelogid > dbsync_env.changelog_gaps[mid].last)
+			lo = mid + 1;
+		else
+			return SUCCEED;
+	}
+
+	return FAIL;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: dbsync_changelog_read                                            *
+ *                                                                            *
+ * Purpose: reads changelog records following the last processed record and  *
+ *          the records in gaps below it                                      *
+ *                                                                            *
+ * Parameters: full_sync - [IN] SUCCEED - read all records for removal        *
+ *                              FAIL    - read changed hosts and items        *
+ *             now       - [IN] the current time                              *
+ *                                                                            *
+ * Return value: SUCCEED - hosts and items can be synchronized by changelog   *
+ *               FAIL    - changelog cannot be read or does not list all      *
+ *                         changed objects                                    *
+ *                                                                            *
+ * Comments: Changelog identifiers are assigned when records are inserted,    *
+ *           while transactions can commit in different order. Identifiers    *
+ *           skipped by the last processed record are remembered as gaps and  *
+ *           read again until they expire, so records of transactions         *
+ *           committed later are not lost.                                    *
+ *           Records below the last processed record outside gaps are either  *
+ *           processed records that failed to be removed or late records of   *
+ *           expired gaps. Both are read and removed only by full             *
+ *           synchronization, which compares all hosts and items.             *
+ *                                                                            *
+ ******************************************************************************/
+static int	dbsync_changelog_read(int full_sync, int now)
+{
+	DB_RESULT	result;
+	DB_ROW		row;
+	zbx_uint64_t	objectid, changelogid, fromid;
+	int		ret = SUCCEED;
+
+	if (SUCCEED == full_sync)
+		fromid = 0;
+	else if (0 != dbsync_env.changelog_gaps_num)
+		fromid = dbsync_env.changelog_gaps[0].first - 1;
+	else
+		fromid = dbsync_env.changelog_lastid;
+
+	if (NULL == (result = DBselect("select changelogid,object,objectid,operation from changelog"
+			" where changelogid>" ZBX_FS_UI64
+			" order by changelogid",
+			fromid)))
+	{
+		return FAIL;
+	}
+
+	while (NULL != (row = DBfetch(result)))
+	{
+		ZBX_STR2UINT64(changelogid, row[0]);
+
+		if (changelogid <= dbsync_env.changelog_lastid)
+		{
+			if (SUCCEED != full_sync && SUCCEED != dbsync_changelog_gap_search(changelogid))
+				continue;
+		}
+		else
+		{
+			if (changelogid > dbsync_env.changelog_lastid + 1)
+				dbsync_changelog_gap_add(dbsync_env.changelog_lastid + 1, changelogid - 1, now);
+
+			dbsync_env.changelog_lastid = changelogid;
+		}
+
+		zbx_vector_uint64_append(&dbsync_env.changelogids, changelogid);
+
+		if (SUCCEED == full_sync)
+			continue;
+#if defined(HAVE_MYSQL)
+		/* MySQL does not fire triggers for rows removed by foreign key cascade, so items removed */
+		/* together with their host, template item or master item are missing from changelog     */
+		if (ZBX_DBSYNC_OP_DELETE == atoi(row[3]))
+			ret = FAIL;
+#endif
+		ZBX_STR2UINT64(objectid, row[2]);
+
+		switch (atoi(row[1]))
+		{
+			case ZBX_DBSYNC_OBJ_HOST:
+				zbx_vector_uint64_append(&dbsync_env.changelog_hostids, objectid);
+				break;
+			case ZBX_DBSYNC_OBJ_ITEM:
+				zbx_vector_uint64_append(&dbsync_env.changelog_itemids, objectid);
+				break;
+		}
+	}
+	DBfree_result(result);
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_dbsync_env_prepare                                           *
+ *                                                                            *
+ * Purpose: reads changelog to find hosts and items changed since the last    *
+ *          synchronization                                                   *
+ *                                                                            *
+ * Parameter: mode - [IN] the synchronization mode (see ZBX_DBSYNC_* defines) *
+ *                                                                            *
+ * Comments: Initial synchronization and periodic full synchronization        *
+ *           compare all hosts and items with database and remove all         *
+ *           changelog records read before that. Otherwise only hosts and     *
+ *           items listed in changelog records following the last processed   *
+ *           record or in gaps below it are selected from database.           *
+ *           Records are removed and the last processed record is updated by  *
+ *           zbx_dbsync_env_flush_changelog() after synchronization, so       *
+ *           records of failed synchronization are read again.                *
+ *           If configuration cache snapshot is enabled, initial              *
+ *           synchronization takes select results from the snapshot and the   *
+ *           next synchronization is forced to be full, while full            *
+ *           synchronizations write new snapshot.                             *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_dbsync_env_prepare(unsigned char mode)
+{
+	int	now;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+
+	now = (int)time(NULL);
+	dbsync_changelog_gaps_expire(now);
+
+	if (ZBX_DBSYNC_UPDATE != mode || now - dbsync_full_sync_time >= ZBX_DBSYNC_FULL_SYNC_PERIOD)
+	{
+		/* the records are read before hosts and items are selected, so their changes are covered */
+		dbsync_changelog_read(SUCCEED, now);
+
+		if (NULL != CONFIG_CONFIG_CACHE_SNAPSHOT_FILE)
+		{
+			if (ZBX_DBSYNC_INIT == mode && SUCCEED == (dbsync_snapshot_loaded = dbsync_snapshot_load()))
+				goto out;
+
+			dbsync_snapshot_create();
+		}
+
+		dbsync_full_sync_time = now;
+		goto out;
+	}
+
+	/* deleted objects can have removed dependent objects not recorded in changelog, compare all of them */
+	if (SUCCEED == dbsync_changelog_read(FAIL, now))
+		dbsync_env.changelog = SUCCEED;
+
+	zbx_vector_uint64_sort(&dbsync_env.changelog_hostids, ZBX_DEFAULT_UINT64_COMPARE_FUNC);
+	zbx_vector_uint64_uniq(&dbsync_env.changelog_hostids, ZBX_DEFAULT_UINT64_COMPARE_FUNC);
+	zbx_vector_uint64_sort(&dbsync_env.changelog_itemids, ZBX_DEFAULT_UINT64_COMPARE_FUNC);
+	zbx_vector_uint64_uniq(&dbsync_env.changelog_itemids, ZBX_DEFAULT_UINT64_COMPARE_FUNC);
+out:
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s() changelog:%s hosts:%d items:%d lastid:" ZBX_FS_UI64 " gaps:%d",
+			__func__, zbx_result_string(dbsync_env.changelog), dbsync_env.changelog_hostids.values_num,
+			dbsync_env.changelog_itemids.values_num, dbsync_env.changelog_lastid,
+			dbsync_env.changelog_gaps_num);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_dbsync_env_flush_changelog                                   *
+ *                                                                            *
+ * Purpose: removes changelog records processed by synchronization            *
+ *                                                                            *
+ * Comments: Must be called after the configuration cache is updated. Only    *
+ *           the records read by this synchronization are removed, so         *
+ *           records of transactions not committed yet are never removed,     *
+ *           also by full synchronization.                                    *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_dbsync_env_flush_changelog(void)
+{
+	if (0 != dbsync_env.changelogids.values_num && SUCCEED != DBexecute_multiple_query(
+			"delete from changelog where", "changelogid", &dbsync_env.changelogids))
+	{
+		zabbix_log(LOG_LEVEL_DEBUG, "cannot remove processed changelog records");
+		return;
+	}
+
+	dbsync_changelog_lastid = dbsync_env.changelog_lastid;
+	memcpy(dbsync_changelog_gaps, dbsync_env.changelog_gaps,
+			sizeof(zbx_dbsync_changelog_gap_t) * (size_t)dbsync_env.changelog_gaps_num);
+	dbsync_changelog_gaps_num = dbsync_env.changelog_gaps_num;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_dbsync_env_reset_changelog                                   *
+ *                                                                            *
+ * Purpose: disables changelog based synchronization for the current         *
+ *          synchronization                                                   *
+ *                                                                            *
+ * Comments: Must be called before hosts and items are compared if changes   *
+ *           not tracked by changelog (for example user macros used in item   *
+ *           fields) can affect them.                                         *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_dbsync_env_reset_changelog(void)
+{
+	dbsync_env.changelog = FAIL;
 }
 
 /******************************************************************************
@@ -287,6 +1140,21 @@ void	zbx_dbsync_init_env(ZBX_DC_CONFIG *cache)
  ******************************************************************************/
 void	zbx_dbsync_free_env(void)
 {
+	int	i;
+
+	for (i = 0; i < dbsync_env.prefetch.values_num; i++)
+		dbsync_prefetch_free((zbx_dbsync_prefetch_t *)dbsync_env.prefetch.values[i]);
+
+	zbx_vector_ptr_destroy(&dbsync_env.prefetch);
+	zbx_db_prefetch_close();
+
+	zbx_vector_ptr_clear_ext(&dbsync_env.snapshot, (zbx_clean_func_t)dbsync_snapshot_section_free);
+	zbx_vector_ptr_destroy(&dbsync_env.snapshot);
+	dbsync_snapshot_discard();
+
+	zbx_vector_uint64_destroy(&dbsync_env.changelogids);
+	zbx_vector_uint64_destroy(&dbsync_env.changelog_itemids);
+	zbx_vector_uint64_destroy(&dbsync_env.changelog_hostids);
 	zbx_hashset_destroy(&dbsync_env.strpool);
 }
 
@@ -511,7 +1379,7 @@ int	zbx_dbsync_compare_config(zbx_dbsync_t *sync)
 
 #define SELECTED_CONFIG_FIELD_COUNT	33	/* number of columns in the following DBselect() */
 
-	if (NULL == (result = DBselect("select discovery_groupid,snmptrap_logging,"
+	if (NULL == (result = dbsync_select("select discovery_groupid,snmptrap_logging,"
 				"severity_name_0,severity_name_1,severity_name_2,"
 				"severity_name_3,severity_name_4,severity_name_5,"
 				"hk_events_mode,hk_events_trigger,hk_events_internal,"
@@ -573,7 +1441,7 @@ int	zbx_dbsync_compare_autoreg_psk(zbx_dbsync_t *sync)
 
 #define CONFIG_AUTOREG_TLS_FIELD_COUNT	2	/* number of columns in the following DBselect() */
 
-	if (NULL == (result = DBselect("select tls_psk_identity,tls_psk"
+	if (NULL == (result = dbsync_select("select tls_psk_identity,tls_psk"
 			" from config_autoreg_tls"
 			" order by autoreg_tlsid")))	/* if you change number of columns in DBselect(), */
 							/* adjust CONFIG_AUTOREG_TLS_FIELD_COUNT */
@@ -756,9 +1624,14 @@ int	zbx_dbsync_compare_hosts(zbx_dbsync_t *sync)
 	zbx_hashset_iter_t	iter;
 	zbx_uint64_t		rowid;
 	ZBX_DC_HOST		*host;
+	char			*sql = NULL;
+	size_t			sql_alloc = 0, sql_offset = 0;
+	int			i, changelog;
+
+	changelog = (ZBX_DBSYNC_UPDATE == sync->mode ? dbsync_env.changelog : FAIL);
 
 #if defined(HAVE_GNUTLS) || defined(HAVE_OPENSSL)
-	if (NULL == (result = DBselect(
+	zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset,
 			"select hostid,proxy_hostid,host,ipmi_authtype,ipmi_privilege,ipmi_username,"
 				"ipmi_password,maintenance_status,maintenance_type,maintenance_from,"
 				"status,name,lastaccess,tls_connect,tls_accept,tls_issuer,tls_subject,"
@@ -766,16 +1639,13 @@ int	zbx_dbsync_compare_hosts(zbx_dbsync_t *sync)
 			" from hosts"
 			" where status in (%d,%d,%d,%d)"
 				" and flags<>%d",
-			HOST_STATUS_MONITORED, HOST_STATUS_NOT_MONITORED,
-			HOST_STATUS_PROXY_ACTIVE, HOST_STATUS_PROXY_PASSIVE,
-			ZBX_FLAG_DISCOVERY_PROTOTYPE)))
-	{
-		return FAIL;
-	}
+			HOST_STATUS_MONITORED, HOST_STATUS_NOT_MONITORED,
+			HOST_STATUS_PROXY_ACTIVE, HOST_STATUS_PROXY_PASSIVE,
+			ZBX_FLAG_DISCOVERY_PROTOTYPE);
 
 	dbsync_prepare(sync, 22, NULL);
 #else
-	if (NULL == (result = DBselect(
+	zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset,
 			"select hostid,proxy_hostid,host,ipmi_authtype,ipmi_privilege,ipmi_username,"
 				"ipmi_password,maintenance_status,maintenance_type,maintenance_from,"
 				"status,name,lastaccess,tls_connect,tls_accept,"
@@ -785,21 +1655,39 @@ int	zbx_dbsync_compare_hosts(zbx_dbsync_t *sync)
 				" and flags<>%d",
 			HOST_STATUS_MONITORED, HOST_STATUS_NOT_MONITORED,
 			HOST_STATUS_PROXY_ACTIVE, HOST_STATUS_PROXY_PASSIVE,
-			ZBX_FLAG_DISCOVERY_PROTOTYPE)))
-	{
-		return FAIL;
-	}
+			ZBX_FLAG_DISCOVERY_PROTOTYPE);
 
 	dbsync_prepare(sync, 18, NULL);
 #endif
 
+	if (SUCCEED == changelog)
+	{
+		/* nothing changed since the last synchronization */
+		if (0 == dbsync_env.changelog_hostids.values_num)
+		{
+			zbx_free(sql);
+			return SUCCEED;
+		}
+
+		zbx_strcpy_alloc(&sql, &sql_alloc, &sql_offset, " and");
+		DBadd_condition_alloc(&sql, &sql_alloc, &sql_offset, "hostid", dbsync_env.changelog_hostids.values,
+				dbsync_env.changelog_hostids.values_num);
+	}
+
+	result = dbsync_select("%s", sql);
+	zbx_free(sql);
+
+	if (NULL == result)
+		return FAIL;
+
 	if (ZBX_DBSYNC_INIT == sync->mode)
 	{
 		sync->dbresult = result;
 		return SUCCEED;
 	}
 
-	zbx_hashset_create(&ids, dbsync_env.cache->hosts.num_data, ZBX_DEFAULT_UINT64_HASH_FUNC,
+	zbx_hashset_create(&ids, (SUCCEED == changelog ? (size_t)dbsync_env.changelog_hostids.values_num :
+			dbsync_env.cache->hosts.num_data), ZBX_DEFAULT_UINT64_HASH_FUNC,
 			ZBX_DEFAULT_UINT64_COMPARE_FUNC);
 
 	while (NULL != (dbrow = DBfetch(result)))
@@ -818,13 +1706,30 @@ int	zbx_dbsync_compare_hosts(zbx_dbsync_t *sync)
 			dbsync_add_row(sync, rowid, tag, dbrow);
 	}
 
+	if (SUCCEED == changelog)
+	{
+		/* only changed hosts can be removed */
+		for (i = 0; i < dbsync_env.changelog_hostids.values_num; i++)
+		{
+			rowid = dbsync_env.changelog_hostids.values[i];
+
+			if (NULL != zbx_hashset_search(&dbsync_env.cache->hosts, &rowid) &&
+					NULL == zbx_hashset_search(&ids, &rowid))
+			{
+				dbsync_add_row(sync, rowid, ZBX_DBSYNC_ROW_REMOVE, NULL);
+			}
+		}
+
+		goto out;
+	}
+
 	zbx_hashset_iter_reset(&dbsync_env.cache->hosts, &iter);
 	while (NULL != (host = (ZBX_DC_HOST *)zbx_hashset_iter_next(&iter)))
 	{
 		if (NULL == zbx_hashset_search(&ids, &host->hostid))
 			dbsync_add_row(sync, host->hostid, ZBX_DBSYNC_ROW_REMOVE, NULL);
 	}
-
+out:
 	zbx_hashset_destroy(&ids);
 	DBfree_result(result);
 
@@ -895,7 +1800,7 @@ int	zbx_dbsync_compare_host_inventory(zbx_dbsync_t *sync)
 			"poc_2_cell,poc_2_screen,poc_2_notes"
 			" from host_inventory";
 
-	if (NULL == (result = DBselect("%s", sql)))
+	if (NULL == (result = dbsync_select("%s", sql)))
 		return FAIL;
 
 	dbsync_prepare(sync, 72, NULL);
@@ -966,7 +1871,7 @@ int	zbx_dbsync_compare_host_templates(zbx_dbsync_t *sync)
 	char			hostid_s[MAX_ID_LEN + 1], templateid_s[MAX_ID_LEN + 1];
 	char			*del_row[2] = {hostid_s, templateid_s};
 
-	if (NULL == (result = DBselect(
+	if (NULL == (result = dbsync_select(
 			"select hostid,templateid"
 			" from hosts_templates"
 			" order by hostid")))
@@ -1096,7 +2001,7 @@ int	zbx_dbsync_compare_global_macros(zbx_dbsync_t *sync)
 	zbx_uint64_t		rowid;
 	ZBX_DC_GMACRO		*macro;
 
-	if (NULL == (result = DBselect(
+	if (NULL == (result = dbsync_select(
 			"select globalmacroid,macro,value,type"
 			" from globalmacro")))
 	{
@@ -1218,7 +2123,7 @@ int	zbx_dbsync_compare_host_macros(zbx_dbsync_t *sync)
 	zbx_uint64_t		rowid;
 	ZBX_DC_HMACRO		*macro;
 
-	if (NULL == (result = DBselect(
+	if (NULL == (result = dbsync_select(
 			"select m.hostmacroid,m.hostid,m.macro,m.value,m.type"
 			" from hostmacro m"
 			" inner join hosts h on m.hostid=h.hostid"
@@ -1392,7 +2297,7 @@ int	zbx_dbsync_compare_interfaces(zbx_dbsync_t *sync)
 	zbx_uint64_t		rowid;
 	ZBX_DC_INTERFACE	*interface;
 
-	if (NULL == (result = DBselect(
+	if (NULL == (result = dbsync_select(
 			"select i.interfaceid,i.hostid,i.type,i.main,i.useip,i.ip,i.dns,i.port,"
 			"i.available,i.disable_until,i.error,i.errors_from,"
 			"s.version,s.bulk,s.community,s.securityname,s.securitylevel,s.authpassphrase,s.privpassphrase,"
@@ -1752,70 +2657,70 @@ static int	dbsync_compare_item(const ZBX_DC_ITEM *item, const DB_ROW dbrow)
 		if (NULL == httpitem)
 			return FAIL;
 
-		if (FAIL == dbsync_compare_str(dbrow[30], httpitem->timeout))
+		if (FAIL == dbsync_compare_str(dbrow[30], httpitem->params->timeout))
 			return FAIL;
 
-		if (FAIL == dbsync_compare_str(dbrow[31], httpitem->url))
+		if (FAIL == dbsync_compare_str(dbrow[31], httpitem->params->url))
 			return FAIL;
 
-		if (FAIL == dbsync_compare_str(dbrow[32], httpitem->query_fields))
+		if (FAIL == dbsync_compare_str(dbrow[32], httpitem->params->query_fields))
 			return FAIL;
 
-		if (FAIL == dbsync_compare_str(dbrow[33], httpitem->posts))
+		if (FAIL == dbsync_compare_str(dbrow[33], httpitem->params->posts))
 			return FAIL;
 
-		if (FAIL == dbsync_compare_str(dbrow[34], httpitem->status_codes))
+		if (FAIL == dbsync_compare_str(dbrow[34], httpitem->params->status_codes))
 			return FAIL;
 
-		if (FAIL == dbsync_compare_uchar(dbrow[35], httpitem->follow_redirects))
+		if (FAIL == dbsync_compare_uchar(dbrow[35], httpitem->params->follow_redirects))
 			return FAIL;
 
-		if (FAIL == dbsync_compare_uchar(dbrow[36], httpitem->post_type))
+		if (FAIL == dbsync_compare_uchar(dbrow[36], httpitem->params->post_type))
 			return FAIL;
 
-		if (FAIL == dbsync_compare_str(dbrow[37], httpitem->http_proxy))
+		if (FAIL == dbsync_compare_str(dbrow[37], httpitem->params->http_proxy))
 			return FAIL;
 
-		if (FAIL == dbsync_compare_str(dbrow[38], httpitem->headers))
+		if (FAIL == dbsync_compare_str(dbrow[38], httpitem->params->headers))
 			return FAIL;
 
-		if (FAIL == dbsync_compare_uchar(dbrow[39], httpitem->retrieve_mode))
+		if (FAIL == dbsync_compare_uchar(dbrow[39], httpitem->params->retrieve_mode))
 			return FAIL;
 
-		if (FAIL == dbsync_compare_uchar(dbrow[40], httpitem->request_method))
+		if (FAIL == dbsync_compare_uchar(dbrow[40], httpitem->params->request_method))
 			return FAIL;
 
-		if (FAIL == dbsync_compare_uchar(dbrow[41], httpitem->output_format))
+		if (FAIL == dbsync_compare_uchar(dbrow[41], httpitem->params->output_format))
 			return FAIL;
 
-		if (FAIL == dbsync_compare_str(dbrow[42], httpitem->ssl_cert_file))
+		if (FAIL == dbsync_compare_str(dbrow[42], httpitem->params->ssl_cert_file))
 			return FAIL;
 
-		if (FAIL == dbsync_compare_str(dbrow[43], httpitem->ssl_key_file))
+		if (FAIL == dbsync_compare_str(dbrow[43], httpitem->params->ssl_key_file))
 			return FAIL;
 
-		if (FAIL == dbsync_compare_str(dbrow[44], httpitem->ssl_key_password))
+		if (FAIL == dbsync_compare_str(dbrow[44], httpitem->params->ssl_key_password))
 			return FAIL;
 
-		if (FAIL == dbsync_compare_uchar(dbrow[45], httpitem->verify_peer))
+		if (FAIL == dbsync_compare_uchar(dbrow[45], httpitem->params->verify_peer))
 			return FAIL;
 
-		if (FAIL == dbsync_compare_uchar(dbrow[46], httpitem->verify_host))
+		if (FAIL == dbsync_compare_uchar(dbrow[46], httpitem->params->verify_host))
 			return FAIL;
 
-		if (FAIL == dbsync_compare_uchar(dbrow[13], httpitem->authtype))
+		if (FAIL == dbsync_compare_uchar(dbrow[13], httpitem->params->authtype))
 			return FAIL;
 
-		if (FAIL == dbsync_compare_str(dbrow[14], httpitem->username))
+		if (FAIL == dbsync_compare_str(dbrow[14], httpitem->params->username))
 			return FAIL;
 
-		if (FAIL == dbsync_compare_str(dbrow[15], httpitem->password))
+		if (FAIL == dbsync_compare_str(dbrow[15], httpitem->params->password))
 			return FAIL;
 
-		if (FAIL == dbsync_compare_uchar(dbrow[47], httpitem->allow_traps))
+		if (FAIL == dbsync_compare_uchar(dbrow[47], httpitem->params->allow_traps))
 			return FAIL;
 
-		if (FAIL == dbsync_compare_str(dbrow[10], httpitem->trapper_hosts))
+		if (FAIL == dbsync_compare_str(dbrow[10], httpitem->params->trapper_hosts))
 			return FAIL;
 	}
 	else if (NULL != httpitem)
@@ -1914,25 +2819,23 @@ static char	**dbsync_item_preproc_row(char **row)
 
 /******************************************************************************
  *                                                                            *
- * Function: zbx_dbsync_compare_items                                         *
+ * Function: dbsync_items_sql                                                 *
  *                                                                            *
- * Purpose: compares items table with cached configuration data               *
+ * Purpose: builds items select statement                                     *
  *                                                                            *
- * Return value: SUCCEED - the changeset was successfully calculated          *
- *               FAIL    - otherwise                                          *
+ * Parameters: sql        - [IN/OUT] the sql statement                        *
+ *             sql_alloc  - [IN/OUT] the sql statement buffer size            *
+ *             sql_offset - [IN/OUT] the sql statement length                 *
+ *             changelog  - [IN] SUCCEED - select only items listed in        *
+ *                                         changelog                          *
+ *                                                                            *
+ * Return value: SUCCEED - the statement was built                            *
+ *               FAIL    - there are no changed items to select               *
  *                                                                            *
  ******************************************************************************/
-int	zbx_dbsync_compare_items(zbx_dbsync_t *sync)
+static int	dbsync_items_sql(char **sql, size_t *sql_alloc, size_t *sql_offset, int changelog)
 {
-	DB_ROW			dbrow;
-	DB_RESULT		result;
-	zbx_hashset_t		ids;
-	zbx_hashset_iter_t	iter;
-	zbx_uint64_t		rowid;
-	ZBX_DC_ITEM		*item;
-	char			**row;
-
-	if (NULL == (result = DBselect(
+	zbx_snprintf_alloc(sql, sql_alloc, sql_offset,
 			"select i.itemid,i.hostid,i.status,i.type,i.value_type,i.key_,i.snmp_oid,i.ipmi_sensor,i.delay,"
 				"i.trapper_hosts,i.logtimefmt,i.params,ir.state,i.authtype,i.username,i.password,"
 				"i.publickey,i.privatekey,i.flags,i.interfaceid,ir.lastlogsize,ir.mtime,"
@@ -1946,21 +2849,230 @@ int	zbx_dbsync_compare_items(zbx_dbsync_t *sync)
 			" left join item_discovery id on i.itemid=id.itemid"
 			" join item_rtdata ir on i.itemid=ir.itemid"
 			" where h.status in (%d,%d) and i.flags<>%d",
-			HOST_STATUS_MONITORED, HOST_STATUS_NOT_MONITORED, ZBX_FLAG_DISCOVERY_PROTOTYPE)))
+			HOST_STATUS_MONITORED, HOST_STATUS_NOT_MONITORED, ZBX_FLAG_DISCOVERY_PROTOTYPE);
 
+	if (SUCCEED == changelog)
 	{
-		return FAIL;
+		if (0 == dbsync_env.changelog_itemids.values_num && 0 == dbsync_env.changelog_hostids.values_num)
+			return FAIL;
+
+		/* items of changed hosts are selected to follow host status changes and removal */
+		zbx_strcpy_alloc(sql, sql_alloc, sql_offset, " and (");
+
+		if (0 != dbsync_env.changelog_itemids.values_num)
+		{
+			DBadd_condition_alloc(sql, sql_alloc, sql_offset, "i.itemid",
+					dbsync_env.changelog_itemids.values, dbsync_env.changelog_itemids.values_num);
+
+			if (0 != dbsync_env.changelog_hostids.values_num)
+				zbx_strcpy_alloc(sql, sql_alloc, sql_offset, " or");
+		}
+
+		DBadd_condition_alloc(sql, sql_alloc, sql_offset, "i.hostid", dbsync_env.changelog_hostids.values,
+				dbsync_env.changelog_hostids.values_num);
+
+		zbx_chrcpy_alloc(sql, sql_alloc, sql_offset, ')');
+	}
+
+	return SUCCEED;
+}
+
+static void	dbsync_triggers_sql(char **sql, size_t *sql_alloc, size_t *sql_offset)
+{
+	zbx_snprintf_alloc(sql, sql_alloc, sql_offset,
+			"select distinct t.triggerid,t.description,t.expression,t.error,t.priority,t.type,t.value,"
+				"t.state,t.lastchange,t.status,t.recovery_mode,t.recovery_expression,"
+				"t.correlation_mode,t.correlation_tag,t.opdata,t.event_name,null,null,null"
+			" from hosts h,items i,functions f,triggers t"
+			" where h.hostid=i.hostid"
+				" and i.itemid=f.itemid"
+				" and f.triggerid=t.triggerid"
+				" and h.status in (%d,%d)"
+				" and t.flags<>%d",
+			HOST_STATUS_MONITORED, HOST_STATUS_NOT_MONITORED,
+			ZBX_FLAG_DISCOVERY_PROTOTYPE);
+}
+
+static void	dbsync_functions_sql(char **sql, size_t *sql_alloc, size_t *sql_offset)
+{
+	zbx_snprintf_alloc(sql, sql_alloc, sql_offset,
+			"select i.itemid,f.functionid,f.name,f.parameter,t.triggerid,i.hostid"
+			" from hosts h,items i,functions f,triggers t"
+			" where h.hostid=i.hostid"
+				" and i.itemid=f.itemid"
+				" and f.triggerid=t.triggerid"
+				" and h.status in (%d,%d)"
+				" and t.flags<>%d",
+			HOST_STATUS_MONITORED, HOST_STATUS_NOT_MONITORED,
+			ZBX_FLAG_DISCOVERY_PROTOTYPE);
+}
+
+static void	dbsync_item_preprocs_sql(char **sql, size_t *sql_alloc, size_t *sql_offset)
+{
+	zbx_snprintf_alloc(sql, sql_alloc, sql_offset,
+			"select pp.item_preprocid,pp.itemid,pp.type,pp.params,pp.step,i.hostid,pp.error_handler,"
+				"pp.error_handler_params,i.type,i.key_,h.proxy_hostid"
+			" from item_preproc pp,items i,hosts h"
+			" where pp.itemid=i.itemid"
+				" and i.hostid=h.hostid"
+				" and (h.proxy_hostid is null"
+					" or i.type in (%d,%d,%d))"
+				" and h.status in (%d,%d)"
+				" and i.flags<>%d"
+			" order by pp.itemid",
+			ITEM_TYPE_INTERNAL, ITEM_TYPE_CALCULATED, ITEM_TYPE_DEPENDENT,
+			HOST_STATUS_MONITORED, HOST_STATUS_NOT_MONITORED,
+			ZBX_FLAG_DISCOVERY_PROTOTYPE);
+}
+
+static void	dbsync_item_tags_sql(char **sql, size_t *sql_alloc, size_t *sql_offset)
+{
+	zbx_snprintf_alloc(sql, sql_alloc, sql_offset,
+			"select distinct it.itemtagid,it.itemid,it.tag,it.value"
+			" from item_tag it,items i,hosts h"
+			" where i.itemid=it.itemid"
+				" and i.flags in (%d,%d)"
+				" and h.hostid=i.hostid"
+				" and h.status in (%d,%d)",
+				ZBX_FLAG_DISCOVERY_NORMAL, ZBX_FLAG_DISCOVERY_CREATED,
+				HOST_STATUS_MONITORED, HOST_STATUS_NOT_MONITORED);
+}
+
+static void	dbsync_trigger_tags_sql(char **sql, size_t *sql_alloc, size_t *sql_offset)
+{
+	zbx_snprintf_alloc(sql, sql_alloc, sql_offset,
+			"select distinct tt.triggertagid,tt.triggerid,tt.tag,tt.value"
+			" from trigger_tag tt,triggers t,hosts h,items i,functions f"
+			" where t.triggerid=tt.triggerid"
+				" and t.flags<>%d"
+				" and h.hostid=i.hostid"
+				" and i.itemid=f.itemid"
+				" and f.triggerid=tt.triggerid"
+				" and h.status in (%d,%d)",
+				ZBX_FLAG_DISCOVERY_PROTOTYPE, HOST_STATUS_MONITORED, HOST_STATUS_NOT_MONITORED);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: dbsync_prefetch_add                                              *
+ *                                                                            *
+ * Purpose: queues select statement for execution on a separate connection    *
+ *                                                                            *
+ ******************************************************************************/
+static void	dbsync_prefetch_add(char *sql)
+{
+	zbx_dbsync_prefetch_t	*prefetch;
+
+	prefetch = (zbx_dbsync_prefetch_t *)zbx_malloc(NULL, sizeof(zbx_dbsync_prefetch_t));
+	prefetch->sql = sql;
+	prefetch->index = FAIL;
+	zbx_vector_ptr_append(&dbsync_env.prefetch, prefetch);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_dbsync_env_prefetch                                          *
+ *                                                                            *
+ * Purpose: starts parallel execution of the largest configuration selects    *
+ *                                                                            *
+ * Comments: The selects are executed on separate database connections while *
+ *           the preceding configuration sections are synchronized, then the  *
+ *           compare functions take the prefetched results instead of         *
+ *           executing the selects. Prefetching is done only for initial and  *
+ *           full synchronizations, changelog based synchronizations select   *
+ *           few rows, and skipped when the results are loaded from snapshot. *
+ *                                                                            *
+ *           A prefetched result is held in memory as a whole from the time   *
+ *           it is received until its compare function copies it into dbsync  *
+ *           object and frees it. To bound this cost at most                  *
+ *           ZBX_DBSYNC_PREFETCH_MAX selects are executed at once, in the     *
+ *           order the compare functions are called, and the next select is   *
+ *           started only when a result is taken. So besides the result being *
+ *           compared at most ZBX_DBSYNC_PREFETCH_MAX results are in memory,  *
+ *           instead of all of them.                                          *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_dbsync_env_prefetch(void)
+{
+	typedef void	(*zbx_dbsync_sql_func_t)(char **sql, size_t *sql_alloc, size_t *sql_offset);
+
+	/* in the order of compare function calls in DCsync_configuration() */
+	zbx_dbsync_sql_func_t	sql_funcs[] = {dbsync_item_preprocs_sql, dbsync_item_tags_sql, dbsync_functions_sql,
+				dbsync_triggers_sql, dbsync_trigger_tags_sql};
+	char			*sql = NULL;
+	size_t			sql_alloc = 0, sql_offset = 0;
+	int			i;
+
+	if (SUCCEED == dbsync_env.changelog || 0 != dbsync_env.snapshot.values_num)
+		return;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+
+	dbsync_items_sql(&sql, &sql_alloc, &sql_offset, FAIL);
+	dbsync_prefetch_add(sql);
+
+	for (i = 0; i < (int)ARRSIZE(sql_funcs); i++)
+	{
+		sql = NULL;
+		sql_alloc = 0;
+		sql_offset = 0;
+
+		sql_funcs[i](&sql, &sql_alloc, &sql_offset);
+		dbsync_prefetch_add(sql);
 	}
 
+	dbsync_prefetch_send();
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s() prefetched:%d", __func__, dbsync_env.prefetch.values_num);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_dbsync_compare_items                                         *
+ *                                                                            *
+ * Purpose: compares items table with cached configuration data               *
+ *                                                                            *
+ * Return value: SUCCEED - the changeset was successfully calculated          *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_dbsync_compare_items(zbx_dbsync_t *sync)
+{
+	DB_ROW			dbrow;
+	DB_RESULT		result;
+	zbx_hashset_t		ids;
+	zbx_hashset_iter_t	iter;
+	zbx_uint64_t		rowid;
+	ZBX_DC_ITEM		*item;
+	char			**row, *sql = NULL;
+	size_t			sql_alloc = 0, sql_offset = 0;
+	int			i, changelog;
+
+	changelog = (ZBX_DBSYNC_UPDATE == sync->mode ? dbsync_env.changelog : FAIL);
+
 	dbsync_prepare(sync, 51, dbsync_item_preproc_row);
 
+	/* nothing changed since the last synchronization */
+	if (FAIL == dbsync_items_sql(&sql, &sql_alloc, &sql_offset, changelog))
+	{
+		zbx_free(sql);
+		return SUCCEED;
+	}
+
+	result = dbsync_select("%s", sql);
+	zbx_free(sql);
+
+	if (NULL == result)
+		return FAIL;
+
 	if (ZBX_DBSYNC_INIT == sync->mode)
 	{
 		sync->dbresult = result;
 		return SUCCEED;
 	}
 
-	zbx_hashset_create(&ids, dbsync_env.cache->items.num_data, ZBX_DEFAULT_UINT64_HASH_FUNC,
+	zbx_hashset_create(&ids, (SUCCEED == changelog ? (size_t)dbsync_env.changelog_itemids.values_num :
+			dbsync_env.cache->items.num_data), ZBX_DEFAULT_UINT64_HASH_FUNC,
 			ZBX_DEFAULT_UINT64_COMPARE_FUNC);
 
 	while (NULL != (dbrow = DBfetch(result)))
@@ -1981,13 +3093,38 @@ int	zbx_dbsync_compare_items(zbx_dbsync_t *sync)
 			dbsync_add_row(sync, rowid, tag, row);
 	}
 
+	if (SUCCEED == changelog)
+	{
+		/* only changed items and items of changed hosts can be removed */
+		for (i = 0; i < dbsync_env.changelog_itemids.values_num; i++)
+		{
+			rowid = dbsync_env.changelog_itemids.values[i];
+
+			if (NULL != zbx_hashset_search(&dbsync_env.cache->items, &rowid) &&
+					NULL == zbx_hashset_search(&ids, &rowid))
+			{
+				zbx_hashset_insert(&ids, &rowid, sizeof(rowid));
+				dbsync_add_row(sync, rowid, ZBX_DBSYNC_ROW_REMOVE, NULL);
+			}
+		}
+
+		if (0 == dbsync_env.changelog_hostids.values_num)
+			goto out;
+	}
+
 	zbx_hashset_iter_reset(&dbsync_env.cache->items, &iter);
 	while (NULL != (item = (ZBX_DC_ITEM *)zbx_hashset_iter_next(&iter)))
 	{
+		if (SUCCEED == changelog && FAIL == zbx_vector_uint64_bsearch(&dbsync_env.changelog_hostids,
+				item->hostid, ZBX_DEFAULT_UINT64_COMPARE_FUNC))
+		{
+			continue;
+		}
+
 		if (NULL == zbx_hashset_search(&ids, &item->itemid))
 			dbsync_add_row(sync, item->itemid, ZBX_DBSYNC_ROW_REMOVE, NULL);
 	}
-
+out:
 	zbx_hashset_destroy(&ids);
 	DBfree_result(result);
 
@@ -2025,7 +3162,7 @@ int	zbx_dbsync_compare_template_items(zbx_dbsync_t *sync)
 	ZBX_DC_TEMPLATE_ITEM	*item;
 	char			**row;
 
-	if (NULL == (result = DBselect(
+	if (NULL == (result = dbsync_select(
 			"select i.itemid,i.hostid,i.templateid from items i inner join hosts h on i.hostid=h.hostid"
 			" where h.status=%d", HOST_STATUS_TEMPLATE)))
 	{
@@ -2108,7 +3245,7 @@ int	zbx_dbsync_compare_prototype_items(zbx_dbsync_t *sync)
 	ZBX_DC_PROTOTYPE_ITEM	*item;
 	char			**row;
 
-	if (NULL == (result = DBselect(
+	if (NULL == (result = dbsync_select(
 			"select i.itemid,i.hostid,i.templateid from items i where i.flags=%d",
 				ZBX_FLAG_DISCOVERY_PROTOTYPE)))
 	{
@@ -2348,23 +3485,15 @@ int	zbx_dbsync_compare_triggers(zbx_dbsync_t *sync)
 	zbx_hashset_iter_t	iter;
 	zbx_uint64_t		rowid;
 	ZBX_DC_TRIGGER		*trigger;
-	char			**row;
+	char			**row, *sql = NULL;
+	size_t			sql_alloc = 0, sql_offset = 0;
 
-	if (NULL == (result = DBselect(
-			"select distinct t.triggerid,t.description,t.expression,t.error,t.priority,t.type,t.value,"
-				"t.state,t.lastchange,t.status,t.recovery_mode,t.recovery_expression,"
-				"t.correlation_mode,t.correlation_tag,t.opdata,t.event_name,null,null,null"
-			" from hosts h,items i,functions f,triggers t"
-			" where h.hostid=i.hostid"
-				" and i.itemid=f.itemid"
-				" and f.triggerid=t.triggerid"
-				" and h.status in (%d,%d)"
-				" and t.flags<>%d",
-			HOST_STATUS_MONITORED, HOST_STATUS_NOT_MONITORED,
-			ZBX_FLAG_DISCOVERY_PROTOTYPE)))
-	{
+	dbsync_triggers_sql(&sql, &sql_alloc, &sql_offset);
+	result = dbsync_select("%s", sql);
+	zbx_free(sql);
+
+	if (NULL == result)
 		return FAIL;
-	}
 
 	dbsync_prepare(sync, 19, dbsync_trigger_preproc_row);
 
@@ -2432,7 +3561,7 @@ int	zbx_dbsync_compare_trigger_dependency(zbx_dbsync_t *sync)
 	char			*del_row[2] = {down_s, up_s};
 	int			i;
 
-	if (NULL == (result = DBselect(
+	if (NULL == (result = dbsync_select(
 			"select distinct d.triggerid_down,d.triggerid_up"
 			" from trigger_depends d,triggers t,hosts h,items i,functions f"
 			" where t.triggerid=d.triggerid_down"
@@ -2586,21 +3715,15 @@ int	zbx_dbsync_compare_functions(zbx_dbsync_t *sync)
 	zbx_hashset_iter_t	iter;
 	zbx_uint64_t		rowid;
 	ZBX_DC_FUNCTION		*function;
-	char			**row;
+	char			**row, *sql = NULL;
+	size_t			sql_alloc = 0, sql_offset = 0;
 
-	if (NULL == (result = DBselect(
-			"select i.itemid,f.functionid,f.name,f.parameter,t.triggerid,i.hostid"
-			" from hosts h,items i,functions f,triggers t"
-			" where h.hostid=i.hostid"
-				" and i.itemid=f.itemid"
-				" and f.triggerid=t.triggerid"
-				" and h.status in (%d,%d)"
-				" and t.flags<>%d",
-			HOST_STATUS_MONITORED, HOST_STATUS_NOT_MONITORED,
-			ZBX_FLAG_DISCOVERY_PROTOTYPE)))
-	{
+	dbsync_functions_sql(&sql, &sql_alloc, &sql_offset);
+	result = dbsync_select("%s", sql);
+	zbx_free(sql);
+
+	if (NULL == result)
 		return FAIL;
-	}
 
 	dbsync_prepare(sync, 6, dbsync_function_preproc_row);
 
@@ -2699,7 +3822,7 @@ int	zbx_dbsync_compare_expressions(zbx_dbsync_t *sync)
 	zbx_uint64_t		rowid;
 	ZBX_DC_EXPRESSION	*expression;
 
-	if (NULL == (result = DBselect(
+	if (NULL == (result = dbsync_select(
 			"select r.name,e.expressionid,e.expression,e.expression_type,e.exp_delimiter,e.case_sensitive"
 			" from regexps r,expressions e"
 			" where r.regexpid=e.regexpid")))
@@ -2799,7 +3922,7 @@ int	zbx_dbsync_compare_actions(zbx_dbsync_t *sync)
 	zbx_uint64_t		rowid;
 	zbx_dc_action_t		*action;
 
-	if (NULL == (result = DBselect(
+	if (NULL == (result = dbsync_select(
 			"select actionid,eventsource,evaltype,formula"
 			" from actions"
 			" where eventsource<>%d"
@@ -2900,7 +4023,7 @@ int	zbx_dbsync_compare_action_ops(zbx_dbsync_t *sync)
 	zbx_uint64_t		rowid, actionid = 0;
 	unsigned char		opflags = ZBX_ACTION_OPCLASS_NONE;
 
-	if (NULL == (result = DBselect(
+	if (NULL == (result = dbsync_select(
 			"select a.actionid,o.recovery"
 			" from actions a"
 			" left join operations o"
@@ -3002,7 +4125,7 @@ int	zbx_dbsync_compare_action_conditions(zbx_dbsync_t *sync)
 	zbx_uint64_t			rowid;
 	zbx_dc_action_condition_t	*condition;
 
-	if (NULL == (result = DBselect(
+	if (NULL == (result = dbsync_select(
 			"select c.conditionid,c.actionid,c.conditiontype,c.operator,c.value,c.value2"
 			" from conditions c,actions a"
 			" where c.actionid=a.actionid"
@@ -3102,20 +4225,15 @@ int	zbx_dbsync_compare_trigger_tags(zbx_dbsync_t *sync)
 	zbx_hashset_iter_t	iter;
 	zbx_uint64_t		rowid;
 	zbx_dc_trigger_tag_t	*trigger_tag;
+	char			*sql = NULL;
+	size_t			sql_alloc = 0, sql_offset = 0;
 
-	if (NULL == (result = DBselect(
-			"select distinct tt.triggertagid,tt.triggerid,tt.tag,tt.value"
-			" from trigger_tag tt,triggers t,hosts h,items i,functions f"
-			" where t.triggerid=tt.triggerid"
-				" and t.flags<>%d"
-				" and h.hostid=i.hostid"
-				" and i.itemid=f.itemid"
-				" and f.triggerid=tt.triggerid"
-				" and h.status in (%d,%d)",
-				ZBX_FLAG_DISCOVERY_PROTOTYPE, HOST_STATUS_MONITORED, HOST_STATUS_NOT_MONITORED)))
-	{
+	dbsync_trigger_tags_sql(&sql, &sql_alloc, &sql_offset);
+	result = dbsync_select("%s", sql);
+	zbx_free(sql);
+
+	if (NULL == result)
 		return FAIL;
-	}
 
 	dbsync_prepare(sync, 4, NULL);
 
@@ -3207,19 +4325,15 @@ int	zbx_dbsync_compare_item_tags(zbx_dbsync_t *sync)
 	zbx_hashset_iter_t	iter;
 	zbx_uint64_t		rowid;
 	zbx_dc_item_tag_t	*item_tag;
+	char			*sql = NULL;
+	size_t			sql_alloc = 0, sql_offset = 0;
 
-	if (NULL == (result = DBselect(
-			"select distinct it.itemtagid,it.itemid,it.tag,it.value"
-			" from item_tag it,items i,hosts h"
-			" where i.itemid=it.itemid"
-				" and i.flags in (%d,%d)"
-				" and h.hostid=i.hostid"
-				" and h.status in (%d,%d)",
-				ZBX_FLAG_DISCOVERY_NORMAL, ZBX_FLAG_DISCOVERY_CREATED,
-				HOST_STATUS_MONITORED, HOST_STATUS_NOT_MONITORED)))
-	{
+	dbsync_item_tags_sql(&sql, &sql_alloc, &sql_offset);
+	result = dbsync_select("%s", sql);
+	zbx_free(sql);
+
+	if (NULL == result)
 		return FAIL;
-	}
 
 	dbsync_prepare(sync, 4, NULL);
 
@@ -3312,7 +4426,7 @@ int	zbx_dbsync_compare_host_tags(zbx_dbsync_t *sync)
 	zbx_uint64_t		rowid;
 	zbx_dc_host_tag_t	*host_tag;
 
-	if (NULL == (result = DBselect(
+	if (NULL == (result = dbsync_select(
 			"select * from host_tag")))
 	{
 		printf("db query failed!\n");
@@ -3410,7 +4524,7 @@ int	zbx_dbsync_compare_correlations(zbx_dbsync_t *sync)
 	zbx_uint64_t		rowid;
 	zbx_dc_correlation_t	*correlation;
 
-	if (NULL == (result = DBselect(
+	if (NULL == (result = dbsync_select(
 			"select correlationid,name,evaltype,formula"
 			" from correlation"
 			" where status=%d",
@@ -3540,7 +4654,7 @@ int	zbx_dbsync_compare_corr_conditions(zbx_dbsync_t *sync)
 	zbx_uint64_t		rowid;
 	zbx_dc_corr_condition_t	*corr_condition;
 
-	if (NULL == (result = DBselect(
+	if (NULL == (result = dbsync_select(
 			"select cc.corr_conditionid,cc.correlationid,cc.type,cct.tag,cctv.tag,cctv.value,cctv.operator,"
 				" ccg.groupid,ccg.operator,cctp.oldtag,cctp.newtag"
 			" from correlation c,corr_condition cc"
@@ -3650,7 +4764,7 @@ int	zbx_dbsync_compare_corr_operations(zbx_dbsync_t *sync)
 	zbx_uint64_t		rowid;
 	zbx_dc_corr_operation_t	*corr_operation;
 
-	if (NULL == (result = DBselect(
+	if (NULL == (result = dbsync_select(
 			"select co.corr_operationid,co.correlationid,co.type"
 			" from correlation c,corr_operation co"
 			" where c.correlationid=co.correlationid"
@@ -3745,7 +4859,7 @@ int	zbx_dbsync_compare_host_groups(zbx_dbsync_t *sync)
 	zbx_uint64_t		rowid;
 	zbx_dc_hostgroup_t	*group;
 
-	if (NULL == (result = DBselect("select groupid,name from hstgrp")))
+	if (NULL == (result = dbsync_select("select groupid,name from hstgrp")))
 		return FAIL;
 
 	dbsync_prepare(sync, 2, NULL);
@@ -3889,25 +5003,15 @@ int	zbx_dbsync_compare_item_preprocs(zbx_dbsync_t *sync)
 	zbx_hashset_iter_t	iter;
 	zbx_uint64_t		rowid;
 	zbx_dc_preproc_op_t	*preproc;
-	char			**row;
+	char			**row, *sql = NULL;
+	size_t			sql_alloc = 0, sql_offset = 0;
 
-	if (NULL == (result = DBselect(
-			"select pp.item_preprocid,pp.itemid,pp.type,pp.params,pp.step,i.hostid,pp.error_handler,"
-				"pp.error_handler_params,i.type,i.key_,h.proxy_hostid"
-			" from item_preproc pp,items i,hosts h"
-			" where pp.itemid=i.itemid"
-				" and i.hostid=h.hostid"
-				" and (h.proxy_hostid is null"
-					" or i.type in (%d,%d,%d))"
-				" and h.status in (%d,%d)"
-				" and i.flags<>%d"
-			" order by pp.itemid",
-			ITEM_TYPE_INTERNAL, ITEM_TYPE_CALCULATED, ITEM_TYPE_DEPENDENT,
-			HOST_STATUS_MONITORED, HOST_STATUS_NOT_MONITORED,
-			ZBX_FLAG_DISCOVERY_PROTOTYPE)))
-	{
+	dbsync_item_preprocs_sql(&sql, &sql_alloc, &sql_offset);
+	result = dbsync_select("%s", sql);
+	zbx_free(sql);
+
+	if (NULL == result)
 		return FAIL;
-	}
 
 	dbsync_prepare(sync, 8, dbsync_item_pp_preproc_row);
 
@@ -4046,7 +5150,7 @@ int	zbx_dbsync_compare_item_script_param(zbx_dbsync_t *sync)
 	zbx_dc_scriptitem_param_t	*itemscript_params;
 	char				**row;
 
-	if (NULL == (result = DBselect(
+	if (NULL == (result = dbsync_select(
 			"select p.item_parameterid,p.itemid,p.name,p.value,i.hostid"
 			" from item_parameter p,items i,hosts h"
 			" where p.itemid=i.itemid"
@@ -4129,7 +5233,7 @@ int	zbx_dbsync_compare_maintenances(zbx_dbsync_t *sync)
 	zbx_uint64_t		rowid;
 	zbx_dc_maintenance_t	*maintenance;
 
-	if (NULL == (result = DBselect("select maintenanceid,maintenance_type,active_since,active_till,tags_evaltype"
+	if (NULL == (result = dbsync_select("select maintenanceid,maintenance_type,active_since,active_till,tags_evaltype"
 						" from maintenances")))
 	{
 		return FAIL;
@@ -4225,7 +5329,7 @@ int	zbx_dbsync_compare_maintenance_tags(zbx_dbsync_t *sync)
 	zbx_uint64_t			rowid;
 	zbx_dc_maintenance_tag_t	*maintenance_tag;
 
-	if (NULL == (result = DBselect("select maintenancetagid,maintenanceid,operator,tag,value"
+	if (NULL == (result = dbsync_select("select maintenancetagid,maintenanceid,operator,tag,value"
 						" from maintenance_tag")))
 	{
 		return FAIL;
@@ -4338,7 +5442,7 @@ int	zbx_dbsync_compare_maintenance_periods(zbx_dbsync_t *sync)
 	zbx_uint64_t			rowid;
 	zbx_dc_maintenance_period_t	*period;
 
-	if (NULL == (result = DBselect("select t.timeperiodid,t.timeperiod_type,t.every,t.month,t.dayofweek,t.day,"
+	if (NULL == (result = dbsync_select("select t.timeperiodid,t.timeperiod_type,t.every,t.month,t.dayofweek,t.day,"
 						"t.start_time,t.period,t.start_date,m.maintenanceid"
 					" from maintenances_windows m,timeperiods t"
 					" where t.timeperiodid=m.timeperiodid")))
@@ -4413,7 +5517,7 @@ int	zbx_dbsync_compare_maintenance_groups(zbx_dbsync_t *sync)
 	char			maintenanceid_s[MAX_ID_LEN + 1], groupid_s[MAX_ID_LEN + 1];
 	char			*del_row[2] = {maintenanceid_s, groupid_s};
 
-	if (NULL == (result = DBselect("select maintenanceid,groupid from maintenances_groups order by maintenanceid")))
+	if (NULL == (result = dbsync_select("select maintenanceid,groupid from maintenances_groups order by maintenanceid")))
 		return FAIL;
 
 	dbsync_prepare(sync, 2, NULL);
@@ -4490,7 +5594,7 @@ int	zbx_dbsync_compare_maintenance_hosts(zbx_dbsync_t *sync)
 	char			maintenanceid_s[MAX_ID_LEN + 1], hostid_s[MAX_ID_LEN + 1];
 	char			*del_row[2] = {maintenanceid_s, hostid_s};
 
-	if (NULL == (result = DBselect("select maintenanceid,hostid from maintenances_hosts order by maintenanceid")))
+	if (NULL == (result = dbsync_select("select maintenanceid,hostid from maintenances_hosts order by maintenanceid")))
 		return FAIL;
 
 	dbsync_prepare(sync, 2, NULL);
@@ -4567,7 +5671,7 @@ int	zbx_dbsync_compare_host_group_hosts(zbx_dbsync_t *sync)
 	char			groupid_s[MAX_ID_LEN + 1], hostid_s[MAX_ID_LEN + 1];
 	char			*del_row[2] = {groupid_s, hostid_s};
 
-	if (NULL == (result = DBselect(
+	if (NULL == (result = dbsync_select(
 			"select hg.groupid,hg.hostid"
 			" from hosts_groups hg,hosts h"
 			" where hg.hostid=h.hostid"
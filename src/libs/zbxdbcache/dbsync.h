@@ -112,6 +112,12 @@ struct zbx_dbsync
 
 void	zbx_dbsync_init_env(ZBX_DC_CONFIG *cache);
 void	zbx_dbsync_free_env(void);
+void	zbx_dbsync_env_prepare(unsigned char mode);
+void	zbx_dbsync_env_reset_changelog(void);
+void	zbx_dbsync_env_flush_changelog(void);
+void	zbx_dbsync_env_prefetch(void);
+void	zbx_dbsync_env_save_snapshot(void);
+int	zbx_dbsync_snapshot_loaded(void);
 
 void	zbx_dbsync_init(zbx_dbsync_t *sync, unsigned char mode);
 void	zbx_dbsync_clear(zbx_dbsync_t *sync);
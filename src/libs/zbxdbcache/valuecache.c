@@ -28,6 +28,8 @@
 
 #include "vectorimpl.h"
 
+#include <sys/mman.h>
+
 /*
  * The cache (zbx_vc_cache_t) is organized as a hashset of item records (zbx_vc_item_t).
  *
@@ -52,6 +54,22 @@
  *
  * The low memory mode can't be turned off - it will persist until server is rebooted.
  * In low memory mode a warning message is written into log every 5 minutes.
+ *
+ * When value cache compression is enabled the chunks of numeric (float, unsigned) items
+ * are compressed with zbx_gorilla_encode() once they are sealed - when a newer chunk is
+ * added at head or an older chunk is added at tail. Only the head chunk is kept
+ * uncompressed to append new values. Compressed chunks are decoded on access into
+ * process local buffer.
+ *
+ * The cache can be split into several stripes (ValueCacheStripes) to reduce lock
+ * contention. Items are assigned to stripes by itemid and each stripe is a separate
+ * cache (zbx_vc_cache_t) with its own shared memory segment, read-write lock, low memory
+ * mode and statistics. Operations on all items lock the stripes one by one in ascending
+ * order, a process never holds more than one stripe lock at a time.
+ *
+ * When ValueCacheSnapshotFile is set the cached items are saved to the snapshot file at
+ * server shutdown and loaded back at the next start, so the cache does not have to be
+ * filled from database again.
  */
 
 /* the period of low memory warning messages */
@@ -62,10 +80,9 @@
 
 #define ZBX_VC_LOW_MEMORY_ITEM_PRINT_LIMIT	25
 
+/* the memory of the currently locked value cache stripe */
 static zbx_mem_info_t	*vc_mem = NULL;
 
-zbx_rwlock_t	vc_lock = ZBX_RWLOCK_NULL;
-
 /* value cache enable/disable flags */
 #define ZBX_VC_DISABLED		0
 #define ZBX_VC_ENABLED		1
@@ -76,6 +93,21 @@ static int	vc_state = ZBX_VC_DISABLED;
 /* the value cache size */
 extern zbx_uint64_t	CONFIG_VALUE_CACHE_SIZE;
 
+/* the numeric value compression flag */
+extern int		CONFIG_VALUE_CACHE_COMPRESSION;
+
+/* the number of value cache stripes */
+extern int		CONFIG_VALUE_CACHE_STRIPES;
+
+/* the file to save value cache contents at shutdown */
+extern char		*CONFIG_VALUE_CACHE_SNAPSHOT_FILE;
+
+/* the percentile sketch flag */
+extern int		CONFIG_VALUE_CACHE_PERCENTILE_SKETCH;
+
+/* the minimum size of value cache memory per stripe */
+#define ZBX_VC_STRIPE_SIZE_MIN	(128 * ZBX_KIBIBYTE)
+
 ZBX_MEM_FUNC_IMPL(__vc, vc_mem)
 
 #define VC_STRPOOL_INIT_SIZE	(1000)
@@ -108,7 +140,14 @@ typedef struct zbx_vc_chunk
 	/* the number of item value slots in chunk */
 	int			slots_num;
 
-	/* the item value data */
+	/* the size of compressed value data in bytes, 0 for uncompressed chunks */
+	int			packed_size;
+
+	/* the compressed chunk identifier, used to check if process already has the chunk decoded */
+	zbx_uint64_t		packed_id;
+
+	/* the item value data, compressed chunks store the zbx_gorilla_encode() data */
+	/* stream of slots_num values instead                                         */
 	zbx_history_record_t	slots[1];
 }
 zbx_vc_chunk_t;
@@ -121,6 +160,102 @@ zbx_vc_chunk_t;
 #define ZBX_VC_MAX_CHUNK_RECORDS	((64 * ZBX_KIBIBYTE - sizeof(zbx_vc_chunk_t)) / \
 		sizeof(zbx_history_record_t) + 1)
 
+/* the maximum size of compressed chunk data */
+#define ZBX_VC_MAX_PACKED_SIZE		(ZBX_VC_MAX_CHUNK_RECORDS * ZBX_GORILLA_VALUE_BITS_MAX / 8)
+
+/* the values of the last decoded compressed chunk, local for each process */
+static zbx_history_record_t	vc_unpacked_slots[ZBX_VC_MAX_CHUNK_RECORDS];
+static zbx_uint64_t		vc_unpacked_id = 0;
+
+/* the relative error of percentile sketch values */
+#define ZBX_VC_SKETCH_ACCURACY		0.01
+
+/* the ratio of percentile sketch bucket boundaries, (1 + accuracy) / (1 - accuracy) */
+#define ZBX_VC_SKETCH_GAMMA		((1 + ZBX_VC_SKETCH_ACCURACY) / (1 - ZBX_VC_SKETCH_ACCURACY))
+
+/* values with smaller absolute value are counted as zero by percentile sketch */
+#define ZBX_VC_SKETCH_VALUE_MIN		1e-9
+
+/* the initial and maximum number of percentile sketch buckets */
+#define ZBX_VC_SKETCH_BUCKETS_INIT	16
+#define ZBX_VC_SKETCH_BUCKETS_MAX	1024
+
+/* percentiles of windows with less values are calculated exactly */
+#define ZBX_VC_SKETCH_VALUES_MIN	100
+
+static int	vc_sketch_values_min = ZBX_VC_SKETCH_VALUES_MIN;
+
+/* the logarithm of sketch gamma and the bucket index of ZBX_VC_SKETCH_VALUE_MIN */
+static double	vc_sketch_log_gamma;
+static int	vc_sketch_index_min;
+
+/* the maximum number of window aggregates per item */
+#define ZBX_VC_AGGR_MAX			4
+
+/* window aggregates not requested during this period are removed */
+#define ZBX_VC_AGGR_EXPIRE_PERIOD	SEC_PER_HOUR
+
+/* the percentile sketch bucket */
+typedef struct
+{
+	/* 0 - zero values, positive/negative keys - logarithmic buckets of positive/negative values */
+	int	key;
+
+	/* the number of values in bucket */
+	int	count;
+}
+zbx_vc_sketch_bucket_t;
+
+/* The logarithmic histogram of window values (DDSketch), each bucket holding values     */
+/* within ZBX_VC_SKETCH_ACCURACY relative distance from the bucket value. Unlike other  */
+/* quantile sketches it supports value removal, so it can follow the window aggregate. */
+typedef struct
+{
+	/* the buckets sorted by key, NULL if sketch is not kept for the window */
+	zbx_vc_sketch_bucket_t	*buckets;
+
+	int			buckets_num;
+	int			buckets_alloc;
+
+	/* 0 - the bucket limit was exceeded or there was not enough memory, the window must be rescanned */
+	unsigned char		valid;
+}
+zbx_vc_sketch_t;
+
+/* the incrementally updated aggregate of item values in time window (end - seconds, end] */
+typedef struct zbx_vc_aggr
+{
+	/* a pointer to the next aggregate of the same item */
+	struct zbx_vc_aggr	*next;
+
+	/* the aggregated values */
+	zbx_vc_aggregate_t	value;
+
+	/* the window values percentile sketch */
+	zbx_vc_sketch_t		sketch;
+
+	/* the window end, set to the newest item value timestamp */
+	zbx_timespec_t		end;
+
+	/* the window length in seconds */
+	int			seconds;
+
+	/* the last time the aggregate was requested */
+	int			last_accessed;
+
+	/* The number of incremental updates since the window was scanned.      */
+	/* The window is rescanned when it exceeds the number of window values */
+	/* to restore invalidated minimum and maximum values.                  */
+	int			updates;
+
+	/* 0 - the window values are not cached, the aggregate must be rescanned */
+	unsigned char		valid;
+}
+zbx_vc_aggr_t;
+
+/* the buckets of percentile sketch copy used to move the sketch window, local for each process */
+static zbx_vc_sketch_bucket_t	vc_sketch_buckets[ZBX_VC_SKETCH_BUCKETS_MAX];
+
 /* the value cache item data */
 typedef struct
 {
@@ -183,6 +318,9 @@ typedef struct
 
 	/* the first (oldest) chunk of item history data              */
 	zbx_vc_chunk_t	*tail;
+
+	/* the registered time window aggregates                      */
+	zbx_vc_aggr_t	*aggrs;
 }
 zbx_vc_item_t;
 
@@ -207,11 +345,36 @@ typedef struct
 	/* the minimum number of bytes to be freed when cache runs out of space */
 	size_t		min_free_request;
 
+	/* the number of values stored in compressed chunks */
+	zbx_uint64_t	packed_values;
+
+	/* the size of compressed chunks */
+	zbx_uint64_t	packed_size;
+
+	/* The last assigned compressed chunk identifier. Stripes assign identifiers */
+	/* with step of stripe count starting from stripe index, so identifiers are  */
+	/* unique across stripes.                                                    */
+	zbx_uint64_t	packed_id;
+
+	/* the number of read and write locks and how many of them had to wait, the */
+	/* read locks are counted by processes and added when taking write lock     */
+	zbx_uint64_t	rdlocks;
+	zbx_uint64_t	rdlock_waits;
+	zbx_uint64_t	wrlocks;
+	zbx_uint64_t	wrlock_waits;
+
 	/* the cached items */
 	zbx_hashset_t	items;
 
 	/* the string pool for str, text and log item values */
 	zbx_hashset_t	strpool;
+
+	/* the stripe memory and lock */
+	zbx_mem_info_t	*mem;
+	zbx_rwlock_t	lock;
+
+	/* the stripe index */
+	int		index;
 }
 zbx_vc_cache_t;
 
@@ -229,10 +392,72 @@ zbx_vc_item_weight_t;
 ZBX_VECTOR_DECL(vc_itemweight, zbx_vc_item_weight_t)
 ZBX_VECTOR_IMPL(vc_itemweight, zbx_vc_item_weight_t)
 
+ZBX_VECTOR_IMPL(vc_range, zbx_vc_range_t)
+
+/* Items with different range start are loaded by the same history request if the */
+/* additionally read period does not exceed 1/ZBX_VC_PREFETCH_OVERREAD of the     */
+/* item range.                                                                    */
+#define ZBX_VC_PREFETCH_OVERREAD	8
+
+#define ZBX_VC_SNAPSHOT_MAGIC	"ZBXVCSNP"
+#define ZBX_VC_SNAPSHOT_VERSION	2
+
+/* value cache snapshot file header, followed by item records */
+typedef struct
+{
+	char		magic[8];
+	zbx_uint32_t	version;
+	zbx_uint32_t	item_size;	/* the size of saved item record structure */
+	zbx_uint32_t	value_size;	/* the size of saved value record structure */
+	int		saved;		/* the snapshot save time */
+	zbx_uint64_t	items_num;	/* the number of saved items */
+	zbx_hash_t	data_checksum;	/* the checksum of item records chained in saving order */
+	zbx_hash_t	checksum;	/* the checksum of the above fields */
+}
+zbx_vc_snapshot_t;
+
+/* value cache snapshot item record, followed by item value records in ascending order */
+typedef struct
+{
+	zbx_uint64_t	itemid;
+	zbx_uint64_t	hits;
+	zbx_uint64_t	size;		/* the record size including value records */
+	int		values_num;
+	int		active_range;
+	int		daily_range;
+	int		db_cached_from;
+	int		last_accessed;
+	int		last_hourly_num;
+	unsigned char	value_type;
+	unsigned char	status;
+	unsigned char	range_sync_hour;
+}
+zbx_vc_snapshot_item_t;
+
+/* value cache snapshot value record, string values are followed by value and log source strings */
+typedef struct
+{
+	zbx_timespec_t	ts;
+	union
+	{
+		double		dbl;
+		zbx_uint64_t	ui64;
+	}
+	value;
+	zbx_uint32_t	size;		/* the record size including strings */
+	zbx_uint32_t	value_len;	/* the value string length including terminating zero */
+	zbx_uint32_t	source_len;	/* the log source length including terminating zero, 0 - no source */
+	int		timestamp;
+	int		severity;
+	int		logeventid;
+}
+zbx_vc_snapshot_value_t;
+
 typedef enum
 {
 	ZBX_VC_UPDATE_STATS,
-	ZBX_VC_UPDATE_RANGE
+	ZBX_VC_UPDATE_RANGE,
+	ZBX_VC_UPDATE_AGGR
 }
 zbx_vc_item_update_type_t;
 
@@ -248,6 +473,12 @@ enum
 	ZBX_VC_UPDATE_RANGE_NOW
 };
 
+enum
+{
+	ZBX_VC_UPDATE_AGGR_SECONDS,
+	ZBX_VC_UPDATE_AGGR_NOW
+};
+
 typedef struct
 {
 	zbx_uint64_t			itemid;
@@ -275,12 +506,113 @@ static void	vc_cache_item_update(zbx_uint64_t itemid, zbx_vc_item_update_type_t
 	update->data[1] = arg2;
 }
 
-/* the value cache */
+/* the value cache stripes, items are assigned to stripes by itemid */
+static zbx_vc_cache_t	*vc_stripes[ZBX_VC_STRIPES_MAX];
+static int		vc_stripes_num = 0;
+
+/* the currently locked value cache stripe */
 static zbx_vc_cache_t	*vc_cache = NULL;
 
-#define	RDLOCK_CACHE	zbx_rwlock_rdlock(vc_lock);
-#define	WRLOCK_CACHE	zbx_rwlock_wrlock(vc_lock);
-#define	UNLOCK_CACHE	zbx_rwlock_unlock(vc_lock);
+/* the number of read locks taken by the process and not yet added to stripe statistics */
+static zbx_uint64_t	vc_rdlocks[ZBX_VC_STRIPES_MAX];
+static zbx_uint64_t	vc_rdlock_waits[ZBX_VC_STRIPES_MAX];
+
+#define ZBX_VC_LOCK_READ	0
+#define ZBX_VC_LOCK_WRITE	1
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vc_stripe_lock                                                   *
+ *                                                                            *
+ * Purpose: locks value cache stripe and makes it the current stripe          *
+ *                                                                            *
+ * Parameters: stripe - [IN] the stripe to lock (can be NULL if the cache is  *
+ *                           not initialized)                                 *
+ *             mode   - [IN] ZBX_VC_LOCK_READ or ZBX_VC_LOCK_WRITE            *
+ *                                                                            *
+ * Comments: The lock is first tried without waiting to count contention.     *
+ *                                                                            *
+ ******************************************************************************/
+static void	vc_stripe_lock(zbx_vc_cache_t *stripe, int mode)
+{
+	int	index, wait = 0;
+
+	if (NULL == (vc_cache = stripe))
+		return;
+
+	vc_mem = stripe->mem;
+	index = stripe->index;
+
+	if (ZBX_VC_LOCK_READ == mode)
+	{
+		vc_rdlocks[index]++;
+
+		if (FAIL == zbx_rwlock_tryrdlock(stripe->lock))
+		{
+			vc_rdlock_waits[index]++;
+			zbx_rwlock_rdlock(stripe->lock);
+		}
+
+		return;
+	}
+
+	if (FAIL == zbx_rwlock_trywrlock(stripe->lock))
+	{
+		wait = 1;
+		zbx_rwlock_wrlock(stripe->lock);
+	}
+
+	stripe->wrlocks++;
+	stripe->wrlock_waits += wait;
+
+	stripe->rdlocks += vc_rdlocks[index];
+	stripe->rdlock_waits += vc_rdlock_waits[index];
+	vc_rdlocks[index] = 0;
+	vc_rdlock_waits[index] = 0;
+}
+
+static void	vc_stripe_unlock(zbx_vc_cache_t *stripe)
+{
+	if (NULL != stripe)
+		zbx_rwlock_unlock(stripe->lock);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vc_get_stripe_index                                              *
+ *                                                                            *
+ * Purpose: returns index of the value cache stripe storing the item          *
+ *                                                                            *
+ ******************************************************************************/
+static int	vc_get_stripe_index(zbx_uint64_t itemid)
+{
+	return (int)(itemid % (zbx_uint64_t)vc_stripes_num);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vc_get_stripe                                                    *
+ *                                                                            *
+ * Purpose: returns the value cache stripe storing the item or NULL if value  *
+ *          cache is not initialized                                          *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_vc_cache_t	*vc_get_stripe(zbx_uint64_t itemid)
+{
+	if (0 == vc_stripes_num)
+		return NULL;
+
+	return vc_stripes[vc_get_stripe_index(itemid)];
+}
+
+#define	RDLOCK_STRIPE(stripe)	vc_stripe_lock(stripe, ZBX_VC_LOCK_READ)
+#define	WRLOCK_STRIPE(stripe)	vc_stripe_lock(stripe, ZBX_VC_LOCK_WRITE)
+#define	UNLOCK_STRIPE(stripe)	vc_stripe_unlock(stripe)
+
+/* relock the current stripe, used when releasing lock during database requests */
+#define	RDLOCK_CACHE	RDLOCK_STRIPE(vc_cache)
+#define	WRLOCK_CACHE	WRLOCK_STRIPE(vc_cache)
+#define	UNLOCK_CACHE	UNLOCK_STRIPE(vc_cache)
 
 /* function prototypes */
 static void	vc_history_record_copy(zbx_history_record_t *dst, const zbx_history_record_t *src, int value_type);
@@ -836,12 +1168,17 @@ static size_t	vc_release_unused_items(const zbx_vc_item_t *source_item)
  ******************************************************************************/
 void	zbx_vc_housekeeping_value_cache(void)
 {
+	int	i;
+
 	if (ZBX_VC_DISABLED == vc_state)
 		return;
 
-	WRLOCK_CACHE;
-	vc_release_unused_items(NULL);
-	UNLOCK_CACHE;
+	for (i = 0; i < vc_stripes_num; i++)
+	{
+		WRLOCK_STRIPE(vc_stripes[i]);
+		vc_release_unused_items(NULL);
+		UNLOCK_STRIPE(vc_stripes[i]);
+	}
 }
 
 /******************************************************************************
@@ -1427,6 +1764,181 @@ static int	vch_item_add_chunk(zbx_vc_item_t *item, int nslots, zbx_vc_chunk_t *i
 	return SUCCEED;
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: vch_chunk_slots                                                  *
+ *                                                                            *
+ * Purpose: gets chunk value slots                                            *
+ *                                                                            *
+ * Parameters: chunk - [IN] the chunk                                         *
+ *                                                                            *
+ * Return value: The chunk value slots, indexed by first_value..last_value.   *
+ *                                                                            *
+ * Comments: Compressed chunks are decoded into process local buffer, which   *
+ *           is valid until another compressed chunk is accessed. The values  *
+ *           of compressed chunks must not be modified.                       *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_history_record_t	*vch_chunk_slots(const zbx_vc_chunk_t *chunk)
+{
+	zbx_gorilla_state_t	decoder;
+	zbx_uint64_t		value;
+	int			i;
+
+	if (0 == chunk->packed_size)
+		return (zbx_history_record_t *)chunk->slots;
+
+	if (chunk->packed_id == vc_unpacked_id)
+		return vc_unpacked_slots;
+
+	zbx_gorilla_init(&decoder);
+
+	for (i = 0; i < chunk->slots_num; i++)
+	{
+		zbx_gorilla_decode(&decoder, (const unsigned char *)chunk->slots, &vc_unpacked_slots[i].timestamp,
+				&value);
+		memcpy(&vc_unpacked_slots[i].value, &value, sizeof(value));
+	}
+
+	vc_unpacked_id = chunk->packed_id;
+
+	return vc_unpacked_slots;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vch_item_replace_chunk                                           *
+ *                                                                            *
+ * Purpose: replaces item history data chunk with its compressed or           *
+ *          uncompressed copy                                                 *
+ *                                                                            *
+ * Parameters: item  - [IN/OUT] the chunk owner item                          *
+ *             chunk - [IN] the chunk to replace                              *
+ *             copy  - [IN] the chunk copy                                    *
+ *                                                                            *
+ ******************************************************************************/
+static void	vch_item_replace_chunk(zbx_vc_item_t *item, zbx_vc_chunk_t *chunk, zbx_vc_chunk_t *copy)
+{
+	copy->prev = chunk->prev;
+	copy->next = chunk->next;
+
+	if (NULL != chunk->prev)
+		chunk->prev->next = copy;
+	else
+		item->tail = copy;
+
+	if (NULL != chunk->next)
+		chunk->next->prev = copy;
+	else
+		item->head = copy;
+
+	if (0 != chunk->packed_size)
+	{
+		vc_cache->packed_values -= chunk->slots_num;
+		vc_cache->packed_size -= offsetof(zbx_vc_chunk_t, slots) + chunk->packed_size;
+	}
+
+	/* only numeric value chunks are compressed, so there are no value resources to free */
+	__vc_mem_free_func(chunk);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vch_item_pack_chunk                                              *
+ *                                                                            *
+ * Purpose: compresses sealed item history data chunk                         *
+ *                                                                            *
+ * Parameters: item  - [IN/OUT] the chunk owner item                          *
+ *             chunk - [IN] the chunk to compress                             *
+ *                                                                            *
+ * Comments: The chunk is left uncompressed if compression is disabled, the   *
+ *           item is not numeric, the chunk is the head chunk or compression  *
+ *           would not reduce the chunk size.                                 *
+ *           Compression is optional, so cache space is not released to      *
+ *           allocate the compressed chunk.                                   *
+ *                                                                            *
+ ******************************************************************************/
+static void	vch_item_pack_chunk(zbx_vc_item_t *item, zbx_vc_chunk_t *chunk)
+{
+	static unsigned char	data[ZBX_VC_MAX_PACKED_SIZE];
+	zbx_gorilla_state_t	encoder;
+	zbx_vc_chunk_t		*packed;
+	size_t			size;
+	zbx_uint64_t		value;
+	int			i;
+
+	if (0 == CONFIG_VALUE_CACHE_COMPRESSION || 0 != chunk->packed_size || chunk == item->head)
+		return;
+
+	if (ITEM_VALUE_TYPE_FLOAT != item->value_type && ITEM_VALUE_TYPE_UINT64 != item->value_type)
+		return;
+
+	zbx_gorilla_init(&encoder);
+
+	/* float and unsigned values are encoded as their 64 bit patterns */
+	for (i = chunk->first_value; i <= chunk->last_value; i++)
+	{
+		memcpy(&value, &chunk->slots[i].value, sizeof(value));
+		zbx_gorilla_encode(&encoder, data, sizeof(data), &chunk->slots[i].timestamp, value);
+	}
+
+	size = offsetof(zbx_vc_chunk_t, slots) + (encoder.bits_num + 7) / 8;
+
+	if (size >= sizeof(zbx_vc_chunk_t) + (chunk->slots_num - 1) * sizeof(zbx_history_record_t))
+		return;
+
+	if (NULL == (packed = (zbx_vc_chunk_t *)__vc_mem_malloc_func(NULL, size)))
+		return;
+
+	packed->first_value = 0;
+	packed->last_value = chunk->last_value - chunk->first_value;
+	packed->slots_num = packed->last_value + 1;
+	packed->packed_size = (int)(size - offsetof(zbx_vc_chunk_t, slots));
+
+	packed->packed_id = (vc_cache->packed_id += (zbx_uint64_t)vc_stripes_num);
+	memcpy(packed->slots, data, packed->packed_size);
+
+	vch_item_replace_chunk(item, chunk, packed);
+
+	vc_cache->packed_values += packed->slots_num;
+	vc_cache->packed_size += size;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vch_item_unpack_chunk                                            *
+ *                                                                            *
+ * Purpose: decompresses item history data chunk so its values can be         *
+ *          modified                                                          *
+ *                                                                            *
+ * Parameters: item  - [IN/OUT] the chunk owner item                          *
+ *             chunk - [IN] the compressed chunk                              *
+ *                                                                            *
+ * Return value: The uncompressed chunk replacing the compressed one or NULL  *
+ *               if there was not enough space in cache.                      *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_vc_chunk_t	*vch_item_unpack_chunk(zbx_vc_item_t *item, zbx_vc_chunk_t *chunk)
+{
+	zbx_vc_chunk_t	*unpacked;
+
+	if (NULL == (unpacked = (zbx_vc_chunk_t *)vc_item_malloc(item, sizeof(zbx_vc_chunk_t) +
+			(chunk->slots_num - 1) * sizeof(zbx_history_record_t))))
+	{
+		return NULL;
+	}
+
+	memset(unpacked, 0, sizeof(zbx_vc_chunk_t));
+	unpacked->first_value = chunk->first_value;
+	unpacked->last_value = chunk->last_value;
+	unpacked->slots_num = chunk->slots_num;
+	memcpy(unpacked->slots, vch_chunk_slots(chunk), chunk->slots_num * sizeof(zbx_history_record_t));
+
+	vch_item_replace_chunk(item, chunk, unpacked);
+
+	return unpacked;
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: vch_chunk_find_last_value_before                                 *
@@ -1445,10 +1957,11 @@ static int	vch_item_add_chunk(zbx_vc_item_t *item, int nslots, zbx_vc_chunk_t *i
  ******************************************************************************/
 static int	vch_chunk_find_last_value_before(const zbx_vc_chunk_t *chunk, const zbx_timespec_t *ts)
 {
-	int	start = chunk->first_value, end = chunk->last_value, middle;
+	int				start = chunk->first_value, end = chunk->last_value, middle;
+	const zbx_history_record_t	*slots = vch_chunk_slots(chunk);
 
 	/* check if the last value timestamp is already greater or equal to the specified timestamp */
-	if (0 >= zbx_timespec_compare(&chunk->slots[end].timestamp, ts))
+	if (0 >= zbx_timespec_compare(&slots[end].timestamp, ts))
 		return end;
 
 	/* chunk contains only one value, which did not pass the above check, return failure */
@@ -1460,13 +1973,13 @@ static int	vch_chunk_find_last_value_before(const zbx_vc_chunk_t *chunk, const z
 	{
 		middle = start + (end - start) / 2;
 
-		if (0 < zbx_timespec_compare(&chunk->slots[middle].timestamp, ts))
+		if (0 < zbx_timespec_compare(&slots[middle].timestamp, ts))
 		{
 			end = middle;
 			continue;
 		}
 
-		if (0 >= zbx_timespec_compare(&chunk->slots[middle + 1].timestamp, ts))
+		if (0 >= zbx_timespec_compare(&slots[middle + 1].timestamp, ts))
 		{
 			start = middle;
 			continue;
@@ -1512,7 +2025,7 @@ static int	vch_item_get_last_value(const zbx_vc_item_t *item, const zbx_timespec
 
 	if (0 < zbx_timespec_compare(&chunk->slots[index].timestamp, ts))
 	{
-		while (0 < zbx_timespec_compare(&chunk->slots[chunk->first_value].timestamp, ts))
+		while (0 < zbx_timespec_compare(&vch_chunk_slots(chunk)[chunk->first_value].timestamp, ts))
 		{
 			chunk = chunk->prev;
 			/* there are no values for requested range, return failure */
@@ -1656,6 +2169,19 @@ static size_t	vch_item_free_chunk(zbx_vc_item_t *item, zbx_vc_chunk_t *chunk)
 {
 	size_t	freed;
 
+	if (0 != chunk->packed_size)
+	{
+		freed = offsetof(zbx_vc_chunk_t, slots) + chunk->packed_size;
+		item->values_total -= chunk->last_value - chunk->first_value + 1;
+
+		vc_cache->packed_values -= chunk->slots_num;
+		vc_cache->packed_size -= freed;
+
+		__vc_mem_free_func(chunk);
+
+		return freed;
+	}
+
 	freed = sizeof(zbx_vc_chunk_t) + (chunk->slots_num - 1) * sizeof(zbx_history_record_t);
 	freed += vc_item_free_values(item, chunk->slots, chunk->first_value, chunk->last_value);
 
@@ -1707,16 +2233,18 @@ static void	vch_item_clean_cache(zbx_vc_item_t *item)
 
 	if (0 != item->active_range)
 	{
-		zbx_vc_chunk_t	*tail = item->tail;
-		zbx_vc_chunk_t	*chunk = tail;
-		int		timestamp;
+		zbx_vc_chunk_t		*tail = item->tail;
+		zbx_vc_chunk_t		*chunk = tail;
+		zbx_history_record_t	*slots;
+		int			timestamp, last_sec, head_sec;
 
 		timestamp = time(NULL) - item->active_range;
+		head_sec = item->head->slots[item->head->last_value].timestamp.sec;
 
 		/* try to remove chunks with all history values older than maximum request range */
-		while (NULL != chunk && chunk->slots[chunk->last_value].timestamp.sec < timestamp &&
-				chunk->slots[chunk->last_value].timestamp.sec !=
-						item->head->slots[item->head->last_value].timestamp.sec)
+		while (NULL != chunk &&
+				(last_sec = vch_chunk_slots(chunk)[chunk->last_value].timestamp.sec) < timestamp &&
+				last_sec != head_sec)
 		{
 			/* don't remove the head chunk */
 			if (NULL == (next = chunk->next))
@@ -1730,18 +2258,19 @@ static void	vch_item_clean_cache(zbx_vc_item_t *item)
 			/* In this case increase the first value index of the next chunk until the first  */
 			/* value timestamp is greater.                                                    */
 
-			if (next->slots[next->first_value].timestamp.sec != next->slots[next->last_value].timestamp.sec)
+			slots = vch_chunk_slots(next);
+
+			if (slots[next->first_value].timestamp.sec != slots[next->last_value].timestamp.sec)
 			{
-				while (next->slots[next->first_value].timestamp.sec ==
-						chunk->slots[chunk->last_value].timestamp.sec)
+				while (slots[next->first_value].timestamp.sec == last_sec)
 				{
-					vc_item_free_values(item, next->slots, next->first_value, next->first_value);
+					vc_item_free_values(item, slots, next->first_value, next->first_value);
 					next->first_value++;
 				}
 			}
 
 			/* set the database cached from timestamp to the last (oldest) removed value timestamp + 1 */
-			item->db_cached_from = chunk->slots[chunk->last_value].timestamp.sec + 1;
+			item->db_cached_from = last_sec + 1;
 
 			vch_item_remove_chunk(item, chunk);
 
@@ -1768,24 +2297,25 @@ static void	vch_item_clean_cache(zbx_vc_item_t *item)
  ******************************************************************************/
 static void	vch_item_remove_values(zbx_vc_item_t *item, int timestamp)
 {
-	zbx_vc_chunk_t	*chunk = item->tail;
+	zbx_vc_chunk_t		*chunk = item->tail;
+	zbx_history_record_t	*slots;
 
 	if (ZBX_ITEM_STATUS_CACHED_ALL == item->status)
 		item->status = 0;
 
 	/* try to remove chunks with all history values older than the timestamp */
-	while (NULL != chunk && chunk->slots[chunk->first_value].timestamp.sec < timestamp)
+	while (NULL != chunk && (slots = vch_chunk_slots(chunk))[chunk->first_value].timestamp.sec < timestamp)
 	{
 		zbx_vc_chunk_t	*next;
 
 		/* If chunk contains values with timestamp greater or equal - remove */
 		/* only the values with less timestamp. Otherwise remove the while   */
 		/* chunk and check next one.                                         */
-		if (chunk->slots[chunk->last_value].timestamp.sec >= timestamp)
+		if (slots[chunk->last_value].timestamp.sec >= timestamp)
 		{
-			while (chunk->slots[chunk->first_value].timestamp.sec < timestamp)
+			while (slots[chunk->first_value].timestamp.sec < timestamp)
 			{
-				vc_item_free_values(item, chunk->slots, chunk->first_value, chunk->first_value);
+				vc_item_free_values(item, slots, chunk->first_value, chunk->first_value);
 				chunk->first_value++;
 			}
 
@@ -1818,12 +2348,13 @@ static void	vch_item_remove_values(zbx_vc_item_t *item, int timestamp)
 static int	vch_item_add_value_at_head(zbx_vc_item_t *item, const zbx_history_record_t *value)
 {
 	int		ret = FAIL, index, sindex, nslots = 0;
-	zbx_vc_chunk_t	*chunk, *schunk;
+	zbx_vc_chunk_t	*chunk, *schunk, *head = item->head;
 
 	if (NULL != item->head &&
 			0 < zbx_history_record_compare_asc_func(&item->head->slots[item->head->last_value], value))
 	{
-		if (0 < zbx_history_record_compare_asc_func(&item->tail->slots[item->tail->first_value], value))
+		if (0 < zbx_history_record_compare_asc_func(&vch_chunk_slots(item->tail)[item->tail->first_value],
+				value))
 		{
 			/* If the added value has the same or older timestamp as the first value in cache */
 			/* we can't add it to keep cache consistency. Additionally we must make sure no   */
@@ -1877,6 +2408,10 @@ static int	vch_item_add_value_at_head(zbx_vc_item_t *item, const zbx_history_rec
 					goto out;
 				}
 
+				/* the values are shifted through the chunk, so it must be decompressed */
+				if (0 != schunk->packed_size && NULL == (schunk = vch_item_unpack_chunk(item, schunk)))
+					goto out;
+
 				sindex = schunk->last_value;
 			}
 		}
@@ -1905,6 +2440,10 @@ static int	vch_item_add_value_at_head(zbx_vc_item_t *item, const zbx_history_rec
 	if (SUCCEED != vch_item_copy_value(item, chunk, index, value))
 		goto out;
 
+	/* compress the previous head chunk when a new head chunk was added */
+	if (head != item->head && NULL != item->head->prev)
+		vch_item_pack_chunk(item, item->head->prev);
+
 	ret = SUCCEED;
 out:
 	return ret;
@@ -1935,7 +2474,7 @@ static int	vch_item_add_values_at_tail(zbx_vc_item_t *item, const zbx_history_re
 	/* skip values already added to the item cache by another process */
 	if (NULL != item->tail)
 	{
-		int	sec = item->tail->slots[item->tail->first_value].timestamp.sec;
+		int	sec = vch_chunk_slots(item->tail)[item->tail->first_value].timestamp.sec;
 
 		while (--count >= 0 && values[count].timestamp.sec >= sec)
 			;
@@ -1947,11 +2486,15 @@ static int	vch_item_add_values_at_tail(zbx_vc_item_t *item, const zbx_history_re
 		int	copy_slots, nslots = 0;
 
 		/* find the number of free slots on the left side in first (tail) chunk */
-		if (NULL != item->tail)
+		if (NULL != item->tail && 0 == item->tail->packed_size)
 			nslots = item->tail->first_value;
 
 		if (0 == nslots)
 		{
+			/* compress the filled tail chunk before adding a new one */
+			if (NULL != item->tail)
+				vch_item_pack_chunk(item, item->tail);
+
 			nslots = vch_item_chunk_slot_count(item, count);
 
 			if (FAIL == vch_item_add_chunk(item, nslots, item->tail))
@@ -1969,6 +2512,9 @@ static int	vch_item_add_values_at_tail(zbx_vc_item_t *item, const zbx_history_re
 			goto out;
 	}
 
+	if (NULL != item->tail)
+		vch_item_pack_chunk(item, item->tail);
+
 	ret = SUCCEED;
 out:
 	return ret;
@@ -2008,7 +2554,7 @@ static int	vch_item_cache_values_by_time(zbx_vc_item_t **item, int range_start)
 	if (NULL != (*item)->tail)
 	{
 		/* we need to get item values before the first cached value, but not including it */
-		range_end = (*item)->tail->slots[(*item)->tail->first_value].timestamp.sec - 1;
+		range_end = vch_chunk_slots((*item)->tail)[(*item)->tail->first_value].timestamp.sec - 1;
 	}
 	else
 		range_end = ZBX_JAN_2038;
@@ -2115,7 +2661,7 @@ static int	vch_item_cache_values_by_time_and_count(zbx_vc_item_t **item, int ran
 
 	/* get the end timestamp to which (including) the values should be cached */
 	if (NULL != (*item)->head)
-		range_end = (*item)->tail->slots[(*item)->tail->first_value].timestamp.sec - 1;
+		range_end = vch_chunk_slots((*item)->tail)[(*item)->tail->first_value].timestamp.sec - 1;
 	else
 		range_end = ZBX_JAN_2038;
 
@@ -2171,7 +2717,7 @@ static int	vch_item_cache_values_by_time_and_count(zbx_vc_item_t **item, int ran
 	if ((count <= records.values_num || 0 == range_start) && 0 != records.values_num)
 	{
 		vc_item_update_db_cached_from(*item,
-				(*item)->tail->slots[(*item)->tail->first_value].timestamp.sec);
+				vch_chunk_slots((*item)->tail)[(*item)->tail->first_value].timestamp.sec);
 	}
 	else if (0 != range_start)
 		vc_item_update_db_cached_from(*item, range_start);
@@ -2198,9 +2744,10 @@ out:
 static void	vch_item_get_values_by_time(const zbx_vc_item_t *item, zbx_vector_history_record_t *values, int seconds,
 		const zbx_timespec_t *ts)
 {
-	int		index, now;
-	zbx_timespec_t	start = {ts->sec - seconds, ts->ns};
-	zbx_vc_chunk_t	*chunk;
+	int			index, now;
+	zbx_timespec_t		start = {ts->sec - seconds, ts->ns};
+	zbx_vc_chunk_t		*chunk;
+	zbx_history_record_t	*slots;
 
 	/* Check if maximum request range is not set and all data are cached.  */
 	/* Because that indicates there was a count based request with unknown */
@@ -2220,10 +2767,10 @@ static void	vch_item_get_values_by_time(const zbx_vc_item_t *item, zbx_vector_hi
 	}
 
 	/* fill the values vector with item history values until the start timestamp is reached */
-	while (0 < zbx_timespec_compare(&chunk->slots[chunk->last_value].timestamp, &start))
+	while (0 < zbx_timespec_compare(&(slots = vch_chunk_slots(chunk))[chunk->last_value].timestamp, &start))
 	{
-		while (index >= chunk->first_value && 0 < zbx_timespec_compare(&chunk->slots[index].timestamp, &start))
-			vc_history_record_vector_append(values, item->value_type, &chunk->slots[index--]);
+		while (index >= chunk->first_value && 0 < zbx_timespec_compare(&slots[index].timestamp, &start))
+			vc_history_record_vector_append(values, item->value_type, &slots[index--]);
 
 		if (NULL == (chunk = chunk->prev))
 			break;
@@ -2252,9 +2799,10 @@ static void	vch_item_get_values_by_time(const zbx_vc_item_t *item, zbx_vector_hi
 static void	vch_item_get_values_by_time_and_count(zbx_vc_item_t *item, zbx_vector_history_record_t *values,
 		int seconds, int count, const zbx_timespec_t *ts)
 {
-	int		index, now, range_timestamp;
-	zbx_vc_chunk_t	*chunk;
-	zbx_timespec_t	start;
+	int			index, now, range_timestamp;
+	zbx_vc_chunk_t		*chunk;
+	zbx_history_record_t	*slots;
+	zbx_timespec_t		start;
 
 	/* set start timestamp of the requested time period */
 	if (0 != seconds)
@@ -2277,11 +2825,11 @@ static void	vch_item_get_values_by_time_and_count(zbx_vc_item_t *item, zbx_vecto
 	/* fill the values vector with item history values until the <count> values are read    */
 	/* or no more values within specified time period                                       */
 	/* fill the values vector with item history values until the start timestamp is reached */
-	while (0 < zbx_timespec_compare(&chunk->slots[chunk->last_value].timestamp, &start))
+	while (0 < zbx_timespec_compare(&(slots = vch_chunk_slots(chunk))[chunk->last_value].timestamp, &start))
 	{
-		while (index >= chunk->first_value && 0 < zbx_timespec_compare(&chunk->slots[index].timestamp, &start))
+		while (index >= chunk->first_value && 0 < zbx_timespec_compare(&slots[index].timestamp, &start))
 		{
-			vc_history_record_vector_append(values, item->value_type, &chunk->slots[index--]);
+			vc_history_record_vector_append(values, item->value_type, &slots[index--]);
 
 			if (values->values_num == count)
 				goto out;
@@ -2389,365 +2937,2393 @@ out:
 
 /******************************************************************************
  *                                                                            *
- * Function: vch_item_free_cache                                              *
+ * Function: vc_aggr_free                                                     *
  *                                                                            *
- * Purpose: frees resources allocated for item history data                   *
+ * Purpose: frees window aggregate                                            *
  *                                                                            *
- * Parameters: item    - [IN] the item                                        *
+ * Parameters: aggr - [IN] the window aggregate                               *
  *                                                                            *
- * Return value: the size of freed memory (bytes)                             *
+ * Return value: the number of bytes freed                                    *
  *                                                                            *
  ******************************************************************************/
-static size_t	vch_item_free_cache(zbx_vc_item_t *item)
+static size_t	vc_aggr_free(zbx_vc_aggr_t *aggr)
 {
-	size_t	freed = 0;
-
-	zbx_vc_chunk_t	*chunk = item->tail;
+	size_t	freed = sizeof(zbx_vc_aggr_t);
 
-	while (NULL != chunk)
+	if (NULL != aggr->sketch.buckets)
 	{
-		zbx_vc_chunk_t	*next = chunk->next;
-
-		freed += vch_item_free_chunk(item, chunk);
-		chunk = next;
+		__vc_mem_free_func(aggr->sketch.buckets);
+		freed += sizeof(zbx_vc_sketch_bucket_t) * (size_t)aggr->sketch.buckets_alloc;
 	}
-	item->values_total = 0;
-	item->head = NULL;
+
+	__vc_mem_free_func(aggr);
+
+	return freed;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vch_item_free_cache                                              *
+ *                                                                            *
+ * Purpose: frees resources allocated for item history data                   *
+ *                                                                            *
+ * Parameters: item    - [IN] the item                                        *
+ *                                                                            *
+ * Return value: the size of freed memory (bytes)                             *
+ *                                                                            *
+ ******************************************************************************/
+static size_t	vch_item_free_cache(zbx_vc_item_t *item)
+{
+	size_t	freed = 0;
+
+	zbx_vc_chunk_t	*chunk = item->tail;
+
+	while (NULL != chunk)
+	{
+		zbx_vc_chunk_t	*next = chunk->next;
+
+		freed += vch_item_free_chunk(item, chunk);
+		chunk = next;
+	}
+	item->values_total = 0;
+	item->head = NULL;
 	item->tail = NULL;
 
+	/* the aggregates are calculated from cached values, so they are dropped together */
+	while (NULL != item->aggrs)
+	{
+		zbx_vc_aggr_t	*aggr = item->aggrs;
+
+		item->aggrs = aggr->next;
+		freed += vc_aggr_free(aggr);
+	}
+
 	return freed;
 }
 
-/******************************************************************************************************************
- *                                                                                                                *
- * Public API                                                                                                     *
- *                                                                                                                *
- ******************************************************************************************************************/
+/******************************************************************************
+ *                                                                            *
+ * Function: vc_aggregate_sum                                                 *
+ *                                                                            *
+ * Purpose: adds value to the aggregate total, accumulating rounding error    *
+ *          of the addition separately                                        *
+ *                                                                            *
+ * Parameters: aggregate - [IN/OUT] the aggregate                             *
+ *             value     - [IN] the value to add                              *
+ *                                                                            *
+ * Comments: Aggregates are updated by adding and removing values of moving   *
+ *           window, so without the compensation a large value leaving the    *
+ *           window would leave its rounding error in the total.              *
+ *                                                                            *
+ ******************************************************************************/
+static void	vc_aggregate_sum(zbx_vc_aggregate_t *aggregate, double value)
+{
+	double	total = aggregate->total + value;
+
+	if (fabs(aggregate->total) >= fabs(value))
+		aggregate->total_error += (aggregate->total - total) + value;
+	else
+		aggregate->total_error += (value - total) + aggregate->total;
+
+	aggregate->total = total;
+}
 
 /******************************************************************************
  *                                                                            *
- * Function: zbx_vc_init                                                      *
+ * Function: vc_aggregate_finish                                              *
  *                                                                            *
- * Purpose: initializes value cache                                           *
+ * Purpose: applies the accumulated rounding error to the aggregate returned  *
+ *          to caller                                                         *
+ *                                                                            *
+ * Parameters: aggregate  - [IN/OUT] the aggregate                            *
+ *             value_type - [IN] the value type (float or unsigned)           *
  *                                                                            *
  ******************************************************************************/
-int	zbx_vc_init(char **error)
+static void	vc_aggregate_finish(zbx_vc_aggregate_t *aggregate, int value_type)
 {
-	zbx_uint64_t	size_reserved;
-	int		ret = FAIL;
+	aggregate->total += aggregate->total_error;
+	aggregate->total_error = 0;
 
-	if (0 == CONFIG_VALUE_CACHE_SIZE)
-		return SUCCEED;
+	if (ITEM_VALUE_TYPE_FLOAT == value_type)
+		aggregate->sum.dbl = aggregate->total;
+}
 
-	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+/******************************************************************************
+ *                                                                            *
+ * Function: vc_aggregate_add                                                 *
+ *                                                                            *
+ * Purpose: adds value to the aggregate                                       *
+ *                                                                            *
+ * Parameters: aggregate  - [IN/OUT] the aggregate                            *
+ *             value_type - [IN] the value type (float or unsigned)           *
+ *             value      - [IN] the value to add                             *
+ *                                                                            *
+ ******************************************************************************/
+static void	vc_aggregate_add(zbx_vc_aggregate_t *aggregate, int value_type, const history_value_t *value)
+{
+	if (ITEM_VALUE_TYPE_FLOAT == value_type)
+	{
+		if (0 == aggregate->count || value->dbl < aggregate->min.dbl)
+			aggregate->min.dbl = value->dbl;
 
-	if (SUCCEED != (ret = zbx_rwlock_create(&vc_lock, ZBX_RWLOCK_VALUECACHE, error)))
-		goto out;
+		if (0 == aggregate->count || value->dbl > aggregate->max.dbl)
+			aggregate->max.dbl = value->dbl;
 
-	size_reserved = zbx_mem_required_size(1, "value cache size", "ValueCacheSize");
+		/* float sum is set from total when aggregate is returned */
+		vc_aggregate_sum(aggregate, value->dbl);
+	}
+	else
+	{
+		if (0 == aggregate->count || value->ui64 < aggregate->min.ui64)
+			aggregate->min.ui64 = value->ui64;
 
-	if (SUCCEED != zbx_mem_create(&vc_mem, CONFIG_VALUE_CACHE_SIZE, "value cache size", "ValueCacheSize", 1, error))
-		goto out;
+		if (0 == aggregate->count || value->ui64 > aggregate->max.ui64)
+			aggregate->max.ui64 = value->ui64;
 
-	CONFIG_VALUE_CACHE_SIZE -= size_reserved;
+		aggregate->sum.ui64 += value->ui64;
+		vc_aggregate_sum(aggregate, (double)value->ui64);
+	}
 
-	vc_cache = (zbx_vc_cache_t *)__vc_mem_malloc_func(vc_cache, sizeof(zbx_vc_cache_t));
+	aggregate->count++;
+}
 
-	if (NULL == vc_cache)
+/******************************************************************************
+ *                                                                            *
+ * Function: vc_aggregate_remove                                              *
+ *                                                                            *
+ * Purpose: removes value from the aggregate                                  *
+ *                                                                            *
+ * Parameters: aggregate  - [IN/OUT] the aggregate                            *
+ *             value_type - [IN] the value type (float or unsigned)           *
+ *             value      - [IN] the value to remove                          *
+ *                                                                            *
+ * Comments: The minimum and maximum values cannot be restored without        *
+ *           scanning the remaining values, so removing a value matching      *
+ *           either of them invalidates both until the window is rescanned.   *
+ *                                                                            *
+ ******************************************************************************/
+static void	vc_aggregate_remove(zbx_vc_aggregate_t *aggregate, int value_type, const history_value_t *value)
+{
+	if (0 == --aggregate->count)
 	{
-		*error = zbx_strdup(*error, "cannot allocate value cache header");
-		goto out;
+		memset(aggregate, 0, sizeof(zbx_vc_aggregate_t));
+		aggregate->flags = ZBX_VC_AGGREGATE_MINMAX;
+		return;
 	}
-	memset(vc_cache, 0, sizeof(zbx_vc_cache_t));
 
-	zbx_hashset_create_ext(&vc_cache->items, VC_ITEMS_INIT_SIZE,
-			ZBX_DEFAULT_UINT64_HASH_FUNC, ZBX_DEFAULT_UINT64_COMPARE_FUNC, NULL,
-			__vc_mem_malloc_func, __vc_mem_realloc_func, __vc_mem_free_func);
+	if (ITEM_VALUE_TYPE_FLOAT == value_type)
+	{
+		if (value->dbl <= aggregate->min.dbl || value->dbl >= aggregate->max.dbl)
+			aggregate->flags &= ~ZBX_VC_AGGREGATE_MINMAX;
 
-	if (NULL == vc_cache->items.slots)
+		vc_aggregate_sum(aggregate, -value->dbl);
+	}
+	else
 	{
-		*error = zbx_strdup(*error, "cannot allocate value cache data storage");
-		goto out;
+		if (value->ui64 <= aggregate->min.ui64 || value->ui64 >= aggregate->max.ui64)
+			aggregate->flags &= ~ZBX_VC_AGGREGATE_MINMAX;
+
+		aggregate->sum.ui64 -= value->ui64;
+		vc_aggregate_sum(aggregate, -(double)value->ui64);
 	}
+}
 
-	zbx_hashset_create_ext(&vc_cache->strpool, VC_STRPOOL_INIT_SIZE,
-			vc_strpool_hash_func, vc_strpool_compare_func, NULL,
-			__vc_mem_malloc_func, __vc_mem_realloc_func, __vc_mem_free_func);
+/******************************************************************************
+ *                                                                            *
+ * Function: vc_sketch_key                                                    *
+ *                                                                            *
+ * Purpose: gets percentile sketch bucket key of the value                    *
+ *                                                                            *
+ * Parameters: value - [IN] the value                                         *
+ *                                                                            *
+ * Return value: The bucket key. Keys are ordered in the same way as values.  *
+ *                                                                            *
+ ******************************************************************************/
+static int	vc_sketch_key(double value)
+{
+	double	abs_value = fabs(value);
+	int	key;
+
+	if (ZBX_VC_SKETCH_VALUE_MIN > abs_value)
+		return 0;
+
+	/* bucket i holds values in range (gamma^(i-1), gamma^i] */
+	key = (int)ceil(log(abs_value) / vc_sketch_log_gamma) - vc_sketch_index_min + 1;
+
+	return 0 < value ? key : -key;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vc_sketch_key_value                                              *
+ *                                                                            *
+ * Purpose: gets the value representing percentile sketch bucket             *
+ *                                                                            *
+ * Parameters: key - [IN] the bucket key                                      *
+ *                                                                            *
+ * Return value: The value within ZBX_VC_SKETCH_ACCURACY relative distance    *
+ *               from all bucket values.                                      *
+ *                                                                            *
+ ******************************************************************************/
+static double	vc_sketch_key_value(int key)
+{
+	double	value;
+
+	if (0 == key)
+		return 0;
+
+	value = 2 * exp((abs(key) + vc_sketch_index_min - 1) * vc_sketch_log_gamma) / (ZBX_VC_SKETCH_GAMMA + 1);
+
+	return 0 < key ? value : -value;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vc_sketch_find                                                   *
+ *                                                                            *
+ * Purpose: finds percentile sketch bucket position                           *
+ *                                                                            *
+ * Parameters: sketch - [IN] the percentile sketch                            *
+ *             key    - [IN] the bucket key                                   *
+ *                                                                            *
+ * Return value: The index of the first bucket with key not less than the     *
+ *               specified key.                                               *
+ *                                                                            *
+ ******************************************************************************/
+static int	vc_sketch_find(const zbx_vc_sketch_t *sketch, int key)
+{
+	int	lo = 0, hi = sketch->buckets_num;
 
-	if (NULL == vc_cache->strpool.slots)
+	while (lo < hi)
 	{
-		*error = zbx_strdup(*error, "cannot allocate string pool for value cache data storage");
-		goto out;
+		int	mid = lo + (hi - lo) / 2;
+
+		if (sketch->buckets[mid].key < key)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
 
-	/* the free space request should be 5% of cache size, but no more than 128KB */
-	vc_cache->min_free_request = (CONFIG_VALUE_CACHE_SIZE / 100) * 5;
-	if (vc_cache->min_free_request > 128 * ZBX_KIBIBYTE)
-		vc_cache->min_free_request = 128 * ZBX_KIBIBYTE;
+	return lo;
+}
 
-	zbx_vector_vc_itemupdate_create(&vc_itemupdates);
-	zbx_vector_vc_itemupdate_reserve(&vc_itemupdates, 256);
+/******************************************************************************
+ *                                                                            *
+ * Function: vc_sketch_add                                                    *
+ *                                                                            *
+ * Purpose: adds value to percentile sketch                                   *
+ *                                                                            *
+ * Parameters: sketch - [IN/OUT] the percentile sketch                        *
+ *             value  - [IN] the value to add                                 *
+ *                                                                            *
+ * Comments: The sketch is invalidated if the value range needs more than     *
+ *           ZBX_VC_SKETCH_BUCKETS_MAX buckets or there is no memory for more *
+ *           buckets. Cache space is not released for sketch buckets, as the *
+ *           sketch is only an optional accelerator. Process local sketch     *
+ *           copies are allocated with the maximum number of buckets and are  *
+ *           never reallocated.                                               *
+ *                                                                            *
+ ******************************************************************************/
+static void	vc_sketch_add(zbx_vc_sketch_t *sketch, double value)
+{
+	int	key, index;
 
-	ret = SUCCEED;
-out:
-	zbx_vc_disable();
+	if (0 == sketch->valid)
+		return;
 
-	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
+	key = vc_sketch_key(value);
+	index = vc_sketch_find(sketch, key);
 
-	return ret;
+	if (index < sketch->buckets_num && key == sketch->buckets[index].key)
+	{
+		sketch->buckets[index].count++;
+		return;
+	}
+
+	if (sketch->buckets_num == sketch->buckets_alloc)
+	{
+		zbx_vc_sketch_bucket_t	*buckets;
+		int			buckets_alloc;
+
+		if (ZBX_VC_SKETCH_BUCKETS_MAX == sketch->buckets_alloc)
+		{
+			sketch->valid = 0;
+			return;
+		}
+
+		buckets_alloc = MIN(sketch->buckets_alloc * 2, ZBX_VC_SKETCH_BUCKETS_MAX);
+
+		if (NULL == (buckets = (zbx_vc_sketch_bucket_t *)__vc_mem_malloc_func(NULL,
+				sizeof(zbx_vc_sketch_bucket_t) * (size_t)buckets_alloc)))
+		{
+			sketch->valid = 0;
+			return;
+		}
+
+		memcpy(buckets, sketch->buckets, sizeof(zbx_vc_sketch_bucket_t) * (size_t)sketch->buckets_num);
+		__vc_mem_free_func(sketch->buckets);
+
+		sketch->buckets = buckets;
+		sketch->buckets_alloc = buckets_alloc;
+	}
+
+	memmove(sketch->buckets + index + 1, sketch->buckets + index,
+			sizeof(zbx_vc_sketch_bucket_t) * (size_t)(sketch->buckets_num - index));
+
+	sketch->buckets[index].key = key;
+	sketch->buckets[index].count = 1;
+	sketch->buckets_num++;
 }
 
 /******************************************************************************
  *                                                                            *
- * Function: zbx_vc_destroy                                                   *
+ * Function: vc_sketch_remove                                                 *
  *                                                                            *
- * Purpose: destroys value cache                                              *
+ * Purpose: removes value from percentile sketch                              *
+ *                                                                            *
+ * Parameters: sketch - [IN/OUT] the percentile sketch                        *
+ *             value  - [IN] the value to remove                              *
  *                                                                            *
  ******************************************************************************/
-void	zbx_vc_destroy(void)
+static void	vc_sketch_remove(zbx_vc_sketch_t *sketch, double value)
 {
-	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+	int	key, index;
+
+	if (0 == sketch->valid)
+		return;
 
-	if (NULL != vc_cache)
+	key = vc_sketch_key(value);
+	index = vc_sketch_find(sketch, key);
+
+	if (index == sketch->buckets_num || key != sketch->buckets[index].key)
 	{
-		zbx_vector_vc_itemupdate_destroy(&vc_itemupdates);
+		THIS_SHOULD_NEVER_HAPPEN;
+		sketch->valid = 0;
+		return;
+	}
 
-		zbx_rwlock_destroy(&vc_lock);
+	if (0 != --sketch->buckets[index].count)
+		return;
 
-		zbx_hashset_destroy(&vc_cache->items);
-		zbx_hashset_destroy(&vc_cache->strpool);
+	sketch->buckets_num--;
+	memmove(sketch->buckets + index, sketch->buckets + index + 1,
+			sizeof(zbx_vc_sketch_bucket_t) * (size_t)(sketch->buckets_num - index));
+}
 
-		__vc_mem_free_func(vc_cache);
-		vc_cache = NULL;
+/******************************************************************************
+ *                                                                            *
+ * Function: vc_sketch_get_value                                              *
+ *                                                                            *
+ * Purpose: gets estimated value with the specified rank from percentile      *
+ *          sketch                                                            *
+ *                                                                            *
+ * Parameters: sketch - [IN] the percentile sketch                            *
+ *             rank   - [IN] the value rank (0 - the smallest value)          *
+ *                                                                            *
+ * Return value: The estimated value.                                         *
+ *                                                                            *
+ ******************************************************************************/
+static double	vc_sketch_get_value(const zbx_vc_sketch_t *sketch, int rank)
+{
+	int	i, count = 0;
+
+	for (i = 0; i < sketch->buckets_num; i++)
+	{
+		if ((count += sketch->buckets[i].count) > rank)
+			return vc_sketch_key_value(sketch->buckets[i].key);
 	}
 
-	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
+	THIS_SHOULD_NEVER_HAPPEN;
+
+	return 0 == sketch->buckets_num ? 0 : vc_sketch_key_value(sketch->buckets[sketch->buckets_num - 1].key);
 }
 
 /******************************************************************************
  *                                                                            *
- * Function: zbx_vc_reset                                                     *
+ * Function: vc_sketch_value                                                  *
  *                                                                            *
- * Purpose: resets value cache                                                *
+ * Purpose: converts history value to percentile sketch value                 *
  *                                                                            *
- * Comments: All items and their historical data are removed,                 *
- *           cache working mode, statistics reset.                            *
+ ******************************************************************************/
+static double	vc_sketch_value(int value_type, const history_value_t *value)
+{
+	return ITEM_VALUE_TYPE_FLOAT == value_type ? value->dbl : (double)value->ui64;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vch_item_covers                                                  *
+ *                                                                            *
+ * Purpose: checks if all item values newer than the specified timestamp are  *
+ *          cached                                                            *
+ *                                                                            *
+ * Parameters: item      - [IN] the item                                      *
+ *             timestamp - [IN] the timestamp                                 *
+ *                                                                            *
+ * Return value: SUCCEED - the values are cached                              *
+ *               FAIL    - otherwise                                          *
  *                                                                            *
  ******************************************************************************/
-void	zbx_vc_reset(void)
+static int	vch_item_covers(const zbx_vc_item_t *item, int timestamp)
 {
-	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+	if (ZBX_ITEM_STATUS_CACHED_ALL == item->status)
+		return SUCCEED;
 
-	if (NULL != vc_cache)
-	{
-		zbx_vc_item_t		*item;
-		zbx_hashset_iter_t	iter;
+	if (0 != item->db_cached_from && timestamp >= item->db_cached_from)
+		return SUCCEED;
 
-		WRLOCK_CACHE;
+	return FAIL;
+}
 
-		zbx_hashset_iter_reset(&vc_cache->items, &iter);
-		while (NULL != (item = (zbx_vc_item_t *)zbx_hashset_iter_next(&iter)))
+/******************************************************************************
+ *                                                                            *
+ * Function: vch_item_aggregate_values                                        *
+ *                                                                            *
+ * Purpose: adds or removes cached item values in the time period             *
+ *          (start, end] to/from the aggregate                                *
+ *                                                                            *
+ * Parameters: item      - [IN] the item                                      *
+ *             aggregate - [IN/OUT] the aggregate                             *
+ *             sketch    - [IN/OUT] the percentile sketch (optional)          *
+ *             start     - [IN] the period start timestamp (exclusive)        *
+ *             end       - [IN] the period end timestamp (inclusive)          *
+ *             remove    - [IN] 0 - add values, otherwise remove values       *
+ *                                                                            *
+ ******************************************************************************/
+static void	vch_item_aggregate_values(const zbx_vc_item_t *item, zbx_vc_aggregate_t *aggregate,
+		zbx_vc_sketch_t *sketch, const zbx_timespec_t *start, const zbx_timespec_t *end, int remove)
+{
+	int			index;
+	zbx_vc_chunk_t		*chunk;
+	zbx_history_record_t	*slots;
+
+	if (FAIL == vch_item_get_last_value(item, end, &chunk, &index))
+		return;
+
+	while (0 < zbx_timespec_compare(&(slots = vch_chunk_slots(chunk))[chunk->last_value].timestamp, start))
+	{
+		for (; index >= chunk->first_value && 0 < zbx_timespec_compare(&slots[index].timestamp, start); index--)
 		{
-			vch_item_free_cache(item);
-			zbx_hashset_iter_remove(&iter);
+			if (0 == remove)
+				vc_aggregate_add(aggregate, item->value_type, &slots[index].value);
+			else
+				vc_aggregate_remove(aggregate, item->value_type, &slots[index].value);
+
+			if (NULL == sketch)
+				continue;
+
+			if (0 == remove)
+				vc_sketch_add(sketch, vc_sketch_value(item->value_type, &slots[index].value));
+			else
+				vc_sketch_remove(sketch, vc_sketch_value(item->value_type, &slots[index].value));
 		}
 
-		vc_cache->hits = 0;
-		vc_cache->misses = 0;
-		vc_cache->min_free_request = 0;
-		vc_cache->mode = ZBX_VC_MODE_NORMAL;
-		vc_cache->mode_time = 0;
-		vc_cache->last_warning_time = 0;
+		if (NULL == (chunk = chunk->prev))
+			break;
+
+		index = chunk->last_value;
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vch_item_scan_aggr                                               *
+ *                                                                            *
+ * Purpose: calculates window aggregate by scanning all window values         *
+ *                                                                            *
+ * Parameters: item - [IN] the item                                           *
+ *             aggr - [IN/OUT] the window aggregate                           *
+ *                                                                            *
+ ******************************************************************************/
+static void	vch_item_scan_aggr(const zbx_vc_item_t *item, zbx_vc_aggr_t *aggr)
+{
+	zbx_timespec_t	start = {aggr->end.sec - aggr->seconds, aggr->end.ns};
+
+	zbx_vc_sketch_t	*sketch = NULL;
+
+	memset(&aggr->value, 0, sizeof(aggr->value));
+	aggr->value.flags = ZBX_VC_AGGREGATE_MINMAX;
+	aggr->updates = 0;
+
+	if (NULL != aggr->sketch.buckets)
+	{
+		sketch = &aggr->sketch;
+		sketch->buckets_num = 0;
+		sketch->valid = 1;
+	}
+
+	if (FAIL == vch_item_covers(item, start.sec))
+	{
+		aggr->valid = 0;
+		return;
+	}
+
+	vch_item_aggregate_values(item, &aggr->value, sketch, &start, &aggr->end, 0);
+	aggr->valid = 1;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vch_item_move_aggr                                               *
+ *                                                                            *
+ * Purpose: calculates aggregate of window with the specified end from the    *
+ *          window aggregate                                                  *
+ *                                                                            *
+ * Parameters: item      - [IN] the item                                      *
+ *             aggr      - [IN] the window aggregate                          *
+ *             end       - [IN] the new window end                            *
+ *             aggregate - [OUT] the aggregate of the new window              *
+ *             sketch    - [IN/OUT] the copy of window percentile sketch to   *
+ *                         move together with aggregate (optional)            *
+ *                                                                            *
+ * Return value: SUCCEED - the aggregate was calculated                       *
+ *               FAIL    - the windows do not overlap or their values are not *
+ *                         cached                                             *
+ *                                                                            *
+ * Comments: Only the values between old and new window boundaries are        *
+ *           processed. The sketch is not changed if the aggregate cannot be  *
+ *           calculated.                                                      *
+ *                                                                            *
+ ******************************************************************************/
+static int	vch_item_move_aggr(const zbx_vc_item_t *item, const zbx_vc_aggr_t *aggr, const zbx_timespec_t *end,
+		zbx_vc_aggregate_t *aggregate, zbx_vc_sketch_t *sketch)
+{
+	zbx_timespec_t	start = {end->sec - aggr->seconds, end->ns},
+			aggr_start = {aggr->end.sec - aggr->seconds, aggr->end.ns};
+
+	if (0 == aggr->valid)
+		return FAIL;
+
+	if (0 <= zbx_timespec_compare(&start, &aggr->end) || 0 <= zbx_timespec_compare(&aggr_start, end))
+		return FAIL;
+
+	if (FAIL == vch_item_covers(item, MIN(start.sec, aggr_start.sec)))
+		return FAIL;
+
+	*aggregate = aggr->value;
+
+	/* add the new values first, so the window does not get empty while removing the old values */
+	if (0 < zbx_timespec_compare(end, &aggr->end))
+	{
+		vch_item_aggregate_values(item, aggregate, sketch, &aggr->end, end, 0);
+		vch_item_aggregate_values(item, aggregate, sketch, &aggr_start, &start, 1);
+	}
+	else if (0 > zbx_timespec_compare(end, &aggr->end))
+	{
+		vch_item_aggregate_values(item, aggregate, sketch, &start, &aggr_start, 0);
+		vch_item_aggregate_values(item, aggregate, sketch, end, &aggr->end, 1);
+	}
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vch_item_get_aggr                                                *
+ *                                                                            *
+ * Purpose: finds item window aggregate                                       *
+ *                                                                            *
+ * Parameters: item    - [IN] the item                                        *
+ *             seconds - [IN] the window length                               *
+ *                                                                            *
+ * Return value: The window aggregate or NULL if it was not registered.       *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_vc_aggr_t	*vch_item_get_aggr(const zbx_vc_item_t *item, int seconds)
+{
+	zbx_vc_aggr_t	*aggr;
+
+	for (aggr = item->aggrs; NULL != aggr; aggr = aggr->next)
+	{
+		if (aggr->seconds == seconds)
+			return aggr;
+	}
+
+	return NULL;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vch_item_add_aggr                                                *
+ *                                                                            *
+ * Purpose: registers item window aggregate                                   *
+ *                                                                            *
+ * Parameters: item    - [IN] the item                                        *
+ *             seconds - [IN] the window length                               *
+ *                                                                            *
+ * Return value: The window aggregate or NULL if the item already has the     *
+ *               maximum number of aggregates or there is not enough memory.  *
+ *                                                                            *
+ * Comments: The aggregate is added in invalid state and must be scanned.     *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_vc_aggr_t	*vch_item_add_aggr(zbx_vc_item_t *item, int seconds)
+{
+	zbx_vc_aggr_t	*aggr;
+	int		aggrs_num = 0;
+
+	for (aggr = item->aggrs; NULL != aggr; aggr = aggr->next)
+		aggrs_num++;
+
+	if (ZBX_VC_AGGR_MAX <= aggrs_num)
+		return NULL;
+
+	if (NULL == (aggr = (zbx_vc_aggr_t *)vc_item_malloc(item, sizeof(zbx_vc_aggr_t))))
+		return NULL;
+
+	memset(aggr, 0, sizeof(zbx_vc_aggr_t));
+	aggr->seconds = seconds;
+	aggr->last_accessed = time(NULL);
+	aggr->next = item->aggrs;
+	item->aggrs = aggr;
+
+	return aggr;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vch_item_touch_aggr                                              *
+ *                                                                            *
+ * Purpose: updates window aggregate access time                              *
+ *                                                                            *
+ * Parameters: item    - [IN] the item                                        *
+ *             seconds - [IN] the window length                               *
+ *             now     - [IN] the current timestamp                           *
+ *                                                                            *
+ ******************************************************************************/
+static void	vch_item_touch_aggr(zbx_vc_item_t *item, int seconds, int now)
+{
+	zbx_vc_aggr_t	*aggr;
+
+	if (NULL != (aggr = vch_item_get_aggr(item, seconds)))
+		aggr->last_accessed = now;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vch_item_update_aggrs                                            *
+ *                                                                            *
+ * Purpose: moves item window aggregates to include the value added to cache  *
+ *                                                                            *
+ * Parameters: item - [IN] the item                                           *
+ *             ts   - [IN] the added value timestamp                          *
+ *             now  - [IN] the current timestamp                              *
+ *                                                                            *
+ * Comments: Aggregates that were not requested for ZBX_VC_AGGR_EXPIRE_PERIOD *
+ *           are removed.                                                     *
+ *                                                                            *
+ ******************************************************************************/
+static void	vch_item_update_aggrs(zbx_vc_item_t *item, const zbx_timespec_t *ts, int now)
+{
+	zbx_vc_aggr_t		*aggr, *next, *prev = NULL;
+	zbx_vc_aggregate_t	aggregate;
+
+	for (aggr = item->aggrs; NULL != aggr; aggr = next)
+	{
+		next = aggr->next;
+
+		if (aggr->last_accessed < now - ZBX_VC_AGGR_EXPIRE_PERIOD)
+		{
+			if (NULL == prev)
+				item->aggrs = next;
+			else
+				prev->next = next;
+
+			vc_aggr_free(aggr);
+			continue;
+		}
+
+		prev = aggr;
+
+		/* values added before the window end are rare, rescan the window in this case */
+		if (0 >= zbx_timespec_compare(ts, &aggr->end))
+		{
+			vch_item_scan_aggr(item, aggr);
+			continue;
+		}
+
+		/* the registered sketch is moved in place as the aggregate is replaced on success */
+		if (++aggr->updates > aggr->value.count || FAIL == vch_item_move_aggr(item, aggr, ts, &aggregate,
+				NULL != aggr->sketch.buckets ? &aggr->sketch : NULL))
+		{
+			aggr->end = *ts;
+			vch_item_scan_aggr(item, aggr);
+			continue;
+		}
+
+		aggr->value = aggregate;
+		aggr->end = *ts;
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vch_item_add_sketch                                              *
+ *                                                                            *
+ * Purpose: starts keeping percentile sketch for the window aggregate         *
+ *                                                                            *
+ * Parameters: item - [IN] the item                                           *
+ *             aggr - [IN/OUT] the window aggregate                           *
+ *                                                                            *
+ * Return value: SUCCEED - the sketch was added and filled with window values *
+ *               FAIL    - not enough memory                                  *
+ *                                                                            *
+ ******************************************************************************/
+static int	vch_item_add_sketch(zbx_vc_item_t *item, zbx_vc_aggr_t *aggr)
+{
+	if (NULL == (aggr->sketch.buckets = (zbx_vc_sketch_bucket_t *)vc_item_malloc(item,
+			sizeof(zbx_vc_sketch_bucket_t) * ZBX_VC_SKETCH_BUCKETS_INIT)))
+	{
+		return FAIL;
+	}
+
+	aggr->sketch.buckets_alloc = ZBX_VC_SKETCH_BUCKETS_INIT;
+	vch_item_scan_aggr(item, aggr);
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vch_item_get_percentile                                          *
+ *                                                                            *
+ * Purpose: estimates percentile of window values with the specified end      *
+ *          from the window percentile sketch                                 *
+ *                                                                            *
+ * Parameters: item       - [IN] the item                                     *
+ *             aggr       - [IN] the window aggregate with percentile sketch  *
+ *             end        - [IN] the window end                               *
+ *             percentage - [IN] the percentage (0-100)                       *
+ *             value      - [OUT] the percentile value                        *
+ *             count      - [OUT] the number of window values                 *
+ *                                                                            *
+ * Return value: SUCCEED - the percentile was estimated                       *
+ *               FAIL    - the sketch is not available for the window or the  *
+ *                         window has too few values                          *
+ *                                                                            *
+ * Comments: The percentile is the value with the same rank as returned by    *
+ *           exact calculation, estimated with ZBX_VC_SKETCH_ACCURACY         *
+ *           relative error and limited to window minimum and maximum values  *
+ *           when they are known. Sketches of windows with different end are  *
+ *           moved in process local copy.                                     *
+ *                                                                            *
+ ******************************************************************************/
+static int	vch_item_get_percentile(const zbx_vc_item_t *item, const zbx_vc_aggr_t *aggr,
+		const zbx_timespec_t *end, double percentage, history_value_t *value, int *count)
+{
+	zbx_vc_aggregate_t	aggregate;
+	zbx_vc_sketch_t		local;
+	const zbx_vc_sketch_t	*sketch;
+	double			estimate;
+	int			index;
+
+	if (0 == aggr->valid || NULL == aggr->sketch.buckets || 0 == aggr->sketch.valid)
+		return FAIL;
+
+	if (0 == zbx_timespec_compare(end, &aggr->end))
+	{
+		aggregate = aggr->value;
+		sketch = &aggr->sketch;
+	}
+	else
+	{
+		local.buckets = vc_sketch_buckets;
+		local.buckets_num = aggr->sketch.buckets_num;
+		local.buckets_alloc = ZBX_VC_SKETCH_BUCKETS_MAX;
+		local.valid = 1;
+		memcpy(local.buckets, aggr->sketch.buckets, sizeof(zbx_vc_sketch_bucket_t) * (size_t)local.buckets_num);
+
+		if (SUCCEED != vch_item_move_aggr(item, aggr, end, &aggregate, &local) || 0 == local.valid)
+			return FAIL;
+
+		sketch = &local;
+	}
+
+	if (vc_sketch_values_min > (*count = aggregate.count) || 0 == aggregate.count)
+		return FAIL;
+
+	if (0 == percentage)
+		index = 1;
+	else
+		index = (int)ceil(aggregate.count * (percentage / 100));
+
+	estimate = vc_sketch_get_value(sketch, index - 1);
+
+	if (ITEM_VALUE_TYPE_FLOAT == item->value_type)
+	{
+		if (0 != (aggregate.flags & ZBX_VC_AGGREGATE_MINMAX))
+			estimate = MAX(MIN(estimate, aggregate.max.dbl), aggregate.min.dbl);
+
+		value->dbl = estimate;
+	}
+	else
+	{
+		if (0 != (aggregate.flags & ZBX_VC_AGGREGATE_MINMAX))
+			estimate = MAX(MIN(estimate, (double)aggregate.max.ui64), (double)aggregate.min.ui64);
+
+		if (0 >= estimate)
+			value->ui64 = 0;
+		else if ((double)ZBX_MAX_UINT64 <= estimate)
+			value->ui64 = ZBX_MAX_UINT64;
+		else
+			value->ui64 = (zbx_uint64_t)(estimate + 0.5);
+	}
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * value cache snapshot                                                       *
+ *                                                                            *
+ ******************************************************************************/
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vc_snapshot_header_init                                          *
+ *                                                                            *
+ * Purpose: initializes value cache snapshot file header                      *
+ *                                                                            *
+ ******************************************************************************/
+static void	vc_snapshot_header_init(zbx_vc_snapshot_t *header, zbx_uint64_t items_num, zbx_hash_t data_checksum,
+		int saved)
+{
+	memset(header, 0, sizeof(zbx_vc_snapshot_t));
+	memcpy(header->magic, ZBX_VC_SNAPSHOT_MAGIC, sizeof(header->magic));
+	header->version = ZBX_VC_SNAPSHOT_VERSION;
+	header->item_size = sizeof(zbx_vc_snapshot_item_t);
+	header->value_size = sizeof(zbx_vc_snapshot_value_t);
+	header->saved = saved;
+	header->items_num = items_num;
+	header->data_checksum = data_checksum;
+	header->checksum = zbx_hash_modfnv(header, offsetof(zbx_vc_snapshot_t, checksum), 0);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vc_snapshot_write_value                                          *
+ *                                                                            *
+ * Purpose: appends item value record to the snapshot item record buffer      *
+ *                                                                            *
+ * Parameters: buf        - [IN/OUT] the item record buffer                   *
+ *             buf_alloc  - [IN/OUT] the item record buffer size              *
+ *             buf_offset - [IN/OUT] the item record size                     *
+ *             value_type - [IN] the item value type                          *
+ *             record     - [IN] the item value                               *
+ *                                                                            *
+ ******************************************************************************/
+static void	vc_snapshot_write_value(char **buf, size_t *buf_alloc, size_t *buf_offset, int value_type,
+		const zbx_history_record_t *record)
+{
+	zbx_vc_snapshot_value_t	*value;
+	const char		*str = NULL, *source = NULL;
+	size_t			value_len = 0, source_len = 0, size;
+
+	switch (value_type)
+	{
+		case ITEM_VALUE_TYPE_STR:
+		case ITEM_VALUE_TYPE_TEXT:
+			str = record->value.str;
+			break;
+		case ITEM_VALUE_TYPE_LOG:
+			str = record->value.log->value;
+			source = record->value.log->source;
+			break;
+	}
+
+	if (NULL != str)
+		value_len = strlen(str) + 1;
+
+	if (NULL != source)
+		source_len = strlen(source) + 1;
+
+	size = ZBX_SIZE_T_ALIGN8(sizeof(zbx_vc_snapshot_value_t) + value_len + source_len);
+
+	if (*buf_alloc < *buf_offset + size)
+	{
+		while (*buf_alloc < *buf_offset + size)
+			*buf_alloc *= 2;
+
+		*buf = (char *)zbx_realloc(*buf, *buf_alloc);
+	}
+
+	value = (zbx_vc_snapshot_value_t *)(*buf + *buf_offset);
+	memset(value, 0, size);
+
+	value->ts = record->timestamp;
+	value->size = (zbx_uint32_t)size;
+	value->value_len = (zbx_uint32_t)value_len;
+	value->source_len = (zbx_uint32_t)source_len;
+
+	switch (value_type)
+	{
+		case ITEM_VALUE_TYPE_FLOAT:
+			value->value.dbl = record->value.dbl;
+			break;
+		case ITEM_VALUE_TYPE_UINT64:
+			value->value.ui64 = record->value.ui64;
+			break;
+		case ITEM_VALUE_TYPE_LOG:
+			value->timestamp = record->value.log->timestamp;
+			value->severity = record->value.log->severity;
+			value->logeventid = record->value.log->logeventid;
+			break;
+	}
+
+	if (0 != value_len)
+		memcpy(value + 1, str, value_len);
+
+	if (0 != source_len)
+		memcpy((char *)(value + 1) + value_len, source, source_len);
+
+	*buf_offset += size;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vc_snapshot_write_item                                           *
+ *                                                                            *
+ * Purpose: writes cached item and its values into snapshot file              *
+ *                                                                            *
+ * Parameters: fp         - [IN] the snapshot file                            *
+ *             item       - [IN] the cached item                              *
+ *             buf        - [IN/OUT] the item record buffer                   *
+ *             buf_alloc  - [IN/OUT] the item record buffer size              *
+ *             values_num - [IN/OUT] the number of written values             *
+ *             checksum   - [IN/OUT] the checksum of written item records     *
+ *                                                                            *
+ * Return value: SUCCEED - the item was written                               *
+ *               FAIL    - file write error                                   *
+ *                                                                            *
+ ******************************************************************************/
+static int	vc_snapshot_write_item(FILE *fp, const zbx_vc_item_t *item, char **buf, size_t *buf_alloc,
+		zbx_uint64_t *values_num, zbx_hash_t *checksum)
+{
+	zbx_vc_snapshot_item_t	*record;
+	const zbx_vc_chunk_t	*chunk;
+	size_t			buf_offset = sizeof(zbx_vc_snapshot_item_t);
+	int			i, item_values_num = 0;
+
+	for (chunk = item->tail; NULL != chunk; chunk = chunk->next)
+	{
+		const zbx_history_record_t	*slots;
+
+		slots = vch_chunk_slots(chunk);
+
+		for (i = chunk->first_value; i <= chunk->last_value; i++)
+		{
+			vc_snapshot_write_value(buf, buf_alloc, &buf_offset, item->value_type, &slots[i]);
+			item_values_num++;
+		}
+	}
+
+	record = (zbx_vc_snapshot_item_t *)*buf;
+	memset(record, 0, sizeof(zbx_vc_snapshot_item_t));
+
+	record->itemid = item->itemid;
+	record->hits = item->hits;
+	record->size = buf_offset;
+	record->values_num = item_values_num;
+	record->active_range = item->active_range;
+	record->daily_range = item->daily_range;
+	record->db_cached_from = item->db_cached_from;
+	record->last_accessed = item->last_accessed;
+	record->last_hourly_num = item->last_hourly_num;
+	record->value_type = item->value_type;
+	record->status = item->status;
+	record->range_sync_hour = item->range_sync_hour;
+
+	if (1 != fwrite(*buf, buf_offset, 1, fp))
+		return FAIL;
+
+	*values_num += (zbx_uint64_t)item_values_num;
+	*checksum = zbx_hash_modfnv(*buf, buf_offset, *checksum);
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_vc_snapshot_save                                             *
+ *                                                                            *
+ * Purpose: saves value cache contents into snapshot file                     *
+ *                                                                            *
+ * Return value: SUCCEED - the value cache was saved                          *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ * Comments: This function must be called at server exit after history cache *
+ *           is synced and other processes are terminated, so the cache holds *
+ *           all values written to history and locking is unnecessary.        *
+ *           The snapshot is written into temporary file which is renamed     *
+ *           after all items are written, so an interrupted save cannot leave *
+ *           a partial snapshot.                                              *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_vc_snapshot_save(void)
+{
+	FILE			*fp;
+	char			*filename, *buf = NULL;
+	size_t			buf_alloc = ZBX_KIBIBYTE;
+	int			i, saved, ret = FAIL;
+	zbx_uint64_t		items_num = 0, values_num = 0;
+	zbx_hash_t		checksum = 0;
+	zbx_vc_snapshot_t	header;
+	zbx_hashset_iter_t	iter;
+	zbx_vc_item_t		*item;
+
+	if (NULL == CONFIG_VALUE_CACHE_SNAPSHOT_FILE || 0 == vc_stripes_num)
+		return FAIL;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+
+	filename = zbx_dsprintf(NULL, "%s.tmp", CONFIG_VALUE_CACHE_SNAPSHOT_FILE);
+
+	if (NULL == (fp = fopen(filename, "wb")))
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "cannot create value cache snapshot file \"%s\": %s", filename,
+				zbx_strerror(errno));
+		goto out;
+	}
+
+	zabbix_log(LOG_LEVEL_WARNING, "saving value cache snapshot...");
+
+	saved = (int)time(NULL);
+	vc_snapshot_header_init(&header, 0, 0, saved);
+
+	if (1 != fwrite(&header, sizeof(header), 1, fp))
+		goto clean;
+
+	buf = (char *)zbx_malloc(NULL, buf_alloc);
+
+	for (i = 0; i < vc_stripes_num; i++)
+	{
+		zbx_hashset_iter_reset(&vc_stripes[i]->items, &iter);
+
+		while (NULL != (item = (zbx_vc_item_t *)zbx_hashset_iter_next(&iter)))
+		{
+			if (SUCCEED != vc_snapshot_write_item(fp, item, &buf, &buf_alloc, &values_num, &checksum))
+				goto clean;
+
+			items_num++;
+		}
+	}
+
+	vc_snapshot_header_init(&header, items_num, checksum, saved);
+
+	if (0 != fseek(fp, 0, SEEK_SET) || 1 != fwrite(&header, sizeof(header), 1, fp) || 0 != fflush(fp) ||
+			0 != fsync(fileno(fp)))
+	{
+		goto clean;
+	}
+
+	ret = SUCCEED;
+clean:
+	if (SUCCEED != ret)
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "cannot write value cache snapshot file \"%s\": %s", filename,
+				zbx_strerror(errno));
+	}
+
+	if (0 != fclose(fp) && SUCCEED == ret)
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "cannot close value cache snapshot file \"%s\": %s", filename,
+				zbx_strerror(errno));
+		ret = FAIL;
+	}
+
+	if (SUCCEED == ret && 0 != rename(filename, CONFIG_VALUE_CACHE_SNAPSHOT_FILE))
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "cannot rename value cache snapshot file \"%s\" to \"%s\": %s",
+				filename, CONFIG_VALUE_CACHE_SNAPSHOT_FILE, zbx_strerror(errno));
+		ret = FAIL;
+	}
+
+	if (SUCCEED != ret)
+	{
+		unlink(filename);
+	}
+	else
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "saved " ZBX_FS_UI64 " items with " ZBX_FS_UI64 " values to value cache"
+				" snapshot", items_num, values_num);
+	}
+out:
+	zbx_free(buf);
+	zbx_free(filename);
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%s", __func__, zbx_result_string(ret));
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vc_snapshot_read_values                                          *
+ *                                                                            *
+ * Purpose: reads values of snapshot item record                              *
+ *                                                                            *
+ * Parameters: record - [IN] the snapshot item record with validated size     *
+ *             values - [OUT] the item values, string values point to the     *
+ *                            snapshot data                                   *
+ *             logs   - [OUT] the log values referenced by values, an array   *
+ *                            of record->values_num elements                  *
+ *                                                                            *
+ * Return value: SUCCEED - the values were read                               *
+ *               FAIL    - the record is corrupted                            *
+ *                                                                            *
+ ******************************************************************************/
+static int	vc_snapshot_read_values(const zbx_vc_snapshot_item_t *record, zbx_vector_history_record_t *values,
+		zbx_log_value_t *logs)
+{
+	const char	*ptr = (const char *)(record + 1), *end = (const char *)record + record->size;
+	int		i;
+
+	for (i = 0; i < record->values_num; i++)
+	{
+		const zbx_vc_snapshot_value_t	*value = (const zbx_vc_snapshot_value_t *)ptr;
+		const char			*str, *source;
+		zbx_history_record_t		hr;
+
+		if (sizeof(zbx_vc_snapshot_value_t) > (size_t)(end - ptr) || value->size > (size_t)(end - ptr) ||
+				sizeof(zbx_vc_snapshot_value_t) + (zbx_uint64_t)value->value_len +
+				value->source_len > value->size)
+		{
+			return FAIL;
+		}
+
+		str = (const char *)(value + 1);
+		source = str + value->value_len;
+
+		hr.timestamp = value->ts;
+
+		switch (record->value_type)
+		{
+			case ITEM_VALUE_TYPE_FLOAT:
+				hr.value.dbl = value->value.dbl;
+				break;
+			case ITEM_VALUE_TYPE_UINT64:
+				hr.value.ui64 = value->value.ui64;
+				break;
+			case ITEM_VALUE_TYPE_STR:
+			case ITEM_VALUE_TYPE_TEXT:
+				if (0 == value->value_len || '\0' != str[value->value_len - 1])
+					return FAIL;
+
+				hr.value.str = (char *)str;
+				break;
+			case ITEM_VALUE_TYPE_LOG:
+				if (0 == value->value_len || '\0' != str[value->value_len - 1])
+					return FAIL;
+
+				if (0 != value->source_len && '\0' != source[value->source_len - 1])
+					return FAIL;
+
+				logs[i].value = (char *)str;
+				logs[i].source = (0 != value->source_len ? (char *)source : NULL);
+				logs[i].timestamp = value->timestamp;
+				logs[i].severity = value->severity;
+				logs[i].logeventid = value->logeventid;
+				hr.value.log = &logs[i];
+				break;
+			default:
+				return FAIL;
+		}
+
+		/* values must be in ascending order */
+		if (0 != i && 0 < zbx_timespec_compare(&values->values[i - 1].timestamp, &hr.timestamp))
+			return FAIL;
+
+		zbx_vector_history_record_append_ptr(values, &hr);
+		ptr += value->size;
+	}
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vc_snapshot_read_item                                            *
+ *                                                                            *
+ * Purpose: reads snapshot item record and its values                         *
+ *                                                                            *
+ * Parameters: data       - [IN] the snapshot data                            *
+ *             size       - [IN] the snapshot data size                       *
+ *             offset     - [IN] the item record offset                       *
+ *             record     - [OUT] the item record                             *
+ *             values     - [OUT] the item values, string values point to     *
+ *                                the snapshot data                           *
+ *             logs       - [IN/OUT] the log values referenced by values      *
+ *             logs_alloc - [IN/OUT] the number of allocated log values       *
+ *                                                                            *
+ * Return value: SUCCEED - the item record was read                           *
+ *               FAIL    - the record is corrupted                            *
+ *                                                                            *
+ ******************************************************************************/
+static int	vc_snapshot_read_item(const char *data, zbx_uint64_t size, zbx_uint64_t offset,
+		const zbx_vc_snapshot_item_t **record, zbx_vector_history_record_t *values, zbx_log_value_t **logs,
+		int *logs_alloc)
+{
+	if (sizeof(zbx_vc_snapshot_item_t) > size - offset)
+		return FAIL;
+
+	*record = (const zbx_vc_snapshot_item_t *)(data + offset);
+
+	if (sizeof(zbx_vc_snapshot_item_t) > (*record)->size || (*record)->size > size - offset ||
+			0 > (*record)->values_num)
+	{
+		return FAIL;
+	}
+
+	if (*logs_alloc < (*record)->values_num)
+	{
+		*logs_alloc = (*record)->values_num;
+		*logs = (zbx_log_value_t *)zbx_realloc(*logs, sizeof(zbx_log_value_t) * (size_t)*logs_alloc);
+	}
+
+	zbx_vector_history_record_clear(values);
+
+	return vc_snapshot_read_values(*record, values, *logs);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vc_snapshot_load_item                                            *
+ *                                                                            *
+ * Purpose: adds item saved in snapshot to the locked value cache stripe      *
+ *                                                                            *
+ * Parameters: record - [IN] the snapshot item record                         *
+ *             values - [IN] the item values in ascending order               *
+ *                                                                            *
+ * Return value: SUCCEED - the item was added                                 *
+ *               FAIL    - not enough space in value cache                    *
+ *                                                                            *
+ ******************************************************************************/
+static int	vc_snapshot_load_item(const zbx_vc_snapshot_item_t *record, const zbx_vector_history_record_t *values)
+{
+	zbx_vc_item_t	*item, new_item = {.itemid = record->itemid, .value_type = record->value_type};
+
+	/* leave space for items cached at runtime instead of entering low memory mode at start */
+	if (vc_mem->free_size < vc_cache->min_free_request + record->size)
+		return FAIL;
+
+	if (NULL == (item = (zbx_vc_item_t *)zbx_hashset_insert(&vc_cache->items, &new_item, sizeof(new_item))))
+		return FAIL;
+
+	if (0 != values->values_num && SUCCEED != vch_item_add_values_at_tail(item, values->values,
+			values->values_num))
+	{
+		vc_remove_item(item);
+		return FAIL;
+	}
+
+	item->hits = record->hits;
+	item->active_range = record->active_range;
+	item->daily_range = record->daily_range;
+	item->db_cached_from = record->db_cached_from;
+	item->last_accessed = record->last_accessed;
+	item->last_hourly_num = record->last_hourly_num;
+	item->status = record->status;
+	item->range_sync_hour = record->range_sync_hour;
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vc_snapshot_load                                                 *
+ *                                                                            *
+ * Purpose: loads value cache contents saved at previous server exit          *
+ *                                                                            *
+ * Comments: The snapshot file is removed after loading, so it is not loaded  *
+ *           again after a crash when the cache could miss values written to  *
+ *           history since the snapshot was saved.                            *
+ *           Items are discarded if they would expire from the cache anyway   *
+ *           or their cached range does not match the snapshot save time.     *
+ *           All item records are validated against the snapshot checksum     *
+ *           before loading, so a truncated or corrupted snapshot is          *
+ *           discarded without loading any items.                             *
+ *           This function is called before forking, so cache locking is only *
+ *           used to select the stripe memory.                                *
+ *                                                                            *
+ ******************************************************************************/
+static void	vc_snapshot_load(void)
+{
+	int				fd, now, items_num = 0, items_skipped = 0;
+	zbx_stat_t			st;
+	void				*map;
+	const zbx_vc_snapshot_t		*header;
+	zbx_vc_snapshot_t		header_local;
+	const zbx_vc_snapshot_item_t	*record;
+	zbx_uint64_t			offset, i, values_num = 0;
+	zbx_hash_t			checksum = 0;
+	zbx_vector_history_record_t	values;
+	zbx_log_value_t			*logs = NULL;
+	int				logs_alloc = 0;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+
+	if (-1 == (fd = open(CONFIG_VALUE_CACHE_SNAPSHOT_FILE, O_RDONLY)))
+	{
+		if (ENOENT != errno)
+		{
+			zabbix_log(LOG_LEVEL_WARNING, "cannot open value cache snapshot file \"%s\": %s",
+					CONFIG_VALUE_CACHE_SNAPSHOT_FILE, zbx_strerror(errno));
+		}
+
+		goto out;
+	}
+
+	if (0 != fstat(fd, &st) || sizeof(zbx_vc_snapshot_t) > (zbx_uint64_t)st.st_size)
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "invalid value cache snapshot file \"%s\"",
+				CONFIG_VALUE_CACHE_SNAPSHOT_FILE);
+		goto clean;
+	}
+
+	if (MAP_FAILED == (map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)))
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "cannot map value cache snapshot file \"%s\": %s",
+				CONFIG_VALUE_CACHE_SNAPSHOT_FILE, zbx_strerror(errno));
+		goto clean;
+	}
+
+	header = (const zbx_vc_snapshot_t *)map;
+	vc_snapshot_header_init(&header_local, header->items_num, header->data_checksum, header->saved);
+	now = (int)time(NULL);
+
+	if (0 != memcmp(header, &header_local, offsetof(zbx_vc_snapshot_t, checksum)) ||
+			header->checksum != header_local.checksum || header->saved > now)
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "discarding incompatible value cache snapshot file \"%s\"",
+				CONFIG_VALUE_CACHE_SNAPSHOT_FILE);
+		goto unmap;
+	}
+
+	zbx_history_record_vector_create(&values);
+
+	for (offset = sizeof(zbx_vc_snapshot_t), i = 0; i < header->items_num; offset += record->size, i++)
+	{
+		if (SUCCEED != vc_snapshot_read_item((const char *)map, (zbx_uint64_t)st.st_size, offset, &record,
+				&values, &logs, &logs_alloc))
+		{
+			break;
+		}
+
+		checksum = zbx_hash_modfnv(record, record->size, checksum);
+	}
+
+	if (i != header->items_num || offset != (zbx_uint64_t)st.st_size || checksum != header->data_checksum)
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "discarding corrupted value cache snapshot file \"%s\"",
+				CONFIG_VALUE_CACHE_SNAPSHOT_FILE);
+		goto destroy;
+	}
+
+	for (offset = sizeof(zbx_vc_snapshot_t), i = 0; i < header->items_num; offset += record->size, i++)
+	{
+		/* the records were validated above */
+		vc_snapshot_read_item((const char *)map, (zbx_uint64_t)st.st_size, offset, &record, &values, &logs,
+				&logs_alloc);
+
+		/* skip items that are not used anymore or with cached range past the snapshot save time */
+		if (record->last_accessed < now - ZBX_VC_ITEM_EXPIRE_PERIOD || record->db_cached_from > header->saved ||
+				0 > record->active_range || 0 > record->daily_range || (0 != values.values_num &&
+				values.values[values.values_num - 1].timestamp.sec > header->saved))
+		{
+			items_skipped++;
+			continue;
+		}
+
+		WRLOCK_STRIPE(vc_get_stripe(record->itemid));
+
+		if (SUCCEED == vc_snapshot_load_item(record, &values))
+		{
+			items_num++;
+			values_num += (zbx_uint64_t)values.values_num;
+		}
+		else
+			items_skipped++;
+
+		UNLOCK_STRIPE(vc_cache);
+	}
+
+	zabbix_log(LOG_LEVEL_WARNING, "loaded %d items with " ZBX_FS_UI64 " values from value cache snapshot",
+			items_num, values_num);
+
+	if (0 != items_skipped)
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "%d items from value cache snapshot were discarded because they"
+				" expired or did not fit in value cache", items_skipped);
+	}
+destroy:
+	/* the values point to snapshot data, so they are not freed */
+	zbx_vector_history_record_destroy(&values);
+	zbx_free(logs);
+unmap:
+	munmap(map, (size_t)st.st_size);
+clean:
+	close(fd);
+
+	if (0 != unlink(CONFIG_VALUE_CACHE_SNAPSHOT_FILE))
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "cannot remove value cache snapshot file \"%s\": %s",
+				CONFIG_VALUE_CACHE_SNAPSHOT_FILE, zbx_strerror(errno));
+	}
+out:
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
+}
+
+/******************************************************************************************************************
+ *                                                                                                                *
+ * Public API                                                                                                     *
+ *                                                                                                                *
+ ******************************************************************************************************************/
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vc_stripe_create                                                 *
+ *                                                                            *
+ * Purpose: allocate shared memory and lock for value cache stripe            *
+ *                                                                            *
+ * Parameters: stripe - [OUT] the created stripe                              *
+ *             index  - [IN] the stripe index                                 *
+ *             error  - [OUT] the error message                               *
+ *                                                                            *
+ * Return value: SUCCEED - the stripe was created successfully                *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ * Comments: Value cache size is divided equally between stripes.             *
+ *                                                                            *
+ ******************************************************************************/
+static int	vc_stripe_create(zbx_vc_cache_t **stripe, int index, char **error)
+{
+	zbx_rwlock_t		lock = ZBX_RWLOCK_NULL;
+	zbx_rwlock_name_t	lock_name;
+	zbx_uint64_t		size, size_reserved;
+	int			ret;
+
+	lock_name = (0 == index ? ZBX_RWLOCK_VALUECACHE : (zbx_rwlock_name_t)(ZBX_RWLOCK_VALUECACHE_STRIPE + index - 1));
+
+	if (SUCCEED != (ret = zbx_rwlock_create(&lock, lock_name, error)))
+		return ret;
+
+	size = CONFIG_VALUE_CACHE_SIZE / (zbx_uint64_t)CONFIG_VALUE_CACHE_STRIPES;
+	size_reserved = zbx_mem_required_size(1, "value cache size", "ValueCacheSize");
+
+	if (SUCCEED != (ret = zbx_mem_create(&vc_mem, size, "value cache size", "ValueCacheSize", 1, error)))
+		return ret;
+
+	size -= size_reserved;
+
+	if (NULL == (*stripe = (zbx_vc_cache_t *)__vc_mem_malloc_func(NULL, sizeof(zbx_vc_cache_t))))
+	{
+		*error = zbx_strdup(*error, "cannot allocate value cache header");
+		return FAIL;
+	}
+
+	memset(*stripe, 0, sizeof(zbx_vc_cache_t));
+
+	(*stripe)->mem = vc_mem;
+	(*stripe)->lock = lock;
+	(*stripe)->index = index;
+	(*stripe)->packed_id = (zbx_uint64_t)index;
+
+	zbx_hashset_create_ext(&(*stripe)->items, VC_ITEMS_INIT_SIZE / CONFIG_VALUE_CACHE_STRIPES,
+			ZBX_DEFAULT_UINT64_HASH_FUNC, ZBX_DEFAULT_UINT64_COMPARE_FUNC, NULL,
+			__vc_mem_malloc_func, __vc_mem_realloc_func, __vc_mem_free_func);
+
+	if (NULL == (*stripe)->items.slots)
+	{
+		*error = zbx_strdup(*error, "cannot allocate value cache data storage");
+		return FAIL;
+	}
+
+	zbx_hashset_create_ext(&(*stripe)->strpool, VC_STRPOOL_INIT_SIZE / CONFIG_VALUE_CACHE_STRIPES,
+			vc_strpool_hash_func, vc_strpool_compare_func, NULL,
+			__vc_mem_malloc_func, __vc_mem_realloc_func, __vc_mem_free_func);
+
+	if (NULL == (*stripe)->strpool.slots)
+	{
+		*error = zbx_strdup(*error, "cannot allocate string pool for value cache data storage");
+		return FAIL;
+	}
+
+	/* the free space request should be 5% of stripe size, but no more than 128KB */
+	(*stripe)->min_free_request = (size / 100) * 5;
+	if ((*stripe)->min_free_request > 128 * ZBX_KIBIBYTE)
+		(*stripe)->min_free_request = 128 * ZBX_KIBIBYTE;
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_vc_init                                                      *
+ *                                                                            *
+ * Purpose: initializes value cache                                           *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_vc_init(char **error)
+{
+	int	i, ret = FAIL;
+
+	if (0 == CONFIG_VALUE_CACHE_SIZE)
+		return SUCCEED;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+
+	if (1 < CONFIG_VALUE_CACHE_STRIPES &&
+			ZBX_VC_STRIPE_SIZE_MIN > CONFIG_VALUE_CACHE_SIZE / (zbx_uint64_t)CONFIG_VALUE_CACHE_STRIPES)
+	{
+		*error = zbx_dsprintf(*error, "ValueCacheSize must be at least " ZBX_FS_UI64 " bytes per each of %d"
+				" value cache stripes", (zbx_uint64_t)ZBX_VC_STRIPE_SIZE_MIN, CONFIG_VALUE_CACHE_STRIPES);
+		goto out;
+	}
+
+	for (i = 0; i < CONFIG_VALUE_CACHE_STRIPES; i++)
+	{
+		if (SUCCEED != (ret = vc_stripe_create(&vc_stripes[i], i, error)))
+			goto out;
+
+		vc_stripes_num++;
+	}
+
+	/* leave the first stripe as the current one for functions working on locked cache */
+	vc_cache = vc_stripes[0];
+	vc_mem = vc_cache->mem;
+
+	memset(vc_rdlocks, 0, sizeof(vc_rdlocks));
+	memset(vc_rdlock_waits, 0, sizeof(vc_rdlock_waits));
+
+	zbx_vector_vc_itemupdate_create(&vc_itemupdates);
+	zbx_vector_vc_itemupdate_reserve(&vc_itemupdates, 256);
+
+	vc_unpacked_id = 0;
+
+	vc_sketch_log_gamma = log(ZBX_VC_SKETCH_GAMMA);
+	vc_sketch_index_min = (int)ceil(log(ZBX_VC_SKETCH_VALUE_MIN) / vc_sketch_log_gamma);
+
+	if (NULL != CONFIG_VALUE_CACHE_SNAPSHOT_FILE)
+		vc_snapshot_load();
+
+	ret = SUCCEED;
+out:
+	zbx_vc_disable();
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_vc_destroy                                                   *
+ *                                                                            *
+ * Purpose: destroys value cache                                              *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_vc_destroy(void)
+{
+	int	i;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+
+	if (0 != vc_stripes_num)
+	{
+		zbx_vector_vc_itemupdate_destroy(&vc_itemupdates);
+
+		for (i = 0; i < vc_stripes_num; i++)
+		{
+			vc_cache = vc_stripes[i];
+			vc_mem = vc_cache->mem;
+
+			zbx_rwlock_destroy(&vc_cache->lock);
+
+			zbx_hashset_destroy(&vc_cache->items);
+			zbx_hashset_destroy(&vc_cache->strpool);
+
+			__vc_mem_free_func(vc_cache);
+			vc_stripes[i] = NULL;
+		}
+
+		vc_stripes_num = 0;
+		vc_cache = NULL;
+	}
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_vc_reset                                                     *
+ *                                                                            *
+ * Purpose: resets value cache                                                *
+ *                                                                            *
+ * Comments: All items and their historical data are removed,                 *
+ *           cache working mode, statistics reset.                            *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_vc_reset(void)
+{
+	int	i;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+
+	for (i = 0; i < vc_stripes_num; i++)
+	{
+		zbx_vc_item_t		*item;
+		zbx_hashset_iter_t	iter;
+
+		WRLOCK_STRIPE(vc_stripes[i]);
+
+		zbx_hashset_iter_reset(&vc_cache->items, &iter);
+		while (NULL != (item = (zbx_vc_item_t *)zbx_hashset_iter_next(&iter)))
+		{
+			vch_item_free_cache(item);
+			zbx_hashset_iter_remove(&iter);
+		}
+
+		vc_cache->hits = 0;
+		vc_cache->misses = 0;
+		vc_cache->min_free_request = 0;
+		vc_cache->mode = ZBX_VC_MODE_NORMAL;
+		vc_cache->mode_time = 0;
+		vc_cache->last_warning_time = 0;
+
+		UNLOCK_STRIPE(vc_stripes[i]);
+	}
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vc_add_item_value                                                *
+ *                                                                            *
+ * Purpose: adds item value already written to history to the locked value    *
+ *          cache stripe if the item is cached                                *
+ *                                                                            *
+ * Parameters: h                - [IN] the item history value                 *
+ *             now              - [IN] the current timestamp                  *
+ *             expire_timestamp - [IN] items not accessed since this time are *
+ *                                     removed from cache instead             *
+ *                                                                            *
+ ******************************************************************************/
+static void	vc_add_item_value(const ZBX_DC_HISTORY *h, int now, time_t expire_timestamp)
+{
+	zbx_vc_item_t		*item;
+	zbx_history_record_t	record = {h->ts, h->value};
+	zbx_vc_chunk_t		*head;
+
+	if (NULL == (item = (zbx_vc_item_t *)zbx_hashset_search(&vc_cache->items, &h->itemid)))
+		return;
+
+	head = item->head;
+
+	/* If the new value type does not match the item's type in cache remove it, */
+	/* so it's cached with the correct type from correct tables when accessed   */
+	/* next time.                                                               */
+	/* Also remove item if the value adding failed. In this case we             */
+	/* won't have the latest data in cache - so the requests must go directly   */
+	/* to the database.                                                         */
+	if (item->value_type != h->value_type || item->last_accessed < expire_timestamp ||
+			FAIL == vch_item_add_value_at_head(item, &record))
+	{
+		vc_remove_item(item);
+		return;
+	}
+
+	if (NULL != item->aggrs && NULL != item->head)
+		vch_item_update_aggrs(item, &h->ts, now);
+
+	/* try to remove old (unused) chunks if a new chunk was added */
+	if (head != item->head)
+		vch_item_clean_cache(item);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vc_add_values                                                    *
+ *                                                                            *
+ * Purpose: adds item values already written to history to the value cache   *
+ *                                                                            *
+ * Parameters: history - [IN] item history values                             *
+ *                                                                            *
+ ******************************************************************************/
+static void	vc_add_values(zbx_vector_ptr_t *history)
+{
+	int 			i, j, now, values_num[ZBX_VC_STRIPES_MAX] = {0};
+	ZBX_DC_HISTORY		*h;
+	time_t			expire_timestamp;
+
+	if (ZBX_VC_DISABLED == vc_state)
+		return;
+
+	now = time(NULL);
+	expire_timestamp = now - ZBX_VC_ITEM_EXPIRE_PERIOD;
+
+	for (i = 0; i < history->values_num; i++)
+		values_num[vc_get_stripe_index(((ZBX_DC_HISTORY *)history->values[i])->itemid)]++;
+
+	for (j = 0; j < vc_stripes_num; j++)
+	{
+		if (0 == values_num[j])
+			continue;
+
+		WRLOCK_STRIPE(vc_stripes[j]);
+
+		for (i = 0; i < history->values_num; i++)
+		{
+			h = (ZBX_DC_HISTORY *)history->values[i];
+
+			if (j == vc_get_stripe_index(h->itemid))
+				vc_add_item_value(h, now, expire_timestamp);
+		}
+
+		UNLOCK_STRIPE(vc_stripes[j]);
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_vc_add_values                                                *
+ *                                                                            *
+ * Purpose: adds item values to the history and value cache                   *
+ *                                                                            *
+ * Parameters: history - [IN] item history values                             *
+ *                                                                            *
+ * Return value: SUCCEED - the values were added successfully                 *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_vc_add_values(zbx_vector_ptr_t *history)
+{
+	if (FAIL == zbx_history_add_values(history))
+		return FAIL;
+
+	vc_add_values(history);
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_vc_add_values_async                                          *
+ *                                                                            *
+ * Purpose: starts adding item values to the history                          *
+ *                                                                            *
+ * Parameters: history - [IN] item history values                             *
+ *                                                                            *
+ * Return value: SUCCEED - the values are being written to history,           *
+ *                         zbx_vc_wait_values() must be called with the same  *
+ *                         values to complete adding them                     *
+ *               FAIL    - history storage does not support asynchronous      *
+ *                         writes, zbx_vc_add_values() must be used instead   *
+ *                                                                            *
+ * Comments: The value cache is updated only after the values are written to  *
+ *           history, so it never holds values missing in the database.       *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_vc_add_values_async(zbx_vector_ptr_t *history)
+{
+	return zbx_history_add_values_async(history);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_vc_wait_values                                               *
+ *                                                                            *
+ * Purpose: waits for item values to be written to history and adds them to  *
+ *          the value cache                                                   *
+ *                                                                            *
+ * Parameters: history - [IN] item history values passed to                   *
+ *                            zbx_vc_add_values_async()                       *
+ *                                                                            *
+ * Return value: SUCCEED - the values were added successfully                 *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_vc_wait_values(zbx_vector_ptr_t *history)
+{
+	if (FAIL == zbx_history_wait_async())
+		return FAIL;
+
+	vc_add_values(history);
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_vc_get_values                                                *
+ *                                                                            *
+ * Purpose: get item history data for the specified time period               *
+ *                                                                            *
+ * Parameters: itemid     - [IN] the item id                                  *
+ *             value_type - [IN] the item value type                          *
+ *             values     - [OUT] the item history data stored time/value     *
+ *                          pairs in descending order                         *
+ *             seconds    - [IN] the time period to retrieve data for         *
+ *             count      - [IN] the number of history values to retrieve     *
+ *             ts         - [IN] the period end timestamp                     *
+ *                                                                            *
+ * Return value:  SUCCEED - the item history data was retrieved successfully  *
+ *                FAIL    - the item history data was not retrieved           *
+ *                                                                            *
+ * Comments: If the data is not in cache, it's read from DB, so this function *
+ *           will always return the requested data, unless some error occurs. *
+ *                                                                            *
+ *           If <count> is set then value range is defined as <count> values  *
+ *           before <timestamp>. Otherwise the range is defined as <seconds>  *
+ *           seconds before <timestamp>.                                      *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_vc_get_values(zbx_uint64_t itemid, int value_type, zbx_vector_history_record_t *values, int seconds,
+		int count, const zbx_timespec_t *ts)
+{
+	zbx_vc_item_t	*item, new_item;
+	zbx_vc_cache_t	*stripe;
+	int 		ret = FAIL, cache_used = 1;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() itemid:" ZBX_FS_UI64 " value_type:%d seconds:%d count:%d sec:%d ns:%d",
+			__func__, itemid, value_type, seconds, count, ts->sec, ts->ns);
+
+	stripe = vc_get_stripe(itemid);
+	RDLOCK_STRIPE(stripe);
+
+	if (ZBX_VC_DISABLED == vc_state)
+		goto out;
+
+	if (ZBX_VC_MODE_LOWMEM == vc_cache->mode)
+		vc_warn_low_memory();
+
+	if (NULL == (item = (zbx_vc_item_t *)zbx_hashset_search(&vc_cache->items, &itemid)))
+	{
+		if (ZBX_VC_MODE_NORMAL != vc_cache->mode)
+			goto out;
+
+		memset(&new_item, 0, sizeof(new_item));
+		new_item.itemid = itemid;
+		new_item.value_type = value_type;
+		item = &new_item;
+	}
+	else if (item->value_type != value_type)
+		goto out;
+
+	ret = vch_item_get_values(item, values, seconds, count, ts);
+out:
+	if (FAIL == ret)
+	{
+		cache_used = 0;
+
+		UNLOCK_STRIPE(stripe);
+		ret = vc_db_get_values(itemid, value_type, values, seconds, count, ts);
+		WRLOCK_STRIPE(stripe);
+
+		if (ZBX_VC_DISABLED != vc_state)
+			vc_remove_item_by_id(itemid);
+
+		if (SUCCEED == ret)
+			vc_update_statistics(NULL, 0, values->values_num, time(NULL));
+	}
+
+	UNLOCK_STRIPE(stripe);
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%s count:%d cached:%d",
+			__func__, zbx_result_string(ret), values->values_num, cache_used);
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_vc_get_value                                                 *
+ *                                                                            *
+ * Purpose: get the last history value with a timestamp less or equal to the  *
+ *          target timestamp                                                  *
+ *                                                                            *
+ * Parameters: itemid     - [IN] the item id                                  *
+ *             value_type - [IN] the item value type                          *
+ *             ts         - [IN] the target timestamp                         *
+ *             value      - [OUT] the value found                             *
+ *                                                                            *
+ * Return Value: SUCCEED - the item was retrieved                             *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ * Comments: Depending on the value type this function might allocate memory  *
+ *           to store value data. To free it use zbx_vc_history_value_clear() *
+ *           function.                                                        *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_vc_get_value(zbx_uint64_t itemid, int value_type, const zbx_timespec_t *ts, zbx_history_record_t *value)
+{
+	zbx_vector_history_record_t	values;
+	int				ret = FAIL;
+
+	zbx_history_record_vector_create(&values);
+
+	if (SUCCEED != zbx_vc_get_values(itemid, value_type, &values, ts->sec, 1, ts) || 0 == values.values_num)
+		goto out;
+
+	*value = values.values[0];
+
+	/* reset values vector size so the returned value is not cleared when destroying the vector */
+	values.values_num = 0;
+
+	ret = SUCCEED;
+out:
+	zbx_history_record_vector_destroy(&values, value_type);
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_vc_get_aggregate                                             *
+ *                                                                            *
+ * Purpose: get aggregate of item values in the specified time period         *
+ *                                                                            *
+ * Parameters: itemid     - [IN] the item id                                  *
+ *             value_type - [IN] the item value type (float or unsigned)      *
+ *             seconds    - [IN] the time period length                       *
+ *             ts         - [IN] the period end timestamp                     *
+ *             flags      - [IN] the required aggregate data, see             *
+ *                               ZBX_VC_AGGREGATE_* defines                   *
+ *             aggregate  - [OUT] the aggregate                               *
+ *                                                                            *
+ * Return value:  SUCCEED - the aggregate was retrieved                       *
+ *                FAIL    - the aggregate is not available, the values must   *
+ *                          be retrieved with zbx_vc_get_values()             *
+ *                                                                            *
+ * Comments: The first request registers aggregate of the time window ending *
+ *           at the newest cached item value. The aggregate is updated when   *
+ *           new values are added, so following requests with close period    *
+ *           end timestamps process only the values between the windows.      *
+ *                                                                            *
+ *           The aggregate is available only if all values of the time period *
+ *           are cached. Otherwise this function fails and the values can be  *
+ *           cached by zbx_vc_get_values() call.                              *
+ *                                                                            *
+ *           Minimum and maximum values are not available after they have     *
+ *           left the window until the window is rescanned after adding as    *
+ *           many values as it has.                                           *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_vc_get_aggregate(zbx_uint64_t itemid, int value_type, int seconds, const zbx_timespec_t *ts,
+		unsigned char flags, zbx_vc_aggregate_t *aggregate)
+{
+	zbx_vc_item_t	*item;
+	zbx_vc_aggr_t	*aggr;
+	zbx_vc_cache_t	*stripe;
+	int		ret = FAIL, now;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() itemid:" ZBX_FS_UI64 " value_type:%d seconds:%d sec:%d ns:%d",
+			__func__, itemid, value_type, seconds, ts->sec, ts->ns);
+
+	stripe = vc_get_stripe(itemid);
+	RDLOCK_STRIPE(stripe);
+
+	if (ZBX_VC_DISABLED == vc_state || 0 >= seconds ||
+			(ITEM_VALUE_TYPE_FLOAT != value_type && ITEM_VALUE_TYPE_UINT64 != value_type))
+	{
+		goto out;
+	}
+
+	if (NULL == (item = (zbx_vc_item_t *)zbx_hashset_search(&vc_cache->items, &itemid)) ||
+			item->value_type != value_type || NULL == item->head)
+	{
+		goto out;
+	}
+
+	if (NULL != (aggr = vch_item_get_aggr(item, seconds)))
+	{
+		if (SUCCEED == vch_item_move_aggr(item, aggr, ts, aggregate, NULL) &&
+				flags == (aggregate->flags & flags))
+		{
+			ret = SUCCEED;
+			goto out;
+		}
+
+		/* Valid aggregates are not rescanned under write lock for invalidated min/max values, */
+		/* they are restored by periodic rescan in vch_item_update_aggrs().                    */
+		if (0 != aggr->valid)
+			goto out;
+	}
+
+	/* register or rescan the aggregate */
+
+	UNLOCK_STRIPE(stripe);
+	WRLOCK_STRIPE(stripe);
+
+	if (ZBX_VC_DISABLED == vc_state)
+		goto out;
+
+	if (NULL == (item = (zbx_vc_item_t *)zbx_hashset_search(&vc_cache->items, &itemid)) ||
+			item->value_type != value_type || NULL == item->head)
+	{
+		goto out;
+	}
+
+	if (NULL == (aggr = vch_item_get_aggr(item, seconds)) && NULL == (aggr = vch_item_add_aggr(item, seconds)))
+		goto out;
+
+	if (0 == aggr->valid)
+	{
+		aggr->end = item->head->slots[item->head->last_value].timestamp;
+		vch_item_scan_aggr(item, aggr);
+	}
+
+	if (SUCCEED == vch_item_move_aggr(item, aggr, ts, aggregate, NULL) && flags == (aggregate->flags & flags))
+		ret = SUCCEED;
+out:
+	if (SUCCEED == ret)
+	{
+		vc_aggregate_finish(aggregate, value_type);
+
+		now = time(NULL);
+		/* add another second to include nanosecond shifts */
+		vc_cache_item_update(itemid, ZBX_VC_UPDATE_RANGE, seconds + now - ts->sec + 1, now);
+		vc_cache_item_update(itemid, ZBX_VC_UPDATE_STATS, aggregate->count, 0);
+		vc_cache_item_update(itemid, ZBX_VC_UPDATE_AGGR, seconds, now);
+	}
+
+	UNLOCK_STRIPE(stripe);
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%s", __func__, zbx_result_string(ret));
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_vc_get_percentile                                            *
+ *                                                                            *
+ * Purpose: estimates percentile of numeric item values in time window        *
+ *                                                                            *
+ * Parameters: itemid     - [IN] the item id                                  *
+ *             value_type - [IN] the item value type (float or unsigned)      *
+ *             seconds    - [IN] the time window length                       *
+ *             ts         - [IN] the window end timestamp                     *
+ *             percentage - [IN] the percentage (0-100)                       *
+ *             value      - [OUT] the percentile value                        *
+ *                                                                            *
+ * Return value: SUCCEED - the percentile was estimated                       *
+ *               FAIL    - the percentile sketch is disabled or not available *
+ *                         for the window, the percentile must be calculated  *
+ *                         from zbx_vc_get_values() output                    *
+ *                                                                            *
+ * Comments: The percentile is estimated with ZBX_VC_SKETCH_ACCURACY relative *
+ *           error from sketch kept together with the window aggregate (see   *
+ *           zbx_vc_get_aggregate()). Sketches are kept only for windows with *
+ *           at least ZBX_VC_SKETCH_VALUES_MIN values, smaller windows must   *
+ *           be calculated exactly.                                           *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_vc_get_percentile(zbx_uint64_t itemid, int value_type, int seconds, const zbx_timespec_t *ts,
+		double percentage, history_value_t *value)
+{
+	zbx_vc_item_t	*item;
+	zbx_vc_aggr_t	*aggr = NULL;
+	zbx_vc_cache_t	*stripe;
+	int		ret = FAIL, now, count = 0;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() itemid:" ZBX_FS_UI64 " value_type:%d seconds:%d sec:%d ns:%d"
+			" percentage:" ZBX_FS_DBL, __func__, itemid, value_type, seconds, ts->sec, ts->ns, percentage);
+
+	if (0 == CONFIG_VALUE_CACHE_PERCENTILE_SKETCH)
+		goto finish;
+
+	stripe = vc_get_stripe(itemid);
+	RDLOCK_STRIPE(stripe);
+
+	if (ZBX_VC_DISABLED == vc_state || 0 >= seconds ||
+			(ITEM_VALUE_TYPE_FLOAT != value_type && ITEM_VALUE_TYPE_UINT64 != value_type))
+	{
+		goto out;
+	}
+
+	if (NULL == (item = (zbx_vc_item_t *)zbx_hashset_search(&vc_cache->items, &itemid)) ||
+			item->value_type != value_type || NULL == item->head)
+	{
+		goto out;
+	}
+
+	if (NULL != (aggr = vch_item_get_aggr(item, seconds)))
+	{
+		if (SUCCEED == (ret = vch_item_get_percentile(item, aggr, ts, percentage, value, &count)))
+			goto out;
+
+		/* the window is too small or the sketch will be rebuilt by the next window rescan */
+		if (0 != aggr->valid && (NULL != aggr->sketch.buckets || vc_sketch_values_min > aggr->value.count))
+			goto out;
+	}
+
+	/* register or rescan the aggregate and its sketch */
+
+	UNLOCK_STRIPE(stripe);
+	WRLOCK_STRIPE(stripe);
+
+	if (ZBX_VC_DISABLED == vc_state)
+		goto out;
+
+	if (NULL == (item = (zbx_vc_item_t *)zbx_hashset_search(&vc_cache->items, &itemid)) ||
+			item->value_type != value_type || NULL == item->head)
+	{
+		goto out;
+	}
+
+	if (NULL == (aggr = vch_item_get_aggr(item, seconds)) && NULL == (aggr = vch_item_add_aggr(item, seconds)))
+		goto out;
+
+	if (0 == aggr->valid)
+	{
+		aggr->end = item->head->slots[item->head->last_value].timestamp;
+		vch_item_scan_aggr(item, aggr);
+	}
+
+	/* keep sketches only for windows large enough to benefit from them */
+	if (0 != aggr->valid && NULL == aggr->sketch.buckets && vc_sketch_values_min <= aggr->value.count &&
+			SUCCEED != vch_item_add_sketch(item, aggr))
+	{
+		goto out;
+	}
+
+	ret = vch_item_get_percentile(item, aggr, ts, percentage, value, &count);
+out:
+	if (SUCCEED == ret)
+	{
+		now = time(NULL);
+		/* add another second to include nanosecond shifts */
+		vc_cache_item_update(itemid, ZBX_VC_UPDATE_RANGE, seconds + now - ts->sec + 1, now);
+		vc_cache_item_update(itemid, ZBX_VC_UPDATE_STATS, count, 0);
+	}
+
+	/* the aggregate is used to count window values also when the percentile is calculated exactly */
+	if (NULL != aggr)
+		vc_cache_item_update(itemid, ZBX_VC_UPDATE_AGGR, seconds, time(NULL));
+
+	UNLOCK_STRIPE(stripe);
+finish:
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%s", __func__, zbx_result_string(ret));
+
+	return ret;
+}
+
+static int	vc_range_compare_by_itemid(const void *d1, const void *d2)
+{
+	const zbx_vc_range_t	*r1 = (const zbx_vc_range_t *)d1;
+	const zbx_vc_range_t	*r2 = (const zbx_vc_range_t *)d2;
+
+	ZBX_RETURN_IF_NOT_EQUAL(r1->itemid, r2->itemid);
+	ZBX_RETURN_IF_NOT_EQUAL(r1->range_start, r2->range_start);
+
+	return 0;
+}
 
-		UNLOCK_CACHE;
-	}
+static int	vc_range_compare_by_start(const void *d1, const void *d2)
+{
+	const zbx_vc_range_t	*r1 = (const zbx_vc_range_t *)d1;
+	const zbx_vc_range_t	*r2 = (const zbx_vc_range_t *)d2;
 
-	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
+	ZBX_RETURN_IF_NOT_EQUAL(r1->value_type, r2->value_type);
+	ZBX_RETURN_IF_NOT_EQUAL(r1->range_start, r2->range_start);
+	ZBX_RETURN_IF_NOT_EQUAL(r1->itemid, r2->itemid);
+
+	return 0;
 }
 
 /******************************************************************************
  *                                                                            *
- * Function: zbx_vc_add_values                                                *
+ * Function: vc_prefetch_cache_values                                         *
  *                                                                            *
- * Purpose: adds item values to the history and value cache                   *
+ * Purpose: adds items with values read from history storage to cache        *
  *                                                                            *
- * Parameters: history - [IN] item history values                             *
+ * Parameters: itemids     - [IN] the items                                   *
+ *             value_type  - [IN] the items value type                        *
+ *             range_start - [IN] the range start timestamp                   *
+ *             values      - [IN] the item values, an array of vectors        *
+ *                                matching itemids                            *
  *                                                                            *
- * Return value: SUCCEED - the values were added successfully                 *
- *               FAIL    - otherwise                                          *
+ * Comments: Items cached by other processes while the values were read are   *
+ *           left unchanged.                                                  *
  *                                                                            *
  ******************************************************************************/
-int	zbx_vc_add_values(zbx_vector_ptr_t *history)
+static void	vc_prefetch_cache_values(const zbx_vector_uint64_t *itemids, int value_type, int range_start,
+		zbx_vector_history_record_t *values)
 {
-	zbx_vc_item_t		*item;
-	int 			i;
-	ZBX_DC_HISTORY		*h;
-	time_t			expire_timestamp;
+	int	i, j, misses, items_num[ZBX_VC_STRIPES_MAX] = {0};
 
-	if (FAIL == zbx_history_add_values(history))
-		return FAIL;
+	for (i = 0; i < itemids->values_num; i++)
+		items_num[vc_get_stripe_index(itemids->values[i])]++;
 
-	if (ZBX_VC_DISABLED == vc_state)
-		return SUCCEED;
+	for (j = 0; j < vc_stripes_num; j++)
+	{
+		if (0 == items_num[j])
+			continue;
 
-	expire_timestamp = time(NULL) - ZBX_VC_ITEM_EXPIRE_PERIOD;
+		WRLOCK_STRIPE(vc_stripes[j]);
 
-	WRLOCK_CACHE;
+		for (i = 0, misses = 0; i < itemids->values_num; i++)
+		{
+			zbx_vc_item_t	*item, new_item = {.itemid = itemids->values[i], .value_type = value_type};
 
-	for (i = 0; i < history->values_num; i++)
-	{
-		h = (ZBX_DC_HISTORY *)history->values[i];
+			if (ZBX_VC_DISABLED == vc_state || ZBX_VC_MODE_NORMAL != vc_cache->mode)
+				break;
 
-		if (NULL != (item = (zbx_vc_item_t *)zbx_hashset_search(&vc_cache->items, &h->itemid)))
-		{
-			zbx_history_record_t	record = {h->ts, h->value};
-			zbx_vc_chunk_t		*head = item->head;
-
-			/* If the new value type does not match the item's type in cache remove it, */
-			/* so it's cached with the correct type from correct tables when accessed   */
-			/* next time.                                                               */
-			/* Also remove item if the value adding failed. In this case we             */
-			/* won't have the latest data in cache - so the requests must go directly   */
-			/* to the database.                                                         */
-			if (item->value_type != h->value_type || item->last_accessed < expire_timestamp ||
-					FAIL == vch_item_add_value_at_head(item, &record))
+			if (j != vc_get_stripe_index(itemids->values[i]))
+				continue;
+
+			if (NULL != zbx_hashset_search(&vc_cache->items, &itemids->values[i]))
+				continue;
+
+			if (NULL == (item = (zbx_vc_item_t *)zbx_hashset_insert(&vc_cache->items, &new_item,
+					sizeof(new_item))))
 			{
-				vc_remove_item(item);
 				continue;
 			}
 
-			/* try to remove old (unused) chunks if a new chunk was added */
-			if (head != item->head)
-				vch_item_clean_cache(item);
+			if (0 < values[i].values_num)
+			{
+				zbx_vector_history_record_sort(&values[i],
+						(zbx_compare_func_t)zbx_history_record_compare_asc_func);
+
+				if (SUCCEED != vch_item_add_values_at_tail(item, values[i].values,
+						values[i].values_num))
+				{
+					vc_remove_item(item);
+					continue;
+				}
+			}
 
+			vc_item_update_db_cached_from(item, range_start);
+			misses += values[i].values_num;
 		}
-	}
 
-	UNLOCK_CACHE;
+		vc_update_statistics(NULL, 0, misses, time(NULL));
 
-	return SUCCEED;
+		UNLOCK_STRIPE(vc_stripes[j]);
+	}
 }
 
 /******************************************************************************
  *                                                                            *
- * Function: zbx_vc_get_values                                                *
- *                                                                            *
- * Purpose: get item history data for the specified time period               *
- *                                                                            *
- * Parameters: itemid     - [IN] the item id                                  *
- *             value_type - [IN] the item value type                          *
- *             values     - [OUT] the item history data stored time/value     *
- *                          pairs in descending order                         *
- *             seconds    - [IN] the time period to retrieve data for         *
- *             count      - [IN] the number of history values to retrieve     *
- *             ts         - [IN] the period end timestamp                     *
+ * Function: zbx_vc_prefetch_values                                           *
  *                                                                            *
- * Return value:  SUCCEED - the item history data was retrieved successfully  *
- *                FAIL    - the item history data was not retrieved           *
+ * Purpose: loads history of items missing from value cache                   *
  *                                                                            *
- * Comments: If the data is not in cache, it's read from DB, so this function *
- *           will always return the requested data, unless some error occurs. *
+ * Parameters: ranges - [IN] the item history ranges to load                  *
  *                                                                            *
- *           If <count> is set then value range is defined as <count> values  *
- *           before <timestamp>. Otherwise the range is defined as <seconds>  *
- *           seconds before <timestamp>.                                      *
+ * Comments: Only items that are not cached yet are loaded. Items with the     *
+ *           same value type and close range start are read from history      *
+ *           storage with a single request, so cache misses of a batch of     *
+ *           trigger functions take few history storage round-trips instead   *
+ *           of one per item.                                                 *
  *                                                                            *
  ******************************************************************************/
-int	zbx_vc_get_values(zbx_uint64_t itemid, int value_type, zbx_vector_history_record_t *values, int seconds,
-		int count, const zbx_timespec_t *ts)
+void	zbx_vc_prefetch_values(const zbx_vector_vc_range_t *ranges)
 {
-	zbx_vc_item_t	*item, new_item;
-	int 		ret = FAIL, cache_used = 1;
+	int				i, j, k, now, range_start, ranges_num[ZBX_VC_STRIPES_MAX] = {0};
+	zbx_vector_vc_range_t		misses;
+	zbx_vector_uint64_t		itemids;
+	zbx_vector_history_record_t	*values;
 
-	zabbix_log(LOG_LEVEL_DEBUG, "In %s() itemid:" ZBX_FS_UI64 " value_type:%d seconds:%d count:%d sec:%d ns:%d",
-			__func__, itemid, value_type, seconds, count, ts->sec, ts->ns);
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() ranges:%d", __func__, ranges->values_num);
 
-	RDLOCK_CACHE;
+	zbx_vector_vc_range_create(&misses);
 
 	if (ZBX_VC_DISABLED == vc_state)
 		goto out;
 
-	if (ZBX_VC_MODE_LOWMEM == vc_cache->mode)
-		vc_warn_low_memory();
+	for (i = 0; i < ranges->values_num; i++)
+		ranges_num[vc_get_stripe_index(ranges->values[i].itemid)]++;
 
-	if (NULL == (item = (zbx_vc_item_t *)zbx_hashset_search(&vc_cache->items, &itemid)))
+	for (j = 0; j < vc_stripes_num; j++)
 	{
-		if (ZBX_VC_MODE_NORMAL != vc_cache->mode)
-			goto out;
+		if (0 == ranges_num[j])
+			continue;
 
-		memset(&new_item, 0, sizeof(new_item));
-		new_item.itemid = itemid;
-		new_item.value_type = value_type;
-		item = &new_item;
+		RDLOCK_STRIPE(vc_stripes[j]);
+
+		if (ZBX_VC_MODE_NORMAL == vc_cache->mode)
+		{
+			for (i = 0; i < ranges->values_num; i++)
+			{
+				if (j != vc_get_stripe_index(ranges->values[i].itemid))
+					continue;
+
+				if (NULL == zbx_hashset_search(&vc_cache->items, &ranges->values[i].itemid))
+					zbx_vector_vc_range_append_ptr(&misses, &ranges->values[i]);
+			}
+		}
+
+		UNLOCK_STRIPE(vc_stripes[j]);
 	}
-	else if (item->value_type != value_type)
+
+	if (0 == misses.values_num)
 		goto out;
 
-	ret = vch_item_get_values(item, values, seconds, count, ts);
-out:
-	if (FAIL == ret)
+	/* keep the largest range of each item */
+	zbx_vector_vc_range_sort(&misses, vc_range_compare_by_itemid);
+
+	for (i = 1, j = 0; i < misses.values_num; i++)
 	{
-		cache_used = 0;
+		if (misses.values[i].itemid != misses.values[j].itemid)
+			misses.values[++j] = misses.values[i];
+	}
 
-		UNLOCK_CACHE;
-		ret = vc_db_get_values(itemid, value_type, values, seconds, count, ts);
-		WRLOCK_CACHE;
+	misses.values_num = j + 1;
 
-		if (ZBX_VC_DISABLED != vc_state)
-			vc_remove_item_by_id(itemid);
+	zbx_vector_vc_range_sort(&misses, vc_range_compare_by_start);
 
-		if (SUCCEED == ret)
-			vc_update_statistics(NULL, 0, values->values_num, time(NULL));
-	}
+	zbx_vector_uint64_create(&itemids);
+	values = (zbx_vector_history_record_t *)zbx_malloc(NULL,
+			sizeof(zbx_vector_history_record_t) * (size_t)misses.values_num);
 
-	UNLOCK_CACHE;
+	now = time(NULL);
 
-	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%s count:%d cached:%d",
-			__func__, zbx_result_string(ret), values->values_num, cache_used);
+	for (i = 0; i < misses.values_num; i = j)
+	{
+		const zbx_vc_range_t	*first = &misses.values[i];
 
-	return ret;
-}
+		range_start = first->range_start;
+		zbx_vector_uint64_clear(&itemids);
+		zbx_vector_uint64_append(&itemids, first->itemid);
 
-/******************************************************************************
- *                                                                            *
- * Function: zbx_vc_get_value                                                 *
- *                                                                            *
- * Purpose: get the last history value with a timestamp less or equal to the  *
- *          target timestamp                                                  *
- *                                                                            *
- * Parameters: itemid     - [IN] the item id                                  *
- *             value_type - [IN] the item value type                          *
- *             ts         - [IN] the target timestamp                         *
- *             value      - [OUT] the value found                             *
- *                                                                            *
- * Return Value: SUCCEED - the item was retrieved                             *
- *               FAIL    - otherwise                                          *
- *                                                                            *
- * Comments: Depending on the value type this function might allocate memory  *
- *           to store value data. To free it use zbx_vc_history_value_clear() *
- *           function.                                                        *
- *                                                                            *
- ******************************************************************************/
-int	zbx_vc_get_value(zbx_uint64_t itemid, int value_type, const zbx_timespec_t *ts, zbx_history_record_t *value)
-{
-	zbx_vector_history_record_t	values;
-	int				ret = FAIL;
+		for (j = i + 1; j < misses.values_num; j++)
+		{
+			const zbx_vc_range_t	*range = &misses.values[j];
 
-	zbx_history_record_vector_create(&values);
+			if (range->value_type != first->value_type || range->range_start - range_start >
+					(now - range->range_start) / ZBX_VC_PREFETCH_OVERREAD)
+			{
+				break;
+			}
 
-	if (SUCCEED != zbx_vc_get_values(itemid, value_type, &values, ts->sec, 1, ts) || 0 == values.values_num)
-		goto out;
+			zbx_vector_uint64_append(&itemids, range->itemid);
+		}
 
-	*value = values.values[0];
+		zbx_vector_uint64_sort(&itemids, ZBX_DEFAULT_UINT64_COMPARE_FUNC);
 
-	/* reset values vector size so the returned value is not cleared when destroying the vector */
-	values.values_num = 0;
+		for (k = 0; k < itemids.values_num; k++)
+			zbx_history_record_vector_create(&values[k]);
 
-	ret = SUCCEED;
+		/* decrement range start because it is excluded by history backend */
+		if (SUCCEED == zbx_history_get_values_multi(&itemids, first->value_type,
+				(0 != range_start ? range_start - 1 : 0), ZBX_JAN_2038, values))
+		{
+			vc_prefetch_cache_values(&itemids, first->value_type, range_start, values);
+		}
+
+		for (k = 0; k < itemids.values_num; k++)
+			zbx_history_record_vector_destroy(&values[k], first->value_type);
+	}
+
+	zbx_free(values);
+	zbx_vector_uint64_destroy(&itemids);
 out:
-	zbx_history_record_vector_destroy(&values, value_type);
+	zbx_vector_vc_range_destroy(&misses);
 
-	return ret;
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
 }
 
 /******************************************************************************
@@ -2756,7 +5332,8 @@ out:
  *                                                                            *
  * Purpose: retrieves usage cache statistics                                  *
  *                                                                            *
- * Parameters: stats     - [OUT] the cache usage statistics                   *
+ * Parameters: stats     - [OUT] the cache usage statistics summed over all   *
+ *                               stripes                                      *
  *                                                                            *
  * Return value:  SUCCEED - the cache statistics were retrieved successfully  *
  *                FAIL    - failed to retrieve cache statistics               *
@@ -2765,19 +5342,32 @@ out:
  ******************************************************************************/
 int	zbx_vc_get_statistics(zbx_vc_stats_t *stats)
 {
+	int	i;
+
 	if (ZBX_VC_DISABLED == vc_state)
 		return FAIL;
 
-	RDLOCK_CACHE;
+	memset(stats, 0, sizeof(zbx_vc_stats_t));
+
+	for (i = 0; i < vc_stripes_num; i++)
+	{
+		RDLOCK_STRIPE(vc_stripes[i]);
+
+		stats->hits += vc_cache->hits;
+		stats->misses += vc_cache->misses;
 
-	stats->hits = vc_cache->hits;
-	stats->misses = vc_cache->misses;
-	stats->mode = vc_cache->mode;
+		/* the cache is reported in low memory mode if any of its stripes is */
+		if (ZBX_VC_MODE_NORMAL != vc_cache->mode)
+			stats->mode = vc_cache->mode;
 
-	stats->total_size = vc_mem->total_size;
-	stats->free_size = vc_mem->free_size;
+		stats->total_size += vc_mem->total_size;
+		stats->free_size += vc_mem->free_size;
 
-	UNLOCK_CACHE;
+		stats->packed_values += vc_cache->packed_values;
+		stats->packed_size += vc_cache->packed_size;
+
+		UNLOCK_STRIPE(vc_stripes[i]);
+	}
 
 	return SUCCEED;
 }
@@ -2791,7 +5381,7 @@ int	zbx_vc_get_statistics(zbx_vc_stats_t *stats)
  ******************************************************************************/
 void	zbx_vc_enable(void)
 {
-	if (NULL != vc_cache)
+	if (0 != vc_stripes_num)
 		vc_state = ZBX_VC_ENABLED;
 }
 
@@ -2818,46 +5408,149 @@ void	zbx_vc_get_diag_stats(zbx_uint64_t *items_num, zbx_uint64_t *values_num, in
 {
 	zbx_hashset_iter_t	iter;
 	zbx_vc_item_t		*item;
+	int			i;
 
 	*values_num = 0;
+	*items_num = 0;
 
 	if (ZBX_VC_DISABLED == vc_state)
 	{
-		*items_num = 0;
 		*mode = -1;
 		return;
 	}
 
-	RDLOCK_CACHE;
+	*mode = ZBX_VC_MODE_NORMAL;
 
-	*items_num = vc_cache->items.num_data;
-	*mode = vc_cache->mode;
+	for (i = 0; i < vc_stripes_num; i++)
+	{
+		RDLOCK_STRIPE(vc_stripes[i]);
 
-	zbx_hashset_iter_reset(&vc_cache->items, &iter);
+		*items_num += vc_cache->items.num_data;
+
+		if (ZBX_VC_MODE_NORMAL != vc_cache->mode)
+			*mode = vc_cache->mode;
+
+		zbx_hashset_iter_reset(&vc_cache->items, &iter);
+		while (NULL != (item = (zbx_vc_item_t *)zbx_hashset_iter_next(&iter)))
+			*values_num += item->values_total;
+
+		UNLOCK_STRIPE(vc_stripes[i]);
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_vc_get_stripes_num                                           *
+ *                                                                            *
+ * Purpose: get the number of value cache stripes                             *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_vc_get_stripes_num(void)
+{
+	if (ZBX_VC_DISABLED == vc_state)
+		return 0;
+
+	return vc_stripes_num;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_vc_get_stripe_diag_stats                                     *
+ *                                                                            *
+ * Purpose: get diagnostics statistics of a value cache stripe                *
+ *                                                                            *
+ * Parameters: stripe_index - [IN] the stripe index                           *
+ *             stats        - [OUT] the stripe statistics                     *
+ *                                                                            *
+ * Comments: Read locks are added to stripe statistics when the process       *
+ *           taking them locks the stripe for writing, so the read lock       *
+ *           counters can lag behind.                                         *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_vc_get_stripe_diag_stats(int stripe_index, zbx_vc_stripe_stats_t *stats)
+{
+	zbx_hashset_iter_t	iter;
+	zbx_vc_item_t		*item;
+	zbx_vc_cache_t		*stripe = vc_stripes[stripe_index];
+
+	stats->values_num = 0;
+
+	RDLOCK_STRIPE(stripe);
+
+	stats->items_num = stripe->items.num_data;
+	stats->mode = stripe->mode;
+	stats->mem_free = stripe->mem->free_size;
+	stats->mem_total = stripe->mem->total_size;
+	stats->rdlocks = stripe->rdlocks;
+	stats->rdlock_waits = stripe->rdlock_waits;
+	stats->wrlocks = stripe->wrlocks;
+	stats->wrlock_waits = stripe->wrlock_waits;
+
+	zbx_hashset_iter_reset(&stripe->items, &iter);
 	while (NULL != (item = (zbx_vc_item_t *)zbx_hashset_iter_next(&iter)))
-		*values_num += item->values_total;
+		stats->values_num += item->values_total;
 
-	UNLOCK_CACHE;
+	UNLOCK_STRIPE(stripe);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vc_mem_stats_add                                                 *
+ *                                                                            *
+ * Purpose: add shared memory allocator statistics of a stripe to the total   *
+ *                                                                            *
+ ******************************************************************************/
+static void	vc_mem_stats_add(zbx_mem_stats_t *total, const zbx_mem_stats_t *stats)
+{
+	int	i;
+
+	if (0 == total->used_chunks + total->free_chunks)
+	{
+		*total = *stats;
+		return;
+	}
+
+	total->free_size += stats->free_size;
+	total->used_size += stats->used_size;
+	total->overhead += stats->overhead;
+	total->free_chunks += stats->free_chunks;
+	total->used_chunks += stats->used_chunks;
+
+	if (stats->min_chunk_size < total->min_chunk_size)
+		total->min_chunk_size = stats->min_chunk_size;
+
+	if (stats->max_chunk_size > total->max_chunk_size)
+		total->max_chunk_size = stats->max_chunk_size;
+
+	for (i = 0; i < MEM_BUCKET_COUNT; i++)
+		total->chunks_num[i] += stats->chunks_num[i];
 }
 
 /******************************************************************************
  *                                                                            *
  * Function: zbx_hc_get_mem_stats                                             *
  *                                                                            *
- * Purpose: get value cache shared memory statistics                          *
+ * Purpose: get value cache shared memory statistics summed over all stripes  *
  *                                                                            *
  ******************************************************************************/
 void	zbx_vc_get_mem_stats(zbx_mem_stats_t *mem)
 {
+	int		i;
+	zbx_mem_stats_t	stats;
+
+	memset(mem, 0, sizeof(zbx_mem_stats_t));
+
 	if (ZBX_VC_DISABLED == vc_state)
-	{
-		memset(mem, 0, sizeof(zbx_mem_stats_t));
 		return;
-	}
 
-	RDLOCK_CACHE;
-	zbx_mem_get_stats(vc_mem, mem);
-	UNLOCK_CACHE;
+	for (i = 0; i < vc_stripes_num; i++)
+	{
+		RDLOCK_STRIPE(vc_stripes[i]);
+		zbx_mem_get_stats(vc_mem, &stats);
+		UNLOCK_STRIPE(vc_stripes[i]);
+
+		vc_mem_stats_add(mem, &stats);
+	}
 }
 
 /******************************************************************************
@@ -2872,25 +5565,29 @@ void	zbx_vc_get_item_stats(zbx_vector_ptr_t *stats)
 	zbx_hashset_iter_t	iter;
 	zbx_vc_item_t		*item;
 	zbx_vc_item_stats_t	*item_stats;
+	int			i;
 
 	if (ZBX_VC_DISABLED == vc_state)
 		return;
 
-	RDLOCK_CACHE;
+	for (i = 0; i < vc_stripes_num; i++)
+	{
+		RDLOCK_STRIPE(vc_stripes[i]);
+
+		zbx_vector_ptr_reserve(stats, stats->values_num + vc_cache->items.num_data);
 
-	zbx_vector_ptr_reserve(stats, vc_cache->items.num_data);
+		zbx_hashset_iter_reset(&vc_cache->items, &iter);
+		while (NULL != (item = (zbx_vc_item_t *)zbx_hashset_iter_next(&iter)))
+		{
+			item_stats = (zbx_vc_item_stats_t *)zbx_malloc(NULL, sizeof(zbx_vc_item_stats_t));
+			item_stats->itemid = item->itemid;
+			item_stats->values_num = item->values_total;
+			item_stats->hourly_num = item->last_hourly_num;
+			zbx_vector_ptr_append(stats, item_stats);
+		}
 
-	zbx_hashset_iter_reset(&vc_cache->items, &iter);
-	while (NULL != (item = (zbx_vc_item_t *)zbx_hashset_iter_next(&iter)))
-	{
-		item_stats = (zbx_vc_item_stats_t *)zbx_malloc(NULL, sizeof(zbx_vc_item_stats_t));
-		item_stats->itemid = item->itemid;
-		item_stats->values_num = item->values_total;
-		item_stats->hourly_num = item->last_hourly_num;
-		zbx_vector_ptr_append(stats, item_stats);
+		UNLOCK_STRIPE(vc_stripes[i]);
 	}
-
-	UNLOCK_CACHE;
 }
 
 /******************************************************************************
@@ -2902,9 +5599,9 @@ void	zbx_vc_get_item_stats(zbx_vector_ptr_t *stats)
  ******************************************************************************/
 void	zbx_vc_flush_stats(void)
 {
-	int		i, now;
+	int		i, j, now, updates_num[ZBX_VC_STRIPES_MAX] = {0};
 	zbx_vc_item_t	*item = NULL;
-	zbx_uint64_t	itemid = 0;
+	zbx_uint64_t	itemid;
 
 	if (ZBX_VC_DISABLED == vc_state || 0 == vc_itemupdates.values_num)
 		return;
@@ -2913,35 +5610,51 @@ void	zbx_vc_flush_stats(void)
 
 	now = time(NULL);
 
-	WRLOCK_CACHE;
-
 	for (i = 0; i < vc_itemupdates.values_num; i++)
+		updates_num[vc_get_stripe_index(vc_itemupdates.values[i].itemid)]++;
+
+	for (j = 0; j < vc_stripes_num; j++)
 	{
-		zbx_vc_item_update_t	*update = &vc_itemupdates.values[i];
+		if (0 == updates_num[j])
+			continue;
+
+		WRLOCK_STRIPE(vc_stripes[j]);
 
-		if (itemid != update->itemid)
+		for (i = 0, itemid = 0; i < vc_itemupdates.values_num; i++)
 		{
-			itemid = update->itemid;
-			item = (zbx_vc_item_t *)zbx_hashset_search(&vc_cache->items, &itemid);
-		}
+			zbx_vc_item_update_t	*update = &vc_itemupdates.values[i];
 
-		if (NULL == item)
-			continue;
+			if (j != vc_get_stripe_index(update->itemid))
+				continue;
 
-		switch (update->type)
-		{
-			case ZBX_VC_UPDATE_RANGE:
-				vch_item_update_range(item, update->data[ZBX_VC_UPDATE_RANGE_SECONDS],
-						update->data[ZBX_VC_UPDATE_RANGE_NOW]);
-				break;
-			case ZBX_VC_UPDATE_STATS:
-				vc_update_statistics(item, update->data[ZBX_VC_UPDATE_STATS_HITS],
-						update->data[ZBX_VC_UPDATE_STATS_MISSES], now);
-				break;
+			if (itemid != update->itemid)
+			{
+				itemid = update->itemid;
+				item = (zbx_vc_item_t *)zbx_hashset_search(&vc_cache->items, &itemid);
+			}
+
+			if (NULL == item)
+				continue;
+
+			switch (update->type)
+			{
+				case ZBX_VC_UPDATE_RANGE:
+					vch_item_update_range(item, update->data[ZBX_VC_UPDATE_RANGE_SECONDS],
+							update->data[ZBX_VC_UPDATE_RANGE_NOW]);
+					break;
+				case ZBX_VC_UPDATE_STATS:
+					vc_update_statistics(item, update->data[ZBX_VC_UPDATE_STATS_HITS],
+							update->data[ZBX_VC_UPDATE_STATS_MISSES], now);
+					break;
+				case ZBX_VC_UPDATE_AGGR:
+					vch_item_touch_aggr(item, update->data[ZBX_VC_UPDATE_AGGR_SECONDS],
+							update->data[ZBX_VC_UPDATE_AGGR_NOW]);
+					break;
+			}
 		}
-	}
 
-	UNLOCK_CACHE;
+		UNLOCK_STRIPE(vc_stripes[j]);
+	}
 
 	zbx_vector_vc_itemupdate_clear(&vc_itemupdates);
 }
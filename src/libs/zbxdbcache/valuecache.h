@@ -24,6 +24,7 @@
 #include "zbxalgo.h"
 #include "zbxhistory.h"
 #include "memalloc.h"
+#include "mutexs.h"
 
 /*
  * The Value Cache provides read caching of item historical data residing in history
@@ -50,17 +51,30 @@
  *   either zbx_history_record_vector_destroy() function (free the zbx_vc_get_values()
  *   call output) or zbx_history_record_clear() function (free the zbx_vc_get_value() call output).
  *
+ *   The count, sum, minimum and maximum of numeric item values in a time window can be
+ *   retrieved with zbx_vc_get_aggregate() function. The first request registers the window
+ *   and afterwards its aggregate is updated incrementally when new values are added.
+ *   Minimum and maximum values leaving the window are restored only by periodic window
+ *   rescan, meanwhile they must be calculated from zbx_vc_get_values() output.
+ *   When enabled, percentiles of large windows are estimated with zbx_vc_get_percentile()
+ *   function from a sketch updated together with the window aggregate.
+ *
  * Locking
  *
  *   The cache ensures synchronization between processes by using automatic locks whenever
  *   a cache function (zbx_vc_*) is called and by providing manual cache locking functionality
  *   with zbx_vc_lock()/zbx_vc_unlock() functions.
  *
+ *   The cache can be split into up to ZBX_VC_STRIPES_MAX stripes, each protected by its own
+ *   lock. Items are assigned to stripes by itemid.
+ *
  */
 
 #define ZBX_VC_MODE_NORMAL	0
 #define ZBX_VC_MODE_LOWMEM	1
 
+#define ZBX_VC_STRIPES_MAX	(ZBX_RWLOCK_VALUECACHE_STRIPES_NUM + 1)
+
 /* indicates that all values from database are cached */
 #define ZBX_ITEM_STATUS_CACHED_ALL	1
 
@@ -78,6 +92,10 @@ typedef struct
 	zbx_uint64_t	total_size;
 	zbx_uint64_t	free_size;
 
+	/* the number of values stored in compressed chunks and the size of these chunks */
+	zbx_uint64_t	packed_values;
+	zbx_uint64_t	packed_size;
+
 	/* value cache operating mode - see ZBX_VC_MODE_* defines */
 	int		mode;
 }
@@ -92,6 +110,66 @@ typedef struct
 }
 zbx_vc_item_stats_t;
 
+/* stripe diagnostic statistics */
+typedef struct
+{
+	zbx_uint64_t	items_num;
+	zbx_uint64_t	values_num;
+	zbx_uint64_t	mem_free;
+	zbx_uint64_t	mem_total;
+
+	/* the number of read and write locks and how many of them had to wait for the lock */
+	zbx_uint64_t	rdlocks;
+	zbx_uint64_t	rdlock_waits;
+	zbx_uint64_t	wrlocks;
+	zbx_uint64_t	wrlock_waits;
+
+	/* stripe operating mode - see ZBX_VC_MODE_* defines */
+	int		mode;
+}
+zbx_vc_stripe_stats_t;
+
+/* item history range to be loaded into value cache */
+typedef struct
+{
+	zbx_uint64_t	itemid;
+	int		value_type;
+
+	/* the oldest value timestamp to load */
+	int		range_start;
+}
+zbx_vc_range_t;
+
+ZBX_VECTOR_DECL(vc_range, zbx_vc_range_t)
+
+/* the aggregate min/max values are valid */
+#define ZBX_VC_AGGREGATE_MINMAX		0x01
+
+/* aggregate of numeric item values in time window */
+typedef struct
+{
+	/* the number of values */
+	int		count;
+
+	/* the sum of values, unsigned values are summed with wraparound */
+	history_value_t	sum;
+
+	/* the sum of values as floating point number, used to calculate average */
+	double		total;
+
+	/* the rounding error of total (Neumaier summation), added to total and float */
+	/* sum when aggregate is returned                                            */
+	double		total_error;
+
+	/* the minimum and maximum values, valid only with ZBX_VC_AGGREGATE_MINMAX flag */
+	history_value_t	min;
+	history_value_t	max;
+
+	/* see ZBX_VC_AGGREGATE_* defines */
+	unsigned char	flags;
+}
+zbx_vc_aggregate_t;
+
 int	zbx_vc_init(char **error);
 
 void	zbx_vc_destroy(void);
@@ -107,13 +185,27 @@ int	zbx_vc_get_values(zbx_uint64_t itemid, int value_type, zbx_vector_history_re
 
 int	zbx_vc_get_value(zbx_uint64_t itemid, int value_type, const zbx_timespec_t *ts, zbx_history_record_t *value);
 
+void	zbx_vc_prefetch_values(const zbx_vector_vc_range_t *ranges);
+
+int	zbx_vc_get_aggregate(zbx_uint64_t itemid, int value_type, int seconds, const zbx_timespec_t *ts,
+		unsigned char flags, zbx_vc_aggregate_t *aggregate);
+
+int	zbx_vc_get_percentile(zbx_uint64_t itemid, int value_type, int seconds, const zbx_timespec_t *ts,
+		double percentage, history_value_t *value);
+
 int	zbx_vc_add_values(zbx_vector_ptr_t *history);
+int	zbx_vc_add_values_async(zbx_vector_ptr_t *history);
+int	zbx_vc_wait_values(zbx_vector_ptr_t *history);
 
 int	zbx_vc_get_statistics(zbx_vc_stats_t *stats);
 
 void	zbx_vc_housekeeping_value_cache(void);
 
+int	zbx_vc_snapshot_save(void);
+
 void	zbx_vc_get_diag_stats(zbx_uint64_t *items_num, zbx_uint64_t *values_num, int *mode);
+int	zbx_vc_get_stripes_num(void);
+void	zbx_vc_get_stripe_diag_stats(int stripe_index, zbx_vc_stripe_stats_t *stats);
 void	zbx_vc_get_mem_stats(zbx_mem_stats_t *mem);
 void	zbx_vc_get_item_stats(zbx_vector_ptr_t *stats);
 void	zbx_vc_flush_stats(void);
@@ -2729,6 +2729,7 @@ void	zbx_db_insert_prepare_dyn(zbx_db_insert_t *self, const ZBX_TABLE *table, co
 	}
 
 	self->autoincrement = -1;
+	self->copy = 0;
 
 	zbx_vector_ptr_create(&self->fields);
 	zbx_vector_ptr_create(&self->rows);
@@ -2834,7 +2835,9 @@ void	zbx_db_insert_add_values_dyn(zbx_db_insert_t *self, const zbx_db_value_t **
 #ifdef HAVE_ORACLE
 				row[i].str = DBdyn_escape_field_len(field, value->str, ESCAPE_SEQUENCE_OFF);
 #else
-				row[i].str = DBdyn_escape_field_len(field, value->str, ESCAPE_SEQUENCE_ON);
+				/* strings inserted with COPY statement are escaped when formatting copied data */
+				row[i].str = DBdyn_escape_field_len(field, value->str,
+						0 == self->copy ? ESCAPE_SEQUENCE_ON : ESCAPE_SEQUENCE_OFF);
 #endif
 				break;
 			default:
@@ -2914,6 +2917,171 @@ void	zbx_db_insert_add_values(zbx_db_insert_t *self, ...)
 	zbx_vector_ptr_destroy(&values);
 }
 
+#ifdef HAVE_POSTGRESQL
+/******************************************************************************
+ *                                                                            *
+ * Function: db_copy_escape_alloc                                             *
+ *                                                                            *
+ * Purpose: appends string value escaped for COPY text format                 *
+ *                                                                            *
+ ******************************************************************************/
+static void	db_copy_escape_alloc(char **data, size_t *data_alloc, size_t *data_offset, const char *str)
+{
+	for (; '\0' != *str; str++)
+	{
+		switch (*str)
+		{
+			case '\\':
+				zbx_strcpy_alloc(data, data_alloc, data_offset, "\\\\");
+				break;
+			case '\n':
+				zbx_strcpy_alloc(data, data_alloc, data_offset, "\\n");
+				break;
+			case '\r':
+				zbx_strcpy_alloc(data, data_alloc, data_offset, "\\r");
+				break;
+			case '\t':
+				zbx_strcpy_alloc(data, data_alloc, data_offset, "\\t");
+				break;
+			default:
+				zbx_chrcpy_alloc(data, data_alloc, data_offset, *str);
+		}
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: db_insert_format_copy                                            *
+ *                                                                            *
+ * Purpose: formats the prepared bulk insert operation as COPY statement and  *
+ *          its data                                                          *
+ *                                                                            *
+ * Parameters: self - [IN] the bulk insert data                               *
+ *             stmt - [OUT] the COPY statement, allocated                     *
+ *                                                                            *
+ * Comments: The rows are formatted in COPY text format, avoiding parsing of  *
+ *           long insert statements by database.                              *
+ *                                                                            *
+ ******************************************************************************/
+static void	db_insert_format_copy(const zbx_db_insert_t *self, zbx_db_stmt_t *stmt)
+{
+	int		i, j;
+	const ZBX_FIELD	*field;
+	char		*sql = NULL, *data = NULL;
+	size_t		sql_alloc = 0, sql_offset = 0, data_alloc = 16 * ZBX_KIBIBYTE, data_offset = 0;
+
+	zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset, "copy %s (", self->table->table);
+
+	for (i = 0; i < self->fields.values_num; i++)
+	{
+		field = (const ZBX_FIELD *)self->fields.values[i];
+
+		if (0 != i)
+			zbx_chrcpy_alloc(&sql, &sql_alloc, &sql_offset, ',');
+
+		zbx_strcpy_alloc(&sql, &sql_alloc, &sql_offset, field->name);
+	}
+
+	zbx_strcpy_alloc(&sql, &sql_alloc, &sql_offset, ") from stdin");
+
+	data = (char *)zbx_malloc(NULL, data_alloc);
+
+	for (i = 0; i < self->rows.values_num; i++)
+	{
+		const zbx_db_value_t	*values = (const zbx_db_value_t *)self->rows.values[i];
+
+		for (j = 0; j < self->fields.values_num; j++)
+		{
+			const zbx_db_value_t	*value = &values[j];
+
+			field = (const ZBX_FIELD *)self->fields.values[j];
+
+			if (0 != j)
+				zbx_chrcpy_alloc(&data, &data_alloc, &data_offset, '\t');
+
+			switch (field->type)
+			{
+				case ZBX_TYPE_CHAR:
+				case ZBX_TYPE_TEXT:
+				case ZBX_TYPE_SHORTTEXT:
+				case ZBX_TYPE_LONGTEXT:
+				case ZBX_TYPE_CUID:
+					db_copy_escape_alloc(&data, &data_alloc, &data_offset, value->str);
+					break;
+				case ZBX_TYPE_INT:
+					zbx_snprintf_alloc(&data, &data_alloc, &data_offset, "%d", value->i32);
+					break;
+				case ZBX_TYPE_FLOAT:
+					zbx_snprintf_alloc(&data, &data_alloc, &data_offset, ZBX_FS_DBL64, value->dbl);
+					break;
+				case ZBX_TYPE_UINT:
+					zbx_snprintf_alloc(&data, &data_alloc, &data_offset, ZBX_FS_UI64, value->ui64);
+					break;
+				case ZBX_TYPE_ID:
+					if (0 != value->ui64)
+					{
+						zbx_snprintf_alloc(&data, &data_alloc, &data_offset, ZBX_FS_UI64,
+								value->ui64);
+					}
+					else
+						zbx_strcpy_alloc(&data, &data_alloc, &data_offset, "\\N");
+					break;
+				default:
+					THIS_SHOULD_NEVER_HAPPEN;
+					exit(EXIT_FAILURE);
+			}
+		}
+
+		zbx_chrcpy_alloc(&data, &data_alloc, &data_offset, '\n');
+	}
+
+	stmt->sql = sql;
+	stmt->data = data;
+	stmt->data_size = data_offset;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: db_insert_copy                                                   *
+ *                                                                            *
+ * Purpose: executes the prepared database bulk insert operation with COPY    *
+ *          statement                                                         *
+ *                                                                            *
+ * Parameters: self - [IN] the bulk insert data                               *
+ *                                                                            *
+ * Return value: Returns SUCCEED if the operation completed successfully or   *
+ *               FAIL otherwise.                                              *
+ *                                                                            *
+ ******************************************************************************/
+static int	db_insert_copy(const zbx_db_insert_t *self)
+{
+	int		rc;
+	zbx_db_stmt_t	stmt;
+
+	db_insert_format_copy(self, &stmt);
+
+	rc = zbx_db_copy(stmt.sql, stmt.data, stmt.data_size);
+
+	while (ZBX_DB_DOWN == rc)
+	{
+		DBclose();
+		DBconnect(ZBX_DB_CONNECT_NORMAL);
+
+		if (ZBX_DB_DOWN == (rc = zbx_db_copy(stmt.sql, stmt.data, stmt.data_size)))
+		{
+			zabbix_log(LOG_LEVEL_ERR, "database is down: retrying in %d seconds", ZBX_DB_WAIT_DOWN);
+			connection_failure = 1;
+			sleep(ZBX_DB_WAIT_DOWN);
+		}
+	}
+
+	zbx_free(stmt.data);
+	zbx_free(stmt.sql);
+
+	return ZBX_DB_OK <= rc ? SUCCEED : FAIL;
+}
+#endif
+
 /******************************************************************************
  *                                                                            *
  * Function: zbx_db_insert_execute                                            *
@@ -2964,6 +3132,11 @@ int	zbx_db_insert_execute(zbx_db_insert_t *self)
 		}
 	}
 
+#ifdef HAVE_POSTGRESQL
+	if (0 != self->copy)
+		return db_insert_copy(self);
+#endif
+
 #ifndef HAVE_ORACLE
 	sql = (char *)zbx_malloc(NULL, sql_alloc);
 #endif
@@ -3191,6 +3364,136 @@ void	zbx_db_insert_autoincrement(zbx_db_insert_t *self, const char *field_name)
 	exit(EXIT_FAILURE);
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_db_insert_set_copy                                           *
+ *                                                                            *
+ * Purpose: makes the bulk insert operation use COPY statement instead of     *
+ *          insert statements if supported by database                        *
+ *                                                                            *
+ * Parameters: self - [IN] the bulk insert data                               *
+ *                                                                            *
+ * Comments: Only PostgreSQL supports COPY statement, for other databases     *
+ *           this function does nothing.                                      *
+ *           This function must be called before adding any values.           *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_db_insert_set_copy(zbx_db_insert_t *self)
+{
+#ifdef HAVE_POSTGRESQL
+	if (0 != self->rows.values_num)
+	{
+		THIS_SHOULD_NEVER_HAPPEN;
+		return;
+	}
+
+	self->copy = 1;
+#else
+	ZBX_UNUSED(self);
+#endif
+}
+
+#ifdef HAVE_POSTGRESQL
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_db_insert_format                                             *
+ *                                                                            *
+ * Purpose: formats the prepared bulk insert operation without executing it   *
+ *                                                                            *
+ * Parameters: self - [IN] the bulk insert data                               *
+ *             stmt - [OUT] the statement, allocated                          *
+ *                                                                            *
+ * Return value: SUCCEED - the statement was formatted                        *
+ *               FAIL    - there are no rows to insert                        *
+ *                                                                            *
+ * Comments: Operations using COPY are formatted as COPY statement with its   *
+ *           data, other operations as insert statement.                      *
+ *           Auto increment fields are not supported.                         *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_db_insert_format(const zbx_db_insert_t *self, zbx_db_stmt_t *stmt)
+{
+	int		i, j;
+	const ZBX_FIELD	*field;
+	char		delim[2] = {',', '('}, *sql = NULL;
+	size_t		sql_alloc = 0, sql_offset = 0;
+
+	if (0 == self->rows.values_num)
+		return FAIL;
+
+	if (0 != self->copy)
+	{
+		db_insert_format_copy(self, stmt);
+		return SUCCEED;
+	}
+
+	zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset, "insert into %s ", self->table->table);
+
+	for (i = 0; i < self->fields.values_num; i++)
+	{
+		field = (const ZBX_FIELD *)self->fields.values[i];
+
+		zbx_chrcpy_alloc(&sql, &sql_alloc, &sql_offset, delim[0 == i]);
+		zbx_strcpy_alloc(&sql, &sql_alloc, &sql_offset, field->name);
+	}
+
+	zbx_strcpy_alloc(&sql, &sql_alloc, &sql_offset, ") values ");
+
+	for (i = 0; i < self->rows.values_num; i++)
+	{
+		const zbx_db_value_t	*values = (const zbx_db_value_t *)self->rows.values[i];
+
+		if (0 != i)
+			zbx_chrcpy_alloc(&sql, &sql_alloc, &sql_offset, ',');
+
+		for (j = 0; j < self->fields.values_num; j++)
+		{
+			const zbx_db_value_t	*value = &values[j];
+
+			field = (const ZBX_FIELD *)self->fields.values[j];
+
+			zbx_chrcpy_alloc(&sql, &sql_alloc, &sql_offset, delim[0 == j]);
+
+			switch (field->type)
+			{
+				case ZBX_TYPE_CHAR:
+				case ZBX_TYPE_TEXT:
+				case ZBX_TYPE_SHORTTEXT:
+				case ZBX_TYPE_LONGTEXT:
+				case ZBX_TYPE_CUID:
+					zbx_chrcpy_alloc(&sql, &sql_alloc, &sql_offset, '\'');
+					zbx_strcpy_alloc(&sql, &sql_alloc, &sql_offset, value->str);
+					zbx_chrcpy_alloc(&sql, &sql_alloc, &sql_offset, '\'');
+					break;
+				case ZBX_TYPE_INT:
+					zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset, "%d", value->i32);
+					break;
+				case ZBX_TYPE_FLOAT:
+					zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset, ZBX_FS_DBL64_SQL, value->dbl);
+					break;
+				case ZBX_TYPE_UINT:
+					zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset, ZBX_FS_UI64, value->ui64);
+					break;
+				case ZBX_TYPE_ID:
+					zbx_strcpy_alloc(&sql, &sql_alloc, &sql_offset, DBsql_id_ins(value->ui64));
+					break;
+				default:
+					THIS_SHOULD_NEVER_HAPPEN;
+					exit(EXIT_FAILURE);
+			}
+		}
+
+		zbx_chrcpy_alloc(&sql, &sql_alloc, &sql_offset, ')');
+	}
+
+	stmt->sql = sql;
+	stmt->data = NULL;
+	stmt->data_size = 0;
+
+	return SUCCEED;
+}
+#endif
+
 /******************************************************************************
  *                                                                            *
  * Function: zbx_db_get_database_type                                         *
@@ -487,6 +487,151 @@ static int	DBpatch_5050034(void)
 
 	return DBset_default("config", &field);
 }
+
+static int	DBpatch_5050035(void)
+{
+#if defined(HAVE_MYSQL)
+	if (ZBX_DB_OK > DBexecute(
+			"create table changelog ("
+				"changelogid bigint unsigned not null auto_increment,"
+				"object integer default '0' not null,"
+				"objectid bigint unsigned not null,"
+				"operation integer default '0' not null,"
+				"clock integer default '0' not null,"
+				"primary key (changelogid)"
+			") engine=innodb"))
+	{
+		return FAIL;
+	}
+#elif defined(HAVE_POSTGRESQL)
+	if (ZBX_DB_OK > DBexecute(
+			"create table changelog ("
+				"changelogid bigserial not null,"
+				"object integer default '0' not null,"
+				"objectid bigint not null,"
+				"operation integer default '0' not null,"
+				"clock integer default '0' not null,"
+				"primary key (changelogid)"
+			")"))
+	{
+		return FAIL;
+	}
+#elif defined(HAVE_ORACLE)
+	if (ZBX_DB_OK > DBexecute(
+			"create table changelog ("
+				"changelogid number(20) not null,"
+				"object number(10) default '0' not null,"
+				"objectid number(20) not null,"
+				"operation number(10) default '0' not null,"
+				"clock number(10) default '0' not null,"
+				"primary key (changelogid)"
+			")"))
+	{
+		return FAIL;
+	}
+
+	if (ZBX_DB_OK > DBexecute("create sequence changelog_seq start with 1 increment by 1 nomaxvalue nocache"))
+		return FAIL;
+
+	if (ZBX_DB_OK > DBexecute(
+			"create trigger changelog_tr"
+			" before insert on changelog"
+			" for each row"
+			" begin"
+				" select changelog_seq.nextval into :new.changelogid from dual;"
+			" end;"))
+	{
+		return FAIL;
+	}
+#endif
+	return SUCCEED;
+}
+
+static int	DBpatch_5050036(void)
+{
+	return DBcreate_index("changelog", "changelog_1", "clock", 0);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: DBpatch_changelog_create_triggers                                *
+ *                                                                            *
+ * Purpose: create triggers recording insert, update and delete operations    *
+ *          of the specified table in changelog                               *
+ *                                                                            *
+ * Parameters: table  - [IN] the table name                                   *
+ *             field  - [IN] the primary key field name                       *
+ *             object - [IN] the changelog object type                        *
+ *                                                                            *
+ * Return value: SUCCEED - the triggers were created successfully            *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+static int	DBpatch_changelog_create_triggers(const char *table, const char *field, int object)
+{
+	const char	*names[] = {"insert", "update", "delete"}, *rows[] = {"new", "new", "old"};
+	int		i;
+
+	for (i = 0; i < (int)ARRSIZE(names); i++)
+	{
+#if defined(HAVE_MYSQL)
+		if (ZBX_DB_OK > DBexecute(
+				"create trigger %s_%s after %s on %s"
+				" for each row"
+				" insert into changelog (object,objectid,operation,clock)"
+				" values (%d,%s.%s,%d,unix_timestamp())",
+				table, names[i], names[i], table, object, rows[i], field, i + 1))
+		{
+			return FAIL;
+		}
+#elif defined(HAVE_POSTGRESQL)
+		if (ZBX_DB_OK > DBexecute(
+				"create function changelog_%s_%s() returns trigger language plpgsql as $$"
+				" begin"
+					" insert into changelog (object,objectid,operation,clock)"
+					" values (%d,%s.%s,%d,cast(extract(epoch from now()) as integer));"
+					" return null;"
+				" end $$",
+				table, names[i], object, rows[i], field, i + 1))
+		{
+			return FAIL;
+		}
+
+		if (ZBX_DB_OK > DBexecute(
+				"create trigger %s_%s after %s on %s"
+				" for each row execute procedure changelog_%s_%s()",
+				table, names[i], names[i], table, table, names[i]))
+		{
+			return FAIL;
+		}
+#elif defined(HAVE_ORACLE)
+		if (ZBX_DB_OK > DBexecute(
+				"create trigger %s_%s after %s on %s"
+				" for each row"
+				" begin"
+					" insert into changelog (object,objectid,operation,clock)"
+					" values (%d,:%s.%s,%d,"
+						"(cast(sys_extract_utc(systimestamp) as date)-date'1970-01-01')*86400);"
+				" end;",
+				table, names[i], names[i], table, object, rows[i], field, i + 1))
+		{
+			return FAIL;
+		}
+#endif
+	}
+
+	return SUCCEED;
+}
+
+static int	DBpatch_5050037(void)
+{
+	return DBpatch_changelog_create_triggers("hosts", "hostid", 1);
+}
+
+static int	DBpatch_5050038(void)
+{
+	return DBpatch_changelog_create_triggers("items", "itemid", 2);
+}
 #endif
 
 DBPATCH_START(5050)
@@ -528,5 +673,9 @@ DBPATCH_ADD(5050031, 0, 1)
 DBPATCH_ADD(5050032, 0, 1)
 DBPATCH_ADD(5050033, 0, 1)
 DBPATCH_ADD(5050034, 0, 1)
+DBPATCH_ADD(5050035, 0, 1)
+DBPATCH_ADD(5050036, 0, 1)
+DBPATCH_ADD(5050037, 0, 1)
+DBPATCH_ADD(5050038, 0, 1)
 
 DBPATCH_END()
@@ -248,12 +248,14 @@ int	diag_add_historycache_info(const struct zbx_json_parse *jp, struct zbx_json
 	double			time1, time2, time_total = 0;
 	zbx_uint64_t		fields;
 	zbx_diag_map_t		field_map[] = {
-					{"", ZBX_DIAG_HISTORYCACHE_SIMPLE | ZBX_DIAG_HISTORYCACHE_MEMORY},
+					{"", ZBX_DIAG_HISTORYCACHE_SIMPLE | ZBX_DIAG_HISTORYCACHE_MEMORY |
+							ZBX_DIAG_HISTORYCACHE_SHARDS},
 					{"items", ZBX_DIAG_HISTORYCACHE_ITEMS},
 					{"values", ZBX_DIAG_HISTORYCACHE_VALUES},
 					{"memory", ZBX_DIAG_HISTORYCACHE_MEMORY},
 					{"memory.data", ZBX_DIAG_HISTORYCACHE_MEMORY_DATA},
 					{"memory.index", ZBX_DIAG_HISTORYCACHE_MEMORY_INDEX},
+					{"shards", ZBX_DIAG_HISTORYCACHE_SHARDS},
 					{NULL, 0}
 					};
 
@@ -283,18 +285,57 @@ int	diag_add_historycache_info(const struct zbx_json_parse *jp, struct zbx_json
 		if (0 != (fields & ZBX_DIAG_HISTORYCACHE_MEMORY))
 		{
 			zbx_mem_stats_t	data_mem, index_mem, *pdata_mem, *pindex_mem;
+			double		compression;
 
 			pdata_mem = (0 != (fields & ZBX_DIAG_HISTORYCACHE_MEMORY_DATA) ? &data_mem : NULL);
 			pindex_mem = (0 != (fields & ZBX_DIAG_HISTORYCACHE_MEMORY_INDEX) ? &index_mem : NULL);
 
 			time1 = zbx_time();
-			zbx_hc_get_mem_stats(pdata_mem, pindex_mem);
+			zbx_hc_get_mem_stats(pdata_mem, pindex_mem, &compression);
 			time2 = zbx_time();
 			time_total += time2 - time1;
 
 			zbx_json_addobject(json, "memory");
 			diag_add_mem_stats(json, "data", pdata_mem);
 			diag_add_mem_stats(json, "index", pindex_mem);
+
+			if (NULL != pdata_mem)
+				zbx_json_addfloat(json, "compression", compression);
+
+			zbx_json_close(json);
+		}
+
+		if (0 != (fields & ZBX_DIAG_HISTORYCACHE_SHARDS))
+		{
+			zbx_hc_shard_stats_t	shard_stats;
+			int			shards_num;
+
+			zbx_json_addarray(json, "shards");
+
+			time1 = zbx_time();
+			shards_num = zbx_hc_get_shards_num();
+
+			for (i = 0; i < shards_num; i++)
+			{
+				zbx_hc_get_shard_diag_stats(i, &shard_stats);
+
+				zbx_json_addobject(json, NULL);
+				zbx_json_addint64(json, "items", shard_stats.items_num);
+				zbx_json_addint64(json, "values", shard_stats.values_num);
+				zbx_json_addobject(json, "data");
+				zbx_json_adduint64(json, "free", shard_stats.data_free);
+				zbx_json_adduint64(json, "total", shard_stats.data_total);
+				zbx_json_close(json);
+				zbx_json_addobject(json, "index");
+				zbx_json_adduint64(json, "free", shard_stats.index_free);
+				zbx_json_adduint64(json, "total", shard_stats.index_total);
+				zbx_json_close(json);
+				zbx_json_close(json);
+			}
+
+			time2 = zbx_time();
+			time_total += time2 - time1;
+
 			zbx_json_close(json);
 		}
 
@@ -514,13 +555,13 @@ void	diag_add_locks_info(struct zbx_json *json)
 {
 	int		i;
 #ifdef HAVE_VMINFO_T_UPDATES
-	const char	*names[ZBX_MUTEX_COUNT] = {"ZBX_MUTEX_LOG", "ZBX_MUTEX_CACHE", "ZBX_MUTEX_TRENDS",
+	const char	*names[ZBX_MUTEX_HISTORY_SHARD] = {"ZBX_MUTEX_LOG", "ZBX_MUTEX_CACHE", "ZBX_MUTEX_TRENDS",
 				"ZBX_MUTEX_CACHE_IDS", "ZBX_MUTEX_SELFMON", "ZBX_MUTEX_CPUSTATS", "ZBX_MUTEX_DISKSTATS",
 				"ZBX_MUTEX_VALUECACHE", "ZBX_MUTEX_VMWARE", "ZBX_MUTEX_SQLITE3",
 				"ZBX_MUTEX_PROCSTAT", "ZBX_MUTEX_PROXY_HISTORY", "ZBX_MUTEX_KSTAT", "ZBX_MUTEX_MODBUS",
 				"ZBX_MUTEX_TREND_FUNC"};
 #else
-	const char	*names[ZBX_MUTEX_COUNT] = {"ZBX_MUTEX_LOG", "ZBX_MUTEX_CACHE", "ZBX_MUTEX_TRENDS",
+	const char	*names[ZBX_MUTEX_HISTORY_SHARD] = {"ZBX_MUTEX_LOG", "ZBX_MUTEX_CACHE", "ZBX_MUTEX_TRENDS",
 				"ZBX_MUTEX_CACHE_IDS", "ZBX_MUTEX_SELFMON", "ZBX_MUTEX_CPUSTATS", "ZBX_MUTEX_DISKSTATS",
 				"ZBX_MUTEX_VALUECACHE", "ZBX_MUTEX_VMWARE", "ZBX_MUTEX_SQLITE3",
 				"ZBX_MUTEX_PROCSTAT", "ZBX_MUTEX_PROXY_HISTORY", "ZBX_MUTEX_MODBUS",
@@ -528,13 +569,37 @@ void	diag_add_locks_info(struct zbx_json *json)
 #endif
 	zbx_json_addarray(json, ZBX_DIAG_LOCKS);
 
-	for (i = 0; i < ZBX_MUTEX_COUNT; i++)
+	for (i = 0; i < ZBX_MUTEX_HISTORY_SHARD; i++)
 	{
 		zbx_json_addobject(json, NULL);
 		zbx_json_addhex(json, names[i], (zbx_uint64_t)zbx_mutex_addr_get(i));
 		zbx_json_close(json);
 	}
 
+	for (i = ZBX_MUTEX_HISTORY_SHARD; i <= ZBX_MUTEX_HISTORY_SHARD_LAST; i++)
+	{
+		char	name[MAX_STRING_LEN];
+
+		zbx_snprintf(name, sizeof(name), "ZBX_MUTEX_HISTORY_SHARD_%d", i - ZBX_MUTEX_HISTORY_SHARD + 1);
+		zbx_json_addobject(json, NULL);
+		zbx_json_addhex(json, name, (zbx_uint64_t)zbx_mutex_addr_get(i));
+		zbx_json_close(json);
+	}
+
+	for (i = ZBX_MUTEX_POLLER_QUEUE; i <= ZBX_MUTEX_POLLER_QUEUE_LAST; i++)
+	{
+		char	name[MAX_STRING_LEN];
+
+		zbx_snprintf(name, sizeof(name), "ZBX_MUTEX_POLLER_QUEUE_%d", i - ZBX_MUTEX_POLLER_QUEUE);
+		zbx_json_addobject(json, NULL);
+		zbx_json_addhex(json, name, (zbx_uint64_t)zbx_mutex_addr_get(i));
+		zbx_json_close(json);
+	}
+
+	zbx_json_addobject(json, NULL);
+	zbx_json_addhex(json, "ZBX_MUTEX_POLLER_QUEUE_MEM", (zbx_uint64_t)zbx_mutex_addr_get(ZBX_MUTEX_POLLER_QUEUE_MEM));
+	zbx_json_close(json);
+
 	zbx_json_addobject(json, NULL);
 	zbx_json_addhex(json, "ZBX_RWLOCK_CONFIG", (zbx_uint64_t)zbx_rwlock_addr_get(ZBX_RWLOCK_CONFIG));
 	zbx_json_close(json);
@@ -542,6 +607,16 @@ void	diag_add_locks_info(struct zbx_json *json)
 	zbx_json_addhex(json, "ZBX_RWLOCK_VALUECACHE", (zbx_uint64_t)zbx_rwlock_addr_get(ZBX_RWLOCK_VALUECACHE));
 	zbx_json_close(json);
 
+	for (i = ZBX_RWLOCK_VALUECACHE_STRIPE; i < ZBX_RWLOCK_COUNT; i++)
+	{
+		char	name[MAX_STRING_LEN];
+
+		zbx_snprintf(name, sizeof(name), "ZBX_RWLOCK_VALUECACHE_STRIPE_%d", i - ZBX_RWLOCK_VALUECACHE_STRIPE + 1);
+		zbx_json_addobject(json, NULL);
+		zbx_json_addhex(json, name, (zbx_uint64_t)zbx_rwlock_addr_get(i));
+		zbx_json_close(json);
+	}
+
 	zbx_json_close(json);
 }
 
@@ -33,6 +33,7 @@
 #define ZBX_DIAG_HISTORYCACHE_VALUES		0x00000002
 #define ZBX_DIAG_HISTORYCACHE_MEMORY_DATA	0x00000004
 #define ZBX_DIAG_HISTORYCACHE_MEMORY_INDEX	0x00000008
+#define ZBX_DIAG_HISTORYCACHE_SHARDS		0x00000010
 
 #define ZBX_DIAG_HISTORYCACHE_SIMPLE	(ZBX_DIAG_HISTORYCACHE_ITEMS | \
 					ZBX_DIAG_HISTORYCACHE_VALUES)
@@ -44,6 +45,7 @@
 #define ZBX_DIAG_VALUECACHE_VALUES		0x00000002
 #define ZBX_DIAG_VALUECACHE_MODE		0x00000004
 #define ZBX_DIAG_VALUECACHE_MEMORY		0x00000008
+#define ZBX_DIAG_VALUECACHE_STRIPES		0x00000010
 
 #define ZBX_DIAG_VALUECACHE_SIMPLE	(ZBX_DIAG_VALUECACHE_ITEMS | \
 					ZBX_DIAG_VALUECACHE_VALUES | \
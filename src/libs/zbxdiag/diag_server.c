@@ -103,11 +103,13 @@ static int	diag_add_valuecache_info(const struct zbx_json_parse *jp, struct zbx_
 	double			time1, time2, time_total = 0;
 	zbx_uint64_t		fields;
 	zbx_diag_map_t		field_map[] = {
-					{"", ZBX_DIAG_VALUECACHE_SIMPLE | ZBX_DIAG_VALUECACHE_MEMORY},
+					{"", ZBX_DIAG_VALUECACHE_SIMPLE | ZBX_DIAG_VALUECACHE_MEMORY |
+							ZBX_DIAG_VALUECACHE_STRIPES},
 					{"items", ZBX_DIAG_VALUECACHE_ITEMS},
 					{"values", ZBX_DIAG_VALUECACHE_VALUES},
 					{"mode", ZBX_DIAG_VALUECACHE_MODE},
 					{"memory", ZBX_DIAG_VALUECACHE_MEMORY},
+					{"stripes", ZBX_DIAG_VALUECACHE_STRIPES},
 					{NULL, 0}
 					};
 
@@ -147,6 +149,43 @@ static int	diag_add_valuecache_info(const struct zbx_json_parse *jp, struct zbx_
 			diag_add_mem_stats(json, "memory", &mem);
 		}
 
+		if (0 != (fields & ZBX_DIAG_VALUECACHE_STRIPES))
+		{
+			zbx_vc_stripe_stats_t	stripe_stats;
+			int			i, stripes_num;
+
+			zbx_json_addarray(json, "stripes");
+
+			time1 = zbx_time();
+			stripes_num = zbx_vc_get_stripes_num();
+
+			for (i = 0; i < stripes_num; i++)
+			{
+				zbx_vc_get_stripe_diag_stats(i, &stripe_stats);
+
+				zbx_json_addobject(json, NULL);
+				zbx_json_addint64(json, "items", stripe_stats.items_num);
+				zbx_json_addint64(json, "values", stripe_stats.values_num);
+				zbx_json_addint64(json, "mode", stripe_stats.mode);
+				zbx_json_addobject(json, "memory");
+				zbx_json_adduint64(json, "free", stripe_stats.mem_free);
+				zbx_json_adduint64(json, "total", stripe_stats.mem_total);
+				zbx_json_close(json);
+				zbx_json_addobject(json, "locks");
+				zbx_json_adduint64(json, "read", stripe_stats.rdlocks);
+				zbx_json_adduint64(json, "read.waits", stripe_stats.rdlock_waits);
+				zbx_json_adduint64(json, "write", stripe_stats.wrlocks);
+				zbx_json_adduint64(json, "write.waits", stripe_stats.wrlock_waits);
+				zbx_json_close(json);
+				zbx_json_close(json);
+			}
+
+			time2 = zbx_time();
+			time_total += time2 - time1;
+
+			zbx_json_close(json);
+		}
+
 		if (0 != tops.values_num)
 		{
 			zbx_vector_ptr_t	items;
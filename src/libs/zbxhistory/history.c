@@ -29,9 +29,12 @@ ZBX_VECTOR_IMPL(history_record, zbx_history_record_t)
 
 extern char	*CONFIG_HISTORY_STORAGE_URL;
 extern char	*CONFIG_HISTORY_STORAGE_OPTS;
+extern char	*CONFIG_HISTORY_STORAGE_DIR;
 
 zbx_history_iface_t	history_ifaces[ITEM_VALUE_TYPE_MAX];
 
+static int	async_flags;	/* value types with asynchronous flush in progress */
+
 /************************************************************************************
  *                                                                                  *
  * Function: zbx_history_init                                                       *
@@ -40,7 +43,8 @@ zbx_history_iface_t	history_ifaces[ITEM_VALUE_TYPE_MAX];
  *                                                                                  *
  * Comments: History interfaces are created for all values types based on           *
  *           configuration. Every value type can have different history storage     *
- *           backend.                                                               *
+ *           backend. Numeric values not sent to Elasticsearch are stored in local  *
+ *           files if history storage directory is configured.                      *
  *                                                                                  *
  ************************************************************************************/
 int	zbx_history_init(char **error)
@@ -54,7 +58,15 @@ int	zbx_history_init(char **error)
 	for (i = 0; i < ITEM_VALUE_TYPE_MAX; i++)
 	{
 		if (NULL == CONFIG_HISTORY_STORAGE_URL || NULL == strstr(CONFIG_HISTORY_STORAGE_OPTS, opts[i]))
-			ret = zbx_history_sql_init(&history_ifaces[i], i, error);
+		{
+			if (NULL != CONFIG_HISTORY_STORAGE_DIR &&
+					(ITEM_VALUE_TYPE_FLOAT == i || ITEM_VALUE_TYPE_UINT64 == i))
+			{
+				ret = zbx_history_columnar_init(&history_ifaces[i], i, error);
+			}
+			else
+				ret = zbx_history_sql_init(&history_ifaces[i], i, error);
+		}
 		else
 			ret = zbx_history_elastic_init(&history_ifaces[i], i, error);
 
@@ -125,6 +137,90 @@ int	zbx_history_add_values(const zbx_vector_ptr_t *history)
 	return ret;
 }
 
+/************************************************************************************
+ *                                                                                  *
+ * Function: zbx_history_add_values_async                                           *
+ *                                                                                  *
+ * Purpose: starts sending values to the history storage                            *
+ *                                                                                  *
+ * Parameters: history - [IN] the values to store                                   *
+ *                                                                                  *
+ * Return value: SUCCEED - the values were added, zbx_history_wait_async() must be  *
+ *                         called to complete writing them                          *
+ *               FAIL    - the configured storage backends do not support           *
+ *                         asynchronous writing, nothing was done                   *
+ *                                                                                  *
+ ************************************************************************************/
+int	zbx_history_add_values_async(const zbx_vector_ptr_t *history)
+{
+	int	i;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+
+	for (i = 0; i < ITEM_VALUE_TYPE_MAX; i++)
+	{
+		if (NULL == history_ifaces[i].flush_async)
+		{
+			zabbix_log(LOG_LEVEL_DEBUG, "End of %s():FAIL", __func__);
+			return FAIL;
+		}
+	}
+
+	async_flags = 0;
+
+	for (i = 0; i < ITEM_VALUE_TYPE_MAX; i++)
+	{
+		zbx_history_iface_t	*writer = &history_ifaces[i];
+
+		if (0 < writer->add_values(writer, history))
+			async_flags |= (1 << i);
+	}
+
+	for (i = 0; i < ITEM_VALUE_TYPE_MAX; i++)
+	{
+		zbx_history_iface_t	*writer = &history_ifaces[i];
+
+		if (0 != (async_flags & (1 << i)))
+			writer->flush_async(writer);
+	}
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():SUCCEED", __func__);
+
+	return SUCCEED;
+}
+
+/************************************************************************************
+ *                                                                                  *
+ * Function: zbx_history_wait_async                                                 *
+ *                                                                                  *
+ * Purpose: waits for the values sent by zbx_history_add_values_async() to be       *
+ *          stored                                                                  *
+ *                                                                                  *
+ * Return value: SUCCEED - the values were stored                                   *
+ *               FAIL    - otherwise                                                *
+ *                                                                                  *
+ ************************************************************************************/
+int	zbx_history_wait_async(void)
+{
+	int	i, ret = SUCCEED;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+
+	for (i = 0; i < ITEM_VALUE_TYPE_MAX; i++)
+	{
+		zbx_history_iface_t	*writer = &history_ifaces[i];
+
+		if (0 != (async_flags & (1 << i)) && SUCCEED != writer->wait(writer))
+			ret = FAIL;
+	}
+
+	async_flags = 0;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%s", __func__, zbx_result_string(ret));
+
+	return ret;
+}
+
 /************************************************************************************
  *                                                                                  *
  * Function: zbx_history_get_values                                                 *
@@ -177,6 +273,50 @@ int	zbx_history_get_values(zbx_uint64_t itemid, int value_type, int start, int c
 	return ret;
 }
 
+/************************************************************************************
+ *                                                                                  *
+ * Function: zbx_history_get_values_multi                                           *
+ *                                                                                  *
+ * Purpose: gets values of multiple items from history storage                      *
+ *                                                                                  *
+ * Parameters:  itemids    - [IN] the itemids, sorted in ascending order            *
+ *              value_type - [IN] the items value type                              *
+ *              start      - [IN] the period start timestamp                        *
+ *              end        - [IN] the period end timestamp                          *
+ *              values     - [OUT] the item history data values, an array of        *
+ *                                 vectors matching itemids                         *
+ *                                                                                  *
+ * Return value: SUCCEED - the history data were read successfully                  *
+ *               FAIL - otherwise                                                   *
+ *                                                                                  *
+ * Comments: This function reads all values from ]<start>,<end>] interval.          *
+ *           Backends without multi-item support are queried item by item.         *
+ *                                                                                  *
+ ************************************************************************************/
+int	zbx_history_get_values_multi(const zbx_vector_uint64_t *itemids, int value_type, int start, int end,
+		zbx_vector_history_record_t *values)
+{
+	int			i, ret = SUCCEED;
+	zbx_history_iface_t	*writer = &history_ifaces[value_type];
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() items:%d value_type:%d start:%d end:%d", __func__,
+			itemids->values_num, value_type, start, end);
+
+	if (NULL != writer->get_values_multi)
+	{
+		ret = writer->get_values_multi(writer, itemids->values, itemids->values_num, start, end, values);
+	}
+	else
+	{
+		for (i = 0; i < itemids->values_num && SUCCEED == ret; i++)
+			ret = writer->get_values(writer, itemids->values[i], start, 0, end, &values[i]);
+	}
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%s", __func__, zbx_result_string(ret));
+
+	return ret;
+}
+
 /************************************************************************************
  *                                                                                  *
  * Function: zbx_history_requires_trends                                            *
@@ -199,6 +339,33 @@ int	zbx_history_requires_trends(int value_type)
 	return 0 != writer->requires_trends ? SUCCEED : FAIL;
 }
 
+/************************************************************************************
+ *                                                                                  *
+ * Function: zbx_history_housekeep                                                  *
+ *                                                                                  *
+ * Purpose: removes expired history of the value type from history storage         *
+ *                                                                                  *
+ * Parameters: value_type - [IN] the value type                                     *
+ *             now        - [IN] the current timestamp                              *
+ *             keep_from  - [IN] the oldest timestamp to keep, 0 to keep all        *
+ *             deleted    - [OUT] the number of removed values                      *
+ *                                                                                  *
+ * Return value: SUCCEED - the history was housekept by history storage             *
+ *               FAIL - the history storage is housekept in database, if at all     *
+ *                                                                                  *
+ ************************************************************************************/
+int	zbx_history_housekeep(int value_type, int now, int keep_from, int *deleted)
+{
+	zbx_history_iface_t	*writer = &history_ifaces[value_type];
+
+	if (NULL == writer->housekeep)
+		return FAIL;
+
+	*deleted = writer->housekeep(writer, now, keep_from);
+
+	return SUCCEED;
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: history_logfree                                                  *
@@ -31,18 +31,26 @@ typedef void (*zbx_history_destroy_func_t)(struct zbx_history_iface *hist);
 typedef int (*zbx_history_add_values_func_t)(struct zbx_history_iface *hist, const zbx_vector_ptr_t *history);
 typedef int (*zbx_history_get_values_func_t)(struct zbx_history_iface *hist, zbx_uint64_t itemid, int start,
 		int count, int end, zbx_vector_history_record_t *values);
+typedef int (*zbx_history_get_values_multi_func_t)(struct zbx_history_iface *hist, const zbx_uint64_t *itemids,
+		int itemids_num, int start, int end, zbx_vector_history_record_t *values);
 typedef int (*zbx_history_flush_func_t)(struct zbx_history_iface *hist);
+typedef void (*zbx_history_flush_async_func_t)(struct zbx_history_iface *hist);
+typedef int (*zbx_history_housekeep_func_t)(struct zbx_history_iface *hist, int now, int keep_from);
 
 struct zbx_history_iface
 {
-	unsigned char			value_type;
-	unsigned char			requires_trends;
-	void				*data;
-
-	zbx_history_destroy_func_t	destroy;
-	zbx_history_add_values_func_t	add_values;
-	zbx_history_get_values_func_t	get_values;
-	zbx_history_flush_func_t	flush;
+	unsigned char				value_type;
+	unsigned char				requires_trends;
+	void					*data;
+
+	zbx_history_destroy_func_t		destroy;
+	zbx_history_add_values_func_t		add_values;
+	zbx_history_get_values_func_t		get_values;
+	zbx_history_get_values_multi_func_t	get_values_multi;	/* NULL if not supported */
+	zbx_history_flush_func_t		flush;
+	zbx_history_flush_async_func_t		flush_async;		/* NULL if not supported */
+	zbx_history_flush_func_t		wait;
+	zbx_history_housekeep_func_t		housekeep;		/* NULL if housekept in database */
 };
 
 /* SQL hist */
@@ -53,4 +61,7 @@ int	zbx_history_elastic_init(zbx_history_iface_t *hist, unsigned char value_type
 void	zbx_elastic_version_extract(struct zbx_json *json);
 zbx_uint32_t	zbx_elastic_version_get(void);
 
+/* local columnar hist */
+int	zbx_history_columnar_init(zbx_history_iface_t *hist, unsigned char value_type, char **error);
+
 #endif
@@ -0,0 +1,1193 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "common.h"
+#include "log.h"
+#include "zbxalgo.h"
+#include "dbcache.h"
+#include "zbxhistory.h"
+#include "history.h"
+
+#include <sys/mman.h>
+
+/*
+ * Local columnar storage of numeric history.
+ *
+ * Values are stored in append-only partition files, one file per value type and hour:
+ *   <HistoryStorageDir>/<table>_<partition start timestamp>.zhc
+ *
+ * The partition file consists of header followed by chunks. Every history flush appends one chunk
+ * to each partition it has values for. A chunk consists of:
+ *   chunk header
+ *   block directory - itemid, block offset and number of values, sorted by itemid
+ *   blocks          - timestamps and values of a single item, compressed with zbx_gorilla_encode()
+ *
+ * Chunks of older partitions are merged into a single chunk by housekeeper, so each item has a single
+ * block per partition. Housekeeper also removes partitions older than the history storage period.
+ *
+ * Writers append chunks under exclusive file lock and update the committed data size in header after
+ * chunk is written. Readers map only the committed data, which is never modified afterwards. Merged
+ * partition is written into a new file which then replaces the old one, so readers still can use the
+ * old file.
+ *
+ * The files use native byte order.
+ */
+
+extern char	*CONFIG_HISTORY_STORAGE_DIR;
+
+#define ZBX_HCOL_PERIOD		SEC_PER_HOUR
+#define ZBX_HCOL_MAGIC		"ZBXHCOL"
+#define ZBX_HCOL_VERSION	1
+#define ZBX_HCOL_EXTENSION	".zhc"
+
+/* maximum size of a single value in compressed block */
+#define ZBX_HCOL_VALUE_SIZE_MAX	(ZBX_GORILLA_VALUE_BITS_MAX / 8 + 1)
+
+/* chunks are padded, so decoding of a damaged block cannot read outside the chunk */
+#define ZBX_HCOL_CHUNK_PADDING	ZBX_HCOL_VALUE_SIZE_MAX
+
+/* the maximum number of values kept for retrying after failed write */
+#define ZBX_HCOL_RETRY_VALUES_MAX	1000000
+
+#define ZBX_HCOL_ALIGN8(x)	(((x) + 7) & ~(size_t)7)
+
+typedef struct
+{
+	char		magic[8];
+	zbx_uint32_t	version;
+	zbx_uint32_t	value_type;
+	zbx_uint64_t	size;		/* committed data size, including header */
+	zbx_uint32_t	chunks_num;
+	zbx_uint32_t	reserved;
+}
+zbx_hcol_header_t;
+
+typedef struct
+{
+	zbx_uint32_t	size;		/* chunk size, including header, block directory and padding */
+	zbx_uint32_t	blocks_num;
+	int		clock_min;
+	int		clock_max;
+}
+zbx_hcol_chunk_t;
+
+typedef struct
+{
+	zbx_uint64_t	itemid;
+	zbx_uint32_t	offset;		/* block data offset from chunk start */
+	zbx_uint32_t	values_num;
+}
+zbx_hcol_block_t;
+
+/* history value prepared for writing */
+typedef struct
+{
+	zbx_uint64_t	itemid;
+	zbx_timespec_t	ts;
+	zbx_uint64_t	value;		/* value bit pattern */
+}
+zbx_hcol_value_t;
+
+typedef struct
+{
+	zbx_hcol_value_t	*values;
+	int			values_num;
+	int			values_alloc;
+
+	/* the existing partitions, sorted in descending order */
+	zbx_vector_uint64_t	periods;
+
+	/* the storage directory modification time when partitions were scanned */
+	time_t			periods_mtime;
+
+	/* the time of the last partition scan */
+	time_t			periods_scanned;
+}
+zbx_hcol_data_t;
+
+/* value_type - table name mapping */
+static const char	*hcol_tables[] = {"history", "history_str", "history_log", "history_uint", "history_text"};
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hcol_values_append                                               *
+ *                                                                            *
+ * Purpose: appends value to value array                                      *
+ *                                                                            *
+ ******************************************************************************/
+static void	hcol_values_append(zbx_hcol_data_t *data, zbx_uint64_t itemid, const zbx_timespec_t *ts,
+		zbx_uint64_t value)
+{
+	zbx_hcol_value_t	*hv;
+
+	if (data->values_num == data->values_alloc)
+	{
+		data->values_alloc = (0 == data->values_alloc ? 1024 : data->values_alloc * 2);
+		data->values = (zbx_hcol_value_t *)zbx_realloc(data->values,
+				sizeof(zbx_hcol_value_t) * (size_t)data->values_alloc);
+	}
+
+	hv = &data->values[data->values_num++];
+	hv->itemid = itemid;
+	hv->ts = *ts;
+	hv->value = value;
+}
+
+static int	hcol_get_period(int clock)
+{
+	return clock - clock % ZBX_HCOL_PERIOD;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hcol_value_compare                                               *
+ *                                                                            *
+ * Purpose: sorts values by partition, itemid and timestamp                   *
+ *                                                                            *
+ ******************************************************************************/
+static int	hcol_value_compare(const void *d1, const void *d2)
+{
+	const zbx_hcol_value_t	*v1 = (const zbx_hcol_value_t *)d1;
+	const zbx_hcol_value_t	*v2 = (const zbx_hcol_value_t *)d2;
+
+	ZBX_RETURN_IF_NOT_EQUAL(hcol_get_period(v1->ts.sec), hcol_get_period(v2->ts.sec));
+	ZBX_RETURN_IF_NOT_EQUAL(v1->itemid, v2->itemid);
+	ZBX_RETURN_IF_NOT_EQUAL(v1->ts.sec, v2->ts.sec);
+	ZBX_RETURN_IF_NOT_EQUAL(v1->ts.ns, v2->ts.ns);
+
+	return 0;
+}
+
+static char	*hcol_get_path(unsigned char value_type, int period)
+{
+	return zbx_dsprintf(NULL, "%s/%s_%d" ZBX_HCOL_EXTENSION, CONFIG_HISTORY_STORAGE_DIR, hcol_tables[value_type],
+			period);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hcol_chunk_build                                                 *
+ *                                                                            *
+ * Purpose: builds chunk from values of a single partition                    *
+ *                                                                            *
+ * Parameters: values     - [IN] the values sorted by itemid and timestamp    *
+ *             values_num - [IN] the number of values                         *
+ *             size       - [OUT] the chunk size                              *
+ *                                                                            *
+ * Return value: The chunk, must be freed by the caller, or NULL if values    *
+ *               cannot be encoded.                                           *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_hcol_chunk_t	*hcol_chunk_build(const zbx_hcol_value_t *values, int values_num, size_t *size)
+{
+	int			i, blocks_num = 1;
+	size_t			alloc, offset;
+	unsigned char		*buf;
+	zbx_hcol_chunk_t	*chunk;
+	zbx_hcol_block_t	*block = NULL;
+	zbx_gorilla_state_t	encoder;
+
+	for (i = 1; i < values_num; i++)
+	{
+		if (values[i].itemid != values[i - 1].itemid)
+			blocks_num++;
+	}
+
+	offset = sizeof(zbx_hcol_chunk_t) + sizeof(zbx_hcol_block_t) * (size_t)blocks_num;
+	alloc = ZBX_HCOL_ALIGN8(offset + ZBX_HCOL_VALUE_SIZE_MAX * (size_t)values_num + ZBX_HCOL_CHUNK_PADDING);
+	buf = (unsigned char *)zbx_malloc(NULL, alloc);
+
+	chunk = (zbx_hcol_chunk_t *)buf;
+	chunk->blocks_num = (zbx_uint32_t)blocks_num;
+	chunk->clock_min = values[0].ts.sec;
+	chunk->clock_max = values[0].ts.sec;
+
+	block = (zbx_hcol_block_t *)(chunk + 1) - 1;
+
+	for (i = 0; i < values_num; i++)
+	{
+		const zbx_hcol_value_t	*hv = &values[i];
+
+		if (0 == i || hv->itemid != values[i - 1].itemid)
+		{
+			if (0 != i)
+				offset += (encoder.bits_num + 7) / 8;
+
+			block++;
+			block->itemid = hv->itemid;
+			block->offset = (zbx_uint32_t)offset;
+			block->values_num = 0;
+			zbx_gorilla_init(&encoder);
+		}
+
+		if (SUCCEED != zbx_gorilla_encode(&encoder, buf + offset, alloc - offset, &hv->ts, hv->value))
+		{
+			THIS_SHOULD_NEVER_HAPPEN;
+			zbx_free(buf);
+			return NULL;
+		}
+
+		block->values_num++;
+
+		if (hv->ts.sec < chunk->clock_min)
+			chunk->clock_min = hv->ts.sec;
+
+		if (hv->ts.sec > chunk->clock_max)
+			chunk->clock_max = hv->ts.sec;
+	}
+
+	offset += (encoder.bits_num + 7) / 8;
+	offset = ZBX_HCOL_ALIGN8(offset + ZBX_HCOL_CHUNK_PADDING);
+	memset(buf + offset - ZBX_HCOL_CHUNK_PADDING, 0, ZBX_HCOL_CHUNK_PADDING);
+
+	chunk->size = (zbx_uint32_t)offset;
+	*size = offset;
+
+	return chunk;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hcol_header_check                                                *
+ *                                                                            *
+ * Purpose: checks if partition file header is valid                          *
+ *                                                                            *
+ ******************************************************************************/
+static int	hcol_header_check(const zbx_hcol_header_t *header, unsigned char value_type, const char *path)
+{
+	if (0 != memcmp(header->magic, ZBX_HCOL_MAGIC, sizeof(header->magic)) || ZBX_HCOL_VERSION != header->version ||
+			value_type != header->value_type || sizeof(zbx_hcol_header_t) > header->size)
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "invalid history partition file \"%s\"", path);
+		return FAIL;
+	}
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hcol_open_locked                                                 *
+ *                                                                            *
+ * Purpose: opens partition file for writing and locks it                     *
+ *                                                                            *
+ * Parameters: path  - [IN] the partition file path                           *
+ *             flags - [IN] the open() flags                                  *
+ *                                                                            *
+ * Return value: The file descriptor or -1 on error.                          *
+ *                                                                            *
+ * Comments: Merging replaces the partition file, so the lock is acquired     *
+ *           again if the opened file was replaced while waiting for lock.    *
+ *                                                                            *
+ ******************************************************************************/
+static int	hcol_open_locked(const char *path, int flags)
+{
+	int		fd;
+	zbx_stat_t	st_path;
+	struct stat	st_fd;
+
+	for (;;)
+	{
+		if (-1 == (fd = open(path, flags, 0640)))
+		{
+			if (ENOENT != errno)
+			{
+				zabbix_log(LOG_LEVEL_WARNING, "cannot open history partition file \"%s\": %s", path,
+						zbx_strerror(errno));
+			}
+
+			return -1;
+		}
+
+		if (0 != flock(fd, LOCK_EX))
+		{
+			zabbix_log(LOG_LEVEL_WARNING, "cannot lock history partition file \"%s\": %s", path,
+					zbx_strerror(errno));
+			close(fd);
+			return -1;
+		}
+
+		if (0 == fstat(fd, &st_fd) && 0 == zbx_stat(path, &st_path) && st_fd.st_ino == st_path.st_ino)
+			return fd;
+
+		close(fd);
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hcol_write_chunk                                                 *
+ *                                                                            *
+ * Purpose: appends chunk to partition file                                   *
+ *                                                                            *
+ * Parameters: value_type - [IN] the value type                               *
+ *             period     - [IN] the partition                                *
+ *             chunk      - [IN] the chunk to write                           *
+ *             size       - [IN] the chunk size                               *
+ *                                                                            *
+ * Return value: SUCCEED - the chunk was written                              *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+static int	hcol_write_chunk(unsigned char value_type, int period, const zbx_hcol_chunk_t *chunk, size_t size)
+{
+	int			fd, ret = FAIL;
+	char			*path;
+	ssize_t			rc;
+	zbx_hcol_header_t	header;
+
+	path = hcol_get_path(value_type, period);
+
+	if (-1 == (fd = hcol_open_locked(path, O_RDWR | O_CREAT)))
+		goto out;
+
+	if (0 > (rc = pread(fd, &header, sizeof(header), 0)))
+		goto err;
+
+	if (0 == rc)
+	{
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, ZBX_HCOL_MAGIC, sizeof(header.magic));
+		header.version = ZBX_HCOL_VERSION;
+		header.value_type = value_type;
+		header.size = sizeof(header);
+	}
+	else if (sizeof(header) != (size_t)rc || SUCCEED != hcol_header_check(&header, value_type, path))
+		goto close;
+
+	/* data after the committed size is left from interrupted write and can be overwritten */
+	if ((ssize_t)size != pwrite(fd, chunk, size, (off_t)header.size))
+		goto err;
+
+	header.size += size;
+	header.chunks_num++;
+
+	if (sizeof(header) != pwrite(fd, &header, sizeof(header), 0))
+		goto err;
+
+	ret = SUCCEED;
+	goto close;
+err:
+	zabbix_log(LOG_LEVEL_WARNING, "cannot write history partition file \"%s\": %s", path, zbx_strerror(errno));
+close:
+	close(fd);
+out:
+	zbx_free(path);
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hcol_map                                                         *
+ *                                                                            *
+ * Purpose: maps committed data of partition file into memory                 *
+ *                                                                            *
+ * Parameters: path       - [IN] the partition file path                      *
+ *             fd         - [IN] the opened partition file                    *
+ *             value_type - [IN] the value type                               *
+ *             size       - [OUT] the mapped data size                        *
+ *                                                                            *
+ * Return value: The mapped data or NULL if the file is empty or invalid.     *
+ *                                                                            *
+ ******************************************************************************/
+static const unsigned char	*hcol_map(const char *path, int fd, unsigned char value_type, size_t *size)
+{
+	zbx_hcol_header_t	header;
+	void			*data;
+
+	if (sizeof(header) != pread(fd, &header, sizeof(header), 0) ||
+			SUCCEED != hcol_header_check(&header, value_type, path))
+	{
+		return NULL;
+	}
+
+	if (MAP_FAILED == (data = mmap(NULL, header.size, PROT_READ, MAP_SHARED, fd, 0)))
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "cannot map history partition file \"%s\": %s", path,
+				zbx_strerror(errno));
+		return NULL;
+	}
+
+	*size = header.size;
+
+	return (const unsigned char *)data;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hcol_chunk_next                                                  *
+ *                                                                            *
+ * Purpose: gets the next valid chunk of mapped partition data                *
+ *                                                                            *
+ * Parameters: data   - [IN] the mapped data                                  *
+ *             size   - [IN] the mapped data size                             *
+ *             offset - [IN/OUT] the chunk offset                             *
+ *                                                                            *
+ * Return value: The chunk or NULL if there are no more valid chunks.         *
+ *                                                                            *
+ ******************************************************************************/
+static const zbx_hcol_chunk_t	*hcol_chunk_next(const unsigned char *data, size_t size, size_t *offset)
+{
+	const zbx_hcol_chunk_t	*chunk;
+
+	if (*offset + sizeof(zbx_hcol_chunk_t) > size)
+		return NULL;
+
+	chunk = (const zbx_hcol_chunk_t *)(data + *offset);
+
+	if (chunk->size > size - *offset || sizeof(zbx_hcol_chunk_t) +
+			sizeof(zbx_hcol_block_t) * (size_t)chunk->blocks_num + ZBX_HCOL_CHUNK_PADDING > chunk->size)
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "invalid history partition chunk at offset " ZBX_FS_SIZE_T,
+				(zbx_fs_size_t)*offset);
+		return NULL;
+	}
+
+	*offset += chunk->size;
+
+	return chunk;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hcol_block_decode                                                *
+ *                                                                            *
+ * Purpose: decodes values of the item block                                  *
+ *                                                                            *
+ * Parameters: chunk - [IN] the chunk                                         *
+ *             index - [IN] the block index in chunk directory                *
+ *             func  - [IN] the callback to process decoded values            *
+ *             arg   - [IN] the callback argument                             *
+ *                                                                            *
+ ******************************************************************************/
+typedef void (*zbx_hcol_value_func_t)(zbx_uint64_t itemid, const zbx_timespec_t *ts, zbx_uint64_t value,
+		void *arg);
+
+static void	hcol_block_decode(const zbx_hcol_chunk_t *chunk, zbx_uint32_t index, zbx_hcol_value_func_t func,
+		void *arg)
+{
+	const zbx_hcol_block_t	*block = (const zbx_hcol_block_t *)(chunk + 1) + index;
+	size_t			end;
+	zbx_uint32_t		i;
+	zbx_gorilla_state_t	decoder;
+	zbx_timespec_t		ts;
+	zbx_uint64_t		value;
+
+	end = (index + 1 < chunk->blocks_num ? block[1].offset : chunk->size - ZBX_HCOL_CHUNK_PADDING);
+
+	if (block->offset > end || end > chunk->size - ZBX_HCOL_CHUNK_PADDING)
+		return;
+
+	zbx_gorilla_init(&decoder);
+
+	for (i = 0; i < block->values_num && decoder.bits_num < (end - block->offset) * 8; i++)
+	{
+		zbx_gorilla_decode(&decoder, (const unsigned char *)chunk + block->offset, &ts, &value);
+		func(block->itemid, &ts, value, arg);
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hcol_chunk_find_block                                            *
+ *                                                                            *
+ * Purpose: finds item block in chunk directory                               *
+ *                                                                            *
+ * Return value: The block index or -1 if chunk has no values of the item.    *
+ *                                                                            *
+ ******************************************************************************/
+static int	hcol_chunk_find_block(const zbx_hcol_chunk_t *chunk, zbx_uint64_t itemid)
+{
+	const zbx_hcol_block_t	*blocks = (const zbx_hcol_block_t *)(chunk + 1);
+	int			lo = 0, hi = (int)chunk->blocks_num - 1;
+
+	while (lo <= hi)
+	{
+		int	mid = lo + (hi - lo) / 2;
+
+		if (blocks[mid].itemid == itemid)
+			return mid;
+
+		if (blocks[mid].itemid < itemid)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+
+	return -1;
+}
+
+/* arguments of hcol_read_value() callback */
+typedef struct
+{
+	unsigned char			value_type;
+	int				start;
+	int				end;
+	zbx_vector_history_record_t	*records;
+}
+zbx_hcol_read_t;
+
+static void	hcol_read_value(zbx_uint64_t itemid, const zbx_timespec_t *ts, zbx_uint64_t value, void *arg)
+{
+	zbx_hcol_read_t		*read = (zbx_hcol_read_t *)arg;
+	zbx_history_record_t	record;
+
+	ZBX_UNUSED(itemid);
+
+	if (ts->sec <= read->start || ts->sec > read->end)
+		return;
+
+	record.timestamp = *ts;
+
+	if (ITEM_VALUE_TYPE_FLOAT == read->value_type)
+		memcpy(&record.value.dbl, &value, sizeof(value));
+	else
+		record.value.ui64 = value;
+
+	zbx_vector_history_record_append_ptr(read->records, &record);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hcol_read_partition                                              *
+ *                                                                            *
+ * Purpose: reads item values from partition                                  *
+ *                                                                            *
+ * Parameters: value_type - [IN] the value type                               *
+ *             period     - [IN] the partition                                *
+ *             itemid     - [IN] the item                                     *
+ *             start      - [IN] the period start timestamp (exclusive)       *
+ *             end        - [IN] the period end timestamp (inclusive)         *
+ *             records    - [OUT] the item values                             *
+ *                                                                            *
+ ******************************************************************************/
+static void	hcol_read_partition(unsigned char value_type, int period, zbx_uint64_t itemid, int start, int end,
+		zbx_vector_history_record_t *records)
+{
+	int			fd, index;
+	char			*path;
+	const unsigned char	*data;
+	size_t			size, offset = sizeof(zbx_hcol_header_t);
+	const zbx_hcol_chunk_t	*chunk;
+	zbx_hcol_read_t		read = {value_type, start, end, records};
+
+	path = hcol_get_path(value_type, period);
+
+	if (-1 == (fd = open(path, O_RDONLY)))
+		goto out;
+
+	/* the committed size is updated under exclusive lock after the chunk is written */
+	if (0 == flock(fd, LOCK_SH))
+	{
+		data = hcol_map(path, fd, value_type, &size);
+		flock(fd, LOCK_UN);
+	}
+	else
+		data = NULL;
+
+	close(fd);
+
+	if (NULL == data)
+		goto out;
+
+	while (NULL != (chunk = hcol_chunk_next(data, size, &offset)))
+	{
+		if (chunk->clock_max <= start || chunk->clock_min > end)
+			continue;
+
+		if (-1 != (index = hcol_chunk_find_block(chunk, itemid)))
+			hcol_block_decode(chunk, (zbx_uint32_t)index, hcol_read_value, &read);
+	}
+
+	munmap((void *)data, size);
+out:
+	zbx_free(path);
+}
+
+static void	hcol_merge_value(zbx_uint64_t itemid, const zbx_timespec_t *ts, zbx_uint64_t value, void *arg)
+{
+	hcol_values_append((zbx_hcol_data_t *)arg, itemid, ts, value);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hcol_sync_dir                                                    *
+ *                                                                            *
+ * Purpose: syncs history storage directory, so the renamed and removed       *
+ *          partition files are persisted                                     *
+ *                                                                            *
+ ******************************************************************************/
+static void	hcol_sync_dir(void)
+{
+	int	fd;
+
+	if (-1 == (fd = open(CONFIG_HISTORY_STORAGE_DIR, O_RDONLY)))
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "cannot open history storage directory \"%s\": %s",
+				CONFIG_HISTORY_STORAGE_DIR, zbx_strerror(errno));
+		return;
+	}
+
+	if (0 != fsync(fd))
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "cannot sync history storage directory \"%s\": %s",
+				CONFIG_HISTORY_STORAGE_DIR, zbx_strerror(errno));
+	}
+
+	close(fd);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hcol_merge_partition                                             *
+ *                                                                            *
+ * Purpose: merges partition chunks into single chunk                         *
+ *                                                                            *
+ * Parameters: value_type - [IN] the value type                               *
+ *             period     - [IN] the partition                                *
+ *                                                                            *
+ * Comments: The merged partition is synced to disk before it replaces the    *
+ *           old file, and the directory is synced after the replace, so the  *
+ *           partition is not lost if system crashes.                         *
+ *                                                                            *
+ ******************************************************************************/
+static void	hcol_merge_partition(unsigned char value_type, int period)
+{
+	int			fd, fd_tmp = -1;
+	char			*path, *path_tmp = NULL;
+	const unsigned char	*data = NULL;
+	size_t			size, offset = sizeof(zbx_hcol_header_t), chunk_size;
+	zbx_uint32_t		i;
+	const zbx_hcol_chunk_t	*chunk;
+	zbx_hcol_chunk_t	*chunk_merged = NULL;
+	zbx_hcol_header_t	header;
+	zbx_hcol_data_t		merged;
+
+	memset(&merged, 0, sizeof(merged));
+
+	path = hcol_get_path(value_type, period);
+
+	if (-1 == (fd = hcol_open_locked(path, O_RDONLY)))
+		goto out;
+
+	if (NULL == (data = hcol_map(path, fd, value_type, &size)))
+		goto close;
+
+	header = *(const zbx_hcol_header_t *)data;
+
+	if (1 >= header.chunks_num)
+		goto close;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() path:%s chunks:%u", __func__, path, header.chunks_num);
+
+	while (NULL != (chunk = hcol_chunk_next(data, size, &offset)))
+	{
+		for (i = 0; i < chunk->blocks_num; i++)
+			hcol_block_decode(chunk, i, hcol_merge_value, &merged);
+	}
+
+	if (0 == merged.values_num)
+		goto close;
+
+	qsort(merged.values, (size_t)merged.values_num, sizeof(zbx_hcol_value_t), hcol_value_compare);
+
+	if (NULL == (chunk_merged = hcol_chunk_build(merged.values, merged.values_num, &chunk_size)))
+		goto close;
+
+	header.size = sizeof(header) + chunk_size;
+	header.chunks_num = 1;
+
+	path_tmp = zbx_dsprintf(NULL, "%s.tmp", path);
+
+	if (-1 == (fd_tmp = open(path_tmp, O_WRONLY | O_CREAT | O_TRUNC, 0640)) ||
+			sizeof(header) != write(fd_tmp, &header, sizeof(header)) ||
+			(ssize_t)chunk_size != write(fd_tmp, chunk_merged, chunk_size) ||
+			0 != fsync(fd_tmp) || 0 != rename(path_tmp, path))
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "cannot merge history partition file \"%s\": %s", path,
+				zbx_strerror(errno));
+		unlink(path_tmp);
+		goto close;
+	}
+
+	hcol_sync_dir();
+close:
+	if (-1 != fd_tmp)
+		close(fd_tmp);
+
+	if (NULL != data)
+		munmap((void *)data, size);
+
+	/* closing the old file releases the lock, waiting writers will reopen the merged file */
+	close(fd);
+out:
+	zbx_free(chunk_merged);
+	zbx_free(merged.values);
+	zbx_free(path_tmp);
+	zbx_free(path);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hcol_get_periods                                                 *
+ *                                                                            *
+ * Purpose: gets the existing partitions of the value type                    *
+ *                                                                            *
+ * Parameters: value_type - [IN] the value type                               *
+ *             periods    - [OUT] the partitions, sorted in descending order  *
+ *                                                                            *
+ ******************************************************************************/
+static void	hcol_get_periods(unsigned char value_type, zbx_vector_uint64_t *periods)
+{
+	DIR		*dir;
+	struct dirent	*entry;
+	size_t		len;
+	const char	*ptr;
+	char		*end;
+	long		period;
+
+	if (NULL == (dir = opendir(CONFIG_HISTORY_STORAGE_DIR)))
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "cannot open history storage directory \"%s\": %s",
+				CONFIG_HISTORY_STORAGE_DIR, zbx_strerror(errno));
+		return;
+	}
+
+	len = strlen(hcol_tables[value_type]);
+
+	while (NULL != (entry = readdir(dir)))
+	{
+		if (0 != strncmp(entry->d_name, hcol_tables[value_type], len) || '_' != entry->d_name[len])
+			continue;
+
+		ptr = entry->d_name + len + 1;
+
+		if (0 == isdigit((unsigned char)*ptr))
+			continue;
+
+		period = strtol(ptr, &end, 10);
+
+		if (0 != strcmp(end, ZBX_HCOL_EXTENSION) || 0 != period % ZBX_HCOL_PERIOD)
+			continue;
+
+		zbx_vector_uint64_append(periods, (zbx_uint64_t)period);
+	}
+
+	closedir(dir);
+
+	zbx_vector_uint64_sort(periods, ZBX_DEFAULT_UINT64_COMPARE_FUNC);
+
+	/* reverse order */
+	for (len = 0; (int)len < periods->values_num / 2; len++)
+	{
+		zbx_uint64_t	tmp = periods->values[len];
+
+		periods->values[len] = periods->values[periods->values_num - 1 - len];
+		periods->values[periods->values_num - 1 - len] = tmp;
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hcol_update_periods                                              *
+ *                                                                            *
+ * Purpose: updates the cached partitions of the value type if partitions     *
+ *          were added or removed                                             *
+ *                                                                            *
+ * Parameters: data       - [IN/OUT] the history storage data                 *
+ *             value_type - [IN] the value type                               *
+ *                                                                            *
+ * Comments: Partitions are created by history syncers and removed by         *
+ *           housekeeper, which changes the directory modification time.      *
+ *           The modification time has one second resolution, so directory is *
+ *           scanned again while it's not older than the last scan.           *
+ *                                                                            *
+ ******************************************************************************/
+static void	hcol_update_periods(zbx_hcol_data_t *data, unsigned char value_type)
+{
+	zbx_stat_t	st;
+	time_t		now;
+
+	if (0 != zbx_stat(CONFIG_HISTORY_STORAGE_DIR, &st))
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "cannot access history storage directory \"%s\": %s",
+				CONFIG_HISTORY_STORAGE_DIR, zbx_strerror(errno));
+		zbx_vector_uint64_clear(&data->periods);
+		data->periods_scanned = 0;
+		return;
+	}
+
+	if (st.st_mtime == data->periods_mtime && st.st_mtime < data->periods_scanned)
+		return;
+
+	now = time(NULL);
+
+	zbx_vector_uint64_clear(&data->periods);
+	hcol_get_periods(value_type, &data->periods);
+
+	data->periods_mtime = st.st_mtime;
+	data->periods_scanned = now;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hcol_remove_partition                                            *
+ *                                                                            *
+ * Purpose: removes partition file                                            *
+ *                                                                            *
+ * Parameters: value_type - [IN] the value type                               *
+ *             period     - [IN] the partition                                *
+ *                                                                            *
+ * Return value: The number of removed values.                                *
+ *                                                                            *
+ ******************************************************************************/
+static int	hcol_remove_partition(unsigned char value_type, int period)
+{
+	int			fd, values_num = 0;
+	char			*path;
+	const unsigned char	*data;
+	size_t			size, offset = sizeof(zbx_hcol_header_t);
+	zbx_uint32_t		i;
+	const zbx_hcol_chunk_t	*chunk;
+
+	path = hcol_get_path(value_type, period);
+
+	if (-1 == (fd = hcol_open_locked(path, O_RDONLY)))
+		goto out;
+
+	if (NULL != (data = hcol_map(path, fd, value_type, &size)))
+	{
+		while (NULL != (chunk = hcol_chunk_next(data, size, &offset)))
+		{
+			const zbx_hcol_block_t	*blocks = (const zbx_hcol_block_t *)(chunk + 1);
+
+			for (i = 0; i < chunk->blocks_num; i++)
+				values_num += (int)blocks[i].values_num;
+		}
+
+		munmap((void *)data, size);
+	}
+
+	/* writers waiting for lock will create a new file for late values */
+	if (0 != unlink(path))
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "cannot remove history partition file \"%s\": %s", path,
+				zbx_strerror(errno));
+		values_num = 0;
+	}
+
+	close(fd);
+out:
+	zbx_free(path);
+
+	return values_num;
+}
+
+/************************************************************************************
+ *                                                                                  *
+ * Function: hcol_destroy                                                           *
+ *                                                                                  *
+ * Purpose: destroys history storage interface                                      *
+ *                                                                                  *
+ * Parameters:  hist    - [IN] the history storage interface                        *
+ *                                                                                  *
+ ************************************************************************************/
+static void	hcol_destroy(zbx_history_iface_t *hist)
+{
+	zbx_hcol_data_t	*data = (zbx_hcol_data_t *)hist->data;
+
+	if (0 != data->values_num)
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "%d values were not written into history storage directory",
+				data->values_num);
+	}
+
+	zbx_vector_uint64_destroy(&data->periods);
+	zbx_free(data->values);
+	zbx_free(data);
+}
+
+/************************************************************************************
+ *                                                                                  *
+ * Function: hcol_get_values                                                        *
+ *                                                                                  *
+ * Purpose: gets item history data from history storage                             *
+ *                                                                                  *
+ * Parameters:  hist    - [IN] the history storage interface                        *
+ *              itemid  - [IN] the itemid                                           *
+ *              start   - [IN] the period start timestamp                           *
+ *              count   - [IN] the number of values to read                         *
+ *              end     - [IN] the period end timestamp                             *
+ *              values  - [OUT] the item history data values                        *
+ *                                                                                  *
+ * Return value: SUCCEED - the history data were read successfully                  *
+ *               FAIL - otherwise                                                   *
+ *                                                                                  *
+ * Comments: This function reads <count> values from ]<start>,<end>] interval or    *
+ *           all values from the specified interval if count is zero.               *
+ *           When reading by count only, all values from the second of the last     *
+ *           value are returned, so the values are cached by seconds.               *
+ *                                                                                  *
+ ************************************************************************************/
+static int	hcol_get_values(zbx_history_iface_t *hist, zbx_uint64_t itemid, int start, int count, int end,
+		zbx_vector_history_record_t *values)
+{
+	zbx_hcol_data_t			*data = (zbx_hcol_data_t *)hist->data;
+	int				i, num, period;
+	zbx_vector_history_record_t	records;
+
+	zbx_vector_history_record_create(&records);
+
+	hcol_update_periods(data, hist->value_type);
+
+	for (i = 0; i < data->periods.values_num; i++)
+	{
+		period = (int)data->periods.values[i];
+
+		if (period > end)
+			continue;
+
+		if (period + ZBX_HCOL_PERIOD - 1 <= start)
+			break;
+
+		hcol_read_partition(hist->value_type, period, itemid, start, end, &records);
+
+		/* older partitions have only older values */
+		if (0 != count && records.values_num >= count)
+			break;
+	}
+
+	zbx_vector_history_record_sort(&records, (zbx_compare_func_t)zbx_history_record_compare_desc_func);
+
+	num = records.values_num;
+
+	if (0 != count && num > count)
+	{
+		num = count;
+
+		if (0 == start)
+		{
+			while (num < records.values_num &&
+					records.values[num].timestamp.sec == records.values[count - 1].timestamp.sec)
+			{
+				num++;
+			}
+		}
+	}
+
+	zbx_vector_history_record_reserve(values, (size_t)(values->values_num + num));
+
+	for (i = 0; i < num; i++)
+		zbx_vector_history_record_append_ptr(values, &records.values[i]);
+
+	zbx_vector_history_record_destroy(&records);
+
+	return SUCCEED;
+}
+
+/************************************************************************************
+ *                                                                                  *
+ * Function: hcol_add_values                                                        *
+ *                                                                                  *
+ * Purpose: sends history data to the storage                                       *
+ *                                                                                  *
+ * Parameters:  hist    - [IN] the history storage interface                        *
+ *              history - [IN] the history data vector (may have mixed value types) *
+ *                                                                                  *
+ ************************************************************************************/
+static int	hcol_add_values(zbx_history_iface_t *hist, const zbx_vector_ptr_t *history)
+{
+	zbx_hcol_data_t	*data = (zbx_hcol_data_t *)hist->data;
+	int		i, h_num = 0;
+
+	for (i = 0; i < history->values_num; i++)
+	{
+		const ZBX_DC_HISTORY	*h = (ZBX_DC_HISTORY *)history->values[i];
+		zbx_uint64_t		value;
+
+		if (h->value_type != hist->value_type)
+			continue;
+
+		if (ITEM_VALUE_TYPE_FLOAT == h->value_type)
+			memcpy(&value, &h->value.dbl, sizeof(value));
+		else
+			value = h->value.ui64;
+
+		hcol_values_append(data, h->itemid, &h->ts, value);
+		h_num++;
+	}
+
+	return h_num;
+}
+
+/************************************************************************************
+ *                                                                                  *
+ * Function: hcol_flush                                                             *
+ *                                                                                  *
+ * Purpose: flushes the history data to storage                                     *
+ *                                                                                  *
+ * Parameters:  hist    - [IN] the history storage interface                        *
+ *                                                                                  *
+ * Comments: Writes a chunk into each partition having new values. Values of the    *
+ *           partitions that could not be written are kept and written with the     *
+ *           next flush, unless too many values are waiting already.                *
+ *                                                                                  *
+ ************************************************************************************/
+static int	hcol_flush(zbx_history_iface_t *hist)
+{
+	zbx_hcol_data_t		*data = (zbx_hcol_data_t *)hist->data;
+	int			i, j, period, kept = 0, ret = SUCCEED;
+	size_t			size;
+	zbx_hcol_chunk_t	*chunk;
+
+	if (0 == data->values_num)
+		return SUCCEED;
+
+	qsort(data->values, (size_t)data->values_num, sizeof(zbx_hcol_value_t), hcol_value_compare);
+
+	for (i = 0; i < data->values_num; i = j)
+	{
+		period = hcol_get_period(data->values[i].ts.sec);
+
+		for (j = i + 1; j < data->values_num && period == hcol_get_period(data->values[j].ts.sec); j++)
+			;
+
+		if (NULL == (chunk = hcol_chunk_build(data->values + i, j - i, &size)) ||
+				SUCCEED != hcol_write_chunk(hist->value_type, period, chunk, size))
+		{
+			/* the partitions are processed in ascending order, so kept values are never overwritten */
+			if (kept != i)
+				memmove(data->values + kept, data->values + i, sizeof(zbx_hcol_value_t) * (size_t)(j - i));
+
+			kept += j - i;
+		}
+
+		zbx_free(chunk);
+	}
+
+	if (ZBX_HCOL_RETRY_VALUES_MAX < kept)
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "cannot write %d values into history storage directory, the values"
+				" are lost", kept);
+		kept = 0;
+		ret = FAIL;
+	}
+	else if (0 != kept)
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "cannot write %d values into history storage directory, retrying with"
+				" the next flush", kept);
+	}
+
+	data->values_num = kept;
+
+	return ret;
+}
+
+/************************************************************************************
+ *                                                                                  *
+ * Function: hcol_housekeep                                                         *
+ *                                                                                  *
+ * Purpose: removes expired partitions and merges chunks of older partitions        *
+ *                                                                                  *
+ * Parameters:  hist      - [IN] the history storage interface                      *
+ *              now       - [IN] the current timestamp                              *
+ *              keep_from - [IN] the oldest timestamp to keep, 0 to keep all        *
+ *                                                                                  *
+ * Return value: The number of removed values.                                      *
+ *                                                                                  *
+ * Comments: Only whole partitions are removed, so values are kept until all values *
+ *           of the partition are expired. Partitions are merged when they are no   *
+ *           longer written by history syncers, except for late values.             *
+ *                                                                                  *
+ ************************************************************************************/
+static int	hcol_housekeep(zbx_history_iface_t *hist, int now, int keep_from)
+{
+	zbx_hcol_data_t	*data = (zbx_hcol_data_t *)hist->data;
+	int		i, period, removed = 0;
+
+	/* force rescan, partitions could be removed or merged outside of this process */
+	data->periods_scanned = 0;
+	hcol_update_periods(data, hist->value_type);
+
+	for (i = 0; i < data->periods.values_num; i++)
+	{
+		period = (int)data->periods.values[i];
+
+		if (0 != keep_from && period + ZBX_HCOL_PERIOD <= keep_from)
+			removed += hcol_remove_partition(hist->value_type, period);
+		else if (period + ZBX_HCOL_PERIOD * 2 <= now)
+			hcol_merge_partition(hist->value_type, period);
+	}
+
+	if (0 != removed)
+		hcol_sync_dir();
+
+	return removed;
+}
+
+/************************************************************************************
+ *                                                                                  *
+ * Function: zbx_history_columnar_init                                              *
+ *                                                                                  *
+ * Purpose: initializes history storage interface                                   *
+ *                                                                                  *
+ * Parameters:  hist       - [IN] the history storage interface                     *
+ *              value_type - [IN] the target value type                             *
+ *              error      - [OUT] the error message                                *
+ *                                                                                  *
+ * Return value: SUCCEED - the history storage interface was initialized            *
+ *               FAIL    - otherwise                                                *
+ *                                                                                  *
+ ************************************************************************************/
+int	zbx_history_columnar_init(zbx_history_iface_t *hist, unsigned char value_type, char **error)
+{
+	zbx_hcol_data_t	*data;
+
+	if (ITEM_VALUE_TYPE_FLOAT != value_type && ITEM_VALUE_TYPE_UINT64 != value_type)
+	{
+		*error = zbx_strdup(*error, "history storage directory supports only numeric values");
+		return FAIL;
+	}
+
+	if (0 != access(CONFIG_HISTORY_STORAGE_DIR, R_OK | W_OK | X_OK))
+	{
+		*error = zbx_dsprintf(*error, "cannot access history storage directory \"%s\": %s",
+				CONFIG_HISTORY_STORAGE_DIR, zbx_strerror(errno));
+		return FAIL;
+	}
+
+	data = (zbx_hcol_data_t *)zbx_malloc(NULL, sizeof(zbx_hcol_data_t));
+	memset(data, 0, sizeof(zbx_hcol_data_t));
+	zbx_vector_uint64_create(&data->periods);
+
+	hist->value_type = value_type;
+	hist->data = data;
+	hist->destroy = hcol_destroy;
+	hist->add_values = hcol_add_values;
+	hist->flush = hcol_flush;
+	hist->flush_async = NULL;
+	hist->wait = NULL;
+	hist->get_values = hcol_get_values;
+	hist->get_values_multi = NULL;
+	hist->housekeep = hcol_housekeep;
+	hist->requires_trends = 1;
+
+	return SUCCEED;
+}
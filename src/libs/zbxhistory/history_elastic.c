@@ -33,6 +33,9 @@
 #define		ZBX_IDX_JSON_ALLOCATE		256
 #define		ZBX_JSON_ALLOCATE		2048
 
+/* the number of hits per page when scrolling through multi-item search results */
+#define		ZBX_ELASTIC_SCROLL_SIZE		1000
+
 const char	*value_type_str[] = {"dbl", "str", "log", "uint", "text"};
 
 extern char	*CONFIG_HISTORY_STORAGE_URL;
@@ -621,38 +624,35 @@ static void	elastic_destroy(zbx_history_iface_t *hist)
 
 /************************************************************************************
  *                                                                                  *
- * Function: elastic_get_values                                                     *
+ * Function: elastic_search                                                         *
  *                                                                                  *
- * Purpose: gets item history data from history storage                             *
+ * Purpose: runs history search query and reads the results with scroll requests    *
  *                                                                                  *
- * Parameters:  hist    - [IN] the history storage interface                        *
- *              itemid  - [IN] the itemid                                           *
- *              start   - [IN] the period start timestamp                           *
- *              count   - [IN] the number of values to read                         *
- *              end     - [IN] the period end timestamp                             *
- *              values  - [OUT] the item history data values                        *
+ * Parameters:  hist        - [IN] the history storage interface                    *
+ *              query       - [IN] the search query                                 *
+ *              count       - [IN] the number of values to read, 0 - all values     *
+ *              itemids     - [IN] the itemids, sorted in ascending order (optional)*
+ *              itemids_num - [IN] the number of itemids                            *
+ *              values      - [OUT] the item history data values                    *
  *                                                                                  *
  * Return value: SUCCEED - the history data were read successfully                  *
  *               FAIL - otherwise                                                   *
  *                                                                                  *
- * Comments: This function reads <count> values from ]<start>,<end>] interval or    *
- *           all values from the specified interval if count is zero.               *
+ * Comments: If itemids are set, the values are stored in array of vectors matching *
+ *           itemids. Otherwise all values are stored in the values vector.         *
  *                                                                                  *
  ************************************************************************************/
-static int	elastic_get_values(zbx_history_iface_t *hist, zbx_uint64_t itemid, int start, int count, int end,
-		zbx_vector_history_record_t *values)
+static int	elastic_search(zbx_history_iface_t *hist, const char *query, int count, const zbx_uint64_t *itemids,
+		int itemids_num, zbx_vector_history_record_t *values)
 {
 	zbx_elastic_data_t	*data = (zbx_elastic_data_t *)hist->data;
 	size_t			url_alloc = 0, url_offset = 0, id_alloc = 0, scroll_alloc = 0, scroll_offset = 0;
 	int			total, empty, ret;
 	CURLcode		err;
-	struct zbx_json		query;
 	struct curl_slist	*curl_headers = NULL;
 	char			*scroll_id = NULL, *scroll_query = NULL, errbuf[CURL_ERROR_SIZE];
 	CURLoption		opt;
 
-	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
-
 	ret = FAIL;
 
 	if (NULL == (data->handle = curl_easy_init()))
@@ -665,53 +665,10 @@ static int	elastic_get_values(zbx_history_iface_t *hist, zbx_uint64_t itemid, in
 	zbx_snprintf_alloc(&data->post_url, &url_alloc, &url_offset, "%s/%s*/_search?scroll=10s", data->base_url,
 			value_type_str[hist->value_type]);
 
-	/* prepare the json query for elasticsearch, apply ranges if needed */
-	zbx_json_init(&query, ZBX_JSON_ALLOCATE);
-
-	if (0 < count)
-	{
-		zbx_json_adduint64(&query, "size", count);
-		zbx_json_addarray(&query, "sort");
-		zbx_json_addobject(&query, NULL);
-		zbx_json_addobject(&query, "clock");
-		zbx_json_addstring(&query, "order", "desc", ZBX_JSON_TYPE_STRING);
-		zbx_json_close(&query);
-		zbx_json_close(&query);
-		zbx_json_close(&query);
-	}
-
-	zbx_json_addobject(&query, "query");
-	zbx_json_addobject(&query, "bool");
-	zbx_json_addarray(&query, "must");
-	zbx_json_addobject(&query, NULL);
-	zbx_json_addobject(&query, "match");
-	zbx_json_adduint64(&query, "itemid", itemid);
-	zbx_json_close(&query);
-	zbx_json_close(&query);
-	zbx_json_close(&query);
-	zbx_json_addarray(&query, "filter");
-	zbx_json_addobject(&query, NULL);
-	zbx_json_addobject(&query, "range");
-	zbx_json_addobject(&query, "clock");
-
-	if (0 < start)
-		zbx_json_adduint64(&query, "gt", start);
-
-	if (0 < end)
-		zbx_json_adduint64(&query, "lte", end);
-
-	zbx_json_close(&query);
-	zbx_json_close(&query);
-	zbx_json_close(&query);
-	zbx_json_close(&query);
-	zbx_json_close(&query);
-	zbx_json_close(&query);
-	zbx_json_close(&query);
-
 	curl_headers = curl_slist_append(curl_headers, "Content-Type: application/json");
 
 	if (CURLE_OK != (err = curl_easy_setopt(data->handle, opt = CURLOPT_URL, data->post_url)) ||
-			CURLE_OK != (err = curl_easy_setopt(data->handle, opt = CURLOPT_POSTFIELDS, query.buffer)) ||
+			CURLE_OK != (err = curl_easy_setopt(data->handle, opt = CURLOPT_POSTFIELDS, query)) ||
 			CURLE_OK != (err = curl_easy_setopt(data->handle, opt = CURLOPT_WRITEFUNCTION,
 					curl_write_cb)) ||
 			CURLE_OK != (err = curl_easy_setopt(data->handle, opt = CURLOPT_WRITEDATA, &page_r)) ||
@@ -723,7 +680,7 @@ static int	elastic_get_values(zbx_history_iface_t *hist, zbx_uint64_t itemid, in
 		goto out;
 	}
 
-	zabbix_log(LOG_LEVEL_DEBUG, "sending query to %s; post data: %s", data->post_url, query.buffer);
+	zabbix_log(LOG_LEVEL_DEBUG, "sending query to %s; post data: %s", data->post_url, query);
 
 	page_r.offset = 0;
 	*errbuf = '\0';
@@ -773,6 +730,8 @@ static int	elastic_get_values(zbx_history_iface_t *hist, zbx_uint64_t itemid, in
 
 		while (NULL != (p = zbx_json_next(&jp_hits, p)))
 		{
+			zbx_vector_history_record_t	*item_values = values;
+
 			empty = 0;
 
 			if (SUCCEED != zbx_json_brackets_open(p, &jp_item))
@@ -781,10 +740,31 @@ static int	elastic_get_values(zbx_history_iface_t *hist, zbx_uint64_t itemid, in
 			if (SUCCEED != zbx_json_brackets_by_name(&jp_item, "_source", &jp_source))
 				continue;
 
+			if (NULL != itemids)
+			{
+				char			buffer[MAX_ID_LEN + 1];
+				zbx_uint64_t		itemid;
+				const zbx_uint64_t	*ptr;
+
+				if (SUCCEED != zbx_json_value_by_name(&jp_source, "itemid", buffer, sizeof(buffer),
+						NULL) || SUCCEED != is_uint64(buffer, &itemid))
+				{
+					continue;
+				}
+
+				if (NULL == (ptr = (const zbx_uint64_t *)bsearch(&itemid, itemids, (size_t)itemids_num,
+						sizeof(zbx_uint64_t), ZBX_DEFAULT_UINT64_COMPARE_FUNC)))
+				{
+					continue;
+				}
+
+				item_values = &values[ptr - itemids];
+			}
+
 			if (SUCCEED != history_parse_value(&jp_source, hist->value_type, &hr))
 				continue;
 
-			zbx_vector_history_record_append_ptr(values, &hr);
+			zbx_vector_history_record_append_ptr(item_values, &hr);
 
 			if (-1 != total)
 				--total;
@@ -855,11 +835,99 @@ out:
 
 	curl_slist_free_all(curl_headers);
 
-	zbx_json_free(&query);
-
 	zbx_free(scroll_id);
 	zbx_free(scroll_query);
 
+	return ret;
+}
+
+/************************************************************************************
+ *                                                                                  *
+ * Function: elastic_add_query_range                                                *
+ *                                                                                  *
+ * Purpose: adds clock range filter to the search query                             *
+ *                                                                                  *
+ ************************************************************************************/
+static void	elastic_add_query_range(struct zbx_json *query, int start, int end)
+{
+	zbx_json_addarray(query, "filter");
+	zbx_json_addobject(query, NULL);
+	zbx_json_addobject(query, "range");
+	zbx_json_addobject(query, "clock");
+
+	if (0 < start)
+		zbx_json_adduint64(query, "gt", start);
+
+	if (0 < end)
+		zbx_json_adduint64(query, "lte", end);
+
+	zbx_json_close(query);
+	zbx_json_close(query);
+	zbx_json_close(query);
+	zbx_json_close(query);
+}
+
+/************************************************************************************
+ *                                                                                  *
+ * Function: elastic_get_values                                                     *
+ *                                                                                  *
+ * Purpose: gets item history data from history storage                             *
+ *                                                                                  *
+ * Parameters:  hist    - [IN] the history storage interface                        *
+ *              itemid  - [IN] the itemid                                           *
+ *              start   - [IN] the period start timestamp                           *
+ *              count   - [IN] the number of values to read                         *
+ *              end     - [IN] the period end timestamp                             *
+ *              values  - [OUT] the item history data values                        *
+ *                                                                                  *
+ * Return value: SUCCEED - the history data were read successfully                  *
+ *               FAIL - otherwise                                                   *
+ *                                                                                  *
+ * Comments: This function reads <count> values from ]<start>,<end>] interval or    *
+ *           all values from the specified interval if count is zero.               *
+ *                                                                                  *
+ ************************************************************************************/
+static int	elastic_get_values(zbx_history_iface_t *hist, zbx_uint64_t itemid, int start, int count, int end,
+		zbx_vector_history_record_t *values)
+{
+	int		ret;
+	struct zbx_json	query;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+
+	/* prepare the json query for elasticsearch, apply ranges if needed */
+	zbx_json_init(&query, ZBX_JSON_ALLOCATE);
+
+	if (0 < count)
+	{
+		zbx_json_adduint64(&query, "size", count);
+		zbx_json_addarray(&query, "sort");
+		zbx_json_addobject(&query, NULL);
+		zbx_json_addobject(&query, "clock");
+		zbx_json_addstring(&query, "order", "desc", ZBX_JSON_TYPE_STRING);
+		zbx_json_close(&query);
+		zbx_json_close(&query);
+		zbx_json_close(&query);
+	}
+
+	zbx_json_addobject(&query, "query");
+	zbx_json_addobject(&query, "bool");
+	zbx_json_addarray(&query, "must");
+	zbx_json_addobject(&query, NULL);
+	zbx_json_addobject(&query, "match");
+	zbx_json_adduint64(&query, "itemid", itemid);
+	zbx_json_close(&query);
+	zbx_json_close(&query);
+	zbx_json_close(&query);
+	elastic_add_query_range(&query, start, end);
+	zbx_json_close(&query);
+	zbx_json_close(&query);
+	zbx_json_close(&query);
+
+	ret = elastic_search(hist, query.buffer, count, NULL, 0, values);
+
+	zbx_json_free(&query);
+
 	zbx_vector_history_record_sort(values, (zbx_compare_func_t)zbx_history_record_compare_desc_func);
 
 	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
@@ -867,6 +935,69 @@ out:
 	return ret;
 }
 
+/************************************************************************************
+ *                                                                                  *
+ * Function: elastic_get_values_multi                                               *
+ *                                                                                  *
+ * Purpose: gets history data of multiple items from history storage                *
+ *                                                                                  *
+ * Parameters:  hist        - [IN] the history storage interface                    *
+ *              itemids     - [IN] the itemids, sorted in ascending order           *
+ *              itemids_num - [IN] the number of itemids                            *
+ *              start       - [IN] the period start timestamp                       *
+ *              end         - [IN] the period end timestamp                         *
+ *              values      - [OUT] the item history data values, an array of       *
+ *                                  vectors matching itemids                        *
+ *                                                                                  *
+ * Return value: SUCCEED - the history data were read successfully                  *
+ *               FAIL - otherwise                                                   *
+ *                                                                                  *
+ * Comments: This function reads all values from ]<start>,<end>] interval with a    *
+ *           single terms query, scrolling through the results.                     *
+ *                                                                                  *
+ ************************************************************************************/
+static int	elastic_get_values_multi(zbx_history_iface_t *hist, const zbx_uint64_t *itemids, int itemids_num,
+		int start, int end, zbx_vector_history_record_t *values)
+{
+	int		i, ret;
+	struct zbx_json	query;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() items:%d", __func__, itemids_num);
+
+	zbx_json_init(&query, ZBX_JSON_ALLOCATE);
+
+	zbx_json_adduint64(&query, "size", ZBX_ELASTIC_SCROLL_SIZE);
+	zbx_json_addobject(&query, "query");
+	zbx_json_addobject(&query, "bool");
+	zbx_json_addarray(&query, "must");
+	zbx_json_addobject(&query, NULL);
+	zbx_json_addobject(&query, "terms");
+	zbx_json_addarray(&query, "itemid");
+
+	for (i = 0; i < itemids_num; i++)
+		zbx_json_adduint64(&query, NULL, itemids[i]);
+
+	zbx_json_close(&query);
+	zbx_json_close(&query);
+	zbx_json_close(&query);
+	zbx_json_close(&query);
+	elastic_add_query_range(&query, start, end);
+	zbx_json_close(&query);
+	zbx_json_close(&query);
+	zbx_json_close(&query);
+
+	ret = elastic_search(hist, query.buffer, 0, itemids, itemids_num, values);
+
+	zbx_json_free(&query);
+
+	for (i = 0; i < itemids_num; i++)
+		zbx_vector_history_record_sort(&values[i], (zbx_compare_func_t)zbx_history_record_compare_desc_func);
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%s", __func__, zbx_result_string(ret));
+
+	return ret;
+}
+
 /************************************************************************************
  *                                                                                  *
  * Function: elastic_add_values                                                     *
@@ -1009,7 +1140,11 @@ int	zbx_history_elastic_init(zbx_history_iface_t *hist, unsigned char value_type
 	hist->destroy = elastic_destroy;
 	hist->add_values = elastic_add_values;
 	hist->flush = elastic_flush;
+	hist->flush_async = NULL;
+	hist->wait = NULL;
 	hist->get_values = elastic_get_values;
+	hist->get_values_multi = elastic_get_values_multi;
+	hist->housekeep = NULL;
 	hist->requires_trends = 0;
 
 	return SUCCEED;
@@ -25,10 +25,18 @@
 #include "zbxhistory.h"
 #include "history.h"
 
+/* the maximum number of items read by a single multi-item history query */
+#define ZBX_HISTORY_SQL_ITEMS_BATCH	1000
+
 typedef struct
 {
 	unsigned char		initialized;
+	unsigned char		async;
 	zbx_vector_ptr_t	dbinserts;
+#ifdef HAVE_POSTGRESQL
+	zbx_db_stmt_t		stmts[ITEM_VALUE_TYPE_MAX];	/* statements being written asynchronously */
+	int			stmts_num;
+#endif
 }
 zbx_sql_writer_t;
 
@@ -133,6 +141,16 @@ static void	sql_writer_release(void)
 	zbx_vector_ptr_clear(&writer.dbinserts);
 	zbx_vector_ptr_destroy(&writer.dbinserts);
 
+#ifdef HAVE_POSTGRESQL
+	for (i = 0; i < writer.stmts_num; i++)
+	{
+		zbx_free(writer.stmts[i].sql);
+		zbx_free(writer.stmts[i].data);
+	}
+	writer.stmts_num = 0;
+#endif
+
+	writer.async = 0;
 	writer.initialized = 0;
 }
 
@@ -184,6 +202,76 @@ static int	sql_writer_flush(void)
 	return ZBX_DB_OK == txn_error ? SUCCEED : FAIL;
 }
 
+#ifdef HAVE_POSTGRESQL
+/************************************************************************************
+ *                                                                                  *
+ * Function: sql_writer_flush_async                                                 *
+ *                                                                                  *
+ * Purpose: sends bulk insert data to database without waiting for the result       *
+ *                                                                                  *
+ * Comments: The inserts are kept until sql_writer_wait() is called, so they can be *
+ *           flushed synchronously if sending fails or database goes down.          *
+ *           History tables are written with COPY statements as in synchronous      *
+ *           flush, in one transaction separate from the item and trend updates,    *
+ *           also as in synchronous flush.                                          *
+ *                                                                                  *
+ ************************************************************************************/
+static void	sql_writer_flush_async(void)
+{
+	int	i;
+
+	/* there is one bulk insert per history table, otherwise flush synchronously */
+	if (0 == writer.initialized || 0 != writer.async || 0 != writer.stmts_num ||
+			ITEM_VALUE_TYPE_MAX < writer.dbinserts.values_num)
+	{
+		return;
+	}
+
+	for (i = 0; i < writer.dbinserts.values_num; i++)
+	{
+		if (SUCCEED == zbx_db_insert_format((zbx_db_insert_t *)writer.dbinserts.values[i],
+				&writer.stmts[writer.stmts_num]))
+		{
+			writer.stmts_num++;
+		}
+	}
+
+	if (0 != writer.stmts_num && ZBX_DB_OK == zbx_db_async_send(writer.stmts, writer.stmts_num))
+		writer.async = 1;
+}
+#endif
+
+/************************************************************************************
+ *                                                                                  *
+ * Function: sql_writer_wait                                                        *
+ *                                                                                  *
+ * Purpose: waits for bulk insert data sent by sql_writer_flush_async() to be       *
+ *          written into database                                                   *
+ *                                                                                  *
+ * Comments: If the data was not sent or the database went down while writing it,   *
+ *           the data is flushed synchronously.                                     *
+ *                                                                                  *
+ ************************************************************************************/
+static int	sql_writer_wait(void)
+{
+#ifdef HAVE_POSTGRESQL
+	if (0 != writer.initialized && 0 != writer.async)
+	{
+		int	rc;
+
+		if (ZBX_DB_DOWN != (rc = zbx_db_async_wait()))
+		{
+			sql_writer_release();
+
+			return ZBX_DB_OK == rc ? SUCCEED : FAIL;
+		}
+
+		zabbix_log(LOG_LEVEL_WARNING, "cannot write history asynchronously, retrying synchronously");
+	}
+#endif
+	return sql_writer_flush();
+}
+
 /******************************************************************************************************************
  *                                                                                                                *
  * database writing support                                                                                       *
@@ -204,6 +292,7 @@ static void	add_history_dbl(const zbx_vector_ptr_t *history)
 
 	db_insert = (zbx_db_insert_t *)zbx_malloc(NULL, sizeof(zbx_db_insert_t));
 	zbx_db_insert_prepare(db_insert, "history", "itemid", "clock", "ns", "value", NULL);
+	zbx_db_insert_set_copy(db_insert);
 
 	for (i = 0; i < history->values_num; i++)
 	{
@@ -230,6 +319,7 @@ static void	add_history_uint(zbx_vector_ptr_t *history)
 
 	db_insert = (zbx_db_insert_t *)zbx_malloc(NULL, sizeof(zbx_db_insert_t));
 	zbx_db_insert_prepare(db_insert, "history_uint", "itemid", "clock", "ns", "value", NULL);
+	zbx_db_insert_set_copy(db_insert);
 
 	for (i = 0; i < history->values_num; i++)
 	{
@@ -256,6 +346,7 @@ static void	add_history_str(zbx_vector_ptr_t *history)
 
 	db_insert = (zbx_db_insert_t *)zbx_malloc(NULL, sizeof(zbx_db_insert_t));
 	zbx_db_insert_prepare(db_insert, "history_str", "itemid", "clock", "ns", "value", NULL);
+	zbx_db_insert_set_copy(db_insert);
 
 	for (i = 0; i < history->values_num; i++)
 	{
@@ -282,6 +373,7 @@ static void	add_history_text(zbx_vector_ptr_t *history)
 
 	db_insert = (zbx_db_insert_t *)zbx_malloc(NULL, sizeof(zbx_db_insert_t));
 	zbx_db_insert_prepare(db_insert, "history_text", "itemid", "clock", "ns", "value", NULL);
+	zbx_db_insert_set_copy(db_insert);
 
 	for (i = 0; i < history->values_num; i++)
 	{
@@ -309,6 +401,7 @@ static void	add_history_log(zbx_vector_ptr_t *history)
 	db_insert = (zbx_db_insert_t *)zbx_malloc(NULL, sizeof(zbx_db_insert_t));
 	zbx_db_insert_prepare(db_insert, "history_log", "itemid", "clock", "ns", "timestamp", "source", "severity",
 			"value", "logeventid", NULL);
+	zbx_db_insert_set_copy(db_insert);
 
 	for (i = 0; i < history->values_num; i++)
 	{
@@ -602,6 +695,96 @@ out:
 	return ret;
 }
 
+/*********************************************************************************
+ *                                                                               *
+ * Function: db_read_values_by_time_multi                                        *
+ *                                                                               *
+ * Purpose: reads history data of multiple items from database                   *
+ *                                                                               *
+ * Parameters:  itemids       - [IN] the itemids, sorted in ascending order      *
+ *              itemids_num   - [IN] the number of itemids                       *
+ *              value_type    - [IN] the value type (see ITEM_VALUE_TYPE_* defs) *
+ *              start         - [IN] the period start timestamp                  *
+ *              end           - [IN] the period end timestamp                    *
+ *              values        - [OUT] the item history data values, an array of  *
+ *                                    vectors matching itemids                   *
+ *                                                                               *
+ * Return value: SUCCEED - the history data were read successfully               *
+ *               FAIL - otherwise                                                *
+ *                                                                               *
+ * Comments: This function reads all values with timestamps in range:            *
+ *             start < <value timestamp> <= end                                  *
+ *           The items are read in batches, one query per batch.                 *
+ *                                                                               *
+ *********************************************************************************/
+static int	db_read_values_by_time_multi(const zbx_uint64_t *itemids, int itemids_num, int value_type,
+		int start, int end, zbx_vector_history_record_t *values)
+{
+	char			*sql = NULL;
+	size_t			sql_alloc = 0, sql_offset;
+	DB_RESULT		result;
+	DB_ROW			row;
+	zbx_vc_history_table_t	*table = &vc_history_tables[value_type];
+	int			i, batch, ret = SUCCEED;
+
+	for (i = 0; i < itemids_num; i += batch)
+	{
+		zbx_uint64_t			itemid, itemid_last = 0;
+		zbx_vector_history_record_t	*item_values = NULL;
+
+		batch = MIN(itemids_num - i, ZBX_HISTORY_SQL_ITEMS_BATCH);
+
+		sql_offset = 0;
+		zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset, "select itemid,clock,ns,%s from %s where",
+				table->fields, table->name);
+		DBadd_condition_alloc(&sql, &sql_alloc, &sql_offset, "itemid", itemids + i, batch);
+
+		if (ZBX_JAN_2038 == end)
+			zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset, " and clock>%d", start);
+		else
+			zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset, " and clock>%d and clock<=%d", start, end);
+
+		if (NULL == (result = DBselect("%s", sql)))
+		{
+			ret = FAIL;
+			break;
+		}
+
+		while (NULL != (row = DBfetch(result)))
+		{
+			zbx_history_record_t	value;
+
+			ZBX_STR2UINT64(itemid, row[0]);
+
+			if (NULL == item_values || itemid != itemid_last)
+			{
+				const zbx_uint64_t	*ptr;
+
+				if (NULL == (ptr = (const zbx_uint64_t *)bsearch(&itemid, itemids + i, (size_t)batch,
+						sizeof(zbx_uint64_t), ZBX_DEFAULT_UINT64_COMPARE_FUNC)))
+				{
+					THIS_SHOULD_NEVER_HAPPEN;
+					continue;
+				}
+
+				item_values = &values[ptr - itemids];
+				itemid_last = itemid;
+			}
+
+			value.timestamp.sec = atoi(row[1]);
+			value.timestamp.ns = atoi(row[2]);
+			table->rtov(&value.value, row + 3);
+
+			zbx_vector_history_record_append_ptr(item_values, &value);
+		}
+		DBfree_result(result);
+	}
+
+	zbx_free(sql);
+
+	return ret;
+}
+
 /******************************************************************************************************************
  *                                                                                                                *
  * history interface support                                                                                      *
@@ -654,6 +837,32 @@ static int	sql_get_values(zbx_history_iface_t *hist, zbx_uint64_t itemid, int st
 	return db_read_values_by_time_and_count(itemid, hist->value_type, values, end - start, count, end);
 }
 
+/************************************************************************************
+ *                                                                                  *
+ * Function: sql_get_values_multi                                                   *
+ *                                                                                  *
+ * Purpose: gets history data of multiple items from history storage                *
+ *                                                                                  *
+ * Parameters:  hist        - [IN] the history storage interface                    *
+ *              itemids     - [IN] the itemids, sorted in ascending order           *
+ *              itemids_num - [IN] the number of itemids                            *
+ *              start       - [IN] the period start timestamp                       *
+ *              end         - [IN] the period end timestamp                         *
+ *              values      - [OUT] the item history data values, an array of       *
+ *                                  vectors matching itemids                        *
+ *                                                                                  *
+ * Return value: SUCCEED - the history data were read successfully                  *
+ *               FAIL - otherwise                                                   *
+ *                                                                                  *
+ * Comments: This function reads all values from ]<start>,<end>] interval.          *
+ *                                                                                  *
+ ************************************************************************************/
+static int	sql_get_values_multi(zbx_history_iface_t *hist, const zbx_uint64_t *itemids, int itemids_num,
+		int start, int end, zbx_vector_history_record_t *values)
+{
+	return db_read_values_by_time_multi(itemids, itemids_num, hist->value_type, start, end, values);
+}
+
 /************************************************************************************
  *                                                                                  *
  * Function: sql_add_values                                                         *
@@ -704,6 +913,40 @@ static int	sql_flush(zbx_history_iface_t *hist)
 	return sql_writer_flush();
 }
 
+#ifdef HAVE_POSTGRESQL
+/************************************************************************************
+ *                                                                                  *
+ * Function: sql_flush_async                                                        *
+ *                                                                                  *
+ * Purpose: starts flushing the history data to storage                             *
+ *                                                                                  *
+ * Parameters:  hist    - [IN] the history storage interface                        *
+ *                                                                                  *
+ ************************************************************************************/
+static void	sql_flush_async(zbx_history_iface_t *hist)
+{
+	ZBX_UNUSED(hist);
+
+	sql_writer_flush_async();
+}
+#endif
+
+/************************************************************************************
+ *                                                                                  *
+ * Function: sql_wait                                                               *
+ *                                                                                  *
+ * Purpose: waits for the history data flush started by sql_flush_async()          *
+ *                                                                                  *
+ * Parameters:  hist    - [IN] the history storage interface                        *
+ *                                                                                  *
+ ************************************************************************************/
+static int	sql_wait(zbx_history_iface_t *hist)
+{
+	ZBX_UNUSED(hist);
+
+	return sql_writer_wait();
+}
+
 /************************************************************************************
  *                                                                                  *
  * Function: zbx_history_sql_init                                                   *
@@ -727,7 +970,15 @@ int	zbx_history_sql_init(zbx_history_iface_t *hist, unsigned char value_type, ch
 	hist->destroy = sql_destroy;
 	hist->add_values = sql_add_values;
 	hist->flush = sql_flush;
+#ifdef HAVE_POSTGRESQL
+	hist->flush_async = sql_flush_async;
+#else
+	hist->flush_async = NULL;
+#endif
+	hist->wait = sql_wait;
 	hist->get_values = sql_get_values;
+	hist->get_values_multi = sql_get_values_multi;
+	hist->housekeep = NULL;
 
 	switch (value_type)
 	{
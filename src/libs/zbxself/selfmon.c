@@ -123,6 +123,9 @@ extern int	CONFIG_HISTORYPOLLER_FORKS;
 extern int	CONFIG_AVAILMAN_FORKS;
 extern int	CONFIG_SERVICEMAN_FORKS;
 extern int	CONFIG_PROBLEMHOUSEKEEPER_FORKS;
+extern int	CONFIG_AGENTPOLLER_FORKS;
+extern int	CONFIG_SNMPPOLLER_FORKS;
+extern int	CONFIG_HTTPAGENT_POLLER_FORKS;
 
 extern unsigned char	process_type;
 extern int		process_num;
@@ -214,6 +217,12 @@ int	get_process_type_forks(unsigned char proc_type)
 			return CONFIG_SERVICEMAN_FORKS;
 		case ZBX_PROCESS_TYPE_PROBLEMHOUSEKEEPER:
 			return CONFIG_PROBLEMHOUSEKEEPER_FORKS;
+		case ZBX_PROCESS_TYPE_AGENT_POLLER:
+			return CONFIG_AGENTPOLLER_FORKS;
+		case ZBX_PROCESS_TYPE_SNMP_POLLER:
+			return CONFIG_SNMPPOLLER_FORKS;
+		case ZBX_PROCESS_TYPE_HTTPAGENT_POLLER:
+			return CONFIG_HTTPAGENT_POLLER_FORKS;
 	}
 
 	return get_component_process_type_forks(proc_type);
@@ -780,6 +780,39 @@ static void	count_one_str(int *count, int op, const char *value, const char *pat
 	}
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: get_window_aggregate                                             *
+ *                                                                            *
+ * Purpose: get aggregate of item values in the function history range from  *
+ *          value cache                                                       *
+ *                                                                            *
+ * Parameters: item       - [IN] the item                                     *
+ *             arg1_type  - [IN] the history range type                       *
+ *             seconds    - [IN] the history range length in seconds          *
+ *             time_shift - [IN] the history range time shift                 *
+ *             ts         - [IN] the history range end                        *
+ *             flags      - [IN] the required aggregate data, see             *
+ *                               ZBX_VC_AGGREGATE_* defines                   *
+ *             aggregate  - [OUT] the aggregate                               *
+ *                                                                            *
+ * Return value: SUCCEED - the aggregate was retrieved                        *
+ *               FAIL    - the aggregate is not available, the values must be *
+ *                         retrieved with zbx_vc_get_values()                 *
+ *                                                                            *
+ * Comments: Only time based ranges without time shift are aggregated by      *
+ *           value cache, as the aggregates follow the newest item values.    *
+ *                                                                            *
+ ******************************************************************************/
+static int	get_window_aggregate(const DC_ITEM *item, zbx_value_type_t arg1_type, int seconds, int time_shift,
+		const zbx_timespec_t *ts, unsigned char flags, zbx_vc_aggregate_t *aggregate)
+{
+	if (ZBX_VALUE_SECONDS != arg1_type || 0 != time_shift)
+		return FAIL;
+
+	return zbx_vc_get_aggregate(item->itemid, item->value_type, seconds, ts, flags, aggregate);
+}
+
 /* flags for evaluate_COUNT() */
 #define COUNT_ALL	0
 #define COUNT_UNIQUE	1
@@ -824,6 +857,7 @@ static int	evaluate_COUNT(zbx_variant_t *value, DC_ITEM *item, const char *param
 	zbx_vector_ptr_t		regexps;
 	zbx_vector_history_record_t	values;
 	zbx_timespec_t			ts_end = *ts;
+	zbx_vc_aggregate_t		aggregate;
 
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
 
@@ -1003,6 +1037,16 @@ static int	evaluate_COUNT(zbx_variant_t *value, DC_ITEM *item, const char *param
 			THIS_SHOULD_NEVER_HAPPEN;
 	}
 
+	/* plain count of numeric values can be taken from value cache window aggregate */
+	if (COUNT_ALL == unique && 0 != numeric_search && '\0' == *pattern &&
+			(NULL == operator || '\0' == *operator) &&
+			SUCCEED == get_window_aggregate(item, arg1_type, seconds, time_shift, &ts_end, 0, &aggregate))
+	{
+		zbx_variant_set_dbl(value, MIN(aggregate.count, limit));
+		ret = SUCCEED;
+		goto out;
+	}
+
 	if (FAIL == zbx_vc_get_values(item->itemid, item->value_type, &values, seconds, nvalues, &ts_end))
 	{
 		*error = zbx_strdup(*error, "cannot get values from value cache");
@@ -1150,6 +1194,7 @@ static int	evaluate_SUM(zbx_variant_t *value, DC_ITEM *item, const char *paramet
 	zbx_vector_history_record_t	values;
 	history_value_t			result;
 	zbx_timespec_t			ts_end = *ts;
+	zbx_vc_aggregate_t		aggregate;
 
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
 
@@ -1188,6 +1233,13 @@ static int	evaluate_SUM(zbx_variant_t *value, DC_ITEM *item, const char *paramet
 			THIS_SHOULD_NEVER_HAPPEN;
 	}
 
+	if (SUCCEED == get_window_aggregate(item, arg1_type, seconds, time_shift, &ts_end, 0, &aggregate))
+	{
+		zbx_history_value2variant(&aggregate.sum, item->value_type, value);
+		ret = SUCCEED;
+		goto out;
+	}
+
 	if (FAIL == zbx_vc_get_values(item->itemid, item->value_type, &values, seconds, nvalues, &ts_end))
 	{
 		*error = zbx_strdup(*error, "cannot get values from value cache");
@@ -1238,6 +1290,7 @@ static int	evaluate_AVG(zbx_variant_t  *value, DC_ITEM *item, const char *parame
 	zbx_value_type_t		arg1_type;
 	zbx_vector_history_record_t	values;
 	zbx_timespec_t			ts_end = *ts;
+	zbx_vc_aggregate_t		aggregate;
 
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
 
@@ -1276,6 +1329,24 @@ static int	evaluate_AVG(zbx_variant_t  *value, DC_ITEM *item, const char *parame
 			THIS_SHOULD_NEVER_HAPPEN;
 	}
 
+	/* the total of large float values can overflow, while their running average calculated below cannot */
+	if (SUCCEED == get_window_aggregate(item, arg1_type, seconds, time_shift, &ts_end, 0, &aggregate) &&
+			-DBL_MAX <= aggregate.total && DBL_MAX >= aggregate.total)
+	{
+		if (0 < aggregate.count)
+		{
+			zbx_variant_set_dbl(value, aggregate.total / aggregate.count);
+			ret = SUCCEED;
+		}
+		else
+		{
+			zabbix_log(LOG_LEVEL_DEBUG, "result for AVG is empty");
+			*error = zbx_strdup(*error, "not enough data");
+		}
+
+		goto out;
+	}
+
 	if (FAIL == zbx_vc_get_values(item->itemid, item->value_type, &values, seconds, nvalues, &ts_end))
 	{
 		*error = zbx_strdup(*error, "cannot get values from value cache");
@@ -1367,6 +1438,7 @@ static int	evaluate_MIN(zbx_variant_t *value, DC_ITEM *item, const char *paramet
 	zbx_value_type_t		arg1_type;
 	zbx_vector_history_record_t	values;
 	zbx_timespec_t			ts_end = *ts;
+	zbx_vc_aggregate_t		aggregate;
 
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
 
@@ -1405,6 +1477,23 @@ static int	evaluate_MIN(zbx_variant_t *value, DC_ITEM *item, const char *paramet
 			THIS_SHOULD_NEVER_HAPPEN;
 	}
 
+	if (SUCCEED == get_window_aggregate(item, arg1_type, seconds, time_shift, &ts_end, ZBX_VC_AGGREGATE_MINMAX,
+			&aggregate))
+	{
+		if (0 < aggregate.count)
+		{
+			zbx_history_value2variant(&aggregate.min, item->value_type, value);
+			ret = SUCCEED;
+		}
+		else
+		{
+			zabbix_log(LOG_LEVEL_DEBUG, "result for MIN is empty");
+			*error = zbx_strdup(*error, "not enough data");
+		}
+
+		goto out;
+	}
+
 	if (FAIL == zbx_vc_get_values(item->itemid, item->value_type, &values, seconds, nvalues, &ts_end))
 	{
 		*error = zbx_strdup(*error, "cannot get values from value cache");
@@ -1467,6 +1556,7 @@ static int	evaluate_MAX(zbx_variant_t *value, DC_ITEM *item, const char *paramet
 	zbx_value_type_t		arg1_type;
 	zbx_vector_history_record_t	values;
 	zbx_timespec_t			ts_end = *ts;
+	zbx_vc_aggregate_t		aggregate;
 
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
 
@@ -1505,6 +1595,23 @@ static int	evaluate_MAX(zbx_variant_t *value, DC_ITEM *item, const char *paramet
 			THIS_SHOULD_NEVER_HAPPEN;
 	}
 
+	if (SUCCEED == get_window_aggregate(item, arg1_type, seconds, time_shift, &ts_end, ZBX_VC_AGGREGATE_MINMAX,
+			&aggregate))
+	{
+		if (0 < aggregate.count)
+		{
+			zbx_history_value2variant(&aggregate.max, item->value_type, value);
+			ret = SUCCEED;
+		}
+		else
+		{
+			zabbix_log(LOG_LEVEL_DEBUG, "result for MAX is empty");
+			*error = zbx_strdup(*error, "not enough data");
+		}
+
+		goto out;
+	}
+
 	if (FAIL == zbx_vc_get_values(item->itemid, item->value_type, &values, seconds, nvalues, &ts_end))
 	{
 		*error = zbx_strdup(*error, "cannot get values from value cache");
@@ -1572,6 +1679,7 @@ static int	evaluate_PERCENTILE(zbx_variant_t  *value, DC_ITEM *item, const char
 	double				percentage;
 	zbx_vector_history_record_t	values;
 	zbx_timespec_t			ts_end = *ts;
+	history_value_t			percentile;
 
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
 
@@ -1618,6 +1726,15 @@ static int	evaluate_PERCENTILE(zbx_variant_t  *value, DC_ITEM *item, const char
 		goto out;
 	}
 
+	/* like window aggregates, percentile sketches follow the newest item values */
+	if (ZBX_VALUE_SECONDS == arg1_type && 0 == time_shift && SUCCEED == zbx_vc_get_percentile(item->itemid,
+			item->value_type, seconds, &ts_end, percentage, &percentile))
+	{
+		zbx_history_value2variant(&percentile, item->value_type, value);
+		ret = SUCCEED;
+		goto out;
+	}
+
 	if (FAIL == zbx_vc_get_values(item->itemid, item->value_type, &values, seconds, nvalues, &ts_end))
 	{
 		*error = zbx_strdup(*error, "cannot get values from value cache");
@@ -2903,6 +3020,58 @@ int	evaluate_function2(zbx_variant_t *value, DC_ITEM *item, const char *function
 	return ret;
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_get_function_history_range                                   *
+ *                                                                            *
+ * Purpose: get the oldest history value timestamp trigger function reads     *
+ *                                                                            *
+ * Parameters: function    - [IN] the function name                           *
+ *             parameter   - [IN] the function parameters                     *
+ *             ts          - [IN] the function evaluation time                *
+ *             range_start - [OUT] the range start timestamp                  *
+ *                                                                            *
+ * Return value: SUCCEED - the function reads time based history range       *
+ *               FAIL    - the function reads values by count or does not     *
+ *                         read history at all                                *
+ *                                                                            *
+ * Comments: Used to load history of multiple items into value cache before   *
+ *           trigger functions are evaluated.                                 *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_get_function_history_range(const char *function, const char *parameter, const zbx_timespec_t *ts,
+		int *range_start)
+{
+	static const char	*functions[] = {"avg", "count", "countunique", "find", "first", "forecast",
+					"kurtosis", "mad", "max", "min", "monodec", "monoinc", "percentile", "skewness",
+					"stddevpop", "stddevsamp", "sum", "sumofsquares", "timeleft", "varpop",
+					"varsamp", NULL};
+	const char		**name;
+	int			seconds, time_shift;
+	zbx_value_type_t	type;
+
+	for (name = functions; NULL != *name; name++)
+	{
+		if (0 == strcmp(*name, function))
+			break;
+	}
+
+	if (NULL == *name)
+		return FAIL;
+
+	if (SUCCEED != get_function_parameter_hist_range(ts->sec, parameter, 1, &seconds, &type, &time_shift) ||
+			ZBX_VALUE_SECONDS != type)
+	{
+		return FAIL;
+	}
+
+	/* ranges starting at epoch are not worth loading in advance */
+	if (0 >= (*range_start = ts->sec - time_shift - seconds))
+		return FAIL;
+
+	return SUCCEED;
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: zbx_is_trigger_function                                          *
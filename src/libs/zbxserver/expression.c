@@ -5225,20 +5225,60 @@ static void	zbx_populate_function_items(const zbx_vector_uint64_t *functionids,
 	zabbix_log(LOG_LEVEL_DEBUG, "End of %s() ifuncs_num:%d", __func__, ifuncs->num_data);
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: func_get_item                                                    *
+ *                                                                            *
+ * Purpose: get configuration cache item of the function                      *
+ *                                                                            *
+ * Parameters: func             - [IN] the function                           *
+ *             history_itemids  - [IN] the items retrieved when saving        *
+ *                                     history, sorted                        *
+ *             history_items    - [IN] the items matching history_itemids     *
+ *             history_errcodes - [IN] the item error codes                   *
+ *             itemids          - [IN] the other function items, sorted       *
+ *             items            - [IN] the items matching itemids             *
+ *             errcodes         - [IN] the item error codes                   *
+ *             item             - [OUT] the function item                     *
+ *                                                                            *
+ * Return value: SUCCEED - the item was retrieved from configuration cache    *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+static int	func_get_item(const zbx_func_t *func, const zbx_vector_uint64_t *history_itemids,
+		const DC_ITEM *history_items, const int *history_errcodes, const zbx_vector_uint64_t *itemids,
+		const DC_ITEM *items, const int *errcodes, const DC_ITEM **item)
+{
+	int	i;
+
+	/* avoid double copying from configuration cache if already retrieved when saving history */
+	if (FAIL != (i = zbx_vector_uint64_bsearch(history_itemids, func->itemid, ZBX_DEFAULT_UINT64_COMPARE_FUNC)))
+	{
+		*item = history_items + i;
+		return history_errcodes[i];
+	}
+
+	i = zbx_vector_uint64_bsearch(itemids, func->itemid, ZBX_DEFAULT_UINT64_COMPARE_FUNC);
+	*item = items + i;
+
+	return errcodes[i];
+}
+
 static void	zbx_evaluate_item_functions(zbx_hashset_t *funcs, const zbx_vector_uint64_t *history_itemids,
 		const DC_ITEM *history_items, const int *history_errcodes)
 {
 	DC_ITEM			*items = NULL;
 	char			*error = NULL;
-	int			i;
 	zbx_func_t		*func;
 	zbx_vector_uint64_t	itemids;
 	int			*errcodes = NULL;
 	zbx_hashset_iter_t	iter;
+	zbx_vector_vc_range_t	ranges;
 
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s() funcs_num:%d", __func__, funcs->num_data);
 
 	zbx_vector_uint64_create(&itemids);
+	zbx_vector_vc_range_create(&ranges);
 
 	zbx_hashset_iter_reset(funcs, &iter);
 	while (NULL != (func = (zbx_func_t *)zbx_hashset_iter_next(&iter)))
@@ -5259,27 +5299,41 @@ static void	zbx_evaluate_item_functions(zbx_hashset_t *funcs, const zbx_vector_u
 				ZBX_ITEM_GET_SYNC);
 	}
 
+	/* load history of items missing from value cache with few multi-item requests */
 	zbx_hashset_iter_reset(funcs, &iter);
 	while (NULL != (func = (zbx_func_t *)zbx_hashset_iter_next(&iter)))
 	{
-		int		errcode;
+		zbx_vc_range_t	range;
 		const DC_ITEM	*item;
 
-		/* avoid double copying from configuration cache if already retrieved when saving history */
-		if (FAIL != (i = zbx_vector_uint64_bsearch(history_itemids, func->itemid,
-				ZBX_DEFAULT_UINT64_COMPARE_FUNC)))
+		if (SUCCEED != func_get_item(func, history_itemids, history_items, history_errcodes, &itemids, items,
+				errcodes, &item) || ITEM_STATUS_ACTIVE != item->status ||
+				HOST_STATUS_MONITORED != item->host.status)
 		{
-			item = history_items + i;
-			errcode = history_errcodes[i];
+			continue;
 		}
-		else
+
+		if (SUCCEED != zbx_get_function_history_range(func->function, func->parameter, &func->timespec,
+				&range.range_start))
 		{
-			i = zbx_vector_uint64_bsearch(&itemids, func->itemid, ZBX_DEFAULT_UINT64_COMPARE_FUNC);
-			item = items + i;
-			errcode = errcodes[i];
+			continue;
 		}
 
-		if (SUCCEED != errcode)
+		range.itemid = item->itemid;
+		range.value_type = item->value_type;
+		zbx_vector_vc_range_append_ptr(&ranges, &range);
+	}
+
+	if (0 != ranges.values_num)
+		zbx_vc_prefetch_values(&ranges);
+
+	zbx_hashset_iter_reset(funcs, &iter);
+	while (NULL != (func = (zbx_func_t *)zbx_hashset_iter_next(&iter)))
+	{
+		const DC_ITEM	*item;
+
+		if (SUCCEED != func_get_item(func, history_itemids, history_items, history_errcodes, &itemids, items,
+				errcodes, &item))
 		{
 			zbx_free(func->error);
 			func->error = zbx_eval_format_function_error(func->function, NULL, NULL, func->parameter,
@@ -5331,6 +5385,7 @@ static void	zbx_evaluate_item_functions(zbx_hashset_t *funcs, const zbx_vector_u
 
 	DCconfig_clean_items(items, errcodes, itemids.values_num);
 	zbx_vector_uint64_destroy(&itemids);
+	zbx_vector_vc_range_destroy(&ranges);
 
 	zbx_free(errcodes);
 	zbx_free(items);
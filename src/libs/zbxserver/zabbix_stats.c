@@ -80,6 +80,7 @@ void	zbx_get_zabbix_stats(struct zbx_json *json)
 	zbx_json_addfloat(json, "pfree", *(double *)DCconfig_get_stats(ZBX_CONFSTATS_BUFFER_PFREE));
 	zbx_json_adduint64(json, "used", *(zbx_uint64_t *)DCconfig_get_stats(ZBX_CONFSTATS_BUFFER_USED));
 	zbx_json_addfloat(json, "pused", *(double *)DCconfig_get_stats(ZBX_CONFSTATS_BUFFER_PUSED));
+	zbx_json_adduint64(json, "peritem", *(zbx_uint64_t *)DCconfig_get_stats(ZBX_CONFSTATS_BUFFER_PER_ITEM));
 	zbx_json_close(json);
 
 	/* zabbix[version] */
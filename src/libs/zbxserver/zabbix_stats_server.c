@@ -78,6 +78,8 @@ void	zbx_get_zabbix_stats_ext(struct zbx_json *json)
 		zbx_json_adduint64(json, "hits", vc_stats.hits);
 		zbx_json_adduint64(json, "misses", vc_stats.misses);
 		zbx_json_adduint64(json, "mode", vc_stats.mode);
+		zbx_json_adduint64(json, "packed_values", vc_stats.packed_values);
+		zbx_json_adduint64(json, "packed_size", vc_stats.packed_size);
 		zbx_json_close(json);
 
 		zbx_json_close(json);
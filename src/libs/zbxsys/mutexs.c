@@ -310,6 +310,74 @@ void	__zbx_rwlock_unlock(const char *filename, int line, zbx_rwlock_t rwlock)
 	}
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: __zbx_rwlock_trywrlock                                           *
+ *                                                                            *
+ * Purpose: try to acquire write lock for read-write lock without waiting     *
+ *                                                                            *
+ * Parameters: rwlock - handle of read-write lock                             *
+ *                                                                            *
+ * Return value: SUCCEED - the lock was acquired                              *
+ *               FAIL    - the lock is held by another process                *
+ *                                                                            *
+ ******************************************************************************/
+int	__zbx_rwlock_trywrlock(const char *filename, int line, zbx_rwlock_t rwlock)
+{
+	int	err;
+
+	if (ZBX_RWLOCK_NULL == rwlock)
+		return SUCCEED;
+
+	if (0 != locks_disabled)
+		return SUCCEED;
+
+	if (0 != (err = pthread_rwlock_trywrlock(rwlock)))
+	{
+		if (EBUSY == err)
+			return FAIL;
+
+		zbx_error("[file:'%s',line:%d] write lock failed: %s", filename, line, zbx_strerror(err));
+		exit(EXIT_FAILURE);
+	}
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: __zbx_rwlock_tryrdlock                                           *
+ *                                                                            *
+ * Purpose: try to acquire read lock for read-write lock without waiting      *
+ *                                                                            *
+ * Parameters: rwlock - handle of read-write lock                             *
+ *                                                                            *
+ * Return value: SUCCEED - the lock was acquired                              *
+ *               FAIL    - the lock is held by a writer                       *
+ *                                                                            *
+ ******************************************************************************/
+int	__zbx_rwlock_tryrdlock(const char *filename, int line, zbx_rwlock_t rwlock)
+{
+	int	err;
+
+	if (ZBX_RWLOCK_NULL == rwlock)
+		return SUCCEED;
+
+	if (0 != locks_disabled)
+		return SUCCEED;
+
+	if (0 != (err = pthread_rwlock_tryrdlock(rwlock)))
+	{
+		if (EBUSY == err)
+			return FAIL;
+
+		zbx_error("[file:'%s',line:%d] read lock failed: %s", filename, line, zbx_strerror(err));
+		exit(EXIT_FAILURE);
+	}
+
+	return SUCCEED;
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: zbx_rwlock_destroy                                               *
@@ -515,6 +583,46 @@ void	__zbx_mutex_unlock(const char *filename, int line, zbx_mutex_t mutex)
 #endif
 }
 
+#if !defined(_WINDOWS) && !defined(HAVE_PTHREAD_PROCESS_SHARED)
+/******************************************************************************
+ *                                                                            *
+ * Function: __zbx_mutex_trylock                                              *
+ *                                                                            *
+ * Purpose: try to lock the mutex without waiting                             *
+ *                                                                            *
+ * Parameters: mutex - handle of mutex                                        *
+ *                                                                            *
+ * Return value: SUCCEED - the mutex was locked                               *
+ *               FAIL    - the mutex is locked by another process             *
+ *                                                                            *
+ ******************************************************************************/
+int	__zbx_mutex_trylock(const char *filename, int line, zbx_mutex_t mutex)
+{
+	struct sembuf	sem_lock;
+
+	if (ZBX_MUTEX_NULL == mutex)
+		return SUCCEED;
+
+	sem_lock.sem_num = mutex;
+	sem_lock.sem_op = -1;
+	sem_lock.sem_flg = SEM_UNDO | IPC_NOWAIT;
+
+	while (-1 == semop(ZBX_SEM_LIST_ID, &sem_lock, 1))
+	{
+		if (EAGAIN == errno)
+			return FAIL;
+
+		if (EINTR != errno)
+		{
+			zbx_error("[file:'%s',line:%d] lock failed: %s", filename, line, zbx_strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	return SUCCEED;
+}
+#endif
+
 /******************************************************************************
  *                                                                            *
  * Function: zbx_mutex_destroy                                                *
@@ -298,6 +298,9 @@ int	CONFIG_HISTORYPOLLER_FORKS	= 0;
 int	CONFIG_AVAILMAN_FORKS		= 0;
 int	CONFIG_SERVICEMAN_FORKS		= 0;
 int	CONFIG_PROBLEMHOUSEKEEPER_FORKS = 0;
+int	CONFIG_AGENTPOLLER_FORKS	= 0;
+int	CONFIG_SNMPPOLLER_FORKS		= 0;
+int	CONFIG_HTTPAGENT_POLLER_FORKS	= 0;
 
 char	*opt = NULL;
 
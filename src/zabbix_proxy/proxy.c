@@ -44,6 +44,7 @@
 #include "housekeeper/housekeeper.h"
 #include "../zabbix_server/pinger/pinger.h"
 #include "../zabbix_server/poller/poller.h"
+#include "../zabbix_server/poller/async_poller.h"
 #include "../zabbix_server/trapper/trapper.h"
 #include "../zabbix_server/trapper/proxydata.h"
 #include "../zabbix_server/snmptrapper/snmptrapper.h"
@@ -188,6 +189,10 @@ int	CONFIG_HISTORYPOLLER_FORKS	= 1;	/* for zabbix[proxy_history] internal check
 int	CONFIG_AVAILMAN_FORKS		= 1;
 int	CONFIG_SERVICEMAN_FORKS		= 0;
 int	CONFIG_PROBLEMHOUSEKEEPER_FORKS	= 0;
+int	CONFIG_AGENTPOLLER_FORKS	= 0;
+int	CONFIG_SNMPPOLLER_FORKS		= 0;
+int	CONFIG_HTTPAGENT_POLLER_FORKS	= 0;
+int	CONFIG_MAX_CONCURRENT_CHECKS_PER_POLLER	= 1000;
 
 int	CONFIG_LISTEN_PORT		= ZBX_DEFAULT_SERVER_PORT;
 char	*CONFIG_LISTEN_IP		= NULL;
@@ -205,6 +210,7 @@ int	CONFIG_PROXYDATA_FREQUENCY	= 1;
 
 int	CONFIG_HISTSYNCER_FORKS		= 4;
 int	CONFIG_HISTSYNCER_FREQUENCY	= 1;
+int	CONFIG_HISTSYNCER_PIPELINE	= 0;
 int	CONFIG_CONFSYNCER_FORKS		= 1;
 
 int	CONFIG_VMWARE_FORKS		= 0;
@@ -215,9 +221,19 @@ int	CONFIG_VMWARE_TIMEOUT		= 10;
 zbx_uint64_t	CONFIG_CONF_CACHE_SIZE		= 8 * ZBX_MEBIBYTE;
 zbx_uint64_t	CONFIG_HISTORY_CACHE_SIZE	= 16 * ZBX_MEBIBYTE;
 zbx_uint64_t	CONFIG_HISTORY_INDEX_CACHE_SIZE	= 4 * ZBX_MEBIBYTE;
+int		CONFIG_HISTORY_CACHE_SHARDS	= 1;
+int		CONFIG_HISTORY_CACHE_COMPRESSION	= 0;
+char		*CONFIG_HISTORY_CACHE_SPOOL_FILE	= NULL;
+zbx_uint64_t	CONFIG_HISTORY_CACHE_SPOOL_SIZE	= ZBX_GIBIBYTE;
+char		*CONFIG_HISTORY_CACHE_SNAPSHOT_FILE	= NULL;
 zbx_uint64_t	CONFIG_TRENDS_CACHE_SIZE	= 0;
 zbx_uint64_t	CONFIG_TREND_FUNC_CACHE_SIZE	= 0;
 zbx_uint64_t	CONFIG_VALUE_CACHE_SIZE		= 0;
+int		CONFIG_VALUE_CACHE_COMPRESSION	= 0;
+int		CONFIG_VALUE_CACHE_STRIPES	= 1;
+char		*CONFIG_VALUE_CACHE_SNAPSHOT_FILE	= NULL;
+char		*CONFIG_CONFIG_CACHE_SNAPSHOT_FILE	= NULL;
+int		CONFIG_VALUE_CACHE_PERCENTILE_SKETCH	= 0;
 zbx_uint64_t	CONFIG_VMWARE_CACHE_SIZE	= 8 * ZBX_MEBIBYTE;
 zbx_uint64_t	CONFIG_EXPORT_FILE_SIZE;
 
@@ -306,6 +322,7 @@ static char	*CONFIG_SOCKET_PATH	= NULL;
 
 char	*CONFIG_HISTORY_STORAGE_URL		= NULL;
 char	*CONFIG_HISTORY_STORAGE_OPTS		= NULL;
+char	*CONFIG_HISTORY_STORAGE_DIR		= NULL;
 int	CONFIG_HISTORY_STORAGE_PIPELINES	= 0;
 
 char	*CONFIG_STATS_ALLOWED_IP	= NULL;
@@ -439,6 +456,21 @@ int	get_process_info_by_thread(int local_server_num, unsigned char *local_proces
 		*local_process_type = ZBX_PROCESS_TYPE_AVAILMAN;
 		*local_process_num = local_server_num - server_count + CONFIG_AVAILMAN_FORKS;
 	}
+	else if (local_server_num <= (server_count += CONFIG_AGENTPOLLER_FORKS))
+	{
+		*local_process_type = ZBX_PROCESS_TYPE_AGENT_POLLER;
+		*local_process_num = local_server_num - server_count + CONFIG_AGENTPOLLER_FORKS;
+	}
+	else if (local_server_num <= (server_count += CONFIG_SNMPPOLLER_FORKS))
+	{
+		*local_process_type = ZBX_PROCESS_TYPE_SNMP_POLLER;
+		*local_process_num = local_server_num - server_count + CONFIG_SNMPPOLLER_FORKS;
+	}
+	else if (local_server_num <= (server_count += CONFIG_HTTPAGENT_POLLER_FORKS))
+	{
+		*local_process_type = ZBX_PROCESS_TYPE_HTTPAGENT_POLLER;
+		*local_process_num = local_server_num - server_count + CONFIG_HTTPAGENT_POLLER_FORKS;
+	}
 	else
 		return FAIL;
 
@@ -570,10 +602,12 @@ static void	zbx_validate_config(ZBX_TASK_EX *task)
 		err = 1;
 	}
 
-	if (0 == CONFIG_UNREACHABLE_POLLER_FORKS && 0 != CONFIG_POLLER_FORKS + CONFIG_JAVAPOLLER_FORKS)
+	if (0 == CONFIG_UNREACHABLE_POLLER_FORKS &&
+			0 != CONFIG_POLLER_FORKS + CONFIG_JAVAPOLLER_FORKS + CONFIG_AGENTPOLLER_FORKS +
+			CONFIG_SNMPPOLLER_FORKS + CONFIG_HTTPAGENT_POLLER_FORKS)
 	{
 		zabbix_log(LOG_LEVEL_CRIT, "\"StartPollersUnreachable\" configuration parameter must not be 0"
-				" if regular or Java pollers are started");
+				" if regular, Java, agent, SNMP or HTTP agent pollers are started");
 		err = 1;
 	}
 
@@ -654,6 +688,13 @@ static void	zbx_validate_config(ZBX_TASK_EX *task)
 #if !defined(HAVE_OPENIPMI)
 	err |= (FAIL == check_cfg_feature_int("StartIPMIPollers", CONFIG_IPMIPOLLER_FORKS, "IPMI support"));
 #endif
+#if !defined(HAVE_NETSNMP)
+	err |= (FAIL == check_cfg_feature_int("StartSNMPPollers", CONFIG_SNMPPOLLER_FORKS, "SNMP support"));
+#endif
+#if !defined(HAVE_LIBCURL)
+	err |= (FAIL == check_cfg_feature_int("StartHTTPAgentPollers", CONFIG_HTTPAGENT_POLLER_FORKS,
+			"cURL library"));
+#endif
 
 	err |= (FAIL == zbx_db_validate_config_features());
 
@@ -720,6 +761,16 @@ static void	zbx_load_config(ZBX_TASK_EX *task)
 			PARM_OPT,	128 * ZBX_KIBIBYTE,	__UINT64_C(2) * ZBX_GIBIBYTE},
 		{"HistoryIndexCacheSize",	&CONFIG_HISTORY_INDEX_CACHE_SIZE,	TYPE_UINT64,
 			PARM_OPT,	128 * ZBX_KIBIBYTE,	__UINT64_C(2) * ZBX_GIBIBYTE},
+		{"HistoryCacheShards",		&CONFIG_HISTORY_CACHE_SHARDS,		TYPE_INT,
+			PARM_OPT,	1,			ZBX_HC_SHARDS_MAX},
+		{"HistoryCacheCompression",	&CONFIG_HISTORY_CACHE_COMPRESSION,	TYPE_INT,
+			PARM_OPT,	0,			1},
+		{"HistoryCacheSpoolFile",	&CONFIG_HISTORY_CACHE_SPOOL_FILE,	TYPE_STRING,
+			PARM_OPT,	0,			0},
+		{"HistoryCacheSpoolSize",	&CONFIG_HISTORY_CACHE_SPOOL_SIZE,	TYPE_UINT64,
+			PARM_OPT,	ZBX_MEBIBYTE,		__UINT64_C(1024) * ZBX_GIBIBYTE},
+		{"HistoryCacheSnapshotFile",	&CONFIG_HISTORY_CACHE_SNAPSHOT_FILE,	TYPE_STRING,
+			PARM_OPT,	0,			0},
 		{"HousekeepingFrequency",	&CONFIG_HOUSEKEEPING_FREQUENCY,		TYPE_INT,
 			PARM_OPT,	0,			24},
 		{"ProxyLocalBuffer",		&CONFIG_PROXY_LOCAL_BUFFER,		TYPE_INT,
@@ -870,6 +921,14 @@ static void	zbx_load_config(ZBX_TASK_EX *task)
 			PARM_OPT,	1,			1000},
 		{"StartHistoryPollers",		&CONFIG_HISTORYPOLLER_FORKS,		TYPE_INT,
 			PARM_OPT,	0,			1000},
+		{"StartAgentPollers",		&CONFIG_AGENTPOLLER_FORKS,		TYPE_INT,
+			PARM_OPT,	0,			1000},
+		{"StartSNMPPollers",		&CONFIG_SNMPPOLLER_FORKS,		TYPE_INT,
+			PARM_OPT,	0,			1000},
+		{"StartHTTPAgentPollers",	&CONFIG_HTTPAGENT_POLLER_FORKS,	TYPE_INT,
+			PARM_OPT,	0,			1000},
+		{"MaxConcurrentChecksPerPoller",	&CONFIG_MAX_CONCURRENT_CHECKS_PER_POLLER,	TYPE_INT,
+			PARM_OPT,	1,			1000},
 		{"ListenBacklog",		&CONFIG_TCP_MAX_BACKLOG_SIZE,		TYPE_INT,
 			PARM_OPT,	0,			INT_MAX},
 		{NULL}
@@ -1201,7 +1260,8 @@ int	MAIN_ZABBIX_ENTRY(int flags)
 			+ CONFIG_JAVAPOLLER_FORKS + CONFIG_SNMPTRAPPER_FORKS + CONFIG_SELFMON_FORKS
 			+ CONFIG_VMWARE_FORKS + CONFIG_IPMIMANAGER_FORKS + CONFIG_TASKMANAGER_FORKS
 			+ CONFIG_PREPROCMAN_FORKS + CONFIG_PREPROCESSOR_FORKS + CONFIG_HISTORYPOLLER_FORKS
-			+ CONFIG_AVAILMAN_FORKS;
+			+ CONFIG_AVAILMAN_FORKS + CONFIG_AGENTPOLLER_FORKS + CONFIG_SNMPPOLLER_FORKS
+			+ CONFIG_HTTPAGENT_POLLER_FORKS;
 
 	threads = (pid_t *)zbx_calloc(threads, threads_num, sizeof(pid_t));
 	threads_flags = (int *)zbx_calloc(threads_flags, threads_num, sizeof(int));
@@ -1318,6 +1378,21 @@ int	MAIN_ZABBIX_ENTRY(int flags)
 				threads_flags[i] = ZBX_THREAD_PRIORITY_FIRST;
 				zbx_thread_start(availability_manager_thread, &thread_args, &threads[i]);
 				break;
+			case ZBX_PROCESS_TYPE_AGENT_POLLER:
+				poller_type = ZBX_POLLER_TYPE_AGENT;
+				thread_args.args = &poller_type;
+				zbx_thread_start(async_poller_thread, &thread_args, &threads[i]);
+				break;
+			case ZBX_PROCESS_TYPE_SNMP_POLLER:
+				poller_type = ZBX_POLLER_TYPE_SNMP;
+				thread_args.args = &poller_type;
+				zbx_thread_start(async_poller_thread, &thread_args, &threads[i]);
+				break;
+			case ZBX_PROCESS_TYPE_HTTPAGENT_POLLER:
+				poller_type = ZBX_POLLER_TYPE_HTTPAGENT;
+				thread_args.args = &poller_type;
+				zbx_thread_start(async_poller_thread, &thread_args, &threads[i]);
+				break;
 		}
 	}
 
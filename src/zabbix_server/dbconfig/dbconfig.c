@@ -100,7 +100,10 @@ ZBX_THREAD_ENTRY(dbconfig_thread, args)
 	DCsync_configuration(ZBX_DBSYNC_INIT, NULL);
 	zbx_setproctitle("%s [synced configuration in " ZBX_FS_DBL " sec, idle %d sec]",
 			get_process_type_string(process_type), (sec = zbx_time() - sec), CONFIG_CONFSYNCER_FREQUENCY);
-	zbx_sleep_loop(CONFIG_CONFSYNCER_FREQUENCY);
+
+	/* configuration loaded from snapshot can be outdated, synchronize it with database right away */
+	if (SUCCEED != DCconfig_snapshot_loaded())
+		zbx_sleep_loop(CONFIG_CONFSYNCER_FREQUENCY);
 
 	while (ZBX_IS_RUNNING())
 	{
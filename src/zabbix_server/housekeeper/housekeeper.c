@@ -155,6 +155,9 @@ typedef struct
 
 	/* the item delete queue */
 	zbx_vector_ptr_t	delete_queue;
+
+	/* the longest item history period, used for history storages removing whole partitions */
+	int			history_max;
 }
 zbx_hk_history_rule_t;
 
@@ -446,6 +449,9 @@ static void	hk_history_update(zbx_hk_history_rule_t *rules, int now)
 			if (0 != history && ZBX_HK_OPTION_DISABLED != *rule->poption_global)
 				history = *rule->poption;
 
+			if (history > rule->history_max)
+				rule->history_max = history;
+
 			hk_history_item_update(rules, rule, ITEM_VALUE_TYPE_MAX, now, itemid, history);
 		}
 
@@ -511,6 +517,8 @@ static void	hk_history_delete_queue_prepare_all(zbx_hk_history_rule_t *rules, in
 	/* prepare history item cache (hashset containing itemid:min_clock values) */
 	for (rule = rules; NULL != rule->table; rule++)
 	{
+		rule->history_max = 0;
+
 		if (ZBX_HK_MODE_REGULAR == *rule->poption_mode)
 		{
 			if (0 == rule->item_cache.num_slots)
@@ -612,6 +620,40 @@ out:
 #endif
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: hk_history_keep_from                                             *
+ *                                                                            *
+ * Purpose: gets the oldest history timestamp to keep for history storages    *
+ *          removing whole partitions                                         *
+ *                                                                            *
+ * Parameters: rule - [IN] the history housekeeping rule                      *
+ *             now  - [IN] the current timestamp                              *
+ *                                                                            *
+ * Return value: The oldest timestamp to keep or 0 to keep all history.       *
+ *                                                                            *
+ * Comments: Partitions cannot be cleaned by item, so without global history  *
+ *           period override the longest item history period is used.         *
+ *                                                                            *
+ ******************************************************************************/
+static int	hk_history_keep_from(const zbx_hk_history_rule_t *rule, int now)
+{
+	int	history;
+
+	if (ZBX_HK_MODE_DISABLED == *rule->poption_mode)
+		return 0;
+
+	if (ZBX_HK_OPTION_DISABLED != *rule->poption_global)
+		history = *rule->poption;
+	else
+		history = rule->history_max;
+
+	if (ZBX_HK_HISTORY_MIN > history || ZBX_HK_PERIOD_MAX < history)
+		return 0;
+
+	return now - history;
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: housekeeping_history_and_trends                                  *
@@ -637,6 +679,19 @@ static int	housekeeping_history_and_trends(int now)
 	/* we need to clear records from */
 	for (rule = hk_history_rules; NULL != rule->table; rule++)
 	{
+		/* history stored outside of database is housekept by history storage, which also needs it */
+		/* when housekeeping is disabled                                                           */
+		if (rule - hk_history_rules < HK_UPDATE_CACHE_OFFSET_TREND_FLOAT && SUCCEED ==
+				zbx_history_housekeep(rule->type, now, hk_history_keep_from(rule, now), &rc))
+		{
+			deleted += rc;
+
+			if (0 != rule->item_cache.num_slots)
+				hk_history_delete_queue_clear(rule);
+
+			continue;
+		}
+
 		if (ZBX_HK_MODE_DISABLED == *rule->poption_mode)
 			continue;
 
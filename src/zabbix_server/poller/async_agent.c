@@ -0,0 +1,994 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+
+#include "common.h"
+#include "comms.h"
+#include "log.h"
+#include "zbxcompress.h"
+#include "../../libs/zbxcrypto/tls_tcp.h"
+
+#include "async_agent.h"
+#include "checks_agent.h"
+
+extern unsigned char	program_type;
+
+#define ZBX_AGENT_STATE_RESOLVE		0
+#define ZBX_AGENT_STATE_CONNECT		1
+#define ZBX_AGENT_STATE_HANDSHAKE	2
+#define ZBX_AGENT_STATE_SEND		3
+#define ZBX_AGENT_STATE_RECV		4
+
+#define ZBX_AGENT_HEADER_DATA		"ZBXD"
+#define ZBX_AGENT_HEADER_DATA_LEN	ZBX_CONST_STRLEN(ZBX_AGENT_HEADER_DATA)
+#define ZBX_AGENT_HEADER_LEN		(ZBX_AGENT_HEADER_DATA_LEN + 1 + 2 * sizeof(zbx_uint32_t))
+
+#define ZBX_AGENT_RECV_CHUNK		ZBX_STAT_BUF_LEN
+
+/* passive agent check in progress */
+typedef struct
+{
+	DC_ITEM				item;
+	AGENT_RESULT			result;
+	zbx_async_check_done_cb_t	done_cb;
+	void				*done_arg;
+	zbx_async_agent_t		*agent;
+	struct event			*ev;
+#ifdef ZBX_ASYNC_AGENT_EVDNS
+	struct evdns_getaddrinfo_request	*dns_req;
+#endif
+	int				fd;
+#if defined(HAVE_GNUTLS) || defined(HAVE_OPENSSL)
+	zbx_tls_context_t		*tls_ctx;
+	const char			*tls_arg1;
+	const char			*tls_arg2;
+#endif
+	unsigned char			state;
+	double				deadline;
+
+	/* the request being sent or the response being received */
+	char				*buffer;
+	size_t				buffer_alloc;
+	size_t				buffer_offset;
+	size_t				buffer_len;
+}
+zbx_agent_context_t;
+
+static void	agent_event_cb(evutil_socket_t fd, short what, void *arg);
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agent_context_finish                                             *
+ *                                                                            *
+ * Purpose: releases check resources and reports the result to poller         *
+ *                                                                            *
+ * Parameters: ctx     - [IN] the check context                               *
+ *             errcode - [IN] the check result code                           *
+ *                                                                            *
+ ******************************************************************************/
+static void	agent_context_finish(zbx_agent_context_t *ctx, int errcode)
+{
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s() itemid:" ZBX_FS_UI64 " %s", __func__, ctx->item.itemid,
+			zbx_result_string(errcode));
+
+	if (NULL != ctx->ev)
+		event_free(ctx->ev);
+
+#if defined(HAVE_GNUTLS) || defined(HAVE_OPENSSL)
+	zbx_tls_async_close(&ctx->tls_ctx);
+#endif
+	if (-1 != ctx->fd)
+		close(ctx->fd);
+
+	zbx_free(ctx->buffer);
+
+	ctx->done_cb(&ctx->item, &ctx->result, errcode, ctx->done_arg);
+	zbx_free(ctx);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agent_context_fail                                               *
+ *                                                                            *
+ * Purpose: finishes check with network error                                 *
+ *                                                                            *
+ * Parameters: ctx     - [IN] the check context                               *
+ *             errcode - [IN] the check result code                           *
+ *             error   - [IN] the error message                               *
+ *                                                                            *
+ ******************************************************************************/
+static void	agent_context_fail(zbx_agent_context_t *ctx, int errcode, const char *error)
+{
+	SET_MSG_RESULT(&ctx->result, zbx_dsprintf(NULL, "Get value from agent failed: %s", error));
+	agent_context_finish(ctx, errcode);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agent_context_wait                                               *
+ *                                                                            *
+ * Purpose: waits for socket to become readable or writable within the check  *
+ *          timeout                                                           *
+ *                                                                            *
+ * Parameters: ctx  - [IN] the check context                                  *
+ *             what - [IN] EV_READ or EV_WRITE, 0 to wait only for timeout    *
+ *                                                                            *
+ ******************************************************************************/
+static void	agent_context_wait(zbx_agent_context_t *ctx, short what)
+{
+	struct timeval	tv;
+	double		left;
+
+	if (NULL != ctx->ev)
+		event_free(ctx->ev);
+
+	if (0 > (left = ctx->deadline - zbx_time()))
+		left = 0;
+
+	tv.tv_sec = (time_t)left;
+	tv.tv_usec = (suseconds_t)((left - tv.tv_sec) * 1000000);
+
+	ctx->ev = event_new(ctx->agent->base, ctx->fd, what, agent_event_cb, ctx);
+	event_add(ctx->ev, &tv);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agent_connect                                                    *
+ *                                                                            *
+ * Purpose: starts nonblocking connection to agent                            *
+ *                                                                            *
+ * Parameters: ctx   - [IN] the check context                                 *
+ *             ai    - [IN] the resolved agent address                        *
+ *             error - [OUT] the error message                                *
+ *                                                                            *
+ * Return value: SUCCEED - the connection is established or in progress       *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+static int	agent_connect(zbx_agent_context_t *ctx, const struct addrinfo *ai, char **error)
+{
+	const struct addrinfo	*ai_bind = ctx->agent->source_ai;
+	int			flags;
+
+	if (-1 == (ctx->fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol)))
+	{
+		*error = zbx_dsprintf(*error, "cannot create socket [[%s]:%hu]: %s", ctx->item.interface.addr,
+				ctx->item.interface.port, zbx_strerror(errno));
+		return FAIL;
+	}
+
+	if (-1 == (flags = fcntl(ctx->fd, F_GETFL, 0)) || -1 == fcntl(ctx->fd, F_SETFL, flags | O_NONBLOCK))
+	{
+		*error = zbx_dsprintf(*error, "cannot set nonblocking mode on socket [[%s]:%hu]: %s",
+				ctx->item.interface.addr, ctx->item.interface.port, zbx_strerror(errno));
+		return FAIL;
+	}
+
+	if (NULL != ai_bind)
+	{
+		if (ai_bind->ai_family != ai->ai_family)
+		{
+			*error = zbx_dsprintf(*error, "invalid source IP address [%s]", CONFIG_SOURCE_IP);
+			return FAIL;
+		}
+
+		if (-1 == bind(ctx->fd, ai_bind->ai_addr, ai_bind->ai_addrlen))
+		{
+			*error = zbx_dsprintf(*error, "bind() failed: %s", zbx_strerror(errno));
+			return FAIL;
+		}
+	}
+
+	if (-1 == connect(ctx->fd, ai->ai_addr, (socklen_t)ai->ai_addrlen) && EINPROGRESS != errno)
+	{
+		*error = zbx_dsprintf(*error, "cannot connect to [[%s]:%hu]: %s", ctx->item.interface.addr,
+				ctx->item.interface.port, zbx_strerror(errno));
+		return FAIL;
+	}
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agent_prepare_request                                            *
+ *                                                                            *
+ * Purpose: writes item key with Zabbix protocol header into context buffer   *
+ *                                                                            *
+ ******************************************************************************/
+static void	agent_prepare_request(zbx_agent_context_t *ctx)
+{
+	size_t		key_len;
+	zbx_uint32_t	len32_le;
+
+	key_len = strlen(ctx->item.key);
+
+	ctx->buffer_alloc = ZBX_AGENT_HEADER_LEN + key_len;
+	ctx->buffer = (char *)zbx_malloc(NULL, ctx->buffer_alloc);
+
+	memcpy(ctx->buffer, ZBX_AGENT_HEADER_DATA, ZBX_AGENT_HEADER_DATA_LEN);
+	ctx->buffer_len = ZBX_AGENT_HEADER_DATA_LEN;
+
+	ctx->buffer[ctx->buffer_len++] = ZBX_TCP_PROTOCOL;
+
+	len32_le = zbx_htole_uint32((zbx_uint32_t)key_len);
+	memcpy(ctx->buffer + ctx->buffer_len, &len32_le, sizeof(len32_le));
+	ctx->buffer_len += sizeof(len32_le);
+
+	len32_le = 0;
+	memcpy(ctx->buffer + ctx->buffer_len, &len32_le, sizeof(len32_le));
+	ctx->buffer_len += sizeof(len32_le);
+
+	memcpy(ctx->buffer + ctx->buffer_len, ctx->item.key, key_len);
+	ctx->buffer_len += key_len;
+
+	ctx->buffer_offset = 0;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agent_start                                                      *
+ *                                                                            *
+ * Purpose: connects to the resolved agent address and starts sending request *
+ *                                                                            *
+ ******************************************************************************/
+static void	agent_start(zbx_agent_context_t *ctx, const struct addrinfo *ai)
+{
+	char	*error = NULL;
+
+	ctx->state = ZBX_AGENT_STATE_CONNECT;
+
+	if (SUCCEED != agent_connect(ctx, ai, &error))
+	{
+		agent_context_fail(ctx, NETWORK_ERROR, error);
+		zbx_free(error);
+		return;
+	}
+
+	agent_prepare_request(ctx);
+	agent_context_wait(ctx, EV_WRITE);
+}
+
+#ifdef ZBX_ASYNC_AGENT_EVDNS
+/******************************************************************************
+ *                                                                            *
+ * Function: agent_resolve_cb                                                 *
+ *                                                                            *
+ * Purpose: connects to agent when its address is resolved                    *
+ *                                                                            *
+ ******************************************************************************/
+static void	agent_resolve_cb(int result, struct evutil_addrinfo *ai, void *arg)
+{
+	zbx_agent_context_t	*ctx = (zbx_agent_context_t *)arg;
+	char			*error;
+
+	ctx->dns_req = NULL;
+
+	if (0 != result)
+	{
+		if (EVUTIL_EAI_CANCEL == result)
+			error = zbx_dsprintf(NULL, "cannot resolve [%s]: timed out", ctx->item.interface.addr);
+		else
+			error = zbx_dsprintf(NULL, "cannot resolve [%s]: %s", ctx->item.interface.addr,
+					evutil_gai_strerror(result));
+
+		agent_context_fail(ctx, NETWORK_ERROR, error);
+		zbx_free(error);
+		return;
+	}
+
+	agent_start(ctx, ai);
+	evutil_freeaddrinfo(ai);
+}
+#endif
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agent_resolve                                                    *
+ *                                                                            *
+ * Purpose: resolves agent address and connects to it                         *
+ *                                                                            *
+ * Comments: The address is resolved by the poller nonblocking resolver       *
+ *           within the check timeout, the check is started from the request  *
+ *           callback. Numeric addresses are handled without waiting.         *
+ *           Without nonblocking resolver (libevent before 2.0) the address   *
+ *           is resolved by blocking getaddrinfo().                           *
+ *                                                                            *
+ ******************************************************************************/
+static void	agent_resolve(zbx_agent_context_t *ctx)
+{
+	struct addrinfo	hints;
+	char		service[8];
+#ifdef ZBX_ASYNC_AGENT_EVDNS
+	struct evdns_getaddrinfo_request	*req;
+#else
+	struct addrinfo	*ai = NULL;
+	char		*error;
+#endif
+	zbx_snprintf(service, sizeof(service), "%hu", ctx->item.interface.port);
+	memset(&hints, 0, sizeof(hints));
+#ifdef HAVE_IPV6
+	hints.ai_family = PF_UNSPEC;
+#else
+	hints.ai_family = AF_INET;
+#endif
+	/* take only addresses the source address can be bound to */
+	if (NULL != ctx->agent->source_ai)
+		hints.ai_family = ctx->agent->source_ai->ai_family;
+
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+
+	ctx->state = ZBX_AGENT_STATE_RESOLVE;
+#ifdef ZBX_ASYNC_AGENT_EVDNS
+	agent_context_wait(ctx, 0);
+
+	/* callback can be called and the check finished before request returns, then it returns NULL */
+	if (NULL != (req = evdns_getaddrinfo(ctx->agent->dnsbase, ctx->item.interface.addr, service, &hints,
+			agent_resolve_cb, ctx)))
+	{
+		ctx->dns_req = req;
+	}
+#else
+	if (0 != getaddrinfo(ctx->item.interface.addr, service, &hints, &ai))
+	{
+		error = zbx_dsprintf(NULL, "cannot resolve [%s]", ctx->item.interface.addr);
+		agent_context_fail(ctx, NETWORK_ERROR, error);
+		zbx_free(error);
+		return;
+	}
+
+	agent_start(ctx, ai);
+	freeaddrinfo(ai);
+#endif
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agent_response_expected_len                                      *
+ *                                                                            *
+ * Purpose: validates the received response header                            *
+ *                                                                            *
+ * Parameters: ctx          - [IN] the check context                          *
+ *             expected_len - [OUT] the full response length including header *
+ *                                  or 0 if the header is not received yet    *
+ *             error        - [OUT] the error message                         *
+ *                                                                            *
+ * Return value: SUCCEED - the header is valid or not fully received yet      *
+ *               FAIL    - invalid response header                            *
+ *                                                                            *
+ ******************************************************************************/
+static int	agent_response_expected_len(const zbx_agent_context_t *ctx, size_t *expected_len, char **error)
+{
+	unsigned char	flags;
+	zbx_uint32_t	len32, reserved;
+
+	*expected_len = 0;
+
+	if (0 != strncmp(ctx->buffer, ZBX_AGENT_HEADER_DATA, MIN(ctx->buffer_offset, ZBX_AGENT_HEADER_DATA_LEN)))
+	{
+		*error = zbx_strdup(*error, "message is missing header");
+		return FAIL;
+	}
+
+	if (ZBX_AGENT_HEADER_DATA_LEN >= ctx->buffer_offset)
+		return SUCCEED;
+
+	flags = (unsigned char)ctx->buffer[ZBX_AGENT_HEADER_DATA_LEN];
+
+	if (0 == (flags & ZBX_TCP_PROTOCOL) || flags > (ZBX_TCP_PROTOCOL | ZBX_TCP_COMPRESS))
+	{
+		*error = zbx_dsprintf(*error, "message is using unsupported protocol version \"%d\"", (int)flags);
+		return FAIL;
+	}
+
+	if (ZBX_AGENT_HEADER_LEN > ctx->buffer_offset)
+		return SUCCEED;
+
+	memcpy(&len32, ctx->buffer + ZBX_AGENT_HEADER_DATA_LEN + 1, sizeof(len32));
+	len32 = zbx_letoh_uint32(len32);
+
+	memcpy(&reserved, ctx->buffer + ZBX_AGENT_HEADER_DATA_LEN + 1 + sizeof(len32), sizeof(reserved));
+	reserved = zbx_letoh_uint32(reserved);
+
+	/* compressed protocol stores uncompressed packet size in the reserved data */
+	if (ZBX_MAX_RECV_DATA_SIZE < len32 || (0 != (flags & ZBX_TCP_COMPRESS) && ZBX_MAX_RECV_DATA_SIZE < reserved))
+	{
+		*error = zbx_dsprintf(*error, "message size " ZBX_FS_UI64 " exceeds the maximum size " ZBX_FS_UI64
+				" bytes", (zbx_uint64_t)MAX(len32, reserved), (zbx_uint64_t)ZBX_MAX_RECV_DATA_SIZE);
+		return FAIL;
+	}
+
+	*expected_len = ZBX_AGENT_HEADER_LEN + len32;
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agent_process_response                                           *
+ *                                                                            *
+ * Purpose: parses the received response and finishes the check               *
+ *                                                                            *
+ ******************************************************************************/
+static void	agent_process_response(zbx_agent_context_t *ctx)
+{
+	char		*error = NULL, *data, *out = NULL;
+	size_t		expected_len, data_len;
+	zbx_uint32_t	reserved;
+	int		ret;
+
+	if (0 == ctx->buffer_offset)
+	{
+		char	empty[] = "";
+
+		agent_context_finish(ctx, zbx_agent_handle_response(empty, 0, 0, ctx->item.interface.addr,
+				&ctx->result));
+		return;
+	}
+
+	if (SUCCEED != agent_response_expected_len(ctx, &expected_len, &error))
+		goto fail;
+
+	if (0 == expected_len || ctx->buffer_offset != expected_len)
+	{
+		error = zbx_dsprintf(error, "message is %s than expected", 0 != expected_len &&
+				ctx->buffer_offset > expected_len ? "longer" : "shorter");
+		goto fail;
+	}
+
+	data = ctx->buffer + ZBX_AGENT_HEADER_LEN;
+	data_len = expected_len - ZBX_AGENT_HEADER_LEN;
+
+	if (0 != (ctx->buffer[ZBX_AGENT_HEADER_DATA_LEN] & ZBX_TCP_COMPRESS))
+	{
+		memcpy(&reserved, ctx->buffer + ZBX_AGENT_HEADER_DATA_LEN + 1 + sizeof(zbx_uint32_t),
+				sizeof(reserved));
+		data_len = zbx_letoh_uint32(reserved);
+
+		out = (char *)zbx_malloc(NULL, data_len + 1);
+
+		if (FAIL == zbx_uncompress(data, expected_len - ZBX_AGENT_HEADER_LEN, out, &data_len) ||
+				data_len != zbx_letoh_uint32(reserved))
+		{
+			error = zbx_dsprintf(error, "cannot uncompress data: %s", zbx_compress_strerror());
+			zbx_free(out);
+			goto fail;
+		}
+
+		data = out;
+	}
+
+	/* buffer has one byte reserved for terminating zero */
+	data[data_len] = '\0';
+
+	ret = zbx_agent_handle_response(data, data_len, (ssize_t)ctx->buffer_offset, ctx->item.interface.addr,
+			&ctx->result);
+	zbx_free(out);
+
+	agent_context_finish(ctx, ret);
+	return;
+fail:
+	agent_context_fail(ctx, NETWORK_ERROR, error);
+	zbx_free(error);
+}
+
+#if defined(HAVE_GNUTLS) || defined(HAVE_OPENSSL)
+/******************************************************************************
+ *                                                                            *
+ * Function: agent_tls_events                                                 *
+ *                                                                            *
+ * Purpose: converts socket events TLS connection waits for to event flags    *
+ *                                                                            *
+ ******************************************************************************/
+static short	agent_tls_events(int events)
+{
+	return 0 != (events & ZBX_TLS_POLL_READ) ? EV_READ : EV_WRITE;
+}
+#endif
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agent_write                                                      *
+ *                                                                            *
+ * Purpose: writes data to plain or TLS connection without blocking           *
+ *                                                                            *
+ * Parameters: ctx   - [IN] the check context                                 *
+ *             buf   - [IN] the data to write                                 *
+ *             len   - [IN] the data length                                   *
+ *             what  - [OUT] EV_READ or EV_WRITE if nothing was written and   *
+ *                           socket must be waited for, otherwise 0           *
+ *             error - [OUT] the error message                                *
+ *                                                                            *
+ * Return value: number of bytes written or -1 on error                       *
+ *                                                                            *
+ ******************************************************************************/
+static ssize_t	agent_write(zbx_agent_context_t *ctx, const char *buf, size_t len, short *what, char **error)
+{
+	ssize_t	n;
+
+	*what = 0;
+#if defined(HAVE_GNUTLS) || defined(HAVE_OPENSSL)
+	if (NULL != ctx->tls_ctx)
+	{
+		int	events;
+
+		if (ZBX_PROTO_ERROR == (n = zbx_tls_async_write(ctx->tls_ctx, buf, len, &events, error)))
+			return -1;
+
+		if (0 != events)
+			*what = agent_tls_events(events);
+
+		return n;
+	}
+#endif
+	if (-1 == (n = write(ctx->fd, buf, len)))
+	{
+		if (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno)
+		{
+			*what = EV_WRITE;
+			return 0;
+		}
+
+		*error = zbx_dsprintf(*error, "ZBX_TCP_WRITE() failed: %s", zbx_strerror(errno));
+	}
+
+	return n;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agent_read                                                       *
+ *                                                                            *
+ * Purpose: reads data from plain or TLS connection without blocking          *
+ *                                                                            *
+ * Parameters: ctx   - [IN] the check context                                 *
+ *             buf   - [OUT] the buffer for data                              *
+ *             len   - [IN] the buffer size                                   *
+ *             what  - [OUT] EV_READ or EV_WRITE if nothing was read and      *
+ *                           socket must be waited for, otherwise 0           *
+ *             error - [OUT] the error message                                *
+ *                                                                            *
+ * Return value: number of bytes read, 0 if connection is closed by agent or  *
+ *               socket must be waited for, -1 on error                       *
+ *                                                                            *
+ ******************************************************************************/
+static ssize_t	agent_read(zbx_agent_context_t *ctx, char *buf, size_t len, short *what, char **error)
+{
+	ssize_t	n;
+
+	*what = 0;
+#if defined(HAVE_GNUTLS) || defined(HAVE_OPENSSL)
+	if (NULL != ctx->tls_ctx)
+	{
+		int	events;
+
+		if (ZBX_PROTO_ERROR == (n = zbx_tls_async_read(ctx->tls_ctx, buf, len, &events, error)))
+			return -1;
+
+		if (0 != events)
+			*what = agent_tls_events(events);
+
+		return n;
+	}
+#endif
+	if (-1 == (n = read(ctx->fd, buf, len)))
+	{
+		if (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno)
+		{
+			*what = EV_READ;
+			return 0;
+		}
+
+		*error = zbx_dsprintf(*error, "ZBX_TCP_READ() failed: %s", zbx_strerror(errno));
+	}
+
+	return n;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agent_send                                                       *
+ *                                                                            *
+ * Purpose: sends request without blocking                                    *
+ *                                                                            *
+ ******************************************************************************/
+static void	agent_send(zbx_agent_context_t *ctx)
+{
+	ssize_t	n;
+	char	*error = NULL;
+	short	what;
+
+	while (ctx->buffer_offset < ctx->buffer_len)
+	{
+		if (-1 == (n = agent_write(ctx, ctx->buffer + ctx->buffer_offset, ctx->buffer_len - ctx->buffer_offset,
+				&what, &error)))
+		{
+			agent_context_fail(ctx, NETWORK_ERROR, error);
+			zbx_free(error);
+			return;
+		}
+
+		if (0 != what)
+		{
+			agent_context_wait(ctx, what);
+			return;
+		}
+
+		ctx->buffer_offset += (size_t)n;
+	}
+
+	zabbix_log(LOG_LEVEL_DEBUG, "Sending [%s]", ctx->item.key);
+
+	ctx->state = ZBX_AGENT_STATE_RECV;
+	ctx->buffer_offset = 0;
+	agent_context_wait(ctx, EV_READ);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agent_recv                                                       *
+ *                                                                            *
+ * Purpose: receives response without blocking                                *
+ *                                                                            *
+ ******************************************************************************/
+static void	agent_recv(zbx_agent_context_t *ctx)
+{
+	ssize_t	n;
+	size_t	expected_len = 0;
+	char	*error = NULL;
+	short	what;
+
+	while (1)
+	{
+		/* keep one byte for terminating zero */
+		if (ctx->buffer_alloc < ctx->buffer_offset + ZBX_AGENT_RECV_CHUNK + 1)
+		{
+			ctx->buffer_alloc = ctx->buffer_offset + ZBX_AGENT_RECV_CHUNK + 1;
+			ctx->buffer = (char *)zbx_realloc(ctx->buffer, ctx->buffer_alloc);
+		}
+
+		if (-1 == (n = agent_read(ctx, ctx->buffer + ctx->buffer_offset, ZBX_AGENT_RECV_CHUNK, &what, &error)))
+		{
+			agent_context_fail(ctx, NETWORK_ERROR, error);
+			zbx_free(error);
+			return;
+		}
+
+		if (0 != what)
+		{
+			agent_context_wait(ctx, what);
+			return;
+		}
+
+		if (0 == n)
+			break;
+
+		ctx->buffer_offset += (size_t)n;
+
+		if (SUCCEED != agent_response_expected_len(ctx, &expected_len, &error))
+		{
+			agent_context_fail(ctx, NETWORK_ERROR, error);
+			zbx_free(error);
+			return;
+		}
+
+		if (0 != expected_len && ctx->buffer_offset >= expected_len)
+			break;
+
+		/* allocate whole message buffer once its size is known */
+		if (0 != expected_len && ctx->buffer_alloc < expected_len + 1)
+		{
+			ctx->buffer_alloc = expected_len + 1;
+			ctx->buffer = (char *)zbx_realloc(ctx->buffer, ctx->buffer_alloc);
+		}
+	}
+
+	agent_process_response(ctx);
+}
+
+#if defined(HAVE_GNUTLS) || defined(HAVE_OPENSSL)
+/******************************************************************************
+ *                                                                            *
+ * Function: agent_handshake                                                  *
+ *                                                                            *
+ * Purpose: performs TLS handshake without blocking and starts sending        *
+ *          request when it is finished                                       *
+ *                                                                            *
+ ******************************************************************************/
+static void	agent_handshake(zbx_agent_context_t *ctx)
+{
+	char	*error = NULL, *msg;
+	int	events;
+
+	if (NULL == ctx->tls_ctx && SUCCEED != zbx_tls_async_connect(&ctx->tls_ctx, ctx->fd,
+			ctx->item.host.tls_connect, ctx->tls_arg1, ctx->tls_arg2, &error))
+	{
+		goto fail;
+	}
+
+	if (SUCCEED != zbx_tls_async_handshake(ctx->tls_ctx, ctx->item.host.tls_connect, ctx->tls_arg1,
+			ctx->tls_arg2, &events, &error))
+	{
+		goto fail;
+	}
+
+	if (0 != events)
+	{
+		agent_context_wait(ctx, agent_tls_events(events));
+		return;
+	}
+
+	ctx->state = ZBX_AGENT_STATE_SEND;
+	agent_send(ctx);
+	return;
+fail:
+	msg = zbx_dsprintf(NULL, "TCP successful, cannot establish TLS to [[%s]:%hu]: %s", ctx->item.interface.addr,
+			ctx->item.interface.port, error);
+	agent_context_fail(ctx, NETWORK_ERROR, msg);
+	zbx_free(msg);
+	zbx_free(error);
+}
+#endif
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agent_event_cb                                                   *
+ *                                                                            *
+ * Purpose: drives the check state on socket events and timeouts              *
+ *                                                                            *
+ ******************************************************************************/
+static void	agent_event_cb(evutil_socket_t fd, short what, void *arg)
+{
+	zbx_agent_context_t	*ctx = (zbx_agent_context_t *)arg;
+	int			err = 0;
+	socklen_t		err_len = sizeof(err);
+	char			*error;
+
+	ZBX_UNUSED(fd);
+
+	if (0 != (what & EV_TIMEOUT))
+	{
+		switch (ctx->state)
+		{
+#ifdef ZBX_ASYNC_AGENT_EVDNS
+			case ZBX_AGENT_STATE_RESOLVE:
+				/* the request callback finishes the check */
+				evdns_getaddrinfo_cancel(ctx->dns_req);
+				break;
+#endif
+			case ZBX_AGENT_STATE_CONNECT:
+				error = zbx_dsprintf(NULL, "cannot connect to [[%s]:%hu]: connection timed out",
+						ctx->item.interface.addr, ctx->item.interface.port);
+				agent_context_fail(ctx, NETWORK_ERROR, error);
+				zbx_free(error);
+				break;
+			case ZBX_AGENT_STATE_HANDSHAKE:
+				error = zbx_dsprintf(NULL, "TCP successful, cannot establish TLS to [[%s]:%hu]: handshake"
+						" timed out", ctx->item.interface.addr, ctx->item.interface.port);
+				agent_context_fail(ctx, NETWORK_ERROR, error);
+				zbx_free(error);
+				break;
+			case ZBX_AGENT_STATE_SEND:
+				agent_context_fail(ctx, NETWORK_ERROR, "ZBX_TCP_WRITE() timed out");
+				break;
+			default:
+				agent_context_fail(ctx, TIMEOUT_ERROR, "ZBX_TCP_READ() timed out");
+		}
+
+		return;
+	}
+
+	switch (ctx->state)
+	{
+		case ZBX_AGENT_STATE_CONNECT:
+			if (-1 == getsockopt(ctx->fd, SOL_SOCKET, SO_ERROR, &err, &err_len))
+				err = errno;
+
+			if (0 != err)
+			{
+				error = zbx_dsprintf(NULL, "cannot connect to [[%s]:%hu]: %s", ctx->item.interface.addr,
+						ctx->item.interface.port, zbx_strerror(err));
+				agent_context_fail(ctx, NETWORK_ERROR, error);
+				zbx_free(error);
+				return;
+			}
+#if defined(HAVE_GNUTLS) || defined(HAVE_OPENSSL)
+			if (ZBX_TCP_SEC_UNENCRYPTED != ctx->item.host.tls_connect)
+			{
+				ctx->state = ZBX_AGENT_STATE_HANDSHAKE;
+				agent_handshake(ctx);
+				break;
+			}
+#endif
+			ctx->state = ZBX_AGENT_STATE_SEND;
+			ZBX_FALLTHROUGH;
+		case ZBX_AGENT_STATE_SEND:
+			agent_send(ctx);
+			break;
+#if defined(HAVE_GNUTLS) || defined(HAVE_OPENSSL)
+		case ZBX_AGENT_STATE_HANDSHAKE:
+			agent_handshake(ctx);
+			break;
+#endif
+		default:
+			agent_recv(ctx);
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_async_agent_init                                             *
+ *                                                                            *
+ * Purpose: initializes passive agent checks of a poller                      *
+ *                                                                            *
+ * Parameters: agent - [OUT] the asynchronous agent checks                    *
+ *             base  - [IN] the event base of the poller                      *
+ *             error - [OUT] the error message                                *
+ *                                                                            *
+ * Return value: SUCCEED - initialized successfully                           *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ * Comments: The resolver takes name servers and hosts file from system       *
+ *           configuration once, when the poller starts. The source IP        *
+ *           address is parsed once and bound to every agent connection.      *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_async_agent_init(zbx_async_agent_t *agent, struct event_base *base, char **error)
+{
+	struct addrinfo	hints;
+
+	memset(agent, 0, sizeof(zbx_async_agent_t));
+	agent->base = base;
+
+	if (NULL != CONFIG_SOURCE_IP)
+	{
+		memset(&hints, 0, sizeof(hints));
+#ifdef HAVE_IPV6
+		hints.ai_family = PF_UNSPEC;
+#else
+		hints.ai_family = AF_INET;
+#endif
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_flags = AI_NUMERICHOST;
+
+		if (0 != getaddrinfo(CONFIG_SOURCE_IP, NULL, &hints, &agent->source_ai))
+		{
+			*error = zbx_dsprintf(*error, "invalid source IP address [%s]", CONFIG_SOURCE_IP);
+			agent->source_ai = NULL;
+			return FAIL;
+		}
+	}
+#ifdef ZBX_ASYNC_AGENT_EVDNS
+	if (NULL == (agent->dnsbase = evdns_base_new(base, EVDNS_BASE_INITIALIZE_NAMESERVERS)))
+	{
+		*error = zbx_strdup(*error, "cannot initialize nonblocking resolver");
+		zbx_async_agent_destroy(agent);
+		return FAIL;
+	}
+#endif
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_async_agent_destroy                                          *
+ *                                                                            *
+ * Purpose: releases resources of passive agent checks of a poller            *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_async_agent_destroy(zbx_async_agent_t *agent)
+{
+#ifdef ZBX_ASYNC_AGENT_EVDNS
+	if (NULL != agent->dnsbase)
+	{
+		evdns_base_free(agent->dnsbase, 1);
+		agent->dnsbase = NULL;
+	}
+#endif
+	if (NULL != agent->source_ai)
+	{
+		freeaddrinfo(agent->source_ai);
+		agent->source_ai = NULL;
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_async_check_agent                                            *
+ *                                                                            *
+ * Purpose: starts passive Zabbix agent check                                 *
+ *                                                                            *
+ * Parameters: item    - [IN] the item to check, its contents are taken over  *
+ *                            by the check                                    *
+ *             agent   - [IN] the asynchronous agent checks of the poller     *
+ *             done_cb - [IN] the callback to report item result              *
+ *             arg     - [IN] the callback argument                           *
+ *                                                                            *
+ * Comments: The done_cb callback is called exactly once, either from this    *
+ *           function or when the check finishes in the poller event loop.    *
+ *           Encrypted checks perform TLS handshake, send and receive in the  *
+ *           event loop as well, within the same check timeout.               *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_async_check_agent(DC_ITEM *item, zbx_async_agent_t *agent, zbx_async_check_done_cb_t done_cb, void *arg)
+{
+	zbx_agent_context_t	*ctx;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() host:'%s' addr:'%s' key:'%s' conn:'%s'", __func__, item->host.host,
+			item->interface.addr, item->key, zbx_tcp_connection_type_name(item->host.tls_connect));
+
+	ctx = (zbx_agent_context_t *)zbx_malloc(NULL, sizeof(zbx_agent_context_t));
+	memcpy(&ctx->item, item, sizeof(DC_ITEM));
+
+	/* the copied address points into the poller item buffer, which is reused before the check finishes */
+	ctx->item.interface.addr = (1 == ctx->item.interface.useip ? ctx->item.interface.ip_orig :
+			ctx->item.interface.dns_orig);
+
+	init_result(&ctx->result);
+	ctx->done_cb = done_cb;
+	ctx->done_arg = arg;
+	ctx->agent = agent;
+	ctx->ev = NULL;
+#ifdef ZBX_ASYNC_AGENT_EVDNS
+	ctx->dns_req = NULL;
+#endif
+	ctx->fd = -1;
+#if defined(HAVE_GNUTLS) || defined(HAVE_OPENSSL)
+	ctx->tls_ctx = NULL;
+#endif
+	ctx->state = ZBX_AGENT_STATE_RESOLVE;
+	ctx->deadline = zbx_time() + CONFIG_TIMEOUT;
+	ctx->buffer = NULL;
+	ctx->buffer_alloc = 0;
+	ctx->buffer_offset = 0;
+	ctx->buffer_len = 0;
+
+	switch (ctx->item.host.tls_connect)
+	{
+		case ZBX_TCP_SEC_UNENCRYPTED:
+			break;
+#if defined(HAVE_GNUTLS) || defined(HAVE_OPENSSL)
+		case ZBX_TCP_SEC_TLS_CERT:
+			ctx->tls_arg1 = ctx->item.host.tls_issuer;
+			ctx->tls_arg2 = ctx->item.host.tls_subject;
+			break;
+		case ZBX_TCP_SEC_TLS_PSK:
+			ctx->tls_arg1 = ctx->item.host.tls_psk_identity;
+			ctx->tls_arg2 = ctx->item.host.tls_psk;
+			break;
+#else
+		case ZBX_TCP_SEC_TLS_CERT:
+		case ZBX_TCP_SEC_TLS_PSK:
+			SET_MSG_RESULT(&ctx->result, zbx_dsprintf(NULL, "A TLS connection is configured to be used with"
+					" agent but support for TLS was not compiled into %s.",
+					get_program_type_string(program_type)));
+			agent_context_finish(ctx, CONFIG_ERROR);
+			return;
+#endif
+		default:
+			THIS_SHOULD_NEVER_HAPPEN;
+			SET_MSG_RESULT(&ctx->result, zbx_strdup(NULL, "Invalid TLS connection parameters."));
+			agent_context_finish(ctx, CONFIG_ERROR);
+			return;
+	}
+
+	agent_resolve(ctx);
+}
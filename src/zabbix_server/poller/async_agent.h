@@ -0,0 +1,51 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+
+#ifndef ZABBIX_ASYNC_AGENT_H
+#define ZABBIX_ASYNC_AGENT_H
+
+#include "async_poller.h"
+
+#if defined(LIBEVENT_VERSION_NUMBER) && LIBEVENT_VERSION_NUMBER >= 0x2000000
+#	include <event2/dns.h>
+#	define ZBX_ASYNC_AGENT_EVDNS	/* nonblocking resolver is available starting with libevent 2.0 */
+#endif
+
+extern char	*CONFIG_SOURCE_IP;
+extern int	CONFIG_TIMEOUT;
+
+/* passive agent checks of one poller sharing DNS resolver and source address */
+typedef struct
+{
+	struct event_base	*base;
+#ifdef ZBX_ASYNC_AGENT_EVDNS
+	struct evdns_base	*dnsbase;
+#endif
+	/* the parsed source IP address or NULL */
+	struct addrinfo		*source_ai;
+}
+zbx_async_agent_t;
+
+int	zbx_async_agent_init(zbx_async_agent_t *agent, struct event_base *base, char **error);
+void	zbx_async_agent_destroy(zbx_async_agent_t *agent);
+
+void	zbx_async_check_agent(DC_ITEM *item, zbx_async_agent_t *agent, zbx_async_check_done_cb_t done_cb, void *arg);
+
+#endif
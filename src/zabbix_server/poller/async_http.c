@@ -0,0 +1,394 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+
+#include "common.h"
+#include "log.h"
+
+#include "async_http.h"
+#include "checks_http.h"
+
+#ifdef HAVE_LIBCURL
+
+/* HTTP agent check in progress */
+typedef struct
+{
+	DC_ITEM				item;
+	AGENT_RESULT			result;
+	zbx_http_context_t		context;
+	zbx_async_check_done_cb_t	done_cb;
+	void				*done_arg;
+}
+zbx_http_check_t;
+
+/******************************************************************************
+ *                                                                            *
+ * Function: http_check_finish                                                *
+ *                                                                            *
+ * Purpose: releases check resources and reports the result to poller         *
+ *                                                                            *
+ * Parameters: check   - [IN] the check                                       *
+ *             errcode - [IN] the check result code                           *
+ *                                                                            *
+ * Comments: The easy handle must be removed from multi handle before.        *
+ *                                                                            *
+ ******************************************************************************/
+static void	http_check_finish(zbx_http_check_t *check, int errcode)
+{
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s() itemid:" ZBX_FS_UI64 " %s", __func__, check->item.itemid,
+			zbx_result_string(errcode));
+
+	/* request refers to item fields, so it must be freed before the item is cleaned by callback */
+	zbx_http_context_destroy(&check->context);
+
+	check->done_cb(&check->item, &check->result, errcode, check->done_arg);
+	zbx_free(check);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: http_process_finished_checks                                     *
+ *                                                                            *
+ * Purpose: reports results of the checks whose transfers are completed       *
+ *                                                                            *
+ ******************************************************************************/
+static void	http_process_finished_checks(zbx_async_http_t *http)
+{
+	CURLMsg			*msg;
+	CURL			*easyhandle;
+	CURLcode		err;
+	zbx_http_check_t	*check;
+	int			msgs_left, errcode;
+
+	while (NULL != (msg = curl_multi_info_read(http->multi_handle, &msgs_left)))
+	{
+		if (CURLMSG_DONE != msg->msg)
+			continue;
+
+		/* message is freed when its easy handle is removed */
+		easyhandle = msg->easy_handle;
+		err = msg->data.result;
+
+		if (CURLE_OK != curl_easy_getinfo(easyhandle, CURLINFO_PRIVATE, (char **)&check))
+		{
+			THIS_SHOULD_NEVER_HAPPEN;
+			continue;
+		}
+
+		curl_multi_remove_handle(http->multi_handle, easyhandle);
+
+		errcode = zbx_http_context_process_response(&check->context, &check->item, err, &check->result);
+		http_check_finish(check, errcode);
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: http_socket_event_cb                                             *
+ *                                                                            *
+ * Purpose: passes socket readiness to cURL                                   *
+ *                                                                            *
+ ******************************************************************************/
+static void	http_socket_event_cb(evutil_socket_t fd, short what, void *arg)
+{
+	zbx_async_http_t	*http = (zbx_async_http_t *)arg;
+	int			action = 0, running;
+
+	if (0 != (what & EV_READ))
+		action |= CURL_CSELECT_IN;
+
+	if (0 != (what & EV_WRITE))
+		action |= CURL_CSELECT_OUT;
+
+	curl_multi_socket_action(http->multi_handle, fd, action, &running);
+	http_process_finished_checks(http);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: http_timer_event_cb                                              *
+ *                                                                            *
+ * Purpose: lets cURL process timeouts and start queued transfers             *
+ *                                                                            *
+ ******************************************************************************/
+static void	http_timer_event_cb(evutil_socket_t fd, short what, void *arg)
+{
+	zbx_async_http_t	*http = (zbx_async_http_t *)arg;
+	int			running;
+
+	ZBX_UNUSED(fd);
+	ZBX_UNUSED(what);
+
+	curl_multi_socket_action(http->multi_handle, CURL_SOCKET_TIMEOUT, 0, &running);
+	http_process_finished_checks(http);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: http_socket_cb                                                   *
+ *                                                                            *
+ * Purpose: updates socket events requested by cURL                           *
+ *                                                                            *
+ * Parameters: easyhandle - [IN] the easy handle using the socket             *
+ *             s          - [IN] the socket                                   *
+ *             what       - [IN] the socket events to wait for (CURL_POLL_*)  *
+ *             userp      - [IN] the asynchronous HTTP checks                 *
+ *             socketp    - [IN] the socket event, NULL for new socket        *
+ *                                                                            *
+ * Return value: 0 - always                                                   *
+ *                                                                            *
+ ******************************************************************************/
+static int	http_socket_cb(CURL *easyhandle, curl_socket_t s, int what, void *userp, void *socketp)
+{
+	zbx_async_http_t	*http = (zbx_async_http_t *)userp;
+	struct event		*ev = (struct event *)socketp;
+	short			events = EV_PERSIST;
+
+	ZBX_UNUSED(easyhandle);
+
+	if (NULL != ev)
+		event_free(ev);
+
+	if (CURL_POLL_REMOVE == what)
+		return 0;
+
+	if (0 != (what & CURL_POLL_IN))
+		events |= EV_READ;
+
+	if (0 != (what & CURL_POLL_OUT))
+		events |= EV_WRITE;
+
+	ev = event_new(http->base, s, events, http_socket_event_cb, http);
+	event_add(ev, NULL);
+	curl_multi_assign(http->multi_handle, s, ev);
+
+	return 0;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: http_timer_cb                                                    *
+ *                                                                            *
+ * Purpose: schedules the timeout requested by cURL                           *
+ *                                                                            *
+ * Parameters: multi_handle - [IN] the multi handle                           *
+ *             timeout_ms   - [IN] the timeout in milliseconds, -1 to cancel  *
+ *             userp        - [IN] the asynchronous HTTP checks               *
+ *                                                                            *
+ * Return value: 0 - always                                                   *
+ *                                                                            *
+ * Comments: cURL must not be called from this callback, so even expired      *
+ *           timeout is processed in the event loop.                          *
+ *                                                                            *
+ ******************************************************************************/
+static int	http_timer_cb(CURLM *multi_handle, long timeout_ms, void *userp)
+{
+	zbx_async_http_t	*http = (zbx_async_http_t *)userp;
+	struct timeval		tv;
+
+	ZBX_UNUSED(multi_handle);
+
+	if (-1 == timeout_ms)
+	{
+		evtimer_del(http->timer);
+		return 0;
+	}
+
+	tv.tv_sec = timeout_ms / 1000;
+	tv.tv_usec = (timeout_ms % 1000) * 1000;
+	evtimer_add(http->timer, &tv);
+
+	return 0;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_async_http_init                                              *
+ *                                                                            *
+ * Purpose: initializes asynchronous HTTP agent checks of a poller            *
+ *                                                                            *
+ * Parameters: http  - [OUT] the asynchronous HTTP checks                     *
+ *             base  - [IN] the event base of the poller                      *
+ *             error - [OUT] the error message                                *
+ *                                                                            *
+ * Return value: SUCCEED - initialized successfully                           *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ * Comments: Connections are kept in the multi handle connection cache and    *
+ *           reused by later checks of the same host. Resolved addresses and  *
+ *           SSL sessions are shared between easy handles through the share   *
+ *           handle, so new connections to known hosts skip DNS lookup and    *
+ *           full TLS handshake.                                              *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_async_http_init(zbx_async_http_t *http, struct event_base *base, char **error)
+{
+	CURLSHcode	sh_err;
+	CURLMcode	m_err;
+
+	memset(http, 0, sizeof(zbx_async_http_t));
+
+	if (0 != curl_global_init(CURL_GLOBAL_ALL))
+	{
+		*error = zbx_strdup(*error, "Cannot initialize cURL library");
+		return FAIL;
+	}
+
+	if (NULL == (http->share_handle = curl_share_init()))
+	{
+		*error = zbx_strdup(*error, "Cannot initialize cURL share handle");
+		goto out;
+	}
+
+	if (CURLSHE_OK != (sh_err = curl_share_setopt(http->share_handle, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS)))
+	{
+		*error = zbx_dsprintf(*error, "Cannot share DNS cache: %s", curl_share_strerror(sh_err));
+		goto out;
+	}
+
+#if LIBCURL_VERSION_NUM >= 0x071700
+	/* sharing SSL sessions is supported starting with version 7.23.0 (0x071700) */
+	if (CURLSHE_OK != (sh_err = curl_share_setopt(http->share_handle, CURLSHOPT_SHARE,
+			CURL_LOCK_DATA_SSL_SESSION)))
+	{
+		*error = zbx_dsprintf(*error, "Cannot share SSL session cache: %s", curl_share_strerror(sh_err));
+		goto out;
+	}
+#endif
+
+	if (NULL == (http->multi_handle = curl_multi_init()))
+	{
+		*error = zbx_strdup(*error, "Cannot initialize cURL multi handle");
+		goto out;
+	}
+
+	if (CURLM_OK != (m_err = curl_multi_setopt(http->multi_handle, CURLMOPT_SOCKETFUNCTION, http_socket_cb)) ||
+			CURLM_OK != (m_err = curl_multi_setopt(http->multi_handle, CURLMOPT_SOCKETDATA, http)) ||
+			CURLM_OK != (m_err = curl_multi_setopt(http->multi_handle, CURLMOPT_TIMERFUNCTION,
+			http_timer_cb)) ||
+			CURLM_OK != (m_err = curl_multi_setopt(http->multi_handle, CURLMOPT_TIMERDATA, http)))
+	{
+		*error = zbx_dsprintf(*error, "Cannot set cURL multi handle callbacks: %s", curl_multi_strerror(m_err));
+		goto out;
+	}
+
+	/* by default connection cache shrinks with the number of transfers in progress, */
+	/* keep idle connections of all hosts polled between checks                      */
+	if (CURLM_OK != (m_err = curl_multi_setopt(http->multi_handle, CURLMOPT_MAXCONNECTS,
+			(long)CONFIG_MAX_CONCURRENT_CHECKS_PER_POLLER)))
+	{
+		*error = zbx_dsprintf(*error, "Cannot set connection cache size: %s", curl_multi_strerror(m_err));
+		goto out;
+	}
+
+	http->base = base;
+	http->timer = event_new(base, -1, 0, http_timer_event_cb, http);
+
+	return SUCCEED;
+out:
+	zbx_async_http_destroy(http);
+
+	return FAIL;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_async_http_destroy                                           *
+ *                                                                            *
+ * Purpose: frees resources of asynchronous HTTP agent checks                 *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_async_http_destroy(zbx_async_http_t *http)
+{
+	if (NULL != http->timer)
+		event_free(http->timer);
+
+	if (NULL != http->multi_handle)
+		curl_multi_cleanup(http->multi_handle);
+
+	if (NULL != http->share_handle)
+		curl_share_cleanup(http->share_handle);
+
+	memset(http, 0, sizeof(zbx_async_http_t));
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_async_check_http                                             *
+ *                                                                            *
+ * Purpose: starts HTTP agent check                                           *
+ *                                                                            *
+ * Parameters: item    - [IN] the item to check, its contents are taken over  *
+ *                            by the check                                    *
+ *             http    - [IN] the asynchronous HTTP checks of the poller      *
+ *             done_cb - [IN] the callback to report item result              *
+ *             arg     - [IN] the callback argument                           *
+ *                                                                            *
+ * Comments: The done_cb callback is called exactly once, either from this    *
+ *           function or when the transfer finishes in the poller event loop. *
+ *           The request is the same as performed by get_value_http().        *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_async_check_http(DC_ITEM *item, zbx_async_http_t *http, zbx_async_check_done_cb_t done_cb, void *arg)
+{
+	zbx_http_check_t	*check;
+	CURLcode		err;
+	CURLMcode		m_err;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() itemid:" ZBX_FS_UI64 " URL '%s%s'", __func__, item->itemid,
+			item->url, item->query_fields);
+
+	check = (zbx_http_check_t *)zbx_malloc(NULL, sizeof(zbx_http_check_t));
+	memcpy(&check->item, item, sizeof(DC_ITEM));
+	init_result(&check->result);
+	zbx_http_context_init(&check->context);
+	check->done_cb = done_cb;
+	check->done_arg = arg;
+
+	if (SUCCEED != zbx_http_context_prepare(&check->context, &check->item, &check->result))
+		goto fail;
+
+	if (CURLE_OK != (err = curl_easy_setopt(check->context.easyhandle, CURLOPT_SHARE, http->share_handle)))
+	{
+		SET_MSG_RESULT(&check->result, zbx_dsprintf(NULL, "Cannot set share handle: %s",
+				curl_easy_strerror(err)));
+		goto fail;
+	}
+
+	if (CURLE_OK != (err = curl_easy_setopt(check->context.easyhandle, CURLOPT_PRIVATE, check)))
+	{
+		SET_MSG_RESULT(&check->result, zbx_dsprintf(NULL, "Cannot set private data: %s",
+				curl_easy_strerror(err)));
+		goto fail;
+	}
+
+	/* the transfer is started by timeout callback from the event loop */
+	if (CURLM_OK != (m_err = curl_multi_add_handle(http->multi_handle, check->context.easyhandle)))
+	{
+		SET_MSG_RESULT(&check->result, zbx_dsprintf(NULL, "Cannot start request: %s",
+				curl_multi_strerror(m_err)));
+		goto fail;
+	}
+
+	return;
+fail:
+	http_check_finish(check, NOTSUPPORTED);
+}
+
+#endif
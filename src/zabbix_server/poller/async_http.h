@@ -0,0 +1,45 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+
+#ifndef ZABBIX_ASYNC_HTTP_H
+#define ZABBIX_ASYNC_HTTP_H
+
+#include "async_poller.h"
+
+#ifdef HAVE_LIBCURL
+
+/* HTTP agent checks of one poller sharing connection, DNS and SSL session caches */
+typedef struct
+{
+	CURLM			*multi_handle;
+	CURLSH			*share_handle;
+	struct event_base	*base;
+	struct event		*timer;
+}
+zbx_async_http_t;
+
+int	zbx_async_http_init(zbx_async_http_t *http, struct event_base *base, char **error);
+void	zbx_async_http_destroy(zbx_async_http_t *http);
+
+void	zbx_async_check_http(DC_ITEM *item, zbx_async_http_t *http, zbx_async_check_done_cb_t done_cb, void *arg);
+
+#endif
+
+#endif
@@ -0,0 +1,505 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+
+#include "common.h"
+
+#include "dbcache.h"
+#include "daemon.h"
+#include "zbxself.h"
+#include "zbxserver.h"
+#include "preproc.h"
+#include "log.h"
+#include "zbxavailability.h"
+#include "zbxcrypto.h"
+
+#include "async_poller.h"
+#include "async_agent.h"
+#include "async_http.h"
+#include "checks_snmp.h"
+#include "poller.h"
+
+extern unsigned char	process_type, program_type;
+extern int		server_num, process_num;
+
+#ifdef HAVE_NETSNMP
+static volatile sig_atomic_t	snmp_cache_reload_requested;
+#endif
+
+#if !defined(LIBEVENT_VERSION_NUMBER) || LIBEVENT_VERSION_NUMBER < 0x2000000
+struct event	*event_new(struct event_base *ev, evutil_socket_t fd, short what,
+		void(*cb_func)(int, short, void *), void *cb_arg)
+{
+	struct event	*event;
+
+	event = zbx_malloc(NULL, sizeof(struct event));
+	event_set(event, fd, what, cb_func, cb_arg);
+	event_base_set(ev, event);
+
+	return event;
+}
+
+void	event_free(struct event *event)
+{
+	event_del(event);
+	zbx_free(event);
+}
+#endif
+
+/* the last availability state set by finished checks of interface */
+typedef struct
+{
+	zbx_uint64_t	interfaceid;
+	int		available;
+}
+zbx_async_interface_t;
+
+typedef struct
+{
+	struct event_base	*base;
+	unsigned char		poller_type;
+
+	/* the number of checks in progress */
+	int			checks_num;
+
+	/* the number of finished checks since the last process title update */
+	int			processed;
+
+	int			nextcheck;
+
+	/* finished items to be returned to queue */
+	zbx_uint64_t		*itemids;
+	int			*errcodes;
+	int			*lastclocks;
+	int			requeue_num;
+
+	/* serialized interface availability changes */
+	unsigned char		*data;
+	size_t			data_alloc;
+	size_t			data_offset;
+
+	/* the last availability states set by finished checks, reduce interface updates */
+	zbx_hashset_t		interfaces;
+
+	/* passive agent checks sharing resolver of the poller */
+	zbx_async_agent_t	agent;
+#ifdef HAVE_LIBCURL
+	/* HTTP agent checks sharing connections of the poller */
+	zbx_async_http_t	http;
+#endif
+}
+zbx_async_poller_t;
+
+/******************************************************************************
+ *                                                                            *
+ * Function: async_poller_requeue                                             *
+ *                                                                            *
+ * Purpose: returns finished items to queue and flushes collected data        *
+ *                                                                            *
+ ******************************************************************************/
+static void	async_poller_requeue(zbx_async_poller_t *poller)
+{
+	if (0 != poller->requeue_num)
+	{
+		DCpoller_requeue_items(poller->itemids, poller->lastclocks, poller->errcodes,
+				(size_t)poller->requeue_num, poller->poller_type, &poller->nextcheck);
+		poller->requeue_num = 0;
+
+		zbx_preprocessor_flush();
+	}
+
+	if (0 != poller->data_offset)
+	{
+		zbx_availability_flush(poller->data, poller->data_offset);
+		poller->data_offset = 0;
+	}
+
+	zbx_hashset_clear(&poller->interfaces);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: async_poller_get_interface                                       *
+ *                                                                            *
+ * Purpose: gets the last availability state set by finished checks of       *
+ *          interface since items were returned to queue                      *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_async_interface_t	*async_poller_get_interface(zbx_async_poller_t *poller, zbx_uint64_t interfaceid)
+{
+	zbx_async_interface_t	*interface, interface_local;
+
+	if (NULL == (interface = (zbx_async_interface_t *)zbx_hashset_search(&poller->interfaces, &interfaceid)))
+	{
+		interface_local.interfaceid = interfaceid;
+		interface_local.available = INTERFACE_AVAILABLE_UNKNOWN;
+		interface = (zbx_async_interface_t *)zbx_hashset_insert(&poller->interfaces, &interface_local,
+				sizeof(interface_local));
+	}
+
+	return interface;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: async_check_done_cb                                              *
+ *                                                                            *
+ * Purpose: processes the result of finished check                            *
+ *                                                                            *
+ * Parameters: item    - [IN/OUT] the checked item                            *
+ *             result  - [IN] the check result                                *
+ *             errcode - [IN] the check result code                           *
+ *             arg     - [IN] the poller                                      *
+ *                                                                            *
+ ******************************************************************************/
+static void	async_check_done_cb(DC_ITEM *item, AGENT_RESULT *result, int errcode, void *arg)
+{
+	zbx_async_poller_t	*poller = (zbx_async_poller_t *)arg;
+	zbx_async_interface_t	*interface;
+	zbx_timespec_t		timespec;
+
+	zbx_timespec(&timespec);
+
+	switch (errcode)
+	{
+		case SUCCEED:
+		case NOTSUPPORTED:
+		case AGENT_ERROR:
+			interface = async_poller_get_interface(poller, item->interface.interfaceid);
+
+			if (INTERFACE_AVAILABLE_TRUE != interface->available)
+			{
+				zbx_activate_item_interface(&timespec, item, &poller->data, &poller->data_alloc,
+						&poller->data_offset);
+				interface->available = INTERFACE_AVAILABLE_TRUE;
+			}
+			break;
+		case NETWORK_ERROR:
+		case GATEWAY_ERROR:
+		case TIMEOUT_ERROR:
+			/* every failure is counted towards interface unreachability */
+			zbx_deactivate_item_interface(&timespec, item, &poller->data, &poller->data_alloc,
+					&poller->data_offset, result->msg);
+			async_poller_get_interface(poller, item->interface.interfaceid)->available =
+					INTERFACE_AVAILABLE_FALSE;
+			break;
+		case CONFIG_ERROR:
+			/* nothing to do */
+			break;
+		default:
+			zbx_error("unknown response code returned: %d", errcode);
+			THIS_SHOULD_NEVER_HAPPEN;
+	}
+
+	if (SUCCEED == errcode)
+	{
+		item->state = ITEM_STATE_NORMAL;
+		zbx_preprocess_item_value(item->itemid, item->host.hostid, item->value_type, item->flags, result,
+				&timespec, item->state, NULL);
+	}
+	else if (NOTSUPPORTED == errcode || AGENT_ERROR == errcode || CONFIG_ERROR == errcode)
+	{
+		item->state = ITEM_STATE_NOTSUPPORTED;
+		zbx_preprocess_item_value(item->itemid, item->host.hostid, item->value_type, item->flags, NULL,
+				&timespec, item->state, result->msg);
+	}
+
+	poller->itemids[poller->requeue_num] = item->itemid;
+	poller->errcodes[poller->requeue_num] = errcode;
+	poller->lastclocks[poller->requeue_num] = timespec.sec;
+
+	if (CONFIG_MAX_CONCURRENT_CHECKS_PER_POLLER == ++poller->requeue_num)
+		async_poller_requeue(poller);
+
+	zbx_clean_items(item, 1, result);
+	DCconfig_clean_items(item, NULL, 1);
+
+	poller->checks_num--;
+	poller->processed++;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: async_poller_start_checks                                        *
+ *                                                                            *
+ * Purpose: takes due items from queue and starts their checks                *
+ *                                                                            *
+ * Parameters: poller - [IN] the poller                                       *
+ *             items  - [IN] the buffer for MAX_POLLER_ITEMS items            *
+ *                                                                            *
+ * Comments: Items are taken in chunks until all check slots are used or      *
+ *           there are no more due items. SNMP items are returned in batches  *
+ *           of one interface and are checked by a single request.           *
+ *                                                                            *
+ ******************************************************************************/
+static void	async_poller_start_checks(zbx_async_poller_t *poller, DC_ITEM *items)
+{
+	AGENT_RESULT	results[MAX_POLLER_ITEMS];
+	int		errcodes[MAX_POLLER_ITEMS];
+	int		i, num, items_num;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() checks:%d", __func__, poller->checks_num);
+
+	do
+	{
+		if (0 == (items_num = CONFIG_MAX_CONCURRENT_CHECKS_PER_POLLER - poller->checks_num))
+			break;
+
+		if (MAX_POLLER_ITEMS < items_num)
+			items_num = MAX_POLLER_ITEMS;
+
+		if (0 == (num = DCconfig_get_async_poller_items(poller->poller_type, (int)time(NULL), items,
+				items_num, &poller->nextcheck)))
+		{
+			break;
+		}
+
+		zbx_prepare_items(items, errcodes, num, results, MACRO_EXPAND_YES);
+
+		poller->checks_num += num;
+#ifdef HAVE_NETSNMP
+		if (ZBX_POLLER_TYPE_SNMP == poller->poller_type)
+		{
+			/* check takes over the items, results and error codes of the whole batch */
+			zbx_async_check_snmp(items, results, errcodes, num, poller->base, async_check_done_cb, poller);
+			continue;
+		}
+#endif
+		for (i = 0; i < num; i++)
+		{
+			if (SUCCEED != errcodes[i])
+			{
+				async_check_done_cb(&items[i], &results[i], errcodes[i], poller);
+				continue;
+			}
+
+			/* check takes over the item, its result is initialized by check */
+			free_result(&results[i]);
+#ifdef HAVE_LIBCURL
+			if (ZBX_POLLER_TYPE_HTTPAGENT == poller->poller_type)
+			{
+				zbx_async_check_http(&items[i], &poller->http, async_check_done_cb, poller);
+				continue;
+			}
+#endif
+			zbx_async_check_agent(&items[i], &poller->agent, async_check_done_cb, poller);
+		}
+	}
+	while (num == items_num || ZBX_POLLER_TYPE_SNMP == poller->poller_type);
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s() checks:%d", __func__, poller->checks_num);
+}
+
+static void	async_poller_sigusr_handler(int flags)
+{
+#ifdef HAVE_NETSNMP
+	if (ZBX_RTC_SNMP_CACHE_RELOAD == ZBX_RTC_GET_MSG(flags))
+		snmp_cache_reload_requested = 1;
+#else
+	ZBX_UNUSED(flags);
+#endif
+}
+
+static void	async_poller_timer_cb(evutil_socket_t fd, short what, void *arg)
+{
+	ZBX_UNUSED(fd);
+	ZBX_UNUSED(what);
+	ZBX_UNUSED(arg);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: async_poller_thread                                              *
+ *                                                                            *
+ * Purpose: polls items with many checks in progress at the same time         *
+ *                                                                            *
+ * Comments: Unlike regular pollers, which wait for every item in turn, the   *
+ *           asynchronous poller starts checks on nonblocking sockets and     *
+ *           processes their results as they arrive, keeping up to            *
+ *           MaxConcurrentChecksPerPoller checks in progress.                 *
+ *                                                                            *
+ ******************************************************************************/
+ZBX_THREAD_ENTRY(async_poller_thread, args)
+{
+	zbx_async_poller_t	poller;
+	DC_ITEM			*items;
+	struct event		*timer;
+	struct timeval		tv;
+	int			sleeptime = -1, old_processed = 0;
+	double			sec, total_sec = 0.0, old_total_sec = 0.0;
+	time_t			last_stat_time;
+
+#define	STAT_INTERVAL	5	/* if a process is busy and does not sleep then update status not faster than */
+				/* once in STAT_INTERVAL seconds */
+
+	memset(&poller, 0, sizeof(poller));
+	poller.poller_type = *(unsigned char *)((zbx_thread_args_t *)args)->args;
+	process_type = ((zbx_thread_args_t *)args)->process_type;
+	server_num = ((zbx_thread_args_t *)args)->server_num;
+	process_num = ((zbx_thread_args_t *)args)->process_num;
+
+	zabbix_log(LOG_LEVEL_INFORMATION, "%s #%d started [%s #%d]", get_program_type_string(program_type),
+			server_num, get_process_type_string(process_type), process_num);
+
+	update_selfmon_counter(ZBX_PROCESS_STATE_BUSY);
+
+#if defined(HAVE_GNUTLS) || defined(HAVE_OPENSSL)
+	zbx_tls_init_child();
+#endif
+	zbx_setproctitle("%s #%d started", get_process_type_string(process_type), process_num);
+	last_stat_time = time(NULL);
+
+	if (NULL == (poller.base = event_base_new()))
+	{
+		zabbix_log(LOG_LEVEL_CRIT, "cannot initialize event base");
+		exit(EXIT_FAILURE);
+	}
+
+	if (ZBX_POLLER_TYPE_AGENT == poller.poller_type)
+	{
+		char	*error = NULL;
+
+		if (SUCCEED != zbx_async_agent_init(&poller.agent, poller.base, &error))
+		{
+			zabbix_log(LOG_LEVEL_CRIT, "cannot initialize agent checks: %s", error);
+			zbx_free(error);
+			exit(EXIT_FAILURE);
+		}
+	}
+#ifdef HAVE_LIBCURL
+	if (ZBX_POLLER_TYPE_HTTPAGENT == poller.poller_type)
+	{
+		char	*error = NULL;
+
+		if (SUCCEED != zbx_async_http_init(&poller.http, poller.base, &error))
+		{
+			zabbix_log(LOG_LEVEL_CRIT, "cannot initialize HTTP agent checks: %s", error);
+			zbx_free(error);
+			exit(EXIT_FAILURE);
+		}
+	}
+#endif
+
+	timer = event_new(poller.base, -1, 0, async_poller_timer_cb, NULL);
+
+	poller.nextcheck = FAIL;
+	zbx_hashset_create(&poller.interfaces, 100, ZBX_DEFAULT_UINT64_HASH_FUNC, ZBX_DEFAULT_UINT64_COMPARE_FUNC);
+	poller.itemids = (zbx_uint64_t *)zbx_malloc(NULL, sizeof(zbx_uint64_t) *
+			CONFIG_MAX_CONCURRENT_CHECKS_PER_POLLER);
+	poller.errcodes = (int *)zbx_malloc(NULL, sizeof(int) * CONFIG_MAX_CONCURRENT_CHECKS_PER_POLLER);
+	poller.lastclocks = (int *)zbx_malloc(NULL, sizeof(int) * CONFIG_MAX_CONCURRENT_CHECKS_PER_POLLER);
+	items = (DC_ITEM *)zbx_malloc(NULL, sizeof(DC_ITEM) * MAX_POLLER_ITEMS);
+
+	zbx_set_sigusr_handler(async_poller_sigusr_handler);
+
+	while (ZBX_IS_RUNNING())
+	{
+		sec = zbx_time();
+		zbx_update_env(sec);
+
+		if (0 != sleeptime)
+		{
+			zbx_setproctitle("%s #%d [got %d values in " ZBX_FS_DBL " sec, getting values]",
+					get_process_type_string(process_type), process_num, old_processed,
+					old_total_sec);
+		}
+
+#ifdef HAVE_NETSNMP
+		/* SNMP library can be reinitialized only when there are no sessions in progress */
+		if (1 == snmp_cache_reload_requested && 0 == poller.checks_num)
+		{
+			zbx_clear_cache_snmp(process_type, process_num);
+			snmp_cache_reload_requested = 0;
+		}
+
+		if (0 == snmp_cache_reload_requested)
+#endif
+			async_poller_start_checks(&poller, items);
+
+		/* wait for check events when all check slots are used, they are limited by timeout */
+		if (poller.checks_num < CONFIG_MAX_CONCURRENT_CHECKS_PER_POLLER)
+			sleeptime = calculate_sleeptime(poller.nextcheck, POLLER_DELAY);
+		else
+			sleeptime = POLLER_DELAY;
+
+		if (0 != sleeptime)
+		{
+			tv.tv_sec = sleeptime;
+			tv.tv_usec = 0;
+			evtimer_add(timer, &tv);
+
+			total_sec += zbx_time() - sec;
+
+			update_selfmon_counter(ZBX_PROCESS_STATE_IDLE);
+			event_base_loop(poller.base, EVLOOP_ONCE);
+			update_selfmon_counter(ZBX_PROCESS_STATE_BUSY);
+
+			sec = zbx_time();
+			evtimer_del(timer);
+		}
+
+		/* process finished checks without waiting */
+		event_base_loop(poller.base, EVLOOP_NONBLOCK);
+
+		async_poller_requeue(&poller);
+		total_sec += zbx_time() - sec;
+
+		if (0 != sleeptime || STAT_INTERVAL <= time(NULL) - last_stat_time)
+		{
+			if (0 == sleeptime)
+			{
+				zbx_setproctitle("%s #%d [got %d values in " ZBX_FS_DBL " sec, getting values]",
+					get_process_type_string(process_type), process_num, poller.processed,
+					total_sec);
+			}
+			else
+			{
+				zbx_setproctitle("%s #%d [got %d values in " ZBX_FS_DBL " sec, idle %d sec,"
+						" %d checks in progress]", get_process_type_string(process_type),
+						process_num, poller.processed, total_sec, sleeptime, poller.checks_num);
+				old_processed = poller.processed;
+				old_total_sec = total_sec;
+			}
+			poller.processed = 0;
+			total_sec = 0.0;
+			last_stat_time = time(NULL);
+		}
+	}
+
+	zbx_free(items);
+	zbx_free(poller.lastclocks);
+	zbx_free(poller.errcodes);
+	zbx_free(poller.itemids);
+	zbx_free(poller.data);
+	zbx_hashset_destroy(&poller.interfaces);
+
+	if (ZBX_POLLER_TYPE_AGENT == poller.poller_type)
+		zbx_async_agent_destroy(&poller.agent);
+#ifdef HAVE_LIBCURL
+	if (ZBX_POLLER_TYPE_HTTPAGENT == poller.poller_type)
+		zbx_async_http_destroy(&poller.http);
+#endif
+	event_free(timer);
+
+	zbx_setproctitle("%s #%d [terminated]", get_process_type_string(process_type), process_num);
+
+	while (1)
+		zbx_sleep(SEC_PER_MIN);
+#undef STAT_INTERVAL
+}
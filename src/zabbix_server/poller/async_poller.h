@@ -0,0 +1,46 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+
+#ifndef ZABBIX_ASYNC_POLLER_H
+#define ZABBIX_ASYNC_POLLER_H
+
+#include <event.h>
+
+#include "threads.h"
+#include "dbcache.h"
+#include "sysinfo.h"
+
+extern int	CONFIG_MAX_CONCURRENT_CHECKS_PER_POLLER;
+
+#if !defined(LIBEVENT_VERSION_NUMBER) || LIBEVENT_VERSION_NUMBER < 0x2000000
+typedef int evutil_socket_t;
+
+struct event	*event_new(struct event_base *ev, evutil_socket_t fd, short what,
+		void(*cb_func)(int, short, void *), void *cb_arg);
+void	event_free(struct event *event);
+#endif
+
+/* Called by asynchronous checks when the item value is retrieved or the check has failed. */
+/* The item and result are cleaned by the callback and must not be used afterwards.        */
+typedef void	(*zbx_async_check_done_cb_t)(DC_ITEM *item, AGENT_RESULT *result, int errcode, void *arg);
+
+ZBX_THREAD_ENTRY(async_poller_thread, args);
+
+#endif
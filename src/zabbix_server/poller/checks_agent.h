@@ -26,5 +26,7 @@
 extern char	*CONFIG_SOURCE_IP;
 
 int	get_value_agent(const DC_ITEM *item, AGENT_RESULT *result);
+int	zbx_agent_handle_response(char *buffer, size_t read_bytes, ssize_t received_len, const char *addr,
+		AGENT_RESULT *result);
 
 #endif
@@ -176,6 +176,10 @@ int	zbx_get_value_internal_ext(const char *param1, const AGENT_REQUEST *request,
 				SET_UI64_RESULT(result, stats.misses);
 			else if (0 == strcmp(param3, "mode"))
 				SET_UI64_RESULT(result, stats.mode);
+			else if (0 == strcmp(param3, "packed_values"))
+				SET_UI64_RESULT(result, stats.packed_values);
+			else if (0 == strcmp(param3, "packed_size"))
+				SET_UI64_RESULT(result, stats.packed_size);
 			else
 			{
 				SET_MSG_RESULT(result, zbx_strdup(NULL, "Invalid third parameter."));
@@ -452,17 +452,33 @@ static int	zbx_get_snmp_response_error(const struct snmp_session *ss, const DC_I
 	return ret;
 }
 
-static struct snmp_session	*zbx_snmp_open_session(const DC_ITEM *item, char *error, size_t max_error_len)
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_snmp_init_session                                            *
+ *                                                                            *
+ * Purpose: fills SNMP session parameters of the item interface               *
+ *                                                                            *
+ * Parameters: item          - [IN] the item                                  *
+ *             session       - [OUT] the session parameters                   *
+ *             addr          - [OUT] the buffer for peer name, referenced by  *
+ *                                   session                                  *
+ *             addr_len      - [IN] the peer name buffer size                 *
+ *             error         - [OUT] the error message                        *
+ *             max_error_len - [IN] the error message buffer size             *
+ *                                                                            *
+ * Return value: SUCCEED - the session parameters were set                    *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+static int	zbx_snmp_init_session(const DC_ITEM *item, struct snmp_session *session, char *addr, size_t addr_len,
+		char *error, size_t max_error_len)
 {
-	struct snmp_session	session, *ss = NULL;
-	char			addr[128];
+	int	ret = FAIL;
 #ifdef HAVE_IPV6
-	int			family;
+	int	family;
 #endif
 
-	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
-
-	snmp_sess_init(&session);
+	snmp_sess_init(session);
 
 	/* Allow using sub-OIDs higher than MAX_INT, like in 'snmpwalk -Ir'. */
 	/* Disables the validation of varbind values against the MIB definition for the relevant OID. */
@@ -476,167 +492,167 @@ static struct snmp_session	*zbx_snmp_open_session(const DC_ITEM *item, char *err
 	switch (item->snmp_version)
 	{
 		case ZBX_IF_SNMP_VERSION_1:
-			session.version = SNMP_VERSION_1;
+			session->version = SNMP_VERSION_1;
 			break;
 		case ZBX_IF_SNMP_VERSION_2:
-			session.version = SNMP_VERSION_2c;
+			session->version = SNMP_VERSION_2c;
 			break;
 		case ZBX_IF_SNMP_VERSION_3:
-			session.version = SNMP_VERSION_3;
+			session->version = SNMP_VERSION_3;
 			break;
 		default:
 			THIS_SHOULD_NEVER_HAPPEN;
 			break;
 	}
 
-	session.timeout = CONFIG_TIMEOUT * 1000 * 1000;	/* timeout of one attempt in microseconds */
-							/* (net-snmp default = 1 second) */
+	session->timeout = CONFIG_TIMEOUT * 1000 * 1000;	/* timeout of one attempt in microseconds */
+								/* (net-snmp default = 1 second) */
 
 #ifdef HAVE_IPV6
 	if (SUCCEED != get_address_family(item->interface.addr, &family, error, max_error_len))
-		goto end;
+		goto out;
 
 	if (PF_INET == family)
 	{
-		zbx_snprintf(addr, sizeof(addr), "%s:%hu", item->interface.addr, item->interface.port);
+		zbx_snprintf(addr, addr_len, "%s:%hu", item->interface.addr, item->interface.port);
 	}
 	else
 	{
 		if (item->interface.useip)
-			zbx_snprintf(addr, sizeof(addr), "udp6:[%s]:%hu", item->interface.addr, item->interface.port);
+			zbx_snprintf(addr, addr_len, "udp6:[%s]:%hu", item->interface.addr, item->interface.port);
 		else
-			zbx_snprintf(addr, sizeof(addr), "udp6:%s:%hu", item->interface.addr, item->interface.port);
+			zbx_snprintf(addr, addr_len, "udp6:%s:%hu", item->interface.addr, item->interface.port);
 	}
 #else
-	zbx_snprintf(addr, sizeof(addr), "%s:%hu", item->interface.addr, item->interface.port);
+	zbx_snprintf(addr, addr_len, "%s:%hu", item->interface.addr, item->interface.port);
 #endif
-	session.peername = addr;
+	session->peername = addr;
 
-	if (SNMP_VERSION_1 == session.version || SNMP_VERSION_2c == session.version)
+	if (SNMP_VERSION_1 == session->version || SNMP_VERSION_2c == session->version)
 	{
-		session.community = (u_char *)item->snmp_community;
-		session.community_len = strlen((char *)session.community);
-		zabbix_log(LOG_LEVEL_DEBUG, "SNMP [%s@%s]", session.community, session.peername);
+		session->community = (u_char *)item->snmp_community;
+		session->community_len = strlen((char *)session->community);
+		zabbix_log(LOG_LEVEL_DEBUG, "SNMP [%s@%s]", session->community, session->peername);
 	}
-	else if (SNMP_VERSION_3 == session.version)
+	else if (SNMP_VERSION_3 == session->version)
 	{
 		/* set the SNMPv3 user name */
-		session.securityName = item->snmpv3_securityname;
-		session.securityNameLen = strlen(session.securityName);
+		session->securityName = item->snmpv3_securityname;
+		session->securityNameLen = strlen(session->securityName);
 
 		/* set the SNMPv3 context if specified */
 		if ('\0' != *item->snmpv3_contextname)
 		{
-			session.contextName = item->snmpv3_contextname;
-			session.contextNameLen = strlen(session.contextName);
+			session->contextName = item->snmpv3_contextname;
+			session->contextNameLen = strlen(session->contextName);
 		}
 
 		/* set the security level to authenticated, but not encrypted */
 		switch (item->snmpv3_securitylevel)
 		{
 			case ITEM_SNMPV3_SECURITYLEVEL_NOAUTHNOPRIV:
-				session.securityLevel = SNMP_SEC_LEVEL_NOAUTH;
+				session->securityLevel = SNMP_SEC_LEVEL_NOAUTH;
 				break;
 			case ITEM_SNMPV3_SECURITYLEVEL_AUTHNOPRIV:
-				session.securityLevel = SNMP_SEC_LEVEL_AUTHNOPRIV;
+				session->securityLevel = SNMP_SEC_LEVEL_AUTHNOPRIV;
 
-				if (FAIL == zbx_snmpv3_set_auth_protocol(item, &session))
+				if (FAIL == zbx_snmpv3_set_auth_protocol(item, session))
 				{
 					zbx_snprintf(error, max_error_len, "Unsupported authentication protocol [%d]",
 							item->snmpv3_authprotocol);
-					goto end;
+					goto out;
 				}
 
-				session.securityAuthKeyLen = USM_AUTH_KU_LEN;
+				session->securityAuthKeyLen = USM_AUTH_KU_LEN;
 
-				if (SNMPERR_SUCCESS != generate_Ku(session.securityAuthProto,
-						session.securityAuthProtoLen, (u_char *)item->snmpv3_authpassphrase,
-						strlen(item->snmpv3_authpassphrase), session.securityAuthKey,
-						&session.securityAuthKeyLen))
+				if (SNMPERR_SUCCESS != generate_Ku(session->securityAuthProto,
+						session->securityAuthProtoLen, (u_char *)item->snmpv3_authpassphrase,
+						strlen(item->snmpv3_authpassphrase), session->securityAuthKey,
+						&session->securityAuthKeyLen))
 				{
 					zbx_strlcpy(error, "Error generating Ku from authentication pass phrase",
 							max_error_len);
-					goto end;
+					goto out;
 				}
 				break;
 			case ITEM_SNMPV3_SECURITYLEVEL_AUTHPRIV:
-				session.securityLevel = SNMP_SEC_LEVEL_AUTHPRIV;
+				session->securityLevel = SNMP_SEC_LEVEL_AUTHPRIV;
 
-				if (FAIL == zbx_snmpv3_set_auth_protocol(item, &session))
+				if (FAIL == zbx_snmpv3_set_auth_protocol(item, session))
 				{
 					zbx_snprintf(error, max_error_len, "Unsupported authentication protocol [%d]",
 							item->snmpv3_authprotocol);
-					goto end;
+					goto out;
 				}
 
-				session.securityAuthKeyLen = USM_AUTH_KU_LEN;
+				session->securityAuthKeyLen = USM_AUTH_KU_LEN;
 
-				if (SNMPERR_SUCCESS != generate_Ku(session.securityAuthProto,
-						session.securityAuthProtoLen, (u_char *)item->snmpv3_authpassphrase,
-						strlen(item->snmpv3_authpassphrase), session.securityAuthKey,
-						&session.securityAuthKeyLen))
+				if (SNMPERR_SUCCESS != generate_Ku(session->securityAuthProto,
+						session->securityAuthProtoLen, (u_char *)item->snmpv3_authpassphrase,
+						strlen(item->snmpv3_authpassphrase), session->securityAuthKey,
+						&session->securityAuthKeyLen))
 				{
 					zbx_strlcpy(error, "Error generating Ku from authentication pass phrase",
 							max_error_len);
-					goto end;
+					goto out;
 				}
 
 				switch (item->snmpv3_privprotocol)
 				{
 					case ITEM_SNMPV3_PRIVPROTOCOL_DES:
 						/* set the privacy protocol to DES */
-						session.securityPrivProto = usmDESPrivProtocol;
-						session.securityPrivProtoLen = USM_PRIV_PROTO_DES_LEN;
+						session->securityPrivProto = usmDESPrivProtocol;
+						session->securityPrivProtoLen = USM_PRIV_PROTO_DES_LEN;
 						break;
 					case ITEM_SNMPV3_PRIVPROTOCOL_AES128:
 						/* set the privacy protocol to AES128 */
-						session.securityPrivProto = usmAESPrivProtocol;
-						session.securityPrivProtoLen = USM_PRIV_PROTO_AES_LEN;
+						session->securityPrivProto = usmAESPrivProtocol;
+						session->securityPrivProtoLen = USM_PRIV_PROTO_AES_LEN;
 						break;
 #ifdef HAVE_NETSNMP_STRONG_PRIV
 					case ITEM_SNMPV3_PRIVPROTOCOL_AES192:
 						/* set the privacy protocol to AES192 */
-						session.securityPrivProto = usmAES192PrivProtocol;
-						session.securityPrivProtoLen = OID_LENGTH(usmAES192PrivProtocol);
+						session->securityPrivProto = usmAES192PrivProtocol;
+						session->securityPrivProtoLen = OID_LENGTH(usmAES192PrivProtocol);
 						break;
 					case ITEM_SNMPV3_PRIVPROTOCOL_AES256:
 						/* set the privacy protocol to AES256 */
-						session.securityPrivProto = usmAES256PrivProtocol;
-						session.securityPrivProtoLen = OID_LENGTH(usmAES256PrivProtocol);
+						session->securityPrivProto = usmAES256PrivProtocol;
+						session->securityPrivProtoLen = OID_LENGTH(usmAES256PrivProtocol);
 						break;
 					case ITEM_SNMPV3_PRIVPROTOCOL_AES192C:
 						/* set the privacy protocol to AES192 (Cisco version) */
-						session.securityPrivProto = usmAES192CiscoPrivProtocol;
-						session.securityPrivProtoLen = OID_LENGTH(usmAES192CiscoPrivProtocol);
+						session->securityPrivProto = usmAES192CiscoPrivProtocol;
+						session->securityPrivProtoLen = OID_LENGTH(usmAES192CiscoPrivProtocol);
 						break;
 					case ITEM_SNMPV3_PRIVPROTOCOL_AES256C:
 						/* set the privacy protocol to AES256 (Cisco version) */
-						session.securityPrivProto = usmAES256CiscoPrivProtocol;
-						session.securityPrivProtoLen = OID_LENGTH(usmAES256CiscoPrivProtocol);
+						session->securityPrivProto = usmAES256CiscoPrivProtocol;
+						session->securityPrivProtoLen = OID_LENGTH(usmAES256CiscoPrivProtocol);
 						break;
 #endif
 					default:
 						zbx_snprintf(error, max_error_len,
 								"Unsupported privacy protocol [%d]",
 								item->snmpv3_privprotocol);
-						goto end;
+						goto out;
 				}
 
-				session.securityPrivKeyLen = USM_PRIV_KU_LEN;
+				session->securityPrivKeyLen = USM_PRIV_KU_LEN;
 
-				if (SNMPERR_SUCCESS != generate_Ku(session.securityAuthProto,
-						session.securityAuthProtoLen, (u_char *)item->snmpv3_privpassphrase,
-						strlen(item->snmpv3_privpassphrase), session.securityPrivKey,
-						&session.securityPrivKeyLen))
+				if (SNMPERR_SUCCESS != generate_Ku(session->securityAuthProto,
+						session->securityAuthProtoLen, (u_char *)item->snmpv3_privpassphrase,
+						strlen(item->snmpv3_privpassphrase), session->securityPrivKey,
+						&session->securityPrivKeyLen))
 				{
 					zbx_strlcpy(error, "Error generating Ku from privacy pass phrase",
 							max_error_len);
-					goto end;
+					goto out;
 				}
 				break;
 		}
 
-		zabbix_log(LOG_LEVEL_DEBUG, "SNMPv3 [%s@%s]", session.securityName, session.peername);
+		zabbix_log(LOG_LEVEL_DEBUG, "SNMPv3 [%s@%s]", session->securityName, session->peername);
 	}
 
 #ifdef HAVE_NETSNMP_SESSION_LOCALNAME
@@ -649,10 +665,25 @@ static struct snmp_session	*zbx_snmp_open_session(const DC_ITEM *item, char *err
 		static char	localname[64];
 
 		zbx_snprintf(localname, sizeof(localname), "%s:0", CONFIG_SOURCE_IP);
-		session.localname = localname;
+		session->localname = localname;
 	}
 #endif
 
+	ret = SUCCEED;
+out:
+	return ret;
+}
+
+static struct snmp_session	*zbx_snmp_open_session(const DC_ITEM *item, char *error, size_t max_error_len)
+{
+	struct snmp_session	session, *ss = NULL;
+	char			addr[128];
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+
+	if (SUCCEED != zbx_snmp_init_session(item, &session, addr, sizeof(addr), error, max_error_len))
+		goto end;
+
 	SOCK_STARTUP;
 
 	if (NULL == (ss = snmp_open(&session)))
@@ -2199,6 +2230,608 @@ out:
 	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
 }
 
+/* range of batch items queried with one request, see zbx_snmp_get_values() for levels */
+typedef struct
+{
+	int	start;
+	int	num;
+	int	level;
+}
+zbx_snmp_range_t;
+
+/* asynchronous SNMP batch check in progress */
+typedef struct
+{
+	DC_ITEM				*items;
+	AGENT_RESULT			*results;
+	int				*errcodes;
+	int				num;
+
+	oid				(*parsed_oids)[MAX_OID_LEN];
+	size_t				*parsed_oid_lens;
+
+	/* ranges left to query, the last range is queried first */
+	zbx_snmp_range_t		*ranges;
+	int				ranges_num;
+
+	/* the range being queried and mapping of its request variable bindings to batch items */
+	zbx_snmp_range_t		range;
+	int				mapping[MAX_SNMP_ITEMS];
+	int				mapping_num;
+	int				reqid;
+
+	void				*sessp;
+	int				fd;
+	struct event_base		*base;
+	struct event			*ev;
+	zbx_async_check_done_cb_t	done_cb;
+	void				*done_arg;
+
+	int				max_succeed;
+	int				min_fail;
+
+	/* the error of the whole batch */
+	int				err;
+	char				error[MAX_STRING_LEN];
+}
+zbx_snmp_context_t;
+
+static void	zbx_snmp_async_event_cb(evutil_socket_t fd, short what, void *arg);
+
+static void	zbx_snmp_async_push_range(zbx_snmp_context_t *ctx, int start, int num, int level)
+{
+	zbx_snmp_range_t	*range = &ctx->ranges[ctx->ranges_num++];
+
+	range->start = start;
+	range->num = num;
+	range->level = level;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_snmp_async_halve                                             *
+ *                                                                            *
+ * Purpose: splits the current range into smaller requests after the device   *
+ *          failed to handle it                                               *
+ *                                                                            *
+ * Comments: First the range is halved, then the halves are queried item by   *
+ *           item, the same as zbx_snmp_get_values() does.                    *
+ *                                                                            *
+ ******************************************************************************/
+static void	zbx_snmp_async_halve(zbx_snmp_context_t *ctx)
+{
+	int	i, base;
+
+	if (ctx->min_fail > ctx->mapping_num)
+		ctx->min_fail = ctx->mapping_num;
+
+	if (0 == ctx->range.level)
+	{
+		base = ctx->range.num / 2;
+
+		zbx_snmp_async_push_range(ctx, ctx->range.start + base, ctx->range.num - base, 1);
+		zbx_snmp_async_push_range(ctx, ctx->range.start, base, 1);
+	}
+	else if (1 == ctx->range.level)
+	{
+		for (i = ctx->range.num - 1; 0 <= i; i--)
+			zbx_snmp_async_push_range(ctx, ctx->range.start + i, 1, 2);
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_snmp_async_process_response                                  *
+ *                                                                            *
+ * Purpose: processes response to the current range request                   *
+ *                                                                            *
+ * Parameters: ctx      - [IN] the check context                              *
+ *             ss       - [IN] the SNMP session                               *
+ *             status   - [IN] the request status (STAT_SUCCESS, ...)         *
+ *             response - [IN] the response, NULL if not received             *
+ *                                                                            *
+ * Comments: Follows zbx_snmp_get_values() logic, requests that should be     *
+ *           retried with less variables are pushed to the range stack.       *
+ *                                                                            *
+ ******************************************************************************/
+static void	zbx_snmp_async_process_response(zbx_snmp_context_t *ctx, const struct snmp_session *ss, int status,
+		const struct snmp_pdu *response)
+{
+	int			i, j;
+	struct variable_list	*var;
+	unsigned char		val_type;
+	const DC_ITEM		*item = &ctx->items[0];
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() status:%d s_snmp_errno:%d errstat:%ld mapping_num:%d level:%d",
+			__func__, status, ss->s_snmp_errno, NULL == response ? (long)-1 : response->errstat,
+			ctx->mapping_num, ctx->range.level);
+
+	if (STAT_SUCCESS == status && SNMP_ERR_NOERROR == response->errstat)
+	{
+		for (i = 0, var = response->variables;; i++, var = var->next_variable)
+		{
+			/* check that response variable binding matches the request variable binding */
+
+			if (i == ctx->mapping_num)
+			{
+				if (NULL != var)
+				{
+					zabbix_log(LOG_LEVEL_WARNING, "SNMP response from host \"%s\" contains"
+							" too many variable bindings", item->host.host);
+
+					if (1 != ctx->mapping_num)	/* give device a chance to handle a smaller request */
+					{
+						zbx_snmp_async_halve(ctx);
+						goto out;
+					}
+
+					zbx_strlcpy(ctx->error, "Invalid SNMP response: too many variable bindings.",
+							sizeof(ctx->error));
+					ctx->err = NOTSUPPORTED;
+				}
+
+				break;
+			}
+
+			if (NULL == var)
+			{
+				zabbix_log(LOG_LEVEL_WARNING, "SNMP response from host \"%s\" contains"
+						" too few variable bindings", item->host.host);
+
+				if (1 != ctx->mapping_num)	/* give device a chance to handle a smaller request */
+				{
+					zbx_snmp_async_halve(ctx);
+					goto out;
+				}
+
+				zbx_strlcpy(ctx->error, "Invalid SNMP response: too few variable bindings.",
+						sizeof(ctx->error));
+				ctx->err = NOTSUPPORTED;
+				break;
+			}
+
+			j = ctx->mapping[i];
+
+			if (ctx->parsed_oid_lens[j] != var->name_length ||
+					0 != memcmp(ctx->parsed_oids[j], var->name, ctx->parsed_oid_lens[j] * sizeof(oid)))
+			{
+				char	sent_oid[ITEM_SNMP_OID_LEN_MAX], received_oid[ITEM_SNMP_OID_LEN_MAX];
+
+				zbx_snmp_dump_oid(sent_oid, sizeof(sent_oid), ctx->parsed_oids[j],
+						ctx->parsed_oid_lens[j]);
+				zbx_snmp_dump_oid(received_oid, sizeof(received_oid), var->name, var->name_length);
+
+				if (1 != ctx->mapping_num)
+				{
+					zabbix_log(LOG_LEVEL_WARNING, "SNMP response from host \"%s\" contains"
+							" variable bindings that do not match the request:"
+							" sent \"%s\", received \"%s\"",
+							item->host.host, sent_oid, received_oid);
+
+					zbx_snmp_async_halve(ctx);	/* give device a chance to handle a smaller request */
+					goto out;
+				}
+				else
+				{
+					zabbix_log(LOG_LEVEL_DEBUG, "SNMP response from host \"%s\" contains"
+							" variable bindings that do not match the request:"
+							" sent \"%s\", received \"%s\"",
+							item->host.host, sent_oid, received_oid);
+				}
+			}
+
+			/* process received data */
+
+			ctx->errcodes[j] = zbx_snmp_set_result(var, &ctx->results[j], &val_type);
+
+			if (ISSET_TEXT(&ctx->results[j]) && ZBX_SNMP_STR_HEX == val_type)
+				zbx_remove_chars(ctx->results[j].text, "\r\n");
+		}
+
+		if (SUCCEED == ctx->err && ctx->max_succeed < ctx->mapping_num)
+			ctx->max_succeed = ctx->mapping_num;
+	}
+	else if (STAT_SUCCESS == status && SNMP_ERR_NOSUCHNAME == response->errstat && 0 != response->errindex)
+	{
+		/* the whole SNMPv1 request is rejected because of single bad variable, see zbx_snmp_get_values() */
+
+		i = response->errindex - 1;
+
+		if (0 > i || i >= ctx->mapping_num)
+		{
+			zabbix_log(LOG_LEVEL_WARNING, "SNMP response from host \"%s\" contains"
+					" an out of bounds error index: %ld", item->host.host, response->errindex);
+
+			zbx_strlcpy(ctx->error, "Invalid SNMP response: error index out of bounds.", sizeof(ctx->error));
+			ctx->err = NOTSUPPORTED;
+			goto out;
+		}
+
+		j = ctx->mapping[i];
+
+		ctx->errcodes[j] = zbx_get_snmp_response_error(ss, &item->interface, status, response, ctx->error,
+				sizeof(ctx->error));
+		SET_MSG_RESULT(&ctx->results[j], zbx_strdup(NULL, ctx->error));
+		*ctx->error = '\0';
+
+		/* retry the range without the bad variable */
+		if (1 < ctx->mapping_num)
+			zbx_snmp_async_push_range(ctx, ctx->range.start, ctx->range.num, ctx->range.level);
+	}
+	else if (1 < ctx->mapping_num &&
+			((STAT_SUCCESS == status && SNMP_ERR_TOOBIG == response->errstat) || STAT_TIMEOUT == status ||
+			(STAT_ERROR == status && SNMPERR_TOO_LONG == ss->s_snmp_errno)))
+	{
+		/* the response is too big or the device does not respond to big requests, see zbx_snmp_get_values() */
+		zbx_snmp_async_halve(ctx);
+	}
+	else
+	{
+		ctx->err = zbx_get_snmp_response_error(ss, &item->interface, status, response, ctx->error,
+				sizeof(ctx->error));
+	}
+out:
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%s", __func__, zbx_result_string(ctx->err));
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_snmp_async_response_cb                                       *
+ *                                                                            *
+ * Purpose: net-snmp callback for received responses and timed out requests   *
+ *                                                                            *
+ ******************************************************************************/
+static int	zbx_snmp_async_response_cb(int operation, struct snmp_session *sp, int reqid, struct snmp_pdu *pdu,
+		void *magic)
+{
+	zbx_snmp_context_t	*ctx = (zbx_snmp_context_t *)magic;
+
+	if (reqid != ctx->reqid)
+		return 1;
+
+	ctx->reqid = 0;
+
+	switch (operation)
+	{
+		case NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE:
+			zbx_snmp_async_process_response(ctx, sp, STAT_SUCCESS, pdu);
+			break;
+		case NETSNMP_CALLBACK_OP_TIMED_OUT:
+			zbx_snmp_async_process_response(ctx, sp, STAT_TIMEOUT, NULL);
+			break;
+		default:
+			zbx_snmp_async_process_response(ctx, sp, STAT_ERROR, NULL);
+	}
+
+	return 1;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_snmp_async_send                                              *
+ *                                                                            *
+ * Purpose: sends request for the next range with items left to query         *
+ *                                                                            *
+ * Return value: SUCCEED - the request was sent                               *
+ *               FAIL    - there are no more requests to send or the batch    *
+ *                         has failed                                         *
+ *                                                                            *
+ ******************************************************************************/
+static int	zbx_snmp_async_send(zbx_snmp_context_t *ctx)
+{
+	int			i, j;
+	struct snmp_pdu		*pdu;
+	struct snmp_session	*ss;
+
+	ss = snmp_sess_session(ctx->sessp);
+
+	while (SUCCEED == ctx->err && 0 != ctx->ranges_num)
+	{
+		ctx->range = ctx->ranges[--ctx->ranges_num];
+		ctx->mapping_num = 0;
+
+		if (NULL == (pdu = snmp_pdu_create(SNMP_MSG_GET)))
+		{
+			zbx_strlcpy(ctx->error, "snmp_pdu_create(): cannot create PDU object.", sizeof(ctx->error));
+			ctx->err = CONFIG_ERROR;
+			break;
+		}
+
+		for (i = 0; i < ctx->range.num; i++)
+		{
+			j = ctx->range.start + i;
+
+			if (SUCCEED != ctx->errcodes[j])
+				continue;
+
+			if (NULL == snmp_add_null_var(pdu, ctx->parsed_oids[j], ctx->parsed_oid_lens[j]))
+			{
+				SET_MSG_RESULT(&ctx->results[j], zbx_strdup(NULL,
+						"snmp_add_null_var(): cannot add null variable."));
+				ctx->errcodes[j] = CONFIG_ERROR;
+				continue;
+			}
+
+			/* drop values of the failed bigger request */
+			free_result(&ctx->results[j]);
+			ctx->mapping[ctx->mapping_num++] = j;
+		}
+
+		if (0 == ctx->mapping_num)
+		{
+			snmp_free_pdu(pdu);
+			continue;
+		}
+
+		ss->retries = (1 == ctx->mapping_num && 0 == ctx->range.level ? 1 : 0);
+
+		if (0 == (ctx->reqid = snmp_sess_async_send(ctx->sessp, pdu, zbx_snmp_async_response_cb, ctx)))
+		{
+			snmp_free_pdu(pdu);
+			zbx_snmp_async_process_response(ctx, ss, STAT_ERROR, NULL);
+			continue;
+		}
+
+		return SUCCEED;
+	}
+
+	return FAIL;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_snmp_async_wait                                              *
+ *                                                                            *
+ * Purpose: waits for response or the next retransmission of the request      *
+ *                                                                            *
+ ******************************************************************************/
+static void	zbx_snmp_async_wait(zbx_snmp_context_t *ctx)
+{
+	netsnmp_large_fd_set	fdset;
+	struct timeval		tv = {0, 0};
+	int			numfds = 0, block = 1;
+
+	netsnmp_large_fd_set_init(&fdset, ctx->fd + 1);
+	snmp_sess_select_info2(ctx->sessp, &numfds, &fdset, &tv, &block);
+	netsnmp_large_fd_set_cleanup(&fdset);
+
+	/* the request is always pending here, but do not rely on library to schedule its timeout */
+	if (0 != block)
+	{
+		tv.tv_sec = CONFIG_TIMEOUT;
+		tv.tv_usec = 0;
+	}
+
+	if (NULL != ctx->ev)
+		event_free(ctx->ev);
+
+	ctx->ev = event_new(ctx->base, ctx->fd, EV_READ, zbx_snmp_async_event_cb, ctx);
+	event_add(ctx->ev, &tv);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_snmp_async_finish                                            *
+ *                                                                            *
+ * Purpose: releases check resources and reports item results to poller       *
+ *                                                                            *
+ ******************************************************************************/
+static void	zbx_snmp_async_finish(zbx_snmp_context_t *ctx)
+{
+	int	i;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() host:'%s' addr:'%s' num:%d %s", __func__, ctx->items[0].host.host,
+			ctx->items[0].interface.addr, ctx->num, zbx_result_string(ctx->err));
+
+	if (NULL != ctx->ev)
+		event_free(ctx->ev);
+
+	if (NULL != ctx->sessp)
+	{
+		snmp_sess_close(ctx->sessp);
+		SOCK_CLEANUP;
+	}
+
+	if (SUCCEED != ctx->err)
+	{
+		zabbix_log(LOG_LEVEL_DEBUG, "getting SNMP values failed: %s", ctx->error);
+
+		for (i = 0; i < ctx->num; i++)
+		{
+			if (SUCCEED != ctx->errcodes[i])
+				continue;
+
+			SET_MSG_RESULT(&ctx->results[i], zbx_strdup(NULL, ctx->error));
+			ctx->errcodes[i] = ctx->err;
+		}
+	}
+	else if (0 != ctx->max_succeed || MAX_SNMP_ITEMS + 1 != ctx->min_fail)
+	{
+		DCconfig_update_interface_snmp_stats(ctx->items[0].interface.interfaceid, ctx->max_succeed,
+				ctx->min_fail);
+	}
+
+	for (i = 0; i < ctx->num; i++)
+		ctx->done_cb(&ctx->items[i], &ctx->results[i], ctx->errcodes[i], ctx->done_arg);
+
+	zbx_free(ctx->ranges);
+	zbx_free(ctx->parsed_oid_lens);
+	zbx_free(ctx->parsed_oids);
+	zbx_free(ctx->errcodes);
+	zbx_free(ctx->results);
+	zbx_free(ctx->items);
+	zbx_free(ctx);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_snmp_async_event_cb                                          *
+ *                                                                            *
+ * Purpose: reads response or handles request timeout and sends the next      *
+ *          request of the batch                                              *
+ *                                                                            *
+ ******************************************************************************/
+static void	zbx_snmp_async_event_cb(evutil_socket_t fd, short what, void *arg)
+{
+	zbx_snmp_context_t	*ctx = (zbx_snmp_context_t *)arg;
+
+	if (0 != (what & EV_READ))
+	{
+		netsnmp_large_fd_set	fdset;
+
+		netsnmp_large_fd_set_init(&fdset, fd + 1);
+		NETSNMP_LARGE_FD_SET(fd, &fdset);
+		snmp_sess_read2(ctx->sessp, &fdset);
+		netsnmp_large_fd_set_cleanup(&fdset);
+	}
+	else
+		snmp_sess_timeout(ctx->sessp);
+
+	/* request is still pending after retransmission or reading unrelated packet */
+	if (0 != ctx->reqid)
+	{
+		zbx_snmp_async_wait(ctx);
+		return;
+	}
+
+	if (SUCCEED == zbx_snmp_async_send(ctx))
+		zbx_snmp_async_wait(ctx);
+	else
+		zbx_snmp_async_finish(ctx);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_async_check_snmp                                             *
+ *                                                                            *
+ * Purpose: starts SNMP GET check of a batch of items of the same interface   *
+ *                                                                            *
+ * Parameters: items    - [IN] the items to check, their contents are taken   *
+ *                             over by the check                              *
+ *             results  - [IN] the prepared item results, taken over by the   *
+ *                             check                                          *
+ *             errcodes - [IN] the item preparation result codes              *
+ *             num      - [IN] the number of items                            *
+ *             base     - [IN] the event base of the poller                   *
+ *             done_cb  - [IN] the callback to report item results            *
+ *             arg      - [IN] the callback argument                          *
+ *                                                                            *
+ * Comments: The done_cb callback is called once for every item, either from  *
+ *           this function or when the check finishes in the poller event     *
+ *           loop. Requests are sent one at a time, halving the batch when    *
+ *           device fails to handle it, and the interface SNMP statistics are *
+ *           updated the same way as for synchronous checks.                  *
+ *           Only items with plain OIDs are supported, dynamic index and      *
+ *           discovery items are checked with get_values_snmp().              *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_async_check_snmp(DC_ITEM *items, AGENT_RESULT *results, int *errcodes, int num, struct event_base *base,
+		zbx_async_check_done_cb_t done_cb, void *arg)
+{
+	zbx_snmp_context_t	*ctx;
+	struct snmp_session	session;
+	char			addr[128], oid_translated[ITEM_SNMP_OID_LEN_MAX];
+	int			i, first = -1;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() host:'%s' addr:'%s' num:%d", __func__, items[0].host.host,
+			items[0].interface.addr, num);
+
+	zbx_init_snmp();	/* avoid high CPU usage by only initializing SNMP once used */
+
+	ctx = (zbx_snmp_context_t *)zbx_malloc(NULL, sizeof(zbx_snmp_context_t));
+	memset(ctx, 0, sizeof(zbx_snmp_context_t));
+
+	ctx->num = num;
+	ctx->items = (DC_ITEM *)zbx_malloc(NULL, sizeof(DC_ITEM) * num);
+	memcpy(ctx->items, items, sizeof(DC_ITEM) * num);
+
+	/* the copied addresses point into the poller item buffer, which is reused before the check finishes */
+	for (i = 0; i < num; i++)
+	{
+		ctx->items[i].interface.addr = (1 == ctx->items[i].interface.useip ? ctx->items[i].interface.ip_orig :
+				ctx->items[i].interface.dns_orig);
+	}
+
+	ctx->results = (AGENT_RESULT *)zbx_malloc(NULL, sizeof(AGENT_RESULT) * num);
+	memcpy(ctx->results, results, sizeof(AGENT_RESULT) * num);
+	ctx->errcodes = (int *)zbx_malloc(NULL, sizeof(int) * num);
+	memcpy(ctx->errcodes, errcodes, sizeof(int) * num);
+	ctx->parsed_oids = zbx_malloc(NULL, sizeof(*ctx->parsed_oids) * num);
+	ctx->parsed_oid_lens = (size_t *)zbx_malloc(NULL, sizeof(size_t) * num);
+	ctx->ranges = (zbx_snmp_range_t *)zbx_malloc(NULL, sizeof(zbx_snmp_range_t) * (num + 2));
+
+	ctx->base = base;
+	ctx->done_cb = done_cb;
+	ctx->done_arg = arg;
+	ctx->fd = -1;
+	ctx->err = SUCCEED;
+	ctx->min_fail = MAX_SNMP_ITEMS + 1;
+
+	for (i = 0; i < num; i++)
+	{
+		if (SUCCEED != ctx->errcodes[i])
+			continue;
+
+		if (0 != num_key_param(ctx->items[i].snmp_oid))
+		{
+			SET_MSG_RESULT(&ctx->results[i], zbx_dsprintf(NULL, "OID \"%s\" contains unsupported parameters.",
+					ctx->items[i].snmp_oid));
+			ctx->errcodes[i] = CONFIG_ERROR;
+			continue;
+		}
+
+		zbx_snmp_translate(oid_translated, ctx->items[i].snmp_oid, sizeof(oid_translated));
+		ctx->parsed_oid_lens[i] = MAX_OID_LEN;
+
+		if (NULL == snmp_parse_oid(oid_translated, ctx->parsed_oids[i], &ctx->parsed_oid_lens[i]))
+		{
+			SET_MSG_RESULT(&ctx->results[i], zbx_dsprintf(NULL, "snmp_parse_oid(): cannot parse OID \"%s\".",
+					oid_translated));
+			ctx->errcodes[i] = CONFIG_ERROR;
+			continue;
+		}
+
+		if (-1 == first)
+			first = i;
+	}
+
+	/* all items already NOTSUPPORTED (with invalid key, port or SNMP parameters) */
+	if (-1 == first)
+		goto finish;
+
+	/* SNMPv3 session performs blocking engine discovery when opened, such items are scheduled */
+	/* to regular pollers, so this can happen only after interface SNMP version is changed     */
+	if (SUCCEED != zbx_snmp_init_session(&ctx->items[first], &session, addr, sizeof(addr), ctx->error,
+			sizeof(ctx->error)))
+	{
+		ctx->err = NETWORK_ERROR;
+		goto finish;
+	}
+
+	SOCK_STARTUP;
+
+	if (NULL == (ctx->sessp = snmp_sess_open(&session)))
+	{
+		SOCK_CLEANUP;
+
+		zbx_strlcpy(ctx->error, "Cannot open SNMP session", sizeof(ctx->error));
+		ctx->err = NETWORK_ERROR;
+		goto finish;
+	}
+
+	ctx->fd = snmp_sess_transport(ctx->sessp)->sock;
+
+	zbx_snmp_async_push_range(ctx, 0, num, 0);
+
+	if (SUCCEED == zbx_snmp_async_send(ctx))
+	{
+		zbx_snmp_async_wait(ctx);
+		return;
+	}
+finish:
+	zbx_snmp_async_finish(ctx);
+}
+
 static void	zbx_shutdown_snmp(void)
 {
 	sigset_t	mask, orig_mask;
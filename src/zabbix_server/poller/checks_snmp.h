@@ -24,6 +24,7 @@
 #include "log.h"
 #include "dbcache.h"
 #include "sysinfo.h"
+#include "async_poller.h"
 
 extern char	*CONFIG_SOURCE_IP;
 extern int	CONFIG_TIMEOUT;
@@ -40,6 +41,8 @@ extern int	CONFIG_TIMEOUT;
 int	get_value_snmp(const DC_ITEM *item, AGENT_RESULT *result, unsigned char poller_type);
 void	get_values_snmp(const DC_ITEM *items, AGENT_RESULT *results, int *errcodes, int num, unsigned char poller_type);
 void	zbx_clear_cache_snmp(unsigned char process_type, int process_num);
+void	zbx_async_check_snmp(DC_ITEM *items, AGENT_RESULT *results, int *errcodes, int num, struct event_base *base,
+		zbx_async_check_done_cb_t done_cb, void *arg);
 #endif
 
 #endif
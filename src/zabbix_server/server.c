@@ -51,6 +51,7 @@
 #include "housekeeper/housekeeper.h"
 #include "pinger/pinger.h"
 #include "poller/poller.h"
+#include "poller/async_poller.h"
 #include "timer/timer.h"
 #include "trapper/trapper.h"
 #include "snmptrapper/snmptrapper.h"
@@ -211,6 +212,10 @@ int	CONFIG_REPORTMANAGER_FORKS	= 0;
 int	CONFIG_REPORTWRITER_FORKS	= 0;
 int	CONFIG_SERVICEMAN_FORKS		= 1;
 int	CONFIG_PROBLEMHOUSEKEEPER_FORKS = 1;
+int	CONFIG_AGENTPOLLER_FORKS	= 0;
+int	CONFIG_SNMPPOLLER_FORKS		= 0;
+int	CONFIG_HTTPAGENT_POLLER_FORKS	= 0;
+int	CONFIG_MAX_CONCURRENT_CHECKS_PER_POLLER	= 1000;
 
 int	CONFIG_LISTEN_PORT		= ZBX_DEFAULT_SERVER_PORT;
 char	*CONFIG_LISTEN_IP		= NULL;
@@ -222,6 +227,7 @@ int	CONFIG_HOUSEKEEPING_FREQUENCY	= 1;
 int	CONFIG_MAX_HOUSEKEEPER_DELETE	= 5000;		/* applies for every separate field value */
 int	CONFIG_HISTSYNCER_FORKS		= 4;
 int	CONFIG_HISTSYNCER_FREQUENCY	= 1;
+int	CONFIG_HISTSYNCER_PIPELINE	= 0;
 int	CONFIG_CONFSYNCER_FORKS		= 1;
 int	CONFIG_CONFSYNCER_FREQUENCY	= 60;
 
@@ -235,9 +241,19 @@ int	CONFIG_VMWARE_TIMEOUT		= 10;
 zbx_uint64_t	CONFIG_CONF_CACHE_SIZE		= 8 * ZBX_MEBIBYTE;
 zbx_uint64_t	CONFIG_HISTORY_CACHE_SIZE	= 16 * ZBX_MEBIBYTE;
 zbx_uint64_t	CONFIG_HISTORY_INDEX_CACHE_SIZE	= 4 * ZBX_MEBIBYTE;
+int		CONFIG_HISTORY_CACHE_SHARDS	= 1;
+int		CONFIG_HISTORY_CACHE_COMPRESSION	= 0;
+char		*CONFIG_HISTORY_CACHE_SPOOL_FILE	= NULL;
+zbx_uint64_t	CONFIG_HISTORY_CACHE_SPOOL_SIZE	= ZBX_GIBIBYTE;
+char		*CONFIG_HISTORY_CACHE_SNAPSHOT_FILE	= NULL;
 zbx_uint64_t	CONFIG_TRENDS_CACHE_SIZE	= 4 * ZBX_MEBIBYTE;
 zbx_uint64_t	CONFIG_TREND_FUNC_CACHE_SIZE	= 4 * ZBX_MEBIBYTE;
 zbx_uint64_t	CONFIG_VALUE_CACHE_SIZE		= 8 * ZBX_MEBIBYTE;
+int		CONFIG_VALUE_CACHE_COMPRESSION	= 0;
+int		CONFIG_VALUE_CACHE_STRIPES	= 1;
+char		*CONFIG_VALUE_CACHE_SNAPSHOT_FILE	= NULL;
+char		*CONFIG_CONFIG_CACHE_SNAPSHOT_FILE	= NULL;
+int		CONFIG_VALUE_CACHE_PERCENTILE_SKETCH	= 0;
 zbx_uint64_t	CONFIG_VMWARE_CACHE_SIZE	= 8 * ZBX_MEBIBYTE;
 zbx_uint64_t	CONFIG_EXPORT_FILE_SIZE		= ZBX_GIBIBYTE;
 
@@ -330,6 +346,7 @@ static char	*CONFIG_SOCKET_PATH	= NULL;
 
 char	*CONFIG_HISTORY_STORAGE_URL		= NULL;
 char	*CONFIG_HISTORY_STORAGE_OPTS		= NULL;
+char	*CONFIG_HISTORY_STORAGE_DIR		= NULL;
 int	CONFIG_HISTORY_STORAGE_PIPELINES	= 0;
 
 char	*CONFIG_STATS_ALLOWED_IP	= NULL;
@@ -518,6 +535,21 @@ int	get_process_info_by_thread(int local_server_num, unsigned char *local_proces
 		*local_process_type = ZBX_PROCESS_TYPE_PROBLEMHOUSEKEEPER;
 		*local_process_num = local_server_num - server_count + CONFIG_PROBLEMHOUSEKEEPER_FORKS;
 	}
+	else if (local_server_num <= (server_count += CONFIG_AGENTPOLLER_FORKS))
+	{
+		*local_process_type = ZBX_PROCESS_TYPE_AGENT_POLLER;
+		*local_process_num = local_server_num - server_count + CONFIG_AGENTPOLLER_FORKS;
+	}
+	else if (local_server_num <= (server_count += CONFIG_SNMPPOLLER_FORKS))
+	{
+		*local_process_type = ZBX_PROCESS_TYPE_SNMP_POLLER;
+		*local_process_num = local_server_num - server_count + CONFIG_SNMPPOLLER_FORKS;
+	}
+	else if (local_server_num <= (server_count += CONFIG_HTTPAGENT_POLLER_FORKS))
+	{
+		*local_process_type = ZBX_PROCESS_TYPE_HTTPAGENT_POLLER;
+		*local_process_num = local_server_num - server_count + CONFIG_HTTPAGENT_POLLER_FORKS;
+	}
 	else
 		return FAIL;
 
@@ -608,10 +640,12 @@ static void	zbx_validate_config(ZBX_TASK_EX *task)
 	char	*ch_error;
 	int	err = 0;
 
-	if (0 == CONFIG_UNREACHABLE_POLLER_FORKS && 0 != CONFIG_POLLER_FORKS + CONFIG_JAVAPOLLER_FORKS)
+	if (0 == CONFIG_UNREACHABLE_POLLER_FORKS &&
+			0 != CONFIG_POLLER_FORKS + CONFIG_JAVAPOLLER_FORKS + CONFIG_AGENTPOLLER_FORKS +
+			CONFIG_SNMPPOLLER_FORKS + CONFIG_HTTPAGENT_POLLER_FORKS)
 	{
 		zabbix_log(LOG_LEVEL_CRIT, "\"StartPollersUnreachable\" configuration parameter must not be 0"
-				" if regular or Java pollers are started");
+				" if regular, Java, agent, SNMP or HTTP agent pollers are started");
 		err = 1;
 	}
 
@@ -699,6 +733,13 @@ static void	zbx_validate_config(ZBX_TASK_EX *task)
 
 #if !defined(HAVE_OPENIPMI)
 	err |= (FAIL == check_cfg_feature_int("StartIPMIPollers", CONFIG_IPMIPOLLER_FORKS, "IPMI support"));
+#endif
+#if !defined(HAVE_NETSNMP)
+	err |= (FAIL == check_cfg_feature_int("StartSNMPPollers", CONFIG_SNMPPOLLER_FORKS, "SNMP support"));
+#endif
+#if !defined(HAVE_LIBCURL)
+	err |= (FAIL == check_cfg_feature_int("StartHTTPAgentPollers", CONFIG_HTTPAGENT_POLLER_FORKS,
+			"cURL library"));
 #endif
 	err |= (FAIL == zbx_db_validate_config_features());
 
@@ -735,6 +776,8 @@ static void	zbx_load_config(ZBX_TASK_EX *task)
 			MANDATORY,	MIN,			MAX */
 		{"StartDBSyncers",		&CONFIG_HISTSYNCER_FORKS,		TYPE_INT,
 			PARM_OPT,	1,			100},
+		{"HistorySyncPipeline",		&CONFIG_HISTSYNCER_PIPELINE,		TYPE_INT,
+			PARM_OPT,	0,			1},
 		{"StartDiscoverers",		&CONFIG_DISCOVERER_FORKS,		TYPE_INT,
 			PARM_OPT,	0,			250},
 		{"StartHTTPPollers",		&CONFIG_HTTPPOLLER_FORKS,		TYPE_INT,
@@ -769,14 +812,34 @@ static void	zbx_load_config(ZBX_TASK_EX *task)
 			PARM_OPT,	128 * ZBX_KIBIBYTE,	__UINT64_C(2) * ZBX_GIBIBYTE},
 		{"HistoryIndexCacheSize",	&CONFIG_HISTORY_INDEX_CACHE_SIZE,	TYPE_UINT64,
 			PARM_OPT,	128 * ZBX_KIBIBYTE,	__UINT64_C(2) * ZBX_GIBIBYTE},
+		{"HistoryCacheShards",		&CONFIG_HISTORY_CACHE_SHARDS,		TYPE_INT,
+			PARM_OPT,	1,			ZBX_HC_SHARDS_MAX},
+		{"HistoryCacheCompression",	&CONFIG_HISTORY_CACHE_COMPRESSION,	TYPE_INT,
+			PARM_OPT,	0,			1},
+		{"HistoryCacheSpoolFile",	&CONFIG_HISTORY_CACHE_SPOOL_FILE,	TYPE_STRING,
+			PARM_OPT,	0,			0},
+		{"HistoryCacheSpoolSize",	&CONFIG_HISTORY_CACHE_SPOOL_SIZE,	TYPE_UINT64,
+			PARM_OPT,	ZBX_MEBIBYTE,		__UINT64_C(1024) * ZBX_GIBIBYTE},
+		{"HistoryCacheSnapshotFile",	&CONFIG_HISTORY_CACHE_SNAPSHOT_FILE,	TYPE_STRING,
+			PARM_OPT,	0,			0},
 		{"TrendCacheSize",		&CONFIG_TRENDS_CACHE_SIZE,		TYPE_UINT64,
 			PARM_OPT,	128 * ZBX_KIBIBYTE,	__UINT64_C(2) * ZBX_GIBIBYTE},
 		{"TrendFunctionCacheSize",	&CONFIG_TREND_FUNC_CACHE_SIZE,		TYPE_UINT64,
 			PARM_OPT,	0,			__UINT64_C(2) * ZBX_GIBIBYTE},
 		{"ValueCacheSize",		&CONFIG_VALUE_CACHE_SIZE,		TYPE_UINT64,
 			PARM_OPT,	0,			__UINT64_C(64) * ZBX_GIBIBYTE},
+		{"ValueCacheCompression",	&CONFIG_VALUE_CACHE_COMPRESSION,	TYPE_INT,
+			PARM_OPT,	0,			1},
+		{"ValueCacheStripes",		&CONFIG_VALUE_CACHE_STRIPES,		TYPE_INT,
+			PARM_OPT,	1,			ZBX_VC_STRIPES_MAX},
+		{"ValueCacheSnapshotFile",	&CONFIG_VALUE_CACHE_SNAPSHOT_FILE,	TYPE_STRING,
+			PARM_OPT,	0,			0},
+		{"ValueCachePercentileSketch",	&CONFIG_VALUE_CACHE_PERCENTILE_SKETCH,	TYPE_INT,
+			PARM_OPT,	0,			1},
 		{"CacheUpdateFrequency",	&CONFIG_CONFSYNCER_FREQUENCY,		TYPE_INT,
 			PARM_OPT,	1,			SEC_PER_HOUR},
+		{"CacheSnapshotFile",		&CONFIG_CONFIG_CACHE_SNAPSHOT_FILE,	TYPE_STRING,
+			PARM_OPT,	0,			0},
 		{"HousekeepingFrequency",	&CONFIG_HOUSEKEEPING_FREQUENCY,		TYPE_INT,
 			PARM_OPT,	0,			24},
 		{"MaxHousekeeperDelete",	&CONFIG_MAX_HOUSEKEEPER_DELETE,		TYPE_INT,
@@ -915,6 +978,8 @@ static void	zbx_load_config(ZBX_TASK_EX *task)
 			PARM_OPT,	0,			0},
 		{"HistoryStorageDateIndex",	&CONFIG_HISTORY_STORAGE_PIPELINES,	TYPE_INT,
 			PARM_OPT,	0,			1},
+		{"HistoryStorageDir",		&CONFIG_HISTORY_STORAGE_DIR,		TYPE_STRING,
+			PARM_OPT,	0,			0},
 		{"ExportDir",			&CONFIG_EXPORT_DIR,			TYPE_STRING,
 			PARM_OPT,	0,			0},
 		{"ExportType",			&CONFIG_EXPORT_TYPE,			TYPE_STRING_LIST,
@@ -927,6 +992,14 @@ static void	zbx_load_config(ZBX_TASK_EX *task)
 			PARM_OPT,	0,			0},
 		{"StartHistoryPollers",		&CONFIG_HISTORYPOLLER_FORKS,		TYPE_INT,
 			PARM_OPT,	0,			1000},
+		{"StartAgentPollers",		&CONFIG_AGENTPOLLER_FORKS,		TYPE_INT,
+			PARM_OPT,	0,			1000},
+		{"StartSNMPPollers",		&CONFIG_SNMPPOLLER_FORKS,		TYPE_INT,
+			PARM_OPT,	0,			1000},
+		{"StartHTTPAgentPollers",	&CONFIG_HTTPAGENT_POLLER_FORKS,	TYPE_INT,
+			PARM_OPT,	0,			1000},
+		{"MaxConcurrentChecksPerPoller",	&CONFIG_MAX_CONCURRENT_CHECKS_PER_POLLER,	TYPE_INT,
+			PARM_OPT,	1,			1000},
 		{"StartReportWriters",		&CONFIG_REPORTWRITER_FORKS,		TYPE_INT,
 			PARM_OPT,	0,			100},
 		{"WebServiceURL",		&CONFIG_WEBSERVICE_URL,			TYPE_STRING,
@@ -1317,7 +1390,9 @@ int	MAIN_ZABBIX_ENTRY(int flags)
 			+ CONFIG_ALERTMANAGER_FORKS + CONFIG_PREPROCMAN_FORKS + CONFIG_PREPROCESSOR_FORKS
 			+ CONFIG_LLDMANAGER_FORKS + CONFIG_LLDWORKER_FORKS + CONFIG_ALERTDB_FORKS
 			+ CONFIG_HISTORYPOLLER_FORKS + CONFIG_AVAILMAN_FORKS + CONFIG_REPORTMANAGER_FORKS
-			+ CONFIG_REPORTWRITER_FORKS + CONFIG_SERVICEMAN_FORKS + CONFIG_PROBLEMHOUSEKEEPER_FORKS;
+			+ CONFIG_REPORTWRITER_FORKS + CONFIG_SERVICEMAN_FORKS + CONFIG_PROBLEMHOUSEKEEPER_FORKS
+			+ CONFIG_AGENTPOLLER_FORKS + CONFIG_SNMPPOLLER_FORKS
+			+ CONFIG_HTTPAGENT_POLLER_FORKS;
 	threads = (pid_t *)zbx_calloc(threads, threads_num, sizeof(pid_t));
 	threads_flags = (int *)zbx_calloc(threads_flags, threads_num, sizeof(int));
 
@@ -1479,6 +1554,21 @@ int	MAIN_ZABBIX_ENTRY(int flags)
 			case ZBX_PROCESS_TYPE_PROBLEMHOUSEKEEPER:
 				zbx_thread_start(trigger_housekeeper_thread, &thread_args, &threads[i]);
 				break;
+			case ZBX_PROCESS_TYPE_AGENT_POLLER:
+				poller_type = ZBX_POLLER_TYPE_AGENT;
+				thread_args.args = &poller_type;
+				zbx_thread_start(async_poller_thread, &thread_args, &threads[i]);
+				break;
+			case ZBX_PROCESS_TYPE_SNMP_POLLER:
+				poller_type = ZBX_POLLER_TYPE_SNMP;
+				thread_args.args = &poller_type;
+				zbx_thread_start(async_poller_thread, &thread_args, &threads[i]);
+				break;
+			case ZBX_PROCESS_TYPE_HTTPAGENT_POLLER:
+				poller_type = ZBX_POLLER_TYPE_HTTPAGENT;
+				thread_args.args = &poller_type;
+				zbx_thread_start(async_poller_thread, &thread_args, &threads[i]);
+				break;
 		}
 	}
 
@@ -1545,6 +1635,10 @@ void	zbx_on_exit(int ret)
 
 	free_configuration_cache();
 
+	/* save value cache contents only at normal exit, after crash it can miss values written to history */
+	if (SUCCEED == ret)
+		zbx_vc_snapshot_save();
+
 	/* free history value cache */
 	zbx_vc_destroy();
 
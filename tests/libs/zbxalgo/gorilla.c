@@ -0,0 +1,123 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "zbxmocktest.h"
+#include "zbxmockdata.h"
+#include "zbxmockassert.h"
+#include "zbxmockutil.h"
+
+#include "zbxalgo.h"
+
+typedef struct
+{
+	zbx_timespec_t	ts;
+	zbx_uint64_t	value;
+}
+zbx_mock_gorilla_value_t;
+
+static void	mock_read_values(zbx_mock_handle_t hvalues, unsigned char value_type, zbx_mock_gorilla_value_t **values,
+		int *values_num)
+{
+	zbx_mock_error_t	err;
+	zbx_mock_handle_t	hvalue;
+	int			values_alloc = 0;
+
+	*values = NULL;
+	*values_num = 0;
+
+	while (ZBX_MOCK_END_OF_VECTOR != (err = (zbx_mock_vector_element(hvalues, &hvalue))))
+	{
+		zbx_mock_gorilla_value_t	*value;
+
+		if (ZBX_MOCK_SUCCESS != err)
+			fail_msg("Cannot read vector member: %s", zbx_mock_error_string(err));
+
+		if (*values_num == values_alloc)
+		{
+			values_alloc += 16;
+			*values = (zbx_mock_gorilla_value_t *)zbx_realloc(*values,
+					sizeof(zbx_mock_gorilla_value_t) * values_alloc);
+		}
+
+		value = &(*values)[(*values_num)++];
+
+		value->ts.sec = (int)zbx_mock_get_object_member_uint64(hvalue, "sec");
+		value->ts.ns = (int)zbx_mock_get_object_member_uint64(hvalue, "ns");
+
+		if (ITEM_VALUE_TYPE_FLOAT == value_type)
+		{
+			double	dbl;
+
+			dbl = zbx_mock_get_object_member_float(hvalue, "value");
+			memcpy(&value->value, &dbl, sizeof(value->value));
+		}
+		else
+			value->value = zbx_mock_get_object_member_uint64(hvalue, "value");
+	}
+}
+
+void	zbx_mock_test_entry(void **state)
+{
+	zbx_mock_gorilla_value_t	*values;
+	int				values_num, encoded_num, i;
+	unsigned char			value_type, *data;
+	size_t				size;
+	zbx_gorilla_state_t		encoder, decoder;
+
+	ZBX_UNUSED(state);
+
+	value_type = zbx_mock_str_to_value_type(zbx_mock_get_parameter_string("in.value_type"));
+	size = (size_t)zbx_mock_get_parameter_uint64("in.size");
+	mock_read_values(zbx_mock_get_parameter_handle("in.values"), value_type, &values, &values_num);
+
+	data = (unsigned char *)zbx_malloc(NULL, size);
+	zbx_gorilla_init(&encoder);
+
+	for (encoded_num = 0; encoded_num < values_num; encoded_num++)
+	{
+		if (SUCCEED != zbx_gorilla_encode(&encoder, data, size, &values[encoded_num].ts,
+				values[encoded_num].value))
+		{
+			break;
+		}
+	}
+
+	zbx_mock_assert_int_eq("encoded values", (int)zbx_mock_get_parameter_uint64("out.values_num"), encoded_num);
+	zbx_mock_assert_int_eq("encoder values", encoded_num, (int)encoder.values_num);
+	zbx_mock_assert_int_eq("encoded bits", (int)zbx_mock_get_parameter_uint64("out.bits_num"),
+			(int)encoder.bits_num);
+
+	zbx_gorilla_init(&decoder);
+
+	for (i = 0; i < encoded_num; i++)
+	{
+		zbx_timespec_t	ts;
+		zbx_uint64_t	value;
+
+		zbx_gorilla_decode(&decoder, data, &ts, &value);
+
+		zbx_mock_assert_timespec_eq("decoded timestamp", &values[i].ts, &ts);
+		zbx_mock_assert_uint64_eq("decoded value", values[i].value, value);
+	}
+
+	zbx_mock_assert_int_eq("decoded bits", (int)encoder.bits_num, (int)decoder.bits_num);
+
+	zbx_free(data);
+	zbx_free(values);
+}
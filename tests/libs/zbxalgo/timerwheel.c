@@ -0,0 +1,218 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "zbxmocktest.h"
+#include "zbxmockdata.h"
+#include "zbxmockassert.h"
+#include "zbxmockutil.h"
+
+#include "zbxalgo.h"
+
+typedef struct
+{
+	zbx_uint64_t	id;
+	int		nextcheck;
+	int		delay;
+}
+zbx_tw_item_t;
+
+static unsigned int	seed;
+
+static int	tw_rand(int range)
+{
+	seed = seed * 1103515245 + 12345;
+
+	return (int)((seed >> 8) % (unsigned int)range);
+}
+
+static int	tw_item_compare(const void *d1, const void *d2)
+{
+	const zbx_binary_heap_elem_t	*e1 = (const zbx_binary_heap_elem_t *)d1;
+	const zbx_binary_heap_elem_t	*e2 = (const zbx_binary_heap_elem_t *)d2;
+
+	const zbx_tw_item_t		*i1 = (const zbx_tw_item_t *)e1->data;
+	const zbx_tw_item_t		*i2 = (const zbx_tw_item_t *)e2->data;
+
+	ZBX_RETURN_IF_NOT_EQUAL(i1->nextcheck, i2->nextcheck);
+	ZBX_RETURN_IF_NOT_EQUAL(i1->id, i2->id);
+
+	return 0;
+}
+
+static double	tw_time(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: tw_schedule_wheel                                                *
+ *                                                                            *
+ * Purpose: pops due items and reschedules them after their delay, returns    *
+ *          the popped items in the order they were popped                    *
+ *                                                                            *
+ ******************************************************************************/
+static void	tw_schedule_wheel(zbx_timer_wheel_t *wheel, zbx_tw_item_t *items, int now, zbx_vector_uint64_t *popped)
+{
+	zbx_binary_heap_elem_t	*min;
+	zbx_tw_item_t		*item;
+	int			i, num = popped->values_num;
+
+	while (NULL != (min = zbx_timer_wheel_find_min(wheel, now)))
+	{
+		item = (zbx_tw_item_t *)min->data;
+
+		if (item->nextcheck > now)
+			break;
+
+		zbx_vector_uint64_append(popped, item->id);
+		zbx_timer_wheel_remove_min(wheel);
+	}
+
+	for (i = num; i < popped->values_num; i++)
+	{
+		item = &items[popped->values[i]];
+		item->nextcheck += item->delay;
+		zbx_timer_wheel_update(wheel, item->id, item, item->nextcheck);
+	}
+}
+
+static void	tw_schedule_heap(zbx_binary_heap_t *heap, zbx_tw_item_t *items, int now, zbx_vector_uint64_t *popped)
+{
+	zbx_binary_heap_elem_t	*min, elem;
+	zbx_tw_item_t		*item;
+	int			i, num = popped->values_num;
+
+	while (FAIL == zbx_binary_heap_empty(heap))
+	{
+		min = zbx_binary_heap_find_min(heap);
+		item = (zbx_tw_item_t *)min->data;
+
+		if (item->nextcheck > now)
+			break;
+
+		zbx_vector_uint64_append(popped, item->id);
+		zbx_binary_heap_remove_min(heap);
+	}
+
+	for (i = num; i < popped->values_num; i++)
+	{
+		item = &items[popped->values[i]];
+		item->nextcheck += item->delay;
+		elem.key = item->id;
+		elem.data = item;
+		zbx_binary_heap_insert(heap, &elem);
+	}
+}
+
+static void	tw_items_init(zbx_tw_item_t *items, int items_num, int start, int delay_max)
+{
+	int	i;
+
+	seed = 1;
+
+	for (i = 0; i < items_num; i++)
+	{
+		items[i].id = i;
+		items[i].delay = 1 + tw_rand(delay_max);
+		items[i].nextcheck = start + tw_rand(items[i].delay);
+	}
+}
+
+void	zbx_mock_test_entry(void **state)
+{
+	zbx_timer_wheel_t	wheel;
+	zbx_binary_heap_t	heap;
+	zbx_tw_item_t		*items;
+	zbx_vector_uint64_t	popped_wheel, popped_heap;
+	zbx_binary_heap_elem_t	elem;
+	int			i, now, start, items_num, delay_max, duration, nextcheck;
+	double			time_wheel, time_heap;
+
+	ZBX_UNUSED(state);
+
+	items_num = (int)zbx_mock_get_parameter_uint64("in.items");
+	delay_max = (int)zbx_mock_get_parameter_uint64("in.delay");
+	duration = (int)zbx_mock_get_parameter_uint64("in.duration");
+	start = (int)zbx_mock_get_parameter_uint64("in.start");
+
+	items = (zbx_tw_item_t *)zbx_malloc(NULL, sizeof(zbx_tw_item_t) * items_num);
+	zbx_vector_uint64_create(&popped_wheel);
+	zbx_vector_uint64_create(&popped_heap);
+
+	/* timer wheel */
+	tw_items_init(items, items_num, start, delay_max);
+	zbx_timer_wheel_create(&wheel, tw_item_compare);
+
+	time_wheel = tw_time();
+
+	for (i = 0; i < items_num; i++)
+		zbx_timer_wheel_update(&wheel, items[i].id, &items[i], items[i].nextcheck);
+
+	for (now = start; now < start + duration; now++)
+	{
+		tw_schedule_wheel(&wheel, items, now, &popped_wheel);
+
+		nextcheck = zbx_timer_wheel_nextcheck(&wheel);
+
+		if (nextcheck <= now)
+			fail_msg("next check %d is not after the current time %d", nextcheck, now);
+	}
+
+	time_wheel = tw_time() - time_wheel;
+
+	zbx_mock_assert_int_eq("timer wheel elements", items_num, zbx_timer_wheel_elems_num(&wheel));
+	zbx_timer_wheel_destroy(&wheel);
+
+	/* binary heap */
+	tw_items_init(items, items_num, start, delay_max);
+	zbx_binary_heap_create(&heap, tw_item_compare, ZBX_BINARY_HEAP_OPTION_DIRECT);
+
+	time_heap = tw_time();
+
+	for (i = 0; i < items_num; i++)
+	{
+		elem.key = items[i].id;
+		elem.data = &items[i];
+		zbx_binary_heap_insert(&heap, &elem);
+	}
+
+	for (now = start; now < start + duration; now++)
+		tw_schedule_heap(&heap, items, now, &popped_heap);
+
+	time_heap = tw_time() - time_heap;
+
+	zbx_binary_heap_destroy(&heap);
+
+	printf("scheduled %d checks of %d items: timer wheel %.6f sec, binary heap %.6f sec\n",
+			popped_wheel.values_num, items_num, time_wheel, time_heap);
+
+	zbx_mock_assert_int_eq("popped items", popped_heap.values_num, popped_wheel.values_num);
+
+	for (i = 0; i < popped_heap.values_num; i++)
+		zbx_mock_assert_uint64_eq("popped item", popped_heap.values[i], popped_wheel.values[i]);
+
+	zbx_vector_uint64_destroy(&popped_heap);
+	zbx_vector_uint64_destroy(&popped_wheel);
+	zbx_free(items);
+}
@@ -0,0 +1,115 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "dbcache_test.h"
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_hc_test_pop_values                                           *
+ *                                                                            *
+ * Purpose: takes the next batch of values out of history cache like history  *
+ *          syncers do                                                        *
+ *                                                                            *
+ * Parameters: itemids - [OUT] the item identifiers of popped values          *
+ *             ts      - [OUT] the timestamps of popped values                *
+ *                                                                            *
+ * Return value: the number of popped values                                  *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_hc_test_pop_values(zbx_uint64_t *itemids, zbx_timespec_t *ts)
+{
+	zbx_vector_ptr_t	history_items;
+	ZBX_DC_HISTORY		*history;
+	zbx_hc_shard_t		*shard;
+	int			i, history_num;
+
+	history = (ZBX_DC_HISTORY *)zbx_malloc(NULL, sizeof(ZBX_DC_HISTORY) * ZBX_HC_SYNC_MAX);
+	zbx_vector_ptr_create(&history_items);
+	zbx_vector_ptr_reserve(&history_items, ZBX_HC_SYNC_MAX);
+
+	shard = hc_pop_items(&history_items);
+	history_num = history_items.values_num;
+	hc_get_item_values(history, &history_items);
+
+	for (i = 0; i < history_num; i++)
+	{
+		itemids[i] = history[i].itemid;
+		ts[i] = history[i].ts;
+	}
+
+	hc_free_item_values(history, history_num);
+
+	LOCK_SHARD(shard);
+	hc_push_items(shard, &history_items);
+	shard->history_num -= history_num;
+	UNLOCK_SHARD(shard);
+
+	zbx_vector_ptr_destroy(&history_items);
+	zbx_free(history);
+
+	return history_num;
+}
+
+void	zbx_hc_test_get_counts(zbx_uint64_t *spooled_num, zbx_uint64_t *pending_num)
+{
+	int	i;
+
+	*spooled_num = 0;
+	*pending_num = 0;
+
+	for (i = 0; i < cache->shards_num; i++)
+	{
+		zbx_hc_shard_t	*shard = cache->shards[i];
+
+		LOCK_SHARD(shard);
+
+		if (NULL != shard->spool)
+			*spooled_num += shard->spool->values_num;
+
+		*pending_num += shard->snapshot_values_num;
+
+		UNLOCK_SHARD(shard);
+	}
+}
+
+int	zbx_hc_test_save(void)
+{
+	return hc_snapshot_save();
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_hc_test_stop                                                 *
+ *                                                                            *
+ * Purpose: releases history cache files like a stopped process, history      *
+ *          cache values are lost unless they were saved                      *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_hc_test_stop(void)
+{
+	hc_spool_destroy();
+
+	if (MAP_FAILED != snapshot_map)
+	{
+		munmap(snapshot_map, snapshot_map_size);
+		snapshot_map = MAP_FAILED;
+	}
+
+	cache = NULL;
+}
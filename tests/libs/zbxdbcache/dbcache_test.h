@@ -0,0 +1,31 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#ifndef ZABBIX_DBCACHE_TEST_H
+#define ZABBIX_DBCACHE_TEST_H
+
+/* the maximum number of values popped from history cache at once */
+#define ZBX_HC_TEST_VALUES_MAX	1000
+
+int	zbx_hc_test_pop_values(zbx_uint64_t *itemids, zbx_timespec_t *ts);
+void	zbx_hc_test_get_counts(zbx_uint64_t *spooled_num, zbx_uint64_t *pending_num);
+int	zbx_hc_test_save(void);
+void	zbx_hc_test_stop(void);
+
+#endif
@@ -0,0 +1,72 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "zbxmocktest.h"
+#include "zbxmockdata.h"
+#include "zbxmockassert.h"
+#include "zbxmockutil.h"
+
+#include "zbxserver.h"
+#include "common.h"
+#include "zbxalgo.h"
+#include "dbcache.h"
+#include "mutexs.h"
+
+#define ZBX_DBCONFIG_IMPL
+#include "dbconfig.h"
+
+#include "configcache_mock.h"
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_mock_test_entry                                              *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_mock_test_entry(void **state)
+{
+	char		*value = NULL, *error = NULL;
+	const char	*text;
+	zbx_uint64_t	hostid = 1;
+	int		i, ret, expected_ret;
+
+	ZBX_UNUSED(state);
+
+	mock_config_init();
+	mock_config_load_user_macros("in.macros");
+
+	text = zbx_mock_get_parameter_string("in.text");
+	expected_ret = zbx_mock_str_to_return_code(zbx_mock_get_parameter_string("out.return"));
+
+	/* the second expansion uses compiled template and cached macro values */
+	for (i = 0; i < 2; i++)
+	{
+		ret = dc_expand_user_macros_len(text, strlen(text), &hostid, 1, &value, &error);
+		zbx_mock_assert_result_eq("dc_expand_user_macros_len() return value", expected_ret, ret);
+
+		if (SUCCEED == ret)
+		{
+			zbx_mock_assert_str_eq("expanded text", zbx_mock_get_parameter_string("out.value"), value);
+			zbx_free(value);
+		}
+		else
+			zbx_free(error);
+	}
+
+	mock_config_free();
+}
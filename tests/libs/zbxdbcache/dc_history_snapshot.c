@@ -0,0 +1,238 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "zbxmocktest.h"
+#include "zbxmockdata.h"
+#include "zbxmockassert.h"
+#include "zbxmockutil.h"
+
+#include "common.h"
+#include "mutexs.h"
+#include "dbcache.h"
+#include "dbcache_test.h"
+
+#define HC_MOCK_ITEMS_MAX	16
+#define HC_MOCK_CLOCK		1600000000
+
+extern unsigned char	program_type;
+extern zbx_uint64_t	CONFIG_HISTORY_CACHE_SIZE;
+extern zbx_uint64_t	CONFIG_HISTORY_INDEX_CACHE_SIZE;
+extern int		CONFIG_HISTORY_CACHE_SHARDS;
+extern char		*CONFIG_HISTORY_CACHE_SPOOL_FILE;
+extern zbx_uint64_t	CONFIG_HISTORY_CACHE_SPOOL_SIZE;
+extern char		*CONFIG_HISTORY_CACHE_SNAPSHOT_FILE;
+
+static zbx_uint64_t	hc_mock_get_size(const char *path)
+{
+	zbx_uint64_t	size;
+
+	if (FAIL == str2uint64(zbx_mock_get_parameter_string(path), "KMG", &size))
+		fail_msg("invalid size parameter \"%s\"", path);
+
+	return size;
+}
+
+static int	hc_mock_get_yesno(const char *path)
+{
+	return 0 == strcmp(zbx_mock_get_parameter_string(path), "yes") ? 1 : 0;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_mock_start                                                    *
+ *                                                                            *
+ * Purpose: initializes history cache like a starting process                 *
+ *                                                                            *
+ ******************************************************************************/
+static void	hc_mock_start(void)
+{
+	char	*error = NULL;
+
+	if (SUCCEED != init_database_cache(&error))
+		fail_msg("cannot initialize history cache: %s", error);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_mock_add_values                                               *
+ *                                                                            *
+ * Purpose: adds one value per second to each item                            *
+ *                                                                            *
+ * Parameters: items_num - [IN] the number of items                           *
+ *             from      - [IN] the index of the first value                  *
+ *             to        - [IN] the index after the last value                *
+ *                                                                            *
+ ******************************************************************************/
+static void	hc_mock_add_values(int items_num, int from, int to)
+{
+	AGENT_RESULT	result;
+	zbx_timespec_t	ts = {0, 0};
+	int		i, j;
+
+	for (i = from; i < to; i++)
+	{
+		ts.sec = HC_MOCK_CLOCK + i;
+
+		for (j = 1; j <= items_num; j++)
+		{
+			init_result(&result);
+			SET_UI64_RESULT(&result, (zbx_uint64_t)i);
+			dc_add_history((zbx_uint64_t)j, ITEM_VALUE_TYPE_UINT64, 0, &result, &ts, ITEM_STATE_NORMAL,
+					NULL);
+			free_result(&result);
+		}
+
+		dc_flush_history();
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_mock_pop_values                                               *
+ *                                                                            *
+ * Purpose: takes values out of history cache and checks that values of each  *
+ *          item come in the order they were added                            *
+ *                                                                            *
+ * Parameters: items_num - [IN] the number of items                           *
+ *             last      - [IN/OUT] the timestamps of the last popped values  *
+ *             num       - [IN] the minimum number of values to pop, -1 to    *
+ *                              pop all values                                *
+ *                                                                            *
+ * Return value: the number of popped values                                  *
+ *                                                                            *
+ ******************************************************************************/
+static int	hc_mock_pop_values(int items_num, int *last, int num)
+{
+	zbx_uint64_t	itemids[ZBX_HC_TEST_VALUES_MAX];
+	zbx_timespec_t	ts[ZBX_HC_TEST_VALUES_MAX];
+	int		i, values_num, popped = 0;
+
+	while ((0 > num || popped < num) && 0 != (values_num = zbx_hc_test_pop_values(itemids, ts)))
+	{
+		for (i = 0; i < values_num; i++)
+		{
+			if (1 > itemids[i] || (zbx_uint64_t)items_num < itemids[i])
+				fail_msg("unexpected value of item " ZBX_FS_UI64, itemids[i]);
+
+			if (ts[i].sec <= last[itemids[i] - 1])
+			{
+				fail_msg("value of item " ZBX_FS_UI64 " at %d follows value at %d", itemids[i],
+						ts[i].sec - HC_MOCK_CLOCK, last[itemids[i] - 1] - HC_MOCK_CLOCK);
+			}
+
+			last[itemids[i] - 1] = ts[i].sec;
+		}
+
+		popped += values_num;
+	}
+
+	return popped;
+}
+
+void	zbx_mock_test_entry(void **state)
+{
+	char		dir[] = "/tmp/zbx_hsnp_XXXXXX", *error = NULL;
+	int		items_num, values_num, runtime_num, popped, crash, i, last[HC_MOCK_ITEMS_MAX];
+	zbx_uint64_t	spooled_num, pending_num;
+
+	ZBX_UNUSED(state);
+
+	if (NULL == mkdtemp(dir))
+		fail_msg("cannot create history cache directory: %s", zbx_strerror(errno));
+
+	zbx_mock_set_real_dir(dir);
+
+	program_type = ZBX_PROGRAM_TYPE_PROXY;
+	CONFIG_HISTORY_CACHE_SHARDS = atoi(zbx_mock_get_parameter_string("in.shards"));
+	CONFIG_HISTORY_CACHE_SIZE = 128 * ZBX_KIBIBYTE * CONFIG_HISTORY_CACHE_SHARDS;
+	CONFIG_HISTORY_INDEX_CACHE_SIZE = 128 * ZBX_KIBIBYTE * CONFIG_HISTORY_CACHE_SHARDS;
+	CONFIG_HISTORY_CACHE_SPOOL_FILE = zbx_dsprintf(NULL, "%s/zabbix_history.spool", dir);
+	CONFIG_HISTORY_CACHE_SPOOL_SIZE = hc_mock_get_size("in.spool size");
+	CONFIG_HISTORY_CACHE_SNAPSHOT_FILE = zbx_dsprintf(NULL, "%s/zabbix_history.snapshot", dir);
+
+	if (HC_MOCK_ITEMS_MAX < (items_num = atoi(zbx_mock_get_parameter_string("in.items"))))
+		fail_msg("too many items");
+
+	values_num = atoi(zbx_mock_get_parameter_string("in.values"));
+	runtime_num = atoi(zbx_mock_get_parameter_string("in.runtime values"));
+	crash = hc_mock_get_yesno("in.crash");
+
+	for (i = 0; i < items_num; i++)
+		last[i] = 0;
+
+	if (SUCCEED != zbx_locks_create(&error))
+		fail_msg("cannot create locks: %s", error);
+
+	/* fill history cache and spool, then save them into snapshot */
+	hc_mock_start();
+	hc_mock_add_values(items_num, 0, values_num);
+
+	zbx_hc_test_get_counts(&spooled_num, &pending_num);
+
+	if (0 == spooled_num)
+		fail_msg("history cache is too large for the test, no values were spooled");
+
+	zbx_mock_assert_result_eq("snapshot save", SUCCEED, zbx_hc_test_save());
+	zbx_hc_test_stop();
+
+	/* restart from snapshot and add new values */
+	CONFIG_HISTORY_CACHE_SPOOL_SIZE = hc_mock_get_size("in.restart spool size");
+	hc_mock_start();
+
+	zbx_hc_test_get_counts(&spooled_num, &pending_num);
+	zbx_mock_assert_int_eq("values not loaded from snapshot", hc_mock_get_yesno("out.pending"),
+			0 != pending_num ? 1 : 0);
+
+	popped = hc_mock_pop_values(items_num, last, atoi(zbx_mock_get_parameter_string("in.popped")));
+	hc_mock_add_values(items_num, values_num, values_num + runtime_num);
+
+	if (0 != crash)
+	{
+		/* the values in history cache are lost, the values that were popped can come again */
+		zbx_hc_test_stop();
+		hc_mock_start();
+
+		for (i = 0; i < items_num; i++)
+			last[i] = 0;
+	}
+
+	popped += hc_mock_pop_values(items_num, last, -1);
+
+	zbx_hc_test_get_counts(&spooled_num, &pending_num);
+	zbx_mock_assert_uint64_eq("spooled values left", 0, spooled_num);
+	zbx_mock_assert_uint64_eq("values not loaded from snapshot left", 0, pending_num);
+
+	if (0 == crash)
+		zbx_mock_assert_int_eq("popped values", items_num * (values_num + runtime_num), popped);
+
+	for (i = 0; i < items_num; i++)
+	{
+		zbx_mock_assert_int_eq("the last value of item", HC_MOCK_CLOCK + values_num + runtime_num - 1,
+				last[i]);
+	}
+
+	zbx_hc_test_stop();
+
+	unlink(CONFIG_HISTORY_CACHE_SPOOL_FILE);
+	unlink(CONFIG_HISTORY_CACHE_SNAPSHOT_FILE);
+	rmdir(dir);
+	zbx_free(CONFIG_HISTORY_CACHE_SNAPSHOT_FILE);
+	zbx_free(CONFIG_HISTORY_CACHE_SPOOL_FILE);
+	zbx_mock_set_real_dir(NULL);
+}
@@ -0,0 +1,115 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "zbxmocktest.h"
+#include "zbxmockdata.h"
+#include "zbxmockassert.h"
+#include "zbxmockutil.h"
+
+#include "common.h"
+#include "mutexs.h"
+#define ZBX_DBCONFIG_IMPL
+#include "dbcache.h"
+#include "dbconfig.h"
+#include "dc_httpitem_params_test.h"
+
+#define DC_HTTPITEM_PARAMS_ITEMS_MAX	16
+
+void	zbx_mock_test_entry(void **state)
+{
+	const zbx_dc_httpitem_params_t	*items[DC_HTTPITEM_PARAMS_ITEMS_MAX] = {0};
+	zbx_mock_handle_t		hops, hop, hrefcount;
+	zbx_mock_error_t		err;
+	const char			*op;
+	char				msg[MAX_STRING_LEN];
+	int				i, index;
+
+	ZBX_UNUSED(state);
+
+	dc_httpitem_params_test_init();
+
+	hops = zbx_mock_get_parameter_handle("in.ops");
+
+	for (i = 1; ZBX_MOCK_END_OF_VECTOR != (err = zbx_mock_vector_element(hops, &hop)); i++)
+	{
+		if (ZBX_MOCK_SUCCESS != err)
+			fail_msg("Cannot read operation #%d: %s", i, zbx_mock_error_string(err));
+
+		index = (int)zbx_mock_get_object_member_uint64(hop, "item");
+
+		if (0 > index || DC_HTTPITEM_PARAMS_ITEMS_MAX <= index)
+			fail_msg("Invalid item index %d in operation #%d", index, i);
+
+		op = zbx_mock_get_object_member_string(hop, "op");
+
+		if (0 == strcmp(op, "acquire"))
+		{
+			if (NULL != items[index])
+				fail_msg("Item %d already has parameters in operation #%d", index, i);
+
+			items[index] = dc_httpitem_params_test_acquire(zbx_mock_get_object_member_string(hop, "url"),
+					zbx_mock_get_object_member_string(hop, "username"),
+					zbx_mock_get_object_member_string(hop, "password"));
+		}
+		else if (0 == strcmp(op, "release"))
+		{
+			if (NULL == items[index])
+				fail_msg("Item %d has no parameters in operation #%d", index, i);
+
+			dc_httpitem_params_test_release(items[index]);
+			items[index] = NULL;
+		}
+		else
+			fail_msg("Unknown operation \"%s\"", op);
+
+		zbx_snprintf(msg, sizeof(msg), "operation #%d shared parameters", i);
+		zbx_mock_assert_int_eq(msg, (int)zbx_mock_get_object_member_uint64(hop, "params"),
+				dc_httpitem_params_test_num());
+
+		zbx_snprintf(msg, sizeof(msg), "operation #%d interned strings", i);
+		zbx_mock_assert_int_eq(msg, (int)zbx_mock_get_object_member_uint64(hop, "strings"),
+				dc_httpitem_params_test_strings_num());
+
+		/* the reference count of the parameters used by item, checked while they are held */
+		if (ZBX_MOCK_SUCCESS == zbx_mock_object_member(hop, "refcount", &hrefcount))
+		{
+			zbx_uint64_t	refcount;
+
+			if (NULL == items[index])
+				fail_msg("Cannot check reference count of released parameters in operation #%d", i);
+
+			if (ZBX_MOCK_SUCCESS != (err = zbx_mock_uint64(hrefcount, &refcount)))
+				fail_msg("Cannot read reference count: %s", zbx_mock_error_string(err));
+
+			zbx_snprintf(msg, sizeof(msg), "operation #%d reference count", i);
+			zbx_mock_assert_uint64_eq(msg, refcount, items[index]->refcount);
+		}
+	}
+
+	for (i = 0; i < DC_HTTPITEM_PARAMS_ITEMS_MAX; i++)
+	{
+		if (NULL != items[i])
+			dc_httpitem_params_test_release(items[i]);
+	}
+
+	zbx_mock_assert_int_eq("shared parameters after release", 0, dc_httpitem_params_test_num());
+	zbx_mock_assert_int_eq("interned strings after release", 0, dc_httpitem_params_test_strings_num());
+
+	dc_httpitem_params_test_destroy();
+}
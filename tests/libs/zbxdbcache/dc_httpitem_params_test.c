@@ -0,0 +1,76 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "dc_httpitem_params_test.h"
+
+void	dc_httpitem_params_test_init(void)
+{
+	config = (ZBX_DC_CONFIG *)zbx_malloc(NULL, sizeof(ZBX_DC_CONFIG));
+	memset(config, 0, sizeof(ZBX_DC_CONFIG));
+
+	zbx_hashset_create(&config->strpool, 100, __config_strpool_hash, __config_strpool_compare);
+	zbx_hashset_create(&config->httpitem_params, 0, __config_httpitem_params_hash,
+			__config_httpitem_params_compare);
+}
+
+void	dc_httpitem_params_test_destroy(void)
+{
+	zbx_hashset_destroy(&config->httpitem_params);
+	zbx_hashset_destroy(&config->strpool);
+	zbx_free(config);
+}
+
+const zbx_dc_httpitem_params_t	*dc_httpitem_params_test_acquire(const char *url, const char *username,
+		const char *password)
+{
+	zbx_dc_httpitem_params_t	params_local;
+
+	memset(&params_local, 0, sizeof(params_local));
+
+	params_local.timeout = zbx_strpool_intern("3s");
+	params_local.url = zbx_strpool_intern(url);
+	params_local.query_fields = zbx_strpool_intern("");
+	params_local.posts = zbx_strpool_intern("");
+	params_local.status_codes = zbx_strpool_intern("200");
+	params_local.http_proxy = zbx_strpool_intern("");
+	params_local.headers = zbx_strpool_intern("");
+	params_local.ssl_cert_file = zbx_strpool_intern("");
+	params_local.ssl_key_file = zbx_strpool_intern("");
+	params_local.ssl_key_password = zbx_strpool_intern("");
+	params_local.username = zbx_strpool_intern(username);
+	params_local.password = zbx_strpool_intern(password);
+	params_local.trapper_hosts = zbx_strpool_intern("");
+
+	return dc_httpitem_params_acquire(&params_local);
+}
+
+void	dc_httpitem_params_test_release(const zbx_dc_httpitem_params_t *params)
+{
+	dc_httpitem_params_release(params);
+}
+
+int	dc_httpitem_params_test_num(void)
+{
+	return config->httpitem_params.num_data;
+}
+
+int	dc_httpitem_params_test_strings_num(void)
+{
+	return config->strpool.num_data;
+}
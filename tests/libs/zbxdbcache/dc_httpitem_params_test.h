@@ -0,0 +1,31 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#ifndef DC_HTTPITEM_PARAMS_TEST_H
+#define DC_HTTPITEM_PARAMS_TEST_H
+
+void	dc_httpitem_params_test_init(void);
+void	dc_httpitem_params_test_destroy(void);
+const zbx_dc_httpitem_params_t	*dc_httpitem_params_test_acquire(const char *url, const char *username,
+		const char *password);
+void	dc_httpitem_params_test_release(const zbx_dc_httpitem_params_t *params);
+int	dc_httpitem_params_test_num(void);
+int	dc_httpitem_params_test_strings_num(void);
+
+#endif /* DC_HTTPITEM_PARAMS_TEST_H */
@@ -25,13 +25,19 @@ void	zbx_vc_set_mode(int mode)
 	vc_cache->mode_time = time(NULL);
 }
 
+void	zbx_vc_set_sketch_values_min(int values_min)
+{
+	vc_sketch_values_min = values_min;
+}
+
 int	zbx_vc_get_cached_values(zbx_uint64_t itemid, unsigned char value_type, zbx_vector_history_record_t *values)
 {
-	zbx_vc_item_t	*item;
-	int		i;
-	zbx_vc_chunk_t	*chunk;
+	zbx_vc_item_t		*item;
+	int			i;
+	zbx_vc_chunk_t		*chunk;
+	zbx_history_record_t	*slots;
 
-	if (NULL == (item = zbx_hashset_search(&vc_cache->items, &itemid)))
+	if (NULL == (item = zbx_hashset_search(&vc_get_stripe(itemid)->items, &itemid)))
 		return FAIL;
 
 	if (NULL == item->head)
@@ -39,8 +45,10 @@ int	zbx_vc_get_cached_values(zbx_uint64_t itemid, unsigned char value_type, zbx_
 
 	for (chunk = item->tail; NULL != chunk; chunk = chunk->next)
 	{
+		slots = vch_chunk_slots(chunk);
+
 		for (i = chunk->first_value; i <= chunk->last_value; i++)
-			vc_history_record_vector_append(values, value_type, &chunk->slots[i]);
+			vc_history_record_vector_append(values, value_type, &slots[i]);
 	}
 
 	return SUCCEED;
@@ -49,27 +57,34 @@ int	zbx_vc_get_cached_values(zbx_uint64_t itemid, unsigned char value_type, zbx_
 int	zbx_vc_precache_values(zbx_uint64_t itemid, int value_type, int seconds, int count, const zbx_timespec_t *ts)
 {
 	zbx_vc_item_t			*item;
+	zbx_vc_cache_t			*stripe;
 	int				ret;
 	zbx_vector_history_record_t	values;
 
-	/* add item to cache if necessary */
-	if (NULL == (item = (zbx_vc_item_t *)zbx_hashset_search(&vc_cache->items, &itemid)))
+	stripe = vc_get_stripe(itemid);
+
+	/* add item to cache if necessary, locking the stripe so the item is allocated in its memory */
+	WRLOCK_STRIPE(stripe);
+
+	if (NULL == (item = (zbx_vc_item_t *)zbx_hashset_search(&stripe->items, &itemid)))
 	{
 		zbx_vc_item_t   new_item = {.itemid = itemid, .value_type = value_type};
-		item = zbx_hashset_insert(&vc_cache->items, &new_item, sizeof(zbx_vc_item_t));
+		item = zbx_hashset_insert(&stripe->items, &new_item, sizeof(zbx_vc_item_t));
 	}
 
+	UNLOCK_STRIPE(stripe);
+
 	/* perform request to cache values */
 	zbx_history_record_vector_create(&values);
-	RDLOCK_CACHE;
+	RDLOCK_STRIPE(stripe);
 	ret = vch_item_get_values(item, &values, seconds, count, ts);
-	UNLOCK_CACHE;
+	UNLOCK_STRIPE(stripe);
 	zbx_vc_flush_stats();
 	zbx_history_record_vector_destroy(&values, value_type);
 
 	/* reset cache statistics */
-	vc_cache->hits = 0;
-	vc_cache->misses = 0;
+	stripe->hits = 0;
+	stripe->misses = 0;
 
 	return ret;
 }
@@ -80,7 +95,7 @@ int	zbx_vc_get_item_state(zbx_uint64_t itemid, int *status, int *active_range, i
 	zbx_vc_item_t	*item;
 	int		ret = FAIL;
 
-	if (NULL != (item = (zbx_vc_item_t *)zbx_hashset_search(&vc_cache->items, &itemid)))
+	if (NULL != (item = (zbx_vc_item_t *)zbx_hashset_search(&vc_get_stripe(itemid)->items, &itemid)))
 	{
 		*status = item->status;
 		*active_range = item->active_range;
@@ -104,3 +119,73 @@ int	zbx_vc_get_cache_state(int *mode, zbx_uint64_t *hits, zbx_uint64_t *misses)
 
 	return SUCCEED;
 }
+
+static int	vc_stripe_owns(const zbx_vc_cache_t *stripe, const void *ptr)
+{
+	if ((const char *)ptr < (const char *)stripe->mem->lo_bound ||
+			(const char *)ptr >= (const char *)stripe->mem->hi_bound)
+	{
+		return FAIL;
+	}
+
+	return SUCCEED;
+}
+
+int	zbx_vc_check_stripes(char **error)
+{
+	int			i;
+	zbx_vc_cache_t		*stripe;
+	zbx_vc_item_t		*item;
+	zbx_vc_chunk_t		*chunk;
+	zbx_hashset_iter_t	iter;
+
+	for (i = 0; i < vc_stripes_num; i++)
+	{
+		stripe = vc_stripes[i];
+
+		if (stripe->index != i || FAIL == vc_stripe_owns(stripe, stripe) ||
+				FAIL == vc_stripe_owns(stripe, stripe->items.slots))
+		{
+			*error = zbx_dsprintf(*error, "stripe #%d is not allocated in its own memory", i);
+			return FAIL;
+		}
+
+		if (FAIL == zbx_rwlock_trywrlock(stripe->lock))
+		{
+			*error = zbx_dsprintf(*error, "stripe #%d is left locked", i);
+			return FAIL;
+		}
+
+		zbx_rwlock_unlock(stripe->lock);
+
+		zbx_hashset_iter_reset(&stripe->items, &iter);
+		while (NULL != (item = (zbx_vc_item_t *)zbx_hashset_iter_next(&iter)))
+		{
+			if (vc_get_stripe_index(item->itemid) != i)
+			{
+				*error = zbx_dsprintf(*error, "item " ZBX_FS_UI64 " is cached in wrong stripe #%d",
+						item->itemid, i);
+				return FAIL;
+			}
+
+			if (FAIL == vc_stripe_owns(stripe, item))
+			{
+				*error = zbx_dsprintf(*error, "item " ZBX_FS_UI64 " is not allocated in stripe #%d"
+						" memory", item->itemid, i);
+				return FAIL;
+			}
+
+			for (chunk = item->tail; NULL != chunk; chunk = chunk->next)
+			{
+				if (FAIL == vc_stripe_owns(stripe, chunk))
+				{
+					*error = zbx_dsprintf(*error, "item " ZBX_FS_UI64 " chunk is not allocated in"
+							" stripe #%d memory", item->itemid, i);
+					return FAIL;
+				}
+			}
+		}
+	}
+
+	return SUCCEED;
+}
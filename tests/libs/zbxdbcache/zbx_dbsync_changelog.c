@@ -0,0 +1,173 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "zbxmocktest.h"
+#include "zbxmockdata.h"
+#include "zbxmockassert.h"
+#include "zbxmockutil.h"
+#include "zbxmockdb.h"
+
+#include "common.h"
+#include "zbxalgo.h"
+#define ZBX_DBCONFIG_IMPL
+#include "dbcache.h"
+#include "dbconfig.h"
+#include "dbsync.h"
+
+typedef struct
+{
+	zbx_uint64_t	hostid;
+	unsigned char	tag;
+}
+zbx_mock_sync_row_t;
+
+static unsigned char	dbsync_mock_str_to_tag(const char *str)
+{
+	if (0 == strcmp(str, "ADD"))
+		return ZBX_DBSYNC_ROW_ADD;
+
+	if (0 == strcmp(str, "UPDATE"))
+		return ZBX_DBSYNC_ROW_UPDATE;
+
+	if (0 == strcmp(str, "REMOVE"))
+		return ZBX_DBSYNC_ROW_REMOVE;
+
+	fail_msg("Unknown row tag \"%s\"", str);
+
+	return ZBX_DBSYNC_ROW_NONE;
+}
+
+static int	dbsync_mock_row_compare(const void *d1, const void *d2)
+{
+	const zbx_mock_sync_row_t	*r1 = *(const zbx_mock_sync_row_t * const *)d1;
+	const zbx_mock_sync_row_t	*r2 = *(const zbx_mock_sync_row_t * const *)d2;
+
+	ZBX_RETURN_IF_NOT_EQUAL(r1->hostid, r2->hostid);
+
+	return 0;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: dbsync_mock_sync_hosts                                           *
+ *                                                                            *
+ * Purpose: performs host synchronization as configuration syncer does and    *
+ *          returns changed rows sorted by host identifier                    *
+ *                                                                            *
+ ******************************************************************************/
+static void	dbsync_mock_sync_hosts(ZBX_DC_CONFIG *cache, zbx_vector_ptr_t *rows)
+{
+	zbx_dbsync_t		sync;
+	zbx_uint64_t		rowid;
+	char			**row;
+	unsigned char		tag;
+	zbx_mock_sync_row_t	*sync_row;
+
+	zbx_dbsync_init_env(cache);
+	zbx_dbsync_env_prepare(ZBX_DBSYNC_UPDATE);
+	zbx_dbsync_init(&sync, ZBX_DBSYNC_UPDATE);
+
+	if (SUCCEED != zbx_dbsync_compare_hosts(&sync))
+		fail_msg("Cannot compare hosts");
+
+	while (SUCCEED == zbx_dbsync_next(&sync, &rowid, &row, &tag))
+	{
+		sync_row = (zbx_mock_sync_row_t *)zbx_malloc(NULL, sizeof(zbx_mock_sync_row_t));
+		sync_row->hostid = rowid;
+		sync_row->tag = tag;
+		zbx_vector_ptr_append(rows, sync_row);
+	}
+
+	zbx_vector_ptr_sort(rows, dbsync_mock_row_compare);
+
+	zbx_dbsync_env_flush_changelog();
+	zbx_dbsync_clear(&sync);
+	zbx_dbsync_free_env();
+}
+
+void	zbx_mock_test_entry(void **state)
+{
+	ZBX_DC_CONFIG		cache;
+	ZBX_DC_HOST		host_local;
+	zbx_mock_handle_t	hhosts, hhost, hsyncs, hsync, hrows, hrow;
+	zbx_mock_error_t	err;
+	zbx_vector_ptr_t	rows;
+	zbx_mock_sync_row_t	*sync_row;
+	int			i, j;
+	char			msg[MAX_STRING_LEN];
+
+	ZBX_UNUSED(state);
+
+	zbx_mockdb_init();
+
+	memset(&cache, 0, sizeof(cache));
+	zbx_hashset_create(&cache.hosts, 10, ZBX_DEFAULT_UINT64_HASH_FUNC, ZBX_DEFAULT_UINT64_COMPARE_FUNC);
+
+	hhosts = zbx_mock_get_parameter_handle("in.hosts");
+	while (ZBX_MOCK_END_OF_VECTOR != (err = (zbx_mock_vector_element(hhosts, &hhost))))
+	{
+		if (ZBX_MOCK_SUCCESS != err)
+			fail_msg("Cannot read cached host: %s", zbx_mock_error_string(err));
+
+		memset(&host_local, 0, sizeof(host_local));
+		host_local.hostid = zbx_mock_get_object_member_uint64(hhost, "hostid");
+		host_local.proxy_hostid = zbx_mock_get_object_member_uint64(hhost, "proxy_hostid");
+		zbx_hashset_insert(&cache.hosts, &host_local, sizeof(host_local));
+	}
+
+	zbx_vector_ptr_create(&rows);
+
+	hsyncs = zbx_mock_get_parameter_handle("out.syncs");
+	for (i = 1; ZBX_MOCK_END_OF_VECTOR != (err = (zbx_mock_vector_element(hsyncs, &hsync))); i++)
+	{
+		if (ZBX_MOCK_SUCCESS != err)
+			fail_msg("Cannot read synchronization #%d: %s", i, zbx_mock_error_string(err));
+
+		dbsync_mock_sync_hosts(&cache, &rows);
+
+		hrows = zbx_mock_get_object_member_handle(hsync, "rows");
+		for (j = 0; ZBX_MOCK_END_OF_VECTOR != (err = (zbx_mock_vector_element(hrows, &hrow))); j++)
+		{
+			if (ZBX_MOCK_SUCCESS != err)
+				fail_msg("Cannot read synchronization #%d row #%d: %s", i, j + 1, zbx_mock_error_string(err));
+
+			if (j >= rows.values_num)
+				fail_msg("Synchronization #%d returned fewer rows (%d) than expected", i, rows.values_num);
+
+			sync_row = (zbx_mock_sync_row_t *)rows.values[j];
+
+			zbx_snprintf(msg, sizeof(msg), "synchronization #%d row #%d hostid", i, j + 1);
+			zbx_mock_assert_uint64_eq(msg, zbx_mock_get_object_member_uint64(hrow, "hostid"),
+					sync_row->hostid);
+
+			zbx_snprintf(msg, sizeof(msg), "synchronization #%d row #%d tag", i, j + 1);
+			zbx_mock_assert_int_eq(msg, dbsync_mock_str_to_tag(
+					zbx_mock_get_object_member_string(hrow, "tag")), sync_row->tag);
+		}
+
+		zbx_snprintf(msg, sizeof(msg), "synchronization #%d rows", i);
+		zbx_mock_assert_int_eq(msg, j, rows.values_num);
+
+		zbx_vector_ptr_clear_ext(&rows, zbx_ptr_free);
+	}
+
+	zbx_vector_ptr_destroy(&rows);
+	zbx_hashset_destroy(&cache.hosts);
+	zbx_mockdb_destroy();
+}
@@ -0,0 +1,140 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "zbxmocktest.h"
+#include "zbxmockdata.h"
+#include "zbxmockassert.h"
+#include "zbxmockutil.h"
+#include "zbxmockdb.h"
+
+#include "common.h"
+#include "zbxalgo.h"
+#define ZBX_DBCONFIG_IMPL
+#include "dbcache.h"
+#include "dbconfig.h"
+#include "dbsync.h"
+
+extern char	*CONFIG_CONFIG_CACHE_SNAPSHOT_FILE;
+
+/******************************************************************************
+ *                                                                            *
+ * Function: dbsync_mock_sync_hosts                                           *
+ *                                                                            *
+ * Purpose: performs initial host synchronization and checks the rows         *
+ *                                                                            *
+ * Parameters: cache - [IN] the configuration cache                           *
+ *             save  - [IN] 1 - save snapshot after synchronization           *
+ *             pass  - [IN] the synchronization description for messages      *
+ *                                                                            *
+ ******************************************************************************/
+static void	dbsync_mock_sync_hosts(ZBX_DC_CONFIG *cache, int save, const char *pass)
+{
+	zbx_dbsync_t		sync;
+	zbx_uint64_t		rowid;
+	char			**row, msg[MAX_STRING_LEN];
+	unsigned char		tag;
+	zbx_mock_handle_t	hrows, hrow, hfield;
+	zbx_mock_error_t	err;
+	const char		*value;
+	int			i, j;
+
+	zbx_dbsync_init_env(cache);
+	zbx_dbsync_env_prepare(ZBX_DBSYNC_INIT);
+	zbx_dbsync_init(&sync, ZBX_DBSYNC_INIT);
+
+	if (SUCCEED != zbx_dbsync_compare_hosts(&sync))
+		fail_msg("Cannot compare hosts during %s", pass);
+
+	hrows = zbx_mock_get_parameter_handle("out.rows");
+
+	for (i = 0; SUCCEED == zbx_dbsync_next(&sync, &rowid, &row, &tag); i++)
+	{
+		if (ZBX_MOCK_SUCCESS != (err = zbx_mock_vector_element(hrows, &hrow)))
+			fail_msg("Unexpected row #%d during %s: %s", i + 1, pass, zbx_mock_error_string(err));
+
+		/* only the columns selected by the current build are compared */
+		for (j = 0; j < sync.columns_num; j++)
+		{
+			if (ZBX_MOCK_SUCCESS != (err = zbx_mock_vector_element(hrow, &hfield)) ||
+					ZBX_MOCK_SUCCESS != (err = zbx_mock_string(hfield, &value)))
+			{
+				fail_msg("Cannot read row #%d column #%d: %s", i + 1, j + 1, zbx_mock_error_string(err));
+			}
+
+			zbx_snprintf(msg, sizeof(msg), "%s row #%d column #%d", pass, i + 1, j + 1);
+			zbx_mock_assert_str_eq(msg, value, row[j]);
+		}
+	}
+
+	if (ZBX_MOCK_END_OF_VECTOR != zbx_mock_vector_element(hrows, &hrow))
+		fail_msg("Fewer rows than expected (%d) during %s", i, pass);
+
+	if (0 != save)
+		zbx_dbsync_env_save_snapshot();
+
+	zbx_dbsync_clear(&sync);
+	zbx_dbsync_free_env();
+}
+
+void	zbx_mock_test_entry(void **state)
+{
+	ZBX_DC_CONFIG	cache;
+	char		dir[] = "/tmp/zbx_csnp_XXXXXX";
+	zbx_stat_t	st;
+	int		expected_ret;
+
+	ZBX_UNUSED(state);
+
+	if (NULL == mkdtemp(dir))
+		fail_msg("cannot create snapshot directory: %s", zbx_strerror(errno));
+
+	zbx_mock_set_real_dir(dir);
+	CONFIG_CONFIG_CACHE_SNAPSHOT_FILE = zbx_dsprintf(NULL, "%s/zabbix_config.snapshot", dir);
+
+	zbx_mockdb_init();
+	memset(&cache, 0, sizeof(cache));
+
+	/* full synchronization selects rows from database and saves them into snapshot */
+	dbsync_mock_sync_hosts(&cache, 1, "saving synchronization");
+	zbx_mock_assert_int_eq("snapshot saved by synchronization", FAIL, zbx_dbsync_snapshot_loaded());
+
+	if (0 != zbx_stat(CONFIG_CONFIG_CACHE_SNAPSHOT_FILE, &st))
+		fail_msg("cannot stat snapshot file: %s", zbx_strerror(errno));
+
+	zbx_mock_assert_int_eq("snapshot file permissions", S_IRUSR | S_IWUSR, (int)(st.st_mode & 0777));
+
+	if (0 != chmod(CONFIG_CONFIG_CACHE_SNAPSHOT_FILE,
+			(mode_t)strtol(zbx_mock_get_parameter_string("in.permissions"), NULL, 8)))
+	{
+		fail_msg("cannot change snapshot file permissions: %s", zbx_strerror(errno));
+	}
+
+	/* initial synchronization after restart takes rows from snapshot if it is valid */
+	dbsync_mock_sync_hosts(&cache, 0, "loading synchronization");
+
+	expected_ret = zbx_mock_str_to_return_code(zbx_mock_get_parameter_string("out.loaded"));
+	zbx_mock_assert_int_eq("snapshot loaded", expected_ret, zbx_dbsync_snapshot_loaded());
+
+	zbx_mockdb_destroy();
+
+	unlink(CONFIG_CONFIG_CACHE_SNAPSHOT_FILE);
+	rmdir(dir);
+	zbx_free(CONFIG_CONFIG_CACHE_SNAPSHOT_FILE);
+	zbx_mock_set_real_dir(NULL);
+}
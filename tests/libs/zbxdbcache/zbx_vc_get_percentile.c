@@ -0,0 +1,164 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "zbxmocktest.h"
+#include "zbxmockdata.h"
+#include "zbxmockassert.h"
+#include "zbxmockutil.h"
+
+#include "common.h"
+#include "valuecache.h"
+#include "valuecache_test.h"
+#include "mocks/valuecache/valuecache_mock.h"
+
+extern zbx_uint64_t	CONFIG_VALUE_CACHE_SIZE;
+extern int		CONFIG_VALUE_CACHE_PERCENTILE_SKETCH;
+
+/* the percentile sketch relative error */
+#define VCMOCK_SKETCH_ACCURACY	0.01
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vcmock_check_percentile                                          *
+ *                                                                            *
+ * Purpose: checks if the estimated percentile is within sketch accuracy from *
+ *          the exact percentile value                                        *
+ *                                                                            *
+ ******************************************************************************/
+static void	vcmock_check_percentile(zbx_mock_handle_t handle, unsigned char value_type,
+		const history_value_t *value)
+{
+	double	expected, returned, delta;
+
+	expected = zbx_mock_get_object_member_float(handle, "value");
+
+	if (ITEM_VALUE_TYPE_FLOAT == value_type)
+	{
+		returned = value->dbl;
+		delta = fabs(expected) * VCMOCK_SKETCH_ACCURACY;
+	}
+	else
+	{
+		returned = (double)value->ui64;
+		/* unsigned estimates are rounded to the nearest integer */
+		delta = fabs(expected) * VCMOCK_SKETCH_ACCURACY + 0.5;
+	}
+
+	if (delta < fabs(returned - expected))
+		fail_msg("Expected percentile value %f while got %f", expected, returned);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_mock_test_entry                                              *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_mock_test_entry(void **state)
+{
+	char			*error = NULL;
+	int			err, seconds, count;
+	double			percentage;
+	zbx_timespec_t		ts;
+	zbx_uint64_t		itemid;
+	unsigned char		value_type;
+	history_value_t		value;
+	zbx_vector_ptr_t	history;
+	zbx_mock_handle_t	handle, hrequests, hrequest, hresults, hresult, hvalues;
+	zbx_mock_error_t	mock_err;
+
+	ZBX_UNUSED(state);
+
+	/* the cache must hold all test values together with window sketches */
+	CONFIG_VALUE_CACHE_SIZE = 128 * ZBX_KIBIBYTE;
+	CONFIG_VALUE_CACHE_PERCENTILE_SKETCH = 1;
+
+	err = zbx_locks_create(&error);
+	zbx_mock_assert_result_eq("Lock initialization failed", SUCCEED, err);
+
+	err = zbx_vc_init(&error);
+	zbx_mock_assert_result_eq("Value cache initialization failed", SUCCEED, err);
+
+	zbx_vc_enable();
+
+	/* use sketches also for the small test windows */
+	zbx_vc_set_sketch_values_min((int)zbx_mock_get_parameter_uint64("in.sketch values min"));
+
+	zbx_vcmock_ds_init();
+	zbx_vector_ptr_create(&history);
+
+	/* precache values */
+	if (ZBX_MOCK_SUCCESS == zbx_mock_parameter("in.precache", &handle))
+	{
+		while (ZBX_MOCK_END_OF_VECTOR != (mock_err = (zbx_mock_vector_element(handle, &hrequest))))
+		{
+			zbx_vcmock_set_time(hrequest, "time");
+			zbx_vcmock_get_request_params(hrequest, &itemid, &value_type, &seconds, &count, &ts);
+			zbx_vc_precache_values(itemid, value_type, seconds, count, &ts);
+		}
+	}
+
+	/* perform requests, optionally adding new values before each request */
+
+	hrequests = zbx_mock_get_parameter_handle("in.requests");
+	hresults = zbx_mock_get_parameter_handle("out.percentiles");
+
+	while (ZBX_MOCK_END_OF_VECTOR != (mock_err = (zbx_mock_vector_element(hrequests, &hrequest))))
+	{
+		if (ZBX_MOCK_SUCCESS != zbx_mock_vector_element(hresults, &hresult))
+			fail_msg("Missing out.percentiles element");
+
+		zbx_vcmock_set_time(hrequest, "time");
+
+		if (ZBX_MOCK_SUCCESS == zbx_mock_object_member(hrequest, "values", &hvalues))
+		{
+			zbx_vcmock_get_dc_history(hvalues, &history);
+			err = zbx_vc_add_values(&history);
+			zbx_mock_assert_result_eq("zbx_vc_add_values() return value", SUCCEED, err);
+			zbx_vector_ptr_clear_ext(&history, zbx_vcmock_free_dc_history);
+		}
+
+		if (FAIL == is_uint64(zbx_mock_get_object_member_string(hrequest, "itemid"), &itemid))
+			fail_msg("Invalid itemid value");
+
+		value_type = zbx_mock_str_to_value_type(zbx_mock_get_object_member_string(hrequest, "value type"));
+		seconds = atoi(zbx_mock_get_object_member_string(hrequest, "seconds"));
+		zbx_strtime_to_timespec(zbx_mock_get_object_member_string(hrequest, "end"), &ts);
+		percentage = zbx_mock_get_object_member_float(hrequest, "percentage");
+
+		err = zbx_vc_get_percentile(itemid, value_type, seconds, &ts, percentage, &value);
+		zbx_vc_flush_stats();
+
+		zbx_mock_assert_result_eq("zbx_vc_get_percentile() return value",
+				zbx_mock_str_to_return_code(zbx_mock_get_object_member_string(hresult, "return")), err);
+
+		if (SUCCEED != err)
+			continue;
+
+		vcmock_check_percentile(hresult, value_type, &value);
+	}
+
+	/* cleanup */
+
+	zbx_vector_ptr_destroy(&history);
+
+	zbx_vcmock_ds_destroy();
+
+	zbx_vc_reset();
+	zbx_vc_destroy();
+}
@@ -28,6 +28,7 @@
 #include "mocks/valuecache/valuecache_mock.h"
 
 extern zbx_uint64_t	CONFIG_VALUE_CACHE_SIZE;
+extern int		CONFIG_VALUE_CACHE_COMPRESSION;
 
 /******************************************************************************
  *                                                                            *
@@ -52,6 +53,9 @@ void	zbx_mock_test_entry(void **state)
 	/* set small cache size to force smaller cache free request size (5% of cache size) */
 	CONFIG_VALUE_CACHE_SIZE = ZBX_KIBIBYTE;
 
+	if (ZBX_MOCK_SUCCESS == zbx_mock_parameter("in.compression", &handle))
+		CONFIG_VALUE_CACHE_COMPRESSION = (int)zbx_mock_get_parameter_uint64("in.compression");
+
 	err = zbx_locks_create(&error);
 	zbx_mock_assert_result_eq("Lock initialization failed", SUCCEED, err);
 
@@ -0,0 +1,263 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "zbxmocktest.h"
+#include "zbxmockdata.h"
+#include "zbxmockassert.h"
+#include "zbxmockutil.h"
+
+#include "common.h"
+#include "valuecache.h"
+#include "valuecache_test.h"
+#include "mocks/valuecache/valuecache_mock.h"
+
+extern zbx_uint64_t	CONFIG_VALUE_CACHE_SIZE;
+extern int		CONFIG_VALUE_CACHE_STRIPES;
+extern char		*CONFIG_VALUE_CACHE_SNAPSHOT_FILE;
+
+#define VCTEST_ITEMS_MAX	16
+
+/* the cache size of each stripe */
+#define VCTEST_STRIPE_SIZE	(512 * ZBX_KIBIBYTE)
+
+/* the cached item state saved before snapshot */
+typedef struct
+{
+	zbx_uint64_t			itemid;
+	unsigned char			value_type;
+	int				status;
+	int				active_range;
+	int				values_total;
+	int				db_cached_from;
+	zbx_vector_history_record_t	values;
+}
+vctest_item_t;
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vctest_start                                                     *
+ *                                                                            *
+ * Purpose: initializes value cache, loading snapshot file if it exists       *
+ *                                                                            *
+ ******************************************************************************/
+static void	vctest_start(void)
+{
+	char	*error = NULL;
+
+	if (SUCCEED != zbx_vc_init(&error))
+		fail_msg("Value cache initialization failed: %s", error);
+
+	zbx_vc_enable();
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vctest_get_size                                                  *
+ *                                                                            *
+ * Purpose: returns the size of snapshot file                                 *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_uint64_t	vctest_get_size(const char *filename)
+{
+	zbx_stat_t	st;
+
+	if (0 != zbx_stat(filename, &st))
+		fail_msg("Cannot get value cache snapshot file \"%s\" size: %s", filename, zbx_strerror(errno));
+
+	return (zbx_uint64_t)st.st_size;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vctest_damage_snapshot                                           *
+ *                                                                            *
+ * Purpose: truncates or corrupts snapshot file as specified in input data    *
+ *                                                                            *
+ * Comments: The damage offsets are counted from the end of file, so they     *
+ *           point into item records regardless of the header size.           *
+ *                                                                            *
+ ******************************************************************************/
+static void	vctest_damage_snapshot(const char *filename)
+{
+	zbx_mock_handle_t	handle;
+	zbx_uint64_t		size, offset;
+	unsigned char		byte;
+	int			fd;
+
+	size = vctest_get_size(filename);
+
+	if (ZBX_MOCK_SUCCESS == zbx_mock_parameter("in.truncate", &handle))
+	{
+		if (size <= (offset = zbx_mock_get_parameter_uint64("in.truncate")))
+			fail_msg("Cannot truncate " ZBX_FS_UI64 " bytes of " ZBX_FS_UI64 " bytes file", offset, size);
+
+		if (0 != truncate(filename, (off_t)(size - offset)))
+			fail_msg("Cannot truncate value cache snapshot file: %s", zbx_strerror(errno));
+	}
+
+	if (ZBX_MOCK_SUCCESS == zbx_mock_parameter("in.corrupt", &handle))
+	{
+		if (size < (offset = zbx_mock_get_parameter_uint64("in.corrupt")) || 0 == offset)
+			fail_msg("Cannot corrupt byte " ZBX_FS_UI64 " of " ZBX_FS_UI64 " bytes file", offset, size);
+
+		if (-1 == (fd = open(filename, O_RDWR)))
+			fail_msg("Cannot open value cache snapshot file: %s", zbx_strerror(errno));
+
+		if (1 != pread(fd, &byte, 1, (off_t)(size - offset)))
+			fail_msg("Cannot read value cache snapshot file: %s", zbx_strerror(errno));
+
+		byte ^= 0xff;
+
+		if (1 != pwrite(fd, &byte, 1, (off_t)(size - offset)))
+			fail_msg("Cannot write value cache snapshot file: %s", zbx_strerror(errno));
+
+		close(fd);
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_mock_test_entry                                              *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_mock_test_entry(void **state)
+{
+	int				err, i, items_num = 0, loaded, status, active_range, values_total,
+					db_cached_from, seconds, count;
+	char				dir[] = "/tmp/zbx_vcsnp_XXXXXX", *error = NULL;
+	zbx_mock_handle_t		handle, hitem, hstripes;
+	zbx_mock_error_t		mock_err;
+	zbx_timespec_t			ts;
+	zbx_stat_t			st;
+	vctest_item_t			items[VCTEST_ITEMS_MAX], *item;
+	zbx_vector_history_record_t	values;
+
+	ZBX_UNUSED(state);
+
+	if (NULL == mkdtemp(dir))
+		fail_msg("Cannot create value cache snapshot directory: %s", zbx_strerror(errno));
+
+	zbx_mock_set_real_dir(dir);
+
+	if (ZBX_MOCK_SUCCESS == zbx_mock_parameter("in.stripes", &hstripes))
+		CONFIG_VALUE_CACHE_STRIPES = (int)zbx_mock_get_parameter_uint64("in.stripes");
+
+	CONFIG_VALUE_CACHE_SIZE = (zbx_uint64_t)CONFIG_VALUE_CACHE_STRIPES * VCTEST_STRIPE_SIZE;
+	CONFIG_VALUE_CACHE_SNAPSHOT_FILE = zbx_dsprintf(NULL, "%s/zabbix_vc.snapshot", dir);
+
+	if (SUCCEED != zbx_locks_create(&error))
+		fail_msg("Lock initialization failed: %s", error);
+
+	vctest_start();
+
+	zbx_vcmock_ds_init();
+	zbx_history_record_vector_create(&values);
+
+	handle = zbx_mock_get_parameter_handle("in");
+	zbx_vcmock_set_time(handle, "time");
+
+	/* cache items and remember their state */
+
+	handle = zbx_mock_get_parameter_handle("in.precache");
+
+	while (ZBX_MOCK_END_OF_VECTOR != (mock_err = (zbx_mock_vector_element(handle, &hitem))))
+	{
+		if (ZBX_MOCK_SUCCESS != mock_err)
+			fail_msg("Cannot read 'precache' element #%d: %s", items_num, zbx_mock_error_string(mock_err));
+
+		if (VCTEST_ITEMS_MAX == items_num)
+			fail_msg("Too many items");
+
+		item = &items[items_num++];
+
+		zbx_vcmock_get_request_params(hitem, &item->itemid, &item->value_type, &seconds, &count, &ts);
+		err = zbx_vc_precache_values(item->itemid, item->value_type, seconds, count, &ts);
+		zbx_mock_assert_result_eq("zbx_vc_precache_values() return value", SUCCEED, err);
+
+		err = zbx_vc_get_item_state(item->itemid, &item->status, &item->active_range, &item->values_total,
+				&item->db_cached_from);
+		zbx_mock_assert_result_eq("zbx_vc_get_item_state() return value", SUCCEED, err);
+
+		zbx_history_record_vector_create(&item->values);
+		zbx_vc_get_cached_values(item->itemid, item->value_type, &item->values);
+
+		if (0 == item->values.values_num)
+			fail_msg("No values were cached for item " ZBX_FS_UI64, item->itemid);
+	}
+
+	/* save snapshot and restart value cache */
+
+	zbx_mock_assert_result_eq("zbx_vc_snapshot_save() return value", SUCCEED, zbx_vc_snapshot_save());
+
+	zbx_vc_reset();
+	zbx_vc_destroy();
+
+	vctest_damage_snapshot(CONFIG_VALUE_CACHE_SNAPSHOT_FILE);
+
+	vctest_start();
+
+	/* the snapshot must be removed after loading, whether it was valid or not */
+	if (0 == zbx_stat(CONFIG_VALUE_CACHE_SNAPSHOT_FILE, &st))
+		fail_msg("Value cache snapshot file was not removed after loading");
+
+	/* validate that either all items were restored or none were */
+
+	loaded = (0 == strcmp(zbx_mock_get_parameter_string("out.loaded"), "yes") ? SUCCEED : FAIL);
+
+	for (i = 0; i < items_num; i++)
+	{
+		item = &items[i];
+
+		err = zbx_vc_get_item_state(item->itemid, &status, &active_range, &values_total, &db_cached_from);
+
+		if (SUCCEED != loaded)
+		{
+			zbx_mock_assert_result_eq("zbx_vc_get_item_state() return value", FAIL, err);
+			continue;
+		}
+
+		zbx_mock_assert_result_eq("zbx_vc_get_item_state() return value", SUCCEED, err);
+		zbx_mock_assert_int_eq("item.status", item->status, status);
+		zbx_mock_assert_int_eq("item.active_range", item->active_range, active_range);
+		zbx_mock_assert_int_eq("item.values_total", item->values_total, values_total);
+		zbx_mock_assert_time_eq("item.db_cached_from", item->db_cached_from, db_cached_from);
+
+		zbx_vc_get_cached_values(item->itemid, item->value_type, &values);
+		zbx_vcmock_check_records("Cached values", item->value_type, &item->values, &values);
+		zbx_history_record_vector_clean(&values, item->value_type);
+	}
+
+	/* cleanup */
+
+	for (i = 0; i < items_num; i++)
+		zbx_history_record_vector_destroy(&items[i].values, items[i].value_type);
+
+	zbx_vector_history_record_destroy(&values);
+
+	zbx_vcmock_ds_destroy();
+
+	zbx_vc_reset();
+	zbx_vc_destroy();
+
+	zbx_free(CONFIG_VALUE_CACHE_SNAPSHOT_FILE);
+	CONFIG_VALUE_CACHE_STRIPES = 1;
+
+	if (0 != rmdir(dir))
+		fail_msg("Cannot remove value cache snapshot directory: %s", zbx_strerror(errno));
+}
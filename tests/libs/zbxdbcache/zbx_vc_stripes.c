@@ -0,0 +1,285 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "zbxmocktest.h"
+#include "zbxmockdata.h"
+#include "zbxmockassert.h"
+#include "zbxmockutil.h"
+
+#include "common.h"
+#include "dbcache.h"
+#include "valuecache.h"
+#include "valuecache_test.h"
+#include "mocks/valuecache/valuecache_mock.h"
+
+extern zbx_uint64_t	CONFIG_VALUE_CACHE_SIZE;
+extern int		CONFIG_VALUE_CACHE_STRIPES;
+extern int		CONFIG_VALUE_CACHE_COMPRESSION;
+
+/* the requested period of concurrent reads, must be covered by the precached period */
+#define VCTEST_READ_SECONDS	300
+
+/* the cache size of each stripe, large enough to keep all test values */
+#define VCTEST_STRIPE_SIZE	(512 * ZBX_KIBIBYTE)
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vctest_value                                                     *
+ *                                                                            *
+ * Purpose: returns the value added to the item at the specified step         *
+ *                                                                            *
+ ******************************************************************************/
+static double	vctest_value(zbx_uint64_t itemid, int step)
+{
+	return (double)itemid * 1000 + step;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vctest_check_values                                              *
+ *                                                                            *
+ * Purpose: checks that values returned by value cache are the values added   *
+ *          to the item, in descending order                                  *
+ *                                                                            *
+ * Parameters: itemid - [IN] the item id                                      *
+ *             values - [IN] the returned values                              *
+ *             start  - [IN] the timestamp of the first added value           *
+ *                                                                            *
+ * Return value: SUCCEED - the values are consistent                          *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+static int	vctest_check_values(zbx_uint64_t itemid, const zbx_vector_history_record_t *values, int start)
+{
+	int	i, step;
+
+	for (i = 0; i < values->values_num; i++)
+	{
+		step = values->values[i].timestamp.sec - start;
+
+		if (0 > step || vctest_value(itemid, step) != values->values[i].value.dbl)
+			return FAIL;
+
+		if (0 < i && values->values[i - 1].timestamp.sec <= values->values[i].timestamp.sec)
+			return FAIL;
+	}
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vctest_run_process                                               *
+ *                                                                            *
+ * Purpose: adds values of the items owned by process, reading values of all  *
+ *          items between adds                                                *
+ *                                                                            *
+ * Parameters: index     - [IN] the process index                             *
+ *             processes - [IN] the number of processes                       *
+ *             items_num - [IN] the number of items, itemids start with 1     *
+ *             steps     - [IN] the number of values to add to each item      *
+ *             start     - [IN] the timestamp of the first added value        *
+ *                                                                            *
+ * Return value: SUCCEED - all values were added and read back consistently   *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ * Comments: Items are assigned to processes by itemid, so every process      *
+ *           writes into all stripes while other processes read them.         *
+ *                                                                            *
+ ******************************************************************************/
+static int	vctest_run_process(int index, int processes, int items_num, int steps, int start)
+{
+	int				i, step, ret = FAIL;
+	zbx_uint64_t			itemid;
+	ZBX_DC_HISTORY			*hist;
+	zbx_vector_ptr_t		history;
+	zbx_vector_history_record_t	values;
+	zbx_timespec_t			ts;
+
+	hist = (ZBX_DC_HISTORY *)zbx_malloc(NULL, sizeof(ZBX_DC_HISTORY) * (size_t)items_num);
+	memset(hist, 0, sizeof(ZBX_DC_HISTORY) * (size_t)items_num);
+
+	zbx_vector_ptr_create(&history);
+	zbx_history_record_vector_create(&values);
+
+	for (step = 0; step < steps; step++)
+	{
+		zbx_vector_ptr_clear(&history);
+
+		for (i = 0; i < items_num; i++)
+		{
+			if (index != i % processes)
+				continue;
+
+			hist[i].itemid = (zbx_uint64_t)i + 1;
+			hist[i].value_type = ITEM_VALUE_TYPE_FLOAT;
+			hist[i].value.dbl = vctest_value(hist[i].itemid, step);
+			hist[i].ts.sec = start + step;
+			hist[i].ts.ns = 0;
+
+			zbx_vector_ptr_append(&history, &hist[i]);
+		}
+
+		if (SUCCEED != zbx_vc_add_values(&history))
+			goto out;
+
+		ts = zbx_vcmock_get_ts();
+
+		for (itemid = 1; itemid <= (zbx_uint64_t)items_num; itemid++)
+		{
+			if (SUCCEED != zbx_vc_get_values(itemid, ITEM_VALUE_TYPE_FLOAT, &values, VCTEST_READ_SECONDS, 0,
+					&ts))
+			{
+				goto out;
+			}
+
+			if (SUCCEED != vctest_check_values(itemid, &values, start))
+				goto out;
+
+			zbx_history_record_vector_clean(&values, ITEM_VALUE_TYPE_FLOAT);
+		}
+
+		zbx_vc_flush_stats();
+	}
+
+	ret = SUCCEED;
+out:
+	zbx_history_record_vector_destroy(&values, ITEM_VALUE_TYPE_FLOAT);
+	zbx_vector_ptr_destroy(&history);
+	zbx_free(hist);
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_mock_test_entry                                              *
+ *                                                                            *
+ * Comments: The value cache stripes are created in real shared memory and    *
+ *           accessed by forked processes, so stripe locks and the switching  *
+ *           of current stripe memory are exercised concurrently.             *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_mock_test_entry(void **state)
+{
+	int				err, i, processes, items_num, steps, start, status;
+	char				*error = NULL;
+	pid_t				*pids;
+	zbx_uint64_t			itemid;
+	zbx_timespec_t			ts;
+	zbx_vector_history_record_t	values;
+	zbx_mock_handle_t		handle;
+
+	ZBX_UNUSED(state);
+
+	CONFIG_VALUE_CACHE_STRIPES = (int)zbx_mock_get_parameter_uint64("in.stripes");
+	CONFIG_VALUE_CACHE_SIZE = (zbx_uint64_t)CONFIG_VALUE_CACHE_STRIPES * VCTEST_STRIPE_SIZE;
+
+	if (ZBX_MOCK_SUCCESS == zbx_mock_parameter("in.compression", &handle))
+		CONFIG_VALUE_CACHE_COMPRESSION = (int)zbx_mock_get_parameter_uint64("in.compression");
+
+	processes = (int)zbx_mock_get_parameter_uint64("in.processes");
+	items_num = (int)zbx_mock_get_parameter_uint64("in.items");
+	steps = (int)zbx_mock_get_parameter_uint64("in.values");
+
+	if (SUCCEED != zbx_locks_create(&error))
+		fail_msg("Lock initialization failed: %s", error);
+
+	if (SUCCEED != zbx_vc_init(&error))
+		fail_msg("Value cache initialization failed: %s", error);
+
+	zbx_vc_enable();
+
+	zbx_vcmock_ds_init();
+	zbx_history_record_vector_create(&values);
+
+	zbx_vcmock_set_time(zbx_mock_get_parameter_handle("in"), "time");
+	ts = zbx_vcmock_get_ts();
+
+	/* the values are added with one second step up to the current time, within the read period */
+	if (steps >= VCTEST_READ_SECONDS)
+		fail_msg("Too many values requested for the read period");
+
+	start = ts.sec - steps + 1;
+
+	/* cache all items, so the added values are stored in their stripes */
+	for (itemid = 1; itemid <= (zbx_uint64_t)items_num; itemid++)
+	{
+		err = zbx_vc_precache_values(itemid, ITEM_VALUE_TYPE_FLOAT, VCTEST_READ_SECONDS * 2, 0, &ts);
+		zbx_mock_assert_result_eq("zbx_vc_precache_values() return value", SUCCEED, err);
+	}
+
+	pids = (pid_t *)zbx_malloc(NULL, sizeof(pid_t) * (size_t)processes);
+
+	for (i = 0; i < processes; i++)
+	{
+		if (-1 == (pids[i] = fork()))
+			fail_msg("Cannot fork test process: %s", zbx_strerror(errno));
+
+		if (0 == pids[i])
+		{
+			/* the forked process must not return into the test framework */
+			_exit(SUCCEED == vctest_run_process(i, processes, items_num, steps, start) ?
+					EXIT_SUCCESS : EXIT_FAILURE);
+		}
+	}
+
+	for (i = 0; i < processes; i++)
+	{
+		if (-1 == waitpid(pids[i], &status, 0))
+			fail_msg("Cannot wait for test process: %s", zbx_strerror(errno));
+
+		if (!WIFEXITED(status) || EXIT_SUCCESS != WEXITSTATUS(status))
+			fail_msg("Test process #%d failed", i);
+	}
+
+	zbx_free(pids);
+
+	/* validate that every item has all its values in its stripe */
+
+	for (itemid = 1; itemid <= (zbx_uint64_t)items_num; itemid++)
+	{
+		err = zbx_vc_get_cached_values(itemid, ITEM_VALUE_TYPE_FLOAT, &values);
+		zbx_mock_assert_result_eq("zbx_vc_get_cached_values() return value", SUCCEED, err);
+		zbx_mock_assert_int_eq("cached values", steps, values.values_num);
+
+		for (i = 0; i < values.values_num; i++)
+		{
+			zbx_mock_assert_int_eq("value timestamp", start + i, values.values[i].timestamp.sec);
+			zbx_mock_assert_double_eq("value", vctest_value(itemid, i), values.values[i].value.dbl);
+		}
+
+		zbx_history_record_vector_clean(&values, ITEM_VALUE_TYPE_FLOAT);
+	}
+
+	if (SUCCEED != zbx_vc_check_stripes(&error))
+		fail_msg("Invalid value cache stripes: %s", error);
+
+	/* cleanup */
+
+	zbx_history_record_vector_destroy(&values, ITEM_VALUE_TYPE_FLOAT);
+
+	zbx_vcmock_ds_destroy();
+
+	zbx_vc_reset();
+	zbx_vc_destroy();
+
+	CONFIG_VALUE_CACHE_STRIPES = 1;
+	CONFIG_VALUE_CACHE_COMPRESSION = 0;
+}
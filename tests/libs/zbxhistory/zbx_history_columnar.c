@@ -0,0 +1,244 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+
+#include "zbxmocktest.h"
+#include "zbxmockdata.h"
+#include "zbxmockassert.h"
+#include "zbxmockutil.h"
+
+#include "common.h"
+#include "zbxalgo.h"
+#include "dbcache.h"
+#include "zbxhistory.h"
+#include "history.h"
+
+extern char	*CONFIG_HISTORY_STORAGE_DIR;
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hcol_mock_get_clock                                              *
+ *                                                                            *
+ * Purpose: reads timestamp in seconds from input data                        *
+ *                                                                            *
+ ******************************************************************************/
+static int	hcol_mock_get_clock(zbx_mock_handle_t handle, const char *name)
+{
+	const char		*data;
+	zbx_timespec_t		ts;
+	zbx_mock_error_t	err;
+
+	data = zbx_mock_get_object_member_string(handle, name);
+
+	if (ZBX_MOCK_SUCCESS != (err = zbx_strtime_to_timespec(data, &ts)))
+		fail_msg("Invalid timestamp \"%s\": %s", data, zbx_mock_error_string(err));
+
+	return ts.sec;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hcol_mock_read_value                                             *
+ *                                                                            *
+ * Purpose: reads history value and timestamp from input data                 *
+ *                                                                            *
+ ******************************************************************************/
+static void	hcol_mock_read_value(zbx_mock_handle_t hvalue, unsigned char value_type, history_value_t *value,
+		zbx_timespec_t *ts)
+{
+	const char		*data;
+	zbx_mock_error_t	err;
+
+	data = zbx_mock_get_object_member_string(hvalue, "value");
+
+	if (ITEM_VALUE_TYPE_FLOAT == value_type)
+		value->dbl = atof(data);
+	else if (FAIL == is_uint64(data, &value->ui64))
+		fail_msg("Invalid uint64 value \"%s\"", data);
+
+	data = zbx_mock_get_object_member_string(hvalue, "ts");
+
+	if (ZBX_MOCK_SUCCESS != (err = zbx_strtime_to_timespec(data, ts)))
+		fail_msg("Invalid value timestamp \"%s\": %s", data, zbx_mock_error_string(err));
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hcol_mock_flush_values                                           *
+ *                                                                            *
+ * Purpose: writes a batch of values into history storage                     *
+ *                                                                            *
+ ******************************************************************************/
+static void	hcol_mock_flush_values(zbx_history_iface_t *hist, zbx_mock_handle_t hvalues)
+{
+	zbx_mock_handle_t	hvalue;
+	zbx_vector_ptr_t	history;
+	ZBX_DC_HISTORY		*h;
+
+	zbx_vector_ptr_create(&history);
+
+	while (ZBX_MOCK_END_OF_VECTOR != zbx_mock_vector_element(hvalues, &hvalue))
+	{
+		h = (ZBX_DC_HISTORY *)zbx_malloc(NULL, sizeof(ZBX_DC_HISTORY));
+		memset(h, 0, sizeof(ZBX_DC_HISTORY));
+
+		if (FAIL == is_uint64(zbx_mock_get_object_member_string(hvalue, "itemid"), &h->itemid))
+			fail_msg("Invalid itemid");
+
+		h->value_type = hist->value_type;
+		hcol_mock_read_value(hvalue, hist->value_type, &h->value, &h->ts);
+		zbx_vector_ptr_append(&history, h);
+	}
+
+	zbx_mock_assert_int_eq("add_values()", history.values_num, hist->add_values(hist, &history));
+	zbx_mock_assert_result_eq("flush()", SUCCEED, hist->flush(hist));
+
+	zbx_vector_ptr_clear_ext(&history, zbx_ptr_free);
+	zbx_vector_ptr_destroy(&history);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hcol_mock_check_request                                          *
+ *                                                                            *
+ * Purpose: reads item values from history storage and compares them with    *
+ *          expected values                                                   *
+ *                                                                            *
+ ******************************************************************************/
+static void	hcol_mock_check_request(zbx_history_iface_t *hist, zbx_mock_handle_t hrequest)
+{
+	zbx_uint64_t			itemid;
+	int				i, start = 0, count, end;
+	zbx_mock_handle_t		hvalues, hvalue;
+	zbx_vector_history_record_t	values;
+	zbx_history_record_t		expected;
+
+	if (FAIL == is_uint64(zbx_mock_get_object_member_string(hrequest, "itemid"), &itemid))
+		fail_msg("Invalid itemid");
+
+	if (ZBX_MOCK_SUCCESS == zbx_mock_object_member(hrequest, "start", &hvalue))
+		start = hcol_mock_get_clock(hrequest, "start");
+
+	end = hcol_mock_get_clock(hrequest, "end");
+	count = atoi(zbx_mock_get_object_member_string(hrequest, "count"));
+
+	zbx_history_record_vector_create(&values);
+
+	zbx_mock_assert_result_eq("get_values()", SUCCEED, hist->get_values(hist, itemid, start, count, end,
+			&values));
+
+	hvalues = zbx_mock_get_object_member_handle(hrequest, "values");
+
+	for (i = 0; ZBX_MOCK_END_OF_VECTOR != zbx_mock_vector_element(hvalues, &hvalue); i++)
+	{
+		if (i >= values.values_num)
+			fail_msg("Expected more than %d values", values.values_num);
+
+		hcol_mock_read_value(hvalue, hist->value_type, &expected.value, &expected.timestamp);
+		zbx_mock_assert_timespec_eq("value timestamp", &expected.timestamp, &values.values[i].timestamp);
+
+		if (ITEM_VALUE_TYPE_FLOAT == hist->value_type)
+			zbx_mock_assert_double_eq("value", expected.value.dbl, values.values[i].value.dbl);
+		else
+			zbx_mock_assert_uint64_eq("value", expected.value.ui64, values.values[i].value.ui64);
+	}
+
+	zbx_mock_assert_int_eq("number of values", i, values.values_num);
+
+	zbx_history_record_vector_destroy(&values, hist->value_type);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hcol_mock_remove_dir                                             *
+ *                                                                            *
+ * Purpose: removes history storage directory with partition files           *
+ *                                                                            *
+ ******************************************************************************/
+static void	hcol_mock_remove_dir(const char *path)
+{
+	DIR		*dir;
+	struct dirent	*entry;
+	char		*file;
+
+	if (NULL == (dir = opendir(path)))
+		return;
+
+	while (NULL != (entry = readdir(dir)))
+	{
+		if ('.' == *entry->d_name)
+			continue;
+
+		file = zbx_dsprintf(NULL, "%s/%s", path, entry->d_name);
+		unlink(file);
+		zbx_free(file);
+	}
+
+	closedir(dir);
+	rmdir(path);
+}
+
+void	zbx_mock_test_entry(void **state)
+{
+	char			*error = NULL, dir[] = "/tmp/zbx_hcol_XXXXXX";
+	unsigned char		value_type;
+	zbx_history_iface_t	hist;
+	zbx_mock_handle_t	hbatches, hbatch, hrequests, hrequest, hhousekeep;
+
+	ZBX_UNUSED(state);
+
+	if (NULL == mkdtemp(dir))
+		fail_msg("cannot create history storage directory: %s", zbx_strerror(errno));
+
+	CONFIG_HISTORY_STORAGE_DIR = dir;
+	zbx_mock_set_real_dir(dir);
+
+	value_type = zbx_mock_str_to_value_type(zbx_mock_get_parameter_string("in.value type"));
+
+	memset(&hist, 0, sizeof(hist));
+
+	if (SUCCEED != zbx_history_columnar_init(&hist, value_type, &error))
+		fail_msg("cannot initialize history storage: %s", error);
+
+	hbatches = zbx_mock_get_parameter_handle("in.batches");
+
+	while (ZBX_MOCK_END_OF_VECTOR != zbx_mock_vector_element(hbatches, &hbatch))
+		hcol_mock_flush_values(&hist, hbatch);
+
+	if (ZBX_MOCK_SUCCESS == zbx_mock_parameter("in.housekeep", &hhousekeep))
+	{
+		int	keep_from = 0, removed;
+
+		if (ZBX_MOCK_SUCCESS == zbx_mock_object_member(hhousekeep, "keep from", &hrequest))
+			keep_from = hcol_mock_get_clock(hhousekeep, "keep from");
+
+		removed = hist.housekeep(&hist, hcol_mock_get_clock(hhousekeep, "now"), keep_from);
+		zbx_mock_assert_int_eq("removed values", (int)zbx_mock_get_parameter_uint64("out.removed"), removed);
+	}
+
+	hrequests = zbx_mock_get_parameter_handle("out.requests");
+
+	while (ZBX_MOCK_END_OF_VECTOR != zbx_mock_vector_element(hrequests, &hrequest))
+		hcol_mock_check_request(&hist, hrequest);
+
+	hist.destroy(&hist);
+	hcol_mock_remove_dir(dir);
+	zbx_mock_set_real_dir(NULL);
+	CONFIG_HISTORY_STORAGE_DIR = NULL;
+}
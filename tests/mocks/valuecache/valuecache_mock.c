@@ -51,8 +51,11 @@ void	__wrap___zbx_mem_free(const char *file, int line, zbx_mem_info_t *info, voi
 void	__wrap_zbx_mem_dump_stats(int level, zbx_mem_info_t *info);
 int	__wrap_zbx_history_get_values(zbx_uint64_t itemid, int value_type, int start, int count, int end,
 		zbx_vector_history_record_t *values);
+int	__wrap_zbx_history_get_values_multi(const zbx_vector_uint64_t *itemids, int value_type, int start, int end,
+		zbx_vector_history_record_t *values);
 int	__wrap_zbx_history_add_values(const zbx_vector_ptr_t *history);
 int	__wrap_zbx_history_sql_init(zbx_history_iface_t *hist, unsigned char value_type, char **error);
+int	__wrap_zbx_history_columnar_init(zbx_history_iface_t *hist, unsigned char value_type, char **error);
 int	__wrap_zbx_history_elastic_init(zbx_history_iface_t *hist, unsigned char value_type, char **error);
 void	__wrap_zbx_elastic_version_extract(void);
 int	__wrap_zbx_elastic_version_get(void);
@@ -638,6 +641,17 @@ int	__wrap_zbx_history_get_values(zbx_uint64_t itemid, int value_type, int start
 	return SUCCEED;
 }
 
+int	__wrap_zbx_history_get_values_multi(const zbx_vector_uint64_t *itemids, int value_type, int start, int end,
+		zbx_vector_history_record_t *values)
+{
+	int	i;
+
+	for (i = 0; i < itemids->values_num; i++)
+		__wrap_zbx_history_get_values(itemids->values[i], value_type, start, 0, end, &values[i]);
+
+	return SUCCEED;
+}
+
 int	__wrap_zbx_history_add_values(const zbx_vector_ptr_t *history)
 {
 	int			i;
@@ -678,6 +692,15 @@ int	__wrap_zbx_history_sql_init(zbx_history_iface_t *hist, unsigned char value_t
 	return SUCCEED;
 }
 
+int	__wrap_zbx_history_columnar_init(zbx_history_iface_t *hist, unsigned char value_type, char **error)
+{
+	ZBX_UNUSED(hist);
+	ZBX_UNUSED(value_type);
+	ZBX_UNUSED(error);
+
+	return SUCCEED;
+}
+
 int	__wrap_zbx_history_elastic_init(zbx_history_iface_t *hist, unsigned char value_type, char **error)
 {
 	ZBX_UNUSED(hist);
@@ -23,13 +23,17 @@
 
 /* make sure that __wrap_*() prototypes match unwrapped counterparts */
 
-#define zbx_db_vselect	__wrap_zbx_db_vselect
-#define zbx_db_fetch	__wrap_zbx_db_fetch
-#define DBfree_result	__wrap_DBfree_result
+#define zbx_db_vselect			__wrap_zbx_db_vselect
+#define zbx_db_fetch			__wrap_zbx_db_fetch
+#define DBfree_result			__wrap_DBfree_result
+#define zbx_db_result_from_blob		__wrap_zbx_db_result_from_blob
+#define zbx_db_result_fields		__wrap_zbx_db_result_fields
 #include "zbxdb.h"
 #undef zbx_db_vselect
 #undef zbx_db_fetch
 #undef DBfree_result
+#undef zbx_db_result_from_blob
+#undef zbx_db_result_fields
 
 #define __zbx_DBexecute			__wrap___zbx_DBexecute
 #define DBexecute_multiple_query	__wrap_DBexecute_multiple_query
@@ -43,6 +47,9 @@
 
 #define ZBX_MOCK_DB_RESULT_COLUMNS_MAX	128
 
+/* serialized NULL value length, must match zbx_db_row_serialize() */
+#define ZBX_MOCK_DB_BLOB_NULL		0xffffffff
+
 typedef struct
 {
 	char	*data_source;
@@ -65,6 +72,12 @@ struct zbx_db_result
 	zbx_mock_handle_t	rows;
 	int			row_to_fetch;	/* for error messages */
 	int			columns;	/* to make sure that rows have identical number of columns */
+
+	/* rows serialized by zbx_db_row_serialize(), used instead of test case data if not NULL */
+	char			*blob;
+	size_t			blob_size;
+	size_t			blob_offset;
+	int			blob_fields;
 };
 
 DB_RESULT	__fwd_zbx_db_select(const char *fmt, ...);
@@ -131,6 +144,10 @@ static char	*generate_data_source(const char *sql)
 			break;
 	}
 
+	/* table name at the end of query */
+	if (0 != found)
+		*(ptr_ds++) = ' ';
+
 	if (ptr_ds == data_source)
 		zbx_free(data_source);	/* failed to generate data_source */
 	else
@@ -177,10 +194,90 @@ DB_RESULT	__wrap_zbx_db_vselect(const char *fmt, va_list args)
 	result->rows = rows;
 	result->row_to_fetch = 1;
 	result->columns = -1;
+	result->blob = NULL;
+
+	return result;
+}
+
+DB_RESULT	__wrap_zbx_db_result_from_blob(char *blob, size_t blob_size, int fields)
+{
+	DB_RESULT	result;
+
+	if (ZBX_MOCK_DB_RESULT_COLUMNS_MAX < fields)
+		fail_msg("Too many columns in serialized rows.");
+
+	result = zbx_malloc(NULL, sizeof(struct zbx_db_result));
+	result->row = zbx_malloc(NULL, ZBX_MOCK_DB_RESULT_COLUMNS_MAX * sizeof(char *));
+	result->data_source = zbx_strdup(NULL, "blob");
+	result->row_to_fetch = 1;
+	result->columns = fields;
+	result->blob = (NULL != blob ? blob : zbx_malloc(NULL, 1));
+	result->blob_size = blob_size;
+	result->blob_offset = 0;
+	result->blob_fields = fields;
 
 	return result;
 }
 
+int	__wrap_zbx_db_result_fields(DB_RESULT result)
+{
+	zbx_mock_handle_t	rows, row, field;
+	int			fields = 0;
+
+	if (NULL == result)
+		return 0;
+
+	if (NULL != result->blob)
+		return result->blob_fields;
+
+	/* count columns of the first row without fetching it */
+	if (ZBX_MOCK_SUCCESS != zbx_mock_db_rows(result->data_source, &rows) ||
+			ZBX_MOCK_SUCCESS != zbx_mock_vector_element(rows, &row))
+	{
+		return 0;
+	}
+
+	while (ZBX_MOCK_SUCCESS == zbx_mock_vector_element(row, &field))
+		fields++;
+
+	return fields;
+}
+
+static DB_ROW	mockdb_blob_fetch(DB_RESULT result)
+{
+	int	i;
+
+	if (result->blob_offset >= result->blob_size)
+		return NULL;
+
+	for (i = 0; i < result->blob_fields; i++)
+	{
+		zbx_uint32_t	len;
+
+		if (result->blob_offset + sizeof(len) > result->blob_size)
+			fail_msg("Truncated length of column %d, row %d in serialized rows.", i + 1, result->row_to_fetch);
+
+		memcpy(&len, result->blob + result->blob_offset, sizeof(len));
+		result->blob_offset += sizeof(len);
+
+		if (ZBX_MOCK_DB_BLOB_NULL == len)
+		{
+			result->row[i] = NULL;
+			continue;
+		}
+
+		if (result->blob_offset + (size_t)len + 1 > result->blob_size)
+			fail_msg("Truncated value of column %d, row %d in serialized rows.", i + 1, result->row_to_fetch);
+
+		result->row[i] = result->blob + result->blob_offset;
+		result->blob_offset += (size_t)len + 1;
+	}
+
+	result->row_to_fetch++;
+
+	return result->row;
+}
+
 DB_RESULT	__fwd_zbx_db_select(const char *fmt, ...)
 {
 	va_list		args;
@@ -204,6 +301,9 @@ DB_ROW	__wrap_zbx_db_fetch(DB_RESULT result)
 	zbx_mock_handle_t	row, field;
 	int			column = 0;
 
+	if (NULL != result && NULL != result->blob)
+		return mockdb_blob_fetch(result);
+
 	if (NULL == result || ZBX_MOCK_END_OF_VECTOR == (error = zbx_mock_vector_element(result->rows, &row)))
 		return NULL;
 
@@ -262,6 +362,7 @@ void	__wrap_DBfree_result(DB_RESULT result)
 	{
 		zbx_free(result->row);
 		zbx_free(result->data_source);
+		zbx_free(result->blob);
 	}
 
 	zbx_free(result);
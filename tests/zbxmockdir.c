@@ -27,12 +27,17 @@
 
 #include "zbxmocktest.h"
 #include "zbxmockdata.h"
+#include "zbxmockutil.h"
 
 #include "common.h"
 
+DIR		*__real_opendir(const char *name);
+struct dirent	*__real_readdir(DIR *dirp);
+
 DIR	*__wrap_opendir(const char *name)
 {
-	ZBX_UNUSED(name);
+	if (SUCCEED == zbx_mock_is_real_path(name))
+		return __real_opendir(name);
 
 	errno = ENOENT;
 	return NULL;
@@ -40,7 +45,9 @@ DIR	*__wrap_opendir(const char *name)
 
 struct dirent	*__wrap_readdir(DIR *dirp)
 {
-	ZBX_UNUSED(dirp);
+	/* only directories of real files are opened */
+	if (NULL != dirp)
+		return __real_readdir(dirp);
 
 	errno = EBADF;
 	return NULL;
@@ -37,6 +37,9 @@ void	*mock_streams[ZBX_MOCK_MAX_FILES];
 
 static zbx_mock_handle_t	fragments;
 
+/* the directory of real files created by test, file functions are not mocked for paths within it */
+static char	*real_dir = NULL;
+
 struct zbx_mock_IO_FILE
 {
 	const char	*contents;
@@ -72,6 +75,48 @@ static int	is_profiler_path(const char *path)
 	return FAIL;
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_mock_set_real_dir                                            *
+ *                                                                            *
+ * Purpose: sets directory of real files, which are accessed without mocking  *
+ *                                                                            *
+ * Parameters: path - [IN] the directory path, NULL to mock all files         *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_mock_set_real_dir(const char *path)
+{
+	zbx_free(real_dir);
+
+	if (NULL != path)
+		real_dir = zbx_strdup(NULL, path);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_mock_is_real_path                                            *
+ *                                                                            *
+ * Purpose: checks if path is within directory of real files                  *
+ *                                                                            *
+ * Return value: SUCCEED - the path must be accessed without mocking          *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_mock_is_real_path(const char *path)
+{
+	size_t	len;
+
+	if (NULL == real_dir)
+		return FAIL;
+
+	len = strlen(real_dir);
+
+	if (0 != strncmp(path, real_dir, len) || ('\0' != path[len] && '/' != path[len]))
+		return FAIL;
+
+	return SUCCEED;
+}
+
 static int	is_mock_stream(FILE *stream)
 {
 	int	i;
@@ -92,7 +137,7 @@ FILE	*__wrap_fopen(const char *path, const char *mode)
 	const char		*contents;
 	struct zbx_mock_IO_FILE	*file = NULL;
 
-	if (SUCCEED == is_profiler_path(path))
+	if (SUCCEED == is_profiler_path(path) || SUCCEED == zbx_mock_is_real_path(path))
 		return __real_fopen(path, mode);
 
 	if (0 != strcmp(mode, "r"))
@@ -184,7 +229,7 @@ int	__wrap_connect(int socket, __CONST_SOCKADDR_ARG addr, socklen_t address_len)
 
 int	__wrap_open(const char *path, int oflag, ...)
 {
-	if (SUCCEED == is_profiler_path(path))
+	if (SUCCEED == is_profiler_path(path) || SUCCEED == zbx_mock_is_real_path(path))
 	{
 		va_list	args;
 		int	fd;
@@ -251,7 +296,7 @@ int	__wrap_stat(const char *path, struct stat *buf)
 	zbx_mock_error_t	error;
 	zbx_mock_handle_t	handle;
 
-	if (SUCCEED == is_profiler_path(path))
+	if (SUCCEED == is_profiler_path(path) || SUCCEED == zbx_mock_is_real_path(path))
 		return __real_stat(path, buf);
 
 	if (ZBX_MOCK_SUCCESS == (error = zbx_mock_file(path, &handle)))
@@ -277,7 +322,7 @@ int	__wrap___xstat(int ver, const char *pathname, struct stat *buf)
 {
 	ZBX_UNUSED(ver);
 
-	if (SUCCEED == is_profiler_path(pathname))
+	if (SUCCEED == is_profiler_path(pathname) || SUCCEED == zbx_mock_is_real_path(pathname))
 		return __real_stat(pathname, buf);
 
 	return __wrap_stat(pathname, buf);
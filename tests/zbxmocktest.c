@@ -58,6 +58,9 @@ int	CONFIG_HISTORYPOLLER_FORKS	= 5;
 int	CONFIG_AVAILMAN_FORKS		= 1;
 int	CONFIG_SERVICEMAN_FORKS		= 0;
 int	CONFIG_PROBLEMHOUSEKEEPER_FORKS = 0;
+int	CONFIG_AGENTPOLLER_FORKS	= 0;
+int	CONFIG_SNMPPOLLER_FORKS		= 0;
+int	CONFIG_HTTPAGENT_POLLER_FORKS	= 0;
 
 int	CONFIG_LISTEN_PORT		= 0;
 char	*CONFIG_LISTEN_IP		= NULL;
@@ -68,6 +71,7 @@ int	CONFIG_HOUSEKEEPING_FREQUENCY	= 1;
 int	CONFIG_MAX_HOUSEKEEPER_DELETE	= 5000;		/* applies for every separate field value */
 int	CONFIG_HISTSYNCER_FORKS		= 4;
 int	CONFIG_HISTSYNCER_FREQUENCY	= 1;
+int	CONFIG_HISTSYNCER_PIPELINE	= 0;
 int	CONFIG_CONFSYNCER_FORKS		= 1;
 int	CONFIG_CONFSYNCER_FREQUENCY	= 60;
 int	CONFIG_PROBLEMHOUSEKEEPING_FREQUENCY = 60;
@@ -80,8 +84,18 @@ int	CONFIG_VMWARE_TIMEOUT		= 10;
 zbx_uint64_t	CONFIG_CONF_CACHE_SIZE		= 8 * 0;
 zbx_uint64_t	CONFIG_HISTORY_CACHE_SIZE	= 16 * 0;
 zbx_uint64_t	CONFIG_HISTORY_INDEX_CACHE_SIZE	= 4 * 0;
+int		CONFIG_HISTORY_CACHE_SHARDS	= 1;
+int		CONFIG_HISTORY_CACHE_COMPRESSION	= 0;
+char		*CONFIG_HISTORY_CACHE_SPOOL_FILE	= NULL;
+zbx_uint64_t	CONFIG_HISTORY_CACHE_SPOOL_SIZE	= ZBX_GIBIBYTE;
+char		*CONFIG_HISTORY_CACHE_SNAPSHOT_FILE	= NULL;
 zbx_uint64_t	CONFIG_TRENDS_CACHE_SIZE	= 4 * 0;
 zbx_uint64_t	CONFIG_VALUE_CACHE_SIZE		= 8 * 0;
+int		CONFIG_VALUE_CACHE_COMPRESSION	= 0;
+int		CONFIG_VALUE_CACHE_STRIPES	= 1;
+char		*CONFIG_VALUE_CACHE_SNAPSHOT_FILE	= NULL;
+char		*CONFIG_CONFIG_CACHE_SNAPSHOT_FILE	= NULL;
+int		CONFIG_VALUE_CACHE_PERCENTILE_SKETCH	= 0;
 zbx_uint64_t	CONFIG_VMWARE_CACHE_SIZE	= 8 * 0;
 zbx_uint64_t	CONFIG_EXPORT_FILE_SIZE;
 zbx_uint64_t	CONFIG_TREND_FUNC_CACHE_SIZE	= 0;
@@ -175,6 +189,7 @@ char	*CONFIG_TLS_CIPHER_CMD		= NULL;
 char	*CONFIG_SOCKET_PATH			= NULL;
 char	*CONFIG_HISTORY_STORAGE_URL		= NULL;
 char	*CONFIG_HISTORY_STORAGE_OPTS		= NULL;
+char	*CONFIG_HISTORY_STORAGE_DIR		= NULL;
 int	CONFIG_HISTORY_STORAGE_PIPELINES	= 0;
 
 /* not used in tests, defined for linking with comms.c */
@@ -41,4 +41,7 @@ void	zbx_mock_str_to_token_type(const char *str, int *out);
 int	zbx_mock_str_to_item_type(const char *str);
 int	zbx_mock_str_to_family(const char *str);
 
+void	zbx_mock_set_real_dir(const char *path);
+int	zbx_mock_is_real_path(const char *path);
+
 #endif